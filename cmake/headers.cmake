@@ -30,6 +30,7 @@ include_directories(
   ${FLB_PATH_ROOT_SOURCE}/${FLB_PATH_LIB_MINIZ}/
   ${FLB_PATH_ROOT_SOURCE}/${FLB_PATH_LIB_ONIGMO}
   ${FLB_PATH_ROOT_SOURCE}/${FLB_PATH_LIB_SNAPPY}
+  ${FLB_PATH_ROOT_SOURCE}/${FLB_PATH_LIB_ZSTD}
   ${FLB_PATH_ROOT_SOURCE}/${FLB_PATH_LIB_CMETRICS}/include
   ${FLB_PATH_ROOT_SOURCE}/${FLB_PATH_LIB_CTRACES}/include
   ${FLB_PATH_ROOT_SOURCE}/${FLB_PATH_LIB_CARES}/include
@@ -21,6 +21,8 @@ set(FLB_PATH_LIB_MINIZ       "lib/miniz")
 set(FLB_PATH_LIB_TUTF8E      "lib/tutf8e")
 set(FLB_PATH_LIB_CARES       "lib/c-ares-1.32.3")
 set(FLB_PATH_LIB_SNAPPY      "lib/snappy-fef67ac")
+set(FLB_PATH_LIB_LZ4         "lib/lz4-1.9.3")
+set(FLB_PATH_LIB_ZSTD        "lib/zstd-1.5.7")
 set(FLB_PATH_LIB_RDKAFKA     "lib/librdkafka-2.4.0")
 set(FLB_PATH_LIB_RING_BUFFER "lib/lwrb")
 set(FLB_PATH_LIB_WASM_MICRO_RUNTIME  "lib/wasm-micro-runtime-WAMR-1.3.0")
@@ -0,0 +1,147 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <fluent-bit.h>
+#include <fluent-bit/flb_pack.h>
+#include <cfl/cfl_time.h>
+#include <monkey/mk_core.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_RECORDS     10000
+#define BENCH_ITERATIONS  50
+
+/* Generate BENCH_RECORDS newline separated JSON log lines */
+static char *bench_generate(size_t *out_len)
+{
+    int i;
+    size_t len = 0;
+    size_t size;
+    char *buf;
+
+    size = BENCH_RECORDS * 512;
+    buf = flb_malloc(size);
+    if (!buf) {
+        return NULL;
+    }
+
+    for (i = 0; i < BENCH_RECORDS; i++) {
+        len += snprintf(buf + len, size - len,
+                        "{\"time\": \"2024-05-30T09:39:52.000681Z\", "
+                        "\"stream\": \"stdout\", \"level\": \"info\", "
+                        "\"code\": %i, \"latency\": %i.%i, \"ok\": true, "
+                        "\"log\": \"GET /api/v1/items/%i HTTP/1.1 200 - "
+                        "Mozilla/5.0 (X11; Linux x86_64) \\\"curl\\\"\", "
+                        "\"kubernetes\": {\"pod_name\": \"app-%i\", "
+                        "\"namespace_name\": \"default\", "
+                        "\"labels\": {\"app\": \"web\", \"tier\": \"frontend\"}}}\n",
+                        200 + (i % 5), i % 100, i % 10, i, i % 32);
+    }
+
+    *out_len = len;
+    return buf;
+}
+
+static double bench_run(int backend, char *json, size_t len, int iterations,
+                        size_t *out_size)
+{
+    int i;
+    int ret;
+    int prev;
+    int root_type;
+    int records;
+    char *out_buf;
+    size_t consumed;
+    uint64_t start;
+    uint64_t end;
+
+    prev = flb_pack_json_backend_set(backend);
+    if (prev == -1) {
+        return -1;
+    }
+
+    start = cfl_time_now();
+    for (i = 0; i < iterations; i++) {
+        ret = flb_pack_json_recs(json, len, &out_buf, out_size, &root_type,
+                                 &records, &consumed);
+        if (ret != 0) {
+            fprintf(stderr, "packer failed (backend %i)\n", backend);
+            flb_pack_json_backend_set(prev);
+            return -1;
+        }
+        flb_free(out_buf);
+    }
+    end = cfl_time_now();
+
+    flb_pack_json_backend_set(prev);
+
+    /* MB/s */
+    return ((double) len * iterations / (1024 * 1024)) /
+           ((double) (end - start) / 1000000000.0);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = BENCH_ITERATIONS;
+    size_t len;
+    size_t size_jsmn = 0;
+    size_t size_scan = 0;
+    double jsmn;
+    double scan;
+    char *json;
+
+    if (argc > 1) {
+        json = mk_file_to_buffer(argv[1]);
+        if (!json) {
+            fprintf(stderr, "cannot read %s\n", argv[1]);
+            exit(EXIT_FAILURE);
+        }
+        len = strlen(json);
+    }
+    else {
+        json = bench_generate(&len);
+        if (!json) {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc > 2) {
+        iterations = atoi(argv[2]);
+    }
+
+    jsmn = bench_run(FLB_PACK_JSON_BACKEND_JSMN, json, len, iterations,
+                     &size_jsmn);
+    scan = bench_run(FLB_PACK_JSON_BACKEND_SCAN, json, len, iterations,
+                     &size_scan);
+
+    printf("input   : %zu bytes x %i iterations\n", len, iterations);
+    printf("jsmn    : %8.2f MB/s (%zu bytes msgpack)\n", jsmn, size_jsmn);
+    if (scan < 0) {
+        printf("scan    : not available, build with -DFLB_SIMD=On\n");
+    }
+    else {
+        printf("scan    : %8.2f MB/s (%zu bytes msgpack)\n", scan, size_scan);
+        printf("speedup : %8.2fx\n", scan / jsmn);
+    }
+
+    flb_free(json);
+    return 0;
+}
@@ -24,6 +24,8 @@
 #define FLB_AWS_COMPRESS_NONE  0
 #define FLB_AWS_COMPRESS_GZIP  1
 #define FLB_AWS_COMPRESS_ARROW 2
+#define FLB_AWS_COMPRESS_ZSTD  3
+#define FLB_AWS_COMPRESS_LZ4   4
 
 /*
  * Get compression type from compression keyword. The return value is used to identify
@@ -33,6 +35,14 @@
  */
 int flb_aws_compression_get_type(const char *compression_keyword);
 
+/*
+ * Get the compression keyword of a compression type id, the value is suitable
+ * for the Content-Encoding header of the gzip, zstd and lz4 types.
+ *
+ * Returns NULL if the type is unknown
+ */
+const char *flb_aws_compression_get_keyword(int compression_type);
+
 /*
  * Compress in_data and write result to newly allocated out_data buf
  * Client is responsable for freeing out_data.
@@ -0,0 +1,69 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef FLB_AHO_CORASICK_H
+#define FLB_AHO_CORASICK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Aho-Corasick automaton: looks up a set of literal strings in a buffer with
+ * a single pass, whatever the number of strings is.
+ *
+ *     ac = flb_aho_corasick_create();
+ *     a = flb_aho_corasick_add(ac, "foo", 3);
+ *     b = flb_aho_corasick_add(ac, "bar", 3);
+ *     flb_aho_corasick_build(ac);
+ *
+ *     memset(found, 0, ac->patterns);
+ *     flb_aho_corasick_search(ac, buf, len, found);
+ *     ... found[a] and found[b] are set if the strings are in 'buf' ...
+ */
+
+struct flb_aho_corasick_pattern {
+    char *str;
+    size_t len;
+};
+
+struct flb_aho_corasick {
+    int patterns;                   /* number of patterns added          */
+    int patterns_size;
+    struct flb_aho_corasick_pattern *list;
+
+    /* automaton, set by flb_aho_corasick_build() */
+    int states;
+    int classes;                    /* bytes found in the patterns + 1   */
+    uint8_t class_map[256];         /* byte to class, 0 for other bytes  */
+    int32_t *next;                  /* next row, < 0 if it has outputs   */
+    int32_t *out_offset;            /* per state range in 'out'          */
+    int32_t *out;                   /* patterns ending at every state    */
+};
+
+struct flb_aho_corasick *flb_aho_corasick_create();
+void flb_aho_corasick_destroy(struct flb_aho_corasick *ac);
+
+int flb_aho_corasick_add(struct flb_aho_corasick *ac,
+                         const char *str, size_t len);
+int flb_aho_corasick_build(struct flb_aho_corasick *ac);
+
+int flb_aho_corasick_search(struct flb_aho_corasick *ac,
+                            const char *buf, size_t len, char *found);
+
+#endif
@@ -0,0 +1,81 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef FLB_ARENA_H
+#define FLB_ARENA_H
+
+#include <fluent-bit/flb_info.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Arena allocator: memory is taken from big blocks by bumping a pointer and
+ * it's released all at once when the arena is reset, there is no free() for
+ * single allocations. It's meant for short lived data that is created and
+ * discarded per chunk, like the records of a chunk going through the
+ * processors.
+ *
+ * Users open a scope before allocating and close it when they are done, the
+ * arena is reset when the outer scope is closed. After a reset the arena
+ * keeps a single block big enough for the previous usage, so on a steady
+ * state there are no calls to the system allocator.
+ */
+
+#define FLB_ARENA_BLOCK_SIZE      (64 * 1024)
+#define FLB_ARENA_BLOCK_MAX       (4 * 1024 * 1024)
+#define FLB_ARENA_ALIGN           16
+
+struct flb_arena_block {
+    size_t size;                     /* usable bytes in 'data' */
+    size_t used;                     /* bytes handed out       */
+    struct flb_arena_block *next;    /* previous (full) block  */
+    char *data;                      /* aligned, after header  */
+};
+
+struct flb_arena {
+    int scopes;                      /* open scopes               */
+    size_t block_size;               /* default block size        */
+    size_t used;                     /* bytes used since reset    */
+    size_t high_water;               /* maximum of 'used'         */
+    size_t reserved;                 /* bytes held by the blocks  */
+    struct flb_arena_block *block;   /* current block             */
+};
+
+struct flb_arena *flb_arena_create(size_t block_size);
+void flb_arena_destroy(struct flb_arena *arena);
+
+void *flb_arena_alloc(struct flb_arena *arena, size_t size);
+void *flb_arena_calloc(struct flb_arena *arena, size_t size);
+void flb_arena_reset(struct flb_arena *arena);
+
+void flb_arena_scope_begin(struct flb_arena *arena);
+void flb_arena_scope_end(struct flb_arena *arena);
+
+/* Arena of the calling thread, created on first use */
+void flb_arena_init();
+struct flb_arena *flb_arena_thread_get();
+void flb_arena_thread_destroy();
+
+/* Usage of all the arenas, for the internal metrics */
+uint64_t flb_arena_high_water();
+uint64_t flb_arena_reserved();
+
+#endif
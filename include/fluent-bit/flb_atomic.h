@@ -0,0 +1,107 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef FLB_ATOMIC_H
+#define FLB_ATOMIC_H
+
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+
+/*
+ * Minimal set of 64 bits atomic operations. Loads have acquire semantics,
+ * stores have release semantics and read-modify-write operations are full
+ * barriers.
+ */
+
+static inline uint64_t flb_atomic_load(uint64_t *storage)
+{
+#ifdef _MSC_VER
+    return (uint64_t) InterlockedCompareExchange64((LONG64 volatile *) storage,
+                                                   0, 0);
+#else
+    return __atomic_load_n(storage, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void flb_atomic_store(uint64_t *storage, uint64_t value)
+{
+#ifdef _MSC_VER
+    InterlockedExchange64((LONG64 volatile *) storage, (LONG64) value);
+#else
+    __atomic_store_n(storage, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/* Returns the previous value */
+static inline uint64_t flb_atomic_exchange(uint64_t *storage, uint64_t value)
+{
+#ifdef _MSC_VER
+    return (uint64_t) InterlockedExchange64((LONG64 volatile *) storage,
+                                            (LONG64) value);
+#else
+    return __atomic_exchange_n(storage, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* Returns the previous value */
+static inline uint64_t flb_atomic_add(uint64_t *storage, uint64_t value)
+{
+#ifdef _MSC_VER
+    return (uint64_t) InterlockedExchangeAdd64((LONG64 volatile *) storage,
+                                               (LONG64) value);
+#else
+    return __atomic_fetch_add(storage, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/* Returns the previous value */
+static inline uint64_t flb_atomic_sub(uint64_t *storage, uint64_t value)
+{
+    return flb_atomic_add(storage, (uint64_t) 0 - value);
+}
+
+/*
+ * Replace '*storage' by 'value' if it's still 'expected'. Returns 1 on
+ * success, otherwise 0 and 'expected' gets the current value.
+ */
+static inline int flb_atomic_compare_exchange(uint64_t *storage,
+                                              uint64_t *expected,
+                                              uint64_t value)
+{
+#ifdef _MSC_VER
+    LONG64 prev;
+
+    prev = InterlockedCompareExchange64((LONG64 volatile *) storage,
+                                        (LONG64) value, (LONG64) *expected);
+    if ((uint64_t) prev == *expected) {
+        return 1;
+    }
+    *expected = (uint64_t) prev;
+    return 0;
+#else
+    return __atomic_compare_exchange_n(storage, expected, value, 0,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE);
+#endif
+}
+
+#endif
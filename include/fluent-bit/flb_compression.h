@@ -22,10 +22,16 @@
 
 #include <fluent-bit/flb_info.h>
 #include <fluent-bit/flb_gzip.h>
+#include <fluent-bit/flb_lz4.h>
+#ifdef FLB_HAVE_ZSTD
+#include <fluent-bit/flb_zstd.h>
+#endif
 #include <stdio.h>
 
 #define FLB_COMPRESSION_ALGORITHM_NONE                    0
 #define FLB_COMPRESSION_ALGORITHM_GZIP                    1
+#define FLB_COMPRESSION_ALGORITHM_ZSTD                    2
+#define FLB_COMPRESSION_ALGORITHM_LZ4                     3
 
 #define FLB_DECOMPRESSOR_STATE_FAILED                    -1
 #define FLB_DECOMPRESSOR_STATE_EXPECTING_HEADER           0
@@ -41,6 +47,12 @@
 
 #define FLB_DECOMPRESSION_BUFFER_SIZE                     (1024 * 1000)
 
+/*
+ * Largest payload the network inputs decompress from a single request, the
+ * same limit flb_gzip_uncompress() enforces.
+ */
+#define FLB_DECOMPRESSION_MAX_SIZE                        100000000
+
 struct flb_decompression_context {
     size_t     input_buffer_length;
     size_t     input_buffer_size;
@@ -73,4 +85,17 @@ int flb_decompress(struct flb_decompression_context *context,
                    void *output_buffer,
                    size_t *output_length);
 
+int flb_compression_get_algorithm_by_name(const char *name, size_t length);
+const char *flb_compression_get_algorithm_name(int algorithm);
+int flb_compression_is_supported(int algorithm);
+
+int flb_compress(int algorithm,
+                 void *in_data, size_t in_len,
+                 void **out_data, size_t *out_len);
+/* max_size limits the decompressed data, zero means no limit */
+int flb_uncompress(int algorithm,
+                   void *in_data, size_t in_len,
+                   void **out_data, size_t *out_len,
+                   size_t max_size);
+
 #endif
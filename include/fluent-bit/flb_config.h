@@ -37,6 +37,10 @@
 #define HC_RETRY_FAILURE_COUNTS_DEFAULT 5
 #define HEALTH_CHECK_PERIOD 60
 #define FLB_CONFIG_DEFAULT_TAG  "fluent_bit"
+#define FLB_CONFIG_DNS_CACHE_MAX_TTL       300
+#define FLB_CONFIG_DNS_CACHE_NEGATIVE_TTL  5
+
+struct flb_net_dns_cache;
 
 /* Main struct to hold the configuration of the runtime service */
 struct flb_config {
@@ -133,6 +137,16 @@ struct flb_config {
     /* Filter instances */
     struct mk_list filters;
 
+    /* Threads running the filters chain (see flb_filter_worker.h) */
+    int filter_workers;
+    struct flb_filter_pool *filter_pool;
+
+    /* Compiled routing table (Tag -> filters and outputs) */
+    struct flb_router_table *router_table;
+
+    /* Number of elements of the routes mask (see flb_routes_mask.h) */
+    size_t route_mask_size;
+
     struct mk_event_loop *evl;          /* the event loop (mk_core) */
 
     struct flb_bucket_queue *evl_bktq;   /* bucket queue for evl track event priority */
@@ -214,6 +228,11 @@ struct flb_config {
     char *dns_resolver;
     int   dns_prefer_ipv4;
     int   dns_prefer_ipv6;
+    int   dns_cache;                /* share resolved names across upstreams */
+    int   dns_cache_max_ttl;
+    int   dns_cache_negative_ttl;
+    int   dns_cache_stale_ttl;
+    struct flb_net_dns_cache *dns_cache_ctx;
 
     /* Chunk I/O Buffering */
     void *cio;
@@ -222,6 +241,7 @@ struct flb_config {
     char *storage_sync;             /* sync mode */
     int   storage_metrics;          /* enable/disable storage metrics */
     int   storage_checksum;         /* checksum enabled */
+    int   storage_meta_stats;       /* record stats in chunk metadata */
     int   storage_max_chunks_up;    /* max number of chunks 'up' in memory */
     int   storage_del_bad_chunks;   /* delete irrecoverable chunks */
     char *storage_bl_mem_limit;     /* storage backlog memory limit */
@@ -280,6 +300,9 @@ struct flb_config {
      */
     uint16_t in_table_id[512];
 
+    /* Queue used by threaded inputs to publish their data to the engine */
+    struct flb_mpsc_queue *input_queue;
+
     void *sched;
     unsigned int sched_cap;
     unsigned int sched_base;
@@ -352,12 +375,17 @@ enum conf_type {
 #define FLB_CONF_DNS_RESOLVER          "dns.resolver"
 #define FLB_CONF_DNS_PREFER_IPV4       "dns.prefer_ipv4"
 #define FLB_CONF_DNS_PREFER_IPV6       "dns.prefer_ipv6"
+#define FLB_CONF_DNS_CACHE             "dns.cache"
+#define FLB_CONF_DNS_CACHE_MAX_TTL     "dns.cache.max_ttl"
+#define FLB_CONF_DNS_CACHE_NEGATIVE_TTL "dns.cache.negative_ttl"
+#define FLB_CONF_DNS_CACHE_STALE_TTL   "dns.cache.stale_ttl"
 
 /* Storage / Chunk I/O */
 #define FLB_CONF_STORAGE_PATH          "storage.path"
 #define FLB_CONF_STORAGE_SYNC          "storage.sync"
 #define FLB_CONF_STORAGE_METRICS       "storage.metrics"
 #define FLB_CONF_STORAGE_CHECKSUM      "storage.checksum"
+#define FLB_CONF_STORAGE_META_STATS    "storage.metadata_stats"
 #define FLB_CONF_STORAGE_BL_MEM_LIMIT  "storage.backlog.mem_limit"
 #define FLB_CONF_STORAGE_MAX_CHUNKS_UP "storage.max_chunks_up"
 #define FLB_CONF_STORAGE_DELETE_IRRECOVERABLE_CHUNKS \
@@ -371,4 +399,7 @@ enum conf_type {
 #define FLB_CONF_STR_SCHED_CAP        "scheduler.cap"
 #define FLB_CONF_STR_SCHED_BASE       "scheduler.base"
 
+/* Filters */
+#define FLB_CONF_STR_FILTER_WORKERS   "filter.workers"
+
 #endif
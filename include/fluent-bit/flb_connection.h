@@ -58,6 +58,7 @@ struct flb_net_setup;
 struct flb_upstream;
 struct flb_downstream;
 struct flb_tls_session;
+struct flb_http2_client_session;
 
 /* Base network connection */
 struct flb_connection {
@@ -153,6 +154,9 @@ struct flb_connection {
 
     /* Each TCP connections using TLS needs a session */
     struct flb_tls_session *tls_session;
+
+    /* HTTP/2 client session, set if the upstream connection speaks h2 */
+    struct flb_http2_client_session *http2_session;
 };
 
 int flb_connection_setup(struct flb_connection *connection,
@@ -0,0 +1,34 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef FLB_DTOA_H
+#define FLB_DTOA_H
+
+/* Room needed by flb_dtoa(), including the sign and the exponent */
+#define FLB_DTOA_BUFFER_SIZE   32
+
+/*
+ * Write the shortest decimal representation of 'value' that reads back to
+ * the same double, using the same layout than printf(3) '%g'. The value must
+ * be finite, the output is not NULL terminated. Returns the number of bytes
+ * written.
+ */
+int flb_dtoa(double value, char *buf);
+
+#endif
@@ -51,12 +51,20 @@
 #define FLB_FILTER_METRICS     2
 #define FLB_FILTER_TRACES      4
 
+/*
+ * Plugin flags: a thread safe filter can run its filter callback for several
+ * buffers at the same time, so it can be dispatched to the filter workers.
+ * The flags are copied to every instance, which can clear them from its
+ * init callback.
+ */
+#define FLB_FILTER_THREADSAFE  1
+
 struct flb_input_instance;
 struct flb_filter_instance;
 
 struct flb_filter_plugin {
     int event_type;        /* Event type: logs, metrics, traces */
-    int flags;             /* Flags (not available at the moment */
+    int flags;             /* Flags                        */
     char *name;            /* Filter short name            */
     char *description;     /* Description                  */
 
@@ -82,6 +90,7 @@ struct flb_filter_instance {
     int id;                        /* instance id              */
     int log_level;                 /* instance log level       */
     int log_suppress_interval;     /* log suppression interval     */
+    int flags;                     /* plugin flags of the instance */
     char name[32];                 /* numbered name            */
     char *alias;                   /* alias name               */
     char *match;                   /* match rule based on Tags */
@@ -106,6 +115,7 @@ struct flb_filter_instance {
     struct cmt_counter *cmt_bytes;        /* m: filter_bytes_total        */
     struct cmt_counter *cmt_add_records;  /* m: filter_add_records_total  */
     struct cmt_counter *cmt_drop_records; /* m: filter_drop_records_total */
+    struct cmt_counter *cmt_queue_wait;   /* m: filter_queue_wait_seconds_total */
 
 #ifdef FLB_HAVE_METRICS
     struct flb_metrics *metrics;   /* metrics                  */
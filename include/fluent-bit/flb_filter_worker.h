@@ -0,0 +1,90 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef FLB_FILTER_WORKER_H
+#define FLB_FILTER_WORKER_H
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_pthread.h>
+#include <fluent-bit/flb_thread_pool.h>
+
+#include <stdint.h>
+
+/*
+ * Filter workers: when 'filter.workers' is set in the service section, the
+ * records appended to a chunk are split in slices that run through the
+ * filters chain in parallel, the caller waits for all of them and joins the
+ * results in the original order. Only chains made of filters registering the
+ * FLB_FILTER_THREADSAFE flag are dispatched.
+ *
+ * A thread safe filter keeping state that cannot be shared, e.g. an
+ * interpreter, allocates flb_filter_worker_slots() copies of it at init
+ * time and picks the one of the running thread with flb_filter_worker_id().
+ */
+
+/* Minimum number of records of a slice */
+#define FLB_FILTER_WORKER_SLICE_MIN   256
+
+/* Number of jobs that can wait in the queue per worker */
+#define FLB_FILTER_WORKER_QUEUE_SIZE  4
+
+struct flb_filter_job {
+    void (*cb) (struct flb_filter_job *);
+    uint64_t queued;                /* time when it was queued (ns)   */
+    uint64_t wait;                  /* time spent in the queue (ns)   */
+    int *pending;                   /* jobs of the batch not done yet */
+};
+
+struct flb_filter_worker {
+    int id;                         /* 1..workers, 0 is the caller     */
+    struct flb_filter_pool *pool;
+};
+
+struct flb_filter_pool {
+    int workers;
+    int stop;
+    int callers;                    /* threads running a batch         */
+
+    /* bounded queue of jobs, callers wait if it's full */
+    int queue_size;
+    int queue_head;
+    int queue_count;
+    struct flb_filter_job **queue;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_jobs;       /* a job was queued or stop is set */
+    pthread_cond_t cond_space;      /* a job was taken from the queue  */
+    pthread_cond_t cond_done;       /* a batch was completed           */
+
+    struct flb_filter_worker *threads;
+    struct flb_tp *tp;
+    struct flb_config *config;
+};
+
+void flb_filter_worker_init();
+int flb_filter_worker_id();
+int flb_filter_worker_slots(struct flb_config *config);
+
+int flb_filter_pool_create(struct flb_config *config);
+void flb_filter_pool_destroy(struct flb_config *config);
+
+void flb_filter_pool_run(struct flb_filter_pool *pool,
+                         struct flb_filter_job **jobs, int count);
+
+#endif
@@ -47,24 +47,71 @@ struct flb_hash_table_entry {
     struct mk_list _head_parent;        /* link to flb_hash->entries */
 };
 
+/* Table layouts */
+#define FLB_HASH_TABLE_CHAINED          0   /* linked entries per bucket     */
+#define FLB_HASH_TABLE_OPEN             1   /* open addressing, inline slots */
+
+/* Keys shorter than this are stored inside the slot of an open table */
+#define FLB_HASH_TABLE_INLINE_KEY      24
+
 struct flb_hash_table_chain {
     int count;
     struct mk_list chains;
 };
 
+/*
+ * Open addressing slot. Slots live in a single array, a parallel array of
+ * control bytes (one per slot) tells if the slot is empty, deleted or the
+ * 7 bits tag of the key hash, so lookups only touch the slots with a
+ * matching tag.
+ */
+struct flb_hash_table_slot {
+    uint64_t hash;
+    uint64_t hits;
+    time_t created;
+    char *key;                          /* 'inline_key' or a heap copy */
+    int key_len;
+    int32_t older;                      /* insertion order: previous slot */
+    int32_t newer;                      /* insertion order: next slot */
+    void *val;
+    ssize_t val_size;
+    char inline_key[FLB_HASH_TABLE_INLINE_KEY];
+};
+
 struct flb_hash_table {
+    int type;
     int evict_mode;
     int max_entries;
     int total_count;
     int cache_ttl;
     size_t size;
+
+    /* chained layout (FLB_HASH_TABLE_CHAINED) */
     struct mk_list entries;
     struct flb_hash_table_chain *table;
+
+    /* open addressing layout (FLB_HASH_TABLE_OPEN) */
+    size_t capacity;                    /* number of slots, power of two */
+    size_t deleted;                     /* number of deleted slots       */
+    uint8_t *ctrl;                      /* control bytes                 */
+    struct flb_hash_table_slot *slots;
+    int32_t oldest;                     /* first inserted slot or -1     */
+    int32_t newest;                     /* last inserted slot or -1      */
 };
 
 struct flb_hash_table *flb_hash_table_create(int evict_mode, size_t size, int max_entries);
 struct flb_hash_table *flb_hash_table_create_with_ttl(int cache_ttl, int evict_mode,
                                                       size_t size, int max_entries);
+
+/*
+ * Open addressing tables: same interface and eviction modes. The table grows
+ * as needed, the ids returned by flb_hash_table_add() and _get() are slot
+ * numbers and are valid until the next table update.
+ */
+struct flb_hash_table *flb_hash_table_create_open(int evict_mode, size_t size,
+                                                  int max_entries);
+struct flb_hash_table *flb_hash_table_create_open_with_ttl(int cache_ttl, int evict_mode,
+                                                           size_t size, int max_entries);
 void flb_hash_table_destroy(struct flb_hash_table *ht);
 
 int flb_hash_table_add(struct flb_hash_table *ht,
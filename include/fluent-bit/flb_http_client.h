@@ -158,6 +158,8 @@ int flb_http_bearer_auth(struct flb_http_client *c,
                         const char *token);
 int flb_http_set_keepalive(struct flb_http_client *c);
 int flb_http_set_content_encoding_gzip(struct flb_http_client *c);
+int flb_http_set_content_encoding_zstd(struct flb_http_client *c);
+int flb_http_set_content_encoding_lz4(struct flb_http_client *c);
 int flb_http_set_callback_context(struct flb_http_client *c,
                                   struct flb_callback *cb_ctx);
 
@@ -0,0 +1,89 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef FLB_HTTP_CLIENT_HTTP2_H
+#define FLB_HTTP_CLIENT_HTTP2_H
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_coro.h>
+#include <monkey/mk_core.h>
+
+#include <nghttp2/nghttp2.h>
+
+/*
+ * HTTP/2 client: when 'net.http2' is enabled in an upstream, every new
+ * connection gets an HTTP/2 session (negotiated through ALPN for TLS, prior
+ * knowledge for plain TCP) and flb_http_do() sends the requests as streams
+ * of that session. The upstream hands the same connection to concurrent
+ * callers until the stream limit is reached.
+ *
+ * Only one coroutine at a time (the 'driver') reads and writes the socket,
+ * the others submit their streams and sleep until the driver completes them
+ * or hands over the connection when its own stream is done.
+ */
+
+/* Size of the socket read buffer */
+#define FLB_HTTP2_CLIENT_READ_SIZE  16384
+
+/* Pending wake up of a waiting stream */
+#define FLB_HTTP2_CLIENT_WAKE_NONE    0
+#define FLB_HTTP2_CLIENT_WAKE_QUEUED  1   /* event injected in the loop     */
+#define FLB_HTTP2_CLIENT_WAKE_DIRECT  2   /* resumed by the driver instead  */
+
+struct flb_http_client;
+struct flb_connection;
+
+struct flb_http2_client_stream {
+    struct mk_event event;          /* wakes up the waiting coroutine    */
+    int32_t id;
+    int done;
+    int error;
+    int wake_pending;               /* FLB_HTTP2_CLIENT_WAKE_*           */
+    int headers_done;               /* final response headers received   */
+    size_t headers_len;             /* length of the headers in 'data'   */
+    size_t body_offset;             /* request body bytes already sent   */
+    struct flb_coro *coro;          /* coroutine waiting for the stream  */
+    struct flb_http_client *c;
+    struct mk_list _head;
+};
+
+struct flb_http2_client_session {
+    nghttp2_session *inner_session;
+    struct flb_connection *connection;
+
+    int users;                      /* callers holding the connection    */
+    int failed;                     /* connection error or GOAWAY        */
+    int write_blocked;              /* last write would block            */
+    int wake_direct;                /* some stream needs a direct resume */
+
+    struct flb_coro *driver;        /* coroutine doing the socket I/O    */
+    int event_saved;                /* 'event_backup' must be restored   */
+    struct mk_event event_backup;   /* connection event before driving   */
+
+    char *read_buf;
+    struct mk_list streams;         /* streams waiting for a response    */
+};
+
+int flb_http2_client_session_create(struct flb_connection *connection);
+void flb_http2_client_session_destroy(struct flb_http2_client_session *session);
+int flb_http2_client_session_available(struct flb_http2_client_session *session);
+
+int flb_http2_client_do(struct flb_http_client *c, size_t *bytes);
+
+#endif
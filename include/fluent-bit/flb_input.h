@@ -69,6 +69,14 @@
                                      * private key and certificate are required.
                                      */
 
+/*
+ * Input queue: number of slots of the engine input queue shared by the
+ * threaded inputs and the number of entries a single instance can have in
+ * flight, so a busy input cannot starve the others.
+ */
+#define FLB_INPUT_QUEUE_SIZE          16384
+#define FLB_INPUT_QUEUE_INSTANCE_MAX   1024
+
 /* Input status */
 #define FLB_INPUT_RUNNING     1
 #define FLB_INPUT_PAUSED      0
@@ -297,11 +305,16 @@ struct flb_input_instance {
     struct flb_input_thread_instance *thi;
 
     /*
-     * ring buffer: the ring buffer is used by the instance if is running
-     * in threaded mode; so when registering a msgpack buffer this happens
-     * in the ring buffer.
+     * input queue: when running in threaded mode the msgpack buffers are
+     * published in the engine input queue (config->input_queue).
+     * 'queue_depth' is the number of entries in flight for this instance,
+     * 'queue_stalls' the number of times a producer had to wait for room and
+     * 'queue_pending' keeps the entries received while the instance is
+     * paused (only accessed from the engine thread).
      */
-    struct flb_ring_buffer *rb;
+    uint64_t queue_depth;
+    uint64_t queue_stalls;
+    struct mk_list queue_pending;
 
     /* List of upstreams */
     struct mk_list upstreams;
@@ -343,6 +356,10 @@ struct flb_input_instance {
     /* total bytes used by chunks in a busy state */
     struct cmt_gauge   *cmt_storage_chunks_busy_bytes;
 
+    /* input queue metrics (threaded mode) */
+    struct cmt_gauge   *cmt_queue_depth;
+    struct cmt_counter *cmt_queue_stalls;
+
     /* memory ring buffer (memrb) metrics */
     struct cmt_counter *cmt_memrb_dropped_chunks;
     struct cmt_counter *cmt_memrb_dropped_bytes;
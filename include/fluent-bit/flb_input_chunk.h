@@ -51,12 +51,27 @@
 #define FLB_INPUT_CHUNK_TYPE_METRICS   1
 #define FLB_INPUT_CHUNK_TYPE_TRACES    2
 
+/*
+ * Metadata header flags (m[3]). When FLB_INPUT_CHUNK_FLAG_STATS is set, a
+ * fixed size stats block is stored between the header and the tag:
+ *
+ *   [0..3]   number of records (uint32, big endian)
+ *   [4..11]  first append time in nanoseconds (uint64, big endian)
+ *   [12..19] last append time in nanoseconds (uint64, big endian)
+ *
+ * The block is only written when storage.metadata_stats is enabled, chunks
+ * carrying it can't be read by versions that expect m[3] to be zero.
+ */
+#define FLB_INPUT_CHUNK_FLAG_STATS     0x01
+#define FLB_INPUT_CHUNK_META_STATS     20
+
 #ifdef FLB_HAVE_CHUNK_TRACE
 #define FLB_INPUT_CHUNK_HAS_TRACE     1 << 31
 #endif /* FLB_HAVE_CHUNK_TRACE */
 
 /* Max length for Tag */
-#define FLB_INPUT_CHUNK_TAG_MAX        (65535 - FLB_INPUT_CHUNK_META_HEADER)
+#define FLB_INPUT_CHUNK_TAG_MAX        (65535 - FLB_INPUT_CHUNK_META_HEADER - \
+                                        FLB_INPUT_CHUNK_META_STATS)
 
 struct flb_input_chunk {
     int  event_type;                 /* chunk type: logs, metrics or traces */
@@ -64,10 +79,11 @@ struct flb_input_chunk {
     int  busy;                       /* buffer is being flushed  */
     int  fs_backlog;                 /* chunk originated from fs backlog */
     int  sp_done;                    /* sp already processed this chunk */
-#ifdef FLB_HAVE_METRICS
     int  total_records;              /* total records in the chunk */
     int  added_records;              /* recently added records */
-#endif
+    int  meta_stats;                 /* metadata holds a stats block */
+    uint64_t first_append_ts;        /* time of the first append (ns) */
+    uint64_t last_append_ts;         /* time of the last append (ns) */
     void *chunk;                    /* context of struct cio_chunk */
     off_t stream_off;               /* stream offset */
     msgpack_packer mp_pck;          /* msgpack packer */
@@ -76,8 +92,7 @@ struct flb_input_chunk {
 #ifdef FLB_HAVE_CHUNK_TRACE
     struct flb_chunk_trace *trace;
 #endif /* FLB_HAVE_CHUNK_TRACE */
-    uint64_t routes_mask
-        [FLB_ROUTES_MASK_ELEMENTS]; /* track the output plugins the chunk routes to */
+    flb_route_mask_element *routes_mask; /* track the output plugins the chunk routes to */
     struct mk_list _head;
 };
 
@@ -107,9 +122,11 @@ int flb_input_chunk_get_event_type(struct flb_input_chunk *ic);
 
 int flb_input_chunk_get_tag(struct flb_input_chunk *ic,
                             const char **tag_buf, int *tag_len);
+int flb_input_chunk_get_stats(struct flb_input_chunk *ic, size_t *records,
+                              uint64_t *first_ts, uint64_t *last_ts);
 
-void flb_input_chunk_ring_buffer_cleanup(struct flb_input_instance *ins);
-void flb_input_chunk_ring_buffer_collector(struct flb_config *ctx, void *data);
+void flb_input_chunk_queue_cleanup(struct flb_input_instance *ins);
+void flb_input_chunk_queue_collector(struct flb_config *ctx, void *data);
 ssize_t flb_input_chunk_get_size(struct flb_input_chunk *ic);
 size_t flb_input_chunk_set_limits(struct flb_input_instance *in);
 size_t flb_input_chunk_total_size(struct flb_input_instance *in);
@@ -25,6 +25,12 @@
 #include <fluent-bit/flb_info.h>
 #include <fluent-bit/flb_coro.h>
 
+#ifdef FLB_SYSTEM_WINDOWS
+#include <msgpack.h>      /* struct iovec */
+#else
+#include <sys/uio.h>
+#endif
+
 /* Coroutine status 'flb_coro.status' */
 #define FLB_IO_CONNECT     0  /* thread issue a connection request */
 #define FLB_IO_WRITE       1  /* thread wants to write() data      */
@@ -39,6 +45,12 @@
 /* Other features */
 #define FLB_IO_IPV6       32  /* network I/O uses IPv6                  */
 
+/* Max number of buffers handled by a single writev(2) call */
+#define FLB_IO_IOV_MAX    64
+
+/* Small buffers of a TLS vectored write are gathered in records of this size */
+#define FLB_IO_TLS_GATHER_SIZE  16384
+
 struct flb_connection;
 
 int flb_io_net_accept(struct flb_connection *connection,
@@ -50,10 +62,16 @@ int flb_io_net_connect(struct flb_connection *u_conn,
 int flb_io_net_write(struct flb_connection *connection, const void *data,
                      size_t len, size_t *out_len);
 
+int flb_io_net_writev(struct flb_connection *connection,
+                      const struct iovec *iov, int iovcnt, size_t *out_len);
+
 ssize_t flb_io_net_read(struct flb_connection *connection, void *buf, size_t len);
 
 int flb_io_fd_write(int fd, const void *data, size_t len, size_t *out_len);
 
+int flb_io_fd_writev(int fd, const struct iovec *iov, int iovcnt,
+                     size_t *out_len);
+
 ssize_t flb_io_fd_read(int fd, void *buf, size_t len);
 
 #endif
@@ -0,0 +1,105 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef FLB_LINE_SPLIT_H
+#define FLB_LINE_SPLIT_H
+
+#include <stddef.h>
+
+/*
+ * Line splitter: finds the position of every separator byte in a buffer in
+ * a single pass, using SIMD comparisons when available. Up to two separator
+ * bytes are supported (e.g. '\n' and '\0' for syslog).
+ *
+ * The positions are returned in batches of FLB_LINE_SPLIT_BATCH so the
+ * buffer is scanned once no matter how short the lines are:
+ *
+ *     flb_line_split_init(&ls, buf, len, '\n', '\n');
+ *     while ((p = flb_line_split_next(&ls))) {
+ *         ... line goes from the previous separator up to 'p' ...
+ *     }
+ */
+
+#define FLB_LINE_SPLIT_BATCH    64
+
+struct flb_line_split {
+    const char *buf;
+    size_t len;
+    size_t pos;                         /* next byte to scan        */
+    char sep_a;
+    char sep_b;
+    int count;                          /* positions in 'found'     */
+    int index;                          /* next position to return  */
+    size_t found[FLB_LINE_SPLIT_BATCH];
+};
+
+/*
+ * Store in 'out' the offsets of up to 'max' bytes equal to 'sep_a' or
+ * 'sep_b', 'next' is set to the offset where the scan must continue.
+ * Returns the number of offsets found.
+ */
+int flb_line_split_scan(const char *buf, size_t len, char sep_a, char sep_b,
+                        size_t *out, int max, size_t *next);
+
+static inline void flb_line_split_init(struct flb_line_split *ls,
+                                       const char *buf, size_t len,
+                                       char sep_a, char sep_b)
+{
+    ls->buf = buf;
+    ls->len = len;
+    ls->pos = 0;
+    ls->sep_a = sep_a;
+    ls->sep_b = sep_b;
+    ls->count = 0;
+    ls->index = 0;
+}
+
+/* Returns a pointer to the next separator or NULL if there are no more */
+static inline const char *flb_line_split_next(struct flb_line_split *ls)
+{
+    int i;
+    size_t next;
+
+    if (ls->index == ls->count) {
+        if (ls->pos >= ls->len) {
+            return NULL;
+        }
+
+        ls->count = flb_line_split_scan(ls->buf + ls->pos, ls->len - ls->pos,
+                                        ls->sep_a, ls->sep_b,
+                                        ls->found, FLB_LINE_SPLIT_BATCH,
+                                        &next);
+
+        /* make the offsets absolute */
+        for (i = 0; i < ls->count; i++) {
+            ls->found[i] += ls->pos;
+        }
+        ls->index = 0;
+        ls->pos += next;
+
+        if (ls->count == 0) {
+            return NULL;
+        }
+    }
+
+    return ls->buf + ls->found[ls->index++];
+}
+
+#endif
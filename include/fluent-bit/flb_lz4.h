@@ -0,0 +1,50 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef FLB_LZ4_H
+#define FLB_LZ4_H
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_macros.h>
+
+#include <stddef.h>
+
+/* Size of the blocks generated by the compressor */
+#define FLB_LZ4_BLOCK_SIZE               (64 * 1024)
+
+struct flb_decompression_context;
+
+/*
+ * one-shot frame compression, max_size limits the decompressed data (zero
+ * means no limit)
+ */
+int flb_lz4_compress(void *in_data, size_t in_len,
+                     void **out_data, size_t *out_len);
+int flb_lz4_uncompress(void *in_data, size_t in_len,
+                       void **out_data, size_t *out_len,
+                       size_t max_size);
+
+/* streaming decompression (flb_decompression_context backend) */
+void *flb_lz4_decompression_context_create();
+void flb_lz4_decompression_context_destroy(void *context);
+
+int flb_lz4_decompressor_dispatch(struct flb_decompression_context *context,
+                                  void *out_data, size_t *out_size);
+
+#endif
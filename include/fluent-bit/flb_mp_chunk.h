@@ -22,6 +22,7 @@
 
 #include <fluent-bit/flb_info.h>
 #include <fluent-bit/flb_log_event.h>
+#include <fluent-bit/flb_arena.h>
 #include <cfl/cfl.h>
 
 #define FLB_MP_CHUNK_RECORD_ERROR -1  /* Error while retrieving content */
@@ -33,6 +34,7 @@ struct flb_mp_chunk_record {
     struct flb_log_event event;
     struct cfl_object *cobj_metadata;
     struct cfl_object *cobj_record;
+    struct flb_arena *arena;         /* arena owning the record, if any */
     struct cfl_list _head;
 };
 
@@ -43,6 +45,9 @@ struct flb_mp_chunk_cobj {
 
     struct flb_mp_chunk_record *record_pos;
     struct cfl_list records;
+
+    /* if set, records are allocated from this arena */
+    struct flb_arena *arena;
 };
 
 
@@ -55,6 +60,9 @@ int flb_mp_chunk_cobj_record_next(struct flb_mp_chunk_cobj *chunk_cobj,
 
 struct flb_mp_chunk_cobj *flb_mp_chunk_cobj_create(struct flb_log_event_encoder *log_encoder,
                                                    struct flb_log_event_decoder *log_decoder);
+struct flb_mp_chunk_cobj *flb_mp_chunk_cobj_create_with_arena(struct flb_log_event_encoder *log_encoder,
+                                                              struct flb_log_event_decoder *log_decoder,
+                                                              struct flb_arena *arena);
 int flb_mp_chunk_cobj_destroy(struct flb_mp_chunk_cobj *chunk_cobj);
 
 int flb_mp_chunk_cobj_encode(struct flb_mp_chunk_cobj *chunk_cobj, char **out_buf, size_t *out_size);
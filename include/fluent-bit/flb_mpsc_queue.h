@@ -0,0 +1,84 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#ifndef FLB_MPSC_QUEUE_H
+#define FLB_MPSC_QUEUE_H
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_pipe.h>
+
+#include <stdint.h>
+
+/*
+ * Bounded lock-free multi-producer / single-consumer queue of pointers.
+ *
+ * Producers reserve a slot with a compare-and-swap on 'head', every slot
+ * carries a sequence number that tells whether it's free, published or
+ * still being written. The consumer owns 'tail' and doesn't need atomic
+ * read-modify-write operations at all.
+ *
+ * Wakeups are coalesced: a producer only writes to the signaling channel
+ * (an eventfd when available) if no other wakeup is pending, so the
+ * consumer can drain many entries per wakeup.
+ */
+
+#define FLB_MPSC_QUEUE_CACHE_LINE  64
+
+struct flb_mpsc_queue_slot {
+    uint64_t seq;                     /* slot sequence number */
+    void *data;                       /* published pointer */
+};
+
+struct flb_mpsc_queue {
+    uint64_t size;                    /* number of slots, power of two */
+    uint64_t mask;                    /* size - 1 */
+    struct flb_mpsc_queue_slot *slots;
+
+    void *event_loop;                 /* event loop signaled by producers */
+    void *signal_event;               /* event loop entry for the signals */
+    flb_pipefd_t signal_channels[2];  /* eventfd (same fd twice) or pipe */
+
+    /* producers side */
+    char _pad0[FLB_MPSC_QUEUE_CACHE_LINE];
+    uint64_t head;                    /* next slot to be reserved */
+    uint64_t signal_pending;          /* a wakeup is on its way */
+
+    /* consumer side */
+    char _pad1[FLB_MPSC_QUEUE_CACHE_LINE];
+    uint64_t tail;                    /* next slot to be consumed */
+};
+
+struct flb_mpsc_queue *flb_mpsc_queue_create(uint64_t size);
+void flb_mpsc_queue_destroy(struct flb_mpsc_queue *queue);
+
+int flb_mpsc_queue_add_event_loop(struct flb_mpsc_queue *queue, void *evl,
+                                  int event_type);
+
+/* producers */
+int flb_mpsc_queue_push(struct flb_mpsc_queue *queue, void *data);
+void flb_mpsc_queue_signal(struct flb_mpsc_queue *queue);
+
+/* consumer */
+void *flb_mpsc_queue_pop(struct flb_mpsc_queue *queue);
+void flb_mpsc_queue_signal_drain(struct flb_mpsc_queue *queue);
+
+uint64_t flb_mpsc_queue_depth(struct flb_mpsc_queue *queue);
+
+#endif
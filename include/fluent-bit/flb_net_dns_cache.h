@@ -0,0 +1,107 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef FLB_NET_DNS_CACHE_H
+#define FLB_NET_DNS_CACHE_H
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_pthread.h>
+#include <monkey/mk_core.h>
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * DNS cache: the results of the asynchronous resolver are shared by every
+ * upstream and worker thread until their TTL expires. Lookups that end with
+ * 'not found' are cached as negative entries. Every hit rotates the returned
+ * list of addresses so connections are spread across all the records.
+ *
+ * If 'dns.cache.stale_ttl' is set, an expired entry is still served during
+ * that window: the first caller resolves the name again while the others
+ * keep using the old addresses, which are also used if the lookup fails.
+ */
+
+#define FLB_NET_DNS_CACHE_MAX_ENTRIES    1024
+
+/* lookup results */
+#define FLB_NET_DNS_CACHE_MISS           0
+#define FLB_NET_DNS_CACHE_HIT            1
+#define FLB_NET_DNS_CACHE_STALE          2
+#define FLB_NET_DNS_CACHE_NEGATIVE       3
+
+/* resolution latency histogram buckets, upper bounds in seconds */
+#define FLB_NET_DNS_CACHE_LATENCY_BUCKETS   8
+#define FLB_NET_DNS_CACHE_LATENCY_BOUNDS    0.001, 0.005, 0.01, 0.05, \
+                                            0.1, 0.5, 1.0, 5.0
+
+struct cmt;
+struct addrinfo;
+
+struct flb_net_dns_cache_entry {
+    char *key;                      /* host:port                          */
+    int status;                     /* c-ares error of negative entries   */
+    int count;                      /* number of addresses                */
+    unsigned int next;              /* round robin index                  */
+    int refreshing;                 /* a caller is resolving it again     */
+    time_t expires;
+    struct addrinfo *addrs;
+    struct mk_list _head;
+};
+
+struct flb_net_dns_cache {
+    int max_ttl;
+    int negative_ttl;
+    int stale_ttl;
+
+    int entry_count;
+    struct mk_list entries;
+    pthread_mutex_t lock;
+
+    /* counters */
+    uint64_t hits;
+    uint64_t stale_hits;
+    uint64_t negative_hits;
+    uint64_t misses;
+
+    /* resolution latency */
+    uint64_t latency_count;
+    double latency_sum;
+    uint64_t latency_buckets[FLB_NET_DNS_CACHE_LATENCY_BUCKETS + 1];
+};
+
+struct flb_net_dns_cache *flb_net_dns_cache_create(int max_ttl, int negative_ttl,
+                                                   int stale_ttl);
+void flb_net_dns_cache_destroy(struct flb_net_dns_cache *cache);
+
+int flb_net_dns_cache_lookup(struct flb_net_dns_cache *cache,
+                             const char *host, const char *port,
+                             struct addrinfo **res, int *status);
+void flb_net_dns_cache_store(struct flb_net_dns_cache *cache,
+                             const char *host, const char *port,
+                             int status, struct addrinfo *res, int ttl);
+int flb_net_dns_cache_fallback(struct flb_net_dns_cache *cache,
+                               const char *host, const char *port,
+                               struct addrinfo **res);
+void flb_net_dns_cache_observe(struct flb_net_dns_cache *cache, uint64_t ns);
+
+int flb_net_dns_cache_metrics(struct flb_net_dns_cache *cache, struct cmt *cmt,
+                              uint64_t ts, char *hostname);
+
+#endif
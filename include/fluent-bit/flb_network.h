@@ -85,6 +85,15 @@ struct flb_net_setup {
 
     /* maximum number of allowed active TCP connections */
     int max_worker_connections;
+
+    /* minimum number of idle keepalive connections kept open per worker */
+    int keepalive_min_idle;
+
+    /* multiplex HTTP requests over HTTP/2 connections (h2 or h2c) */
+    int http2;
+
+    /* maximum number of concurrent HTTP/2 streams per connection */
+    int http2_max_streams;
 };
 
 /* Defines a host service and it properties */
@@ -107,6 +116,7 @@ struct flb_dns_lookup_context {
     int                          ares_socket_type;
     void                        *ares_channel;
     int                         *result_code;
+    int                         *result_ttl;                      /* lowest TTL of the records */
     struct mk_event_loop        *event_loop;
     struct flb_coro             *coroutine;
     struct flb_sched_timer      *udp_timer;
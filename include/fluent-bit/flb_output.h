@@ -52,6 +52,7 @@
 #include <cmetrics/cmetrics.h>
 #include <cmetrics/cmt_gauge.h>
 #include <cmetrics/cmt_counter.h>
+#include <cmetrics/cmt_histogram.h>
 #include <cmetrics/cmt_decode_msgpack.h>
 #include <cmetrics/cmt_encode_msgpack.h>
 
@@ -371,6 +372,8 @@ struct flb_output_instance {
     struct cmt_gauge   *cmt_upstream_total_connections;
     /* m: output_upstream_busy_connections */
     struct cmt_gauge   *cmt_upstream_busy_connections;
+    /* m: output_upstream_connection_wait_seconds */
+    struct cmt_histogram *cmt_upstream_wait_time;
     /* m: output_chunk_available_capacity_percent */
     struct cmt_gauge   *cmt_chunk_available_capacity_percent;
 
@@ -35,6 +35,10 @@
 #define FLB_PACK_JSON_STRING        JSMN_STRING
 #define FLB_PACK_JSON_PRIMITIVE     JSMN_PRIMITIVE
 
+/* JSON packers */
+#define FLB_PACK_JSON_BACKEND_JSMN  0   /* jsmn tokenizer + tokens walk */
+#define FLB_PACK_JSON_BACKEND_SCAN  1   /* single pass scanner (FLB_SIMD) */
+
 /* Date formats */
 #define FLB_PACK_JSON_DATE_DOUBLE                0
 #define FLB_PACK_JSON_DATE_ISO8601               1
@@ -88,6 +92,7 @@ int flb_pack_json_state(const char *js, size_t len,
                         char **buffer, int *size,
                         struct flb_pack_state *state);
 int flb_pack_json_valid(const char *json, size_t len);
+int flb_pack_json_backend_set(int backend);
 
 flb_sds_t flb_pack_msgpack_to_json_format(const char *data, uint64_t bytes,
                                           int json_format, int date_format,
@@ -99,6 +104,7 @@ void flb_pack_print(const char *data, size_t bytes);
 int flb_msgpack_to_json(char *json_str, size_t str_len,
                         const msgpack_object *obj);
 char* flb_msgpack_to_json_str(size_t size, const msgpack_object *obj);
+int flb_msgpack_to_json_sds(flb_sds_t *buf, const msgpack_object *obj);
 flb_sds_t flb_msgpack_raw_to_json_sds(const void *in_buf, size_t in_size);
 
 int flb_pack_time_now(msgpack_packer *pck);
@@ -38,6 +38,14 @@ struct flb_parser_types {
     int type;
 };
 
+/* Regex named group lookups, resolved when the parser is created */
+struct flb_parser_field {
+    struct flb_parser_types *type;  /* type casting rule, or NULL */
+    int time_key;                   /* group holds the time field */
+};
+
+struct flb_parser_time_cache;
+
 struct flb_parser {
     /* configuration */
     int type;             /* parser type */
@@ -63,7 +71,11 @@ struct flb_parser {
     int time_with_year;   /* do time_fmt consider a year (%Y) ? */
     char *time_fmt_year;
     int time_with_tz;     /* do time_fmt consider a timezone ?  */
+    int time_fast;        /* time formats handled by the built-in decoder */
+    struct flb_parser_time_cache *time_cache; /* last timestamp parsed */
     struct flb_regex *regex;
+    struct flb_parser_field *fields;  /* one entry per regex group */
+    int native;           /* built-in matcher for a bundled regex */
     struct mk_list _head;
 };
 
@@ -122,4 +134,12 @@ int flb_parser_typecast(const char *key, int key_len,
                         msgpack_packer *pck,
                         struct flb_parser_types *types,
                         int types_len);
+
+/* Built-in matchers for the bundled regex parsers */
+#define FLB_PARSER_NATIVE_GROUPS     16
+#define FLB_PARSER_NATIVE_FALLBACK   -2
+
+int flb_parser_native_lookup(struct flb_parser *parser);
+int flb_parser_native_do(int id, const char *buf, size_t length,
+                         ptrdiff_t *beg, ptrdiff_t *end);
 #endif
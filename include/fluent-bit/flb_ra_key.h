@@ -27,6 +27,8 @@
 #include <monkey/mk_core.h>
 #include <msgpack.h>
 
+#include <stdint.h>
+
 enum ra_types {
     FLB_RA_BOOL = 0,
     FLB_RA_INT,
@@ -50,6 +52,24 @@ struct flb_ra_value {
     ra_val val;
 };
 
+/* Entries of a map resolved by a record accessor key */
+struct flb_ra_kv {
+    msgpack_object *start_key;   /* key of the first level */
+    msgpack_object *key;
+    msgpack_object *val;
+};
+
+#define FLB_RA_KEY_SET_MAX   32
+#define FLB_RA_KEY_SET_LENS  64
+
+/* Keys resolved together with a single walk of the map */
+struct flb_ra_key_set {
+    int count;
+    struct flb_ra_key *keys[FLB_RA_KEY_SET_MAX];
+    uint32_t lens[FLB_RA_KEY_SET_LENS];  /* keys by name length */
+    uint32_t lens_long;                  /* keys with longer names */
+};
+
 struct flb_ra_value *flb_ra_key_to_value(flb_sds_t ckey,
                                          msgpack_object map,
                                          struct mk_list *subkeys);
@@ -60,6 +80,11 @@ int flb_ra_key_value_get(flb_sds_t ckey, msgpack_object map,
                          msgpack_object **start_key,
                          msgpack_object **out_key, msgpack_object **out_val);
 
+void flb_ra_key_set_init(struct flb_ra_key_set *set);
+int flb_ra_key_set_add(struct flb_ra_key_set *set, struct flb_ra_key *key);
+int flb_ra_key_set_get(struct flb_ra_key_set *set, msgpack_object map,
+                       struct flb_ra_kv *out);
+
 int flb_ra_key_strcmp(flb_sds_t ckey, msgpack_object map,
                       struct mk_list *subkeys, char *str, int len);
 int flb_ra_key_regex_match(flb_sds_t ckey, msgpack_object map,
@@ -24,6 +24,7 @@
 #include <fluent-bit/flb_regex.h>
 #include <fluent-bit/flb_sds.h>
 #include <fluent-bit/flb_sds_list.h>
+#include <fluent-bit/flb_ra_key.h>
 #include <monkey/mk_core.h>
 #include <msgpack.h>
 
@@ -55,6 +56,8 @@ int flb_ra_regex_match(struct flb_record_accessor *ra, msgpack_object map,
 int flb_ra_get_kv_pair(struct flb_record_accessor *ra, msgpack_object map,
                        msgpack_object **start_key,
                        msgpack_object **out_key, msgpack_object **out_val);
+int flb_ra_key_set_add_ra(struct flb_ra_key_set *set,
+                          struct flb_record_accessor *ra);
 
 struct flb_ra_value *flb_ra_get_value_object(struct flb_record_accessor *ra,
                                              msgpack_object map);
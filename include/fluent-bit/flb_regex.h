@@ -29,8 +29,24 @@
 #include <stdlib.h>
 #include <stddef.h>
 
+/* Named capture group, resolved once when the pattern is compiled */
+struct flb_regex_group {
+    char *name;
+    int name_len;
+    int num;                 /* backreference number */
+};
+
 struct flb_regex {
     void *regex;
+
+    /* named groups, in the order reported by the engine */
+    struct flb_regex_group *groups;
+    int groups_len;
+
+    /* literal any match must contain, lines without it are skipped */
+    char *literal;
+    int literal_len;
+    int literal_exact;       /* the pattern is only the literal */
 };
 
 struct flb_regex_search {
@@ -55,6 +71,11 @@ int flb_regex_parse(struct flb_regex *r, struct flb_regex_search *result,
                                       const char *, size_t,  /* value */
                                       void *),                  /* caller data */
                     void *data);
+int flb_regex_parse_groups(struct flb_regex *r, struct flb_regex_search *result,
+                           void (*cb_group) (int,                   /* group index */
+                                             const char *, size_t,  /* value */
+                                             void *),               /* caller data */
+                           void *data);
 int flb_regex_destroy(struct flb_regex *r);
 int flb_regex_results_get(struct flb_regex_search *result, int i,
                           ptrdiff_t *start, ptrdiff_t *end);
@@ -23,12 +23,76 @@
 #include <fluent-bit/flb_info.h>
 #include <fluent-bit/flb_input.h>
 #include <fluent-bit/flb_output.h>
+#include <fluent-bit/flb_sds.h>
+#include <fluent-bit/flb_hash_table.h>
+#include <fluent-bit/flb_routes_mask.h>
+
+/* Max number of distinct tags cached by the routing table */
+#define FLB_ROUTER_CACHE_SIZE        1024
+
+/* Compiled match rule types */
+#define FLB_ROUTER_RULE_NONE         0   /* no pattern, never matches      */
+#define FLB_ROUTER_RULE_ALL          1   /* '*'                            */
+#define FLB_ROUTER_RULE_EXACT        2   /* 'app.log'                      */
+#define FLB_ROUTER_RULE_PREFIX       3   /* 'app.*'                        */
+#define FLB_ROUTER_RULE_SUFFIX       4   /* '*.log'                        */
+#define FLB_ROUTER_RULE_WILDCARD     5   /* any other wildcard pattern     */
 
 struct flb_router_path {
     struct flb_output_instance *ins;
     struct mk_list _head;
 };
 
+/*
+ * A match rule (Match / Match_Regex) pre-processed at startup so the common
+ * patterns can be resolved with a single comparison instead of the recursive
+ * wildcard matcher.
+ */
+struct flb_router_rule {
+    int type;
+    const char *match;             /* original pattern                    */
+    const char *literal;           /* literal part of the pattern         */
+    int literal_len;
+    void *match_regex;             /* struct flb_regex (Match_Regex)      */
+};
+
+/*
+ * The resolved route for a given Tag: the ordered list of filters that must
+ * process the records and the mask of the outputs they are routed to.
+ */
+struct flb_router_route {
+    flb_sds_t tag;
+    int users;                     /* active references (not evictable)   */
+    int cached;                    /* linked into the routing table?      */
+    int has_routes;
+    flb_route_mask_element *routes_mask;
+    int filters_size;
+    struct flb_filter_instance **filters;
+    struct mk_list _head;          /* link to flb_router_table->routes    */
+};
+
+struct flb_router_table {
+    struct flb_config *config;
+
+    /* compiled rules */
+    int filters_size;
+    struct flb_filter_instance **filters;
+    struct flb_router_rule *filter_rules;
+    int outputs_size;
+    struct flb_output_instance **outputs;
+    struct flb_router_rule *output_rules;
+
+    /* cache of resolved routes by Tag */
+    int routes_max;
+    int routes_count;
+    struct flb_hash_table *routes_ht;
+    struct mk_list routes;         /* insertion order, used for eviction  */
+
+    /* stats */
+    uint64_t hits;
+    uint64_t misses;
+};
+
 static inline int flb_router_match_type(int in_event_type,
                                         struct flb_output_instance *o_ins)
 {
@@ -57,4 +121,19 @@ int flb_router_match(const char *tag, int tag_len,
                      const char *match, void *match_regex);
 int flb_router_io_set(struct flb_config *config);
 void flb_router_exit(struct flb_config *config);
+
+/* compiled rules */
+void flb_router_rule_compile(struct flb_router_rule *rule,
+                             const char *match, void *match_regex);
+int flb_router_rule_match(struct flb_router_rule *rule,
+                          const char *tag, int tag_len);
+
+/* routing table */
+struct flb_router_table *flb_router_table_create(struct flb_config *config,
+                                                 int routes_max);
+void flb_router_table_destroy(struct flb_router_table *table);
+struct flb_router_route *flb_router_route_get(struct flb_router_table *table,
+                                              const char *tag, int tag_len);
+void flb_router_route_put(struct flb_router_table *table,
+                          struct flb_router_route *route);
 #endif
@@ -24,15 +24,21 @@
 #include <fluent-bit/flb_pipe.h>
 #include <fluent-bit/flb_task.h>
 #include <fluent-bit/flb_output.h>
+#include <fluent-bit/flb_timer_wheel.h>
 
 /* Sched contstants */
 #define FLB_SCHED_CAP            2000
 #define FLB_SCHED_BASE           5
-#define FLB_SCHED_REQUEST_FRAME  10
+
+/*
+ * Timer wheel resolution in milliseconds, callback timers that are not a
+ * multiple of it get their own timer instead.
+ */
+#define FLB_SCHED_WHEEL_TICK     100
 
 /* Timer types */
-#define FLB_SCHED_TIMER_REQUEST     1  /* timerfd             */
-#define FLB_SCHED_TIMER_FRAME       2  /* timer frame checker */
+#define FLB_SCHED_TIMER_REQUEST     1  /* retry request             */
+#define FLB_SCHED_TIMER_FRAME       2  /* timer wheel frame timer   */
 #define FLB_SCHED_TIMER_CB_ONESHOT  3  /* one-shot callback timer  */
 #define FLB_SCHED_TIMER_CB_PERM     4  /* permanent callback timer */
 
@@ -56,12 +62,18 @@ struct flb_sched_timer {
     /*
      * Custom timer specific data:
      *
-     * - timer_fd = timer file descriptor
+     * - timer_fd = timer file descriptor (frame timer and callback timers
+     *              kept off the wheel)
+     * - ms       = interval in milliseconds for callback timers
      * - cb       = callback to be triggerd upon expiration
      */
     int timer_fd;
+    int ms;
     void (*cb)(struct flb_config *, void *);
 
+    /* link to flb_sched->wheel */
+    struct flb_timer_wheel_entry wheel_entry;
+
     /* Parent context */
     struct flb_config *config;
 
@@ -71,12 +83,11 @@ struct flb_sched_timer {
 
 /* Struct representing a FLB_SCHED_TIMER_REQUEST */
 struct flb_sched_request {
-    flb_pipefd_t fd;
     time_t created;
     time_t timeout;
     void *data;
     struct flb_sched_timer *timer; /* parent timer linked from */
-    struct mk_list _head;          /* link to flb_sched->[requests|wait] */
+    struct mk_list _head;          /* link to flb_sched->requests */
 };
 
 /* Scheduler context */
@@ -88,20 +99,11 @@ struct flb_sched {
      * The scheduler is used to issue 'retries' of flush requests when these
      * cannot be processed and the output plugins ask for a retry.
      *
-     * If a retry have not reached a limit and is allowed, it needs to be
-     * queued:
-     *
-     *  - For retries that will happen within the next 60 seconds, they are
-     *    placed in the 'requests' list and a timeout is registered with
-     *    the operating system (timerfd).
-     *
-     *  - For retries that will happen 'after' 60 seconds, they are queued
-     *    into the requests_wait' list. They stay there until their
-     *    flush time happens within the next 60 seconds, so they are moved
-     *    to the sched_requests list and a further timeout is created.
+     * If a retry have not reached a limit and is allowed, it's placed in the
+     * 'requests' list and its timer is armed into the timer wheel, no matter
+     * how far in the future it is.
      */
     struct mk_list requests;
-    struct mk_list requests_wait;
 
     /* Timers: list of timers for different purposes */
     struct mk_list timers;
@@ -112,8 +114,21 @@ struct flb_sched {
      */
     struct mk_list timers_drop;
 
-    /* Frame timer context */
-    flb_pipefd_t frame_fd;
+    /*
+     * Timer wheel: requests and callback timers are armed into the wheel, a
+     * single frame timer (frame_fd) fires when the next expiration is due
+     * and advances it. It's re-armed when timers are added or removed and
+     * stopped while the wheel is empty, so an idle event loop is not woken
+     * up.
+     */
+    struct flb_timer_wheel wheel;
+    uint64_t wheel_base;             /* time of tick zero (nanoseconds) */
+    uint64_t tick_lag;               /* delay of the last tick (nanoseconds) */
+    struct flb_sched_timer *frame;   /* frame timer context */
+    uint64_t frame_tick;             /* wheel tick the frame timer is armed for */
+    int frame_hold;                  /* don't re-arm while the wheel advances */
+    int frame_armed;                 /* the frame timer is armed */
+    flb_pipefd_t frame_fd;           /* frame timer file descriptor or -1 */
 
     struct mk_event_loop *evl;
     struct flb_config *config;
@@ -144,6 +159,9 @@ int flb_sched_timer_cleanup(struct flb_sched *sched);
 int flb_sched_retry_now(struct flb_config *config, 
                         struct flb_task_retry *retry);
 
+size_t flb_sched_timers_armed(struct flb_sched *sched);
+uint64_t flb_sched_tick_lag(struct flb_sched *sched);
+
 /* Sched context api for multithread environment */
 void flb_sched_ctx_init();
 struct flb_sched *flb_sched_ctx_get();
@@ -0,0 +1,140 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef FLB_SIMD_H
+#define FLB_SIMD_H
+
+#include <stdint.h>
+
+/*
+ * Minimal byte vector helpers. The instruction set is picked at build time
+ * from the compiler target: AVX2 (32 bytes) when built with -mavx2 or a
+ * -march that includes it, SSE2 (16 bytes) which is part of any x86_64
+ * (and SSE4.2) target, otherwise FLB_SIMD_NONE is defined and the callers
+ * must use their scalar code path.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FLB_SIMD_AVX2
+#define FLB_VECTOR8_SIZE    32
+typedef __m256i flb_vector8;
+#elif defined(__SSE2__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLB_SIMD_SSE2
+#define FLB_VECTOR8_SIZE    16
+typedef __m128i flb_vector8;
+#else
+#define FLB_SIMD_NONE
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifndef FLB_SIMD_NONE
+
+/* Unaligned load of FLB_VECTOR8_SIZE bytes */
+static inline flb_vector8 flb_vector8_load(const char *s)
+{
+#ifdef FLB_SIMD_AVX2
+    return _mm256_loadu_si256((const __m256i *) s);
+#else
+    return _mm_loadu_si128((const __m128i *) s);
+#endif
+}
+
+/* Vector with every byte set to 'c' */
+static inline flb_vector8 flb_vector8_broadcast(char c)
+{
+#ifdef FLB_SIMD_AVX2
+    return _mm256_set1_epi8(c);
+#else
+    return _mm_set1_epi8(c);
+#endif
+}
+
+/* Bytewise equality, matching bytes are set to 0xff */
+static inline flb_vector8 flb_vector8_eq(flb_vector8 a, flb_vector8 b)
+{
+#ifdef FLB_SIMD_AVX2
+    return _mm256_cmpeq_epi8(a, b);
+#else
+    return _mm_cmpeq_epi8(a, b);
+#endif
+}
+
+/* Bytewise signed greater-than, bytes where 'a' > 'b' are set to 0xff */
+static inline flb_vector8 flb_vector8_gt(flb_vector8 a, flb_vector8 b)
+{
+#ifdef FLB_SIMD_AVX2
+    return _mm256_cmpgt_epi8(a, b);
+#else
+    return _mm_cmpgt_epi8(a, b);
+#endif
+}
+
+static inline flb_vector8 flb_vector8_or(flb_vector8 a, flb_vector8 b)
+{
+#ifdef FLB_SIMD_AVX2
+    return _mm256_or_si256(a, b);
+#else
+    return _mm_or_si128(a, b);
+#endif
+}
+
+/* One bit per byte, set when the most significant bit of the byte is set */
+static inline uint32_t flb_vector8_mask(flb_vector8 v)
+{
+#ifdef FLB_SIMD_AVX2
+    return (uint32_t) _mm256_movemask_epi8(v);
+#else
+    return (uint32_t) _mm_movemask_epi8(v);
+#endif
+}
+
+#endif /* !FLB_SIMD_NONE */
+
+/* Index of the highest bit set, 'v' must not be zero */
+static inline int flb_simd_msb(uint32_t v)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+
+    _BitScanReverse(&index, v);
+    return (int) index;
+#else
+    return 31 - __builtin_clz(v);
+#endif
+}
+
+/* Index of the lowest bit set, 'v' must not be zero */
+static inline int flb_simd_ctz(uint32_t v)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+
+    _BitScanForward(&index, v);
+    return (int) index;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+#endif
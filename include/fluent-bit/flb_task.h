@@ -84,9 +84,7 @@ struct flb_task {
     int users;                           /* number of users (threads) */
     struct flb_event_chunk *event_chunk; /* event chunk context       */
     void *ic;                            /* input chunk context       */
-#ifdef FLB_HAVE_METRICS
     int records;                         /* numbers of records in 'buf'   */
-#endif
     struct mk_list routes;               /* routes to dispatch data       */
     struct mk_list retries;              /* queued in-memory retries      */
     struct mk_list _head;                /* link to input_instance        */
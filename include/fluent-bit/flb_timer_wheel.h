@@ -0,0 +1,76 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef FLB_TIMER_WHEEL_H
+#define FLB_TIMER_WHEEL_H
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_macros.h>
+#include <monkey/mk_core/mk_list.h>
+
+#include <stdint.h>
+
+/*
+ * Hierarchical timing wheel: 4 levels of 64 slots each. Level 0 holds the
+ * entries expiring within the next 64 ticks, every upper level covers 64
+ * times the range of the previous one and its entries are cascaded down
+ * when the lower level wraps around.
+ *
+ * Insert and delete are O(1), advancing the wheel costs one slot per tick
+ * plus the cascaded entries.
+ */
+#define FLB_TIMER_WHEEL_LEVELS     4
+#define FLB_TIMER_WHEEL_SLOT_BITS  6
+#define FLB_TIMER_WHEEL_SLOTS      (1 << FLB_TIMER_WHEEL_SLOT_BITS)
+#define FLB_TIMER_WHEEL_SLOT_MASK  (FLB_TIMER_WHEEL_SLOTS - 1)
+
+/* Longest timeout that can be represented, longer ones are truncated */
+#define FLB_TIMER_WHEEL_MAX_TICKS  \
+    ((1ULL << (FLB_TIMER_WHEEL_LEVELS * FLB_TIMER_WHEEL_SLOT_BITS)) - 1)
+
+struct flb_timer_wheel_entry {
+    int armed;                   /* linked to the wheel ? */
+    uint64_t expires;            /* absolute expiration tick */
+    struct mk_list _head;        /* link to a wheel slot or expired list */
+};
+
+struct flb_timer_wheel {
+    uint64_t current;            /* next tick to be processed */
+    size_t armed;                /* number of armed entries */
+    struct mk_list slots[FLB_TIMER_WHEEL_LEVELS][FLB_TIMER_WHEEL_SLOTS];
+};
+
+void flb_timer_wheel_init(struct flb_timer_wheel *wheel);
+void flb_timer_wheel_entry_init(struct flb_timer_wheel_entry *entry);
+
+void flb_timer_wheel_add(struct flb_timer_wheel *wheel,
+                         struct flb_timer_wheel_entry *entry, uint64_t ticks);
+void flb_timer_wheel_del(struct flb_timer_wheel *wheel,
+                         struct flb_timer_wheel_entry *entry);
+
+int flb_timer_wheel_expire(struct flb_timer_wheel *wheel, uint64_t tick,
+                           struct mk_list *expired);
+int flb_timer_wheel_next(struct flb_timer_wheel *wheel, uint64_t *tick);
+
+static inline size_t flb_timer_wheel_armed(struct flb_timer_wheel *wheel)
+{
+    return wheel->armed;
+}
+
+#endif
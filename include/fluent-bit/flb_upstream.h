@@ -32,6 +32,7 @@
 
 #include <cmetrics/cmetrics.h>
 #include <cmetrics/cmt_gauge.h>
+#include <cmetrics/cmt_histogram.h>
 
 /*
  * Upstream creation FLAGS set by Fluent Bit sub-components
@@ -70,6 +71,8 @@ struct flb_upstream {
     struct cmt_gauge          *cmt_busy_connections;
     const char                *cmt_total_connections_label;
     const char                *cmt_busy_connections_label;
+    struct cmt_histogram      *cmt_wait_time;
+    const char                *cmt_wait_time_label;
 
     /*
      * If the connections will be in separate threads, this flag is
@@ -120,4 +123,11 @@ void flb_upstream_set_busy_connections_gauge(
         struct flb_upstream *stream,
         struct cmt_gauge *gauge_instance);
 
+void flb_upstream_set_wait_time_label(
+        struct flb_upstream *stream,
+        const char *label_value);
+void flb_upstream_set_wait_time_histogram(
+        struct flb_upstream *stream,
+        struct cmt_histogram *histogram_instance);
+
 #endif
@@ -22,6 +22,8 @@
 
 #include <fluent-bit/flb_info.h>
 
+struct flb_upstream_prewarm;
+
 struct flb_upstream_queue {
     /*
      * This field is a linked-list-head for upstream connections that
@@ -42,6 +44,12 @@ struct flb_upstream_queue {
      * to avoid any race condition with a late event.
      */
     struct mk_list destroy_queue;
+
+    /*
+     * Coroutine establishing connections in background to keep at least
+     * 'net.keepalive_min_idle' of them in the 'av_queue' list.
+     */
+    struct flb_upstream_prewarm *prewarm;
 };
 
 #endif
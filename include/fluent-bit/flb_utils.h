@@ -25,6 +25,9 @@
 #include <fluent-bit/flb_config.h>
 #include <fluent-bit/flb_sds.h>
 
+/* Worst case output of flb_utils_write_str_raw(): \u00XX for every byte */
+#define FLB_UTILS_WRITE_STR_MAX(len)   ((len) * 6)
+
 struct flb_split_entry {
     char *value;
     int len;
@@ -58,6 +61,7 @@ void flb_utils_bytes_to_human_readable_size(size_t bytes,
 int flb_utils_time_split(const char *time, int *sec, long *nsec);
 int flb_utils_write_str(char *buf, int *off, size_t size,
                         const char *str, size_t str_len);
+size_t flb_utils_write_str_raw(char *buf, const char *str, size_t str_len);
 int flb_utils_write_str_buf(const char *str, size_t str_len,
                             char **out, size_t *out_size);
 
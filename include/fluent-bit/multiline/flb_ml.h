@@ -75,6 +75,15 @@ struct flb_ml_rule {
 
     struct mk_list to_state_map;
 
+    /*
+     * 'to_state_map' compiled by flb_ml_rule_init(): the rules that can
+     * continue this one (start states excluded) in the map order, and a flag
+     * set if any of the mapped rules is a start state.
+     */
+    struct flb_ml_rule **next_rules;
+    int next_rules_count;
+    int next_start;
+
     /* regex content pattern */
     struct flb_regex *regex;
 
@@ -105,6 +114,8 @@ struct flb_ml_stream_group {
 
     msgpack_sbuffer mp_sbuf;    /* temporary msgpack buffer              */
     msgpack_packer mp_pck;      /* temporary msgpack packer              */
+    size_t mp_content_off;      /* key_content value range in 'mp_sbuf', */
+    size_t mp_content_end;      /* replaced by 'buf' on flush            */
     struct flb_time mp_time;    /* multiline time parsed from first line */
 
     struct mk_list _head;
@@ -191,6 +202,10 @@ struct flb_ml_parser {
      */
     struct mk_list regex_rules;
 
+    /* rules having a 'start_state', in definition order */
+    struct flb_ml_rule **start_rules;
+    int start_rules_count;
+
     /* Fluent Bit parent context */
     struct flb_config *config;
 
@@ -280,7 +295,8 @@ struct flb_ml {
 struct flb_ml *flb_ml_create(struct flb_config *ctx, char *name);
 int flb_ml_destroy(struct flb_ml *ml);
 
-int flb_ml_register_context(struct flb_ml_stream_group *group,
+int flb_ml_register_context(struct flb_ml_stream *mst,
+                            struct flb_ml_stream_group *group,
                             struct flb_time *tm, msgpack_object *map);
 
 int flb_ml_append_text(struct flb_ml *ml,
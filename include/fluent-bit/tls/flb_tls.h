@@ -78,6 +78,8 @@ struct flb_tls_backend {
     /* Session management */
     void *(*session_create) (struct flb_tls *, int);
     int (*session_destroy) (void *);
+    int (*session_alpn_set) (void *, const char *);
+    int (*session_alpn_get) (void *, char *, size_t);
 
     /* I/O */
     int (*net_read) (struct flb_tls_session *, void *, size_t);
@@ -121,6 +123,9 @@ struct mk_list *flb_tls_get_config_map(struct flb_config *config);
 
 int flb_tls_session_destroy(struct flb_tls_session *session);
 
+int flb_tls_session_get_alpn(struct flb_tls_session *session,
+                             char *buf, size_t size);
+
 int flb_tls_session_create(struct flb_tls *tls,
                            struct flb_connection *connection,
                            struct flb_coro *co);
@@ -38,10 +38,18 @@
 
 static void delete_rules(struct grep_ctx *ctx)
 {
+    int i;
     struct mk_list *tmp;
     struct mk_list *head;
     struct grep_rule *rule;
 
+    for (i = 0; i < ctx->keys.count; i++) {
+        flb_aho_corasick_destroy(ctx->key_list[i].ac);
+        ctx->key_list[i].ac = NULL;
+    }
+    flb_ra_key_set_init(&ctx->keys);
+    ctx->literals = 0;
+
     mk_list_foreach_safe(head, tmp, &ctx->rules) {
         rule = mk_list_entry(head, struct grep_rule, _head);
         flb_sds_destroy(rule->field);
@@ -86,6 +94,8 @@ static int set_rules(struct grep_ctx *ctx, struct flb_filter_instance *f_ins)
             flb_free(rule);
             continue;
         }
+        rule->key_id = -1;
+        rule->literal_id = -1;
 
         if (ctx->logical_op != GREP_LOGICAL_OP_LEGACY && first_rule != GREP_NO_RULE) {
             /* 'AND'/'OR' case */
@@ -163,19 +173,160 @@ static int set_rules(struct grep_ctx *ctx, struct flb_filter_instance *f_ins)
     return 0;
 }
 
+/*
+ * Group the rules by key: every key is resolved once per record, and when
+ * enough rules on the same key have a literal (the string any match has to
+ * contain), all of them are looked up with a single pass over the value.
+ * Rules without the literal in the value are not evaluated by the regex
+ * engine, and the ones made only of the literal don't need it either.
+ */
+static int compile_rules(struct grep_ctx *ctx)
+{
+    int i;
+    int id;
+    int count;
+    struct mk_list *head;
+    struct grep_key *key;
+    struct grep_rule *rule;
+
+    mk_list_foreach(head, &ctx->rules) {
+        rule = mk_list_entry(head, struct grep_rule, _head);
+
+        for (i = 0; i < ctx->keys.count; i++) {
+            if (strcmp(ctx->key_list[i].field, rule->field) == 0) {
+                break;
+            }
+        }
+
+        if (i < ctx->keys.count) {
+            rule->key_id = i;
+            continue;
+        }
+
+        /* keyless patterns or too many keys, the rule resolves its own */
+        id = flb_ra_key_set_add_ra(&ctx->keys, rule->ra);
+        if (id == -1) {
+            continue;
+        }
+        ctx->key_list[id].field = rule->field;
+        ctx->key_list[id].ac = NULL;
+        rule->key_id = id;
+    }
+
+    for (i = 0; i < ctx->keys.count; i++) {
+        key = &ctx->key_list[i];
+
+        count = 0;
+        mk_list_foreach(head, &ctx->rules) {
+            rule = mk_list_entry(head, struct grep_rule, _head);
+            if (rule->key_id == i && rule->regex->literal) {
+                count++;
+            }
+        }
+
+        /* a few literals are found faster by each regex prefilter */
+        if (count < GREP_KEY_LITERALS_MIN) {
+            continue;
+        }
+
+        key->ac = flb_aho_corasick_create();
+        if (!key->ac) {
+            return -1;
+        }
+        key->literal_base = ctx->literals;
+
+        mk_list_foreach(head, &ctx->rules) {
+            rule = mk_list_entry(head, struct grep_rule, _head);
+            if (rule->key_id != i || !rule->regex->literal) {
+                continue;
+            }
+
+            id = flb_aho_corasick_add(key->ac, rule->regex->literal,
+                                      rule->regex->literal_len);
+            if (id == -1) {
+                return -1;
+            }
+            rule->literal_id = key->literal_base + id;
+        }
+
+        if (flb_aho_corasick_build(key->ac) == -1) {
+            return -1;
+        }
+        ctx->literals += key->ac->patterns;
+
+        flb_plg_debug(ctx->ins, "%i rules on key '%s' use a single lookup",
+                      key->ac->patterns, key->field);
+    }
+
+    return 0;
+}
+
+/* Resolve the keys of the rules for a new record */
+static inline void grep_state_reset(struct grep_ctx *ctx,
+                                    struct grep_state *state,
+                                    msgpack_object map)
+{
+    if (ctx->keys.count > 0) {
+        flb_ra_key_set_get(&ctx->keys, map, state->kv);
+        memset(state->scanned, 0, ctx->keys.count);
+    }
+}
+
+/* Returns FLB_TRUE if the rule regex matches the record */
+static inline int grep_rule_match(struct grep_ctx *ctx,
+                                  struct grep_state *state,
+                                  struct grep_rule *rule,
+                                  msgpack_object map)
+{
+    msgpack_object *val;
+    struct grep_key *key;
+
+    if (rule->key_id == -1) {
+        return flb_ra_regex_match(rule->ra, map, rule->regex, NULL) > 0;
+    }
+
+    val = state->kv[rule->key_id].val;
+    if (!val || val->type != MSGPACK_OBJECT_STR) {
+        return FLB_FALSE;
+    }
+
+    if (rule->literal_id >= 0) {
+        key = &ctx->key_list[rule->key_id];
+
+        if (!state->scanned[rule->key_id]) {
+            memset(state->found + key->literal_base, 0, key->ac->patterns);
+            flb_aho_corasick_search(key->ac, val->via.str.ptr,
+                                    val->via.str.size,
+                                    state->found + key->literal_base);
+            state->scanned[rule->key_id] = FLB_TRUE;
+        }
+
+        if (!state->found[rule->literal_id]) {
+            return FLB_FALSE;
+        }
+        else if (rule->regex->literal_exact) {
+            return FLB_TRUE;
+        }
+    }
+
+    return flb_regex_match(rule->regex, (unsigned char *) val->via.str.ptr,
+                           val->via.str.size) > 0;
+}
+
 /* Given a msgpack record, do some filter action based on the defined rules */
-static inline int grep_filter_data(msgpack_object map, struct grep_ctx *ctx)
+static inline int grep_filter_data(msgpack_object map, struct grep_ctx *ctx,
+                                   struct grep_state *state)
 {
-    ssize_t ret;
     struct mk_list *head;
     struct grep_rule *rule;
 
+    grep_state_reset(ctx, state, map);
+
     /* For each rule, validate against map fields */
     mk_list_foreach(head, &ctx->rules) {
         rule = mk_list_entry(head, struct grep_rule, _head);
 
-        ret = flb_ra_regex_match(rule->ra, map, rule->regex, NULL);
-        if (ret <= 0) { /* no match */
+        if (!grep_rule_match(ctx, state, rule, map)) { /* no match */
             if (rule->type == GREP_REGEX) {
                 return GREP_RET_EXCLUDE;
             }
@@ -215,6 +366,8 @@ static int cb_grep_init(struct flb_filter_instance *f_ins,
         return -1;
     }
     mk_list_init(&ctx->rules);
+    flb_ra_key_set_init(&ctx->keys);
+    ctx->literals = 0;
     ctx->ins = f_ins;
 
     ctx->logical_op = GREP_LOGICAL_OP_LEGACY;
@@ -242,27 +395,32 @@ static int cb_grep_init(struct flb_filter_instance *f_ins,
         return -1;
     }
 
+    ret = compile_rules(ctx);
+    if (ret == -1) {
+        flb_plg_error(ctx->ins, "could not compile the rules");
+        delete_rules(ctx);
+        flb_free(ctx);
+        return -1;
+    }
+
     /* Set our context */
     flb_filter_set_context(f_ins, ctx);
     return 0;
 }
 
-static inline int grep_filter_data_and_or(msgpack_object map, struct grep_ctx *ctx)
+static inline int grep_filter_data_and_or(msgpack_object map, struct grep_ctx *ctx,
+                                          struct grep_state *state)
 {
-    ssize_t ra_ret;
     int found = FLB_FALSE;
     struct mk_list *head;
     struct grep_rule *rule;
 
+    grep_state_reset(ctx, state, map);
+
     /* For each rule, validate against map fields */
     mk_list_foreach(head, &ctx->rules) {
-        found = FLB_FALSE;
         rule = mk_list_entry(head, struct grep_rule, _head);
-
-        ra_ret = flb_ra_regex_match(rule->ra, map, rule->regex, NULL);
-        if (ra_ret > 0) {
-            found = FLB_TRUE;
-        }
+        found = grep_rule_match(ctx, state, rule, map);
 
         if (ctx->logical_op == GREP_LOGICAL_OP_OR && found == FLB_TRUE) {
             /* OR case: One rule is matched. */
@@ -299,6 +457,7 @@ static int cb_grep_filter(const void *data, size_t bytes,
     struct flb_log_event_decoder log_decoder;
     struct flb_log_event log_event;
     struct grep_ctx *ctx;
+    struct grep_state state;
 
     (void) f_ins;
     (void) i_ins;
@@ -306,12 +465,22 @@ static int cb_grep_filter(const void *data, size_t bytes,
 
     ctx = (struct grep_ctx *) context;
 
+    state.found = NULL;
+    if (ctx->literals > 0) {
+        state.found = flb_malloc(ctx->literals);
+        if (!state.found) {
+            flb_errno();
+            return FLB_FILTER_NOTOUCH;
+        }
+    }
+
     ret = flb_log_event_decoder_init(&log_decoder, (char *) data, bytes);
 
     if (ret != FLB_EVENT_DECODER_SUCCESS) {
         flb_plg_error(ctx->ins,
                       "Log event decoder initialization error : %d", ret);
 
+        flb_free(state.found);
         return FLB_FILTER_NOTOUCH;
     }
 
@@ -323,6 +492,7 @@ static int cb_grep_filter(const void *data, size_t bytes,
                       "Log event encoder initialization error : %d", ret);
 
         flb_log_event_decoder_destroy(&log_decoder);
+        flb_free(state.found);
 
         return FLB_FILTER_NOTOUCH;
     }
@@ -336,10 +506,10 @@ static int cb_grep_filter(const void *data, size_t bytes,
         map  = *log_event.body;
 
         if (ctx->logical_op == GREP_LOGICAL_OP_LEGACY) {
-            ret = grep_filter_data(map, ctx);
+            ret = grep_filter_data(map, ctx, &state);
         }
         else {
-            ret = grep_filter_data_and_or(map, ctx);
+            ret = grep_filter_data_and_or(map, ctx, &state);
         }
 
         if (ret == GREP_RET_KEEP) {
@@ -361,6 +531,7 @@ static int cb_grep_filter(const void *data, size_t bytes,
     }
 
     flb_log_event_decoder_destroy(&log_decoder);
+    flb_free(state.found);
 
     /* we keep everything ? */
     if (old_size == new_size) {
@@ -430,5 +601,5 @@ struct flb_filter_plugin filter_grep_plugin = {
     .cb_filter    = cb_grep_filter,
     .cb_exit      = cb_grep_exit,
     .config_map   = config_map,
-    .flags        = 0
+    .flags        = FLB_FILTER_THREADSAFE
 };
@@ -24,6 +24,7 @@
 #include <fluent-bit/flb_filter.h>
 #include <fluent-bit/flb_sds.h>
 #include <fluent-bit/flb_record_accessor.h>
+#include <fluent-bit/flb_aho_corasick.h>
 
 /* rule types */
 #define GREP_NO_RULE  0
@@ -40,9 +41,25 @@ enum _logical_op{
     GREP_LOGICAL_OP_AND
 } logical_op;
 
+/* minimum number of literals on a key to look them up in a single pass */
+#define GREP_KEY_LITERALS_MIN  4
+
+/* record key used by one or more rules */
+struct grep_key {
+    flb_sds_t field;                 /* reference to the first rule field */
+    int literal_base;                /* first entry in grep_state->found  */
+    struct flb_aho_corasick *ac;     /* literals of the rules on the key  */
+};
+
 struct grep_ctx {
     struct mk_list rules;
     int logical_op;
+
+    /* keys of the rules, resolved once per record */
+    struct flb_ra_key_set keys;
+    struct grep_key key_list[FLB_RA_KEY_SET_MAX];
+    int literals;
+
     struct flb_filter_instance *ins;
 };
 
@@ -52,7 +69,16 @@ struct grep_rule {
     char *regex_pattern;
     struct flb_regex *regex;
     struct flb_record_accessor *ra;
+    int key_id;                      /* key in the set or -1 */
+    int literal_id;                  /* entry in grep_state->found or -1 */
     struct mk_list _head;
 };
 
+/* per record lookups, kept by the caller so the context is read only */
+struct grep_state {
+    struct flb_ra_kv kv[FLB_RA_KEY_SET_MAX];
+    char scanned[FLB_RA_KEY_SET_MAX];
+    char *found;
+};
+
 #endif
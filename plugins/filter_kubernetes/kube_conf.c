@@ -38,6 +38,7 @@
 struct flb_kube *flb_kube_conf_create(struct flb_filter_instance *ins,
                                       struct flb_config *config)
 {
+    int i;
     int off;
     int ret;
     const char *url;
@@ -53,10 +54,14 @@ struct flb_kube *flb_kube_conf_create(struct flb_filter_instance *ins,
     }
     ctx->config = config;
     ctx->ins = ins;
+    pthread_mutex_init(&ctx->token_lock, NULL);
+    pthread_mutex_init(&ctx->cache_lock, NULL);
 
     /* Set config_map properties in our local context */
     ret = flb_filter_config_map_set(ins, (void *) ctx);
     if (ret == -1) {
+        pthread_mutex_destroy(&ctx->token_lock);
+        pthread_mutex_destroy(&ctx->cache_lock);
         flb_free(ctx);
         return NULL;
     }
@@ -126,26 +131,26 @@ struct flb_kube *flb_kube_conf_create(struct flb_filter_instance *ins,
     }
 
     if (ctx->kube_meta_cache_ttl > 0) {
-        ctx->hash_table = flb_hash_table_create_with_ttl(ctx->kube_meta_cache_ttl,
-                                                         FLB_HASH_TABLE_EVICT_OLDER,
-                                                         FLB_HASH_TABLE_SIZE,
-                                                         FLB_HASH_TABLE_SIZE);
+        ctx->hash_table = flb_hash_table_create_open_with_ttl(ctx->kube_meta_cache_ttl,
+                                                              FLB_HASH_TABLE_EVICT_OLDER,
+                                                              FLB_HASH_TABLE_SIZE,
+                                                              FLB_HASH_TABLE_SIZE);
     }
     else {
-        ctx->hash_table = flb_hash_table_create(FLB_HASH_TABLE_EVICT_RANDOM,
-                                                FLB_HASH_TABLE_SIZE,
-                                                FLB_HASH_TABLE_SIZE);
+        ctx->hash_table = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_RANDOM,
+                                                     FLB_HASH_TABLE_SIZE,
+                                                     FLB_HASH_TABLE_SIZE);
     }
     
     if (ctx->kube_meta_namespace_cache_ttl > 0) {
-        ctx->namespace_hash_table = flb_hash_table_create_with_ttl(
+        ctx->namespace_hash_table = flb_hash_table_create_open_with_ttl(
                                             ctx->kube_meta_namespace_cache_ttl,
                                             FLB_HASH_TABLE_EVICT_OLDER,
                                             FLB_HASH_TABLE_SIZE,
                                             FLB_HASH_TABLE_SIZE);
     }
     else {
-        ctx->namespace_hash_table = flb_hash_table_create(
+        ctx->namespace_hash_table = flb_hash_table_create_open(
                                             FLB_HASH_TABLE_EVICT_RANDOM,
                                             FLB_HASH_TABLE_SIZE,
                                             FLB_HASH_TABLE_SIZE);
@@ -157,10 +162,29 @@ struct flb_kube *flb_kube_conf_create(struct flb_filter_instance *ins,
         return NULL;
     }
 
+    ctx->workers_count = flb_filter_worker_slots(config);
+    ctx->workers = flb_calloc(ctx->workers_count,
+                              sizeof(struct flb_kube_worker));
+    if (!ctx->workers) {
+        flb_errno();
+        flb_kube_conf_destroy(ctx);
+        return NULL;
+    }
+    for (i = 0; i < ctx->workers_count; i++) {
+        mk_list_init(&ctx->workers[i].upstreams);
+    }
+
     /* Merge log buffer */
     if (ctx->merge_log == FLB_TRUE) {
-        ctx->unesc_buf = flb_malloc(FLB_MERGE_BUF_SIZE);
-        ctx->unesc_buf_size = FLB_MERGE_BUF_SIZE;
+        for (i = 0; i < ctx->workers_count; i++) {
+            ctx->workers[i].unesc_buf = flb_malloc(FLB_MERGE_BUF_SIZE);
+            if (!ctx->workers[i].unesc_buf) {
+                flb_errno();
+                flb_kube_conf_destroy(ctx);
+                return NULL;
+            }
+            ctx->workers[i].unesc_buf_size = FLB_MERGE_BUF_SIZE;
+        }
     }
 
     /* Custom Regex */
@@ -194,6 +218,9 @@ struct flb_kube *flb_kube_conf_create(struct flb_filter_instance *ins,
 
 void flb_kube_conf_destroy(struct flb_kube *ctx)
 {
+    int i;
+    struct flb_kube_worker *w;
+
     if (ctx == NULL) {
         return;
     }
@@ -206,10 +233,6 @@ void flb_kube_conf_destroy(struct flb_kube *ctx)
         flb_hash_table_destroy(ctx->namespace_hash_table);
     }
 
-    if (ctx->merge_log == FLB_TRUE) {
-        flb_free(ctx->unesc_buf);
-    }
-
     /* Destroy regex content only if a parser was not defined */
     if (ctx->parser == NULL && ctx->regex) {
         flb_regex_destroy(ctx->regex);
@@ -221,12 +244,18 @@ void flb_kube_conf_destroy(struct flb_kube *ctx)
     flb_free(ctx->podname);
     flb_free(ctx->auth);
 
-    if (ctx->kubelet_upstream) {
-        flb_upstream_destroy(ctx->kubelet_upstream);
-    }
-    if (ctx->kube_api_upstream) {
-        flb_upstream_destroy(ctx->kube_api_upstream);
+    for (i = 0; ctx->workers && i < ctx->workers_count; i++) {
+        w = &ctx->workers[i];
+        flb_free(w->unesc_buf);
+
+        if (w->kubelet_upstream) {
+            flb_upstream_destroy(w->kubelet_upstream);
+        }
+        if (w->kube_api_upstream) {
+            flb_upstream_destroy(w->kube_api_upstream);
+        }
     }
+    flb_free(ctx->workers);
 
 #ifdef FLB_HAVE_TLS
     if (ctx->tls) {
@@ -237,5 +266,7 @@ void flb_kube_conf_destroy(struct flb_kube *ctx)
     }
 #endif
 
+    pthread_mutex_destroy(&ctx->token_lock);
+    pthread_mutex_destroy(&ctx->cache_lock);
     flb_free(ctx);
 }
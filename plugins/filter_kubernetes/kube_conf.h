@@ -29,6 +29,7 @@
 #include <fluent-bit/flb_sds.h>
 #include <fluent-bit/flb_regex.h>
 #include <fluent-bit/flb_hash_table.h>
+#include <fluent-bit/flb_filter_worker.h>
 
 /*
  * Since this filter might get a high number of request per second,
@@ -67,6 +68,27 @@
 
 struct kube_meta;
 
+/*
+ * The filter can run in the filter workers, every thread running it gets its
+ * own connections and merge buffer, see flb_kube_worker_get().
+ */
+struct flb_kube_worker {
+    /* Temporal buffer to unescape strings */
+    size_t unesc_buf_size;
+    size_t unesc_buf_len;
+    char *unesc_buf;
+
+    struct flb_upstream *kubelet_upstream;
+    struct flb_upstream *kube_api_upstream;
+
+    /*
+     * With filter workers the upstreams are not linked to the engine, which
+     * would otherwise sweep their connections: they are linked here and
+     * swept after every request, see kube_upstream_sweep().
+     */
+    struct mk_list upstreams;
+};
+
 /* Filter context */
 struct flb_kube {
     /* Configuration parameters */
@@ -96,11 +118,6 @@ struct flb_kube {
 
     struct flb_parser *merge_parser;
 
-    /* Temporal buffer to unescape strings */
-    size_t unesc_buf_size;
-    size_t unesc_buf_len;
-    char *unesc_buf;
-
     /*
      * Merge Log Trim: if merge_log is enabled, this flag allows to trim
      * the value and remove any trailing \n or \r.
@@ -152,6 +169,9 @@ struct flb_kube {
     char *auth;
     size_t auth_len;
 
+    /* Protects the token and the header value when they are refreshed */
+    pthread_mutex_t token_lock;
+
     int dns_retries;
     int dns_wait_time;
 
@@ -169,11 +189,23 @@ struct flb_kube {
     struct flb_config *config;
     struct flb_hash_table *hash_table;
     struct flb_hash_table *namespace_hash_table;
-    struct flb_upstream *kubelet_upstream;
-    struct flb_upstream *kube_api_upstream;
+
+    /* Protects both metadata caches, lookups can evict entries */
+    pthread_mutex_t cache_lock;
+
+    /* one per thread that can run the filter */
+    int workers_count;
+    struct flb_kube_worker *workers;
+
     struct flb_filter_instance *ins;
 };
 
+/* State of the thread running the filter */
+static inline struct flb_kube_worker *flb_kube_worker_get(struct flb_kube *ctx)
+{
+    return &ctx->workers[flb_filter_worker_id()];
+}
+
 struct flb_kube *flb_kube_conf_create(struct flb_filter_instance *i,
                                       struct flb_config *config);
 void flb_kube_conf_destroy(struct flb_kube *ctx);
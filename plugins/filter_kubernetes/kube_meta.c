@@ -352,6 +352,20 @@ static int get_meta_file_info(struct flb_kube *ctx, const char *namespace,
 /* Gather metadata from HTTP Request,
  * this could send out HTTP Request either to KUBE Server API or Kubelet
  */
+/*
+ * With filter workers the engine does not see the upstreams: drop the timed
+ * out connections and free the closed ones after every request.
+ */
+static void kube_upstream_sweep(struct flb_kube *ctx, struct flb_kube_worker *w)
+{
+    if (ctx->config->filter_workers <= 0) {
+        return;
+    }
+
+    flb_upstream_conn_timeouts(&w->upstreams);
+    flb_upstream_conn_pending_destroy_list(&w->upstreams);
+}
+
 static int get_meta_info_from_request(struct flb_kube *ctx,
                                       const char *namespace,
                                       const char *podname,
@@ -365,20 +379,21 @@ static int get_meta_info_from_request(struct flb_kube *ctx,
     int ret;
     size_t b_sent;
     int packed;
+    struct flb_kube_worker *w = flb_kube_worker_get(ctx);
     
     if(use_kubelet_connection == FLB_TRUE) {
-        if (!ctx->kubelet_upstream) {
+        if (!w->kubelet_upstream) {
             return -1;
         }
 
-        u_conn = flb_upstream_conn_get(ctx->kubelet_upstream);
+        u_conn = flb_upstream_conn_get(w->kubelet_upstream);
     } 
     else {
-        if (!ctx->kube_api_upstream) {
+        if (!w->kube_api_upstream) {
             return -1;
         }
 
-        u_conn = flb_upstream_conn_get(ctx->kube_api_upstream);
+        u_conn = flb_upstream_conn_get(w->kube_api_upstream);
     }
 
     if (!u_conn) {
@@ -391,10 +406,14 @@ static int get_meta_info_from_request(struct flb_kube *ctx,
         return -1;
     }
 
+    /* the header value is copied, the lock is only held to refresh it */
+    pthread_mutex_lock(&ctx->token_lock);
     ret = refresh_token_if_needed(ctx);
     if (ret == -1) {
+        pthread_mutex_unlock(&ctx->token_lock);
         flb_plg_error(ctx->ins, "failed to refresh token");
         flb_upstream_conn_release(u_conn);
+        kube_upstream_sweep(ctx, w);
         return -1;
     }
     
@@ -409,6 +428,7 @@ static int get_meta_info_from_request(struct flb_kube *ctx,
     if (ctx->auth_len > 0) {
         flb_http_add_header(c, "Authorization", 13, ctx->auth, ctx->auth_len);
     }
+    pthread_mutex_unlock(&ctx->token_lock);
 
     ret = flb_http_do(c, &b_sent);
     flb_plg_debug(ctx->ins, "Request (ns=%s, pod=%s) http_do=%i, "
@@ -422,6 +442,7 @@ static int get_meta_info_from_request(struct flb_kube *ctx,
         }
         flb_http_client_destroy(c);
         flb_upstream_conn_release(u_conn);
+        kube_upstream_sweep(ctx, w);
         return -1;
     }
 
@@ -431,6 +452,7 @@ static int get_meta_info_from_request(struct flb_kube *ctx,
     /* release resources */
     flb_http_client_destroy(c);
     flb_upstream_conn_release(u_conn);
+    kube_upstream_sweep(ctx, w);
 
     return packed;
 
@@ -1679,12 +1701,31 @@ static int wait_for_dns(struct flb_kube *ctx)
     return -1;
 }
 
+/*
+ * Without filter workers the upstream stays linked to the engine, which
+ * sweeps its connections. Otherwise the upstream of every slot is locked,
+ * since the caller slot can be used by several input threads, and it's
+ * linked to the list of its slot instead.
+ */
+static void kube_upstream_setup(struct flb_kube *ctx,
+                                struct flb_kube_worker *w,
+                                struct flb_upstream *u)
+{
+    if (ctx->config->filter_workers <= 0) {
+        return;
+    }
+
+    flb_upstream_thread_safe(u);
+    mk_list_add(&u->base._head, &w->upstreams);
+}
+
 static int flb_kubelet_network_init(struct flb_kube *ctx, struct flb_config *config)
 {
+    int i;
     int ret;
     int io_type = FLB_IO_TCP;
     int api_https = FLB_TRUE;
-    ctx->kubelet_upstream = NULL;    
+    struct flb_upstream *u;
 
     if(ctx->use_kubelet == FLB_FALSE) {
         return 0;
@@ -1721,31 +1762,36 @@ static int flb_kubelet_network_init(struct flb_kube *ctx, struct flb_config *con
         io_type = FLB_IO_TLS;
     }
 
-    /* Create an Upstream context */
-    ctx->kubelet_upstream = flb_upstream_create(config,
-                                        ctx->kubelet_host,
-                                        ctx->kubelet_port,
-                                        io_type,
-                                        ctx->kubelet_tls);
-    if (!ctx->kubelet_upstream) {
-        /* note: if ctx->tls.context is set, it's destroyed upon context exit */
-        flb_plg_debug(ctx->ins, "kubelet network init create upstream failed");
-        return -1;
-    }
+    /* Create an Upstream context for every thread running the filter */
+    for (i = 0; i < ctx->workers_count; i++) {
+        u = flb_upstream_create(config,
+                                ctx->kubelet_host,
+                                ctx->kubelet_port,
+                                io_type,
+                                ctx->kubelet_tls);
+        if (!u) {
+            /* note: if ctx->tls.context is set, it's destroyed upon context exit */
+            flb_plg_debug(ctx->ins, "kubelet network init create upstream failed");
+            return -1;
+        }
 
-    /* Remove async flag from upstream */
-    flb_stream_disable_async_mode(&ctx->kubelet_upstream->base);
+        /* Remove async flag from upstream */
+        flb_stream_disable_async_mode(&u->base);
+        kube_upstream_setup(ctx, &ctx->workers[i], u);
+
+        ctx->workers[i].kubelet_upstream = u;
+    }
 
     return 0;
 }
 
 static int flb_kube_network_init(struct flb_kube *ctx, struct flb_config *config)
 {
+    int i;
     int ret;
     int io_type = FLB_IO_TCP;
     int kubelet_network_init_ret = 0;
-
-    ctx->kube_api_upstream = NULL;
+    struct flb_upstream *u;
 
     /* Initialize Kube API Connection */
     if (ctx->api_https == FLB_TRUE) {
@@ -1774,20 +1820,25 @@ static int flb_kube_network_init(struct flb_kube *ctx, struct flb_config *config
         io_type = FLB_IO_TLS;
     }
 
-    /* Create an Upstream context */
-    ctx->kube_api_upstream = flb_upstream_create(config,
-                                        ctx->api_host,
-                                        ctx->api_port,
-                                        io_type,
-                                        ctx->tls);
-    if (!ctx->kube_api_upstream) {
-        /* note: if ctx->tls.context is set, it's destroyed upon context exit */
-        flb_plg_debug(ctx->ins, "kube network init create upstream failed");
-        return -1;
-    }
+    /* Create an Upstream context for every thread running the filter */
+    for (i = 0; i < ctx->workers_count; i++) {
+        u = flb_upstream_create(config,
+                                ctx->api_host,
+                                ctx->api_port,
+                                io_type,
+                                ctx->tls);
+        if (!u) {
+            /* note: if ctx->tls.context is set, it's destroyed upon context exit */
+            flb_plg_debug(ctx->ins, "kube network init create upstream failed");
+            return -1;
+        }
+
+        /* Remove async flag from upstream */
+        flb_stream_disable_async_mode(&u->base);
+        kube_upstream_setup(ctx, &ctx->workers[i], u);
 
-    /* Remove async flag from upstream */
-    flb_stream_disable_async_mode(&ctx->kube_api_upstream->base);
+        ctx->workers[i].kube_api_upstream = u;
+    }
     
     kubelet_network_init_ret = flb_kubelet_network_init(ctx, config);
     return kubelet_network_init_ret;
@@ -1903,6 +1954,52 @@ int flb_kube_dummy_meta_get(char **out_buf, size_t *out_size)
     return 0;
 }
 
+/*
+ * Look up the cache key of the metadata and keep a copy of the entry in
+ * meta->cache_buf: the filter workers share the caches, an entry can be
+ * evicted by another thread while the records are packed. Returns -1 if
+ * the key is not cached and -2 on error.
+ */
+static int kube_cache_get(struct flb_kube *ctx, struct flb_hash_table *ht,
+                          struct flb_kube_meta *meta, size_t *out_size)
+{
+    int ret;
+    const char *buf;
+    size_t size;
+
+    pthread_mutex_lock(&ctx->cache_lock);
+    ret = flb_hash_table_get(ht, meta->cache_key, meta->cache_key_len,
+                             (void *) &buf, &size);
+    if (ret == -1) {
+        pthread_mutex_unlock(&ctx->cache_lock);
+        return -1;
+    }
+
+    meta->cache_buf = flb_malloc(size);
+    if (!meta->cache_buf) {
+        flb_errno();
+        pthread_mutex_unlock(&ctx->cache_lock);
+        return -2;
+    }
+    memcpy(meta->cache_buf, buf, size);
+    pthread_mutex_unlock(&ctx->cache_lock);
+
+    *out_size = size;
+    return 0;
+}
+
+/* Cache the metadata retrieved from the API server, buf is kept by meta */
+static void kube_cache_add(struct flb_kube *ctx, struct flb_hash_table *ht,
+                           struct flb_kube_meta *meta,
+                           char *buf, size_t size)
+{
+    pthread_mutex_lock(&ctx->cache_lock);
+    flb_hash_table_add(ht, meta->cache_key, meta->cache_key_len, buf, size);
+    pthread_mutex_unlock(&ctx->cache_lock);
+
+    meta->cache_buf = buf;
+}
+
 static inline int flb_kube_pod_meta_get(struct flb_kube *ctx,
                       const char *tag, int tag_len,
                       const char *data, size_t data_size,
@@ -1910,7 +2007,6 @@ static inline int flb_kube_pod_meta_get(struct flb_kube *ctx,
                       struct flb_kube_meta *meta,
                       struct flb_kube_props *props)
 {
-    int id;
     int ret;
     const char *hash_meta_buf;
     char *tmp_hash_meta_buf;
@@ -1925,11 +2021,15 @@ static inline int flb_kube_pod_meta_get(struct flb_kube *ctx,
     }
 
     /* Check if we have some data associated to the cache key */
-    ret = flb_hash_table_get(ctx->hash_table,
-                             meta->cache_key, meta->cache_key_len,
-                             (void *) &hash_meta_buf, &hash_meta_size);
-    if (ret == -1) {
-        /* Retrieve API server meta and merge with local meta */
+    ret = kube_cache_get(ctx, ctx->hash_table, meta, &hash_meta_size);
+    if (ret == -2) {
+        return -1;
+    }
+    else if (ret == -1) {
+        /*
+         * Retrieve API server meta and merge with local meta, the cache is
+         * not locked meanwhile so other workers can get another entry.
+         */
         ret = get_and_merge_pod_meta(ctx, meta,
                                  &tmp_hash_meta_buf, &hash_meta_size);
         if (ret == -1) {
@@ -1938,20 +2038,10 @@ static inline int flb_kube_pod_meta_get(struct flb_kube *ctx,
             return 0;
         }
 
-        id = flb_hash_table_add(ctx->hash_table,
-                                meta->cache_key, meta->cache_key_len,
-                                tmp_hash_meta_buf, hash_meta_size);
-        if (id >= 0) {
-            /*
-             * Release the original buffer created on extract_pod_meta() as a new
-             * copy has been generated into the hash table, then re-set
-             * the outgoing buffer and size.
-             */
-            flb_free(tmp_hash_meta_buf);
-            flb_hash_table_get_by_id(ctx->hash_table, id, meta->cache_key,
-                                     &hash_meta_buf, &hash_meta_size);
-        }
+        kube_cache_add(ctx, ctx->hash_table, meta,
+                       tmp_hash_meta_buf, hash_meta_size);
     }
+    hash_meta_buf = meta->cache_buf;
 
     /*
      * The retrieved buffer may have two serialized items:
@@ -1989,7 +2079,6 @@ static inline int flb_kube_namespace_meta_get(struct flb_kube *ctx,
                       const char **out_buf, size_t *out_size,
                       struct flb_kube_meta *meta)
 {
-    int id;
     int ret;
     const char *hash_meta_buf;
     char *tmp_hash_meta_buf;
@@ -2004,10 +2093,11 @@ static inline int flb_kube_namespace_meta_get(struct flb_kube *ctx,
     }
 
     /* Check if we have some data associated to the cache key */
-    ret = flb_hash_table_get(ctx->namespace_hash_table,
-                             meta->cache_key, meta->cache_key_len,
-                             (void *) &hash_meta_buf, &hash_meta_size);
-    if (ret == -1) {
+    ret = kube_cache_get(ctx, ctx->namespace_hash_table, meta, &hash_meta_size);
+    if (ret == -2) {
+        return -1;
+    }
+    else if (ret == -1) {
         /* Retrieve API server meta and merge with local meta */
         ret = get_and_merge_namespace_meta(ctx, meta,
                                  &tmp_hash_meta_buf, &hash_meta_size);
@@ -2017,20 +2107,10 @@ static inline int flb_kube_namespace_meta_get(struct flb_kube *ctx,
             return 0;
         }
 
-        id = flb_hash_table_add(ctx->namespace_hash_table,
-                                meta->cache_key, meta->cache_key_len,
-                                tmp_hash_meta_buf, hash_meta_size);
-        if (id >= 0) {
-            /*
-             * Release the original buffer created on extract_namespace_meta()
-             * as a new copy has been generated into the hash table, then reset
-             * the outgoing buffer and size.
-             */
-            flb_free(tmp_hash_meta_buf);
-            flb_hash_table_get_by_id(ctx->namespace_hash_table, id, meta->cache_key,
-                                     &hash_meta_buf, &hash_meta_size);
-        }
+        kube_cache_add(ctx, ctx->namespace_hash_table, meta,
+                       tmp_hash_meta_buf, hash_meta_size);
     }
+    hash_meta_buf = meta->cache_buf;
 
     /*
      * The retrieved buffer may have serialized items:
@@ -2122,5 +2202,10 @@ int flb_kube_meta_release(struct flb_kube_meta *meta)
         flb_free(meta->cache_key);
     }
 
+    if (meta->cache_buf) {
+        flb_free(meta->cache_buf);
+        meta->cache_buf = NULL;
+    }
+
     return r;
 }
@@ -44,6 +44,7 @@ struct flb_kube_meta {
     char *container_hash;   /* set only on Systemd mode */
 
     char *cache_key;
+    char *cache_buf;        /* copy of the cached metadata */
 };
 
 /* Constant Kubernetes paths */
@@ -102,18 +102,19 @@ static int merge_log_handler(msgpack_object o,
     int root_type;
     int records = 0;
     char *tmp;
+    struct flb_kube_worker *w = flb_kube_worker_get(ctx);
 
     /* Reset vars */
     *out_buf = NULL;
     *out_size = 0;
 
     /* Allocate more space if required */
-    if (o.via.str.size >= ctx->unesc_buf_size) {
+    if (o.via.str.size >= w->unesc_buf_size) {
         new_size = o.via.str.size + 1;
-        tmp = flb_realloc(ctx->unesc_buf, new_size);
+        tmp = flb_realloc(w->unesc_buf, new_size);
         if (tmp) {
-            ctx->unesc_buf = tmp;
-            ctx->unesc_buf_size = new_size;
+            w->unesc_buf = tmp;
+            w->unesc_buf_size = new_size;
         }
         else {
             flb_errno();
@@ -122,15 +123,15 @@ static int merge_log_handler(msgpack_object o,
     }
 
     /* Copy the string value and append the required NULL byte */
-    ctx->unesc_buf_len = (int) o.via.str.size;
-    memcpy(ctx->unesc_buf, o.via.str.ptr, o.via.str.size);
-    ctx->unesc_buf[ctx->unesc_buf_len] = '\0';
+    w->unesc_buf_len = (int) o.via.str.size;
+    memcpy(w->unesc_buf, o.via.str.ptr, o.via.str.size);
+    w->unesc_buf[w->unesc_buf_len] = '\0';
 
     ret = -1;
 
     /* Parser set by Annotation */
     if (parser) {
-        ret = flb_parser_do(parser, ctx->unesc_buf, ctx->unesc_buf_len,
+        ret = flb_parser_do(parser, w->unesc_buf, w->unesc_buf_len,
                             out_buf, out_size, log_time);
         if (ret >= 0) {
             if (flb_time_to_nanosec(log_time) == 0L) {
@@ -141,7 +142,7 @@ static int merge_log_handler(msgpack_object o,
     }
     else if (ctx->merge_parser) { /* Custom parser 'merge_parser' option */
         ret = flb_parser_do(ctx->merge_parser,
-                            ctx->unesc_buf, ctx->unesc_buf_len,
+                            w->unesc_buf, w->unesc_buf_len,
                             out_buf, out_size, log_time);
         if (ret >= 0) {
             if (flb_time_to_nanosec(log_time) == 0L) {
@@ -151,7 +152,7 @@ static int merge_log_handler(msgpack_object o,
         }
     }
     else { /* Default JSON parser */
-        ret = flb_pack_json_recs(ctx->unesc_buf, ctx->unesc_buf_len,
+        ret = flb_pack_json_recs(w->unesc_buf, w->unesc_buf_len,
                                  (char **) out_buf, out_size, &root_type,
                                  &records, NULL);
         if (ret == 0 && root_type != FLB_PACK_JSON_OBJECT) {
@@ -236,6 +237,7 @@ static int pack_map_content(struct flb_log_event_encoder *log_encoder,
     msgpack_object v;
     msgpack_object root;
     struct flb_time log_time;
+    struct flb_kube_worker *w = flb_kube_worker_get(ctx);
 
     /* Original map size */
     map_size = source_map.via.map.size;
@@ -338,8 +340,8 @@ static int pack_map_content(struct flb_log_event_encoder *log_encoder,
                     ret = flb_log_event_encoder_append_body_values(
                             log_encoder,
                             FLB_LOG_EVENT_MSGPACK_OBJECT_VALUE(&k),
-                            FLB_LOG_EVENT_STRING_VALUE(ctx->unesc_buf,
-                                                       ctx->unesc_buf_len));
+                            FLB_LOG_EVENT_STRING_VALUE(w->unesc_buf,
+                                                       w->unesc_buf_len));
                 }
                 else {
                     append_original_objects = FLB_TRUE;
@@ -1071,5 +1073,5 @@ struct flb_filter_plugin filter_kubernetes_plugin = {
     .cb_filter    = cb_kube_filter,
     .cb_exit      = cb_kube_exit,
     .config_map   = config_map,
-    .flags        = 0
+    .flags        = FLB_FILTER_THREADSAFE
 };
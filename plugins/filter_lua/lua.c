@@ -21,6 +21,7 @@
 #include <fluent-bit/flb_compat.h>
 #include <fluent-bit/flb_filter.h>
 #include <fluent-bit/flb_filter_plugin.h>
+#include <fluent-bit/flb_filter_worker.h>
 #include <fluent-bit/flb_luajit.h>
 #include <fluent-bit/flb_lua.h>
 #include <fluent-bit/flb_utils.h>
@@ -57,49 +58,40 @@ static int cb_lua_pre_run(struct flb_filter_instance *f_ins,
         lua_config_destroy(ctx);
         return -1;
     }
-    ctx->lua = lj;
 
     /* Lua script source code */
     if (ctx->code) {
-        ret = flb_luajit_load_buffer(ctx->lua,
+        ret = flb_luajit_load_buffer(lj,
                                      ctx->code, flb_sds_len(ctx->code),
                                      "fluentbit.lua");
     }
     else {
         /* Load Script / file path*/
-        ret = flb_luajit_load_script(ctx->lua, ctx->script);
+        ret = flb_luajit_load_script(lj, ctx->script);
     }
 
-    flb_luajit_destroy(ctx->lua);
+    flb_luajit_destroy(lj);
     lua_config_destroy(ctx);
 
     return ret;
 }
 
-static int cb_lua_init(struct flb_filter_instance *f_ins,
-                       struct flb_config *config,
-                       void *data)
+/*
+ * Create a Lua state and run the script on it, so the globals it defines
+ * are ready before the first call.
+ */
+static struct flb_luajit *lua_state_create(struct lua_filter *ctx,
+                                           struct flb_config *config)
 {
     int err;
     int ret;
-    (void) data;
-    struct lua_filter *ctx;
     struct flb_luajit *lj;
 
-    /* Create context */
-    ctx = lua_config_create(f_ins, config);
-    if (!ctx) {
-        flb_error("[filter_lua] filter cannot be loaded");
-        return -1;
-    }
-
     /* Create LuaJIT state/vm */
     lj = flb_luajit_create(config);
     if (!lj) {
-        lua_config_destroy(ctx);
-        return -1;
+        return NULL;
     }
-    ctx->lua = lj;
 
     if (ctx->enable_flb_null) {
         flb_lua_enable_flb_null(lj->state);
@@ -107,41 +99,108 @@ static int cb_lua_init(struct flb_filter_instance *f_ins,
 
     /* Lua script source code */
     if (ctx->code) {
-        ret = flb_luajit_load_buffer(ctx->lua,
+        ret = flb_luajit_load_buffer(lj,
                                      ctx->code, flb_sds_len(ctx->code),
                                      "fluentbit.lua");
     }
     else {
         /* Load Script / file path*/
-        ret = flb_luajit_load_script(ctx->lua, ctx->script);
+        ret = flb_luajit_load_script(lj, ctx->script);
     }
 
     if (ret == -1) {
-        flb_luajit_destroy(ctx->lua);
-        lua_config_destroy(ctx);
-        return -1;
+        flb_luajit_destroy(lj);
+        return NULL;
     }
 
-    err = lua_pcall(ctx->lua->state, 0, 0, 0);
+    err = lua_pcall(lj->state, 0, 0, 0);
     if (err != 0) {
         flb_error("[luajit] invalid lua content, error=%d: %s",
                   err, lua_tostring(lj->state, -1));
         lua_pop(lj->state, 1);
-        lua_config_destroy(ctx);
+        flb_luajit_destroy(lj);
+        return NULL;
+    }
+
+    if (flb_lua_is_valid_func(lj->state, ctx->call) != FLB_TRUE) {
+        flb_plg_error(ctx->ins, "function %s is not found", ctx->call);
+        flb_luajit_destroy(lj);
+        return NULL;
+    }
+
+    return lj;
+}
+
+static void lua_states_destroy(struct lua_filter *ctx)
+{
+    int i;
+
+    if (!ctx->lua) {
+        return;
+    }
+
+    for (i = 0; i < ctx->lua_count; i++) {
+        if (ctx->lua[i]) {
+            flb_luajit_destroy(ctx->lua[i]);
+        }
+    }
+    flb_free(ctx->lua);
+    ctx->lua = NULL;
+}
+
+static int cb_lua_init(struct flb_filter_instance *f_ins,
+                       struct flb_config *config,
+                       void *data)
+{
+    int i;
+    (void) data;
+    struct lua_filter *ctx;
+
+    /* Create context */
+    ctx = lua_config_create(f_ins, config);
+    if (!ctx) {
+        flb_error("[filter_lua] filter cannot be loaded");
         return -1;
     }
 
+    /*
+     * A Lua state cannot be used by two threads at the same time: running on
+     * the filter workers means one state per worker, with its own globals.
+     * Scripts keeping state across records would silently break, so the
+     * instance stays serial unless it asks for it.
+     */
+    if (!ctx->per_worker_state) {
+        f_ins->flags &= ~FLB_FILTER_THREADSAFE;
+    }
 
-    if (flb_lua_is_valid_func(ctx->lua->state, ctx->call) != FLB_TRUE) {
-        flb_plg_error(ctx->ins, "function %s is not found", ctx->call);
+    if (f_ins->flags & FLB_FILTER_THREADSAFE) {
+        ctx->lua_count = flb_filter_worker_slots(config);
+    }
+    else {
+        ctx->lua_count = 1;
+    }
+    ctx->lua = flb_calloc(ctx->lua_count, sizeof(struct flb_luajit *));
+    if (!ctx->lua) {
+        flb_errno();
         lua_config_destroy(ctx);
         return -1;
     }
 
+    for (i = 0; i < ctx->lua_count; i++) {
+        ctx->lua[i] = lua_state_create(ctx, config);
+        if (!ctx->lua[i]) {
+            lua_states_destroy(ctx);
+            lua_config_destroy(ctx);
+            return -1;
+        }
+    }
+
     /* Initialize packing buffer */
     ctx->packbuf = flb_sds_create_size(1024);
     if (!ctx->packbuf) {
         flb_error("[filter_lua] failed to allocate packbuf");
+        lua_states_destroy(ctx);
+        lua_config_destroy(ctx);
         return -1;
     }
 
@@ -221,6 +280,7 @@ static int cb_lua_filter_mpack(const void *data, size_t bytes,
     struct flb_time t_orig;
     struct flb_time t;
     struct lua_filter *ctx = filter_context;
+    struct flb_luajit *lj = ctx->lua[flb_filter_worker_id()];
     double ts = 0;
     int l_code;
     double l_timestamp;
@@ -250,35 +310,35 @@ static int cb_lua_filter_mpack(const void *data, size_t bytes,
         t_orig = t;
 
         /* Prepare function call, pass 3 arguments, expect 3 return values */
-        lua_getglobal(ctx->lua->state, ctx->call);
-        lua_pushstring(ctx->lua->state, tag);
+        lua_getglobal(lj->state, ctx->call);
+        lua_pushstring(lj->state, tag);
 
         /* Timestamp */
         if (ctx->time_as_table == FLB_TRUE) {
-            flb_lua_pushtimetable(ctx->lua->state, &t);
+            flb_lua_pushtimetable(lj->state, &t);
         }
         else {
             ts = flb_time_to_double(&t);
-            lua_pushnumber(ctx->lua->state, ts);
+            lua_pushnumber(lj->state, ts);
         }
 
-        if (flb_lua_pushmpack(ctx->lua->state, &reader)) {
+        if (flb_lua_pushmpack(lj->state, &reader)) {
             return FLB_FILTER_NOTOUCH;
         }
         record_size = reader.data - record_start;
         bytes -= record_size;
 
         if (ctx->protected_mode) {
-            ret = lua_pcall(ctx->lua->state, 3, 3, 0);
+            ret = lua_pcall(lj->state, 3, 3, 0);
             if (ret != 0) {
                 flb_plg_error(ctx->ins, "error code %d: %s",
-                              ret, lua_tostring(ctx->lua->state, -1));
-                lua_pop(ctx->lua->state, 1);
+                              ret, lua_tostring(lj->state, -1));
+                lua_pop(lj->state, 1);
                 return FLB_FILTER_NOTOUCH;
             }
         }
         else {
-            lua_call(ctx->lua->state, 3, 3);
+            lua_call(lj->state, 3, 3);
         }
 
         /* Returned values are on the stack in the following order:
@@ -289,26 +349,26 @@ static int cb_lua_filter_mpack(const void *data, size_t bytes,
          *  we need to swap
          *
          * use lua_insert to put the table/record on the bottom */
-        lua_insert(ctx->lua->state, -3);
+        lua_insert(lj->state, -3);
          /* now swap timestamp with code */
-        lua_insert(ctx->lua->state, -2);
+        lua_insert(lj->state, -2);
 
         /* check code */
-        l_code = (int) lua_tointeger(ctx->lua->state, -1);
-        lua_pop(ctx->lua->state, 1);
+        l_code = (int) lua_tointeger(lj->state, -1);
+        lua_pop(lj->state, 1);
 
         if (l_code == -1) { /* Skip record */
-            lua_pop(ctx->lua->state, 2);
+            lua_pop(lj->state, 2);
             continue;
         }
         else if (l_code == 0) { /* Keep record, copy original to packbuf */
             flb_sds_cat_safe(&ctx->packbuf, record_start, record_size);
-            lua_pop(ctx->lua->state, 2);
+            lua_pop(lj->state, 2);
             continue;
         }
         else if (l_code != 1 && l_code != 2) {/* Unexpected return code, keep original content */
             flb_sds_cat_safe(&ctx->packbuf, record_start, record_size);
-            lua_pop(ctx->lua->state, 2);
+            lua_pop(lj->state, 2);
             flb_plg_error(ctx->ins, "unexpected Lua script return code %i, "
                           "original record will be kept." , l_code);
             continue;
@@ -317,16 +377,16 @@ static int cb_lua_filter_mpack(const void *data, size_t bytes,
         /* process record timestamp */
         l_timestamp = ts;
         if (ctx->time_as_table == FLB_TRUE) {
-            if (lua_type(ctx->lua->state, -1) == LUA_TTABLE) {
+            if (lua_type(lj->state, -1) == LUA_TTABLE) {
                 /* Retrieve seconds */
-                lua_getfield(ctx->lua->state, -1, "sec");
-                t.tm.tv_sec = lua_tointeger(ctx->lua->state, -1);
-                lua_pop(ctx->lua->state, 1);
+                lua_getfield(lj->state, -1, "sec");
+                t.tm.tv_sec = lua_tointeger(lj->state, -1);
+                lua_pop(lj->state, 1);
 
                 /* Retrieve nanoseconds */
-                lua_getfield(ctx->lua->state, -1, "nsec");
-                t.tm.tv_nsec = lua_tointeger(ctx->lua->state, -1);
-                lua_pop(ctx->lua->state, 2);
+                lua_getfield(lj->state, -1, "nsec");
+                t.tm.tv_nsec = lua_tointeger(lj->state, -1);
+                lua_pop(lj->state, 2);
             }
             else {
                 flb_plg_error(ctx->ins, "invalid lua timestamp type returned");
@@ -334,8 +394,8 @@ static int cb_lua_filter_mpack(const void *data, size_t bytes,
             }
         }
         else {
-            l_timestamp = (double) lua_tonumber(ctx->lua->state, -1);
-            lua_pop(ctx->lua->state, 1);
+            l_timestamp = (double) lua_tonumber(lj->state, -1);
+            lua_pop(lj->state, 1);
         }
 
         if (l_code == 1) {
@@ -354,7 +414,7 @@ static int cb_lua_filter_mpack(const void *data, size_t bytes,
         mpack_writer_set_context(&writer, ctx);
         mpack_writer_set_flush(&writer, mpack_buffer_flush);
         /* write the result */
-        pack_result_mpack(ctx->lua->state, &writer, &ctx->l2cc, &t);
+        pack_result_mpack(lj->state, &writer, &ctx->l2cc, &t);
         /* flush the writer */
         mpack_writer_flush_message(&writer);
         mpack_writer_destroy(&writer);
@@ -491,6 +551,7 @@ static int cb_lua_filter(const void *data, size_t bytes,
     struct flb_time t_orig;
     struct flb_time t;
     struct lua_filter *ctx = filter_context;
+    struct flb_luajit *lj = ctx->lua[flb_filter_worker_id()];
     /* Lua return values */
     int l_code;
     double l_timestamp;
@@ -536,25 +597,25 @@ static int cb_lua_filter(const void *data, size_t bytes,
         flb_time_copy(&t_orig, &log_event.timestamp);
 
         /* Prepare function call, pass 3 arguments, expect 3 return values */
-        lua_getglobal(ctx->lua->state, ctx->call);
-        lua_pushstring(ctx->lua->state, tag);
+        lua_getglobal(lj->state, ctx->call);
+        lua_pushstring(lj->state, tag);
 
         /* Timestamp */
         if (ctx->time_as_table == FLB_TRUE) {
-            flb_lua_pushtimetable(ctx->lua->state, &t);
+            flb_lua_pushtimetable(lj->state, &t);
         }
         else {
             ts = flb_time_to_double(&t);
-            lua_pushnumber(ctx->lua->state, ts);
+            lua_pushnumber(lj->state, ts);
         }
 
-        flb_lua_pushmsgpack(ctx->lua->state, log_event.body);
+        flb_lua_pushmsgpack(lj->state, log_event.body);
         if (ctx->protected_mode) {
-            ret = lua_pcall(ctx->lua->state, 3, 3, 0);
+            ret = lua_pcall(lj->state, 3, 3, 0);
             if (ret != 0) {
                 flb_plg_error(ctx->ins, "error code %d: %s",
-                              ret, lua_tostring(ctx->lua->state, -1));
-                lua_pop(ctx->lua->state, 1);
+                              ret, lua_tostring(lj->state, -1));
+                lua_pop(lj->state, 1);
 
                 msgpack_sbuffer_destroy(&data_sbuf);
                 flb_log_event_decoder_destroy(&log_decoder);
@@ -564,28 +625,28 @@ static int cb_lua_filter(const void *data, size_t bytes,
             }
         }
         else {
-            lua_call(ctx->lua->state, 3, 3);
+            lua_call(lj->state, 3, 3);
         }
 
         /* Initialize Return values */
         l_code = 0;
         l_timestamp = ts;
 
-        flb_lua_tomsgpack(ctx->lua->state, &data_pck, 0, &ctx->l2cc);
-        lua_pop(ctx->lua->state, 1);
+        flb_lua_tomsgpack(lj->state, &data_pck, 0, &ctx->l2cc);
+        lua_pop(lj->state, 1);
 
         /* Lua table */
         if (ctx->time_as_table == FLB_TRUE) {
-            if (lua_type(ctx->lua->state, -1) == LUA_TTABLE) {
+            if (lua_type(lj->state, -1) == LUA_TTABLE) {
                 /* Retrieve seconds */
-                lua_getfield(ctx->lua->state, -1, "sec");
-                t.tm.tv_sec = lua_tointeger(ctx->lua->state, -1);
-                lua_pop(ctx->lua->state, 1);
+                lua_getfield(lj->state, -1, "sec");
+                t.tm.tv_sec = lua_tointeger(lj->state, -1);
+                lua_pop(lj->state, 1);
 
                 /* Retrieve nanoseconds */
-                lua_getfield(ctx->lua->state, -1, "nsec");
-                t.tm.tv_nsec = lua_tointeger(ctx->lua->state, -1);
-                lua_pop(ctx->lua->state, 2);
+                lua_getfield(lj->state, -1, "nsec");
+                t.tm.tv_nsec = lua_tointeger(lj->state, -1);
+                lua_pop(lj->state, 2);
             }
             else {
                 flb_plg_error(ctx->ins, "invalid lua timestamp type returned");
@@ -593,12 +654,12 @@ static int cb_lua_filter(const void *data, size_t bytes,
             }
         }
         else {
-            l_timestamp = (double) lua_tonumber(ctx->lua->state, -1);
-            lua_pop(ctx->lua->state, 1);
+            l_timestamp = (double) lua_tonumber(lj->state, -1);
+            lua_pop(lj->state, 1);
         }
 
-        l_code = (int) lua_tointeger(ctx->lua->state, -1);
-        lua_pop(ctx->lua->state, 1);
+        l_code = (int) lua_tointeger(lj->state, -1);
+        lua_pop(lj->state, 1);
 
         if (l_code == -1) { /* Skip record */
             msgpack_sbuffer_destroy(&data_sbuf);
@@ -682,7 +743,7 @@ static int cb_lua_exit(void *data, struct flb_config *config)
     struct lua_filter *ctx;
 
     ctx = data;
-    flb_luajit_destroy(ctx->lua);
+    lua_states_destroy(ctx);
     lua_config_destroy(ctx);
 
     return 0;
@@ -735,6 +796,14 @@ static struct flb_config_map config_map[] = {
      "It is useful to prevent removing key/value "
      "since nil is a special value to remove key value from map in Lua."
     },
+    {
+     FLB_CONFIG_MAP_BOOL, "per_worker_state", "false",
+     0, FLB_TRUE, offsetof(struct lua_filter, per_worker_state),
+     "If enabled and 'filter_workers' is set in the service section, the "
+     "script runs on the filter workers. Every worker loads the script in its "
+     "own Lua state: globals (counters, lookup tables, rate limiters...) are "
+     "not shared between the workers. Ignored when built with mpack."
+    },
 
     {0}
 };
@@ -751,5 +820,10 @@ struct flb_filter_plugin filter_lua_plugin = {
 #endif
     .cb_exit      = cb_lua_exit,
     .config_map   = config_map,
+#ifdef FLB_FILTER_LUA_USE_MPACK
+    /* the mpack writer appends to the shared packbuf */
     .flags        = 0
+#else
+    .flags        = FLB_FILTER_THREADSAFE
+#endif
 };
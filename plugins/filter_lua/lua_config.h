@@ -36,8 +36,10 @@ struct lua_filter {
     int    protected_mode;            /* exec lua function in protected mode */
     int    time_as_table;             /* timestamp as a Lua table */
     int    enable_flb_null;           /* Use flb_null in Lua */
+    int    per_worker_state;          /* one Lua state per filter worker */
     struct flb_lua_l2c_config l2cc;   /* lua -> C config */
-    struct flb_luajit *lua;           /* state context   */
+    struct flb_luajit **lua;          /* state contexts, one per worker */
+    int    lua_count;                 /* number of state contexts */
     struct flb_filter_instance *ins;  /* filter instance */
     flb_sds_t packbuf;                /* dynamic buffer used for mpack write */
 };
@@ -1655,5 +1655,5 @@ struct flb_filter_plugin filter_modify_plugin = {
     .cb_filter = cb_modify_filter,
     .cb_exit = cb_modify_exit,
     .config_map = config_map,
-    .flags = 0
+    .flags = FLB_FILTER_THREADSAFE
 };
@@ -767,5 +767,5 @@ struct flb_filter_plugin filter_nest_plugin = {
     .cb_filter = cb_nest_filter,
     .cb_exit = cb_nest_exit,
     .config_map = config_map,
-    .flags = 0
+    .flags = FLB_FILTER_THREADSAFE
 };
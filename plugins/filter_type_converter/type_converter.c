@@ -395,5 +395,5 @@ struct flb_filter_plugin filter_type_converter_plugin = {
     .cb_filter   = cb_type_converter_filter,
     .cb_exit     = cb_type_converter_exit,
     .config_map  = config_map,
-    .flags       = 0,
+    .flags       = FLB_FILTER_THREADSAFE,
 };
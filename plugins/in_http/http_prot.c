@@ -21,6 +21,7 @@
 #include <fluent-bit/flb_version.h>
 #include <fluent-bit/flb_error.h>
 #include <fluent-bit/flb_pack.h>
+#include <fluent-bit/flb_compression.h>
 
 #include <monkey/monkey.h>
 #include <monkey/mk_core.h>
@@ -513,9 +514,16 @@ static int process_payload(struct flb_http *ctx, struct http_conn *conn,
                            struct mk_http_session *session,
                            struct mk_http_request *request)
 {
+    int i;
     int ret = -1;
     int type = -1;
+    int compression = FLB_COMPRESSION_ALGORITHM_NONE;
+    char *data;
+    size_t size;
+    void *uncompressed_data = NULL;
+    size_t uncompressed_size = 0;
     struct mk_http_header *header;
+    struct mk_http_header *headers_extra;
 
     header = &session->parser.headers[MK_HEADER_CONTENT_TYPE];
     if (header->key.data == NULL) {
@@ -544,11 +552,46 @@ static int process_payload(struct flb_http *ctx, struct http_conn *conn,
         return -1;
     }
 
+    for (i = 0; i < session->parser.headers_extra_count; i++) {
+        headers_extra = &session->parser.headers_extra[i];
+        if (headers_extra->key.len == 16 &&
+            strncasecmp(headers_extra->key.data, "Content-Encoding", 16) == 0) {
+            ret = flb_compression_get_algorithm_by_name(headers_extra->val.data,
+                                                        headers_extra->val.len);
+            if (ret > FLB_COMPRESSION_ALGORITHM_NONE) {
+                compression = ret;
+            }
+        }
+    }
+
+    data = request->data.data;
+    size = request->data.len;
+
+    if (compression != FLB_COMPRESSION_ALGORITHM_NONE) {
+        ret = flb_uncompress(compression, data, size,
+                             &uncompressed_data, &uncompressed_size,
+                             FLB_DECOMPRESSION_MAX_SIZE);
+        if (ret == -1) {
+            flb_plg_error(ctx->ins, "%s uncompress is failed",
+                          flb_compression_get_algorithm_name(compression));
+            send_response(conn, 400, "error: invalid payload\n");
+            return -1;
+        }
+
+        data = uncompressed_data;
+        size = uncompressed_size;
+    }
+
+    ret = -1;
     if (type == HTTP_CONTENT_JSON) {
-        ret = parse_payload_json(ctx, tag, request->data.data, request->data.len);
+        ret = parse_payload_json(ctx, tag, data, size);
     }
     else if (type == HTTP_CONTENT_URLENCODED) {
-        ret = parse_payload_urlencoded(ctx, tag, request->data.data, request->data.len);
+        ret = parse_payload_urlencoded(ctx, tag, data, size);
+    }
+
+    if (uncompressed_data != NULL) {
+        flb_free(uncompressed_data);
     }
 
     if (ret != 0) {
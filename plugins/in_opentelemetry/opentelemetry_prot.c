@@ -24,6 +24,11 @@
 #include <fluent-bit/flb_time.h>
 #include <fluent-bit/flb_gzip.h>
 #include <fluent-bit/flb_snappy.h>
+#include <fluent-bit/flb_lz4.h>
+#ifdef FLB_HAVE_ZSTD
+#include <fluent-bit/flb_zstd.h>
+#endif
+#include <fluent-bit/flb_compression.h>
 #include <fluent-bit/flb_mp.h>
 #include <fluent-bit/flb_log_event_encoder.h>
 
@@ -1655,9 +1660,50 @@ int uncompress_zstd(char **output_buffer,
                     char *input_buffer,
                     size_t input_size)
 {
+#ifdef FLB_HAVE_ZSTD
+    int ret;
+
+    ret = flb_zstd_uncompress(input_buffer,
+                              input_size,
+                              (void *) output_buffer,
+                              output_size,
+                              FLB_DECOMPRESSION_MAX_SIZE);
+
+    if (ret == -1) {
+        flb_error("[opentelemetry] zstd decompression failed");
+
+        return -1;
+    }
+
+    return 1;
+#else
     flb_error("[opentelemetry] unsupported compression format");
 
     return -1;
+#endif
+}
+
+static \
+int uncompress_lz4(char **output_buffer,
+                   size_t *output_size,
+                   char *input_buffer,
+                   size_t input_size)
+{
+    int ret;
+
+    ret = flb_lz4_uncompress(input_buffer,
+                             input_size,
+                             (void *) output_buffer,
+                             output_size,
+                             FLB_DECOMPRESSION_MAX_SIZE);
+
+    if (ret == -1) {
+        flb_error("[opentelemetry] lz4 decompression failed");
+
+        return -1;
+    }
+
+    return 1;
 }
 
 static \
@@ -1750,6 +1796,12 @@ int opentelemetry_prot_uncompress(struct mk_http_session *session,
                                        request->data.data,
                                        request->data.len);
             }
+            else if (strncasecmp(header->val.data, "lz4", 3) == 0) {
+                return uncompress_lz4(output_buffer,
+                                      output_size,
+                                      request->data.data,
+                                      request->data.len);
+            }
             else if (strncasecmp(header->val.data, "snappy", 6) == 0) {
                 return uncompress_snappy(output_buffer,
                                          output_size,
@@ -1897,6 +1949,13 @@ int opentelemetry_prot_handle(struct flb_opentelemetry *ctx, struct http_conn *c
                                         &uncompressed_data,
                                         &uncompressed_data_size);
 
+    if (ret == -1) {
+        flb_sds_destroy(tag);
+        mk_mem_free(uri);
+        send_response(conn, 400, "error: invalid payload\n");
+        return -1;
+    }
+
     if (ret > 0) {
         request->data.data = uncompressed_data;
         request->data.len = uncompressed_data_size;
@@ -22,6 +22,7 @@
 #include <fluent-bit/flb_error.h>
 #include <fluent-bit/flb_pack.h>
 #include <fluent-bit/flb_gzip.h>
+#include <fluent-bit/flb_compression.h>
 
 #include <monkey/monkey.h>
 #include <monkey/mk_core.h>
@@ -569,7 +570,7 @@ static int process_hec_payload(struct flb_splunk *ctx, struct splunk_conn *conn,
     struct mk_http_header *header_auth;
     int extra_size = -1;
     struct mk_http_header *headers_extra;
-    int gzip_compressed = FLB_FALSE;
+    int compression = FLB_COMPRESSION_ALGORITHM_NONE;
     void *gz_data = NULL;
     size_t gz_size = -1;
 
@@ -611,20 +612,25 @@ static int process_hec_payload(struct flb_splunk *ctx, struct splunk_conn *conn,
             headers_extra = &session->parser.headers_extra[i];
             if (headers_extra->key.len == 16 &&
                 strncasecmp(headers_extra->key.data, "Content-Encoding", 16) == 0) {
-                if (headers_extra->val.len == 4 &&
-                    strncasecmp(headers_extra->val.data, "gzip", 4) == 0) {
-                    flb_plg_debug(ctx->ins, "body is gzipped");
-                    gzip_compressed = FLB_TRUE;
+                ret = flb_compression_get_algorithm_by_name(headers_extra->val.data,
+                                                            headers_extra->val.len);
+                if (ret > FLB_COMPRESSION_ALGORITHM_NONE) {
+                    flb_plg_debug(ctx->ins, "body is %s compressed",
+                                  flb_compression_get_algorithm_name(ret));
+                    compression = ret;
                 }
             }
         }
     }
 
-    if (gzip_compressed == FLB_TRUE) {
-        ret = flb_gzip_uncompress((void *) request->data.data, request->data.len,
-                                  &gz_data, &gz_size);
+    if (compression != FLB_COMPRESSION_ALGORITHM_NONE) {
+        ret = flb_uncompress(compression,
+                             (void *) request->data.data, request->data.len,
+                             &gz_data, &gz_size,
+                             FLB_DECOMPRESSION_MAX_SIZE);
         if (ret == -1) {
-            flb_plg_error(ctx->ins, "gzip uncompress is failed");
+            flb_plg_error(ctx->ins, "%s uncompress is failed",
+                          flb_compression_get_algorithm_name(compression));
             return -1;
         }
 
@@ -22,6 +22,7 @@
 #include <fluent-bit/flb_input_chunk.h>
 #include <fluent-bit/flb_storage.h>
 #include <fluent-bit/flb_utils.h>
+#include <fluent-bit/flb_metrics.h>
 #include <chunkio/chunkio.h>
 #include <chunkio/cio_error.h>
 
@@ -36,6 +37,7 @@ struct sb_out_chunk {
     struct cio_chunk  *chunk;
     struct cio_stream *stream;
     size_t             size;
+    ssize_t            records; /* from the chunk metadata, -1 if unknown */
     struct mk_list    _head;
 };
 
@@ -58,7 +60,8 @@ static inline struct flb_sb *sb_get_context(struct flb_config *config);
 
 static struct sb_out_chunk *sb_allocate_chunk(struct cio_chunk *chunk,
                                               struct cio_stream *stream,
-                                              size_t size);
+                                              size_t size,
+                                              ssize_t records);
 
 static void sb_destroy_chunk(struct sb_out_chunk *chunk);
 
@@ -82,6 +85,7 @@ static void sb_remove_chunk_from_segregated_backlogs(struct cio_chunk *chunk,
 static int sb_append_chunk_to_segregated_backlog(struct cio_chunk    *target_chunk,
                                                  struct cio_stream   *stream,
                                                  size_t               target_chunk_size,
+                                                 ssize_t              target_chunk_records,
                                                  struct sb_out_queue *backlog);
 
 static int sb_append_chunk_to_segregated_backlogs(struct cio_chunk  *target_chunk,
@@ -112,16 +116,18 @@ static inline struct flb_sb *sb_get_context(struct flb_config *config)
 
 static struct sb_out_chunk *sb_allocate_chunk(struct cio_chunk *chunk,
                                               struct cio_stream *stream,
-                                              size_t size)
+                                              size_t size,
+                                              ssize_t records)
 {
     struct sb_out_chunk *result;
 
     result = (struct sb_out_chunk *) flb_calloc(1, sizeof(struct sb_out_chunk));
 
     if (result != NULL) {
-        result->chunk  = chunk;
-        result->stream = stream;
-        result->size   = size;
+        result->chunk   = chunk;
+        result->stream  = stream;
+        result->size    = size;
+        result->records = records;
     }
 
     return result;
@@ -251,11 +257,13 @@ static void sb_remove_chunk_from_segregated_backlogs(struct cio_chunk *target_ch
 static int sb_append_chunk_to_segregated_backlog(struct cio_chunk    *target_chunk,
                                                  struct cio_stream   *stream,
                                                  size_t               target_chunk_size,
+                                                 ssize_t              target_chunk_records,
                                                  struct sb_out_queue *backlog)
 {
     struct sb_out_chunk *chunk;
 
-    chunk = sb_allocate_chunk(target_chunk, stream, target_chunk_size);
+    chunk = sb_allocate_chunk(target_chunk, stream, target_chunk_size,
+                              target_chunk_records);
     if (chunk == NULL) {
         flb_errno();
         return -1;
@@ -276,6 +284,10 @@ static int sb_append_chunk_to_segregated_backlogs(struct cio_chunk  *target_chun
     struct mk_list         *tmp;
     struct mk_list         *head;
     size_t                  chunk_size;
+    size_t                  chunk_records;
+    ssize_t                 records;
+    uint64_t                first_ts;
+    uint64_t                last_ts;
     struct sb_out_queue    *backlog;
     int                     tag_len;
     const char *            tag_buf;
@@ -302,21 +314,41 @@ static int sb_append_chunk_to_segregated_backlogs(struct cio_chunk  *target_chun
         return -2;
     }
 
+    /*
+     * The record count is read while the chunk is up, so releasing it later
+     * does not require to map it again.
+     */
+    records = -1;
+    result = flb_input_chunk_get_stats(&dummy_input_chunk, &chunk_records,
+                                       &first_ts, &last_ts);
+    if (result == 0) {
+        records = chunk_records;
+    }
+
+    dummy_input_chunk.routes_mask = flb_routes_mask_create(context->ins->config);
+    if (!dummy_input_chunk.routes_mask) {
+        return -1;
+    }
+
     flb_routes_mask_set_by_tag(dummy_input_chunk.routes_mask, tag_buf, tag_len,
                                context->ins);
 
     mk_list_foreach_safe(head, tmp, &context->backlogs) {
         backlog = mk_list_entry(head, struct sb_out_queue, _head);
         if (flb_routes_mask_get_bit(dummy_input_chunk.routes_mask,
-                                    backlog->ins->id)) {
+                                    backlog->ins->id,
+                                    context->ins->config)) {
             result = sb_append_chunk_to_segregated_backlog(target_chunk, stream,
-                                                           chunk_size, backlog);
+                                                           chunk_size, records,
+                                                           backlog);
             if (result) {
+                flb_routes_mask_destroy(dummy_input_chunk.routes_mask);
                 return -3;
             }
         }
     }
 
+    flb_routes_mask_destroy(dummy_input_chunk.routes_mask);
     return 0;
 }
 
@@ -480,6 +512,19 @@ int sb_release_output_queue_space(struct flb_output_instance *output_plugin,
         released_space += chunk->size;
         underlying_chunk = chunk->chunk;
 
+#ifdef FLB_HAVE_METRICS
+        if (chunk->records > 0) {
+            cmt_counter_add(output_plugin->cmt_dropped_records,
+                            cfl_time_now(),
+                            chunk->records,
+                            1, (char *[]) {(char *) flb_output_name(output_plugin)});
+
+            flb_metrics_sum(FLB_METRIC_OUT_DROPPED_RECORDS,
+                            chunk->records,
+                            output_plugin->metrics);
+        }
+#endif
+
         sb_remove_chunk_from_segregated_backlogs(underlying_chunk, context);
         cio_chunk_close(underlying_chunk, FLB_TRUE);
 
@@ -21,6 +21,7 @@
 #include <fluent-bit/flb_parser.h>
 #include <fluent-bit/flb_time.h>
 #include <fluent-bit/flb_pack.h>
+#include <fluent-bit/flb_line_split.h>
 
 #include "syslog.h"
 #include "syslog_conn.h"
@@ -212,41 +213,26 @@ int syslog_prot_process(struct syslog_conn *conn)
     int ret;
     char *p;
     char *eof;
-    char *end;
     void *out_buf;
     size_t out_size;
     struct flb_time out_time;
+    struct flb_line_split ls;
     struct flb_syslog *ctx = conn->ctx;
 
-    eof = conn->buf_data;
-    end = conn->buf_data + conn->buf_len;
+    /* Messages end with a line break or a NULL byte */
+    flb_line_split_init(&ls,
+                        conn->buf_data + conn->buf_parsed,
+                        conn->buf_len - conn->buf_parsed,
+                        '\n', '\0');
 
-    /* Always parse while some remaining bytes exists */
-    while (eof < end) {
-        /* Lookup the ending byte */
-        eof = p = conn->buf_data + conn->buf_parsed;
-        while (*eof != '\n' && *eof != '\0' && eof < end) {
-            eof++;
-        }
-
-        /* Incomplete message */
-        if (eof == end || (*eof != '\n' && *eof != '\0')) {
-            break;
-        }
+    /* Parse every complete message, an incomplete one waits for more data */
+    while ((eof = (char *) flb_line_split_next(&ls))) {
+        p = conn->buf_data + conn->buf_parsed;
 
         /* No data ? */
         len = (eof - p);
         if (len == 0) {
-            consume_bytes(conn->buf_data, 1, conn->buf_len);
-            conn->buf_len--;
-            conn->buf_parsed = 0;
-            conn->buf_data[conn->buf_len] = '\0';
-            end = conn->buf_data + conn->buf_len;
-
-            if (conn->buf_len == 0) {
-                break;
-            }
-
+            conn->buf_parsed++;
             continue;
         }
 
@@ -270,8 +256,6 @@ int syslog_prot_process(struct syslog_conn *conn)
         }
 
         conn->buf_parsed += len + 1;
-        end = conn->buf_data + conn->buf_len;
-        eof = conn->buf_data + conn->buf_parsed;
     }
 
     if (conn->buf_parsed > 0) {
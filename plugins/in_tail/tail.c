@@ -491,6 +491,20 @@ static int in_tail_init(struct flb_input_instance *in,
     }
 #endif
 
+#ifdef FLB_HAVE_SQLDB
+    /* Register callback to write the file offsets checkpoint */
+    if (ctx->db && ctx->db_checkpoint_interval > 0) {
+        ret = flb_input_set_collector_time(in, flb_tail_db_checkpoint_callback,
+                                           ctx->db_checkpoint_interval, 0,
+                                           config);
+        if (ret == -1) {
+            flb_tail_config_destroy(ctx);
+            return -1;
+        }
+        ctx->coll_fd_db_checkpoint = ret;
+    }
+#endif
+
     return 0;
 }
 
@@ -509,6 +523,13 @@ static int in_tail_exit(void *data, struct flb_config *config)
     (void) *config;
     struct flb_tail_config *ctx = data;
 
+#ifdef FLB_HAVE_SQLDB
+    /* write pending offsets at once before the files are released */
+    if (ctx->db && ctx->db_checkpoint_interval > 0) {
+        flb_tail_db_checkpoint(ctx);
+    }
+#endif
+
     flb_tail_file_remove_all(ctx);
     flb_tail_fs_exit(ctx);
     flb_tail_config_destroy(ctx);
@@ -546,6 +567,13 @@ static void in_tail_pause(void *data, struct flb_config *config)
 
     /* Pause file system backend handlers */
     flb_tail_fs_pause(ctx);
+
+#ifdef FLB_HAVE_SQLDB
+    /* nothing else is read while paused, store the offsets now */
+    if (ctx->db && ctx->db_checkpoint_interval > 0) {
+        flb_tail_db_checkpoint(ctx);
+    }
+#endif
 }
 
 static void in_tail_resume(void *data, struct flb_config *config)
@@ -705,6 +733,17 @@ static struct flb_config_map config_map[] = {
      0, FLB_TRUE, offsetof(struct flb_tail_config, skip_empty_lines),
      "Allows to skip empty lines."
     },
+    {
+     FLB_CONFIG_MAP_STR, "read_mode", "read",
+     0, FLB_FALSE, 0,
+     "set how the content of static files (files with data found on start "
+     "up) is read. 'read' copies it in the file buffer, 'mmap' maps the file "
+     "and cuts the lines in place (Linux only). A window is only mapped "
+     "under a read lease, which makes a concurrent truncation wait until the "
+     "window is read; files open for writing by another process or that "
+     "cannot be leased (not owned by the agent user without CAP_LEASE) are "
+     "read with 'read'."
+    },
 #ifdef __linux__
     {
      FLB_CONFIG_MAP_BOOL, "file_cache_advise", "true",
@@ -757,6 +796,13 @@ static struct flb_config_map config_map[] = {
      "provides higher performance. Note that WAL is not compatible with "
      "shared network file systems."
     },
+    {
+     FLB_CONFIG_MAP_TIME, "db.checkpoint_interval", "0",
+     0, FLB_TRUE, offsetof(struct flb_tail_config, db_checkpoint_interval),
+     "keep file offsets in memory and write them to the database in a single "
+     "transaction on this interval instead of on every read. On a crash the "
+     "files are read again from the last checkpoint. Disabled by default."
+    },
     {
      FLB_CONFIG_MAP_BOOL, "db.compare_filename", "false",
      0, FLB_TRUE, offsetof(struct flb_tail_config, compare_filename),
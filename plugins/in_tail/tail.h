@@ -33,12 +33,17 @@
 #define FLB_TAIL_STATIC  0  /* Data is being consumed through read(2) */
 #define FLB_TAIL_EVENT   1  /* Data is being consumed through inotify */
 
+/* Read mode for static files */
+#define FLB_TAIL_READ_MODE_READ  0  /* read(2) into the file buffer      */
+#define FLB_TAIL_READ_MODE_MMAP  1  /* lines are cut from a file mapping */
+
 /* Config */
 #define FLB_TAIL_CHUNK              "32768"   /* buffer chunk = 32KB      */
 #define FLB_TAIL_REFRESH                 60   /* refresh every 60 seconds */
 #define FLB_TAIL_ROTATE_WAIT             "5"  /* time to monitor after rotation */
 #define FLB_TAIL_STATIC_BATCH_SIZE      "50M" /* static batch size */
 #define FLB_TAIL_EVENT_BATCH_SIZE       "50M" /* event batch size */
+#define FLB_TAIL_MMAP_WINDOW    (1024 * 1024) /* bytes mapped per read    */
 
 int in_tail_collect_event(void *file, struct flb_config *config);
 
@@ -261,6 +261,25 @@ struct flb_tail_config *flb_tail_config_create(struct flb_input_instance *ins,
         ctx->dynamic_tag = FLB_TRUE;
     }
 
+    /* Read mode */
+    ctx->read_mode = FLB_TAIL_READ_MODE_READ;
+    tmp = flb_input_get_property("read_mode", ins);
+    if (tmp) {
+        if (strcasecmp(tmp, "mmap") == 0) {
+#ifndef __linux__
+            flb_plg_warn(ctx->ins, "read_mode 'mmap' is not supported on "
+                         "this platform, using 'read'");
+#else
+            ctx->read_mode = FLB_TAIL_READ_MODE_MMAP;
+#endif
+        }
+        else if (strcasecmp(tmp, "read") != 0) {
+            flb_plg_error(ctx->ins, "invalid 'read_mode' value: %s", tmp);
+            flb_tail_config_destroy(ctx);
+            return NULL;
+        }
+    }
+
 #ifdef FLB_HAVE_SQLDB
     /* Database options (needs to be set before the context) */
     tmp = flb_input_get_property("db.sync", ins);
@@ -414,6 +433,13 @@ struct flb_tail_config *flb_tail_config_create(struct flb_input_instance *ins,
                                                 "Total number of rotated files",
                                                 1, (char *[]) {"name"});
 
+    ctx->cmt_db_checkpoint_lag = cmt_gauge_create(ins->cmt,
+                                                  "fluentbit", "input",
+                                                  "db_checkpoint_lag_bytes",
+                                                  "Bytes read past the previous "
+                                                  "file offsets checkpoint",
+                                                  1, (char *[]) {"name"});
+
     /* OLD metrics */
     flb_metrics_add(FLB_TAIL_METRIC_F_OPENED,
                     "files_opened", ctx->ins->metrics);
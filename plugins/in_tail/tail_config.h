@@ -70,6 +70,7 @@ struct flb_tail_config {
     int coll_fd_dmode_flush;
     int coll_fd_mult_flush;
     int coll_fd_progress_check;
+    int coll_fd_db_checkpoint;
 
     /* Backend collectors */
     int coll_fd_fs1;           /* used by fs_inotify & fs_stat */
@@ -93,6 +94,7 @@ struct flb_tail_config {
     int   skip_long_lines;     /* skip long lines              */
     int   skip_empty_lines;    /* skip empty lines (off)       */
     int   exit_on_eof;         /* exit fluent-bit on EOF, test */
+    int   read_mode;           /* read mode for static files   */
 #ifdef __linux__
     int   file_cache_advise;   /* Use posix_fadvise for file access */
 #endif
@@ -110,6 +112,7 @@ struct flb_tail_config {
     struct flb_sqldb *db;
     int db_sync;
     int db_locking;
+    int db_checkpoint_interval;    /* seconds between offset checkpoints */
     int compare_filename;
     flb_sds_t db_journal_mode;
     sqlite3_stmt *stmt_get_file;
@@ -157,6 +160,7 @@ struct flb_tail_config {
     struct cmt_counter *cmt_files_opened;
     struct cmt_counter *cmt_files_closed;
     struct cmt_counter *cmt_files_rotated;
+    struct cmt_gauge *cmt_db_checkpoint_lag;
 
     /* Hash: hash tables for quick acess to registered files */
     struct flb_hash_table *static_hash;
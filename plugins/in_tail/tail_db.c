@@ -282,13 +282,14 @@ int flb_tail_db_file_set(struct flb_tail_file *file,
         file->db_id = id;
         file->offset = offset;
     }
+    file->db_offset = file->offset;
 
     return 0;
 }
 
 /* Update Offset v2 */
-int flb_tail_db_file_offset(struct flb_tail_file *file,
-                            struct flb_tail_config *ctx)
+static int db_file_offset_write(struct flb_tail_file *file,
+                                struct flb_tail_config *ctx)
 {
     int ret;
 
@@ -317,6 +318,130 @@ int flb_tail_db_file_offset(struct flb_tail_file *file,
     sqlite3_clear_bindings(ctx->stmt_offset);
     sqlite3_reset(ctx->stmt_offset);
 
+    file->db_offset = file->offset;
+
+    return 0;
+}
+
+/*
+ * Register the current file offset. By default it's written right away, when
+ * 'db.checkpoint_interval' is set the offset is only kept in memory and all
+ * the files that moved are written together by flb_tail_db_checkpoint().
+ *
+ * The offset is always updated after the content was appended to the input
+ * chunk, so a checkpoint never goes past data that was ingested: after a
+ * crash the files are re-read from the last checkpoint (at-least-once).
+ */
+int flb_tail_db_file_offset(struct flb_tail_file *file,
+                            struct flb_tail_config *ctx)
+{
+    if (ctx->db_checkpoint_interval > 0) {
+        return 0;
+    }
+
+    return db_file_offset_write(file, ctx);
+}
+
+/* Write the offset of a file now if it has not been checkpointed */
+int flb_tail_db_file_offset_flush(struct flb_tail_file *file,
+                                  struct flb_tail_config *ctx)
+{
+    if (file->offset == file->db_offset) {
+        return 0;
+    }
+
+    return db_file_offset_write(file, ctx);
+}
+
+static int db_checkpoint_list(struct mk_list *files,
+                              struct flb_tail_config *ctx,
+                              int64_t *lag)
+{
+    int ret;
+    int count = 0;
+    struct mk_list *head;
+    struct flb_tail_file *file;
+
+    mk_list_foreach(head, files) {
+        file = mk_list_entry(head, struct flb_tail_file, _head);
+        if (file->offset == file->db_offset) {
+            continue;
+        }
+
+        if (file->offset > file->db_offset) {
+            *lag += file->offset - file->db_offset;
+        }
+
+        ret = db_file_offset_write(file, ctx);
+        if (ret == -1) {
+            return -1;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+/* Write the offsets of all the files that moved in a single transaction */
+int flb_tail_db_checkpoint(struct flb_tail_config *ctx)
+{
+    int ret;
+    int count;
+    int64_t lag = 0;
+    uint64_t ts;
+    char *name;
+
+    if (!ctx->db) {
+        return 0;
+    }
+
+    ret = flb_sqldb_query(ctx->db, SQL_BEGIN_TRANSACTION, NULL, NULL);
+    if (ret != FLB_OK) {
+        flb_plg_error(ctx->ins, "db: could not begin offsets checkpoint");
+        return -1;
+    }
+
+    count = db_checkpoint_list(&ctx->files_static, ctx, &lag);
+    if (count >= 0) {
+        ret = db_checkpoint_list(&ctx->files_event, ctx, &lag);
+        count = (ret == -1) ? -1 : count + ret;
+    }
+
+    if (count == -1) {
+        flb_sqldb_query(ctx->db, SQL_ROLLBACK_TRANSACTION, NULL, NULL);
+        flb_plg_error(ctx->ins, "db: offsets checkpoint failed");
+        return -1;
+    }
+
+    ret = flb_sqldb_query(ctx->db, SQL_COMMIT_TRANSACTION, NULL, NULL);
+    if (ret != FLB_OK) {
+        flb_sqldb_query(ctx->db, SQL_ROLLBACK_TRANSACTION, NULL, NULL);
+        flb_plg_error(ctx->ins, "db: could not commit offsets checkpoint");
+        return -1;
+    }
+
+#ifdef FLB_HAVE_METRICS
+    name = (char *) flb_input_name(ctx->ins);
+    ts = cfl_time_now();
+    cmt_gauge_set(ctx->cmt_db_checkpoint_lag, ts, (double) lag,
+                  1, (char *[]) {name});
+#endif
+
+    if (count > 0) {
+        flb_plg_debug(ctx->ins, "db: checkpoint of %i file offsets, lag=%"PRId64
+                      " bytes", count, lag);
+    }
+
+    return count;
+}
+
+int flb_tail_db_checkpoint_callback(struct flb_input_instance *ins,
+                                    struct flb_config *config, void *context)
+{
+    struct flb_tail_config *ctx = context;
+
+    flb_tail_db_checkpoint(ctx);
+
     return 0;
 }
 
@@ -17,6 +17,10 @@
  *  limitations under the License.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  /* F_SETLEASE */
+#endif
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -30,6 +34,7 @@
 #include <fluent-bit/flb_info.h>
 #include <fluent-bit/flb_input_plugin.h>
 #include <fluent-bit/flb_parser.h>
+#include <fluent-bit/flb_line_split.h>
 #ifdef FLB_HAVE_REGEX
 #include <fluent-bit/flb_regex.h>
 #include <fluent-bit/flb_hash_table.h>
@@ -46,6 +51,10 @@
 
 #ifdef FLB_SYSTEM_WINDOWS
 #include "win32.h"
+#else
+#include <sys/mman.h>
+#include <signal.h>
+#include <unistd.h>
 #endif
 
 #include <cfl/cfl.h>
@@ -439,6 +448,7 @@ static int process_content(struct flb_tail_file *file, size_t *bytes)
     size_t repl_line_len;
     time_t now = time(NULL);
     struct flb_time out_time = {0};
+    struct flb_line_split ls;
     struct flb_tail_config *ctx;
 
     ctx = (struct flb_tail_config *) file->config;
@@ -456,7 +466,10 @@ static int process_content(struct flb_tail_file *file, size_t *bytes)
         processed_bytes++;
     }
 
-    while (data < end && (p = memchr(data, '\n', end - data))) {
+    /* find the line breaks in batches, not one memchr() per line */
+    flb_line_split_init(&ls, data, end - data, '\n', '\n');
+
+    while (data < end && (p = (char *) flb_line_split_next(&ls))) {
         len = (p - data);
         crlf = 0;
         if (file->skip_next == FLB_TRUE) {
@@ -1065,6 +1078,7 @@ int flb_tail_file_append(char *path, struct stat *st, int mode,
     file->dmode_firstline = false;
 #ifdef FLB_HAVE_SQLDB
     file->db_id     = 0;
+    file->db_offset = 0;
 #endif
     file->skip_next = FLB_FALSE;
     file->skip_warn = FLB_FALSE;
@@ -1268,6 +1282,12 @@ void flb_tail_file_remove(struct flb_tail_file *file)
 #endif
         mk_list_del(&file->_rotate_head);
     }
+#ifdef FLB_HAVE_SQLDB
+    else if (ctx->db && ctx->db_checkpoint_interval > 0) {
+        /* the file is not tracked anymore, store its last offset */
+        flb_tail_db_file_offset_flush(file, ctx);
+    }
+#endif
 
     msgpack_sbuffer_destroy(&file->mult_sbuf);
 
@@ -1368,6 +1388,135 @@ static int adjust_counters(struct flb_tail_config *ctx, struct flb_tail_file *fi
     return FLB_TAIL_OK;
 }
 
+#ifdef __linux__
+/*
+ * Static files read mode 'mmap': map the next window of the file and cut the
+ * lines straight from the mapping, no copy into the file buffer is needed.
+ *
+ * Only complete lines are consumed, the remaining bytes are read again on the
+ * next round. This path is used while the file buffer is empty; when a window
+ * has no complete line the regular read(2) path takes over until the buffer
+ * is drained, it already handles long lines and partial lines at EOF.
+ *
+ * Accessing a mapping past the end of a truncated file raises SIGBUS, so the
+ * window is only mapped under a read lease: while it's held, any open for
+ * writing or truncate of the file blocks in the kernel until the lease is
+ * released (or for lease-break-time, 45 seconds by default, far longer than
+ * reading a window), the file cannot shrink. The lease cannot be taken if
+ * the file is open for writing somewhere else, such a file is read with
+ * read(2).
+ *
+ * Returns FLB_TRUE if some content was consumed, FLB_FALSE if the caller must
+ * use read(2) or -1 on error.
+ */
+static int tail_file_chunk_mmap(struct flb_tail_file *file)
+{
+    int ret;
+    char *map;
+    char *buf_data;
+    size_t buf_len;
+    size_t buf_size;
+    size_t map_len;
+    size_t processed_bytes = 0;
+    off_t map_offset;
+    off_t delta;
+    long page_size;
+    struct stat st;
+    struct flb_tail_config *ctx = file->config;
+
+    if (file->mmap_disabled || file->buf_len > 0 ||
+        file->skip_next == FLB_TRUE || file->decompression_context != NULL) {
+        return FLB_FALSE;
+    }
+
+    /*
+     * A lease break is notified with SIGIO by default, which terminates the
+     * process: use SIGURG instead, ignored unless a handler is set.
+     */
+    fcntl(file->fd, F_SETSIG, SIGURG);
+
+    ret = fcntl(file->fd, F_SETLEASE, F_RDLCK);
+    if (ret == -1) {
+        if (errno != EAGAIN) {
+            /* no permission or no lease support on this file system */
+            flb_plg_debug(ctx->ins, "inode=%"PRIu64" file=%s cannot be "
+                          "leased (%s), using read(2)",
+                          file->inode, file->name, strerror(errno));
+            file->mmap_disabled = FLB_TRUE;
+        }
+        return FLB_FALSE;
+    }
+
+    /* the size cannot shrink anymore until the lease is released */
+    ret = fstat(file->fd, &st);
+    if (ret == -1 || st.st_size <= file->offset) {
+        /* no new content, read(2) path handles it */
+        fcntl(file->fd, F_SETLEASE, F_UNLCK);
+        return FLB_FALSE;
+    }
+
+    page_size = sysconf(_SC_PAGESIZE);
+    map_offset = file->offset - (file->offset % page_size);
+    delta = file->offset - map_offset;
+
+    map_len = st.st_size - file->offset;
+    if (map_len > FLB_TAIL_MMAP_WINDOW) {
+        map_len = FLB_TAIL_MMAP_WINDOW;
+    }
+
+    map = mmap(NULL, delta + map_len, PROT_READ, MAP_PRIVATE,
+               file->fd, map_offset);
+    if (map == MAP_FAILED) {
+        flb_errno();
+        fcntl(file->fd, F_SETLEASE, F_UNLCK);
+        return FLB_FALSE;
+    }
+    madvise(map, delta + map_len, MADV_SEQUENTIAL);
+
+    /* process_content() works on the file buffer, point it to the map */
+    buf_data = file->buf_data;
+    buf_len = file->buf_len;
+    buf_size = file->buf_size;
+
+    file->buf_data = map + delta;
+    file->buf_len = map_len;
+    file->buf_size = map_len;
+
+    ret = process_content(file, &processed_bytes);
+
+    file->buf_data = buf_data;
+    file->buf_len = buf_len;
+    file->buf_size = buf_size;
+    file->parsed = 0;
+
+    munmap(map, delta + map_len);
+    fcntl(file->fd, F_SETLEASE, F_UNLCK);
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    if (processed_bytes == 0) {
+        return FLB_FALSE;
+    }
+
+    file->offset += processed_bytes;
+    file->stream_offset += processed_bytes;
+
+    /* keep the descriptor position in sync for the read(2) path */
+    if (lseek(file->fd, file->offset, SEEK_SET) == -1) {
+        flb_errno();
+        return -1;
+    }
+
+    if (ctx->file_cache_advise) {
+        posix_fadvise(file->fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+
+    return FLB_TRUE;
+}
+#endif
+
 int flb_tail_file_chunk(struct flb_tail_file *file)
 {
     size_t                  decompression_buffer_capacity;
@@ -1390,6 +1539,26 @@ int flb_tail_file_chunk(struct flb_tail_file *file)
         return FLB_TAIL_BUSY;
     }
 
+#ifdef __linux__
+    if (ctx->read_mode == FLB_TAIL_READ_MODE_MMAP &&
+        file->tail_mode == FLB_TAIL_STATIC) {
+        ret = tail_file_chunk_mmap(file);
+        if (ret == -1) {
+            flb_plg_debug(ctx->ins, "inode=%"PRIu64" file=%s process content ERROR",
+                          file->inode, file->name);
+            return FLB_TAIL_ERROR;
+        }
+        else if (ret == FLB_TRUE) {
+#ifdef FLB_HAVE_SQLDB
+            if (ctx->db) {
+                flb_tail_db_file_offset(file, ctx);
+            }
+#endif
+            return adjust_counters(ctx, file);
+        }
+    }
+#endif
+
     file_buffer_capacity = (file->buf_size - file->buf_len) - 1;
     stream_data_length = 0;
 
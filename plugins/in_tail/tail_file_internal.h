@@ -116,6 +116,7 @@ struct flb_tail_file {
 
     /* database reference */
     uint64_t db_id;
+    int64_t db_offset;          /* offset stored in the database */
 
     uint64_t hash_bits;
     flb_sds_t hash_key;
@@ -129,6 +130,12 @@ struct flb_tail_file {
     struct flb_log_event_encoder *ml_log_event_encoder;
     struct flb_log_event_encoder *sl_log_event_encoder;
 
+    /*
+     * read_mode 'mmap': set when the file cannot be leased (permissions or
+     * file system support), it's read with read(2) for good.
+     */
+    int mmap_disabled;
+
     /* reference */
     int tail_mode;
     struct flb_tail_config *config;
@@ -53,6 +53,15 @@
 #define SQL_DELETE_FILE                                                 \
     "DELETE FROM in_tail_files WHERE id=@id;"
 
+#define SQL_BEGIN_TRANSACTION                   \
+    "BEGIN TRANSACTION;"
+
+#define SQL_COMMIT_TRANSACTION                  \
+    "COMMIT;"
+
+#define SQL_ROLLBACK_TRANSACTION                \
+    "ROLLBACK;"
+
 #define SQL_STMT_START_PARAM "(?"
 #define SQL_STMT_START_PARAM_LEN (sizeof(SQL_STMT_START_PARAM) - 1)
 
@@ -24,6 +24,7 @@
 #include <fluent-bit/flb_pack.h>
 #include <fluent-bit/flb_error.h>
 #include <fluent-bit/flb_msgpack_append_message.h>
+#include <fluent-bit/flb_line_split.h>
 
 #include "tcp.h"
 #include "tcp_conn.h"
@@ -189,6 +190,7 @@ static ssize_t parse_payload_none(struct tcp_conn *conn)
     char *buf;
     char *s;
     char *separator;
+    struct flb_line_split ls;
     struct flb_in_tcp_config *ctx;
 
     ctx = conn->ctx;
@@ -201,7 +203,13 @@ static ssize_t parse_payload_none(struct tcp_conn *conn)
 
     flb_log_event_encoder_reset(ctx->log_encoder);
 
-    while ((s = strstr(buf, separator))) {
+    /* single byte separators (the default) are located in batches */
+    if (sep_len == 1) {
+        flb_line_split_init(&ls, buf, conn->buf_len, separator[0], separator[0]);
+    }
+
+    while ((s = (sep_len == 1) ? (char *) flb_line_split_next(&ls) :
+                                 strstr(buf, separator))) {
         len = (s - buf);
         if (len == 0) {
             break;
@@ -207,6 +207,16 @@ static int io_unix_write(struct flb_connection *unused, int deprecated_fd, const
     return flb_io_fd_write(uds_conn, data, len, out_len);
 }
 
+static int io_unix_writev(struct flb_connection *unused, int deprecated_fd,
+                          const struct iovec *iov, int iovcnt, size_t *out_len)
+{
+    flb_sockfd_t uds_conn;
+
+    uds_conn = forward_uds_get_conn(NULL, NULL);
+
+    return flb_io_fd_writev(uds_conn, iov, iovcnt, out_len);
+}
+
 static int io_unix_read(struct flb_connection *unused, int deprecated_fd, void* buf,size_t len)
 {
     flb_sockfd_t uds_conn;
@@ -249,6 +259,12 @@ static int io_net_write(struct flb_connection *conn, int unused_fd,
     return flb_io_net_write(conn, data, len, out_len);
 }
 
+static int io_net_writev(struct flb_connection *conn, int unused_fd,
+                         const struct iovec *iov, int iovcnt, size_t *out_len)
+{
+    return flb_io_net_writev(conn, iov, iovcnt, out_len);
+}
+
 static int io_net_read(struct flb_connection *conn, int unused_fd,
                        void* buf, size_t len)
 {
@@ -739,8 +755,8 @@ static int forward_read_ack(struct flb_forward *ctx,
 static int forward_config_init(struct flb_forward_config *fc,
                                struct flb_forward *ctx)
 {
-    if (fc->io_read == NULL || fc->io_write == NULL) {
-        flb_plg_error(ctx->ins, "io_read/io_write is NULL");
+    if (fc->io_read == NULL || fc->io_write == NULL || fc->io_writev == NULL) {
+        flb_plg_error(ctx->ins, "io_read/io_write/io_writev is NULL");
         return -1;
     }
 
@@ -833,6 +849,15 @@ static int config_set_properties(struct flb_upstream_node *node,
         fc->time_as_integer = FLB_FALSE;
     }
 
+    /* forward mode entries sent from the chunk */
+    tmp = config_get_property("passthrough", node, ctx);
+    if (tmp) {
+        fc->passthrough = flb_utils_bool(tmp);
+    }
+    else {
+        fc->passthrough = FLB_TRUE;
+    }
+
     /* send always options (with size) */
     tmp = config_get_property("send_options", node, ctx);
     if (tmp) {
@@ -966,6 +991,7 @@ static int forward_config_ha(const char *upstream_file,
         fc->unix_fd = -1;
         fc->secured = FLB_FALSE;
         fc->io_write = io_net_write;
+        fc->io_writev = io_net_writev;
         fc->io_read  = io_net_read;
 
         /* Is TLS enabled ? */
@@ -1015,6 +1041,7 @@ static int forward_config_simple(struct flb_forward *ctx,
     fc->unix_fd = -1;
     fc->secured = FLB_FALSE;
     fc->io_write = NULL;
+    fc->io_writev = NULL;
     fc->io_read  = NULL;
 
     /* Set default values */
@@ -1056,6 +1083,7 @@ static int forward_config_simple(struct flb_forward *ctx,
          */
 
         fc->io_write = io_unix_write;
+        fc->io_writev = io_unix_writev;
         fc->io_read  = io_unix_read;
 #else
         flb_plg_error(ctx->ins, "unix_path is not supported");
@@ -1076,6 +1104,7 @@ static int forward_config_simple(struct flb_forward *ctx,
             return -1;
         }
         fc->io_write = io_net_write;
+        fc->io_writev = io_net_writev;
         fc->io_read  = io_net_read;
         ctx->u = upstream;
         flb_output_upstream_set(ctx->u, ins);
@@ -1267,6 +1296,7 @@ static int pack_metricses_payload(msgpack_packer *mp_pck, const void *data, size
  */
 static int flush_forward_mode(struct flb_forward *ctx,
                               struct flb_forward_config *fc,
+                              struct flb_forward_flush *ff,
                               struct flb_connection *u_conn,
                               int event_type,
                               const char *tag, int tag_len,
@@ -1275,6 +1305,7 @@ static int flush_forward_mode(struct flb_forward *ctx,
 {
     int ret;
     int entries;
+    int iovcnt;
     int send_options;
     size_t off = 0;
     size_t bytes_sent;
@@ -1287,6 +1318,8 @@ static int flush_forward_mode(struct flb_forward *ctx,
     size_t final_bytes;
     char *transcoded_buffer;
     size_t transcoded_length;
+    struct iovec *entries_iov;
+    struct iovec iov[3];
 
     transcoded_buffer = NULL;
     transcoded_length = 0;
@@ -1304,6 +1337,35 @@ static int flush_forward_mode(struct flb_forward *ctx,
     /* Tag */
     flb_forward_format_append_tag(ctx, fc, &mp_pck, NULL, tag, tag_len);
 
+    if (ff->entries_iov != NULL) {
+        /*
+         * Passthrough: the entries point into the chunk, the first and the
+         * last buffers of the vector are the header and the options.
+         */
+        msgpack_pack_array(&mp_pck, ff->entries);
+
+        entries_iov = ff->entries_iov;
+        iovcnt = ff->entries_iovcnt;
+
+        entries_iov[0].iov_base = mp_sbuf.data;
+        entries_iov[0].iov_len = mp_sbuf.size;
+        entries_iov[iovcnt - 1].iov_base = opts_buf;
+        entries_iov[iovcnt - 1].iov_len = opts_size;
+
+        ret = fc->io_writev(u_conn, fc->unix_fd, entries_iov,
+                            send_options == FLB_TRUE ? iovcnt : iovcnt - 1,
+                            &bytes_sent);
+
+        msgpack_sbuffer_destroy(&mp_sbuf);
+
+        if (ret == -1) {
+            flb_plg_error(ctx->ins, "could not write forward entries");
+            return FLB_RETRY;
+        }
+
+        goto read_ack;
+    }
+
     if (!fc->fwd_retain_metadata && event_type == FLB_EVENT_TYPE_LOGS) {
         ret = flb_forward_format_transcode(ctx, FLB_LOG_EVENT_FORMAT_FORWARD,
                                            (char *) data, bytes,
@@ -1371,38 +1433,19 @@ static int flush_forward_mode(struct flb_forward *ctx,
         }
     }
 
-    /* Write message header */
-    ret = fc->io_write(u_conn, fc->unix_fd, mp_sbuf.data, mp_sbuf.size, &bytes_sent);
-    if (ret == -1) {
-        flb_plg_error(ctx->ins, "could not write forward header");
-        msgpack_sbuffer_destroy(&mp_sbuf);
-        if (fc->compress == COMPRESS_GZIP) {
-            flb_free(final_data);
-        }
+    /* Write message header, msgpack content / entries and options at once */
+    iov[0].iov_base = mp_sbuf.data;
+    iov[0].iov_len = mp_sbuf.size;
+    iov[1].iov_base = final_data;
+    iov[1].iov_len = final_bytes;
+    iov[2].iov_base = opts_buf;
+    iov[2].iov_len = opts_size;
 
-        if (transcoded_buffer != NULL) {
-            flb_free(transcoded_buffer);
-        }
+    ret = fc->io_writev(u_conn, fc->unix_fd, iov,
+                        send_options == FLB_TRUE ? 3 : 2, &bytes_sent);
 
-        return FLB_RETRY;
-    }
     msgpack_sbuffer_destroy(&mp_sbuf);
 
-    /* Write msgpack content / entries */
-    ret = fc->io_write(u_conn, fc->unix_fd, final_data, final_bytes, &bytes_sent);
-    if (ret == -1) {
-        flb_plg_error(ctx->ins, "could not write forward entries");
-        if (fc->compress == COMPRESS_GZIP) {
-            flb_free(final_data);
-        }
-
-        if (transcoded_buffer != NULL) {
-            flb_free(transcoded_buffer);
-        }
-
-        return FLB_RETRY;
-    }
-
     if (fc->compress == COMPRESS_GZIP) {
         flb_free(final_data);
     }
@@ -1411,15 +1454,12 @@ static int flush_forward_mode(struct flb_forward *ctx,
         flb_free(transcoded_buffer);
     }
 
-    /* Write options */
-    if (send_options == FLB_TRUE) {
-        ret = fc->io_write(u_conn, fc->unix_fd, opts_buf, opts_size, &bytes_sent);
-        if (ret == -1) {
-            flb_plg_error(ctx->ins, "could not write forward options");
-            return FLB_RETRY;
-        }
+    if (ret == -1) {
+        flb_plg_error(ctx->ins, "could not write forward entries");
+        return FLB_RETRY;
     }
 
+read_ack:
     /* If the sender requires 'ack' from the remote end-point */
     if (fc->require_ack_response) {
         msgpack_unpacked_init(&result);
@@ -1509,6 +1549,14 @@ static int flush_forward_compat_mode(struct flb_forward *ctx,
     return FLB_OK;
 }
 
+static void forward_flush_destroy(struct flb_forward_flush *flush_ctx)
+{
+    if (flush_ctx->entries_iov) {
+        flb_free(flush_ctx->entries_iov);
+    }
+    flb_free(flush_ctx);
+}
+
 static void cb_forward_flush(struct flb_event_chunk *event_chunk,
                              struct flb_output_flush *out_flush,
                              struct flb_input_instance *i_ins,
@@ -1575,7 +1623,7 @@ static void cb_forward_flush(struct flb_event_chunk *event_chunk,
             flb_plg_error(ctx->ins, "no upstream connections available");
             msgpack_sbuffer_destroy(&mp_sbuf);
             flb_free(out_buf);
-            flb_free(flush_ctx);
+            forward_flush_destroy(flush_ctx);
             FLB_OUTPUT_RETURN(FLB_RETRY);
         }
 
@@ -1589,7 +1637,7 @@ static void cb_forward_flush(struct flb_event_chunk *event_chunk,
 
             msgpack_sbuffer_destroy(&mp_sbuf);
             flb_free(out_buf);
-            flb_free(flush_ctx);
+            forward_flush_destroy(flush_ctx);
             FLB_OUTPUT_RETURN(FLB_RETRY);
         }
 
@@ -1619,7 +1667,7 @@ static void cb_forward_flush(struct flb_event_chunk *event_chunk,
 
             msgpack_sbuffer_destroy(&mp_sbuf);
             flb_free(out_buf);
-            flb_free(flush_ctx);
+            forward_flush_destroy(flush_ctx);
             FLB_OUTPUT_RETURN(FLB_RETRY);
         }
     }
@@ -1638,7 +1686,7 @@ static void cb_forward_flush(struct flb_event_chunk *event_chunk,
         flb_free(out_buf);
     }
     else if (mode == MODE_FORWARD) {
-        ret = flush_forward_mode(ctx, fc, u_conn,
+        ret = flush_forward_mode(ctx, fc, flush_ctx, u_conn,
                                  event_chunk->type,
                                  event_chunk->tag, flb_sds_len(event_chunk->tag),
                                  event_chunk->data, event_chunk->size,
@@ -1673,7 +1721,7 @@ static void cb_forward_flush(struct flb_event_chunk *event_chunk,
         }
     }
 
-    flb_free(flush_ctx);
+    forward_flush_destroy(flush_ctx);
     FLB_OUTPUT_RETURN(ret);
 }
 
@@ -1728,6 +1776,12 @@ static struct flb_config_map config_map[] = {
      0, FLB_TRUE, offsetof(struct flb_forward_config, fwd_retain_metadata),
      "Retain metadata when operating in forward mode"
     },
+    {
+     FLB_CONFIG_MAP_BOOL, "passthrough", "true",
+     0, FLB_TRUE, offsetof(struct flb_forward_config, passthrough),
+     "In forward mode, send the records straight from the chunk instead of "
+     "encoding them again"
+    },
     {
      FLB_CONFIG_MAP_STR, "shared_key", NULL,
      0, FLB_FALSE, 0,
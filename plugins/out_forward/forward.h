@@ -25,6 +25,7 @@
 #include <fluent-bit/flb_upstream_ha.h>
 #include <fluent-bit/flb_record_accessor.h>
 #include <fluent-bit/flb_connection.h>
+#include <fluent-bit/flb_io.h>
 #include <fluent-bit/flb_pthread.h>
 #include <cfl/cfl_list.h>
 
@@ -78,6 +79,7 @@ struct flb_forward_config {
     struct mk_list *extra_options;
 
     int fwd_retain_metadata;  /* Do not drop metadata in forward mode */
+    int passthrough;          /* Send forward mode entries from the chunk */
 
     /* config */
     flb_sds_t shared_key;        /* shared key                   */
@@ -101,6 +103,8 @@ struct flb_forward_config {
 #endif
     int (*io_write)(struct flb_connection* conn, int fd, const void* data,
                         size_t len, size_t *out_len);
+    int (*io_writev)(struct flb_connection* conn, int fd,
+                     const struct iovec *iov, int iovcnt, size_t *out_len);
     int (*io_read)(struct flb_connection* conn, int fd, void* buf, size_t len);
     struct mk_list _head;     /* Link to list flb_forward->configs */
 };
@@ -138,6 +142,11 @@ struct flb_forward_ping {
 struct flb_forward_flush {
     struct flb_forward_config *fc;
     char checksum_hex[33];
+
+    /* forward mode entries pointing into the chunk (passthrough) */
+    struct iovec *entries_iov;
+    int entries_iovcnt;
+    int entries;
 };
 
 struct flb_forward_config *flb_forward_target(struct flb_forward *ctx,
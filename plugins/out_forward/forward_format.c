@@ -25,8 +25,10 @@
 #include <fluent-bit/flb_record_accessor.h>
 #include <fluent-bit/flb_log_event_encoder.h>
 #include <fluent-bit/flb_log_event_decoder.h>
+#include <mpack/mpack.h>
 
 #include "forward.h"
+#include "forward_format.h"
 
 void flb_forward_format_bin_to_hex(uint8_t *buf, size_t len, char *out)
 {
@@ -86,13 +88,16 @@ static int append_options(struct flb_forward *ctx,
                           struct flb_forward_config *fc,
                           int event_type,
                           msgpack_packer *mp_pck,
-                          int entries, void *data, size_t bytes,
+                          int entries,
+                          const struct iovec *iov, int iovcnt,
                           msgpack_object *metadata,
                           char *out_chunk)
 {
+    int i;
     char *chunk = NULL;
     uint8_t checksum[64];
     int     result;
+    struct flb_hash hash;
     struct mk_list *head;
     struct flb_config_map_val *mv;
     struct flb_mp_map_header mh;
@@ -107,9 +112,17 @@ static int append_options(struct flb_forward *ctx,
          * for ack we calculate  sha512 of context, take 16 bytes,
          * make 32 byte hex string of it
          */
-        result = flb_hash_simple(FLB_HASH_SHA512,
-                                 data, bytes,
-                                 checksum, sizeof(checksum));
+        result = flb_hash_init(&hash, FLB_HASH_SHA512);
+
+        for (i = 0; i < iovcnt && result == FLB_CRYPTO_SUCCESS; i++) {
+            result = flb_hash_update(&hash, iov[i].iov_base, iov[i].iov_len);
+        }
+
+        if (result == FLB_CRYPTO_SUCCESS) {
+            result = flb_hash_finalize(&hash, checksum, sizeof(checksum));
+        }
+
+        flb_hash_cleanup(&hash);
 
         if (result != FLB_CRYPTO_SUCCESS) {
             return -1;
@@ -227,6 +240,7 @@ static int flb_forward_format_message_mode(struct flb_forward *ctx,
     char chunk_buf[33];
     msgpack_packer   mp_pck;
     msgpack_sbuffer  mp_sbuf;
+    struct iovec iov;
     struct flb_time tm;
     struct flb_log_event_decoder log_decoder;
     struct flb_log_event log_event;
@@ -293,8 +307,11 @@ static int flb_forward_format_message_mode(struct flb_forward *ctx,
             chunk = chunk_buf;
         }
 
+        iov.iov_base = (char *) data + pre;
+        iov.iov_len = record_size;
+
         append_options(ctx, fc, FLB_EVENT_TYPE_LOGS, &mp_pck, 0,
-                       (char *) data + pre, record_size,
+                       &iov, 1,
                        log_event.metadata,
                        chunk);
 
@@ -390,6 +407,207 @@ int flb_forward_format_transcode(
     return result;
 }
 
+static int passthrough_grow(struct iovec **iov, int *size)
+{
+    struct iovec *tmp;
+
+    tmp = flb_realloc(*iov, sizeof(struct iovec) * *size * 2);
+    if (!tmp) {
+        flb_errno();
+        return -1;
+    }
+    *iov = tmp;
+    *size *= 2;
+
+    return 0;
+}
+
+/* Add the bytes 'start' to 'end' of 'data', merged with the last buffer if they follow it */
+static int passthrough_append(struct iovec **iov, int *count, int *size,
+                              const char *data, size_t start, size_t end)
+{
+    struct iovec *last;
+
+    if (*count > 1) {
+        last = &(*iov)[*count - 1];
+        if ((char *) last->iov_base + last->iov_len == data + start) {
+            last->iov_len += end - start;
+            return 0;
+        }
+    }
+
+    if (*count == *size && passthrough_grow(iov, size) == -1) {
+        return -1;
+    }
+
+    (*iov)[*count].iov_base = (char *) data + start;
+    (*iov)[*count].iov_len = end - start;
+    (*count)++;
+
+    return 0;
+}
+
+/* Skip a timestamp, only the types the Forward protocol defines are valid */
+static int passthrough_timestamp(mpack_reader_t *reader)
+{
+    mpack_tag_t tag;
+
+    tag = mpack_read_tag(reader);
+    if (mpack_reader_error(reader) != mpack_ok) {
+        return -1;
+    }
+
+    if (mpack_tag_type(&tag) == mpack_type_uint) {
+        return 0;
+    }
+
+    if (mpack_tag_type(&tag) != mpack_type_ext ||
+        mpack_tag_ext_exttype(&tag) != 0 ||
+        mpack_tag_ext_length(&tag) != 8) {
+        return -1;
+    }
+
+    mpack_skip_bytes(reader, 8);
+    mpack_done_ext(reader);
+
+    return 0;
+}
+
+/*
+ * Forward Protocol: Forward Mode passthrough
+ * ------------------------------------------
+ * The chunk records are '[[TIMESTAMP, METADATA], RECORD]' while a Forward
+ * mode entry is '[TIMESTAMP, RECORD]'. Instead of decoding and encoding the
+ * records again, the entries are a vector of buffers that point into the
+ * chunk: the inner array header with the timestamp, then the record map.
+ * Records without metadata are taken as they are.
+ *
+ * The first and the last slots of the vector are left empty for the message
+ * header and the options. Returns -1 if a record cannot be sent this way
+ * (e.g. group markers), the caller must transcode the records then.
+ */
+int flb_forward_format_passthrough(const void *data, size_t bytes,
+                                   struct iovec **out_iov, int *out_iovcnt,
+                                   int *out_entries)
+{
+    int ret = 0;
+    int size;
+    int count;
+    int entries = 0;
+    size_t start;
+    size_t ts_start;
+    size_t ts_end;
+    size_t body_start;
+    size_t end;
+    uint32_t i;
+    uint32_t fields;
+    const char *buf = data;
+    struct iovec *iov;
+    mpack_tag_t tag;
+    mpack_reader_t reader;
+
+    size = 64;
+    iov = flb_malloc(sizeof(struct iovec) * size);
+    if (!iov) {
+        flb_errno();
+        return -1;
+    }
+    iov[0].iov_base = NULL;
+    iov[0].iov_len = 0;
+    count = 1;
+
+    mpack_reader_init_data(&reader, buf, bytes);
+
+    while (ret == 0 && mpack_reader_remaining(&reader, NULL) > 0) {
+        start = bytes - mpack_reader_remaining(&reader, NULL);
+
+        tag = mpack_read_tag(&reader);
+        if (mpack_reader_error(&reader) != mpack_ok ||
+            mpack_tag_type(&tag) != mpack_type_array ||
+            mpack_tag_array_count(&tag) != 2) {
+            ret = -1;
+            break;
+        }
+
+        ts_start = bytes - mpack_reader_remaining(&reader, NULL);
+        tag = mpack_peek_tag(&reader);
+
+        if (mpack_tag_type(&tag) == mpack_type_array) {
+            /* [TIMESTAMP, METADATA] header: keep its array header and timestamp */
+            tag = mpack_read_tag(&reader);
+            fields = mpack_tag_array_count(&tag);
+            if (fields != 2 || passthrough_timestamp(&reader) == -1) {
+                ret = -1;
+                break;
+            }
+            ts_end = bytes - mpack_reader_remaining(&reader, NULL);
+
+            for (i = 1; i < fields; i++) {
+                mpack_discard(&reader);
+            }
+            mpack_done_array(&reader);
+        }
+        else {
+            /* legacy record without metadata, it's already an entry */
+            if (passthrough_timestamp(&reader) == -1) {
+                ret = -1;
+                break;
+            }
+            ts_start = start;
+            ts_end = start;
+        }
+
+        body_start = bytes - mpack_reader_remaining(&reader, NULL);
+        if (ts_end == start) {
+            body_start = start;
+        }
+        tag = mpack_peek_tag(&reader);
+        if (mpack_tag_type(&tag) != mpack_type_map) {
+            ret = -1;
+            break;
+        }
+        mpack_discard(&reader);
+        mpack_done_array(&reader);
+
+        if (mpack_reader_error(&reader) != mpack_ok) {
+            ret = -1;
+            break;
+        }
+
+        end = bytes - mpack_reader_remaining(&reader, NULL);
+
+        if (ts_end > ts_start) {
+            ret = passthrough_append(&iov, &count, &size, buf, ts_start, ts_end);
+        }
+        if (ret == 0) {
+            ret = passthrough_append(&iov, &count, &size, buf, body_start, end);
+        }
+        entries++;
+    }
+
+    mpack_reader_destroy(&reader);
+
+    /* last slot for the options */
+    if (ret == 0 && count == size) {
+        ret = passthrough_grow(&iov, &size);
+    }
+
+    if (ret == -1 || entries == 0) {
+        flb_free(iov);
+        return -1;
+    }
+
+    iov[count].iov_base = NULL;
+    iov[count].iov_len = 0;
+    count++;
+
+    *out_iov = iov;
+    *out_iovcnt = count;
+    *out_entries = entries;
+
+    return 0;
+}
+
 /*
  * Forward Protocol: Forward Mode
  * ------------------------------
@@ -412,6 +630,7 @@ static int flb_forward_format_forward_mode(struct flb_forward *ctx,
     msgpack_sbuffer  mp_sbuf;
     char *transcoded_buffer;
     size_t transcoded_length;
+    struct iovec iov;
 
     msgpack_sbuffer_init(&mp_sbuf);
     msgpack_packer_init(&mp_pck, &mp_sbuf, msgpack_sbuffer_write);
@@ -423,32 +642,56 @@ static int flb_forward_format_forward_mode(struct flb_forward *ctx,
         chunk = chunk_buf;
     }
 
-    if (fc->send_options == FLB_TRUE || (event_type == FLB_EVENT_TYPE_METRICS || event_type == FLB_EVENT_TYPE_TRACES)) {
-        if (event_type == FLB_EVENT_TYPE_LOGS) {
-            entries = flb_mp_count(data, bytes);
-        }
-        else {
-            /* for non logs, we don't count the number of entries */
-            entries = 0;
+    /* send the entries straight from the chunk if the metadata is dropped */
+    if (ff && fc->passthrough && !fc->fwd_retain_metadata &&
+        fc->compress == COMPRESS_NONE && event_type == FLB_EVENT_TYPE_LOGS) {
+        result = flb_forward_format_passthrough(data, bytes,
+                                                &ff->entries_iov,
+                                                &ff->entries_iovcnt,
+                                                &ff->entries);
+        if (result == -1) {
+            flb_plg_debug(ctx->ins, "records cannot be passed through, "
+                          "transcoding them");
         }
+    }
 
-        if (!fc->fwd_retain_metadata && event_type == FLB_EVENT_TYPE_LOGS) {
+    if (fc->send_options == FLB_TRUE || (event_type == FLB_EVENT_TYPE_METRICS || event_type == FLB_EVENT_TYPE_TRACES)) {
+        if (ff && ff->entries_iov) {
+            /* the checksum covers the entries, not the header and options */
+            append_options(ctx, fc, event_type, &mp_pck, ff->entries,
+                           ff->entries_iov + 1, ff->entries_iovcnt - 2,
+                           NULL, chunk);
+        }
+        else if (!fc->fwd_retain_metadata && event_type == FLB_EVENT_TYPE_LOGS) {
+            entries = flb_mp_count(data, bytes);
             result = flb_forward_format_transcode(ctx, FLB_LOG_EVENT_FORMAT_FORWARD,
                                                   (char *) data, bytes,
                                                   &transcoded_buffer,
                                                   &transcoded_length);
 
             if (result == 0) {
+                iov.iov_base = transcoded_buffer;
+                iov.iov_len = transcoded_length;
+
                 append_options(ctx, fc, event_type, &mp_pck, entries,
-                               transcoded_buffer,
-                               transcoded_length,
-                               NULL, chunk);
+                               &iov, 1, NULL, chunk);
 
                 free(transcoded_buffer);
             }
         }
         else {
-            append_options(ctx, fc, event_type, &mp_pck, entries, (char *) data, bytes, NULL, chunk);
+            if (event_type == FLB_EVENT_TYPE_LOGS) {
+                entries = flb_mp_count(data, bytes);
+            }
+            else {
+                /* for non logs, we don't count the number of entries */
+                entries = 0;
+            }
+
+            iov.iov_base = (void *) data;
+            iov.iov_len = bytes;
+
+            append_options(ctx, fc, event_type, &mp_pck, entries, &iov, 1, NULL, chunk);
         }
     }
 
@@ -477,6 +720,7 @@ static int flb_forward_format_forward_compat_mode(struct flb_forward *ctx,
     char chunk_buf[33];
     msgpack_packer   mp_pck;
     msgpack_sbuffer  mp_sbuf;
+    struct iovec iov;
     struct flb_log_event_decoder log_decoder;
     struct flb_log_event log_event;
     int ret;
@@ -532,8 +776,11 @@ static int flb_forward_format_forward_compat_mode(struct flb_forward *ctx,
     }
 
     if (fc->send_options == FLB_TRUE) {
+        iov.iov_base = (void *) data;
+        iov.iov_len = bytes;
+
         append_options(ctx, fc, FLB_EVENT_TYPE_LOGS, &mp_pck, entries,
-                       (char *) data, bytes, NULL, chunk);
+                       &iov, 1, NULL, chunk);
     }
 
     flb_log_event_decoder_destroy(&log_decoder);
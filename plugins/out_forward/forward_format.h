@@ -40,6 +40,10 @@ int flb_forward_format(struct flb_config *config,
                        const void *data, size_t bytes,
                        void **out_buf, size_t *out_size);
 
+int flb_forward_format_passthrough(const void *data, size_t bytes,
+                                   struct iovec **out_iov, int *out_iovcnt,
+                                   int *out_entries);
+
 int flb_forward_format_transcode(
         struct flb_forward *ctx, int format,
         char *input_buffer, size_t input_length,
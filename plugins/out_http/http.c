@@ -26,7 +26,7 @@
 #include <fluent-bit/flb_utils.h>
 #include <fluent-bit/flb_pack.h>
 #include <fluent-bit/flb_sds.h>
-#include <fluent-bit/flb_gzip.h>
+#include <fluent-bit/flb_compression.h>
 #include <fluent-bit/flb_record_accessor.h>
 #include <fluent-bit/flb_log_event_decoder.h>
 #include <msgpack.h>
@@ -139,12 +139,13 @@ static int http_post(struct flb_out_http *ctx,
     payload_size = body_len;
 
     /* Should we compress the payload ? */
-    if (ctx->compress_gzip == FLB_TRUE) {
-        ret = flb_gzip_compress((void *) body, body_len,
-                                &payload_buf, &payload_size);
+    if (ctx->compression != FLB_COMPRESSION_ALGORITHM_NONE) {
+        ret = flb_compress(ctx->compression, (void *) body, body_len,
+                           &payload_buf, &payload_size);
         if (ret == -1) {
             flb_plg_error(ctx->ins,
-                          "cannot gzip payload, disabling compression");
+                          "cannot %s payload, disabling compression",
+                          flb_compression_get_algorithm_name(ctx->compression));
         }
         else {
             compressed = FLB_TRUE;
@@ -207,9 +208,17 @@ static int http_post(struct flb_out_http *ctx,
                             tag, tag_len);
     }
 
-    /* Content Encoding: gzip */
+    /* Content Encoding */
     if (compressed == FLB_TRUE) {
-        flb_http_set_content_encoding_gzip(c);
+        if (ctx->compression == FLB_COMPRESSION_ALGORITHM_GZIP) {
+            flb_http_set_content_encoding_gzip(c);
+        }
+        else if (ctx->compression == FLB_COMPRESSION_ALGORITHM_ZSTD) {
+            flb_http_set_content_encoding_zstd(c);
+        }
+        else if (ctx->compression == FLB_COMPRESSION_ALGORITHM_LZ4) {
+            flb_http_set_content_encoding_lz4(c);
+        }
     }
 
     /* Basic Auth headers */
@@ -696,7 +705,8 @@ static struct flb_config_map config_map[] = {
     {
      FLB_CONFIG_MAP_STR, "compress", NULL,
      0, FLB_FALSE, 0,
-     "Set payload compression mechanism. Option available is 'gzip'"
+     "Set payload compression mechanism. Options available are 'gzip', "
+     "'zstd' and 'lz4'"
     },
     {
      FLB_CONFIG_MAP_SLIST_1, "header", NULL,
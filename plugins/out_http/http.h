@@ -83,8 +83,8 @@ struct flb_out_http {
     /* Include tag in header */
     flb_sds_t header_tag;
 
-    /* Compression mode (gzip) */
-    int compress_gzip;
+    /* Compression algorithm (FLB_COMPRESSION_ALGORITHM_*) */
+    int compression;
 
     /* Allow duplicated headers */
     int allow_dup_headers;
@@ -22,6 +22,7 @@
 #include <fluent-bit/flb_pack.h>
 #include <fluent-bit/flb_sds.h>
 #include <fluent-bit/flb_kv.h>
+#include <fluent-bit/flb_compression.h>
 #include <fluent-bit/flb_record_accessor.h>
 #ifdef FLB_HAVE_SIGNV4
 #ifdef FLB_HAVE_AWS
@@ -251,12 +252,21 @@ struct flb_out_http *flb_http_conf_create(struct flb_output_instance *ins,
         }
     }
 
-    /* Compress (gzip) */
+    /* Compress (gzip, zstd or lz4) */
     tmp = flb_output_get_property("compress", ins);
-    ctx->compress_gzip = FLB_FALSE;
+    ctx->compression = FLB_COMPRESSION_ALGORITHM_NONE;
     if (tmp) {
-        if (strcasecmp(tmp, "gzip") == 0) {
-            ctx->compress_gzip = FLB_TRUE;
+        ret = flb_compression_get_algorithm_by_name(tmp, strlen(tmp));
+        if (ret == -1) {
+            flb_plg_error(ctx->ins, "unrecognized 'compress' option '%s'. "
+                          "Compression is disabled.", tmp);
+        }
+        else if (flb_compression_is_supported(ret) == FLB_FALSE) {
+            flb_plg_error(ctx->ins, "'%s' compression is not supported by "
+                          "this build. Compression is disabled.", tmp);
+        }
+        else {
+            ctx->compression = ret;
         }
     }
 
@@ -31,7 +31,7 @@
 #include <fluent-otel-proto/fluent-otel.h>
 
 #include <cmetrics/cmetrics.h>
-#include <fluent-bit/flb_gzip.h>
+#include <fluent-bit/flb_compression.h>
 #include <cmetrics/cmt_encode_opentelemetry.h>
 
 #include <ctraces/ctraces.h>
@@ -80,21 +80,23 @@ int opentelemetry_http_post(struct opentelemetry_context *ctx,
         return FLB_RETRY;
     }
 
-    if (ctx->compress_gzip) {
-        ret = flb_gzip_compress((void *) body, body_len,
-                                &final_body, &final_body_len);
+    final_body = (void *) body;
+    final_body_len = body_len;
+
+    if (ctx->compression != FLB_COMPRESSION_ALGORITHM_NONE) {
+        ret = flb_compress(ctx->compression, (void *) body, body_len,
+                           &final_body, &final_body_len);
 
         if (ret == 0) {
             compressed = FLB_TRUE;
         }
         else {
-            flb_plg_error(ctx->ins, "cannot gzip payload, disabling compression");
+            flb_plg_error(ctx->ins, "cannot %s payload, disabling compression",
+                          flb_compression_get_algorithm_name(ctx->compression));
+            final_body = (void *) body;
+            final_body_len = body_len;
         }
     }
-    else {
-        final_body = (void *) body;
-        final_body_len = body_len;
-    }
 
     /* Create HTTP client context */
     c = flb_http_client(u_conn, FLB_HTTP_POST, uri,
@@ -151,8 +153,17 @@ int opentelemetry_http_post(struct opentelemetry_context *ctx,
                             val->str, flb_sds_len(val->str));
     }
 
+    /* Content Encoding */
     if (compressed) {
-        flb_http_set_content_encoding_gzip(c);
+        if (ctx->compression == FLB_COMPRESSION_ALGORITHM_GZIP) {
+            flb_http_set_content_encoding_gzip(c);
+        }
+        else if (ctx->compression == FLB_COMPRESSION_ALGORITHM_ZSTD) {
+            flb_http_set_content_encoding_zstd(c);
+        }
+        else if (ctx->compression == FLB_COMPRESSION_ALGORITHM_LZ4) {
+            flb_http_set_content_encoding_lz4(c);
+        }
     }
 
     ret = flb_http_do(c, &b_sent);
@@ -530,7 +541,9 @@ static struct flb_config_map config_map[] = {
     {
      FLB_CONFIG_MAP_STR, "compress", NULL,
      0, FLB_FALSE, 0,
-     "Set payload compression mechanism. Option available is 'gzip'"
+     "Set payload compression mechanism. Options available are 'gzip', "
+     "'zstd' and 'lz4'. The OTLP specification only requires receivers to "
+     "support 'gzip'"
     },
     /*
      * Logs Properties
@@ -140,8 +140,8 @@ struct opentelemetry_context {
     /* instance context */
     struct flb_output_instance *ins;
 
-    /* Compression mode (gzip) */
-    int compress_gzip;
+    /* Compression algorithm (FLB_COMPRESSION_ALGORITHM_*) */
+    int compression;
 
     /* FLB/OTLP Record accessor patterns */
     struct flb_record_accessor *ra_meta_schema;
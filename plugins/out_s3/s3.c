@@ -130,6 +130,17 @@ int s3_plugin_under_test()
     return FLB_FALSE;
 }
 
+/*
+ * Compression types applied to the whole payload and advertised through the
+ * Content-Encoding header (unlike 'arrow', which changes the object format).
+ */
+static inline int s3_content_encoding_compression(struct flb_s3 *ctx)
+{
+    return ctx->compression == FLB_AWS_COMPRESS_GZIP ||
+           ctx->compression == FLB_AWS_COMPRESS_ZSTD ||
+           ctx->compression == FLB_AWS_COMPRESS_LZ4;
+}
+
 int create_headers(struct flb_s3 *ctx, char *body_md5,
                    struct flb_aws_header **headers, int *num_headers,
                    int multipart_upload)
@@ -141,7 +152,7 @@ int create_headers(struct flb_s3 *ctx, char *body_md5,
     if (ctx->content_type != NULL) {
         headers_len++;
     }
-    if (ctx->compression == FLB_AWS_COMPRESS_GZIP) {
+    if (s3_content_encoding_compression(ctx)) {
         headers_len++;
     }
     if (ctx->canned_acl != NULL) {
@@ -171,8 +182,10 @@ int create_headers(struct flb_s3 *ctx, char *body_md5,
         s3_headers[n].val_len = strlen(ctx->content_type);
         n++;
     }
-    if (ctx->compression == FLB_AWS_COMPRESS_GZIP) {
+    if (s3_content_encoding_compression(ctx)) {
         s3_headers[n] = content_encoding_header;
+        s3_headers[n].val = (char *) flb_aws_compression_get_keyword(ctx->compression);
+        s3_headers[n].val_len = strlen(s3_headers[n].val);
         n++;
     }
     if (ctx->canned_acl != NULL) {
@@ -674,7 +687,7 @@ static int cb_s3_init(struct flb_output_instance *ins,
             flb_plg_error(ctx->ins, "upload_chunk_size must be at least 5,242,880 bytes");
             return -1;
         }
-        if (ctx->compression == FLB_AWS_COMPRESS_GZIP) {
+        if (s3_content_encoding_compression(ctx)) {
             if(ctx->upload_chunk_size > MAX_CHUNKED_UPLOAD_COMPRESS_SIZE) {
                 flb_plg_error(ctx->ins, "upload_chunk_size in compressed multipart upload cannot exceed 5GB");
                 return -1;
@@ -998,7 +1011,7 @@ static int upload_data(struct flb_s3 *ctx, struct s3_file *chunk,
         file_first_log_time = chunk->first_log_time;
     }
 
-    if (ctx->compression == FLB_AWS_COMPRESS_GZIP) {
+    if (s3_content_encoding_compression(ctx)) {
         /* Map payload */
         ret = flb_aws_compression_compress(ctx->compression, body, body_size, &payload_buf, &payload_size);
         if (ret == -1) {
@@ -1041,7 +1054,7 @@ static int upload_data(struct flb_s3 *ctx, struct s3_file *chunk,
             goto multipart;
         }
         else {
-            if (ctx->use_put_object == FLB_FALSE && ctx->compression == FLB_AWS_COMPRESS_GZIP) {
+            if (ctx->use_put_object == FLB_FALSE && s3_content_encoding_compression(ctx)) {
                 flb_plg_info(ctx->ins, "Pre-compression upload_chunk_size= %zu, After compression, chunk is only %zu bytes, "
                                        "the chunk was too small, using PutObject to upload", preCompress_size, body_size);
             }
@@ -1063,7 +1076,7 @@ put_object:
      * remove chunk from buffer list
      */
     ret = s3_put_object(ctx, tag, file_first_log_time, body, body_size);
-    if (ctx->compression == FLB_AWS_COMPRESS_GZIP) {
+    if (s3_content_encoding_compression(ctx)) {
         flb_free(payload_buf);
     }
     if (ret < 0) {
@@ -1090,7 +1103,7 @@ multipart:
             if (chunk) {
                 s3_store_file_unlock(chunk);
             }
-            if (ctx->compression == FLB_AWS_COMPRESS_GZIP) {
+            if (s3_content_encoding_compression(ctx)) {
                 flb_free(payload_buf);
             }
             return FLB_RETRY;
@@ -1104,7 +1117,7 @@ multipart:
             if (chunk) {
                 s3_store_file_unlock(chunk);
             }
-            if (ctx->compression == FLB_AWS_COMPRESS_GZIP) {
+            if (s3_content_encoding_compression(ctx)) {
                 flb_free(payload_buf);
             }
             return FLB_RETRY;
@@ -1114,7 +1127,7 @@ multipart:
 
     ret = upload_part(ctx, m_upload, body, body_size);
     if (ret < 0) {
-        if (ctx->compression == FLB_AWS_COMPRESS_GZIP) {
+        if (s3_content_encoding_compression(ctx)) {
             flb_free(payload_buf);
         }
         m_upload->upload_errors += 1;
@@ -1131,7 +1144,7 @@ multipart:
         s3_store_file_delete(ctx, chunk);
         chunk = NULL;
     }
-    if (ctx->compression == FLB_AWS_COMPRESS_GZIP) {
+    if (s3_content_encoding_compression(ctx)) {
         flb_free(payload_buf);
     }
     if (m_upload->bytes >= ctx->file_size) {
@@ -2367,10 +2380,11 @@ static struct flb_config_map config_map[] = {
     {
      FLB_CONFIG_MAP_STR, "compression", NULL,
      0, FLB_FALSE, 0,
-    "Compression type for S3 objects. 'gzip' and 'arrow' are the supported values. "
-    "'arrow' is only an available if Apache Arrow was enabled at compile time. "
-    "Defaults to no compression. "
-    "If 'gzip' is selected, the Content-Encoding HTTP Header will be set to 'gzip'."
+    "Compression type for S3 objects. 'gzip', 'zstd', 'lz4' and 'arrow' are the "
+    "supported values. 'zstd' and 'arrow' are only available if zstd and "
+    "Apache Arrow were enabled at compile time. Defaults to no compression. "
+    "If 'gzip', 'zstd' or 'lz4' is selected, the Content-Encoding HTTP Header "
+    "will be set accordingly."
     },
     {
      FLB_CONFIG_MAP_STR, "content_type", NULL,
@@ -23,6 +23,10 @@
 
 #include <fluent-bit/aws/flb_aws_compress.h>
 #include <fluent-bit/flb_gzip.h>
+#include <fluent-bit/flb_lz4.h>
+#ifdef FLB_HAVE_ZSTD
+#include <fluent-bit/flb_zstd.h>
+#endif
 
 #include <stdint.h>
 
@@ -48,6 +52,18 @@ static const struct compression_option compression_options[] = {
         "gzip",
         &flb_gzip_compress
     },
+#ifdef FLB_HAVE_ZSTD
+    {
+        FLB_AWS_COMPRESS_ZSTD,
+        "zstd",
+        &flb_zstd_compress
+    },
+#endif
+    {
+        FLB_AWS_COMPRESS_LZ4,
+        "lz4",
+        &flb_lz4_compress
+    },
 #ifdef FLB_HAVE_ARROW
     {
         FLB_AWS_COMPRESS_ARROW,
@@ -77,6 +93,22 @@ int flb_aws_compression_get_type(const char *compression_keyword)
     return -1;
 }
 
+const char *flb_aws_compression_get_keyword(int compression_type)
+{
+    const struct compression_option *o;
+
+    o = compression_options;
+
+    while (o->compression_type != 0) {
+        if (o->compression_type == compression_type) {
+            return o->compression_keyword;
+        }
+        ++o;
+    }
+
+    return NULL;
+}
+
 int flb_aws_compression_compress(int compression_type, void *in_data, size_t in_len,
                                 void **out_data, size_t *out_len)
 {
@@ -0,0 +1,318 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_aho_corasick.h>
+
+#include <string.h>
+
+struct flb_aho_corasick *flb_aho_corasick_create()
+{
+    struct flb_aho_corasick *ac;
+
+    ac = flb_calloc(1, sizeof(struct flb_aho_corasick));
+    if (!ac) {
+        flb_errno();
+        return NULL;
+    }
+
+    return ac;
+}
+
+static void automaton_destroy(struct flb_aho_corasick *ac)
+{
+    flb_free(ac->next);
+    flb_free(ac->out_offset);
+    flb_free(ac->out);
+    ac->next = NULL;
+    ac->out_offset = NULL;
+    ac->out = NULL;
+    ac->states = 0;
+}
+
+void flb_aho_corasick_destroy(struct flb_aho_corasick *ac)
+{
+    int i;
+
+    if (!ac) {
+        return;
+    }
+
+    for (i = 0; i < ac->patterns; i++) {
+        flb_free(ac->list[i].str);
+    }
+    flb_free(ac->list);
+    automaton_destroy(ac);
+    flb_free(ac);
+}
+
+/*
+ * Add a pattern, returns its id (the position in the 'found' array of the
+ * searches) or -1 on error. Empty patterns are not supported.
+ */
+int flb_aho_corasick_add(struct flb_aho_corasick *ac,
+                         const char *str, size_t len)
+{
+    int size;
+    struct flb_aho_corasick_pattern *tmp;
+
+    if (len == 0 || ac->next) {
+        return -1;
+    }
+
+    if (ac->patterns == ac->patterns_size) {
+        size = ac->patterns_size ? ac->patterns_size * 2 : 8;
+        tmp = flb_realloc(ac->list,
+                          sizeof(struct flb_aho_corasick_pattern) * size);
+        if (!tmp) {
+            flb_errno();
+            return -1;
+        }
+        ac->list = tmp;
+        ac->patterns_size = size;
+    }
+
+    ac->list[ac->patterns].str = flb_malloc(len);
+    if (!ac->list[ac->patterns].str) {
+        flb_errno();
+        return -1;
+    }
+    memcpy(ac->list[ac->patterns].str, str, len);
+    ac->list[ac->patterns].len = len;
+
+    return ac->patterns++;
+}
+
+/*
+ * Compile the patterns into a complete transition table: every state has a
+ * transition for every byte class, failure links are folded into the
+ * table so a search only does one lookup per byte.
+ */
+int flb_aho_corasick_build(struct flb_aho_corasick *ac)
+{
+    int i;
+    int c;
+    int s;
+    int u;
+    int head;
+    int tail;
+    int count;
+    int states;
+    int classes;
+    size_t j;
+    size_t max_states = 1;
+    int32_t *fail = NULL;
+    int32_t *queue = NULL;
+    int32_t *term = NULL;       /* first pattern ending at a state */
+    int32_t *term_next = NULL;  /* next pattern ending at the same state */
+    struct flb_aho_corasick_pattern *pattern;
+
+    if (ac->next || ac->patterns == 0) {
+        return -1;
+    }
+
+    /* byte classes, only the bytes used by the patterns are told apart */
+    memset(ac->class_map, 0, sizeof(ac->class_map));
+    classes = 1;
+    for (i = 0; i < ac->patterns; i++) {
+        pattern = &ac->list[i];
+        for (j = 0; j < pattern->len; j++) {
+            if (ac->class_map[(uint8_t) pattern->str[j]] == 0) {
+                ac->class_map[(uint8_t) pattern->str[j]] = classes++;
+            }
+        }
+        max_states += pattern->len;
+    }
+    ac->classes = classes;
+
+    if (max_states > INT32_MAX / classes) {
+        return -1;
+    }
+
+    ac->next = flb_malloc(sizeof(int32_t) * max_states * classes);
+    fail = flb_calloc(max_states, sizeof(int32_t));
+    queue = flb_malloc(sizeof(int32_t) * max_states);
+    term = flb_malloc(sizeof(int32_t) * max_states);
+    term_next = flb_malloc(sizeof(int32_t) * ac->patterns);
+    ac->out_offset = flb_calloc(max_states + 1, sizeof(int32_t));
+    if (!ac->next || !fail || !queue || !term || !term_next ||
+        !ac->out_offset) {
+        flb_errno();
+        goto error;
+    }
+    memset(ac->next, -1, sizeof(int32_t) * max_states * classes);
+    memset(term, -1, sizeof(int32_t) * max_states);
+
+    /* trie */
+    states = 1;
+    for (i = 0; i < ac->patterns; i++) {
+        pattern = &ac->list[i];
+        s = 0;
+        for (j = 0; j < pattern->len; j++) {
+            c = ac->class_map[(uint8_t) pattern->str[j]];
+            if (ac->next[s * classes + c] == -1) {
+                ac->next[s * classes + c] = states++;
+            }
+            s = ac->next[s * classes + c];
+        }
+        term_next[i] = term[s];
+        term[s] = i;
+    }
+    ac->states = states;
+
+    /* failure links in breadth first order, missing transitions follow them */
+    head = 0;
+    tail = 0;
+    for (c = 0; c < classes; c++) {
+        u = ac->next[c];
+        if (u == -1) {
+            ac->next[c] = 0;
+        }
+        else {
+            fail[u] = 0;
+            queue[tail++] = u;
+        }
+    }
+
+    while (head < tail) {
+        s = queue[head++];
+        for (c = 0; c < classes; c++) {
+            u = ac->next[s * classes + c];
+            if (u == -1) {
+                ac->next[s * classes + c] = ac->next[fail[s] * classes + c];
+            }
+            else {
+                fail[u] = ac->next[fail[s] * classes + c];
+                queue[tail++] = u;
+            }
+        }
+    }
+
+    /*
+     * Outputs of every state: the patterns ending there and the ones of its
+     * failure link, which is closer to the root so it's already resolved.
+     * The count of a state is stored in the next slot of 'out_offset' and
+     * then turned into offsets.
+     */
+    for (i = 0; i < tail; i++) {
+        s = queue[i];
+        count = ac->out_offset[fail[s] + 1];
+        for (u = term[s]; u != -1; u = term_next[u]) {
+            count++;
+        }
+        ac->out_offset[s + 1] = count;
+    }
+    for (s = 0; s < states; s++) {
+        ac->out_offset[s + 1] += ac->out_offset[s];
+    }
+
+    ac->out = flb_malloc(sizeof(int32_t) * (ac->out_offset[states] + 1));
+    if (!ac->out) {
+        flb_errno();
+        goto error;
+    }
+
+    for (i = 0; i < tail; i++) {
+        s = queue[i];
+        count = ac->out_offset[s];
+        for (u = term[s]; u != -1; u = term_next[u]) {
+            ac->out[count++] = u;
+        }
+        for (u = ac->out_offset[fail[s]]; u < ac->out_offset[fail[s] + 1]; u++) {
+            ac->out[count++] = ac->out[u];
+        }
+    }
+
+    /*
+     * Transitions store the row of the next state in the table, with the
+     * sign bit set when the state has outputs, so the search loop does
+     * not need a multiplication nor an extra lookup per byte.
+     */
+    for (j = 0; j < (size_t) states * classes; j++) {
+        u = ac->next[j];
+        ac->next[j] = u * classes;
+        if (ac->out_offset[u] != ac->out_offset[u + 1]) {
+            ac->next[j] |= INT32_MIN;
+        }
+    }
+
+    flb_free(fail);
+    flb_free(queue);
+    flb_free(term);
+    flb_free(term_next);
+    return 0;
+
+error:
+    flb_free(fail);
+    flb_free(queue);
+    flb_free(term);
+    flb_free(term_next);
+    automaton_destroy(ac);
+    return -1;
+}
+
+/*
+ * Look up every pattern in 'buf'. 'found' has one entry per pattern and
+ * must be cleared by the caller, the entries of the patterns found are set
+ * to 1. The search stops once all the patterns were found. Returns the
+ * number of patterns found that were not set already in 'found'.
+ */
+int flb_aho_corasick_search(struct flb_aho_corasick *ac,
+                            const char *buf, size_t len, char *found)
+{
+    int k;
+    int hits = 0;
+    int classes = ac->classes;
+    int patterns = ac->patterns;
+    int32_t s;
+    int32_t v;
+    int32_t row = 0;
+    size_t i;
+    int32_t *out_offset = ac->out_offset;
+    int32_t *next = ac->next;
+    const uint8_t *class_map = ac->class_map;
+    const uint8_t *p = (const uint8_t *) buf;
+
+    if (!next) {
+        return 0;
+    }
+
+    for (i = 0; i < len; i++) {
+        v = next[row + class_map[p[i]]];
+        row = v & INT32_MAX;
+        if (v >= 0) {
+            continue;
+        }
+
+        s = row / classes;
+        for (k = out_offset[s]; k < out_offset[s + 1]; k++) {
+            if (found[ac->out[k]] == 0) {
+                found[ac->out[k]] = 1;
+                hits++;
+            }
+        }
+        if (hits == patterns) {
+            break;
+        }
+    }
+
+    return hits;
+}
@@ -0,0 +1,258 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_atomic.h>
+#include <fluent-bit/flb_thread_storage.h>
+#include <fluent-bit/flb_arena.h>
+
+#include <string.h>
+
+FLB_TLS_DEFINE(struct flb_arena, flb_arena_ctx);
+
+/* usage of all the arenas */
+static uint64_t arena_high_water = 0;
+static uint64_t arena_reserved = 0;
+
+#define ARENA_ALIGN(size) \
+    (((size) + (FLB_ARENA_ALIGN - 1)) & ~((size_t) FLB_ARENA_ALIGN - 1))
+
+static struct flb_arena_block *arena_block_create(struct flb_arena *arena,
+                                                  size_t size)
+{
+    struct flb_arena_block *block;
+
+    block = flb_malloc(ARENA_ALIGN(sizeof(struct flb_arena_block)) + size);
+    if (!block) {
+        flb_errno();
+        return NULL;
+    }
+    block->data = (char *) block + ARENA_ALIGN(sizeof(struct flb_arena_block));
+    block->size = size;
+    block->used = 0;
+    block->next = NULL;
+
+    arena->reserved += size;
+    flb_atomic_add(&arena_reserved, size);
+
+    return block;
+}
+
+static void arena_block_destroy(struct flb_arena *arena,
+                                struct flb_arena_block *block)
+{
+    arena->reserved -= block->size;
+    flb_atomic_sub(&arena_reserved, block->size);
+    flb_free(block);
+}
+
+static void arena_update_high_water(struct flb_arena *arena)
+{
+    uint64_t val;
+
+    if (arena->used <= arena->high_water) {
+        return;
+    }
+    arena->high_water = arena->used;
+
+    /* global maximum */
+    val = flb_atomic_load(&arena_high_water);
+    while (val < arena->high_water) {
+        if (flb_atomic_compare_exchange(&arena_high_water, &val,
+                                        arena->high_water)) {
+            break;
+        }
+    }
+}
+
+struct flb_arena *flb_arena_create(size_t block_size)
+{
+    struct flb_arena *arena;
+
+    arena = flb_calloc(1, sizeof(struct flb_arena));
+    if (!arena) {
+        flb_errno();
+        return NULL;
+    }
+
+    if (block_size == 0) {
+        block_size = FLB_ARENA_BLOCK_SIZE;
+    }
+    arena->block_size = ARENA_ALIGN(block_size);
+
+    return arena;
+}
+
+void flb_arena_destroy(struct flb_arena *arena)
+{
+    struct flb_arena_block *block;
+    struct flb_arena_block *next;
+
+    if (!arena) {
+        return;
+    }
+
+    for (block = arena->block; block; block = next) {
+        next = block->next;
+        arena_block_destroy(arena, block);
+    }
+
+    flb_free(arena);
+}
+
+void *flb_arena_alloc(struct flb_arena *arena, size_t size)
+{
+    size_t block_size;
+    struct flb_arena_block *block;
+
+    size = ARENA_ALIGN(size);
+    block = arena->block;
+
+    if (!block || block->size - block->used < size) {
+        block_size = arena->block_size;
+        if (size > block_size) {
+            block_size = size;
+        }
+
+        block = arena_block_create(arena, block_size);
+        if (!block) {
+            return NULL;
+        }
+        block->next = arena->block;
+        arena->block = block;
+    }
+
+    block->used += size;
+    arena->used += size;
+    arena_update_high_water(arena);
+
+    return block->data + block->used - size;
+}
+
+void *flb_arena_calloc(struct flb_arena *arena, size_t size)
+{
+    void *ptr;
+
+    ptr = flb_arena_alloc(arena, size);
+    if (ptr) {
+        memset(ptr, 0, size);
+    }
+
+    return ptr;
+}
+
+/*
+ * Release everything. If more than one block was needed they are replaced
+ * by a single one that can hold the same content (up to FLB_ARENA_BLOCK_MAX).
+ */
+void flb_arena_reset(struct flb_arena *arena)
+{
+    size_t size;
+    struct flb_arena_block *block;
+    struct flb_arena_block *next;
+
+    block = arena->block;
+    if (block && block->next) {
+        size = arena->used;
+        if (size > FLB_ARENA_BLOCK_MAX) {
+            size = FLB_ARENA_BLOCK_MAX;
+        }
+        if (size < arena->block_size) {
+            size = arena->block_size;
+        }
+
+        for (; block; block = next) {
+            next = block->next;
+            arena_block_destroy(arena, block);
+        }
+        arena->block = arena_block_create(arena, ARENA_ALIGN(size));
+    }
+    else if (block) {
+        block->used = 0;
+    }
+
+    arena->used = 0;
+}
+
+void flb_arena_scope_begin(struct flb_arena *arena)
+{
+    arena->scopes++;
+}
+
+/* Closing the outer scope releases all the allocations */
+void flb_arena_scope_end(struct flb_arena *arena)
+{
+    if (arena->scopes <= 0) {
+        return;
+    }
+
+    arena->scopes--;
+    if (arena->scopes == 0) {
+        flb_arena_reset(arena);
+    }
+}
+
+void flb_arena_init()
+{
+    FLB_TLS_INIT(flb_arena_ctx);
+}
+
+struct flb_arena *flb_arena_thread_get()
+{
+    struct flb_arena *arena;
+
+    arena = FLB_TLS_GET(flb_arena_ctx);
+    if (arena) {
+        return arena;
+    }
+
+    arena = flb_arena_create(FLB_ARENA_BLOCK_SIZE);
+    if (!arena) {
+        return NULL;
+    }
+    FLB_TLS_SET(flb_arena_ctx, arena);
+
+    return arena;
+}
+
+void flb_arena_thread_destroy()
+{
+    struct flb_arena *arena;
+
+    arena = FLB_TLS_GET(flb_arena_ctx);
+    if (!arena) {
+        return;
+    }
+
+    flb_arena_destroy(arena);
+    FLB_TLS_SET(flb_arena_ctx, NULL);
+}
+
+uint64_t flb_arena_high_water()
+{
+    return flb_atomic_load(&arena_high_water);
+}
+
+uint64_t flb_arena_reserved()
+{
+    return flb_atomic_load(&arena_reserved);
+}
@@ -20,8 +20,13 @@
 #include <fluent-bit/flb_info.h>
 #include <fluent-bit/flb_mem.h>
 #include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_compat.h>
 #include <fluent-bit/flb_gzip.h>
+#include <fluent-bit/flb_lz4.h>
 #include <fluent-bit/flb_compression.h>
+#ifdef FLB_HAVE_ZSTD
+#include <fluent-bit/flb_zstd.h>
+#endif
 
 static size_t flb_decompression_context_get_read_buffer_offset(
                 struct flb_decompression_context *context)
@@ -131,7 +136,17 @@ void flb_decompression_context_destroy(struct flb_decompression_context *context
         }
 
         if (context->inner_context != NULL) {
-            flb_gzip_decompression_context_destroy(context->inner_context);
+            if (context->algorithm == FLB_COMPRESSION_ALGORITHM_GZIP) {
+                flb_gzip_decompression_context_destroy(context->inner_context);
+            }
+#ifdef FLB_HAVE_ZSTD
+            else if (context->algorithm == FLB_COMPRESSION_ALGORITHM_ZSTD) {
+                flb_zstd_decompression_context_destroy(context->inner_context);
+            }
+#endif
+            else if (context->algorithm == FLB_COMPRESSION_ALGORITHM_LZ4) {
+                flb_lz4_decompression_context_destroy(context->inner_context);
+            }
 
             context->inner_context = NULL;
         }
@@ -175,9 +190,20 @@ struct flb_decompression_context *flb_decompression_context_create(int algorithm
         return NULL;
     }
 
+    /* set before creating the backend so destroy() releases the right one */
+    context->algorithm = algorithm;
+
     if (algorithm == FLB_COMPRESSION_ALGORITHM_GZIP) {
         context->inner_context = flb_gzip_decompression_context_create();
     }
+#ifdef FLB_HAVE_ZSTD
+    else if (algorithm == FLB_COMPRESSION_ALGORITHM_ZSTD) {
+        context->inner_context = flb_zstd_decompression_context_create();
+    }
+#endif
+    else if (algorithm == FLB_COMPRESSION_ALGORITHM_LZ4) {
+        context->inner_context = flb_lz4_decompression_context_create();
+    }
     else {
         flb_error("invalid compression algorithm : %d", algorithm);
 
@@ -197,8 +223,7 @@ struct flb_decompression_context *flb_decompression_context_create(int algorithm
     }
 
     context->input_buffer_size = input_buffer_size;
-    context->read_buffer = context->read_buffer;
-    context->algorithm = algorithm;
+    context->read_buffer = context->input_buffer;
     context->state = FLB_DECOMPRESSOR_STATE_EXPECTING_HEADER;
 
     return context;
@@ -215,7 +240,141 @@ int flb_decompress(struct flb_decompression_context *context,
                                                   output_length);
 
         }
+#ifdef FLB_HAVE_ZSTD
+        else if (context->algorithm == FLB_COMPRESSION_ALGORITHM_ZSTD) {
+            return flb_zstd_decompressor_dispatch(context,
+                                                  output_buffer,
+                                                  output_length);
+        }
+#endif
+        else if (context->algorithm == FLB_COMPRESSION_ALGORITHM_LZ4) {
+            return flb_lz4_decompressor_dispatch(context,
+                                                 output_buffer,
+                                                 output_length);
+        }
     }
 
     return FLB_DECOMPRESSOR_FAILURE;
 }
+
+/*
+ * Content codings as used in the Content-Encoding / Accept-Encoding HTTP
+ * headers and in the 'compress' property of the output plugins.
+ */
+int flb_compression_get_algorithm_by_name(const char *name, size_t length)
+{
+    if (name == NULL) {
+        return -1;
+    }
+
+    if (length == 4 && strncasecmp(name, "none", 4) == 0) {
+        return FLB_COMPRESSION_ALGORITHM_NONE;
+    }
+    else if (length == 4 && strncasecmp(name, "gzip", 4) == 0) {
+        return FLB_COMPRESSION_ALGORITHM_GZIP;
+    }
+    else if (length == 4 && strncasecmp(name, "zstd", 4) == 0) {
+        return FLB_COMPRESSION_ALGORITHM_ZSTD;
+    }
+    else if (length == 3 && strncasecmp(name, "lz4", 3) == 0) {
+        return FLB_COMPRESSION_ALGORITHM_LZ4;
+    }
+
+    return -1;
+}
+
+const char *flb_compression_get_algorithm_name(int algorithm)
+{
+    switch (algorithm) {
+    case FLB_COMPRESSION_ALGORITHM_NONE:
+        return "none";
+    case FLB_COMPRESSION_ALGORITHM_GZIP:
+        return "gzip";
+    case FLB_COMPRESSION_ALGORITHM_ZSTD:
+        return "zstd";
+    case FLB_COMPRESSION_ALGORITHM_LZ4:
+        return "lz4";
+    }
+
+    return NULL;
+}
+
+int flb_compression_is_supported(int algorithm)
+{
+    if (algorithm == FLB_COMPRESSION_ALGORITHM_NONE ||
+        algorithm == FLB_COMPRESSION_ALGORITHM_GZIP ||
+        algorithm == FLB_COMPRESSION_ALGORITHM_LZ4) {
+        return FLB_TRUE;
+    }
+#ifdef FLB_HAVE_ZSTD
+    else if (algorithm == FLB_COMPRESSION_ALGORITHM_ZSTD) {
+        return FLB_TRUE;
+    }
+#endif
+
+    return FLB_FALSE;
+}
+
+int flb_compress(int algorithm,
+                 void *in_data, size_t in_len,
+                 void **out_data, size_t *out_len)
+{
+    if (algorithm == FLB_COMPRESSION_ALGORITHM_GZIP) {
+        return flb_gzip_compress(in_data, in_len, out_data, out_len);
+    }
+#ifdef FLB_HAVE_ZSTD
+    else if (algorithm == FLB_COMPRESSION_ALGORITHM_ZSTD) {
+        return flb_zstd_compress(in_data, in_len, out_data, out_len);
+    }
+#endif
+    else if (algorithm == FLB_COMPRESSION_ALGORITHM_LZ4) {
+        return flb_lz4_compress(in_data, in_len, out_data, out_len);
+    }
+
+    flb_error("unsupported compression algorithm : %d", algorithm);
+
+    return -1;
+}
+
+int flb_uncompress(int algorithm,
+                   void *in_data, size_t in_len,
+                   void **out_data, size_t *out_len,
+                   size_t max_size)
+{
+    uint8_t *p;
+    size_t size;
+
+    if (algorithm == FLB_COMPRESSION_ALGORITHM_GZIP) {
+        /*
+         * flb_gzip_uncompress() allocates the size found in the gzip
+         * trailer and never writes past it, checking it is enough.
+         */
+        if (max_size > 0 && in_len >= 4) {
+            p = (uint8_t *) in_data + in_len - 4;
+            size = (size_t) p[0] | ((size_t) p[1] << 8) |
+                   ((size_t) p[2] << 16) | ((size_t) p[3] << 24);
+
+            if (size > max_size) {
+                flb_error("[gzip] maximum decompression size is %zu bytes",
+                          max_size);
+                return -1;
+            }
+        }
+
+        return flb_gzip_uncompress(in_data, in_len, out_data, out_len);
+    }
+#ifdef FLB_HAVE_ZSTD
+    else if (algorithm == FLB_COMPRESSION_ALGORITHM_ZSTD) {
+        return flb_zstd_uncompress(in_data, in_len, out_data, out_len,
+                                   max_size);
+    }
+#endif
+    else if (algorithm == FLB_COMPRESSION_ALGORITHM_LZ4) {
+        return flb_lz4_uncompress(in_data, in_len, out_data, out_len,
+                                  max_size);
+    }
+
+    flb_error("unsupported compression algorithm : %d", algorithm);
+
+    return -1;
+}
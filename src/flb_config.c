@@ -44,6 +44,7 @@
 #include <fluent-bit/flb_config_format.h>
 #include <fluent-bit/multiline/flb_ml.h>
 #include <fluent-bit/flb_bucket_queue.h>
+#include <fluent-bit/flb_net_dns_cache.h>
 
 const char *FLB_CONF_ENV_LOGLEVEL = "FLB_LOG_LEVEL";
 
@@ -129,6 +130,22 @@ struct flb_service_config service_configs[] = {
      FLB_CONF_TYPE_BOOL,
      offsetof(struct flb_config, dns_prefer_ipv6)},
 
+    {FLB_CONF_DNS_CACHE,
+     FLB_CONF_TYPE_BOOL,
+     offsetof(struct flb_config, dns_cache)},
+
+    {FLB_CONF_DNS_CACHE_MAX_TTL,
+     FLB_CONF_TYPE_INT,
+     offsetof(struct flb_config, dns_cache_max_ttl)},
+
+    {FLB_CONF_DNS_CACHE_NEGATIVE_TTL,
+     FLB_CONF_TYPE_INT,
+     offsetof(struct flb_config, dns_cache_negative_ttl)},
+
+    {FLB_CONF_DNS_CACHE_STALE_TTL,
+     FLB_CONF_TYPE_INT,
+     offsetof(struct flb_config, dns_cache_stale_ttl)},
+
     /* Storage */
     {FLB_CONF_STORAGE_PATH,
      FLB_CONF_TYPE_STR,
@@ -142,6 +159,9 @@ struct flb_service_config service_configs[] = {
     {FLB_CONF_STORAGE_CHECKSUM,
      FLB_CONF_TYPE_BOOL,
      offsetof(struct flb_config, storage_checksum)},
+    {FLB_CONF_STORAGE_META_STATS,
+     FLB_CONF_TYPE_BOOL,
+     offsetof(struct flb_config, storage_meta_stats)},
     {FLB_CONF_STORAGE_BL_MEM_LIMIT,
      FLB_CONF_TYPE_STR,
      offsetof(struct flb_config, storage_bl_mem_limit)},
@@ -168,6 +188,11 @@ struct flb_service_config service_configs[] = {
      FLB_CONF_TYPE_INT,
      offsetof(struct flb_config, sched_base)},
 
+    /* Filters */
+    {FLB_CONF_STR_FILTER_WORKERS,
+     FLB_CONF_TYPE_INT,
+     offsetof(struct flb_config, filter_workers)},
+
 #ifdef FLB_HAVE_STREAM_PROCESSOR
     {FLB_CONF_STR_STREAMS_FILE,
      FLB_CONF_TYPE_STR,
@@ -282,6 +307,12 @@ struct flb_config *flb_config_init()
     config->sched_cap  = FLB_SCHED_CAP;
     config->sched_base = FLB_SCHED_BASE;
 
+    /* DNS cache */
+    config->dns_cache = FLB_TRUE;
+    config->dns_cache_max_ttl = FLB_CONFIG_DNS_CACHE_MAX_TTL;
+    config->dns_cache_negative_ttl = FLB_CONFIG_DNS_CACHE_NEGATIVE_TTL;
+    config->dns_cache_stale_ttl = 0;
+
     /* reload */
     config->ensure_thread_safety_on_hot_reloading = FLB_TRUE;
     config->hot_reloaded_count = 0;
@@ -501,6 +532,9 @@ void flb_config_exit(struct flb_config *config)
     if (config->dns_resolver) {
         flb_free(config->dns_resolver);
     }
+    if (config->dns_cache_ctx) {
+        flb_net_dns_cache_destroy(config->dns_cache_ctx);
+    }
 
     if (config->storage_path) {
         flb_free(config->storage_path);
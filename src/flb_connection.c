@@ -22,6 +22,7 @@ int flb_connection_setup(struct flb_connection *connection,
     connection->evl                     = event_loop;
     connection->coroutine               = coroutine;
     connection->tls_session             = NULL;
+    connection->http2_session           = NULL;
     connection->ts_created              = time(NULL);
     connection->ts_assigned             = time(NULL);
     connection->busy_flag               = FLB_FALSE;
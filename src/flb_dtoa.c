@@ -0,0 +1,422 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_dtoa.h>
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Grisu2 shortest round-trip conversion, as described by Florian Loitsch in
+ * "Printing Floating-Point Numbers Quickly and Accurately with Integers"
+ * (PLDI 2010). The layout follows Milo Yip's implementation used by RapidJSON.
+ *
+ * A double is handled as a 'diy_fp' (64 bits significand + binary exponent),
+ * it's scaled by a cached power of ten so its integral part lands in 32 bits
+ * and the digits are generated until they are enough to identify the value
+ * inside its rounding boundaries.
+ */
+
+#define DP_SIGNIFICAND_SIZE   52
+#define DP_EXPONENT_BIAS      (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_MIN_EXPONENT       (-DP_EXPONENT_BIAS)
+#define DP_EXPONENT_MASK      0x7FF0000000000000ULL
+#define DP_SIGNIFICAND_MASK   0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT         0x0010000000000000ULL
+#define DIY_SIGNIFICAND_SIZE  64
+
+/* Exponent layout of '%g', values out of this range use scientific notation */
+#define DTOA_EXP_MIN          -4
+#define DTOA_EXP_MAX          16
+
+struct diy_fp {
+    uint64_t f;
+    int e;
+};
+
+/* Normalized powers of ten: 10^-348, 10^-340, ..., 10^340 */
+static const uint64_t cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL,
+    0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL,
+    0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL,
+    0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL,
+    0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL,
+    0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL,
+    0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL,
+    0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL,
+    0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL,
+    0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL,
+    0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL,
+    0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL,
+    0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL,
+    0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL,
+    0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL,
+    0xaf87023b9bf0ee6bULL,
+};
+
+static const int16_t cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715, -688, -661,
+    -635, -608, -582, -555, -529, -502, -475, -449, -422, -396, -369, -343,
+    -316, -289, -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3,
+    30, 56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402,
+    428, 455, 481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774,
+    800, 827, 853, 880, 907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const uint64_t pow10_table[] = {
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL,
+    10000000000000000000ULL
+};
+
+static inline struct diy_fp diy_fp_make(uint64_t f, int e)
+{
+    struct diy_fp fp;
+
+    fp.f = f;
+    fp.e = e;
+    return fp;
+}
+
+static inline struct diy_fp diy_fp_from_double(double d)
+{
+    int biased_e;
+    uint64_t u;
+    uint64_t significand;
+
+    memcpy(&u, &d, sizeof(u));
+    biased_e = (int) ((u & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+    significand = u & DP_SIGNIFICAND_MASK;
+
+    if (biased_e != 0) {
+        return diy_fp_make(significand + DP_HIDDEN_BIT,
+                           biased_e - DP_EXPONENT_BIAS);
+    }
+
+    /* subnormal */
+    return diy_fp_make(significand, DP_MIN_EXPONENT + 1);
+}
+
+static inline struct diy_fp diy_fp_mul(struct diy_fp x, struct diy_fp y)
+{
+    uint64_t a = x.f >> 32;
+    uint64_t b = x.f & 0xFFFFFFFF;
+    uint64_t c = y.f >> 32;
+    uint64_t d = y.f & 0xFFFFFFFF;
+    uint64_t ac = a * c;
+    uint64_t bc = b * c;
+    uint64_t ad = a * d;
+    uint64_t bd = b * d;
+    uint64_t tmp;
+
+    tmp = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF);
+    tmp += 1U << 31; /* round */
+
+    return diy_fp_make(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32),
+                       x.e + y.e + 64);
+}
+
+static inline struct diy_fp diy_fp_normalize(struct diy_fp v)
+{
+    while (!(v.f & DP_HIDDEN_BIT)) {
+        v.f <<= 1;
+        v.e--;
+    }
+    v.f <<= (DIY_SIGNIFICAND_SIZE - DP_SIGNIFICAND_SIZE - 1);
+    v.e -= (DIY_SIGNIFICAND_SIZE - DP_SIGNIFICAND_SIZE - 1);
+
+    return v;
+}
+
+/* Normalized upper and lower rounding boundaries of 'v', same exponent */
+static inline void diy_fp_boundaries(struct diy_fp v,
+                                     struct diy_fp *minus, struct diy_fp *plus)
+{
+    struct diy_fp pl;
+    struct diy_fp mi;
+
+    pl = diy_fp_make((v.f << 1) + 1, v.e - 1);
+    while (!(pl.f & (DP_HIDDEN_BIT << 1))) {
+        pl.f <<= 1;
+        pl.e--;
+    }
+    pl.f <<= (DIY_SIGNIFICAND_SIZE - DP_SIGNIFICAND_SIZE - 2);
+    pl.e -= (DIY_SIGNIFICAND_SIZE - DP_SIGNIFICAND_SIZE - 2);
+
+    /* the lower boundary is closer when the significand is a power of two */
+    if (v.f == DP_HIDDEN_BIT) {
+        mi = diy_fp_make((v.f << 2) - 1, v.e - 2);
+    }
+    else {
+        mi = diy_fp_make((v.f << 1) - 1, v.e - 1);
+    }
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+
+    *plus = pl;
+    *minus = mi;
+}
+
+/* Cached power of ten that brings the binary exponent 'e' into range */
+static inline struct diy_fp cached_power(int e, int *k)
+{
+    int ki;
+    double dk;
+    unsigned int index;
+
+    dk = (-61 - e) * 0.30102999566398114 + 347;
+    ki = (int) dk;
+    if (ki != dk) {
+        ki++;
+    }
+
+    index = (unsigned int) ((ki >> 3) + 1);
+    *k = -(-348 + (int) (index << 3));
+
+    return diy_fp_make(cached_powers_f[index], cached_powers_e[index]);
+}
+
+static inline int count_digits(uint32_t n)
+{
+    int i;
+
+    for (i = 1; i < 10; i++) {
+        if (n < pow10_table[i]) {
+            return i;
+        }
+    }
+    return 10;
+}
+
+static inline void grisu_round(char *buf, int len, uint64_t delta,
+                               uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w ||
+            wp_w - rest > rest + ten_kappa - wp_w)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static void digit_gen(struct diy_fp w, struct diy_fp mp, uint64_t delta,
+                      char *buf, int *len, int *k)
+{
+    int kappa;
+    uint32_t d;
+    uint32_t p1;
+    uint64_t p2;
+    uint64_t tmp;
+    uint64_t wp_w;
+    struct diy_fp one;
+
+    one = diy_fp_make(1ULL << -mp.e, mp.e);
+    wp_w = mp.f - w.f;
+    p1 = (uint32_t) (mp.f >> -one.e);
+    p2 = mp.f & (one.f - 1);
+    kappa = count_digits(p1);
+    *len = 0;
+
+    /* integral part */
+    while (kappa > 0) {
+        d = p1 / pow10_table[kappa - 1];
+        p1 %= pow10_table[kappa - 1];
+        if (d || *len) {
+            buf[(*len)++] = '0' + (char) d;
+        }
+        kappa--;
+
+        tmp = ((uint64_t) p1 << -one.e) + p2;
+        if (tmp <= delta) {
+            *k += kappa;
+            grisu_round(buf, *len, delta, tmp,
+                        pow10_table[kappa] << -one.e, wp_w);
+            return;
+        }
+    }
+
+    /* fractional part */
+    while (1) {
+        p2 *= 10;
+        delta *= 10;
+        d = (uint32_t) (p2 >> -one.e);
+        if (d || *len) {
+            buf[(*len)++] = '0' + (char) d;
+        }
+        p2 &= one.f - 1;
+        kappa--;
+
+        if (p2 < delta) {
+            *k += kappa;
+            grisu_round(buf, *len, delta, p2, one.f,
+                        -kappa < 20 ? wp_w * pow10_table[-kappa] : 0);
+            return;
+        }
+    }
+}
+
+/* Digits of a positive 'value', the result is digits * 10^k */
+static void grisu2(double value, char *buf, int *len, int *k)
+{
+    struct diy_fp v;
+    struct diy_fp w;
+    struct diy_fp wm;
+    struct diy_fp wp;
+    struct diy_fp c_mk;
+
+    v = diy_fp_from_double(value);
+    diy_fp_boundaries(v, &wm, &wp);
+
+    c_mk = cached_power(wp.e, k);
+    w = diy_fp_mul(diy_fp_normalize(v), c_mk);
+    wp = diy_fp_mul(wp, c_mk);
+    wm = diy_fp_mul(wm, c_mk);
+    wm.f++;
+    wp.f--;
+
+    digit_gen(w, wp, wp.f - wm.f, buf, len, k);
+}
+
+int flb_dtoa(double value, char *buf)
+{
+    int k;
+    int n;
+    int len;
+    int exp;
+    char *p = buf;
+    char digits[24];
+
+    if (value < 0) {
+        *p++ = '-';
+        value = -value;
+    }
+
+    if (value == 0) {
+        *p++ = '0';
+        return p - buf;
+    }
+
+    grisu2(value, digits, &len, &k);
+
+    while (len > 1 && digits[len - 1] == '0') {
+        len--;
+        k++;
+    }
+
+    /* decimal exponent of the first digit */
+    exp = k + len - 1;
+
+    if (exp >= DTOA_EXP_MIN && exp < DTOA_EXP_MAX) {
+        if (k >= 0) {
+            /* integer: 1234000 */
+            memcpy(p, digits, len);
+            memset(p + len, '0', k);
+            p += len + k;
+        }
+        else if (exp >= 0) {
+            /* 1234.56 */
+            n = exp + 1;
+            memcpy(p, digits, n);
+            p[n] = '.';
+            memcpy(p + n + 1, digits + n, len - n);
+            p += len + 1;
+        }
+        else {
+            /* 0.0001234 */
+            *p++ = '0';
+            *p++ = '.';
+            memset(p, '0', -exp - 1);
+            p += -exp - 1;
+            memcpy(p, digits, len);
+            p += len;
+        }
+        return p - buf;
+    }
+
+    /* scientific: 1.234e+56, the exponent has two digits at least */
+    *p++ = digits[0];
+    if (len > 1) {
+        *p++ = '.';
+        memcpy(p, digits + 1, len - 1);
+        p += len - 1;
+    }
+    *p++ = 'e';
+    if (exp < 0) {
+        *p++ = '-';
+        exp = -exp;
+    }
+    else {
+        *p++ = '+';
+    }
+    if (exp >= 100) {
+        *p++ = '0' + exp / 100;
+        exp %= 100;
+    }
+    *p++ = '0' + exp / 10;
+    *p++ = '0' + exp % 10;
+
+    return p - buf;
+}
@@ -41,6 +41,7 @@
 #include <fluent-bit/flb_network.h>
 #include <fluent-bit/flb_task.h>
 #include <fluent-bit/flb_router.h>
+#include <fluent-bit/flb_routes_mask.h>
 #include <fluent-bit/flb_http_server.h>
 #include <fluent-bit/flb_scheduler.h>
 #include <fluent-bit/flb_parser.h>
@@ -52,10 +53,12 @@
 #include <fluent-bit/flb_version.h>
 #include <fluent-bit/flb_upstream.h>
 #include <fluent-bit/flb_downstream.h>
-#include <fluent-bit/flb_ring_buffer.h>
+#include <fluent-bit/flb_mpsc_queue.h>
+#include <fluent-bit/flb_arena.h>
 
 #ifdef FLB_HAVE_METRICS
 #include <fluent-bit/flb_metrics_exporter.h>
+#include <fluent-bit/flb_net_dns_cache.h>
 #endif
 
 #ifdef FLB_HAVE_STREAM_PROCESSOR
@@ -663,11 +666,21 @@ static int flb_engine_log_start(struct flb_config *config)
     return 0;
 }
 
-static void flb_engine_drain_ring_buffer_signal_channel(flb_pipefd_t fd)
+/* Return the highest id assigned to an output instance */
+static int output_max_id(struct flb_config *config)
 {
-    static char signal_buffer[512];
+    int id = -1;
+    struct mk_list *head;
+    struct flb_output_instance *ins;
+
+    mk_list_foreach(head, &config->outputs) {
+        ins = mk_list_entry(head, struct flb_output_instance, _head);
+        if (ins->id > id) {
+            id = ins->id;
+        }
+    }
 
-    flb_pipe_r(fd, signal_buffer, sizeof(signal_buffer));
+    return id;
 }
 
 
@@ -777,6 +790,12 @@ int flb_engine_start(struct flb_config *config)
         return -1;
     }
 
+    /*
+     * Size the routes mask from the output instances, it must be done before
+     * any chunk is created or loaded from the storage.
+     */
+    flb_routes_mask_set_size(config, output_max_id(config) + 1);
+
     /* Start the Storage engine */
     ret = flb_storage_create(config);
     if (ret == -1) {
@@ -801,6 +820,17 @@ int flb_engine_start(struct flb_config *config)
     flb_sched_ctx_init();
     flb_sched_ctx_set(sched);
 
+    /* DNS cache shared by the upstreams */
+    if (config->dns_cache && !config->dns_cache_ctx) {
+        config->dns_cache_ctx = flb_net_dns_cache_create(config->dns_cache_max_ttl,
+                                                         config->dns_cache_negative_ttl,
+                                                         config->dns_cache_stale_ttl);
+        if (!config->dns_cache_ctx) {
+            flb_error("[engine] could not create the DNS cache");
+            return -1;
+        }
+    }
+
     /* Initialize input plugins */
     ret = flb_input_init_all(config);
     if (ret == -1) {
@@ -912,10 +942,10 @@ int flb_engine_start(struct flb_config *config)
         rb_ms = atoi(rb_env);
     }
 
-    /* Input instance / Ring buffer collector */
+    /* Input instance / input queue collector */
     ret = flb_sched_timer_cb_create(config->sched,
                                     FLB_SCHED_TIMER_CB_PERM,
-                                    rb_ms, flb_input_chunk_ring_buffer_collector,
+                                    rb_ms, flb_input_chunk_queue_collector,
                                     config, NULL);
     if (ret == -1) {
         flb_error("[engine] could not schedule permanent callback");
@@ -1068,14 +1098,14 @@ int flb_engine_start(struct flb_config *config)
                 handle_input_event(event->fd, ts, config);
             }
             else if(event->type == FLB_ENGINE_EV_THREAD_INPUT) {
-                flb_engine_drain_ring_buffer_signal_channel(event->fd);
+                flb_mpsc_queue_signal_drain(config->input_queue);
 
                 rb_flush_flag = FLB_TRUE;
             }
         }
 
         if (rb_flush_flag) {
-            flb_input_chunk_ring_buffer_collector(config, NULL);
+            flb_input_chunk_queue_collector(config, NULL);
         }
 
         /* Cleanup functions associated to events and timers */
@@ -1120,6 +1150,9 @@ int flb_engine_shutdown(struct flb_config *config)
     flb_custom_exit(config);
     flb_input_exit_all(config);
 
+    /* memory arena used by the processors of the pipeline thread */
+    flb_arena_thread_destroy();
+
     /* Destroy the storage context */
     flb_storage_destroy(config);
 
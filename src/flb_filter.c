@@ -27,12 +27,16 @@
 #include <fluent-bit/flb_pack.h>
 #include <fluent-bit/flb_metrics.h>
 #include <fluent-bit/flb_utils.h>
+#include <fluent-bit/flb_filter_worker.h>
 #include <chunkio/chunkio.h>
 
 #ifdef FLB_HAVE_CHUNK_TRACE
 #include <fluent-bit/flb_chunk_trace.h>
 #endif /* FLB_HAVE_CHUNK_TRACE */
 
+/* Tags shorter than this are copied on the stack by flb_filter_do() */
+#define FLB_FILTER_TAG_SIZE   256
+
 static inline int instance_id(struct flb_config *config)
 {
     struct flb_filter_instance *entry;
@@ -75,6 +79,392 @@ static inline int prop_key_check(const char *key, const char *kv, int k_len)
     return -1;
 }
 
+/*
+ * Check if the filter instance must process the records for the given Tag. If
+ * a compiled route is available, its filters are stored in the same order of
+ * the filters list so a cursor is enough to test the membership.
+ */
+static inline int filter_match(struct flb_router_route *route, int *index,
+                               struct flb_filter_instance *f_ins,
+                               const char *tag, int tag_len)
+{
+    if (route) {
+        if (*index < route->filters_size && route->filters[*index] == f_ins) {
+            (*index)++;
+            return FLB_TRUE;
+        }
+        return FLB_FALSE;
+    }
+
+    return flb_router_match(tag, tag_len, f_ins->match
+#ifdef FLB_HAVE_REGEX
+                            , f_ins->match_regex
+#else
+                            , NULL
+#endif
+                            );
+}
+
+/* Filters chain of an append dispatched to the filter workers */
+struct filter_chain {
+    int size;
+    struct flb_filter_instance **filters;
+    const char *tag;
+    int tag_len;
+    struct flb_input_instance *i_ins;
+    struct flb_config *config;
+};
+
+/*
+ * A slice of the appended records. The per filter statistics of the chain
+ * are stored so the metrics are updated by the caller once all the slices
+ * are done: 'in_records' is -1 for the filters the slice did not reach.
+ */
+struct filter_slice {
+    struct flb_filter_job job;
+    const char *data;
+    size_t size;
+    int records;
+    int modified;
+    char *out_data;
+    size_t out_size;
+    int *in_records;
+    int *out_records;
+    size_t *out_bytes;
+    struct filter_chain *chain;
+};
+
+static void filter_slice_run(struct flb_filter_job *job)
+{
+    int i;
+    int ret;
+    int records;
+    char *work_data;
+    size_t work_size;
+    void *out_buf;
+    size_t out_size;
+    struct flb_filter_instance *f_ins;
+    struct filter_slice *slice = (struct filter_slice *) job;
+    struct filter_chain *chain = slice->chain;
+
+    work_data = (char *) slice->data;
+    work_size = slice->size;
+    records = slice->records;
+
+    for (i = 0; i < chain->size; i++) {
+        f_ins = chain->filters[i];
+        out_buf = NULL;
+        out_size = 0;
+
+        ret = f_ins->p->cb_filter(work_data, work_size,
+                                  chain->tag, chain->tag_len,
+                                  &out_buf, &out_size,
+                                  f_ins, chain->i_ins,
+                                  f_ins->context, chain->config);
+
+        slice->in_records[i] = records;
+        slice->out_bytes[i] = out_size;
+
+        if (ret == FLB_FILTER_MODIFIED) {
+            if (work_data != slice->data) {
+                flb_free(work_data);
+            }
+            work_data = (char *) out_buf;
+            work_size = out_size;
+            slice->modified = FLB_TRUE;
+
+            /* all records removed, no data to continue processing */
+            if (out_size == 0) {
+                slice->out_records[i] = 0;
+                records = 0;
+                i++;
+                break;
+            }
+            records = flb_mp_count(out_buf, out_size);
+        }
+        slice->out_records[i] = records;
+    }
+
+    for (; i < chain->size; i++) {
+        slice->in_records[i] = -1;
+    }
+
+    slice->records = records;
+    if (slice->modified) {
+        slice->out_data = work_data;
+        slice->out_size = work_size;
+    }
+}
+
+#ifdef FLB_HAVE_METRICS
+static void filter_slices_metrics(struct filter_chain *chain,
+                                  struct filter_slice *slices, int count)
+{
+    int i;
+    int n;
+    int in_records;
+    int add_records;
+    int drop_records;
+    size_t bytes;
+    uint64_t ts;
+    uint64_t wait;
+    char *name;
+    struct filter_slice *slice;
+    struct flb_filter_instance *f_ins;
+
+    ts = cfl_time_now();
+
+    for (i = 0; i < chain->size; i++) {
+        f_ins = chain->filters[i];
+        name = (char *) flb_filter_name(f_ins);
+
+        in_records = 0;
+        add_records = 0;
+        drop_records = 0;
+        bytes = 0;
+        wait = 0;
+        for (n = 0; n < count; n++) {
+            slice = &slices[n];
+            if (slice->in_records[i] < 0) {
+                continue;
+            }
+            wait += slice->job.wait;
+            in_records += slice->in_records[i];
+            bytes += slice->out_bytes[i];
+            if (slice->out_records[i] > slice->in_records[i]) {
+                add_records += slice->out_records[i] - slice->in_records[i];
+            }
+            else {
+                drop_records += slice->in_records[i] - slice->out_records[i];
+            }
+        }
+
+        cmt_counter_add(f_ins->cmt_records, ts, in_records,
+                        1, (char *[]) {name});
+        cmt_counter_add(f_ins->cmt_bytes, ts, bytes,
+                        1, (char *[]) {name});
+        flb_metrics_sum(FLB_METRIC_N_RECORDS, in_records, f_ins->metrics);
+        flb_metrics_sum(FLB_METRIC_N_BYTES, bytes, f_ins->metrics);
+
+        if (add_records > 0) {
+            cmt_counter_add(f_ins->cmt_add_records, ts, add_records,
+                            1, (char *[]) {name});
+            flb_metrics_sum(FLB_METRIC_N_ADDED, add_records, f_ins->metrics);
+        }
+        if (drop_records > 0) {
+            cmt_counter_add(f_ins->cmt_drop_records, ts, drop_records,
+                            1, (char *[]) {name});
+            flb_metrics_sum(FLB_METRIC_N_DROPPED, drop_records,
+                            f_ins->metrics);
+        }
+
+        /*
+         * A slice waits once for the whole chain: every filter it reached
+         * reports that wait, the values of one chain are not to be added.
+         */
+        if (f_ins->cmt_queue_wait) {
+            cmt_counter_add(f_ins->cmt_queue_wait, ts, wait / 1e9,
+                            1, (char *[]) {name});
+        }
+    }
+}
+#endif
+
+/*
+ * Run the filters chain of the records in the filter workers. Returns -1 if
+ * the records must be processed in the caller thread: no workers, not enough
+ * records or a filter of the chain that is not thread safe. Once the workers
+ * ran it always returns 0, the chain is never run twice.
+ */
+static int filter_do_workers(struct flb_input_chunk *ic,
+                             const void *data, size_t bytes,
+                             char **out_data, size_t *out_bytes,
+                             const char *tag, int tag_len,
+                             struct flb_router_route *route,
+                             struct flb_config *config)
+{
+    int i;
+    int count;
+    int modified = FLB_FALSE;
+    int records;
+    int route_index = 0;
+    int *in_records = NULL;
+    int *out_records = NULL;
+    size_t *out_sizes = NULL;
+    size_t size;
+    size_t *offsets = NULL;
+    char *buf;
+    struct mk_list *head;
+    struct filter_chain chain;
+    struct filter_slice *slices = NULL;
+    struct flb_filter_job **jobs = NULL;
+    struct flb_filter_instance *f_ins;
+    struct flb_filter_pool *pool = config->filter_pool;
+
+#ifdef FLB_HAVE_CHUNK_TRACE
+    if (ic->trace) {
+        return -1;
+    }
+#endif
+
+    count = ic->added_records / FLB_FILTER_WORKER_SLICE_MIN;
+    if (count > pool->workers + 1) {
+        count = pool->workers + 1;
+    }
+    if (count < 2) {
+        return -1;
+    }
+
+    /* the chain, dispatched only if all of its filters are thread safe */
+    chain.size = 0;
+    chain.filters = flb_malloc(sizeof(struct flb_filter_instance *) *
+                               mk_list_size(&config->filters));
+    if (!chain.filters) {
+        flb_errno();
+        return -1;
+    }
+
+    mk_list_foreach(head, &config->filters) {
+        f_ins = mk_list_entry(head, struct flb_filter_instance, _head);
+        if (filter_match(route, &route_index, f_ins,
+                         tag, tag_len) == FLB_FALSE ||
+            is_active(&f_ins->properties) == FLB_FALSE) {
+            continue;
+        }
+        if (!(f_ins->flags & FLB_FILTER_THREADSAFE)) {
+            flb_free(chain.filters);
+            return -1;
+        }
+        chain.filters[chain.size++] = f_ins;
+    }
+
+    if (chain.size == 0) {
+        flb_free(chain.filters);
+        return -1;
+    }
+    chain.tag = tag;
+    chain.tag_len = tag_len;
+    chain.i_ins = ic->in;
+    chain.config = config;
+
+    offsets = flb_malloc(sizeof(size_t) * (count + 1));
+    slices = flb_calloc(count, sizeof(struct filter_slice));
+    jobs = flb_malloc(sizeof(struct flb_filter_job *) * count);
+    in_records = flb_malloc(sizeof(int) * count * chain.size);
+    out_records = flb_malloc(sizeof(int) * count * chain.size);
+    out_sizes = flb_malloc(sizeof(size_t) * count * chain.size);
+    if (!offsets || !slices || !jobs ||
+        !in_records || !out_records || !out_sizes) {
+        flb_errno();
+        goto error;
+    }
+
+    if (flb_mp_split(data, bytes, ic->added_records, count, offsets) == -1) {
+        goto error;
+    }
+
+    for (i = 0; i < count; i++) {
+        slices[i].job.cb = filter_slice_run;
+        slices[i].data = (char *) data + offsets[i];
+        slices[i].size = offsets[i + 1] - offsets[i];
+        slices[i].records = ic->added_records / count;
+        slices[i].chain = &chain;
+        slices[i].in_records = in_records + i * chain.size;
+        slices[i].out_records = out_records + i * chain.size;
+        slices[i].out_bytes = out_sizes + i * chain.size;
+        jobs[i] = &slices[i].job;
+    }
+    slices[count - 1].records += ic->added_records % count;
+
+    flb_filter_pool_run(pool, jobs, count);
+
+#ifdef FLB_HAVE_METRICS
+    filter_slices_metrics(&chain, slices, count);
+#endif
+
+    /* join the slices in their original order */
+    size = 0;
+    records = 0;
+    for (i = 0; i < count; i++) {
+        if (slices[i].modified) {
+            modified = FLB_TRUE;
+            size += slices[i].out_size;
+        }
+        else {
+            size += slices[i].size;
+        }
+        records += slices[i].records;
+    }
+
+    if (!modified) {
+        *out_data = (char *) data;
+        *out_bytes = bytes;
+    }
+    else {
+        buf = NULL;
+        if (size > 0) {
+            buf = flb_malloc(size);
+            if (!buf) {
+                flb_errno();
+
+                /*
+                 * The filters already ran and were accounted, running the
+                 * chain again in the caller would filter the records twice:
+                 * drop them instead.
+                 */
+                flb_error("[filter] could not join the records filtered "
+                          "by the workers, dropping %i records", records);
+                for (i = 0; i < count; i++) {
+                    flb_free(slices[i].out_data);
+                }
+                ic->total_records -= ic->added_records;
+                *out_data = NULL;
+                *out_bytes = 0;
+                goto done;
+            }
+        }
+
+        size = 0;
+        for (i = 0; i < count; i++) {
+            if (slices[i].modified) {
+                if (slices[i].out_size > 0) {
+                    memcpy(buf + size, slices[i].out_data, slices[i].out_size);
+                    size += slices[i].out_size;
+                }
+                flb_free(slices[i].out_data);
+            }
+            else {
+                memcpy(buf + size, slices[i].data, slices[i].size);
+                size += slices[i].size;
+            }
+        }
+
+        ic->total_records = ic->total_records - ic->added_records + records;
+        *out_data = buf;
+        *out_bytes = size;
+    }
+
+done:
+    flb_free(chain.filters);
+    flb_free(offsets);
+    flb_free(slices);
+    flb_free(jobs);
+    flb_free(in_records);
+    flb_free(out_records);
+    flb_free(out_sizes);
+    return 0;
+
+error:
+    flb_free(chain.filters);
+    flb_free(offsets);
+    flb_free(slices);
+    flb_free(jobs);
+    flb_free(in_records);
+    flb_free(out_records);
+    flb_free(out_sizes);
+    return -1;
+}
+
 void flb_filter_do(struct flb_input_chunk *ic,
                    const void *data, size_t bytes,
                    void **out_data, size_t *out_bytes,
@@ -82,15 +472,17 @@ void flb_filter_do(struct flb_input_chunk *ic,
                    struct flb_config *config)
 {
     int ret;
-#ifdef FLB_HAVE_METRICS
     int in_records = 0;
     int out_records = 0;
-    int diff = 0;
     int pre_records = 0;
+#ifdef FLB_HAVE_METRICS
+    int diff = 0;
     uint64_t ts;
     char *name;
 #endif
+    int route_index;
     char *ntag;
+    char tag_buf[FLB_FILTER_TAG_SIZE];
     char *work_data;
     size_t work_size;
     void *out_buf;
@@ -98,6 +490,7 @@ void flb_filter_do(struct flb_input_chunk *ic,
     struct mk_list *head;
     struct flb_filter_instance *f_ins;
     struct flb_input_instance *i_ins = ic->in;
+    struct flb_router_route *route;
 /* measure time between filters for chunk traces. */
 #ifdef FLB_HAVE_CHUNK_TRACE
     struct flb_time tm_start;
@@ -107,19 +500,43 @@ void flb_filter_do(struct flb_input_chunk *ic,
     *out_data = NULL;
     *out_bytes = 0;
 
-    /* For the incoming Tag make sure to create a NULL terminated reference */
-    ntag = flb_malloc(tag_len + 1);
-    if (!ntag) {
-        flb_errno();
-        flb_error("[filter] could not filter record due to memory problems");
-        return;
+    /*
+     * For the incoming Tag make sure to use a NULL terminated reference, the
+     * caller tag might not be terminated. Common tags fit on the stack.
+     */
+    if ((size_t) tag_len < sizeof(tag_buf)) {
+        ntag = tag_buf;
+    }
+    else {
+        ntag = flb_malloc(tag_len + 1);
+        if (!ntag) {
+            flb_errno();
+            flb_error("[filter] could not filter record due to memory problems");
+            return;
+        }
     }
     memcpy(ntag, tag, tag_len);
     ntag[tag_len] = '\0';
 
+    /* Resolve the filters that apply to this Tag */
+    route = NULL;
+    route_index = 0;
+    if (config->router_table) {
+        route = flb_router_route_get(config->router_table, ntag, tag_len);
+    }
+
     work_data = (char *) data;
     work_size = bytes;
 
+    /* Dispatch the records to the filter workers if possible */
+    if (config->filter_pool) {
+        ret = filter_do_workers(ic, data, bytes, &work_data, &work_size,
+                                ntag, tag_len, route, config);
+        if (ret == 0) {
+            goto done;
+        }
+    }
+
 #ifdef FLB_HAVE_METRICS
     /* timestamp */
     ts = cfl_time_now();
@@ -133,17 +550,12 @@ void flb_filter_do(struct flb_input_chunk *ic,
     mk_list_foreach(head, &config->filters) {
         f_ins = mk_list_entry(head, struct flb_filter_instance, _head);
 
-        if (is_active(&f_ins->properties) == FLB_FALSE) {
+        if (filter_match(route, &route_index, f_ins,
+                         ntag, tag_len) == FLB_FALSE) {
             continue;
         }
 
-        if (flb_router_match(ntag, tag_len, f_ins->match
-#ifdef FLB_HAVE_REGEX
-        , f_ins->match_regex
-#else
-        , NULL
-#endif
-           )) {
+        if (is_active(&f_ins->properties) == FLB_TRUE) {
             /* Reset filtered buffer */
             out_buf = NULL;
             out_size = 0;
@@ -256,10 +668,17 @@ void flb_filter_do(struct flb_input_chunk *ic,
         }
     }
 
+done:
+    if (route) {
+        flb_router_route_put(config->router_table, route);
+    }
+
     *out_data = work_data;
     *out_bytes = work_size;
 
-    flb_free(ntag);
+    if (ntag != tag_buf) {
+        flb_free(ntag);
+    }
 }
 
 int flb_filter_set_property(struct flb_filter_instance *ins,
@@ -349,6 +768,9 @@ void flb_filter_exit(struct flb_config *config)
     struct flb_filter_instance *ins;
     struct flb_filter_plugin *p;
 
+    /* No more records go through the filters */
+    flb_filter_pool_destroy(config);
+
     mk_list_foreach_safe(head, tmp, &config->filters) {
         ins = mk_list_entry(head, struct flb_filter_instance, _head);
         p = ins->p;
@@ -412,6 +834,7 @@ struct flb_filter_instance *flb_filter_new(struct flb_config *config,
     instance->id    = id;
     instance->alias = NULL;
     instance->p     = plugin;
+    instance->flags = plugin->flags;
     instance->data  = data;
     instance->match = NULL;
 #ifdef FLB_HAVE_REGEX
@@ -595,6 +1018,19 @@ int flb_filter_init(struct flb_config *config, struct flb_filter_instance *ins)
         }
     }
 
+    /*
+     * Time spent by the records in the filter workers queue, registered once
+     * the instance had the chance to opt out of the workers.
+     */
+    if (config->filter_workers > 0 && (ins->flags & FLB_FILTER_THREADSAFE)) {
+        ins->cmt_queue_wait = cmt_counter_create(ins->cmt,
+                                                 "fluentbit", "filter",
+                                                 "queue_wait_seconds_total",
+                                                 "Total time records waited for a filter worker.",
+                                                 1, (char *[]) {"name"});
+        cmt_counter_set(ins->cmt_queue_wait, ts, 0, 1, (char *[]) {name});
+    }
+
     return 0;
 }
 
@@ -616,7 +1052,8 @@ int flb_filter_init_all(struct flb_config *config)
         }
     }
 
-    return 0;
+    /* Start the filter workers, if any */
+    return flb_filter_pool_create(config);
 }
 
 void flb_filter_instance_destroy(struct flb_filter_instance *ins)
@@ -0,0 +1,260 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_config.h>
+#include <fluent-bit/flb_filter_worker.h>
+#include <fluent-bit/flb_arena.h>
+#include <fluent-bit/flb_thread_storage.h>
+
+#include <cfl/cfl_time.h>
+
+FLB_TLS_DEFINE(struct flb_filter_worker, flb_filter_worker_ctx);
+
+void flb_filter_worker_init()
+{
+    FLB_TLS_INIT(flb_filter_worker_ctx);
+}
+
+/* Id of the running filter worker, 0 for any other thread */
+int flb_filter_worker_id()
+{
+    struct flb_filter_worker *worker;
+
+    worker = FLB_TLS_GET(flb_filter_worker_ctx);
+    if (!worker) {
+        return 0;
+    }
+    return worker->id;
+}
+
+/* Number of threads that can run the filters: the caller plus the workers */
+int flb_filter_worker_slots(struct flb_config *config)
+{
+    if (config->filter_workers <= 0) {
+        return 1;
+    }
+    return config->filter_workers + 1;
+}
+
+/* Take the next job of the queue, the pool mutex must be held */
+static struct flb_filter_job *queue_pop(struct flb_filter_pool *pool)
+{
+    struct flb_filter_job *job;
+
+    job = pool->queue[pool->queue_head];
+    pool->queue_head = (pool->queue_head + 1) % pool->queue_size;
+    pool->queue_count--;
+
+    return job;
+}
+
+static void filter_worker(void *data)
+{
+    struct flb_filter_job *job;
+    struct flb_filter_worker *worker = data;
+    struct flb_filter_pool *pool = worker->pool;
+
+    FLB_TLS_SET(flb_filter_worker_ctx, worker);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (FLB_TRUE) {
+        /* on stop, keep serving until no caller is queueing a batch */
+        while (pool->queue_count == 0 &&
+               !(pool->stop && pool->callers == 0)) {
+            pthread_cond_wait(&pool->cond_jobs, &pool->mutex);
+        }
+
+        if (pool->queue_count == 0) {
+            break;
+        }
+
+        job = queue_pop(pool);
+        pthread_cond_signal(&pool->cond_space);
+        pthread_mutex_unlock(&pool->mutex);
+
+        job->wait = cfl_time_now() - job->queued;
+        job->cb(job);
+
+        pthread_mutex_lock(&pool->mutex);
+        (*job->pending)--;
+        if (*job->pending == 0) {
+            pthread_cond_broadcast(&pool->cond_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    /* the filters may have created an arena for this thread */
+    flb_arena_thread_destroy();
+}
+
+/* Start the workers if 'filter.workers' is set */
+int flb_filter_pool_create(struct flb_config *config)
+{
+    int i;
+    struct flb_tp_thread *th;
+    struct flb_filter_pool *pool;
+
+    if (config->filter_workers <= 0 || config->filter_pool) {
+        return 0;
+    }
+
+    pool = flb_calloc(1, sizeof(struct flb_filter_pool));
+    if (!pool) {
+        flb_errno();
+        return -1;
+    }
+    pool->config = config;
+    pool->workers = config->filter_workers;
+    pool->queue_size = pool->workers * FLB_FILTER_WORKER_QUEUE_SIZE;
+
+    pool->queue = flb_calloc(pool->queue_size, sizeof(struct flb_filter_job *));
+    if (!pool->queue) {
+        flb_errno();
+        flb_free(pool);
+        return -1;
+    }
+
+    pool->threads = flb_calloc(pool->workers, sizeof(struct flb_filter_worker));
+    if (!pool->threads) {
+        flb_errno();
+        flb_free(pool->queue);
+        flb_free(pool);
+        return -1;
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond_jobs, NULL);
+    pthread_cond_init(&pool->cond_space, NULL);
+    pthread_cond_init(&pool->cond_done, NULL);
+
+    pool->tp = flb_tp_create(config);
+    if (!pool->tp) {
+        flb_free(pool->threads);
+        flb_free(pool->queue);
+        flb_free(pool);
+        return -1;
+    }
+    config->filter_pool = pool;
+
+    for (i = 0; i < pool->workers; i++) {
+        pool->threads[i].id = i + 1;
+        pool->threads[i].pool = pool;
+        th = flb_tp_thread_create(pool->tp, filter_worker, &pool->threads[i],
+                                  config);
+        if (!th || flb_tp_thread_start(pool->tp, th) == -1) {
+            flb_error("[filter] could not start filter worker #%i", i);
+            flb_filter_pool_destroy(config);
+            return -1;
+        }
+    }
+
+    flb_info("[filter] started %i filter workers", pool->workers);
+    return 0;
+}
+
+void flb_filter_pool_destroy(struct flb_config *config)
+{
+    struct mk_list *head;
+    struct flb_tp_thread *th;
+    struct flb_filter_pool *pool = config->filter_pool;
+
+    if (!pool) {
+        return;
+    }
+
+    /*
+     * The queue is drained before the workers leave, batches being queued
+     * are completed too.
+     */
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = FLB_TRUE;
+    pthread_cond_broadcast(&pool->cond_jobs);
+    pthread_mutex_unlock(&pool->mutex);
+
+    mk_list_foreach(head, &pool->tp->list_threads) {
+        th = mk_list_entry(head, struct flb_tp_thread, _head);
+        if (th->status == FLB_THREAD_POOL_RUNNING) {
+            pthread_join(th->tid, NULL);
+        }
+    }
+    flb_tp_destroy(pool->tp);
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->cond_jobs);
+    pthread_cond_destroy(&pool->cond_space);
+    pthread_cond_destroy(&pool->cond_done);
+
+    flb_free(pool->threads);
+    flb_free(pool->queue);
+    flb_free(pool);
+    config->filter_pool = NULL;
+}
+
+/*
+ * Run a batch of jobs: all of them but the first one are queued for the
+ * workers, the first one runs in the caller thread. Returns once every job
+ * of the batch is done. If the queue is full the caller waits for room,
+ * which holds back the input appending the records.
+ */
+void flb_filter_pool_run(struct flb_filter_pool *pool,
+                         struct flb_filter_job **jobs, int count)
+{
+    int i;
+    int tail;
+    int pending;
+
+    pending = count - 1;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->callers++;
+    for (i = 1; i < count; i++) {
+        while (pool->queue_count == pool->queue_size) {
+            pthread_cond_wait(&pool->cond_space, &pool->mutex);
+        }
+
+        jobs[i]->pending = &pending;
+        jobs[i]->wait = 0;
+        jobs[i]->queued = cfl_time_now();
+
+        tail = (pool->queue_head + pool->queue_count) % pool->queue_size;
+        pool->queue[tail] = jobs[i];
+        pool->queue_count++;
+        pthread_cond_signal(&pool->cond_jobs);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (count > 0) {
+        jobs[0]->pending = NULL;
+        jobs[0]->wait = 0;
+        jobs[0]->cb(jobs[0]);
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pending > 0) {
+        pthread_cond_wait(&pool->cond_done, &pool->mutex);
+    }
+    pool->callers--;
+    if (pool->stop && pool->callers == 0) {
+        pthread_cond_broadcast(&pool->cond_jobs);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
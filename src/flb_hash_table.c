@@ -22,6 +22,7 @@
 #include <fluent-bit/flb_hash_table.h>
 #include <fluent-bit/flb_log.h>
 #include <fluent-bit/flb_str.h>
+#include <fluent-bit/flb_simd.h>
 
 #include <cfl/cfl.h>
 
@@ -39,6 +40,488 @@ static inline void flb_hash_table_entry_free(struct flb_hash_table *ht,
     flb_free(entry);
 }
 
+static int value_set(void **entry_val, ssize_t *entry_val_size,
+                     void *val, size_t val_size)
+{
+    char *ptr;
+
+    /*
+     * If the entry already contains a previous value in the heap, just remove
+     * the previously assigned memory.
+     */
+    if (*entry_val_size > 0) {
+        flb_free(*entry_val);
+    }
+
+    /*
+     * Now set the new value. If val_size > 0, we create a new memory area, otherwise
+     * it means the caller just wants to store a pointer address, no allocation
+     * is required.
+     */
+    if (val_size > 0) {
+        *entry_val = flb_malloc(val_size + 1);
+        if (!*entry_val) {
+            flb_errno();
+            return -1;
+        }
+
+        /*
+         * Copy the buffer and append a NULL byte in case the caller set and
+         * expects a string.
+         */
+        memcpy(*entry_val, val, val_size);
+        ptr = (char *) *entry_val;
+        ptr[val_size] = '\0';
+        *entry_val_size = val_size;
+    }
+    else {
+        /* just do a reference */
+        *entry_val = val;
+        *entry_val_size = -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Open addressing layout
+ * ======================
+ *
+ * Slots are stored in a single array and probed linearly by groups of
+ * CTRL_GROUP slots. Every slot has a control byte: CTRL_EMPTY, CTRL_DELETED
+ * or the 7 most significant bits of the key hash. A group of control bytes
+ * is compared at once (SIMD when available) and only the slots with a
+ * matching tag are visited. The control array has CTRL_GROUP extra bytes
+ * that mirror the first ones, so a group can be loaded from any position.
+ *
+ * Deleted slots are kept as tombstones, when a probe might have gone through
+ * them, until the table is rebuilt. The insertion order is tracked with slot
+ * indexes for FLB_HASH_TABLE_EVICT_OLDER.
+ */
+
+#define CTRL_EMPTY      0x80
+#define CTRL_DELETED    0xfe
+
+#ifdef FLB_SIMD_NONE
+#define CTRL_GROUP      8
+#else
+#define CTRL_GROUP      FLB_VECTOR8_SIZE
+#endif
+
+/*
+ * Up to 7/8 of the slots can be used, deleted ones included. When there is
+ * no room left the table is rebuilt, with twice the slots if more than 3/4
+ * of them are in use.
+ */
+#define OPEN_MAX_LOAD(capacity)   ((capacity) - ((capacity) >> 3))
+#define OPEN_GROW_LOAD(capacity)  ((capacity) - ((capacity) >> 2))
+#define OPEN_MAX_CAPACITY         (1 << 30)
+
+#define ctrl_is_full(c)           (((c) & 0x80) == 0)
+
+static inline uint8_t open_tag(uint64_t hash)
+{
+    return (uint8_t) (hash >> 57);
+}
+
+/* Bitmask of the slots in the group starting at 'ctrl' set to 'c' */
+static inline uint32_t ctrl_match(uint8_t *ctrl, uint8_t c)
+{
+#ifdef FLB_SIMD_NONE
+    int i;
+    uint32_t mask = 0;
+
+    for (i = 0; i < CTRL_GROUP; i++) {
+        if (ctrl[i] == c) {
+            mask |= (1 << i);
+        }
+    }
+    return mask;
+#else
+    return flb_vector8_mask(flb_vector8_eq(flb_vector8_load((const char *) ctrl),
+                                           flb_vector8_broadcast((char) c)));
+#endif
+}
+
+/* Bitmask of the empty or deleted slots in the group starting at 'ctrl' */
+static inline uint32_t ctrl_match_free(uint8_t *ctrl)
+{
+#ifdef FLB_SIMD_NONE
+    int i;
+    uint32_t mask = 0;
+
+    for (i = 0; i < CTRL_GROUP; i++) {
+        if (!ctrl_is_full(ctrl[i])) {
+            mask |= (1 << i);
+        }
+    }
+    return mask;
+#else
+    return flb_vector8_mask(flb_vector8_load((const char *) ctrl));
+#endif
+}
+
+static inline void ctrl_set(struct flb_hash_table *ht, size_t id, uint8_t c)
+{
+    ht->ctrl[id] = c;
+    if (id < CTRL_GROUP) {
+        ht->ctrl[ht->capacity + id] = c;
+    }
+}
+
+/*
+ * Find the slot of a key. If 'key' is NULL the first slot with the same
+ * hash is returned.
+ */
+static int32_t open_find(struct flb_hash_table *ht, uint64_t hash,
+                         const char *key, int key_len)
+{
+    int32_t id;
+    size_t pos;
+    size_t mask;
+    size_t probes;
+    uint8_t tag;
+    uint32_t match;
+    struct flb_hash_table_slot *slot;
+
+    mask = ht->capacity - 1;
+    pos = hash & mask;
+    tag = open_tag(hash);
+
+    for (probes = 0; probes < ht->capacity; probes += CTRL_GROUP) {
+        match = ctrl_match(&ht->ctrl[pos], tag);
+        while (match) {
+            id = (pos + flb_simd_ctz(match)) & mask;
+            slot = &ht->slots[id];
+            if (slot->hash == hash &&
+                (!key || (slot->key_len == key_len &&
+                          memcmp(slot->key, key, key_len) == 0))) {
+                return id;
+            }
+            match &= match - 1;
+        }
+
+        /* an empty slot ends the probe sequence */
+        if (ctrl_match(&ht->ctrl[pos], CTRL_EMPTY)) {
+            break;
+        }
+        pos = (pos + CTRL_GROUP) & mask;
+    }
+
+    return -1;
+}
+
+/* First empty or deleted slot in the probe sequence of 'hash' */
+static int32_t open_find_free(struct flb_hash_table *ht, uint64_t hash)
+{
+    size_t pos;
+    size_t mask;
+    uint32_t match;
+
+    mask = ht->capacity - 1;
+    pos = hash & mask;
+
+    while (1) {
+        match = ctrl_match_free(&ht->ctrl[pos]);
+        if (match) {
+            return (pos + flb_simd_ctz(match)) & mask;
+        }
+        pos = (pos + CTRL_GROUP) & mask;
+    }
+}
+
+static void open_link(struct flb_hash_table *ht, int32_t id)
+{
+    struct flb_hash_table_slot *slot = &ht->slots[id];
+
+    slot->older = ht->newest;
+    slot->newer = -1;
+
+    if (ht->newest >= 0) {
+        ht->slots[ht->newest].newer = id;
+    }
+    else {
+        ht->oldest = id;
+    }
+    ht->newest = id;
+}
+
+static void open_unlink(struct flb_hash_table *ht, int32_t id)
+{
+    struct flb_hash_table_slot *slot = &ht->slots[id];
+
+    if (slot->older >= 0) {
+        ht->slots[slot->older].newer = slot->newer;
+    }
+    else {
+        ht->oldest = slot->newer;
+    }
+
+    if (slot->newer >= 0) {
+        ht->slots[slot->newer].older = slot->older;
+    }
+    else {
+        ht->newest = slot->older;
+    }
+}
+
+static int open_alloc(struct flb_hash_table *ht, size_t capacity)
+{
+    ht->ctrl = flb_malloc(capacity + CTRL_GROUP);
+    if (!ht->ctrl) {
+        flb_errno();
+        return -1;
+    }
+    memset(ht->ctrl, CTRL_EMPTY, capacity + CTRL_GROUP);
+
+    ht->slots = flb_malloc(sizeof(struct flb_hash_table_slot) * capacity);
+    if (!ht->slots) {
+        flb_errno();
+        flb_free(ht->ctrl);
+        ht->ctrl = NULL;
+        return -1;
+    }
+
+    ht->capacity = capacity;
+    ht->deleted = 0;
+    ht->oldest = -1;
+    ht->newest = -1;
+
+    return 0;
+}
+
+/* Rebuild the table with 'capacity' slots, the insertion order is kept */
+static int open_resize(struct flb_hash_table *ht, size_t capacity)
+{
+    int ret;
+    int32_t id;
+    int32_t new_id;
+    uint8_t *old_ctrl;
+    struct flb_hash_table_slot *old_slots;
+    struct flb_hash_table_slot *slot;
+    struct flb_hash_table_slot *new_slot;
+
+    old_ctrl = ht->ctrl;
+    old_slots = ht->slots;
+    id = ht->oldest;
+
+    ret = open_alloc(ht, capacity);
+    if (ret == -1) {
+        ht->ctrl = old_ctrl;
+        ht->slots = old_slots;
+        return -1;
+    }
+
+    while (id >= 0) {
+        slot = &old_slots[id];
+
+        new_id = open_find_free(ht, slot->hash);
+        new_slot = &ht->slots[new_id];
+        memcpy(new_slot, slot, sizeof(struct flb_hash_table_slot));
+        if (slot->key == slot->inline_key) {
+            new_slot->key = new_slot->inline_key;
+        }
+
+        ctrl_set(ht, new_id, open_tag(slot->hash));
+        open_link(ht, new_id);
+
+        id = slot->newer;
+    }
+
+    flb_free(old_ctrl);
+    flb_free(old_slots);
+
+    return 0;
+}
+
+/* Make sure there is room for a new slot */
+static int open_reserve(struct flb_hash_table *ht)
+{
+    size_t capacity;
+
+    if (ht->total_count + ht->deleted + 1 <= OPEN_MAX_LOAD(ht->capacity)) {
+        return 0;
+    }
+
+    capacity = ht->capacity;
+    if (ht->total_count + 1 > OPEN_GROW_LOAD(capacity)) {
+        if (capacity >= OPEN_MAX_CAPACITY) {
+            return -1;
+        }
+        capacity <<= 1;
+    }
+
+    return open_resize(ht, capacity);
+}
+
+/*
+ * A slot can go back to empty (instead of deleted) if no group of slots
+ * around it has been full, so no probe sequence went through it.
+ */
+static int open_was_never_full(struct flb_hash_table *ht, int32_t id)
+{
+    uint32_t empty_before;
+    uint32_t empty_after;
+    size_t mask = ht->capacity - 1;
+
+    empty_before = ctrl_match(&ht->ctrl[(id - CTRL_GROUP) & mask], CTRL_EMPTY);
+    empty_after = ctrl_match(&ht->ctrl[id], CTRL_EMPTY);
+
+    if (!empty_before || !empty_after) {
+        return FLB_FALSE;
+    }
+
+    /* used slots right before 'id' plus used slots from 'id' */
+    if ((CTRL_GROUP - 1 - flb_simd_msb(empty_before)) +
+        flb_simd_ctz(empty_after) < CTRL_GROUP) {
+        return FLB_TRUE;
+    }
+
+    return FLB_FALSE;
+}
+
+static void open_slot_free(struct flb_hash_table *ht, int32_t id)
+{
+    struct flb_hash_table_slot *slot = &ht->slots[id];
+
+    open_unlink(ht, id);
+
+    if (slot->key != slot->inline_key) {
+        flb_free(slot->key);
+    }
+    if (slot->val && slot->val_size > 0) {
+        flb_free(slot->val);
+    }
+
+    if (open_was_never_full(ht, id)) {
+        ctrl_set(ht, id, CTRL_EMPTY);
+    }
+    else {
+        ctrl_set(ht, id, CTRL_DELETED);
+        ht->deleted++;
+    }
+    ht->total_count--;
+}
+
+static int open_add(struct flb_hash_table *ht, const char *key, int key_len,
+                    void *val, ssize_t val_size)
+{
+    int ret;
+    int32_t id;
+    uint64_t hash;
+    struct flb_hash_table_slot *slot;
+
+    hash = cfl_hash_64bits(key, key_len);
+
+    /* Check if this is a replacement */
+    id = open_find(ht, hash, key, key_len);
+    if (id >= 0) {
+        slot = &ht->slots[id];
+        ret = value_set(&slot->val, &slot->val_size, val, val_size);
+        if (ret == -1) {
+            return -1;
+        }
+        slot->created = time(NULL);
+        return id;
+    }
+
+    ret = open_reserve(ht);
+    if (ret == -1) {
+        return -1;
+    }
+
+    id = open_find_free(ht, hash);
+    slot = &ht->slots[id];
+
+    if (key_len < FLB_HASH_TABLE_INLINE_KEY) {
+        slot->key = slot->inline_key;
+    }
+    else {
+        slot->key = flb_malloc(key_len + 1);
+        if (!slot->key) {
+            flb_errno();
+            return -1;
+        }
+    }
+    memcpy(slot->key, key, key_len);
+    slot->key[key_len] = '\0';
+    slot->key_len = key_len;
+    slot->hash = hash;
+    slot->hits = 0;
+
+    /* store or reference the value */
+    slot->val = NULL;
+    slot->val_size = 0;
+    ret = value_set(&slot->val, &slot->val_size, val, val_size);
+    if (ret == -1) {
+        if (slot->key != slot->inline_key) {
+            flb_free(slot->key);
+        }
+        return -1;
+    }
+    slot->created = time(NULL);
+
+    if (ht->ctrl[id] == CTRL_DELETED) {
+        ht->deleted--;
+    }
+    ctrl_set(ht, id, open_tag(hash));
+    open_link(ht, id);
+    ht->total_count++;
+
+    return id;
+}
+
+static void open_destroy(struct flb_hash_table *ht)
+{
+    int32_t id;
+    struct flb_hash_table_slot *slot;
+
+    for (id = ht->oldest; id >= 0; id = slot->newer) {
+        slot = &ht->slots[id];
+        if (slot->key != slot->inline_key) {
+            flb_free(slot->key);
+        }
+        if (slot->val && slot->val_size > 0) {
+            flb_free(slot->val);
+        }
+    }
+
+    flb_free(ht->ctrl);
+    flb_free(ht->slots);
+    flb_free(ht);
+}
+
+static void open_evict_random(struct flb_hash_table *ht)
+{
+    size_t i;
+    size_t id;
+
+    id = random() % ht->capacity;
+    for (i = 0; i < ht->capacity; i++) {
+        if (ctrl_is_full(ht->ctrl[id])) {
+            open_slot_free(ht, id);
+            return;
+        }
+        id = (id + 1) & (ht->capacity - 1);
+    }
+}
+
+static void open_evict_less_used(struct flb_hash_table *ht)
+{
+    int32_t id;
+    int32_t less_used = -1;
+
+    for (id = ht->oldest; id >= 0; id = ht->slots[id].newer) {
+        if (less_used == -1 || ht->slots[id].hits < ht->slots[less_used].hits) {
+            less_used = id;
+        }
+    }
+
+    if (less_used >= 0) {
+        open_slot_free(ht, less_used);
+    }
+}
+
 struct flb_hash_table *flb_hash_table_create(int evict_mode, size_t size, int max_entries)
 {
     int i;
@@ -56,11 +539,18 @@ struct flb_hash_table *flb_hash_table_create(int evict_mode, size_t size, int ma
     }
 
     mk_list_init(&ht->entries);
+    ht->type = FLB_HASH_TABLE_CHAINED;
     ht->evict_mode = evict_mode;
     ht->max_entries = max_entries;
     ht->size = size;
     ht->total_count = 0;
     ht->cache_ttl = 0;
+    ht->capacity = 0;
+    ht->deleted = 0;
+    ht->ctrl = NULL;
+    ht->slots = NULL;
+    ht->oldest = -1;
+    ht->newest = -1;
     ht->table = flb_calloc(1, sizeof(struct flb_hash_table_chain) * size);
     if (!ht->table) {
         flb_errno();
@@ -93,6 +583,71 @@ struct flb_hash_table *flb_hash_table_create_with_ttl(int cache_ttl, int evict_m
     return ht;
 }
 
+struct flb_hash_table *flb_hash_table_create_open(int evict_mode, size_t size,
+                                                  int max_entries)
+{
+    int ret;
+    size_t slots;
+    size_t capacity;
+    struct flb_hash_table *ht;
+
+    if (size <= 0) {
+        return NULL;
+    }
+
+    /* room for 'size' entries or the maximum number of entries if bigger */
+    slots = size;
+    if (max_entries > 0 && max_entries > slots) {
+        slots = max_entries;
+    }
+
+    capacity = CTRL_GROUP;
+    while (OPEN_GROW_LOAD(capacity) < slots) {
+        if (capacity >= OPEN_MAX_CAPACITY) {
+            return NULL;
+        }
+        capacity <<= 1;
+    }
+
+    ht = flb_calloc(1, sizeof(struct flb_hash_table));
+    if (!ht) {
+        flb_errno();
+        return NULL;
+    }
+
+    mk_list_init(&ht->entries);
+    ht->type = FLB_HASH_TABLE_OPEN;
+    ht->evict_mode = evict_mode;
+    ht->max_entries = max_entries;
+    ht->size = size;
+    ht->total_count = 0;
+    ht->cache_ttl = 0;
+    ht->table = NULL;
+
+    ret = open_alloc(ht, capacity);
+    if (ret == -1) {
+        flb_free(ht);
+        return NULL;
+    }
+
+    return ht;
+}
+
+struct flb_hash_table *flb_hash_table_create_open_with_ttl(int cache_ttl, int evict_mode,
+                                                           size_t size, int max_entries)
+{
+    struct flb_hash_table *ht;
+
+    ht = flb_hash_table_create_open(evict_mode, size, max_entries);
+    if (!ht) {
+        flb_errno();
+        return NULL;
+    }
+
+    ht->cache_ttl = cache_ttl;
+    return ht;
+}
+
 int flb_hash_table_del_ptr(struct flb_hash_table *ht, const char *key, int key_len,
                            void *ptr)
 {
@@ -104,6 +659,16 @@ int flb_hash_table_del_ptr(struct flb_hash_table *ht, const char *key, int key_l
 
     /* Generate hash number */
     hash = cfl_hash_64bits(key, key_len);
+
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        id = open_find(ht, hash, key, key_len);
+        if (id == -1 || ht->slots[id].val != ptr) {
+            return -1;
+        }
+        open_slot_free(ht, id);
+        return 0;
+    }
+
     id = (hash % ht->size);
 
     /* Link the new entry in our table at the end of the list */
@@ -135,6 +700,11 @@ void flb_hash_table_destroy(struct flb_hash_table *ht)
     struct flb_hash_table_entry *entry;
     struct flb_hash_table_chain *table;
 
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        open_destroy(ht);
+        return;
+    }
+
     for (i = 0; i < ht->size; i++) {
         table = &ht->table[i];
         mk_list_foreach_safe(head, tmp, &table->chains) {
@@ -155,6 +725,11 @@ static void flb_hash_table_evict_random(struct flb_hash_table *ht)
     struct mk_list *head;
     struct flb_hash_table_entry *entry;
 
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        open_evict_random(ht);
+        return;
+    }
+
     id = random() % ht->total_count;
     mk_list_foreach_safe(head, tmp, &ht->entries) {
         if (id == count) {
@@ -172,6 +747,11 @@ static void flb_hash_table_evict_less_used(struct flb_hash_table *ht)
     struct flb_hash_table_entry *entry;
     struct flb_hash_table_entry *entry_less_used = NULL;
 
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        open_evict_less_used(ht);
+        return;
+    }
+
     mk_list_foreach(head, &ht->entries) {
         entry = mk_list_entry(head, struct flb_hash_table_entry, _head_parent);
         if (!entry_less_used) {
@@ -189,6 +769,13 @@ static void flb_hash_table_evict_older(struct flb_hash_table *ht)
 {
     struct flb_hash_table_entry *entry;
 
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        if (ht->oldest >= 0) {
+            open_slot_free(ht, ht->oldest);
+        }
+        return;
+    }
+
     entry = mk_list_entry_first(&ht->entries, struct flb_hash_table_entry, _head_parent);
     flb_hash_table_entry_free(ht, entry);
 }
@@ -249,41 +836,11 @@ static struct flb_hash_table_entry *hash_get_entry(struct flb_hash_table *ht,
 
 static int entry_set_value(struct flb_hash_table_entry *entry, void *val, size_t val_size)
 {
-    char *ptr;
-
-    /*
-     * If the entry already contains a previous value in the heap, just remove
-     * the previously assigned memory.
-     */
-    if (entry->val_size > 0) {
-        flb_free(entry->val);
-    }
-
-    /*
-     * Now set the new value. If val_size > 0, we create a new memory area, otherwise
-     * it means the caller just wants to store a pointer address, no allocation
-     * is required.
-     */
-    if (val_size > 0) {
-        entry->val = flb_malloc(val_size + 1);
-        if (!entry->val) {
-            flb_errno();
-            return -1;
-        }
+    int ret;
 
-        /*
-         * Copy the buffer and append a NULL byte in case the caller set and
-         * expects a string.
-         */
-        memcpy(entry->val, val, val_size);
-        ptr = (char *) entry->val;
-        ptr[val_size] = '\0';
-        entry->val_size = val_size;
-    }
-    else {
-        /* just do a reference */
-        entry->val = val;
-        entry->val_size = -1;
+    ret = value_set(&entry->val, &entry->val_size, val, val_size);
+    if (ret == -1) {
+        return -1;
     }
 
     entry->created = time(NULL);
@@ -320,6 +877,10 @@ int flb_hash_table_add(struct flb_hash_table *ht, const char *key, int key_len,
         }
     }
 
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        return open_add(ht, key, key_len, val, val_size);
+    }
+
     /* Check if this is a replacement */
     entry = hash_get_entry(ht, key, key_len, &id);
     if (entry) {
@@ -386,8 +947,35 @@ int flb_hash_table_get(struct flb_hash_table *ht,
 {
     int id;
     struct flb_hash_table_entry *entry;
+    struct flb_hash_table_slot *slot;
     time_t expiration;
 
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        if (!key || key_len <= 0) {
+            return -1;
+        }
+
+        id = open_find(ht, cfl_hash_64bits(key, key_len), key, key_len);
+        if (id == -1) {
+            return -1;
+        }
+        slot = &ht->slots[id];
+
+        if (ht->cache_ttl > 0) {
+            expiration = slot->created + ht->cache_ttl;
+            if (time(NULL) > expiration) {
+                open_slot_free(ht, id);
+                return -1;
+            }
+        }
+
+        slot->hits++;
+        *out_buf = slot->val;
+        *out_size = slot->val_size;
+
+        return id;
+    }
+
     entry = hash_get_entry(ht, key, key_len, &id);
     if (!entry) {
         return -1;
@@ -416,6 +1004,13 @@ int flb_hash_table_exists(struct flb_hash_table *ht, uint64_t hash)
     struct flb_hash_table_chain *table;
     struct flb_hash_table_entry *entry;
 
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        if (open_find(ht, hash, NULL, 0) == -1) {
+            return FLB_FALSE;
+        }
+        return FLB_TRUE;
+    }
+
     id = (hash % ht->size);
     table = &ht->table[id];
 
@@ -441,6 +1036,22 @@ int flb_hash_table_get_by_id(struct flb_hash_table *ht, int id,
     struct mk_list *head;
     struct flb_hash_table_entry *entry = NULL;
     struct flb_hash_table_chain *table;
+    struct flb_hash_table_slot *slot;
+
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        if (id < 0 || id >= ht->capacity || !ctrl_is_full(ht->ctrl[id])) {
+            return -1;
+        }
+
+        slot = &ht->slots[id];
+        if (strcmp(slot->key, key) != 0) {
+            return -1;
+        }
+
+        *out_buf = slot->val;
+        *out_size = slot->val_size;
+        return 0;
+    }
 
     if (ht->size <= id) {
         return -1;
@@ -480,6 +1091,20 @@ void *flb_hash_table_get_ptr(struct flb_hash_table *ht, const char *key, int key
     int id;
     struct flb_hash_table_entry *entry;
 
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        if (!key || key_len <= 0) {
+            return NULL;
+        }
+
+        id = open_find(ht, cfl_hash_64bits(key, key_len), key, key_len);
+        if (id == -1) {
+            return NULL;
+        }
+
+        ht->slots[id].hits++;
+        return ht->slots[id].val;
+    }
+
     entry = hash_get_entry(ht, key, key_len, &id);
     if (!entry) {
         return NULL;
@@ -508,6 +1133,16 @@ int flb_hash_table_del(struct flb_hash_table *ht, const char *key)
     }
 
     hash = cfl_hash_64bits(key, len);
+
+    if (ht->type == FLB_HASH_TABLE_OPEN) {
+        id = open_find(ht, hash, key, len);
+        if (id == -1) {
+            return -1;
+        }
+        open_slot_free(ht, id);
+        return 0;
+    }
+
     id = (hash % ht->size);
 
     table = &ht->table[id];
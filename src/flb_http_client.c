@@ -38,6 +38,7 @@
 #include <fluent-bit/flb_log.h>
 #include <fluent-bit/flb_mem.h>
 #include <fluent-bit/flb_http_client.h>
+#include <fluent-bit/flb_http_client_http2.h>
 #include <fluent-bit/flb_http_client_debug.h>
 #include <fluent-bit/flb_utils.h>
 #include <fluent-bit/flb_base64.h>
@@ -1061,6 +1062,30 @@ int flb_http_set_content_encoding_gzip(struct flb_http_client *c)
     return ret;
 }
 
+/* Adds a header specifying that the payload is compressed with zstd */
+int flb_http_set_content_encoding_zstd(struct flb_http_client *c)
+{
+    int ret;
+
+    ret = flb_http_add_header(c,
+                              FLB_HTTP_HEADER_CONTENT_ENCODING,
+                              sizeof(FLB_HTTP_HEADER_CONTENT_ENCODING) - 1,
+                              "zstd", 4);
+    return ret;
+}
+
+/* Adds a header specifying that the payload is compressed with lz4 */
+int flb_http_set_content_encoding_lz4(struct flb_http_client *c)
+{
+    int ret;
+
+    ret = flb_http_add_header(c,
+                              FLB_HTTP_HEADER_CONTENT_ENCODING,
+                              sizeof(FLB_HTTP_HEADER_CONTENT_ENCODING) - 1,
+                              "lz4", 3);
+    return ret;
+}
+
 int flb_http_set_callback_context(struct flb_http_client *c,
                                   struct flb_callback *cb_ctx)
 {
@@ -1190,9 +1215,16 @@ int flb_http_do_request(struct flb_http_client *c, size_t *bytes)
     int ret;
     int crlf = 2;
     int new_size;
-    size_t bytes_header = 0;
-    size_t bytes_body = 0;
+    size_t bytes_sent = 0;
     char *tmp;
+    struct iovec iov[2];
+
+    /* The response of an HTTP/2 stream can only be read by flb_http_do */
+    if (c->u_conn->http2_session != NULL) {
+        flb_error("[http_client] cannot send a raw request over the HTTP/2 "
+                  "connection #%i", c->u_conn->fd);
+        return FLB_HTTP_ERROR;
+    }
 
     /* Try to add keep alive header */
     flb_http_set_keepalive(c);
@@ -1229,10 +1261,14 @@ int flb_http_do_request(struct flb_http_client *c, size_t *bytes)
     }
 #endif
 
-    /* Write the header */
-    ret = flb_io_net_write(c->u_conn,
-                           c->header_buf, c->header_len,
-                           &bytes_header);
+    /* Write the header and the body at once */
+    iov[0].iov_base = c->header_buf;
+    iov[0].iov_len = c->header_len;
+    iov[1].iov_base = (void *) c->body_buf;
+    iov[1].iov_len = c->body_len;
+
+    ret = flb_io_net_writev(c->u_conn, iov, c->body_len > 0 ? 2 : 1,
+                            &bytes_sent);
     if (ret == -1) {
         /* errno might be changed from the original call */
         if (errno != 0) {
@@ -1241,18 +1277,8 @@ int flb_http_do_request(struct flb_http_client *c, size_t *bytes)
         return FLB_HTTP_ERROR;
     }
 
-    if (c->body_len > 0) {
-        ret = flb_io_net_write(c->u_conn,
-                               c->body_buf, c->body_len,
-                               &bytes_body);
-        if (ret == -1) {
-            flb_errno();
-            return FLB_HTTP_ERROR;
-        }
-    }
-
     /* number of sent bytes */
-    *bytes = (bytes_header + bytes_body);
+    *bytes = bytes_sent;
 
     /* prep c->resp for incoming data */
     c->resp.data_len = 0;
@@ -1359,6 +1385,22 @@ int flb_http_do(struct flb_http_client *c, size_t *bytes)
 {
     int ret;
 
+    /* HTTP/2 connection: the request is sent as a new stream */
+    if (c->u_conn->http2_session != NULL) {
+        ret = flb_http2_client_do(c, bytes);
+        if (ret != 0) {
+            return ret;
+        }
+
+#ifdef FLB_HAVE_HTTP_CLIENT_DEBUG
+        flb_http_client_debug_cb(c, "_debug.http.response_headers");
+        if (c->resp.payload_size > 0) {
+            flb_http_client_debug_cb(c, "_debug.http.response_payload");
+        }
+#endif
+        return 0;
+    }
+
     ret = flb_http_do_request(c, bytes);
     if (ret != 0) {
         return ret;
@@ -0,0 +1,991 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_kv.h>
+#include <fluent-bit/flb_socket.h>
+#include <fluent-bit/flb_connection.h>
+#include <fluent-bit/flb_upstream.h>
+#include <fluent-bit/flb_engine_macros.h>
+#include <fluent-bit/flb_http_client.h>
+#include <fluent-bit/flb_http_client_http2.h>
+#include <fluent-bit/tls/flb_tls.h>
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+/* Non blocking write, returns NGHTTP2_ERR_WOULDBLOCK if it cannot write */
+static ssize_t connection_send(struct flb_connection *connection,
+                               const uint8_t *data, size_t len)
+{
+    ssize_t ret;
+
+#ifdef FLB_HAVE_TLS
+    if (connection->tls_session != NULL) {
+        ret = connection->tls_session->tls->api->net_write(
+                                                connection->tls_session,
+                                                data, len);
+        if (ret == FLB_TLS_WANT_READ || ret == FLB_TLS_WANT_WRITE) {
+            return NGHTTP2_ERR_WOULDBLOCK;
+        }
+        else if (ret <= 0) {
+            return NGHTTP2_ERR_CALLBACK_FAILURE;
+        }
+        return ret;
+    }
+#endif
+
+    ret = send(connection->fd, (const char *) data, len, 0);
+    if (ret == -1) {
+        if (FLB_WOULDBLOCK()) {
+            return NGHTTP2_ERR_WOULDBLOCK;
+        }
+        return NGHTTP2_ERR_CALLBACK_FAILURE;
+    }
+
+    return ret;
+}
+
+/* Non blocking read, returns NGHTTP2_ERR_EOF if the peer closed */
+static ssize_t connection_recv(struct flb_connection *connection,
+                               uint8_t *buf, size_t len)
+{
+    ssize_t ret;
+
+#ifdef FLB_HAVE_TLS
+    if (connection->tls_session != NULL) {
+        ret = connection->tls_session->tls->api->net_read(
+                                                connection->tls_session,
+                                                buf, len);
+        if (ret == FLB_TLS_WANT_READ || ret == FLB_TLS_WANT_WRITE) {
+            return NGHTTP2_ERR_WOULDBLOCK;
+        }
+        else if (ret == 0) {
+            return NGHTTP2_ERR_EOF;
+        }
+        else if (ret < 0) {
+            return NGHTTP2_ERR_CALLBACK_FAILURE;
+        }
+        return ret;
+    }
+#endif
+
+    ret = recv(connection->fd, (char *) buf, len, 0);
+    if (ret == 0) {
+        return NGHTTP2_ERR_EOF;
+    }
+    else if (ret == -1) {
+        if (FLB_WOULDBLOCK()) {
+            return NGHTTP2_ERR_WOULDBLOCK;
+        }
+        return NGHTTP2_ERR_CALLBACK_FAILURE;
+    }
+
+    return ret;
+}
+
+/*
+ * Resume the coroutine waiting for a stream. A stream has at most one wake
+ * up pending, it's cleared here so the waiter is never resumed twice.
+ */
+static void stream_resume(struct flb_http2_client_stream *stream, int type)
+{
+    if (stream->wake_pending != type) {
+        return;
+    }
+    stream->wake_pending = FLB_HTTP2_CLIENT_WAKE_NONE;
+
+    if (stream->coro != NULL) {
+        flb_coro_resume(stream->coro);
+    }
+}
+
+/* The connection event is processed by the engine: resume the waiter */
+static int cb_stream_wake(void *data)
+{
+    struct flb_http2_client_stream *stream = data;
+
+    stream_resume(stream, FLB_HTTP2_CLIENT_WAKE_QUEUED);
+    return 0;
+}
+
+/*
+ * Wake up the coroutine waiting for a stream: the event is injected in the
+ * event loop that is running the current coroutine so the waiter is resumed
+ * once the current one yields. If the loop has no room for it, the driver
+ * resumes the waiter by itself once it's out of the nghttp2 calls.
+ */
+static void stream_wake(struct flb_http2_client_session *session,
+                        struct flb_http2_client_stream *stream)
+{
+    int ret;
+    struct flb_connection *connection = session->connection;
+
+    if (stream->coro == NULL ||
+        stream->wake_pending != FLB_HTTP2_CLIENT_WAKE_NONE) {
+        return;
+    }
+
+    ret = mk_event_inject(connection->evl, &stream->event,
+                          MK_EVENT_READ, FLB_FALSE);
+    if (ret == 0) {
+        stream->wake_pending = FLB_HTTP2_CLIENT_WAKE_QUEUED;
+    }
+    else {
+        stream->wake_pending = FLB_HTTP2_CLIENT_WAKE_DIRECT;
+        session->wake_direct = FLB_TRUE;
+    }
+}
+
+static void session_wake_direct(struct flb_http2_client_session *session,
+                                struct flb_coro *co)
+{
+    struct mk_list *tmp;
+    struct mk_list *head;
+    struct flb_http2_client_stream *stream;
+
+    if (!session->wake_direct) {
+        return;
+    }
+    session->wake_direct = FLB_FALSE;
+
+    mk_list_foreach_safe(head, tmp, &session->streams) {
+        stream = mk_list_entry(head, struct flb_http2_client_stream, _head);
+        if (stream->wake_pending == FLB_HTTP2_CLIENT_WAKE_DIRECT) {
+            stream_resume(stream, FLB_HTTP2_CLIENT_WAKE_DIRECT);
+            flb_coro_set(co);
+        }
+    }
+}
+
+/* Mark the session as broken and wake up every waiter */
+static void session_fail(struct flb_http2_client_session *session,
+                         const char *reason)
+{
+    struct mk_list *head;
+    struct flb_connection *connection = session->connection;
+    struct flb_http2_client_stream *stream;
+
+    if (session->failed) {
+        return;
+    }
+    session->failed = FLB_TRUE;
+
+    flb_debug("[http2_client] connection #%i to %s:%i: %s",
+              connection->fd,
+              connection->upstream->tcp_host,
+              connection->upstream->tcp_port,
+              reason);
+
+    /* the connection cannot be used anymore */
+    flb_upstream_conn_recycle(connection, FLB_FALSE);
+
+    mk_list_foreach(head, &session->streams) {
+        stream = mk_list_entry(head, struct flb_http2_client_stream, _head);
+        stream_wake(session, stream);
+    }
+}
+
+static void session_restore_event(struct flb_http2_client_session *session)
+{
+    struct mk_event *backup = &session->event_backup;
+    struct flb_connection *connection = session->connection;
+
+    if (!session->event_saved) {
+        return;
+    }
+    session->event_saved = FLB_FALSE;
+
+    if (MK_EVENT_IS_REGISTERED((&connection->event))) {
+        mk_event_del(connection->evl, &connection->event);
+    }
+
+    if (MK_EVENT_IS_REGISTERED(backup)) {
+        connection->event.priority = backup->priority;
+        connection->event.handler = backup->handler;
+
+        mk_event_add(connection->evl,
+                     connection->fd,
+                     backup->type,
+                     backup->mask,
+                     &connection->event);
+    }
+}
+
+/* Register the socket for the events the driver needs to wait for */
+static int session_watch(struct flb_http2_client_session *session)
+{
+    int ret;
+    int mask = MK_EVENT_READ;
+    struct flb_connection *connection = session->connection;
+
+    if (session->write_blocked) {
+        mask |= MK_EVENT_WRITE;
+    }
+
+    if (MK_EVENT_IS_REGISTERED((&connection->event)) &&
+        connection->event.type == FLB_ENGINE_EV_THREAD &&
+        connection->event.mask == mask) {
+        return 0;
+    }
+
+    ret = mk_event_add(connection->evl,
+                       connection->fd,
+                       FLB_ENGINE_EV_THREAD,
+                       mask,
+                       &connection->event);
+    connection->event.priority = FLB_ENGINE_PRIORITY_SEND_RECV;
+
+    return ret;
+}
+
+/* Write as much as possible of the pending frames */
+static int session_send(struct flb_http2_client_session *session)
+{
+    int ret;
+
+    session->write_blocked = FLB_FALSE;
+
+    ret = nghttp2_session_send(session->inner_session);
+    if (ret != 0) {
+        session_fail(session, nghttp2_strerror(ret));
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Read and process the available data, only one read if 'once' is set */
+static int session_recv(struct flb_http2_client_session *session, int once)
+{
+    ssize_t ret;
+    ssize_t bytes;
+    struct flb_connection *connection = session->connection;
+
+    while (FLB_TRUE) {
+        bytes = connection_recv(connection,
+                                (uint8_t *) session->read_buf,
+                                FLB_HTTP2_CLIENT_READ_SIZE);
+        if (bytes == NGHTTP2_ERR_WOULDBLOCK) {
+            return 0;
+        }
+        else if (bytes < 0) {
+            session_fail(session, "connection closed");
+            return -1;
+        }
+
+        flb_connection_reset_io_timeout(connection);
+
+        ret = nghttp2_session_mem_recv(session->inner_session,
+                                       (uint8_t *) session->read_buf, bytes);
+        if (ret < 0) {
+            session_fail(session, nghttp2_strerror(ret));
+            return -1;
+        }
+
+        if (once) {
+            return 0;
+        }
+    }
+}
+
+static int response_append(struct flb_http_client *c,
+                           const void *data, size_t len)
+{
+    int ret;
+    size_t out_size;
+
+    /* keep room for the ending NULL byte */
+    while (flb_http_buffer_available(c) <= len) {
+        ret = flb_http_buffer_increase(c, len + FLB_HTTP_DATA_CHUNK,
+                                       &out_size);
+        if (ret == -1) {
+            flb_warn("[http2_client] cannot increase buffer: current=%zu "
+                     "requested=%zu max=%zu", c->resp.data_size,
+                     c->resp.data_size + len, c->resp.data_size_max);
+            return -1;
+        }
+    }
+
+    memcpy(c->resp.data + c->resp.data_len, data, len);
+    c->resp.data_len += len;
+    c->resp.data[c->resp.data_len] = '\0';
+
+    return 0;
+}
+
+static void stream_cancel(nghttp2_session *inner_session,
+                          struct flb_http2_client_stream *stream)
+{
+    stream->error = FLB_TRUE;
+    nghttp2_submit_rst_stream(inner_session, NGHTTP2_FLAG_NONE,
+                              stream->id, NGHTTP2_CANCEL);
+}
+
+static ssize_t cb_send(nghttp2_session *inner_session,
+                       const uint8_t *data, size_t length,
+                       int flags, void *user_data)
+{
+    ssize_t ret;
+    struct flb_http2_client_session *session = user_data;
+
+    ret = connection_send(session->connection, data, length);
+    if (ret == NGHTTP2_ERR_WOULDBLOCK) {
+        session->write_blocked = FLB_TRUE;
+    }
+    else if (ret > 0) {
+        flb_connection_reset_io_timeout(session->connection);
+    }
+
+    return ret;
+}
+
+/*
+ * The response headers are stored in 'resp.data' with the same layout of an
+ * HTTP/1.1 response so the callers can look them up as usual.
+ */
+static int cb_header(nghttp2_session *inner_session,
+                     const nghttp2_frame *frame,
+                     const uint8_t *name, size_t namelen,
+                     const uint8_t *value, size_t valuelen,
+                     uint8_t flags, void *user_data)
+{
+    int ret;
+    char status[32];
+    struct flb_http_client *c;
+    struct flb_http2_client_stream *stream;
+
+    if (frame->hd.type != NGHTTP2_HEADERS) {
+        return 0;
+    }
+
+    stream = nghttp2_session_get_stream_user_data(inner_session,
+                                                  frame->hd.stream_id);
+    if (stream == NULL || stream->headers_done || stream->error) {
+        return 0;
+    }
+    c = stream->c;
+
+    if (namelen == 7 && memcmp(name, ":status", 7) == 0) {
+        c->resp.status = atoi((const char *) value);
+        ret = snprintf(status, sizeof(status) - 1, "HTTP/2 %i\r\n",
+                       c->resp.status);
+        ret = response_append(c, status, ret);
+    }
+    else if (namelen > 0 && name[0] == ':') {
+        return 0;
+    }
+    else {
+        if (namelen == 14 && strncasecmp((const char *) name,
+                                         "content-length", 14) == 0) {
+            c->resp.content_length = atoi((const char *) value);
+        }
+
+        ret = response_append(c, name, namelen);
+        if (ret == 0) {
+            ret = response_append(c, ": ", 2);
+        }
+        if (ret == 0) {
+            ret = response_append(c, value, valuelen);
+        }
+        if (ret == 0) {
+            ret = response_append(c, "\r\n", 2);
+        }
+    }
+
+    if (ret == -1) {
+        stream_cancel(inner_session, stream);
+    }
+
+    return 0;
+}
+
+static int cb_frame_recv(nghttp2_session *inner_session,
+                         const nghttp2_frame *frame, void *user_data)
+{
+    struct flb_http_client *c;
+    struct flb_http2_client_stream *stream;
+
+    if (frame->hd.type != NGHTTP2_HEADERS ||
+        (frame->hd.flags & NGHTTP2_FLAG_END_HEADERS) == 0) {
+        return 0;
+    }
+
+    stream = nghttp2_session_get_stream_user_data(inner_session,
+                                                  frame->hd.stream_id);
+    if (stream == NULL || stream->headers_done || stream->error) {
+        return 0;
+    }
+    c = stream->c;
+
+    /* informational responses are followed by the final one */
+    if (c->resp.status < 200) {
+        c->resp.status = 0;
+        c->resp.content_length = -1;
+        c->resp.data_len = 0;
+        c->resp.data[0] = '\0';
+        return 0;
+    }
+
+    if (response_append(c, "\r\n", 2) == -1) {
+        stream_cancel(inner_session, stream);
+        return 0;
+    }
+    stream->headers_done = FLB_TRUE;
+    stream->headers_len = c->resp.data_len;
+
+    return 0;
+}
+
+static int cb_data_chunk_recv(nghttp2_session *inner_session, uint8_t flags,
+                              int32_t stream_id, const uint8_t *data,
+                              size_t len, void *user_data)
+{
+    struct flb_http2_client_stream *stream;
+
+    stream = nghttp2_session_get_stream_user_data(inner_session, stream_id);
+    if (stream == NULL || stream->error) {
+        return 0;
+    }
+
+    if (response_append(stream->c, data, len) == -1) {
+        stream_cancel(inner_session, stream);
+    }
+
+    return 0;
+}
+
+static int cb_stream_close(nghttp2_session *inner_session, int32_t stream_id,
+                           uint32_t error_code, void *user_data)
+{
+    struct flb_http2_client_session *session = user_data;
+    struct flb_http2_client_stream *stream;
+
+    stream = nghttp2_session_get_stream_user_data(inner_session, stream_id);
+    if (stream == NULL) {
+        return 0;
+    }
+
+    if (error_code != NGHTTP2_NO_ERROR || !stream->headers_done) {
+        flb_debug("[http2_client] stream %i closed: %s", stream_id,
+                  nghttp2_http2_strerror(error_code));
+        stream->error = FLB_TRUE;
+    }
+    stream->done = FLB_TRUE;
+    stream_wake(session, stream);
+
+    return 0;
+}
+
+/*
+ * The request body is read directly from the caller buffer, nghttp2 asks for
+ * more only when the flow control windows of the stream and the connection
+ * have room for it.
+ */
+static ssize_t cb_body_read(nghttp2_session *inner_session, int32_t stream_id,
+                            uint8_t *buf, size_t length, uint32_t *data_flags,
+                            nghttp2_data_source *source, void *user_data)
+{
+    size_t len;
+    struct flb_http_client *c;
+    struct flb_http2_client_stream *stream;
+
+    /* the caller is gone if the stream has no data */
+    stream = nghttp2_session_get_stream_user_data(inner_session, stream_id);
+    if (stream == NULL) {
+        return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
+    }
+    c = stream->c;
+
+    len = c->body_len - stream->body_offset;
+    if (len > length) {
+        len = length;
+    }
+
+    memcpy(buf, c->body_buf + stream->body_offset, len);
+    stream->body_offset += len;
+
+    if (stream->body_offset == c->body_len) {
+        *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+
+    return len;
+}
+
+int flb_http2_client_session_create(struct flb_connection *connection)
+{
+    int ret;
+    char alpn[16];
+    nghttp2_settings_entry settings[1];
+    nghttp2_session_callbacks *callbacks;
+    struct flb_http2_client_session *session;
+
+    /* TLS connections only speak h2 if the server agreed through ALPN */
+#ifdef FLB_HAVE_TLS
+    if (connection->tls_session != NULL) {
+        ret = flb_tls_session_get_alpn(connection->tls_session,
+                                       alpn, sizeof(alpn));
+        if (ret != 2 || strncmp(alpn, "h2", 2) != 0) {
+            flb_debug("[http2_client] connection #%i to %s:%i: h2 was not "
+                      "negotiated, using HTTP/1.1",
+                      connection->fd,
+                      connection->upstream->tcp_host,
+                      connection->upstream->tcp_port);
+            return 0;
+        }
+    }
+#endif
+
+    session = flb_calloc(1, sizeof(struct flb_http2_client_session));
+    if (!session) {
+        flb_errno();
+        return -1;
+    }
+    session->connection = connection;
+    mk_list_init(&session->streams);
+
+    session->read_buf = flb_malloc(FLB_HTTP2_CLIENT_READ_SIZE);
+    if (!session->read_buf) {
+        flb_errno();
+        flb_free(session);
+        return -1;
+    }
+
+    ret = nghttp2_session_callbacks_new(&callbacks);
+    if (ret != 0) {
+        flb_free(session->read_buf);
+        flb_free(session);
+        return -1;
+    }
+
+    nghttp2_session_callbacks_set_send_callback(callbacks, cb_send);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, cb_header);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks,
+                                                         cb_frame_recv);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(
+                                                callbacks, cb_data_chunk_recv);
+    nghttp2_session_callbacks_set_on_stream_close_callback(callbacks,
+                                                           cb_stream_close);
+
+    ret = nghttp2_session_client_new(&session->inner_session, callbacks,
+                                     session);
+    nghttp2_session_callbacks_del(callbacks);
+
+    if (ret != 0) {
+        flb_free(session->read_buf);
+        flb_free(session);
+        return -1;
+    }
+
+    /* the connection preface and settings go out with the first request */
+    settings[0].settings_id = NGHTTP2_SETTINGS_ENABLE_PUSH;
+    settings[0].value = 0;
+
+    ret = nghttp2_submit_settings(session->inner_session, NGHTTP2_FLAG_NONE,
+                                  settings, 1);
+    if (ret != 0) {
+        flb_http2_client_session_destroy(session);
+        return -1;
+    }
+
+    connection->http2_session = session;
+
+    flb_debug("[http2_client] connection #%i to %s:%i is using HTTP/2",
+              connection->fd,
+              connection->upstream->tcp_host,
+              connection->upstream->tcp_port);
+
+    return 0;
+}
+
+void flb_http2_client_session_destroy(struct flb_http2_client_session *session)
+{
+    if (!session) {
+        return;
+    }
+
+    if (session->connection->http2_session == session) {
+        session->connection->http2_session = NULL;
+    }
+
+    nghttp2_session_del(session->inner_session);
+    flb_free(session->read_buf);
+    flb_free(session);
+}
+
+/* Check if the session can take one more concurrent caller */
+int flb_http2_client_session_available(struct flb_http2_client_session *session)
+{
+    uint32_t limit;
+    uint32_t remote;
+
+    if (session->failed ||
+        !nghttp2_session_check_request_allowed(session->inner_session)) {
+        return FLB_FALSE;
+    }
+
+    limit = session->connection->net->http2_max_streams;
+    remote = nghttp2_session_get_remote_settings(
+                                session->inner_session,
+                                NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS);
+    if (remote < limit) {
+        limit = remote;
+    }
+
+    if (session->users >= limit) {
+        return FLB_FALSE;
+    }
+
+    return FLB_TRUE;
+}
+
+static const char *method_name(int method)
+{
+    switch (method) {
+    case FLB_HTTP_GET:
+        return "GET";
+    case FLB_HTTP_POST:
+        return "POST";
+    case FLB_HTTP_PUT:
+        return "PUT";
+    case FLB_HTTP_HEAD:
+        return "HEAD";
+    case FLB_HTTP_PATCH:
+        return "PATCH";
+    };
+
+    return NULL;
+}
+
+/* Headers that are specific to HTTP/1.1 connections */
+static int header_is_connection_specific(const char *name, size_t len)
+{
+    if ((len == 10 && strncasecmp(name, "connection", len) == 0) ||
+        (len == 10 && strncasecmp(name, "keep-alive", len) == 0) ||
+        (len == 16 && strncasecmp(name, "proxy-connection", len) == 0) ||
+        (len == 17 && strncasecmp(name, "transfer-encoding", len) == 0) ||
+        (len == 7 && strncasecmp(name, "upgrade", len) == 0)) {
+        return FLB_TRUE;
+    }
+
+    return FLB_FALSE;
+}
+
+#define NV_SET(nv, n, n_len, v, v_len)          \
+    (nv)->name = (uint8_t *) (n);               \
+    (nv)->namelen = (n_len);                    \
+    (nv)->value = (uint8_t *) (v);              \
+    (nv)->valuelen = (v_len);                   \
+    (nv)->flags = NGHTTP2_NV_FLAG_NONE;
+
+/* Compose the pseudo headers and the lower case headers of the request */
+static int stream_submit(struct flb_http2_client_session *session,
+                         struct flb_http2_client_stream *stream)
+{
+    int i;
+    int count;
+    int32_t id;
+    size_t j;
+    size_t len;
+    size_t names_size = 0;
+    char *names;
+    char *name;
+    const char *path;
+    const char *method;
+    const char *scheme;
+    const char *authority = NULL;
+    size_t authority_len = 0;
+    struct mk_list *head;
+    struct flb_kv *kv;
+    struct flb_http_client *c = stream->c;
+    struct flb_upstream *u = c->u_conn->upstream;
+    nghttp2_nv *nva;
+    nghttp2_data_provider provider;
+
+    method = method_name(c->method);
+    if (!method) {
+        flb_error("[http2_client] method not supported over HTTP/2");
+        return -1;
+    }
+
+    scheme = c->u_conn->tls_session ? "https" : "http";
+    path = (c->uri && c->uri[0] != '\0') ? c->uri : "/";
+
+    count = 4;
+    mk_list_foreach(head, &c->headers) {
+        kv = mk_list_entry(head, struct flb_kv, _head);
+        names_size += flb_sds_len(kv->key);
+        count++;
+    }
+
+    nva = flb_calloc(count, sizeof(nghttp2_nv));
+    if (!nva) {
+        flb_errno();
+        return -1;
+    }
+
+    names = flb_malloc(names_size + 1);
+    if (!names) {
+        flb_errno();
+        flb_free(nva);
+        return -1;
+    }
+
+    i = 4;
+    name = names;
+    mk_list_foreach(head, &c->headers) {
+        kv = mk_list_entry(head, struct flb_kv, _head);
+        len = flb_sds_len(kv->key);
+
+        if (len == 4 && strncasecmp(kv->key, "host", 4) == 0) {
+            authority = kv->val;
+            authority_len = flb_sds_len(kv->val);
+            continue;
+        }
+        else if (header_is_connection_specific(kv->key, len)) {
+            continue;
+        }
+
+        for (j = 0; j < len; j++) {
+            name[j] = tolower((unsigned char) kv->key[j]);
+        }
+
+        NV_SET(&nva[i], name, len, kv->val, flb_sds_len(kv->val));
+        name += len;
+        i++;
+    }
+
+    if (!authority) {
+        authority = u->tcp_host;
+        authority_len = strlen(u->tcp_host);
+    }
+
+    NV_SET(&nva[0], ":method", 7, method, strlen(method));
+    NV_SET(&nva[1], ":scheme", 7, scheme, strlen(scheme));
+    NV_SET(&nva[2], ":authority", 10, authority, authority_len);
+    NV_SET(&nva[3], ":path", 5, path, strlen(path));
+
+    if (c->body_len > 0) {
+        provider.source.ptr = stream;
+        provider.read_callback = cb_body_read;
+        id = nghttp2_submit_request(session->inner_session, NULL, nva, i,
+                                    &provider, stream);
+    }
+    else {
+        id = nghttp2_submit_request(session->inner_session, NULL, nva, i,
+                                    NULL, stream);
+    }
+
+    flb_free(names);
+    flb_free(nva);
+
+    if (id < 0) {
+        flb_error("[http2_client] cannot submit request: %s",
+                  nghttp2_strerror(id));
+        return -1;
+    }
+    stream->id = id;
+
+    return 0;
+}
+
+/*
+ * The current coroutine takes care of the connection I/O until its own
+ * stream is done, completing the streams of the other callers on the way.
+ */
+static void stream_drive(struct flb_http2_client_session *session,
+                         struct flb_http2_client_stream *stream,
+                         struct flb_coro *co)
+{
+    int ret;
+    struct mk_list *head;
+    struct flb_http2_client_stream *next;
+    struct flb_connection *connection = session->connection;
+
+    session->driver = co;
+    if (!session->event_saved) {
+        memcpy(&session->event_backup, &connection->event,
+               sizeof(struct mk_event));
+        session->event_saved = FLB_TRUE;
+    }
+
+    ret = session_send(session);
+    while (ret == 0 && !stream->done && !session->failed) {
+        if (session_watch(session) == -1) {
+            session_fail(session, "cannot register the connection");
+            break;
+        }
+
+        connection->coroutine = co;
+        flb_coro_yield(co, FLB_FALSE);
+        connection->coroutine = NULL;
+
+        /* the connection was shutdown because of a timeout */
+        if (connection->net_error != -1) {
+            session_fail(session, "connection timed out");
+            break;
+        }
+
+        ret = session_recv(session, FLB_FALSE);
+        session_wake_direct(session, co);
+        if (ret == 0) {
+            ret = session_send(session);
+        }
+    }
+
+    session->driver = NULL;
+
+    /* hand over the connection to a caller still waiting for a response */
+    mk_list_foreach(head, &session->streams) {
+        next = mk_list_entry(head, struct flb_http2_client_stream, _head);
+        if (next != stream && !next->done && next->coro != NULL) {
+            stream_wake(session, next);
+            session_wake_direct(session, co);
+            return;
+        }
+    }
+
+    session_restore_event(session);
+}
+
+/*
+ * Let the driver know there are frames to write, it's only waiting for the
+ * socket to be readable.
+ */
+static void stream_flush(struct flb_http2_client_session *session)
+{
+    if (session_send(session) == -1) {
+        return;
+    }
+
+    if (session->write_blocked && session->driver != NULL &&
+        session->connection->coroutine == session->driver) {
+        if (session_watch(session) == -1) {
+            session_fail(session, "cannot register the connection");
+        }
+    }
+}
+
+int flb_http2_client_do(struct flb_http_client *c, size_t *bytes)
+{
+    int ret;
+    int async;
+    size_t headers_len;
+    struct flb_coro *co;
+    struct flb_connection *connection = c->u_conn;
+    struct flb_http2_client_session *session = connection->http2_session;
+    struct flb_http2_client_stream *stream;
+
+    *bytes = 0;
+
+    if (session->failed) {
+        return -1;
+    }
+
+    stream = flb_calloc(1, sizeof(struct flb_http2_client_stream));
+    if (!stream) {
+        flb_errno();
+        return -1;
+    }
+    MK_EVENT_INIT(&stream->event, -1, stream, cb_stream_wake);
+    stream->event.type = FLB_ENGINE_EV_CUSTOM;
+    stream->event.priority = FLB_ENGINE_PRIORITY_SEND_RECV;
+    stream->c = c;
+
+    c->resp.data_len = 0;
+    c->resp.data[0] = '\0';
+
+    ret = stream_submit(session, stream);
+    if (ret == -1) {
+        flb_free(stream);
+        return -1;
+    }
+    mk_list_add(&stream->_head, &session->streams);
+
+    co = flb_coro_get();
+    async = (flb_connection_get_flags(connection) & FLB_IO_ASYNC) && co;
+
+    if (async) {
+        while (!stream->done && !session->failed) {
+            if (session->driver == NULL) {
+                stream_drive(session, stream, co);
+                continue;
+            }
+
+            /* another caller is in charge of the I/O, wait for it */
+            stream_flush(session);
+            if (stream->done || session->failed) {
+                break;
+            }
+
+            stream->coro = co;
+            flb_coro_yield(co, FLB_FALSE);
+            stream->coro = NULL;
+        }
+    }
+    else {
+        /* blocking socket: write the pending frames and read a response */
+        ret = session_send(session);
+        while (ret == 0 && !stream->done && !session->failed) {
+            ret = session_recv(session, FLB_TRUE);
+            if (ret == 0) {
+                ret = session_send(session);
+            }
+        }
+    }
+
+    mk_list_del(&stream->_head);
+
+    if (!stream->done) {
+        /* the stream cannot reference the caller data anymore */
+        nghttp2_session_set_stream_user_data(session->inner_session,
+                                             stream->id, NULL);
+        if (!session->failed) {
+            nghttp2_submit_rst_stream(session->inner_session,
+                                      NGHTTP2_FLAG_NONE,
+                                      stream->id, NGHTTP2_CANCEL);
+        }
+        stream->error = FLB_TRUE;
+    }
+
+    *bytes = stream->body_offset;
+    headers_len = stream->headers_len;
+    ret = stream->error ? -1 : 0;
+    flb_free(stream);
+
+    if (ret == -1) {
+        flb_error("[http2_client] request to %s:%i failed on connection #%i",
+                  connection->upstream->tcp_host,
+                  connection->upstream->tcp_port,
+                  connection->fd);
+        return -1;
+    }
+
+    /* payload: reference to the body after the headers */
+    c->resp.headers_end = c->resp.data + headers_len;
+    if (headers_len < c->resp.data_len) {
+        c->resp.payload = c->resp.headers_end;
+        c->resp.payload_size = c->resp.data_len - headers_len;
+    }
+
+    return 0;
+}
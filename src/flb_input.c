@@ -39,7 +39,7 @@
 #include <fluent-bit/flb_kv.h>
 #include <fluent-bit/flb_hash_table.h>
 #include <fluent-bit/flb_scheduler.h>
-#include <fluent-bit/flb_ring_buffer.h>
+#include <fluent-bit/flb_mpsc_queue.h>
 #include <fluent-bit/flb_processor.h>
 
 /* input plugin macro helpers */
@@ -54,20 +54,6 @@ pthread_key_t libco_in_param_key;
 
 #define protcmp(a, b)  strncasecmp(a, b, strlen(a))
 
-/*
- * Ring buffer size: we make space for 512 entries that each input instance can
- * use to enqueue data. Note that this value is fixed and only affect input plugins
- * which runs in threaded mode (separate thread)
- *
- * Ring buffer window: the current window size is set to 5% which means that the
- * ring buffer will emit a flush request whenever there are 51 records or more
- * awaiting to be consumed.
- */
-
-#define FLB_INPUT_RING_BUFFER_SIZE   (sizeof(void *) * 1024)
-#define FLB_INPUT_RING_BUFFER_WINDOW (5)
-
-
 static int check_protocol(const char *prot, const char *output)
 {
     int len;
@@ -271,6 +257,7 @@ struct flb_input_instance *flb_input_new(struct flb_config *config,
         mk_list_init(&instance->input_coro_list_destroy);
         mk_list_init(&instance->downstreams);
         mk_list_init(&instance->upstreams);
+        mk_list_init(&instance->queue_pending);
 
         /* Initialize properties list */
         flb_kv_init(&instance->properties);
@@ -328,15 +315,6 @@ struct flb_input_instance *flb_input_new(struct flb_config *config,
 
         }
 
-        /* allocate a ring buffer */
-        instance->rb = flb_ring_buffer_create(FLB_INPUT_RING_BUFFER_SIZE);
-        if (!instance->rb) {
-            flb_error("instance %s could not initialize ring buffer",
-                      flb_input_name(instance));
-            flb_free(instance);
-            return NULL;
-        }
-
         instance->mem_buf_status = FLB_INPUT_RUNNING;
         instance->mem_buf_limit = 0;
         instance->mem_chunks_size = 0;
@@ -798,10 +776,9 @@ void flb_input_instance_destroy(struct flb_input_instance *ins)
 
     mk_list_del(&ins->_head);
 
-    /* ring buffer */
-    if (ins->rb) {
-        flb_input_chunk_ring_buffer_cleanup(ins);
-        flb_ring_buffer_destroy(ins->rb);
+    /* entries published in the engine input queue */
+    if (flb_input_is_threaded(ins)) {
+        flb_input_chunk_queue_cleanup(ins);
     }
 
     /* processor */
@@ -827,6 +804,35 @@ int flb_input_coro_id_get(struct flb_input_instance *ins)
     return id;
 }
 
+/*
+ * Create the queue used by the threaded inputs to hand their data to the
+ * engine, it's shared by all of them and created by the first one.
+ */
+static int input_queue_init(struct flb_config *config)
+{
+    int ret;
+    struct flb_mpsc_queue *queue;
+
+    if (config->input_queue) {
+        return 0;
+    }
+
+    queue = flb_mpsc_queue_create(FLB_INPUT_QUEUE_SIZE);
+    if (!queue) {
+        return -1;
+    }
+
+    ret = flb_mpsc_queue_add_event_loop(queue, config->evl,
+                                        FLB_ENGINE_EV_THREAD_INPUT);
+    if (ret != 0) {
+        flb_mpsc_queue_destroy(queue);
+        return -1;
+    }
+
+    config->input_queue = queue;
+    return 0;
+}
+
 static int input_instance_channel_events_init(struct flb_input_instance *ins)
 {
     int ret;
@@ -1056,6 +1062,26 @@ int flb_input_instance_init(struct flb_input_instance *ins,
         cmt_gauge_set(ins->cmt_storage_chunks_busy_bytes, ts, 0, 1, (char *[]) {name});
     }
 
+    if (flb_input_is_threaded(ins)) {
+        /* fluentbit_input_queue_depth */
+        ins->cmt_queue_depth = \
+            cmt_gauge_create(ins->cmt,
+                             "fluentbit", "input",
+                             "queue_depth",
+                             "Number of buffers in flight in the input queue.",
+                             1, (char *[]) {"name"});
+        cmt_gauge_set(ins->cmt_queue_depth, ts, 0, 1, (char *[]) {name});
+
+        /* fluentbit_input_queue_stalls_total */
+        ins->cmt_queue_stalls = \
+            cmt_counter_create(ins->cmt,
+                               "fluentbit", "input",
+                               "queue_stalls_total",
+                               "Number of times the input waited for room in the input queue.",
+                               1, (char *[]) {"name"});
+        cmt_counter_set(ins->cmt_queue_stalls, ts, 0, 1, (char *[]) {name});
+    }
+
     if (ins->storage_type == FLB_STORAGE_MEMRB) {
         /* fluentbit_input_memrb_dropped_chunks */
         ins->cmt_memrb_dropped_chunks = cmt_counter_create(ins->cmt,
@@ -1182,6 +1208,14 @@ int flb_input_instance_init(struct flb_input_instance *ins,
         }
 
         if (flb_input_is_threaded(ins)) {
+            /* threaded inputs publish their data through the engine queue */
+            ret = input_queue_init(config);
+            if (ret != 0) {
+                flb_error("failed while registering the input queue on input %s",
+                          ins->name);
+                return -1;
+            }
+
             /*
              * Create a thread for a new instance. Now the plugin initialization callback will be invoked and report an early failure
              * or an 'ok' status, we will wait for that return value on flb_input_thread_instance_get_status() below.
@@ -1201,13 +1235,6 @@ int flb_input_instance_init(struct flb_input_instance *ins,
                 return -1;
             }
 
-            /* register the ring buffer */
-            ret = flb_ring_buffer_add_event_loop(ins->rb, config->evl, FLB_INPUT_RING_BUFFER_WINDOW);
-            if (ret) {
-                flb_error("failed while registering ring buffer events on input %s",
-                          ins->name);
-                return -1;
-            }
         }
         else {
             /* initialize channel events */
@@ -1343,6 +1370,11 @@ void flb_input_exit_all(struct flb_config *config)
         /* destroy the instance */
         flb_input_instance_destroy(ins);
     }
+
+    if (config->input_queue) {
+        flb_mpsc_queue_destroy(config->input_queue);
+        config->input_queue = NULL;
+    }
 }
 
 /* Check that at least one Input is enabled */
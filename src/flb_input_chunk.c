@@ -35,7 +35,8 @@
 #include <fluent-bit/flb_routes_mask.h>
 #include <fluent-bit/flb_metrics.h>
 #include <fluent-bit/stream_processor/flb_sp.h>
-#include <fluent-bit/flb_ring_buffer.h>
+#include <fluent-bit/flb_atomic.h>
+#include <fluent-bit/flb_mpsc_queue.h>
 #include <chunkio/chunkio.h>
 #include <monkey/mk_core.h>
 
@@ -57,6 +58,7 @@ struct input_chunk_raw {
     flb_sds_t tag;
     void *buf_data;
     size_t buf_size;
+    struct mk_list _head;      /* link to ins->queue_pending */
 };
 
 #ifdef FLB_HAVE_IN_STORAGE_BACKLOG
@@ -97,43 +99,15 @@ static int flb_input_chunk_drop_task_route(
 
 static ssize_t flb_input_chunk_get_real_size(struct flb_input_chunk *ic);
 
+static int input_chunk_update_stats(struct flb_input_chunk *ic);
+
+/*
+ * The record count is kept up to date on every append (and persisted in the
+ * chunk metadata), there is no need to bring the chunk up to count it.
+ */
 static ssize_t get_input_chunk_record_count(struct flb_input_chunk *input_chunk)
 {
-    ssize_t record_count;
-    char   *chunk_buffer;
-    size_t  chunk_size;
-    int     set_down;
-    int     ret;
-
-    ret = cio_chunk_is_up(input_chunk->chunk);
-    set_down = FLB_FALSE;
-
-    if (ret == CIO_FALSE) {
-        ret = cio_chunk_up_force(input_chunk->chunk);
-
-        if (ret == -1) {
-            return -1;
-        }
-
-        set_down = FLB_TRUE;
-    }
-
-    ret = cio_chunk_get_content(input_chunk->chunk,
-                                &chunk_buffer,
-                                &chunk_size);
-
-    if (ret == CIO_OK) {
-        record_count = flb_mp_count(chunk_buffer, chunk_size);
-    }
-    else {
-        record_count = -1;
-    }
-
-    if (set_down) {
-        cio_chunk_down(input_chunk->chunk);
-    }
-
-    return record_count;
+    return input_chunk->total_records;
 }
 
 static int flb_input_chunk_release_space(
@@ -160,7 +134,8 @@ static int flb_input_chunk_release_space(
                                              struct flb_input_chunk, _head);
 
         if (!flb_routes_mask_get_bit(old_input_chunk->routes_mask,
-                                     output_plugin->id)) {
+                                     output_plugin->id,
+                                     input_plugin->config)) {
             continue;
         }
 
@@ -182,13 +157,15 @@ static int flb_input_chunk_release_space(
 
         if (release_scope == FLB_INPUT_CHUNK_RELEASE_SCOPE_LOCAL) {
             flb_routes_mask_clear_bit(old_input_chunk->routes_mask,
-                                      output_plugin->id);
+                                      output_plugin->id,
+                                      input_plugin->config);
 
             FS_CHUNK_SIZE_DEBUG_MOD(output_plugin, old_input_chunk, chunk_size);
             output_plugin->fs_chunks_size -= chunk_size;
 
             chunk_destroy_flag = flb_routes_mask_is_empty(
-                                                old_input_chunk->routes_mask);
+                                                old_input_chunk->routes_mask,
+                                                input_plugin->config);
 
             chunk_released = FLB_TRUE;
         }
@@ -405,7 +382,8 @@ static int flb_input_chunk_safe_delete(struct flb_input_chunk *ic,
      * the routes_mask could be modified when new chunks is ingested. Therefore,
      * we still need to do the validation on the routes_mask with o_id.
      */
-    if (flb_routes_mask_get_bit(old_ic->routes_mask, o_id) == 0) {
+    if (flb_routes_mask_get_bit(old_ic->routes_mask, o_id,
+                                old_ic->in->config) == 0) {
         return FLB_FALSE;
     }
 
@@ -488,7 +466,8 @@ int flb_input_chunk_release_space_compound(
  * will drop the the oldest chunks when the limitation on local disk is reached.
  */
 int flb_input_chunk_find_space_new_data(struct flb_input_chunk *ic,
-                                        size_t chunk_size, int overlimit)
+                                        size_t chunk_size,
+                                        flb_route_mask_element *overlimit)
 {
     int count;
     int result;
@@ -507,8 +486,11 @@ int flb_input_chunk_find_space_new_data(struct flb_input_chunk *ic,
     mk_list_foreach(head, &ic->in->config->outputs) {
         o_ins = mk_list_entry(head, struct flb_output_instance, _head);
 
-        if ((o_ins->total_limit_size == -1) || ((1 << o_ins->id) & overlimit) == 0 ||
-           (flb_routes_mask_get_bit(ic->routes_mask, o_ins->id) == 0)) {
+        if ((o_ins->total_limit_size == -1) ||
+            (flb_routes_mask_get_bit(overlimit, o_ins->id,
+                                     ic->in->config) == 0) ||
+            (flb_routes_mask_get_bit(ic->routes_mask, o_ins->id,
+                                     ic->in->config) == 0)) {
             continue;
         }
 
@@ -535,12 +517,14 @@ int flb_input_chunk_find_space_new_data(struct flb_input_chunk *ic,
 
 /*
  * Returns a non-zero result if any output instances will reach the limit
- * after buffering the new data
+ * after buffering the new data, the 'overlimit' routes mask is set with
+ * the output instances affected.
  */
 int flb_input_chunk_has_overlimit_routes(struct flb_input_chunk *ic,
-                                         size_t chunk_size)
+                                         size_t chunk_size,
+                                         flb_route_mask_element *overlimit)
 {
-    int overlimit = 0;
+    int count = 0;
     struct mk_list *head;
     struct flb_output_instance *o_ins;
 
@@ -548,7 +532,8 @@ int flb_input_chunk_has_overlimit_routes(struct flb_input_chunk *ic,
         o_ins = mk_list_entry(head, struct flb_output_instance, _head);
 
         if ((o_ins->total_limit_size == -1) ||
-            (flb_routes_mask_get_bit(ic->routes_mask, o_ins->id) == 0)) {
+            (flb_routes_mask_get_bit(ic->routes_mask, o_ins->id,
+                                     ic->in->config) == 0)) {
             continue;
         }
 
@@ -563,11 +548,12 @@ int flb_input_chunk_has_overlimit_routes(struct flb_input_chunk *ic,
         if ((o_ins->fs_chunks_size +
              o_ins->fs_backlog_chunks_size +
              chunk_size) > o_ins->total_limit_size) {
-            overlimit |= (1 << o_ins->id);
+            flb_routes_mask_set_bit(overlimit, o_ins->id, ic->in->config);
+            count++;
         }
     }
 
-    return overlimit;
+    return count;
 }
 
 /* Find a slot for the incoming data to buffer it in local file system
@@ -575,16 +561,22 @@ int flb_input_chunk_has_overlimit_routes(struct flb_input_chunk *ic,
  */
 int flb_input_chunk_place_new_chunk(struct flb_input_chunk *ic, size_t chunk_size)
 {
-	int overlimit;
+    int count;
+    flb_route_mask_element *overlimit;
     struct flb_input_instance *i_ins = ic->in;
 
     if (i_ins->storage_type == CIO_STORE_FS) {
-        overlimit = flb_input_chunk_has_overlimit_routes(ic, chunk_size);
-        if (overlimit != 0) {
-            flb_input_chunk_find_space_new_data(ic, chunk_size, overlimit);
+        overlimit = flb_routes_mask_create(i_ins->config);
+        if (overlimit) {
+            count = flb_input_chunk_has_overlimit_routes(ic, chunk_size,
+                                                         overlimit);
+            if (count != 0) {
+                flb_input_chunk_find_space_new_data(ic, chunk_size, overlimit);
+            }
+            flb_routes_mask_destroy(overlimit);
         }
     }
-    return !flb_routes_mask_is_empty(ic->routes_mask);
+    return !flb_routes_mask_is_empty(ic->routes_mask, i_ins->config);
 }
 
 /* Create an input chunk using a Chunk I/O */
@@ -600,6 +592,7 @@ struct flb_input_chunk *flb_input_chunk_map(struct flb_input_instance *in,
     char *buf_data;
     size_t buf_size;
     size_t offset;
+    size_t stats_records;
     ssize_t bytes;
     const char *tag_buf;
     struct flb_input_chunk *ic;
@@ -716,9 +709,10 @@ struct flb_input_chunk *flb_input_chunk_map(struct flb_input_instance *in,
         cio_chunk_write_at(chunk, offset, NULL, 0);
     }
 
+    ic->total_records = records;
+
     /* Update metrics */
 #ifdef FLB_HAVE_METRICS
-    ic->total_records = records;
     if (ic->total_records > 0) {
         /* timestamp */
         ts = cfl_time_now();
@@ -737,6 +731,20 @@ struct flb_input_chunk *flb_input_chunk_map(struct flb_input_instance *in,
     }
 #endif
 
+    /*
+     * Restore the append times from the chunk metadata, the record count
+     * comes from the validation above so refresh it in case the chunk was
+     * truncated.
+     */
+    ret = flb_input_chunk_get_stats(ic, &stats_records,
+                                    &ic->first_append_ts, &ic->last_append_ts);
+    if (ret == 0) {
+        ic->meta_stats = FLB_TRUE;
+        if (stats_records != records) {
+            input_chunk_update_stats(ic);
+        }
+    }
+
     /* Get the the tag reference (chunk metadata) */
     ret = flb_input_chunk_get_tag(ic, &tag_buf, &tag_len);
     if (ret == -1) {
@@ -752,6 +760,12 @@ struct flb_input_chunk *flb_input_chunk_map(struct flb_input_instance *in,
         return NULL;
     }
 
+    ic->routes_mask = flb_routes_mask_create(in->config);
+    if (!ic->routes_mask) {
+        flb_free(ic);
+        return NULL;
+    }
+
     has_routes = flb_routes_mask_set_by_tag(ic->routes_mask, tag_buf, tag_len, in);
     if (has_routes == 0) {
         flb_warn("[input chunk] no matching route for backoff log chunk %s",
@@ -765,12 +779,47 @@ struct flb_input_chunk *flb_input_chunk_map(struct flb_input_instance *in,
     return ic;
 }
 
+static inline void input_chunk_stats_encode(char *buf, uint32_t records,
+                                            uint64_t first_ts, uint64_t last_ts)
+{
+    int i;
+    unsigned char *p = (unsigned char *) buf;
+
+    for (i = 0; i < 4; i++) {
+        p[i] = (records >> (24 - (i * 8))) & 0xff;
+    }
+    for (i = 0; i < 8; i++) {
+        p[4 + i] = (first_ts >> (56 - (i * 8))) & 0xff;
+        p[12 + i] = (last_ts >> (56 - (i * 8))) & 0xff;
+    }
+}
+
+static inline void input_chunk_stats_decode(char *buf, uint32_t *records,
+                                            uint64_t *first_ts, uint64_t *last_ts)
+{
+    int i;
+    unsigned char *p = (unsigned char *) buf;
+
+    *records = 0;
+    *first_ts = 0;
+    *last_ts = 0;
+
+    for (i = 0; i < 4; i++) {
+        *records = (*records << 8) | p[i];
+    }
+    for (i = 0; i < 8; i++) {
+        *first_ts = (*first_ts << 8) | p[4 + i];
+        *last_ts = (*last_ts << 8) | p[12 + i];
+    }
+}
+
 static int input_chunk_write_header(struct cio_chunk *chunk, int event_type,
-                                    char *tag, int tag_len)
+                                    char *tag, int tag_len, int stats)
 
 {
     int ret;
     int meta_size;
+    int stats_size = 0;
     char *meta;
 
     /*
@@ -779,15 +828,18 @@ static int input_chunk_write_header(struct cio_chunk *chunk, int event_type,
      * m[0] = FLB_INPUT_CHUNK_MAGIC_BYTE_0
      * m[1] = FLB_INPUT_CHUNK_MAGIC_BYTE_1
      * m[2] = type (FLB_INPUT_CHUNK_TYPE_LOG or FLB_INPUT_CHUNK_TYPE_METRIC or FLB_INPUT_CHUNK_TYPE_TRACE
-     * m[3] = 0 (unused for now)
+     * m[3] = flags (FLB_INPUT_CHUNK_FLAG_STATS)
      */
+    if (stats == FLB_TRUE) {
+        stats_size = FLB_INPUT_CHUNK_META_STATS;
+    }
 
     /* write metadata (tag) */
-    if (tag_len > (65535 - FLB_INPUT_CHUNK_META_HEADER)) {
+    if (tag_len > (65535 - FLB_INPUT_CHUNK_META_HEADER - stats_size)) {
         /* truncate length */
-        tag_len = 65535 - FLB_INPUT_CHUNK_META_HEADER;
+        tag_len = 65535 - FLB_INPUT_CHUNK_META_HEADER - stats_size;
     }
-    meta_size = FLB_INPUT_CHUNK_META_HEADER + tag_len;
+    meta_size = FLB_INPUT_CHUNK_META_HEADER + stats_size + tag_len;
 
     /* Allocate buffer for metadata header */
     meta = flb_calloc(1, meta_size);
@@ -816,11 +868,14 @@ static int input_chunk_write_header(struct cio_chunk *chunk, int event_type,
         meta[2] = FLB_INPUT_CHUNK_TYPE_TRACES;
     }
 
-    /* unused byte */
+    /* flags, the stats block starts empty (calloc) */
     meta[3] = 0;
+    if (stats == FLB_TRUE) {
+        meta[3] |= FLB_INPUT_CHUNK_FLAG_STATS;
+    }
 
-    /* copy the tag after magic bytes */
-    memcpy(meta + FLB_INPUT_CHUNK_META_HEADER, tag, tag_len);
+    /* copy the tag after magic bytes and stats */
+    memcpy(meta + FLB_INPUT_CHUNK_META_HEADER + stats_size, tag, tag_len);
 
     /* Write tag into metadata section */
     ret = cio_meta_write(chunk, (char *) meta, meta_size);
@@ -834,6 +889,34 @@ static int input_chunk_write_header(struct cio_chunk *chunk, int event_type,
     return 0;
 }
 
+/*
+ * Refresh the stats block of the chunk metadata. The block has a fixed size
+ * so it's patched in place, the chunk must be up.
+ */
+static int input_chunk_update_stats(struct flb_input_chunk *ic)
+{
+    int ret;
+    int len;
+    char *buf;
+
+    if (ic->meta_stats == FLB_FALSE) {
+        return 0;
+    }
+
+    ret = cio_meta_read(ic->chunk, &buf, &len);
+    if (ret == -1 ||
+        len < FLB_INPUT_CHUNK_META_HEADER + FLB_INPUT_CHUNK_META_STATS ||
+        !(buf[3] & FLB_INPUT_CHUNK_FLAG_STATS)) {
+        return -1;
+    }
+
+    input_chunk_stats_encode(buf + FLB_INPUT_CHUNK_META_HEADER,
+                             ic->total_records,
+                             ic->first_append_ts, ic->last_append_ts);
+
+    return 0;
+}
+
 struct flb_input_chunk *flb_input_chunk_create(struct flb_input_instance *in, int event_type,
                                                const char *tag, int tag_len)
 {
@@ -841,6 +924,7 @@ struct flb_input_chunk *flb_input_chunk_create(struct flb_input_instance *in, in
     int err;
     int set_down = FLB_FALSE;
     int has_routes;
+    int meta_stats;
     char name[64];
     struct cio_chunk *chunk;
     struct flb_storage_input *storage;
@@ -873,8 +957,21 @@ struct flb_input_chunk *flb_input_chunk_create(struct flb_input_instance *in, in
         set_down = FLB_TRUE;
     }
 
+    /*
+     * The stats block is opt-in (storage.metadata_stats): versions that do not
+     * know about it reject chunks with a non zero flags byte. It's patched in
+     * place on every append, that would invalidate the CRC32 of the chunk so
+     * it's also skipped when checksums are enabled.
+     */
+    meta_stats = FLB_FALSE;
+    if (in->config->storage_meta_stats == FLB_TRUE &&
+        in->config->storage_checksum == FLB_FALSE) {
+        meta_stats = FLB_TRUE;
+    }
+
     /* Write chunk header */
-    ret = input_chunk_write_header(chunk, event_type, (char *) tag, tag_len);
+    ret = input_chunk_write_header(chunk, event_type, (char *) tag, tag_len,
+                                   meta_stats);
     if (ret == -1) {
         cio_chunk_close(chunk, CIO_TRUE);
         return NULL;
@@ -901,11 +998,20 @@ struct flb_input_chunk *flb_input_chunk_create(struct flb_input_instance *in, in
     ic->in = in;
     ic->stream_off = 0;
     ic->task = NULL;
-#ifdef FLB_HAVE_METRICS
     ic->total_records = 0;
-#endif
+    ic->added_records = 0;
+    ic->meta_stats = meta_stats;
+    ic->first_append_ts = 0;
+    ic->last_append_ts = 0;
 
     /* Calculate the routes_mask for the input chunk */
+    ic->routes_mask = flb_routes_mask_create(in->config);
+    if (!ic->routes_mask) {
+        flb_free(ic);
+        cio_chunk_close(chunk, CIO_TRUE);
+        return NULL;
+    }
+
     has_routes = flb_routes_mask_set_by_tag(ic->routes_mask, tag, tag_len, in);
     if (has_routes == 0) {
         flb_trace("[input chunk] no matching route for input chunk '%s' with tag '%s'",
@@ -953,7 +1059,8 @@ int flb_input_chunk_destroy_corrupted(struct flb_input_chunk *ic,
             continue;
         }
 
-        if (flb_routes_mask_get_bit(ic->routes_mask, o_ins->id) != 0) {
+        if (flb_routes_mask_get_bit(ic->routes_mask, o_ins->id,
+                                    ic->in->config) != 0) {
             if (ic->fs_counted == FLB_TRUE) {
                 FS_CHUNK_SIZE_DEBUG_MOD(o_ins, ic, -bytes);
                 o_ins->fs_chunks_size -= bytes;
@@ -993,6 +1100,7 @@ int flb_input_chunk_destroy_corrupted(struct flb_input_chunk *ic,
 
     cio_chunk_close(ic->chunk, del);
     mk_list_del(&ic->_head);
+    flb_routes_mask_destroy(ic->routes_mask);
     flb_free(ic);
 
     return 0;
@@ -1025,7 +1133,8 @@ int flb_input_chunk_destroy(struct flb_input_chunk *ic, int del)
             continue;
         }
 
-        if (flb_routes_mask_get_bit(ic->routes_mask, o_ins->id) != 0) {
+        if (flb_routes_mask_get_bit(ic->routes_mask, o_ins->id,
+                                    ic->in->config) != 0) {
             if (ic->fs_counted == FLB_TRUE) {
                 FS_CHUNK_SIZE_DEBUG_MOD(o_ins, ic, -bytes);
                 o_ins->fs_chunks_size -= bytes;
@@ -1086,6 +1195,7 @@ int flb_input_chunk_destroy(struct flb_input_chunk *ic, int del)
 
     cio_chunk_close(ic->chunk, del);
     mk_list_del(&ic->_head);
+    flb_routes_mask_destroy(ic->routes_mask);
     flb_free(ic);
 
     return 0;
@@ -1169,7 +1279,7 @@ static struct flb_input_chunk *input_chunk_get(struct flb_input_instance *in,
      * that the chunk will flush to, we need to modify the routes_mask of the oldest chunks
      * (based in creation time) to get enough space for the incoming chunk.
      */
-    if (!flb_routes_mask_is_empty(ic->routes_mask)
+    if (!flb_routes_mask_is_empty(ic->routes_mask, in->config)
         && flb_input_chunk_place_new_chunk(ic, chunk_size) == 0) {
         /*
          * If the chunk is not newly created, the chunk might already have logs inside.
@@ -1177,7 +1287,8 @@ static struct flb_input_chunk *input_chunk_get(struct flb_input_instance *in,
          * If the routes_mask is cleared after trying to append new data, we destroy
          * the chunk.
          */
-        if (new_chunk || flb_routes_mask_is_empty(ic->routes_mask) == FLB_TRUE) {
+        if (new_chunk ||
+            flb_routes_mask_is_empty(ic->routes_mask, in->config) == FLB_TRUE) {
             flb_input_chunk_destroy(ic, FLB_TRUE);
         }
         return NULL;
@@ -1618,6 +1729,13 @@ static int input_chunk_append_raw(struct flb_input_instance *in,
         ic->added_records = 0;
         ic->total_records = total_records_start;
     }
+    else if (final_data_size > 0) {
+        ic->last_append_ts = cfl_time_now();
+        if (ic->first_append_ts == 0) {
+            ic->first_append_ts = ic->last_append_ts;
+        }
+        input_chunk_update_stats(ic);
+    }
 
     /* Update 'input' metrics */
 #ifdef FLB_HAVE_METRICS
@@ -1767,19 +1885,27 @@ static void destroy_chunk_raw(struct input_chunk_raw *cr)
     flb_free(cr);
 }
 
-static int append_to_ring_buffer(struct flb_input_instance *ins,
-                                 int event_type,
-                                 size_t records,
-                                 const char *tag,
-                                 size_t tag_len,
-                                 const void *buf,
-                                 size_t buf_size)
+static int append_to_queue(struct flb_input_instance *ins,
+                           int event_type,
+                           size_t records,
+                           const char *tag,
+                           size_t tag_len,
+                           const void *buf,
+                           size_t buf_size)
 
 {
     int ret;
     int retries = 0;
     int retry_limit = 10;
+    uint64_t depth;
     struct input_chunk_raw *cr;
+    struct flb_mpsc_queue *queue;
+
+    queue = ins->config->input_queue;
+    if (!queue) {
+        flb_plg_error(ins, "input queue is not available");
+        return -1;
+    }
 
     cr = flb_calloc(1, sizeof(struct input_chunk_raw));
     if (!cr) {
@@ -1817,95 +1943,158 @@ static int append_to_ring_buffer(struct flb_input_instance *ins,
     memcpy(cr->buf_data, buf, buf_size);
     cr->buf_size = buf_size;
 
-
-
 retry:
     /*
-     * There is a little chance that the ring buffer is full or due to saturation
-     * from the main thread the data is not being consumed. On this scenario we
-     * retry up to 'retry_limit' times with a little wait time.
+     * The queue is shared by all the threaded inputs: every instance can only
+     * have FLB_INPUT_QUEUE_INSTANCE_MAX entries in flight. If the instance is
+     * over its limit, the queue is full or due to saturation from the main
+     * thread the data is not being consumed, we retry up to 'retry_limit'
+     * times with a little wait time.
      */
     if (retries >= retry_limit) {
-        flb_plg_error(ins, "could not enqueue records into the ring buffer");
+        flb_plg_error(ins, "could not enqueue records into the input queue");
         destroy_chunk_raw(cr);
         return -1;
     }
 
-    /* append chunk raw context to the ring buffer */
-    ret = flb_ring_buffer_write(ins->rb, (void *) &cr, sizeof(cr));
+    depth = flb_atomic_add(&ins->queue_depth, 1);
+    if (depth < FLB_INPUT_QUEUE_INSTANCE_MAX) {
+        ret = flb_mpsc_queue_push(queue, cr);
+    }
+    else {
+        ret = -1;
+    }
+
     if (ret == -1) {
-        flb_plg_debug(ins, "failed buffer write, retries=%i\n",
-                      retries);
+        flb_atomic_sub(&ins->queue_depth, 1);
+        flb_atomic_add(&ins->queue_stalls, 1);
 
-        /* sleep for 100000 microseconds (100 milliseconds) */
+        flb_plg_debug(ins, "input queue is full, retries=%i", retries);
+
+        /* wake up the engine, then sleep for 100 milliseconds */
+        flb_mpsc_queue_signal(queue);
         usleep(100000);
         retries++;
         goto retry;
     }
 
+    /* only one wakeup is sent for all the entries published meanwhile */
+    flb_mpsc_queue_signal(queue);
+
     return 0;
 }
 
-/* iterate input instance ring buffer and remove any enqueued input_chunk_raw */
-void flb_input_chunk_ring_buffer_cleanup(struct flb_input_instance *ins)
+static void queue_entry_append(struct input_chunk_raw *cr)
 {
-    int ret;
-    struct input_chunk_raw *cr;
+    int tag_len;
 
-    if (!ins->rb) {
-        return;
+    if (cr->tag) {
+        tag_len = flb_sds_len(cr->tag);
+    }
+    else {
+        tag_len = 0;
     }
 
-    while ((ret = flb_ring_buffer_read(ins->rb, (void *) &cr, sizeof(cr))) == 0) {
-        if (cr) {
-            destroy_chunk_raw(cr);
-            cr = NULL;
+    input_chunk_append_raw(cr->ins, cr->event_type, cr->records,
+                           cr->tag, tag_len,
+                           cr->buf_data, cr->buf_size);
+
+    flb_atomic_sub(&cr->ins->queue_depth, 1);
+    destroy_chunk_raw(cr);
+}
+
+/*
+ * Remove the entries owned by an instance that is going away: the ones in
+ * the shared queue that belongs to other instances are kept in their pending
+ * lists.
+ */
+void flb_input_chunk_queue_cleanup(struct flb_input_instance *ins)
+{
+    struct mk_list *tmp;
+    struct mk_list *head;
+    struct input_chunk_raw *cr;
+    struct flb_mpsc_queue *queue;
+
+    queue = ins->config->input_queue;
+    if (queue) {
+        while ((cr = flb_mpsc_queue_pop(queue)) != NULL) {
+            mk_list_add(&cr->_head, &cr->ins->queue_pending);
         }
     }
+
+    mk_list_foreach_safe(head, tmp, &ins->queue_pending) {
+        cr = mk_list_entry(head, struct input_chunk_raw, _head);
+        mk_list_del(&cr->_head);
+        flb_atomic_sub(&ins->queue_depth, 1);
+        destroy_chunk_raw(cr);
+    }
 }
 
-void flb_input_chunk_ring_buffer_collector(struct flb_config *ctx, void *data)
+void flb_input_chunk_queue_collector(struct flb_config *ctx, void *data)
 {
-    int ret;
-    int tag_len = 0;
+#ifdef FLB_HAVE_METRICS
+    uint64_t ts;
+    char *name;
+#endif
+    struct mk_list *tmp;
     struct mk_list *head;
+    struct mk_list *p_head;
     struct flb_input_instance *ins;
     struct input_chunk_raw *cr;
 
+    /* entries received while their instance was paused, in order */
     mk_list_foreach(head, &ctx->inputs) {
         ins = mk_list_entry(head, struct flb_input_instance, _head);
-        cr = NULL;
+        if (!flb_input_is_threaded(ins)) {
+            continue;
+        }
 
-        while (1) {
+        mk_list_foreach_safe(p_head, tmp, &ins->queue_pending) {
             if (flb_input_buf_paused(ins) == FLB_TRUE) {
                 break;
             }
 
-            ret = flb_ring_buffer_read(ins->rb,
-                                       (void *) &cr,
-                                       sizeof(cr));
-            if (ret != 0) {
-                break;
-            }
+            cr = mk_list_entry(p_head, struct input_chunk_raw, _head);
+            mk_list_del(&cr->_head);
+            queue_entry_append(cr);
+        }
+    }
 
-            if (cr) {
-                if (cr->tag) {
-                    tag_len = flb_sds_len(cr->tag);
-                }
-                else {
-                    tag_len = 0;
-                }
+    if (ctx->input_queue) {
+        while ((cr = flb_mpsc_queue_pop(ctx->input_queue)) != NULL) {
+            ins = cr->ins;
 
-                input_chunk_append_raw(cr->ins, cr->event_type, cr->records,
-                                       cr->tag, tag_len,
-                                       cr->buf_data, cr->buf_size);
-                destroy_chunk_raw(cr);
+            /* keep the order of the records of a paused instance */
+            if (flb_input_buf_paused(ins) == FLB_TRUE ||
+                mk_list_is_empty(&ins->queue_pending) != 0) {
+                mk_list_add(&cr->_head, &ins->queue_pending);
+                continue;
             }
-            cr = NULL;
+
+            queue_entry_append(cr);
+        }
+    }
+
+#ifdef FLB_HAVE_METRICS
+    ts = cfl_time_now();
+    mk_list_foreach(head, &ctx->inputs) {
+        ins = mk_list_entry(head, struct flb_input_instance, _head);
+        if (!ins->cmt_queue_depth) {
+            continue;
         }
+        name = (char *) flb_input_name(ins);
+
+        /* fluentbit_input_queue_depth */
+        cmt_gauge_set(ins->cmt_queue_depth, ts,
+                      flb_atomic_load(&ins->queue_depth),
+                      1, (char *[]) {name});
 
-        ins->rb->flush_pending = FLB_FALSE;
+        /* fluentbit_input_queue_stalls_total */
+        cmt_counter_set(ins->cmt_queue_stalls, ts,
+                        flb_atomic_load(&ins->queue_stalls),
+                        1, (char *[]) {name});
     }
+#endif
 }
 
 int flb_input_chunk_append_raw(struct flb_input_instance *in,
@@ -1918,12 +2107,12 @@ int flb_input_chunk_append_raw(struct flb_input_instance *in,
 
     /*
      * If the plugin instance registering the data runs in a separate thread, we must
-     * add the data reference to the ring buffer.
+     * add the data reference to the input queue.
      */
     if (flb_input_is_threaded(in)) {
-        ret = append_to_ring_buffer(in, event_type, records,
-                                    tag, tag_len,
-                                    buf, buf_size);
+        ret = append_to_queue(in, event_type, records,
+                              tag, tag_len,
+                              buf, buf_size);
     }
     else {
         ret = input_chunk_append_raw(in, event_type, records,
@@ -2015,7 +2204,8 @@ static inline int input_chunk_has_magic_bytes(char *buf, int len)
 
     p = (unsigned char *) buf;
     if (p[0] == FLB_INPUT_CHUNK_MAGIC_BYTE_0 &&
-        p[1] == FLB_INPUT_CHUNK_MAGIC_BYTE_1 && p[3] == 0) {
+        p[1] == FLB_INPUT_CHUNK_MAGIC_BYTE_1 &&
+        (p[3] & ~FLB_INPUT_CHUNK_FLAG_STATS) == 0) {
         return FLB_TRUE;
     }
 
@@ -2063,6 +2253,7 @@ int flb_input_chunk_get_tag(struct flb_input_chunk *ic,
 {
     int len;
     int ret;
+    int offset;
     char *buf;
 
     ret = cio_meta_read(ic->chunk, &buf, &len);
@@ -2074,8 +2265,19 @@ int flb_input_chunk_get_tag(struct flb_input_chunk *ic,
 
     /* If magic bytes exists, just set the offset */
     if (input_chunk_has_magic_bytes(buf, len)) {
-        *tag_len = len - FLB_INPUT_CHUNK_META_HEADER;
-        *tag_buf = buf + FLB_INPUT_CHUNK_META_HEADER;
+        offset = FLB_INPUT_CHUNK_META_HEADER;
+        if (buf[3] & FLB_INPUT_CHUNK_FLAG_STATS) {
+            offset += FLB_INPUT_CHUNK_META_STATS;
+        }
+
+        if (len < offset) {
+            *tag_len = -1;
+            *tag_buf = NULL;
+            return -1;
+        }
+
+        *tag_len = len - offset;
+        *tag_buf = buf + offset;
     }
     else {
         /* Old Chunk version without magic bytes */
@@ -2086,6 +2288,36 @@ int flb_input_chunk_get_tag(struct flb_input_chunk *ic,
     return ret;
 }
 
+/*
+ * Get the record count and append times stored in the chunk metadata. It
+ * returns -1 if the chunk was created without a stats block.
+ */
+int flb_input_chunk_get_stats(struct flb_input_chunk *ic, size_t *records,
+                              uint64_t *first_ts, uint64_t *last_ts)
+{
+    int len;
+    int ret;
+    char *buf;
+    uint32_t count;
+
+    ret = cio_meta_read(ic->chunk, &buf, &len);
+    if (ret == -1) {
+        return -1;
+    }
+
+    if (!input_chunk_has_magic_bytes(buf, len) ||
+        !(buf[3] & FLB_INPUT_CHUNK_FLAG_STATS) ||
+        len < FLB_INPUT_CHUNK_META_HEADER + FLB_INPUT_CHUNK_META_STATS) {
+        return -1;
+    }
+
+    input_chunk_stats_decode(buf + FLB_INPUT_CHUNK_META_HEADER,
+                             &count, first_ts, last_ts);
+    *records = count;
+
+    return 0;
+}
+
 /*
  * Iterates all output instances that the chunk will be flushing to and summarize
  * the total number of bytes in use after ingesting the new data.
@@ -2103,7 +2335,8 @@ void flb_input_chunk_update_output_instances(struct flb_input_chunk *ic,
             continue;
         }
 
-        if (flb_routes_mask_get_bit(ic->routes_mask, o_ins->id) != 0) {
+        if (flb_routes_mask_get_bit(ic->routes_mask, o_ins->id,
+                                    ic->in->config) != 0) {
             /*
              * if there is match on any index of 1's in the binary, it indicates
              * that the input chunk will flush to this output instance
@@ -31,6 +31,7 @@
 #include <fluent-bit/flb_input.h>
 #include <fluent-bit/flb_input_plugin.h>
 #include <fluent-bit/flb_input_thread.h>
+#include <fluent-bit/flb_arena.h>
 
 static int input_thread_instance_set_status(struct flb_input_instance *ins, uint32_t status);
 static int input_thread_instance_get_status(struct flb_input_instance *ins);
@@ -458,6 +459,7 @@ static void input_thread(void *data)
     /* Create the bucket queue (FLB_ENGINE_PRIORITY_COUNT priorities) */
     flb_bucket_queue_destroy(evl_bktq);
     flb_sched_destroy(sched);
+    flb_arena_thread_destroy();
     input_thread_instance_destroy(thi);
 }
 
@@ -49,6 +49,7 @@
 
 #include <monkey/mk_core.h>
 #include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
 #include <fluent-bit/flb_config.h>
 #include <fluent-bit/flb_io.h>
 #include <fluent-bit/tls/flb_tls.h>
@@ -191,10 +192,109 @@ static void net_io_propagate_critical_error(
     }
 }
 
-static int fd_io_write(int fd, struct sockaddr_storage *address,
-                       const void *data, size_t len, size_t *out_len);
-static int net_io_write(struct flb_connection *connection,
-                        const void *data, size_t len, size_t *out_len)
+/* Total number of bytes of a vector of buffers */
+static size_t iov_length(const struct iovec *iov, int iovcnt)
+{
+    int i;
+    size_t len = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+
+    return len;
+}
+
+/*
+ * Set in 'vec' the buffers of 'iov' still pending once 'offset' bytes were
+ * written, up to FLB_IO_IOV_MAX buffers and 'max' bytes. Empty buffers are
+ * skipped. Returns the number of buffers set in 'vec'.
+ *
+ * The buffers already written are dropped from 'iov' and 'offset' so long
+ * vectors are not walked again from the start on every call.
+ */
+static int iov_pending(const struct iovec **iov_cur, int *iovcnt_cur,
+                       size_t *offset_cur, size_t max, struct iovec *vec)
+{
+    int i;
+    int count = 0;
+    int iovcnt;
+    size_t len;
+    size_t offset;
+    const struct iovec *iov;
+
+    while (*iovcnt_cur > 0 && *offset_cur >= (*iov_cur)->iov_len) {
+        *offset_cur -= (*iov_cur)->iov_len;
+        (*iov_cur)++;
+        (*iovcnt_cur)--;
+    }
+
+    iov = *iov_cur;
+    iovcnt = *iovcnt_cur;
+    offset = *offset_cur;
+
+    for (i = 0; i < iovcnt && count < FLB_IO_IOV_MAX && max > 0; i++) {
+        if (offset >= iov[i].iov_len) {
+            offset -= iov[i].iov_len;
+            continue;
+        }
+
+        len = iov[i].iov_len - offset;
+        if (len > max) {
+            len = max;
+        }
+
+        vec[count].iov_base = (char *) iov[i].iov_base + offset;
+        vec[count].iov_len = len;
+        count++;
+
+        offset = 0;
+        max -= len;
+    }
+
+    return count;
+}
+
+/* Send a vector of buffers with a single system call */
+static ssize_t fd_io_sendv(int fd, struct sockaddr_storage *address,
+                           struct iovec *vec, int count)
+{
+#ifdef FLB_SYSTEM_WINDOWS
+    /* no gathering here, the caller loops over the remaining buffers */
+    if (count == 0) {
+        return 0;
+    }
+
+    if (address != NULL) {
+        return sendto(fd, vec[0].iov_base, vec[0].iov_len, 0,
+                      (struct sockaddr *) address,
+                      flb_network_address_size(address));
+    }
+
+    return send(fd, vec[0].iov_base, vec[0].iov_len, 0);
+#else
+    struct msghdr msg;
+
+    if (address == NULL) {
+        return writev(fd, vec, count);
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = address;
+    msg.msg_namelen = flb_network_address_size(address);
+    msg.msg_iov = vec;
+    msg.msg_iovlen = count;
+
+    return sendmsg(fd, &msg, 0);
+#endif
+}
+
+static int fd_io_writev(int fd, struct sockaddr_storage *address,
+                        const struct iovec *iov, int iovcnt,
+                        size_t *out_len);
+static int net_io_writev(struct flb_connection *connection,
+                         const struct iovec *iov, int iovcnt,
+                         size_t *out_len)
 {
     struct sockaddr_storage *address;
     int                      ret;
@@ -221,7 +321,7 @@ static int net_io_write(struct flb_connection *connection,
         }
     }
 
-    ret = fd_io_write(connection->fd, address, data, len, out_len);
+    ret = fd_io_writev(connection->fd, address, iov, iovcnt, out_len);
 
     if (ret == -1) {
         net_io_propagate_critical_error(connection);
@@ -230,22 +330,34 @@ static int net_io_write(struct flb_connection *connection,
     return ret;
 }
 
-static int fd_io_write(int fd, struct sockaddr_storage *address,
-                       const void *data, size_t len, size_t *out_len)
+static int net_io_write(struct flb_connection *connection,
+                        const void *data, size_t len, size_t *out_len)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void *) data;
+    iov.iov_len = len;
+
+    return net_io_writev(connection, &iov, 1, out_len);
+}
+
+static int fd_io_writev(int fd, struct sockaddr_storage *address,
+                        const struct iovec *iov, int iovcnt,
+                        size_t *out_len)
 {
     int ret;
+    int count;
     int tries = 0;
+    size_t len;
+    size_t skip = 0;
     size_t total = 0;
+    struct iovec vec[FLB_IO_IOV_MAX];
+
+    len = iov_length(iov, iovcnt);
 
     while (total < len) {
-        if (address != NULL) {
-            ret = sendto(fd, (char *) data + total, len - total, 0,
-                         (struct sockaddr *) address,
-                         flb_network_address_size(address));
-        }
-        else {
-            ret = send(fd, (char *) data + total, len - total, 0);
-        }
+        count = iov_pending(&iov, &iovcnt, &skip, len - total, vec);
+        ret = fd_io_sendv(fd, address, vec, count);
 
         if (ret == -1) {
             if (FLB_WOULDBLOCK()) {
@@ -274,6 +386,7 @@ static int fd_io_write(int fd, struct sockaddr_storage *address,
 
         tries = 0;
         total += ret;
+        skip += ret;
     }
 
     *out_len = total;
@@ -281,6 +394,17 @@ static int fd_io_write(int fd, struct sockaddr_storage *address,
     return total;
 }
 
+static int fd_io_write(int fd, struct sockaddr_storage *address,
+                       const void *data, size_t len, size_t *out_len)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void *) data;
+    iov.iov_len = len;
+
+    return fd_io_writev(fd, address, &iov, 1, out_len);
+}
+
 static FLB_INLINE void net_io_backup_event(struct flb_connection *connection,
                                            struct mk_event *backup)
 {
@@ -324,20 +448,30 @@ static FLB_INLINE void net_io_restore_event(struct flb_connection *connection,
  * Intentionally we register/de-register the socket file descriptor from
  * the event loop each time when we require to do some work.
  */
-static FLB_INLINE int net_io_write_async(struct flb_coro *co,
-                                         struct flb_connection *connection,
-                                         const void *data, size_t len, size_t *out_len)
+static FLB_INLINE int net_io_writev_async(struct flb_coro *co,
+                                          struct flb_connection *connection,
+                                          const struct iovec *iov, int iovcnt,
+                                          size_t *out_len)
 {
     int ret = 0;
     int error;
+    int count;
     uint32_t mask;
     ssize_t bytes;
+    size_t len;
+    size_t skip = 0;
     size_t total = 0;
-    size_t to_send;
     char so_error_buf[256];
+    struct iovec vec[FLB_IO_IOV_MAX];
     struct mk_event event_backup;
     int event_restore_needed;
 
+    len = iov_length(iov, iovcnt);
+    if (len == 0) {
+        *out_len = 0;
+        return 0;
+    }
+
     event_restore_needed = FLB_FALSE;
 
     net_io_backup_event(connection, &event_backup);
@@ -345,14 +479,9 @@ static FLB_INLINE int net_io_write_async(struct flb_coro *co,
 retry:
     error = 0;
 
-    if (len - total > 524288) {
-        to_send = 524288;
-    }
-    else {
-        to_send = (len - total);
-    }
-
-    bytes = send(connection->fd, (char *) data + total, to_send, 0);
+    /* send up to 512KB per call */
+    count = iov_pending(&iov, &iovcnt, &skip, 524288, vec);
+    bytes = fd_io_sendv(connection->fd, NULL, vec, count);
 
 #ifdef FLB_HAVE_TRACE
     if (bytes > 0) {
@@ -461,6 +590,7 @@ retry:
 
     /* Update counters */
     total += bytes;
+    skip += bytes;
     if (total < len) {
         if ((connection->event.mask & MK_EVENT_WRITE) == 0) {
             ret = mk_event_add(connection->evl,
@@ -512,7 +642,19 @@ retry:
 
     *out_len = total;
 
-    return bytes;
+    return total;
+}
+
+static FLB_INLINE int net_io_write_async(struct flb_coro *co,
+                                         struct flb_connection *connection,
+                                         const void *data, size_t len, size_t *out_len)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void *) data;
+    iov.iov_len = len;
+
+    return net_io_writev_async(co, connection, &iov, 1, out_len);
 }
 
 static ssize_t fd_io_read(int fd, struct sockaddr_storage *address,
@@ -658,6 +800,20 @@ int flb_io_fd_write(int fd, const void *data, size_t len, size_t *out_len)
     return fd_io_write(fd, NULL, data, len, out_len);
 }
 
+/*
+ * Write a vector of buffers to fd. For unix socket.
+ *
+ * The write is always blocking: callers like out_forward share one unix
+ * socket between the coroutines of a worker thread, yielding in the middle
+ * of a message would let another coroutine interleave its own data in the
+ * stream.
+ */
+int flb_io_fd_writev(int fd, const struct iovec *iov, int iovcnt,
+                     size_t *out_len)
+{
+    return fd_io_writev(fd, NULL, iov, iovcnt, out_len);
+}
+
 /* Write data to an upstream connection/server */
 int flb_io_net_write(struct flb_connection *connection, const void *data,
                      size_t len, size_t *out_len)
@@ -701,6 +857,165 @@ int flb_io_net_write(struct flb_connection *connection, const void *data,
     return ret;
 }
 
+#ifdef FLB_HAVE_TLS
+static int tls_net_write(struct flb_coro *co,
+                         struct flb_connection *connection, int async,
+                         const void *data, size_t len, size_t *out_len)
+{
+    if (async) {
+        return flb_tls_net_write_async(co, connection->tls_session,
+                                       data, len, out_len);
+    }
+
+    return flb_tls_net_write(connection->tls_session, data, len, out_len);
+}
+
+/*
+ * TLS sessions take a single buffer: small buffers are gathered in records
+ * of FLB_IO_TLS_GATHER_SIZE bytes so every byte is copied once at most,
+ * buffers of that size or bigger are written straight from the caller.
+ */
+static int tls_net_writev(struct flb_coro *co,
+                          struct flb_connection *connection, int async,
+                          const struct iovec *iov, int iovcnt,
+                          size_t *out_len)
+{
+    int i;
+    int ret = 0;
+    char *buf = NULL;
+    char *ptr;
+    size_t left;
+    size_t len;
+    size_t used = 0;
+    size_t sent;
+    size_t total = 0;
+
+    if (iovcnt == 1) {
+        return tls_net_write(co, connection, async,
+                             iov[0].iov_base, iov[0].iov_len, out_len);
+    }
+
+    for (i = 0; i <= iovcnt; i++) {
+        ptr = NULL;
+        left = 0;
+        if (i < iovcnt) {
+            ptr = iov[i].iov_base;
+            left = iov[i].iov_len;
+        }
+
+        /* flush the gathered data before a big buffer or at the end */
+        if (used > 0 && (i == iovcnt || left >= FLB_IO_TLS_GATHER_SIZE)) {
+            sent = 0;
+            ret = tls_net_write(co, connection, async, buf, used, &sent);
+            total += sent;
+            used = 0;
+            if (ret == -1) {
+                break;
+            }
+        }
+
+        if (left >= FLB_IO_TLS_GATHER_SIZE) {
+            sent = 0;
+            ret = tls_net_write(co, connection, async, ptr, left, &sent);
+            total += sent;
+            if (ret == -1) {
+                break;
+            }
+            continue;
+        }
+
+        while (left > 0) {
+            if (!buf) {
+                buf = flb_malloc(FLB_IO_TLS_GATHER_SIZE);
+                if (!buf) {
+                    flb_errno();
+                    ret = -1;
+                    break;
+                }
+            }
+
+            len = FLB_IO_TLS_GATHER_SIZE - used;
+            if (len > left) {
+                len = left;
+            }
+            memcpy(buf + used, ptr, len);
+            used += len;
+            ptr += len;
+            left -= len;
+
+            if (used == FLB_IO_TLS_GATHER_SIZE) {
+                sent = 0;
+                ret = tls_net_write(co, connection, async, buf, used, &sent);
+                total += sent;
+                used = 0;
+                if (ret == -1) {
+                    break;
+                }
+            }
+        }
+
+        if (ret == -1) {
+            break;
+        }
+    }
+
+    if (buf) {
+        flb_free(buf);
+    }
+
+    *out_len = total;
+
+    if (ret == -1) {
+        return -1;
+    }
+
+    return total;
+}
+#endif
+
+/*
+ * Write a vector of buffers to an upstream connection/server, plain sockets
+ * send all of them with a single writev(2) call when possible.
+ */
+int flb_io_net_writev(struct flb_connection *connection,
+                      const struct iovec *iov, int iovcnt, size_t *out_len)
+{
+    int              flags;
+    struct flb_coro *coro;
+    int              ret;
+
+    ret  = -1;
+    *out_len = 0;
+    coro = flb_coro_get();
+    flags = flb_connection_get_flags(connection);
+
+    flb_trace("[io coro=%p] [net_writev] trying %i buffers", coro, iovcnt);
+
+    if (connection->tls_session == NULL) {
+        if (flags & FLB_IO_ASYNC) {
+            ret = net_io_writev_async(coro, connection, iov, iovcnt, out_len);
+        }
+        else {
+            ret = net_io_writev(connection, iov, iovcnt, out_len);
+        }
+    }
+#ifdef FLB_HAVE_TLS
+    else if (flags & FLB_IO_TLS) {
+        ret = tls_net_writev(coro, connection, flags & FLB_IO_ASYNC,
+                             iov, iovcnt, out_len);
+    }
+#endif
+
+    if (ret > 0) {
+        flb_connection_reset_io_timeout(connection);
+    }
+
+    flb_trace("[io coro=%p] [net_writev] ret=%i total=%lu",
+              coro, ret, *out_len);
+
+    return ret;
+}
+
 ssize_t flb_io_fd_read(int fd, void *buf, size_t len)
 {
     /* TODO: support async mode */
@@ -33,6 +33,8 @@
 #include <fluent-bit/flb_metrics.h>
 #include <fluent-bit/flb_upstream.h>
 #include <fluent-bit/flb_downstream.h>
+#include <fluent-bit/flb_arena.h>
+#include <fluent-bit/flb_filter_worker.h>
 #include <fluent-bit/tls/flb_tls.h>
 
 #include <signal.h>
@@ -127,6 +129,8 @@ void flb_init_env()
     flb_upstream_init();
     flb_downstream_init();
     flb_output_prepare();
+    flb_arena_init();
+    flb_filter_worker_init();
 
     FLB_TLS_INIT(flb_lib_active_context);
     FLB_TLS_INIT(flb_lib_active_cf_context);
@@ -0,0 +1,91 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <fluent-bit/flb_simd.h>
+#include <fluent-bit/flb_line_split.h>
+
+#include <string.h>
+
+static int scan_scalar(const char *buf, size_t len, char sep_a, char sep_b,
+                       size_t offset, size_t *out, int count, int max,
+                       size_t *next)
+{
+    const char *p;
+    const char *end = buf + len;
+
+    p = buf + offset;
+
+    /* a single separator, memchr() is already vectorized by the libc */
+    if (sep_a == sep_b) {
+        while (count < max && p < end &&
+               (p = memchr(p, sep_a, end - p)) != NULL) {
+            out[count++] = p - buf;
+            p++;
+        }
+        *next = (count == max) ? out[count - 1] + 1 : len;
+        return count;
+    }
+
+    for (; p < end; p++) {
+        if (*p == sep_a || *p == sep_b) {
+            out[count++] = p - buf;
+            if (count == max) {
+                *next = (p - buf) + 1;
+                return count;
+            }
+        }
+    }
+
+    *next = len;
+    return count;
+}
+
+int flb_line_split_scan(const char *buf, size_t len, char sep_a, char sep_b,
+                        size_t *out, int max, size_t *next)
+{
+    int count = 0;
+    size_t i = 0;
+#ifndef FLB_SIMD_NONE
+    uint32_t mask;
+    flb_vector8 chunk;
+    flb_vector8 va;
+    flb_vector8 vb;
+
+    va = flb_vector8_broadcast(sep_a);
+    vb = flb_vector8_broadcast(sep_b);
+
+    for (; i + FLB_VECTOR8_SIZE <= len; i += FLB_VECTOR8_SIZE) {
+        chunk = flb_vector8_load(buf + i);
+        mask = flb_vector8_mask(flb_vector8_or(flb_vector8_eq(chunk, va),
+                                               flb_vector8_eq(chunk, vb)));
+        while (mask) {
+            out[count++] = i + flb_simd_ctz(mask);
+            if (count == max) {
+                *next = out[count - 1] + 1;
+                return count;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    /* remaining bytes */
+    return scan_scalar(buf, len, sep_a, sep_b, i, out, count, max, next);
+}
@@ -52,11 +52,23 @@ int flb_log_event_encoder_dynamic_field_scope_enter(
         return result;
     }
 
-    scope = flb_calloc(1,
-                       sizeof(struct flb_log_event_encoder_dynamic_field_scope));
+    /* scopes are entered and left for every nested value, reuse them */
+    if (!cfl_list_is_empty(&field->free_scopes)) {
+        scope = cfl_list_entry_first(
+                    &field->free_scopes,
+                    struct flb_log_event_encoder_dynamic_field_scope,
+                    _head);
+
+        cfl_list_del(&scope->_head);
+        memset(scope, 0, sizeof(struct flb_log_event_encoder_dynamic_field_scope));
+    }
+    else {
+        scope = flb_calloc(1,
+                           sizeof(struct flb_log_event_encoder_dynamic_field_scope));
 
-    if (scope == NULL) {
-        return FLB_EVENT_ENCODER_ERROR_ALLOCATION_ERROR;
+        if (scope == NULL) {
+            return FLB_EVENT_ENCODER_ERROR_ALLOCATION_ERROR;
+        }
     }
 
     cfl_list_entry_init(&scope->_head);
@@ -105,8 +117,7 @@ int flb_log_event_encoder_dynamic_field_scope_leave(
     }
 
     cfl_list_del(&scope->_head);
-
-    flb_free(scope);
+    cfl_list_prepend(&scope->_head, &field->free_scopes);
 
     return FLB_EVENT_ENCODER_SUCCESS;
 }
@@ -258,6 +269,7 @@ int flb_log_event_encoder_dynamic_field_init(
     field->type = type;
 
     cfl_list_init(&field->scopes);
+    cfl_list_init(&field->free_scopes);
     flb_log_event_encoder_dynamic_field_reset(field);
 
     return FLB_EVENT_ENCODER_SUCCESS;
@@ -266,6 +278,21 @@ int flb_log_event_encoder_dynamic_field_init(
 void flb_log_event_encoder_dynamic_field_destroy(
     struct flb_log_event_encoder_dynamic_field *field)
 {
+    struct cfl_list                                  *tmp;
+    struct cfl_list                                  *head;
+    struct flb_log_event_encoder_dynamic_field_scope *scope;
+
+    flb_log_event_encoder_dynamic_field_flush_scopes(field, FLB_FALSE);
+
+    cfl_list_foreach_safe(head, tmp, &field->free_scopes) {
+        scope = cfl_list_entry(head,
+                               struct flb_log_event_encoder_dynamic_field_scope,
+                               _head);
+
+        cfl_list_del(&scope->_head);
+        flb_free(scope);
+    }
+
     msgpack_sbuffer_destroy(&field->buffer);
 
     field->initialized = FLB_FALSE;
@@ -0,0 +1,299 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * LZ4 frame codec, backed by the reference LZ4 library (lib/lz4). The
+ * frame format is described in:
+ *
+ *   https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md
+ *
+ * The generated frames use independent 64KB blocks and carry a content
+ * checksum.
+ */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_lz4.h>
+#include <fluent-bit/flb_compression.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <lz4frame.h>
+
+struct flb_lz4_decompression_context {
+    LZ4F_dctx *dctx;
+};
+
+int flb_lz4_compress(void *in_data, size_t in_len,
+                     void **out_data, size_t *out_len)
+{
+    size_t ret;
+    size_t out_size;
+    void *buf;
+    LZ4F_preferences_t prefs;
+
+    memset(&prefs, 0, sizeof(LZ4F_preferences_t));
+    prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+    prefs.frameInfo.blockMode = LZ4F_blockIndependent;
+    prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+
+    out_size = LZ4F_compressFrameBound(in_len, &prefs);
+
+    buf = flb_malloc(out_size);
+    if (!buf) {
+        flb_errno();
+        return -1;
+    }
+
+    ret = LZ4F_compressFrame(buf, out_size, in_data, in_len, &prefs);
+    if (LZ4F_isError(ret)) {
+        flb_error("[lz4] compression failed: %s", LZ4F_getErrorName(ret));
+        flb_free(buf);
+        return -1;
+    }
+
+    *out_data = buf;
+    *out_len = ret;
+
+    return 0;
+}
+
+int flb_lz4_uncompress(void *in_data, size_t in_len,
+                       void **out_data, size_t *out_len,
+                       size_t max_size)
+{
+    size_t ret;
+    size_t in_pos;
+    size_t out_pos;
+    size_t out_size;
+    size_t out_limit;
+    size_t src_size;
+    size_t dst_size;
+    char *buf;
+    char *tmp;
+    LZ4F_dctx *dctx;
+
+    ret = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+    if (LZ4F_isError(ret)) {
+        flb_error("[lz4] could not create decompression context");
+        return -1;
+    }
+
+    /*
+     * The buffer may grow up to one byte over the limit, filling that byte
+     * means the data does not fit.
+     */
+    out_limit = SIZE_MAX - 1;
+    if (max_size > 0) {
+        out_limit = max_size + 1;
+    }
+
+    /* content size is optional in the frame header, start with a guess */
+    out_size = (in_len * 4) + FLB_LZ4_BLOCK_SIZE;
+    if (out_size > out_limit) {
+        out_size = out_limit;
+    }
+
+    buf = flb_malloc(out_size + 1);
+    if (!buf) {
+        flb_errno();
+        LZ4F_freeDecompressionContext(dctx);
+        return -1;
+    }
+
+    in_pos = 0;
+    out_pos = 0;
+
+    /* keep going while there is input or lz4 may still hold output */
+    ret = 0;
+    while (in_pos < in_len || out_pos == out_size) {
+        if (out_pos == out_size) {
+            if (out_size == out_limit) {
+                flb_error("[lz4] maximum decompression size is %zu bytes",
+                          max_size);
+                goto error;
+            }
+
+            out_size = (out_size > out_limit / 2) ? out_limit : out_size * 2;
+
+            tmp = flb_realloc(buf, out_size + 1);
+            if (!tmp) {
+                flb_errno();
+                goto error;
+            }
+            buf = tmp;
+        }
+
+        src_size = in_len - in_pos;
+        dst_size = out_size - out_pos;
+
+        ret = LZ4F_decompress(dctx, buf + out_pos, &dst_size,
+                              (char *) in_data + in_pos, &src_size, NULL);
+        if (LZ4F_isError(ret)) {
+            flb_error("[lz4] decompression failed: %s",
+                      LZ4F_getErrorName(ret));
+            goto error;
+        }
+
+        /* no progress with data left: corrupted input */
+        if (src_size == 0 && dst_size == 0 && in_pos < in_len) {
+            flb_error("[lz4] decompression stalled");
+            goto error;
+        }
+
+        in_pos += src_size;
+        out_pos += dst_size;
+    }
+
+    /* a non zero hint means the last frame is incomplete */
+    if (ret != 0) {
+        flb_error("[lz4] truncated frame");
+        goto error;
+    }
+
+    LZ4F_freeDecompressionContext(dctx);
+
+    /* keep the data usable as a string, like flb_gzip_uncompress() */
+    buf[out_pos] = '\0';
+
+    *out_data = buf;
+    *out_len = out_pos;
+
+    return 0;
+
+error:
+    LZ4F_freeDecompressionContext(dctx);
+    flb_free(buf);
+
+    return -1;
+}
+
+int flb_lz4_decompressor_dispatch(struct flb_decompression_context *context,
+                                  void *output_buffer,
+                                  size_t *output_length)
+{
+    size_t ret;
+    size_t in_pos;
+    size_t out_pos;
+    size_t src_size;
+    size_t dst_size;
+    size_t output_buffer_size;
+    struct flb_lz4_decompression_context *inner_context;
+
+    output_buffer_size = *output_length;
+
+    *output_length = 0;
+
+    if (context == NULL ||
+        context->inner_context == NULL) {
+        return FLB_DECOMPRESSOR_FAILURE;
+    }
+
+    inner_context = context->inner_context;
+
+    in_pos = 0;
+    out_pos = 0;
+
+    /* runs at least once so data buffered by lz4 is flushed */
+    do {
+        src_size = context->input_buffer_length - in_pos;
+        dst_size = output_buffer_size - out_pos;
+
+        ret = LZ4F_decompress(inner_context->dctx,
+                              (char *) output_buffer + out_pos, &dst_size,
+                              &context->read_buffer[in_pos], &src_size,
+                              NULL);
+        if (LZ4F_isError(ret)) {
+            flb_error("[lz4] decompression failed: %s",
+                      LZ4F_getErrorName(ret));
+
+            context->state = FLB_DECOMPRESSOR_STATE_FAILED;
+
+            return FLB_DECOMPRESSOR_FAILURE;
+        }
+
+        in_pos += src_size;
+        out_pos += dst_size;
+
+        /* no progress: wait for more data */
+        if (src_size == 0 && dst_size == 0) {
+            break;
+        }
+    } while (in_pos < context->input_buffer_length &&
+             out_pos < output_buffer_size);
+
+    context->input_buffer_length -= in_pos;
+
+    if (context->input_buffer_length > 0) {
+        context->read_buffer = &context->read_buffer[in_pos];
+    }
+    else {
+        context->read_buffer = context->input_buffer;
+    }
+
+    /* lz4 keeps track of the frame boundaries by itself */
+    if (ret == 0) {
+        context->state = FLB_DECOMPRESSOR_STATE_EXPECTING_HEADER;
+    }
+    else {
+        context->state = FLB_DECOMPRESSOR_STATE_EXPECTING_BODY;
+    }
+
+    *output_length = out_pos;
+
+    return FLB_DECOMPRESSOR_SUCCESS;
+}
+
+void *flb_lz4_decompression_context_create()
+{
+    size_t ret;
+    struct flb_lz4_decompression_context *context;
+
+    context = flb_calloc(1, sizeof(struct flb_lz4_decompression_context));
+    if (context == NULL) {
+        flb_errno();
+        return NULL;
+    }
+
+    ret = LZ4F_createDecompressionContext(&context->dctx, LZ4F_VERSION);
+    if (LZ4F_isError(ret)) {
+        flb_error("[lz4] could not create decompression context");
+        flb_free(context);
+        return NULL;
+    }
+
+    return (void *) context;
+}
+
+void flb_lz4_decompression_context_destroy(void *context)
+{
+    struct flb_lz4_decompression_context *inner_context;
+
+    if (context != NULL) {
+        inner_context = context;
+
+        if (inner_context->dctx != NULL) {
+            LZ4F_freeDecompressionContext(inner_context->dctx);
+        }
+
+        flb_free(inner_context);
+    }
+}
@@ -27,6 +27,9 @@
 #include <fluent-bit/flb_version.h>
 #include <fluent-bit/flb_utils.h>
 #include <fluent-bit/flb_metrics.h>
+#include <fluent-bit/flb_scheduler.h>
+#include <fluent-bit/flb_arena.h>
+#include <fluent-bit/flb_net_dns_cache.h>
 #include <msgpack.h>
 
 static int id_exists(int id, struct flb_metrics *metrics)
@@ -352,6 +355,68 @@ static int attach_hot_reload_info(struct flb_config *ctx, struct cmt *cmt, uint6
     return 0;
 }
 
+static int attach_scheduler_info(struct flb_config *ctx, struct cmt *cmt,
+                                 uint64_t ts, char *hostname)
+{
+    double val;
+    struct cmt_gauge *g;
+
+    if (!ctx->sched) {
+        return 0;
+    }
+
+    g = cmt_gauge_create(cmt, "fluentbit", "scheduler", "timers_armed",
+                         "Number of timers armed in the engine scheduler.",
+                         1, (char *[]) {"hostname"});
+    if (!g) {
+        return -1;
+    }
+
+    val = (double) flb_sched_timers_armed(ctx->sched);
+    cmt_gauge_set(g, ts, val, 1, (char *[]) {hostname});
+
+    g = cmt_gauge_create(cmt, "fluentbit", "scheduler", "tick_lag_seconds",
+                         "Delay of the last engine scheduler tick in seconds.",
+                         1, (char *[]) {"hostname"});
+    if (!g) {
+        return -1;
+    }
+
+    val = (double) flb_sched_tick_lag(ctx->sched) / 1000000000.0;
+    cmt_gauge_set(g, ts, val, 1, (char *[]) {hostname});
+
+    return 0;
+}
+
+static int attach_arena_info(struct flb_config *ctx, struct cmt *cmt,
+                             uint64_t ts, char *hostname)
+{
+    double val;
+    struct cmt_gauge *g;
+
+    g = cmt_gauge_create(cmt, "fluentbit", "arena", "high_water_bytes",
+                         "Largest usage of a per thread memory arena in bytes.",
+                         1, (char *[]) {"hostname"});
+    if (!g) {
+        return -1;
+    }
+
+    val = (double) flb_arena_high_water();
+    cmt_gauge_set(g, ts, val, 1, (char *[]) {hostname});
+
+    g = cmt_gauge_create(cmt, "fluentbit", "arena", "reserved_bytes",
+                         "Memory held by the per thread memory arenas in bytes.",
+                         1, (char *[]) {"hostname"});
+    if (!g) {
+        return -1;
+    }
+
+    val = (double) flb_arena_reserved();
+    cmt_gauge_set(g, ts, val, 1, (char *[]) {hostname});
+
+    return 0;
+}
+
 /* Append internal Fluent Bit metrics to context */
 int flb_metrics_fluentbit_add(struct flb_config *ctx, struct cmt *cmt)
 {
@@ -373,6 +438,12 @@ int flb_metrics_fluentbit_add(struct flb_config *ctx, struct cmt *cmt)
     attach_process_start_time_seconds(ctx, cmt, ts, hostname);
     attach_build_info(ctx, cmt, ts, hostname);
     attach_hot_reload_info(ctx, cmt, ts, hostname);
+    attach_scheduler_info(ctx, cmt, ts, hostname);
+    attach_arena_info(ctx, cmt, ts, hostname);
+
+    if (ctx->dns_cache_ctx) {
+        flb_net_dns_cache_metrics(ctx->dns_cache_ctx, cmt, ts, hostname);
+    }
 
     return 0;
 }
@@ -70,6 +70,43 @@ int flb_mp_count_remaining(const void *data, size_t bytes, size_t *remaining_byt
     return count;
 }
 
+/*
+ * Split a buffer of 'count' msgpack objects in 'parts' slices holding the
+ * same number of objects, the last one gets the remaining objects and bytes.
+ * 'offsets' receives the start of every slice plus the end of the buffer.
+ */
+int flb_mp_split(const void *data, size_t bytes, int count, int parts,
+                 size_t *offsets)
+{
+    int i;
+    int n;
+    int per_part;
+    int ret = 0;
+    mpack_reader_t reader;
+
+    if (parts <= 0 || count < parts) {
+        return -1;
+    }
+    per_part = count / parts;
+
+    mpack_reader_init_data(&reader, (const char *) data, bytes);
+    offsets[0] = 0;
+    for (i = 1; i < parts; i++) {
+        for (n = 0; n < per_part; n++) {
+            mpack_discard(&reader);
+        }
+        if (mpack_reader_error(&reader)) {
+            ret = -1;
+            break;
+        }
+        offsets[i] = bytes - mpack_reader_remaining(&reader, NULL);
+    }
+    offsets[parts] = bytes;
+    mpack_reader_destroy(&reader);
+
+    return ret;
+}
+
 int flb_mp_validate_metric_chunk(const void *data, size_t bytes,
                                  int *out_series, size_t *processed_bytes)
 {
@@ -1024,16 +1061,33 @@ struct flb_mp_chunk_record *flb_mp_chunk_record_create(struct flb_mp_chunk_cobj
 {
     struct flb_mp_chunk_record *record;
 
-    record = flb_calloc(1, sizeof(struct flb_mp_chunk_record));
+    if (chunk_cobj && chunk_cobj->arena) {
+        record = flb_arena_calloc(chunk_cobj->arena,
+                                  sizeof(struct flb_mp_chunk_record));
+    }
+    else {
+        record = flb_calloc(1, sizeof(struct flb_mp_chunk_record));
+    }
     if (!record) {
         flb_errno();
         return NULL;
     }
     record->modified = FLB_FALSE;
+    record->arena = chunk_cobj ? chunk_cobj->arena : NULL;
 
     return record;
 }
 
+static void chunk_record_free(struct flb_mp_chunk_record *record)
+{
+    /* arena memory is released when the arena scope ends */
+    if (record->arena) {
+        return;
+    }
+
+    flb_free(record);
+}
+
 struct flb_mp_chunk_cobj *flb_mp_chunk_cobj_create(struct flb_log_event_encoder *log_encoder, struct flb_log_event_decoder *log_decoder)
 {
     struct flb_mp_chunk_cobj *chunk_cobj;
@@ -1051,98 +1105,118 @@ struct flb_mp_chunk_cobj *flb_mp_chunk_cobj_create(struct flb_log_event_encoder
     chunk_cobj->record_pos  = NULL;
     chunk_cobj->log_encoder = log_encoder;
     chunk_cobj->log_decoder = log_decoder;
+    chunk_cobj->arena = NULL;
 
     return chunk_cobj;
 }
 
-static int generate_empty_msgpack_map(char **out_buf, size_t *out_size)
+/*
+ * Same as flb_mp_chunk_cobj_create() but the records are allocated from
+ * 'arena', the caller must keep its scope open until the chunk_cobj is
+ * destroyed.
+ */
+struct flb_mp_chunk_cobj *flb_mp_chunk_cobj_create_with_arena(struct flb_log_event_encoder *log_encoder,
+                                                              struct flb_log_event_decoder *log_decoder,
+                                                              struct flb_arena *arena)
+{
+    struct flb_mp_chunk_cobj *chunk_cobj;
+
+    chunk_cobj = flb_mp_chunk_cobj_create(log_encoder, log_decoder);
+    if (!chunk_cobj) {
+        return NULL;
+    }
+    chunk_cobj->arena = arena;
+
+    return chunk_cobj;
+}
+
+/*
+ * Pack a record field in 'mp_sbuf', the buffer is reused for all the records
+ * of a chunk. An empty map is packed if the object is not set.
+ */
+static int chunk_cobj_pack_field(struct cfl_object *obj,
+                                 msgpack_sbuffer *mp_sbuf)
 {
-    msgpack_sbuffer mp_sbuf;
     msgpack_packer mp_pck;
 
-    /* initialize msgpack buffer */
-    msgpack_sbuffer_init(&mp_sbuf);
-    msgpack_packer_init(&mp_pck, &mp_sbuf, msgpack_sbuffer_write);
+    msgpack_sbuffer_clear(mp_sbuf);
+    msgpack_packer_init(&mp_pck, mp_sbuf, msgpack_sbuffer_write);
 
-    msgpack_pack_map(&mp_pck, 0);
+    if (!obj) {
+        msgpack_pack_map(&mp_pck, 0);
+        return 0;
+    }
 
-    *out_buf = mp_sbuf.data;
-    *out_size = mp_sbuf.size;
+    /* unitialized CFL object ? */
+    if (obj->type == CFL_OBJECT_NONE) {
+        return -1;
+    }
 
-    return 0;
+    return mp_cfl_to_msgpack(obj->variant, mp_sbuf, &mp_pck);
 }
 
 int flb_mp_chunk_cobj_encode(struct flb_mp_chunk_cobj *chunk_cobj, char **out_buf, size_t *out_size)
 {
     int ret;
-    char *mp_buf;
-    size_t mp_size;
     struct cfl_list *head;
     struct flb_mp_chunk_record *record;
+    msgpack_sbuffer mp_sbuf;
 
     if (!chunk_cobj) {
         return -1;
     }
 
+    msgpack_sbuffer_init(&mp_sbuf);
+
     /* Iterate all records */
     cfl_list_foreach(head, &chunk_cobj->records) {
         record = cfl_list_entry(head, struct flb_mp_chunk_record, _head);
 
         ret = flb_log_event_encoder_begin_record(chunk_cobj->log_encoder);
         if (ret == -1) {
+            msgpack_sbuffer_destroy(&mp_sbuf);
             return -1;
         }
 
         ret = flb_log_event_encoder_set_timestamp(chunk_cobj->log_encoder, &record->event.timestamp);
         if (ret == -1) {
+            msgpack_sbuffer_destroy(&mp_sbuf);
             return -1;
         }
 
-        if (record->cobj_metadata) {
-            ret = flb_mp_cfl_to_msgpack(record->cobj_metadata, &mp_buf, &mp_size);
-            if (ret == -1) {
-                return -1;
-            }
-        }
-        else {
-            ret = generate_empty_msgpack_map(&mp_buf, &mp_size);
-            if (ret == -1) {
-                return -1;
-            }
+        ret = chunk_cobj_pack_field(record->cobj_metadata, &mp_sbuf);
+        if (ret == -1) {
+            msgpack_sbuffer_destroy(&mp_sbuf);
+            return -1;
         }
 
-        ret = flb_log_event_encoder_set_metadata_from_raw_msgpack(chunk_cobj->log_encoder, mp_buf, mp_size);
+        ret = flb_log_event_encoder_set_metadata_from_raw_msgpack(chunk_cobj->log_encoder,
+                                                                  mp_sbuf.data, mp_sbuf.size);
         if (ret != FLB_EVENT_ENCODER_SUCCESS) {
-            flb_free(mp_buf);
+            msgpack_sbuffer_destroy(&mp_sbuf);
             return -1;
         }
-        flb_free(mp_buf);
 
-        if (record->cobj_record) {
-            ret = flb_mp_cfl_to_msgpack(record->cobj_record, &mp_buf, &mp_size);
-            if (ret == -1) {
-                return -1;
-            }
-        }
-        else {
-            ret = generate_empty_msgpack_map(&mp_buf, &mp_size);
-            if (ret == -1) {
-                return -1;
-            }
+        ret = chunk_cobj_pack_field(record->cobj_record, &mp_sbuf);
+        if (ret == -1) {
+            msgpack_sbuffer_destroy(&mp_sbuf);
+            return -1;
         }
 
-        ret = flb_log_event_encoder_set_body_from_raw_msgpack(chunk_cobj->log_encoder, mp_buf, mp_size);
+        ret = flb_log_event_encoder_set_body_from_raw_msgpack(chunk_cobj->log_encoder,
+                                                              mp_sbuf.data, mp_sbuf.size);
         if (ret != FLB_EVENT_ENCODER_SUCCESS) {
-            flb_free(mp_buf);
+            msgpack_sbuffer_destroy(&mp_sbuf);
             return -1;
         }
-        flb_free(mp_buf);
 
         ret = flb_log_event_encoder_commit_record(chunk_cobj->log_encoder);
         if (ret == -1) {
+            msgpack_sbuffer_destroy(&mp_sbuf);
             return -1;
         }
     }
+    msgpack_sbuffer_destroy(&mp_sbuf);
 
     /* set new output buffer */
     *out_buf = chunk_cobj->log_encoder->output_buffer;
@@ -1171,7 +1245,7 @@ int flb_mp_chunk_cobj_destroy(struct flb_mp_chunk_cobj *chunk_cobj)
             cfl_object_destroy(record->cobj_record);
         }
         cfl_list_del(&record->_head);
-        flb_free(record);
+        chunk_record_free(record);
     }
 
     flb_free(chunk_cobj);
@@ -1200,20 +1274,20 @@ int flb_mp_chunk_cobj_record_next(struct flb_mp_chunk_cobj *chunk_cobj,
 
         ret = flb_log_event_decoder_next(chunk_cobj->log_decoder, &record->event);
         if (ret != FLB_EVENT_DECODER_SUCCESS) {
-            flb_free(record);
+            chunk_record_free(record);
             return -1;
         }
 
         record->cobj_metadata = flb_mp_object_to_cfl(record->event.metadata);
         if (!record->cobj_metadata) {
-            flb_free(record);
+            chunk_record_free(record);
             return FLB_MP_CHUNK_RECORD_ERROR;
         }
 
         record->cobj_record = flb_mp_object_to_cfl(record->event.body);
         if (!record->cobj_record) {
             cfl_object_destroy(record->cobj_metadata);
-            flb_free(record);
+            chunk_record_free(record);
             return -1;
         }
 
@@ -1274,7 +1348,7 @@ int flb_mp_chunk_cobj_record_destroy(struct flb_mp_chunk_cobj *chunk_cobj,
     }
 
     cfl_list_del(&record->_head);
-    flb_free(record);
+    chunk_record_free(record);
 
     return 0;
 }
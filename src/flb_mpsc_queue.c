@@ -0,0 +1,267 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_pipe.h>
+#include <fluent-bit/flb_atomic.h>
+#include <fluent-bit/flb_mpsc_queue.h>
+
+#include <monkey/mk_core.h>
+
+#ifdef FLB_HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
+static void flb_mpsc_queue_remove_event_loop(struct flb_mpsc_queue *queue);
+
+/* 'size' is rounded up to the next power of two */
+struct flb_mpsc_queue *flb_mpsc_queue_create(uint64_t size)
+{
+    uint64_t i;
+    uint64_t slots = 2;
+    struct flb_mpsc_queue *queue;
+
+    while (slots < size) {
+        slots <<= 1;
+    }
+
+    queue = flb_calloc(1, sizeof(struct flb_mpsc_queue));
+    if (!queue) {
+        flb_errno();
+        return NULL;
+    }
+    queue->size = slots;
+    queue->mask = slots - 1;
+    queue->signal_channels[0] = -1;
+    queue->signal_channels[1] = -1;
+
+    queue->slots = flb_malloc(sizeof(struct flb_mpsc_queue_slot) * slots);
+    if (!queue->slots) {
+        flb_errno();
+        flb_free(queue);
+        return NULL;
+    }
+
+    /* a slot is free for position 'pos' when its sequence is 'pos' */
+    for (i = 0; i < slots; i++) {
+        queue->slots[i].seq = i;
+        queue->slots[i].data = NULL;
+    }
+
+    return queue;
+}
+
+void flb_mpsc_queue_destroy(struct flb_mpsc_queue *queue)
+{
+    flb_mpsc_queue_remove_event_loop(queue);
+
+    flb_free(queue->slots);
+    flb_free(queue);
+}
+
+int flb_mpsc_queue_add_event_loop(struct flb_mpsc_queue *queue, void *evl,
+                                  int event_type)
+{
+    int ret;
+
+#ifdef FLB_HAVE_EVENTFD
+    queue->signal_channels[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->signal_channels[0] == -1) {
+        flb_errno();
+        return -2;
+    }
+    queue->signal_channels[1] = queue->signal_channels[0];
+#else
+    ret = flb_pipe_create(queue->signal_channels);
+    if (ret) {
+        return -2;
+    }
+
+    flb_pipe_set_nonblocking(queue->signal_channels[0]);
+    flb_pipe_set_nonblocking(queue->signal_channels[1]);
+#endif
+
+    queue->signal_event = flb_calloc(1, sizeof(struct mk_event));
+    if (!queue->signal_event) {
+        flb_errno();
+        flb_mpsc_queue_remove_event_loop(queue);
+        return -2;
+    }
+    MK_EVENT_ZERO(queue->signal_event);
+
+    ret = mk_event_add(evl, queue->signal_channels[0], event_type,
+                       MK_EVENT_READ, queue->signal_event);
+    if (ret != 0) {
+        flb_mpsc_queue_remove_event_loop(queue);
+        return -3;
+    }
+    queue->event_loop = evl;
+
+    return 0;
+}
+
+static void flb_mpsc_queue_remove_event_loop(struct flb_mpsc_queue *queue)
+{
+    if (queue->event_loop) {
+        mk_event_del(queue->event_loop, queue->signal_event);
+        queue->event_loop = NULL;
+    }
+
+    if (queue->signal_event) {
+        flb_free(queue->signal_event);
+        queue->signal_event = NULL;
+    }
+
+#ifdef FLB_HAVE_EVENTFD
+    if (queue->signal_channels[0] != -1) {
+        close(queue->signal_channels[0]);
+    }
+#else
+    if (queue->signal_channels[0] != -1) {
+        flb_pipe_destroy(queue->signal_channels);
+    }
+#endif
+    queue->signal_channels[0] = -1;
+    queue->signal_channels[1] = -1;
+}
+
+/*
+ * Publish 'data', it can be called concurrently from any thread. Returns -1
+ * when the queue is full. The consumer is not woken up, see
+ * flb_mpsc_queue_signal().
+ */
+int flb_mpsc_queue_push(struct flb_mpsc_queue *queue, void *data)
+{
+    int64_t diff;
+    uint64_t seq;
+    uint64_t pos;
+    struct flb_mpsc_queue_slot *slot;
+
+    pos = flb_atomic_load(&queue->head);
+    while (1) {
+        slot = &queue->slots[pos & queue->mask];
+        seq = flb_atomic_load(&slot->seq);
+        diff = (int64_t) (seq - pos);
+
+        if (diff == 0) {
+            /* free slot, try to reserve it ('pos' is reloaded on failure) */
+            if (flb_atomic_compare_exchange(&queue->head, &pos, pos + 1)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            /* the slot still holds an entry from the previous lap */
+            return -1;
+        }
+        else {
+            /* another producer took it */
+            pos = flb_atomic_load(&queue->head);
+        }
+    }
+
+    slot->data = data;
+    flb_atomic_store(&slot->seq, pos + 1);
+
+    return 0;
+}
+
+/* Wake up the consumer unless a wakeup is already pending */
+void flb_mpsc_queue_signal(struct flb_mpsc_queue *queue)
+{
+#ifdef FLB_HAVE_EVENTFD
+    uint64_t val = 1;
+#endif
+
+    if (!queue->event_loop) {
+        return;
+    }
+
+    if (flb_atomic_exchange(&queue->signal_pending, 1) == 1) {
+        return;
+    }
+
+#ifdef FLB_HAVE_EVENTFD
+    flb_pipe_w(queue->signal_channels[1], &val, sizeof(val));
+#else
+    flb_pipe_w(queue->signal_channels[1], ".", 1);
+#endif
+}
+
+/*
+ * Consume the wakeup. It must be called before draining the queue so the
+ * entries published from now on raise a new one.
+ */
+void flb_mpsc_queue_signal_drain(struct flb_mpsc_queue *queue)
+{
+#ifdef FLB_HAVE_EVENTFD
+    uint64_t val;
+
+    flb_pipe_r(queue->signal_channels[0], &val, sizeof(val));
+#else
+    char buf[512];
+
+    flb_pipe_r(queue->signal_channels[0], buf, sizeof(buf));
+#endif
+
+    flb_atomic_exchange(&queue->signal_pending, 0);
+}
+
+/*
+ * Take the oldest entry, only the consumer thread can call it. Returns NULL
+ * if the queue is empty or the oldest entry is still being written.
+ */
+void *flb_mpsc_queue_pop(struct flb_mpsc_queue *queue)
+{
+    void *data;
+    uint64_t tail;
+    struct flb_mpsc_queue_slot *slot;
+
+    tail = queue->tail;
+    slot = &queue->slots[tail & queue->mask];
+
+    if (flb_atomic_load(&slot->seq) != tail + 1) {
+        return NULL;
+    }
+
+    data = slot->data;
+
+    /* release the slot for the next lap */
+    flb_atomic_store(&slot->seq, tail + queue->size);
+    flb_atomic_store(&queue->tail, tail + 1);
+
+    return data;
+}
+
+/* Approximate number of entries, reserved slots included */
+uint64_t flb_mpsc_queue_depth(struct flb_mpsc_queue *queue)
+{
+    uint64_t tail;
+    uint64_t head;
+
+    tail = flb_atomic_load(&queue->tail);
+    head = flb_atomic_load(&queue->head);
+
+    if (head < tail) {
+        return 0;
+    }
+    return head - tail;
+}
@@ -0,0 +1,511 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_compat.h>
+#include <fluent-bit/flb_socket.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_str.h>
+#include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_net_dns_cache.h>
+
+#include <cmetrics/cmetrics.h>
+#include <cmetrics/cmt_counter.h>
+#include <cmetrics/cmt_gauge.h>
+#include <cmetrics/cmt_histogram.h>
+#include <ares.h>
+
+static double latency_bounds[] = { FLB_NET_DNS_CACHE_LATENCY_BOUNDS };
+
+/* The lists use the same allocation as the translated c-ares results */
+static void addrinfo_free(struct addrinfo *list)
+{
+    struct addrinfo *next;
+
+    while (list) {
+        next = list->ai_next;
+        if (list->ai_addr) {
+            flb_free(list->ai_addr);
+        }
+        flb_free(list);
+        list = next;
+    }
+}
+
+/* Copy 'count' records of 'list' starting with the record number 'start' */
+static struct addrinfo *addrinfo_copy(struct addrinfo *list, int count,
+                                      int start)
+{
+    int i;
+    struct addrinfo *rp;
+    struct addrinfo *node;
+    struct addrinfo *head = NULL;
+    struct addrinfo *tail = NULL;
+
+    rp = list;
+    for (i = 0; i < start; i++) {
+        rp = rp->ai_next;
+    }
+
+    for (i = 0; i < count; i++) {
+        node = flb_calloc(1, sizeof(struct addrinfo));
+        if (!node) {
+            flb_errno();
+            addrinfo_free(head);
+            return NULL;
+        }
+
+        node->ai_flags = rp->ai_flags;
+        node->ai_family = rp->ai_family;
+        node->ai_socktype = rp->ai_socktype;
+        node->ai_protocol = rp->ai_protocol;
+        node->ai_addrlen = rp->ai_addrlen;
+
+        node->ai_addr = flb_malloc(rp->ai_addrlen);
+        if (!node->ai_addr) {
+            flb_errno();
+            flb_free(node);
+            addrinfo_free(head);
+            return NULL;
+        }
+        memcpy(node->ai_addr, rp->ai_addr, rp->ai_addrlen);
+
+        if (tail) {
+            tail->ai_next = node;
+        }
+        else {
+            head = node;
+        }
+        tail = node;
+
+        rp = rp->ai_next;
+        if (!rp) {
+            rp = list;
+        }
+    }
+
+    return head;
+}
+
+static int entry_key(char *buf, size_t size, const char *host, const char *port)
+{
+    int ret;
+
+    ret = snprintf(buf, size, "%s:%s", host, port);
+    if (ret < 0 || ret >= size) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static struct flb_net_dns_cache_entry *entry_get(struct flb_net_dns_cache *cache,
+                                                 char *key)
+{
+    struct mk_list *head;
+    struct flb_net_dns_cache_entry *entry;
+
+    mk_list_foreach(head, &cache->entries) {
+        entry = mk_list_entry(head, struct flb_net_dns_cache_entry, _head);
+        if (strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void entry_destroy(struct flb_net_dns_cache *cache,
+                          struct flb_net_dns_cache_entry *entry)
+{
+    mk_list_del(&entry->_head);
+    cache->entry_count--;
+
+    addrinfo_free(entry->addrs);
+    flb_free(entry->key);
+    flb_free(entry);
+}
+
+/* Make room for a new entry, the cache lock must be held */
+static void entries_evict(struct flb_net_dns_cache *cache, time_t now)
+{
+    struct mk_list *tmp;
+    struct mk_list *head;
+    struct flb_net_dns_cache_entry *entry;
+    struct flb_net_dns_cache_entry *oldest = NULL;
+
+    mk_list_foreach_safe(head, tmp, &cache->entries) {
+        entry = mk_list_entry(head, struct flb_net_dns_cache_entry, _head);
+        if (entry->expires + cache->stale_ttl <= now) {
+            entry_destroy(cache, entry);
+        }
+        else if (!oldest || entry->expires < oldest->expires) {
+            oldest = entry;
+        }
+    }
+
+    if (cache->entry_count >= FLB_NET_DNS_CACHE_MAX_ENTRIES && oldest) {
+        entry_destroy(cache, oldest);
+    }
+}
+
+/* Copy the addresses of an entry, every call starts with the next record */
+static struct addrinfo *entry_addrs(struct flb_net_dns_cache_entry *entry)
+{
+    int start;
+
+    start = entry->next % entry->count;
+    entry->next++;
+
+    return addrinfo_copy(entry->addrs, entry->count, start);
+}
+
+struct flb_net_dns_cache *flb_net_dns_cache_create(int max_ttl, int negative_ttl,
+                                                   int stale_ttl)
+{
+    struct flb_net_dns_cache *cache;
+
+    cache = flb_calloc(1, sizeof(struct flb_net_dns_cache));
+    if (!cache) {
+        flb_errno();
+        return NULL;
+    }
+    cache->max_ttl = max_ttl;
+    cache->negative_ttl = negative_ttl;
+    cache->stale_ttl = stale_ttl > 0 ? stale_ttl : 0;
+
+    mk_list_init(&cache->entries);
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return cache;
+}
+
+void flb_net_dns_cache_destroy(struct flb_net_dns_cache *cache)
+{
+    struct mk_list *tmp;
+    struct mk_list *head;
+    struct flb_net_dns_cache_entry *entry;
+
+    if (!cache) {
+        return;
+    }
+
+    mk_list_foreach_safe(head, tmp, &cache->entries) {
+        entry = mk_list_entry(head, struct flb_net_dns_cache_entry, _head);
+        entry_destroy(cache, entry);
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    flb_free(cache);
+}
+
+/*
+ * Look for 'host:port' in the cache. On a hit or a stale hit 'res' gets a
+ * copy of the addresses that must be released by the caller, a negative hit
+ * sets 'status' to the error of the original lookup. A miss means the caller
+ * must resolve the name and report the result with flb_net_dns_cache_store().
+ */
+int flb_net_dns_cache_lookup(struct flb_net_dns_cache *cache,
+                             const char *host, const char *port,
+                             struct addrinfo **res, int *status)
+{
+    int ret;
+    time_t now;
+    char key[320];
+    struct flb_net_dns_cache_entry *entry;
+
+    if (entry_key(key, sizeof(key), host, port) == -1) {
+        return FLB_NET_DNS_CACHE_MISS;
+    }
+
+    now = time(NULL);
+    ret = FLB_NET_DNS_CACHE_MISS;
+
+    pthread_mutex_lock(&cache->lock);
+
+    entry = entry_get(cache, key);
+    if (!entry) {
+        cache->misses++;
+        pthread_mutex_unlock(&cache->lock);
+        return FLB_NET_DNS_CACHE_MISS;
+    }
+
+    if (now < entry->expires) {
+        if (!entry->addrs) {
+            *status = entry->status;
+            ret = FLB_NET_DNS_CACHE_NEGATIVE;
+        }
+        else {
+            *res = entry_addrs(entry);
+            if (*res) {
+                ret = FLB_NET_DNS_CACHE_HIT;
+            }
+        }
+    }
+    else if (entry->addrs && now < entry->expires + cache->stale_ttl) {
+        /* the first caller refreshes the entry, the others use it meanwhile */
+        if (entry->refreshing) {
+            *res = entry_addrs(entry);
+            if (*res) {
+                ret = FLB_NET_DNS_CACHE_STALE;
+            }
+        }
+        else {
+            entry->refreshing = FLB_TRUE;
+        }
+    }
+    else {
+        entry_destroy(cache, entry);
+    }
+
+    switch (ret) {
+    case FLB_NET_DNS_CACHE_HIT:
+        cache->hits++;
+        break;
+    case FLB_NET_DNS_CACHE_STALE:
+        cache->stale_hits++;
+        break;
+    case FLB_NET_DNS_CACHE_NEGATIVE:
+        cache->negative_hits++;
+        break;
+    default:
+        cache->misses++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return ret;
+}
+
+/*
+ * Save the result of a lookup: 'ttl' is the lowest TTL of the records and
+ * it's capped by 'dns.cache.max_ttl', results that cannot be cached or
+ * errors that are not a 'not found' answer are ignored.
+ */
+void flb_net_dns_cache_store(struct flb_net_dns_cache *cache,
+                             const char *host, const char *port,
+                             int status, struct addrinfo *res, int ttl)
+{
+    int count = 0;
+    time_t now;
+    char key[320];
+    struct addrinfo *rp;
+    struct addrinfo *addrs = NULL;
+    struct flb_net_dns_cache_entry *entry;
+
+    if (entry_key(key, sizeof(key), host, port) == -1) {
+        return;
+    }
+
+    if (status == ARES_SUCCESS) {
+        for (rp = res; rp != NULL; rp = rp->ai_next) {
+            count++;
+        }
+        if (ttl > cache->max_ttl) {
+            ttl = cache->max_ttl;
+        }
+    }
+    else if (status == ARES_ENOTFOUND || status == ARES_ENODATA) {
+        ttl = cache->negative_ttl;
+    }
+    else {
+        ttl = 0;
+    }
+
+    if (ttl > 0 && count > 0) {
+        addrs = addrinfo_copy(res, count, 0);
+        if (!addrs) {
+            ttl = 0;
+        }
+    }
+
+    now = time(NULL);
+
+    pthread_mutex_lock(&cache->lock);
+
+    entry = entry_get(cache, key);
+    if (ttl <= 0) {
+        /* keep a stale entry only if there is no newer answer for it */
+        if (entry && status == ARES_SUCCESS) {
+            entry_destroy(cache, entry);
+        }
+        else if (entry) {
+            entry->refreshing = FLB_FALSE;
+        }
+        pthread_mutex_unlock(&cache->lock);
+        return;
+    }
+
+    if (!entry) {
+        if (cache->entry_count >= FLB_NET_DNS_CACHE_MAX_ENTRIES) {
+            entries_evict(cache, now);
+        }
+
+        entry = flb_calloc(1, sizeof(struct flb_net_dns_cache_entry));
+        if (!entry) {
+            flb_errno();
+            pthread_mutex_unlock(&cache->lock);
+            addrinfo_free(addrs);
+            return;
+        }
+        entry->key = flb_strdup(key);
+        if (!entry->key) {
+            flb_free(entry);
+            pthread_mutex_unlock(&cache->lock);
+            addrinfo_free(addrs);
+            return;
+        }
+        mk_list_add(&entry->_head, &cache->entries);
+        cache->entry_count++;
+    }
+
+    addrinfo_free(entry->addrs);
+    entry->addrs = addrs;
+    entry->count = count;
+    entry->status = status;
+    entry->refreshing = FLB_FALSE;
+    entry->expires = now + ttl;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/*
+ * The lookup refreshing an expired entry failed: if the entry is still in
+ * the stale window 'res' gets a copy of the old addresses.
+ */
+int flb_net_dns_cache_fallback(struct flb_net_dns_cache *cache,
+                               const char *host, const char *port,
+                               struct addrinfo **res)
+{
+    int ret = -1;
+    time_t now;
+    char key[320];
+    struct flb_net_dns_cache_entry *entry;
+
+    if (entry_key(key, sizeof(key), host, port) == -1) {
+        return -1;
+    }
+
+    now = time(NULL);
+
+    pthread_mutex_lock(&cache->lock);
+
+    entry = entry_get(cache, key);
+    if (entry && entry->addrs) {
+        entry->refreshing = FLB_FALSE;
+
+        if (now < entry->expires + cache->stale_ttl) {
+            *res = entry_addrs(entry);
+            if (*res) {
+                cache->stale_hits++;
+                ret = 0;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return ret;
+}
+
+/* Account the time spent by a lookup in the resolver (nanoseconds) */
+void flb_net_dns_cache_observe(struct flb_net_dns_cache *cache, uint64_t ns)
+{
+    int i;
+    double val;
+
+    val = (double) ns / 1000000000.0;
+
+    pthread_mutex_lock(&cache->lock);
+
+    for (i = FLB_NET_DNS_CACHE_LATENCY_BUCKETS - 1; i >= 0; i--) {
+        if (val > latency_bounds[i]) {
+            break;
+        }
+        cache->latency_buckets[i]++;
+    }
+    cache->latency_buckets[FLB_NET_DNS_CACHE_LATENCY_BUCKETS]++;
+    cache->latency_count++;
+    cache->latency_sum += val;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int flb_net_dns_cache_metrics(struct flb_net_dns_cache *cache, struct cmt *cmt,
+                              uint64_t ts, char *hostname)
+{
+    int i;
+    double sum;
+    uint64_t count;
+    uint64_t lookups[4];
+    uint64_t buckets[FLB_NET_DNS_CACHE_LATENCY_BUCKETS + 1];
+    char *results[] = {"hit", "stale", "negative", "miss"};
+    struct cmt_counter *c;
+    struct cmt_gauge *g;
+    struct cmt_histogram *h;
+    struct cmt_histogram_buckets *b;
+
+    pthread_mutex_lock(&cache->lock);
+    lookups[0] = cache->hits;
+    lookups[1] = cache->stale_hits;
+    lookups[2] = cache->negative_hits;
+    lookups[3] = cache->misses;
+    memcpy(buckets, cache->latency_buckets, sizeof(buckets));
+    count = cache->latency_count;
+    sum = cache->latency_sum;
+    i = cache->entry_count;
+    pthread_mutex_unlock(&cache->lock);
+
+    g = cmt_gauge_create(cmt, "fluentbit", "dns_cache", "entries",
+                         "Number of names held by the DNS cache.",
+                         1, (char *[]) {"hostname"});
+    if (!g) {
+        return -1;
+    }
+    cmt_gauge_set(g, ts, (double) i, 1, (char *[]) {hostname});
+
+    c = cmt_counter_create(cmt, "fluentbit", "dns_cache", "lookups_total",
+                           "Number of DNS cache lookups by result.",
+                           2, (char *[]) {"hostname", "result"});
+    if (!c) {
+        return -1;
+    }
+    for (i = 0; i < 4; i++) {
+        cmt_counter_set(c, ts, (double) lookups[i],
+                        2, (char *[]) {hostname, results[i]});
+    }
+
+    b = cmt_histogram_buckets_create_size(latency_bounds,
+                                          FLB_NET_DNS_CACHE_LATENCY_BUCKETS);
+    if (!b) {
+        return -1;
+    }
+    h = cmt_histogram_create(cmt, "fluentbit", "dns", "resolution_seconds",
+                             "Time spent resolving names not found in the "
+                             "DNS cache.",
+                             b, 1, (char *[]) {"hostname"});
+    if (!h) {
+        cmt_histogram_buckets_destroy(b);
+        return -1;
+    }
+    cmt_histogram_set_default(h, ts, buckets, sum, count,
+                              1, (char *[]) {hostname});
+
+    return 0;
+}
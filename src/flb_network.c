@@ -45,9 +45,11 @@
 #include <fluent-bit/flb_macros.h>
 #include <fluent-bit/flb_upstream.h>
 #include <fluent-bit/flb_scheduler.h>
+#include <fluent-bit/flb_net_dns_cache.h>
 
 #include <monkey/mk_core.h>
 #include <ares.h>
+#include <cfl/cfl_time.h>
 
 #ifdef FLB_SYSTEM_MACOS
 #ifdef _GNU_SOURCE
@@ -116,10 +118,13 @@ void flb_net_setup_init(struct flb_net_setup *net)
     net->keepalive = FLB_TRUE;
     net->keepalive_idle_timeout = 30;
     net->keepalive_max_recycle = 0;
+    net->keepalive_min_idle = 0;
     net->accept_timeout = 10;
     net->connect_timeout = 10;
     net->io_timeout = 0; /* Infinite time */
     net->source_address = NULL;
+    net->http2 = FLB_FALSE;
+    net->http2_max_streams = 100;
 }
 
 int flb_net_host_set(const char *plugin_name, struct flb_net_host *host, const char *address)
@@ -775,6 +780,28 @@ static struct addrinfo *flb_net_translate_ares_addrinfo(struct ares_addrinfo *in
 }
 
 
+static int flb_net_ares_addrinfo_ttl(struct ares_addrinfo *input)
+{
+    int                        ttl;
+    struct ares_addrinfo_node *current_ares_record;
+
+    ttl = -1;
+
+    for (current_ares_record = input->nodes ;
+         current_ares_record != NULL ;
+         current_ares_record = current_ares_record->ai_next) {
+        if (ttl == -1 || current_ares_record->ai_ttl < ttl) {
+            ttl = current_ares_record->ai_ttl;
+        }
+    }
+
+    if (ttl < 0) {
+        ttl = 0;
+    }
+
+    return ttl;
+}
+
 static void flb_net_getaddrinfo_callback(void *arg, int status, int timeouts,
                                          struct ares_addrinfo *res)
 {
@@ -797,6 +824,7 @@ static void flb_net_getaddrinfo_callback(void *arg, int status, int timeouts,
         }
         else {
             *(lookup_context->result_code) = ARES_SUCCESS;
+            *(lookup_context->result_ttl) = flb_net_ares_addrinfo_ttl(res);
         }
 
         ares_freeaddrinfo(res);
@@ -1041,12 +1069,14 @@ static struct flb_dns_lookup_context *flb_net_dns_lookup_context_create(
 }
 
 int flb_net_getaddrinfo(const char *node, const char *service, struct addrinfo *hints,
-                        struct addrinfo **res, char *dns_mode_textual, int timeout)
+                        struct addrinfo **res, char *dns_mode_textual, int timeout,
+                        int *ttl)
 {
     int                            udp_timeout_detected;
     struct flb_dns_lookup_context *lookup_context;
     int                            errno_backup;
     int                            result_code;
+    int                            result_ttl;
     struct addrinfo               *result_data;
     struct ares_addrinfo_hints     ares_hints;
     struct mk_event_loop          *event_loop;
@@ -1083,6 +1113,7 @@ int flb_net_getaddrinfo(const char *node, const char *service, struct addrinfo *
 
     lookup_context->udp_timeout_detected = &udp_timeout_detected;
     lookup_context->result_code = &result_code;
+    lookup_context->result_ttl = &result_ttl;
     lookup_context->result = &result_data;
 
     /* We think that either the callback or the timeout handler should be executed always
@@ -1091,6 +1122,7 @@ int flb_net_getaddrinfo(const char *node, const char *service, struct addrinfo *
      * is not ARES_SUCCESS and thus cause a NULL pointer to be returned.
      */
     result_code = ARES_ESERVFAIL;
+    result_ttl = 0;
     result_data = NULL;
     udp_timeout_detected = 0;
 
@@ -1165,6 +1197,10 @@ int flb_net_getaddrinfo(const char *node, const char *service, struct addrinfo *
 
     if (!result_code) {
         *res = result_data;
+
+        if (ttl != NULL) {
+            *ttl = result_ttl;
+        }
     }
 
     result = result_code;
@@ -1226,6 +1262,61 @@ static void set_ip_family(const char *host, struct addrinfo *hints)
     }
 }
 
+/*
+ * Asynchronous lookup through the DNS cache of the service: names found in
+ * the cache don't reach the resolver, the other results are saved for the
+ * next connections. Numeric addresses are never cached.
+ */
+static int net_getaddrinfo_cached(struct flb_connection *u_conn,
+                                  const char *host, const char *port,
+                                  struct addrinfo *hints, struct addrinfo **res,
+                                  int timeout)
+{
+    int ret;
+    int ttl;
+    int status;
+    uint64_t ts;
+    struct flb_net_dns_cache *cache = NULL;
+
+    if (u_conn->stream != NULL && u_conn->stream->config != NULL &&
+        !(hints->ai_flags & AI_NUMERICHOST)) {
+        cache = u_conn->stream->config->dns_cache_ctx;
+    }
+
+    if (cache == NULL) {
+        return flb_net_getaddrinfo(host, port, hints, res,
+                                   u_conn->net->dns_mode, timeout, NULL);
+    }
+
+    ret = flb_net_dns_cache_lookup(cache, host, port, res, &status);
+    if (ret == FLB_NET_DNS_CACHE_HIT || ret == FLB_NET_DNS_CACHE_STALE) {
+        return 0;
+    }
+    else if (ret == FLB_NET_DNS_CACHE_NEGATIVE) {
+        return status;
+    }
+
+    ttl = 0;
+    ts = cfl_time_now();
+    ret = flb_net_getaddrinfo(host, port, hints, res,
+                              u_conn->net->dns_mode, timeout, &ttl);
+    flb_net_dns_cache_observe(cache, cfl_time_now() - ts);
+
+    if (ret == ARES_SUCCESS) {
+        flb_net_dns_cache_store(cache, host, port, ret, *res, ttl);
+    }
+    else if (ret == ARES_ENOTFOUND || ret == ARES_ENODATA) {
+        flb_net_dns_cache_store(cache, host, port, ret, NULL, 0);
+    }
+    else if (flb_net_dns_cache_fallback(cache, host, port, res) == 0) {
+        flb_debug("[net] getaddrinfo(host='%s', err=%d): %s, using stale records",
+                  host, ret, ares_strerror(ret));
+        ret = 0;
+    }
+
+    return ret;
+}
+
 /* Connect to a TCP socket server and returns the file descriptor */
 flb_sockfd_t flb_net_tcp_connect(const char *host, unsigned long port,
                                  char *source_addr, int connect_timeout,
@@ -1269,9 +1360,8 @@ flb_sockfd_t flb_net_tcp_connect(const char *host, unsigned long port,
 
     /* retrieve DNS info */
     if (use_async_dns) {
-        ret = flb_net_getaddrinfo(host, _port, &hints, &res,
-                                  u_conn->net->dns_mode,
-                                  connect_timeout);
+        ret = net_getaddrinfo_cached(u_conn, host, _port, &hints, &res,
+                                     connect_timeout);
     }
     else {
         ret = getaddrinfo(host, _port, &hints, &res);
@@ -1070,6 +1070,7 @@ int flb_output_init_all(struct flb_config *config)
     int ret;
 #ifdef FLB_HAVE_METRICS
     char *name;
+    struct cmt_histogram_buckets *buckets;
 #endif
     struct mk_list *tmp;
     struct mk_list *head;
@@ -1205,6 +1206,18 @@ int flb_output_init_all(struct flb_config *config)
                       0,
                       1, (char *[]) {name});
 
+        /* output_upstream_connection_wait_seconds */
+        buckets = cmt_histogram_buckets_create(10,
+                                               0.0005, 0.001, 0.005, 0.01,
+                                               0.05, 0.1, 0.5, 1.0, 5.0, 10.0);
+        ins->cmt_upstream_wait_time = cmt_histogram_create(ins->cmt,
+                                                           "fluentbit",
+                                                           "output",
+                                                           "upstream_connection_wait_seconds",
+                                                           "Time spent waiting for an upstream connection.",
+                                                           buckets,
+                                                           1, (char *[]) {"name"});
+
         /* output_chunk_available_capacity_percent */
         ins->cmt_chunk_available_capacity_percent = cmt_gauge_create(ins->cmt,
                                                         "fluentbit",
@@ -1411,6 +1424,12 @@ int flb_output_upstream_set(struct flb_upstream *u, struct flb_output_instance *
     flb_upstream_set_busy_connections_gauge(u,
                                             ins->cmt_upstream_busy_connections);
 
+    flb_upstream_set_wait_time_label(u,
+                                     flb_output_name(ins));
+
+    flb_upstream_set_wait_time_histogram(u,
+                                         ins->cmt_upstream_wait_time);
+
     /*
      * If the output plugin flush callbacks will run in multiple threads, enable
      * the thread safe mode for the Upstream context.
@@ -25,6 +25,7 @@
 #include <fluent-bit/flb_output_plugin.h>
 #include <fluent-bit/flb_output_thread.h>
 #include <fluent-bit/flb_thread_pool.h>
+#include <fluent-bit/flb_arena.h>
 
 static pthread_once_t local_thread_instance_init = PTHREAD_ONCE_INIT;
 FLB_TLS_DEFINE(struct flb_out_thread_instance, local_thread_instance);
@@ -369,6 +370,7 @@ static void output_thread(void *data)
     if (params) {
         flb_free(params);
     }
+    flb_arena_thread_destroy();
 
     mk_event_channel_destroy(th_ins->evl,
                              th_ins->ch_parent_events[0],
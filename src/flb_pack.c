@@ -29,6 +29,8 @@
 #include <fluent-bit/flb_time.h>
 #include <fluent-bit/flb_pack.h>
 #include <fluent-bit/flb_unescape.h>
+#include <fluent-bit/flb_simd.h>
+#include <fluent-bit/flb_dtoa.h>
 
 /* cmetrics */
 #include <cmetrics/cmetrics.h>
@@ -39,10 +41,14 @@
 #include <math.h>
 #include <jsmn/jsmn.h>
 
-#define try_to_write_str  flb_utils_write_str
-
 static int convert_nan_to_null = FLB_FALSE;
 
+#ifdef FLB_HAVE_SIMD
+static int json_backend = FLB_PACK_JSON_BACKEND_SCAN;
+#else
+static int json_backend = FLB_PACK_JSON_BACKEND_JSMN;
+#endif
+
 static int flb_pack_set_null_as_nan(int b) {
     if (b == FLB_TRUE || b == FLB_FALSE) {
         convert_nan_to_null = b;
@@ -230,6 +236,553 @@ static char *tokens_to_msgpack(struct flb_pack_state *state,
     return buf;
 }
 
+#ifdef FLB_HAVE_SIMD
+/*
+ * Single pass JSON packer
+ * -----------------------
+ * Instead of tokenizing the whole message with jsmn and then walking the
+ * tokens array, the scanner below validates the JSON and emits msgpack in
+ * the same pass. String bodies, which are the bulk of most log records, are
+ * scanned with SIMD instructions when available (see flb_simd.h).
+ *
+ * The size of a map or array is not known when it's opened, so a map32 or
+ * array32 header is reserved and its position recorded. Once the buffer is
+ * complete a single compaction pass rewrites every header with the smallest
+ * encoding, so the output is byte by byte the same than the jsmn packer.
+ */
+
+#define JSON_SCAN_HEADER_SIZE   5    /* map32 / array32 placeholder */
+
+struct json_scan_container {
+    size_t offset;      /* header position in the output buffer */
+    uint32_t entries;   /* number of pairs (maps) or items (arrays) */
+    int type;           /* FLB_PACK_JSON_OBJECT or FLB_PACK_JSON_ARRAY */
+    int parent;         /* index of the parent container, -1 on root */
+};
+
+struct json_scan {
+    const char *js;
+    size_t len;
+    size_t pos;
+    int comma;          /* a comma was skipped before the current byte */
+
+    /* containers in the order they were opened */
+    struct json_scan_container *containers;
+    int containers_count;
+    int containers_size;
+
+    /* temporary buffer to unescape strings */
+    char *buf_data;
+    size_t buf_size;
+
+    msgpack_packer pck;
+    msgpack_sbuffer sbuf;
+};
+
+static inline int json_scan_is_space(char c)
+{
+    return (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+}
+
+/*
+ * Skip blanks and separators. Repeated or trailing commas are accepted to
+ * keep the same tolerance than the jsmn based packer, the caller checks a
+ * comma was found between two entries. Returns the next byte or zero if
+ * the end of the buffer has been reached.
+ */
+static inline char json_scan_skip(struct json_scan *s)
+{
+    char c;
+
+    s->comma = FLB_FALSE;
+    while (s->pos < s->len) {
+        c = s->js[s->pos];
+        if (c == ',') {
+            s->comma = FLB_TRUE;
+        }
+        else if (!json_scan_is_space(c)) {
+            return c;
+        }
+        s->pos++;
+    }
+
+    return '\0';
+}
+
+/* Find the first quote, backslash or null byte in [p, end) */
+static inline const char *json_scan_string_stop(const char *p, const char *end)
+{
+#ifndef FLB_SIMD_NONE
+    uint32_t mask;
+    flb_vector8 v;
+    flb_vector8 quote = flb_vector8_broadcast('"');
+    flb_vector8 bslash = flb_vector8_broadcast('\\');
+    flb_vector8 zero = flb_vector8_broadcast('\0');
+
+    while (end - p >= FLB_VECTOR8_SIZE) {
+        v = flb_vector8_load(p);
+        mask = flb_vector8_mask(flb_vector8_or(
+                                   flb_vector8_or(flb_vector8_eq(v, quote),
+                                                  flb_vector8_eq(v, bslash)),
+                                   flb_vector8_eq(v, zero)));
+        if (mask != 0) {
+            return p + flb_simd_ctz(mask);
+        }
+        p += FLB_VECTOR8_SIZE;
+    }
+#endif
+
+    while (p < end && *p != '"' && *p != '\\' && *p != '\0') {
+        p++;
+    }
+
+    return p;
+}
+
+static inline int json_scan_is_hex(char c)
+{
+    return ((c >= '0' && c <= '9') ||
+            (c >= 'A' && c <= 'F') ||
+            (c >= 'a' && c <= 'f'));
+}
+
+/* Pack the string starting at the current position (opening quote) */
+static int json_scan_string(struct json_scan *s)
+{
+    int i;
+    int len;
+    int out_len;
+    int escaped = FLB_FALSE;
+    char *tmp;
+    const char *p;
+    const char *str;
+    const char *end;
+
+    str = s->js + s->pos + 1;
+    end = s->js + s->len;
+    p = str;
+
+    while (1) {
+        p = json_scan_string_stop(p, end);
+        if (p >= end || *p == '\0') {
+            return FLB_ERR_JSON_PART;
+        }
+
+        if (*p == '"') {
+            break;
+        }
+
+        /* backslash: only the JSON escape sequences are allowed */
+        escaped = FLB_TRUE;
+        if (p + 1 >= end) {
+            return FLB_ERR_JSON_PART;
+        }
+
+        switch (p[1]) {
+        case '"':
+        case '/':
+        case '\\':
+        case 'b':
+        case 'f':
+        case 'r':
+        case 'n':
+        case 't':
+            p += 2;
+            break;
+        case 'u':
+            p += 2;
+            for (i = 0; i < 4; i++, p++) {
+                if (p >= end || *p == '\0') {
+                    return FLB_ERR_JSON_PART;
+                }
+                if (!json_scan_is_hex(*p)) {
+                    return FLB_ERR_JSON_INVAL;
+                }
+            }
+            break;
+        case '\0':
+            return FLB_ERR_JSON_PART;
+        default:
+            return FLB_ERR_JSON_INVAL;
+        }
+    }
+
+    len = p - str;
+    s->pos = (p - s->js) + 1;
+
+    if (escaped == FLB_FALSE) {
+        msgpack_pack_str(&s->pck, len);
+        msgpack_pack_str_body(&s->pck, str, len);
+        return 0;
+    }
+
+    if (s->buf_size < len + 1) {
+        tmp = flb_realloc(s->buf_data, len + 1);
+        if (!tmp) {
+            flb_errno();
+            return -1;
+        }
+        s->buf_data = tmp;
+        s->buf_size = len + 1;
+    }
+
+    /* Always decode any UTF-8 or special characters */
+    out_len = flb_unescape_string_utf8(str, len, s->buf_data);
+
+    msgpack_pack_str(&s->pck, out_len);
+    msgpack_pack_str_body(&s->pck, s->buf_data, out_len);
+
+    return 0;
+}
+
+/* Pack a number, boolean or null, strict mode rules from jsmn apply */
+static int json_scan_primitive(struct json_scan *s)
+{
+    int flen;
+    char c;
+    const char *p;
+    size_t pos;
+
+    c = s->js[s->pos];
+    if (c != '-' && (c < '0' || c > '9') && c != 't' && c != 'f' && c != 'n') {
+        return FLB_ERR_JSON_INVAL;
+    }
+
+    for (pos = s->pos; pos < s->len; pos++) {
+        c = s->js[pos];
+        if (json_scan_is_space(c) || c == ',' || c == ']' || c == '}') {
+            break;
+        }
+        if (c == '\0') {
+            return FLB_ERR_JSON_PART;
+        }
+        if (c < 32 || c >= 127) {
+            return FLB_ERR_JSON_INVAL;
+        }
+    }
+
+    /* a primitive must be followed by a delimiter */
+    if (pos == s->len) {
+        return FLB_ERR_JSON_PART;
+    }
+
+    p = s->js + s->pos;
+    flen = pos - s->pos;
+    s->pos = pos;
+
+    if (*p == 'f') {
+        msgpack_pack_false(&s->pck);
+    }
+    else if (*p == 't') {
+        msgpack_pack_true(&s->pck);
+    }
+    else if (*p == 'n') {
+        msgpack_pack_nil(&s->pck);
+    }
+    else {
+        if (is_float(p, flen)) {
+            msgpack_pack_double(&s->pck, atof(p));
+        }
+        else {
+            msgpack_pack_int64(&s->pck, atoll(p));
+        }
+    }
+
+    return 0;
+}
+
+/* Register a new map or array and reserve room for its header */
+static int json_scan_open(struct json_scan *s, int type, int parent)
+{
+    int size;
+    char header[JSON_SCAN_HEADER_SIZE] = {0};
+    struct json_scan_container *tmp;
+    struct json_scan_container *c;
+
+    if (s->containers_count == s->containers_size) {
+        size = s->containers_size * 2;
+        tmp = flb_realloc(s->containers,
+                          sizeof(struct json_scan_container) * size);
+        if (!tmp) {
+            flb_errno();
+            return -1;
+        }
+        s->containers = tmp;
+        s->containers_size = size;
+    }
+
+    c = &s->containers[s->containers_count++];
+    c->offset = s->sbuf.size;
+    c->entries = 0;
+    c->type = type;
+    c->parent = parent;
+
+    header[0] = (char) ((type == FLB_PACK_JSON_OBJECT) ? 0xdf : 0xdd);
+    msgpack_sbuffer_write(&s->sbuf, header, JSON_SCAN_HEADER_SIZE);
+
+    return 0;
+}
+
+/* Scan and pack one root JSON value */
+static int json_scan_record(struct json_scan *s)
+{
+    int ret;
+    int key = FLB_FALSE;
+    int current = -1;
+    char c;
+    struct json_scan_container *cont;
+
+    while (1) {
+        c = json_scan_skip(s);
+        if (c == '\0') {
+            return FLB_ERR_JSON_PART;
+        }
+
+        if (c == '}' || c == ']') {
+            if (current == -1) {
+                return FLB_ERR_JSON_INVAL;
+            }
+
+            cont = &s->containers[current];
+            if ((c == '}' && (cont->type != FLB_PACK_JSON_OBJECT || !key)) ||
+                (c == ']' && cont->type != FLB_PACK_JSON_ARRAY)) {
+                return FLB_ERR_JSON_INVAL;
+            }
+
+            s->pos++;
+            current = cont->parent;
+            goto value_done;
+        }
+
+        /* the entries of a map or array are separated by commas */
+        if (current != -1 && s->containers[current].entries > 0 &&
+            s->comma == FLB_FALSE &&
+            (key == FLB_TRUE ||
+             s->containers[current].type == FLB_PACK_JSON_ARRAY)) {
+            return FLB_ERR_JSON_INVAL;
+        }
+
+        /* object keys must be strings followed by a colon */
+        if (key == FLB_TRUE) {
+            if (c != '"') {
+                return FLB_ERR_JSON_INVAL;
+            }
+
+            ret = json_scan_string(s);
+            if (ret != 0) {
+                return ret;
+            }
+
+            while (s->pos < s->len && json_scan_is_space(s->js[s->pos])) {
+                s->pos++;
+            }
+            if (s->pos == s->len || s->js[s->pos] == '\0') {
+                return FLB_ERR_JSON_PART;
+            }
+            if (s->js[s->pos] != ':') {
+                return FLB_ERR_JSON_INVAL;
+            }
+
+            s->pos++;
+            key = FLB_FALSE;
+            continue;
+        }
+
+        if (current != -1) {
+            s->containers[current].entries++;
+        }
+
+        if (c == '{' || c == '[') {
+            ret = json_scan_open(s, (c == '{') ? FLB_PACK_JSON_OBJECT :
+                                                 FLB_PACK_JSON_ARRAY,
+                                 current);
+            if (ret != 0) {
+                return ret;
+            }
+
+            s->pos++;
+            current = s->containers_count - 1;
+            key = (c == '{');
+            continue;
+        }
+        else if (c == '"') {
+            ret = json_scan_string(s);
+        }
+        else {
+            ret = json_scan_primitive(s);
+        }
+
+        if (ret != 0) {
+            return ret;
+        }
+
+    value_done:
+        if (current == -1) {
+            return 0;
+        }
+        key = (s->containers[current].type == FLB_PACK_JSON_OBJECT);
+    }
+}
+
+/* Write the smallest map/array header for 'entries' and return its size */
+static inline int json_scan_header(char *p, int type, uint32_t entries)
+{
+    if (entries < 16) {
+        p[0] = ((type == FLB_PACK_JSON_OBJECT) ? 0x80 : 0x90) | entries;
+        return 1;
+    }
+    else if (entries < 65536) {
+        p[0] = (type == FLB_PACK_JSON_OBJECT) ? 0xde : 0xdc;
+        p[1] = (entries >> 8) & 0xff;
+        p[2] = entries & 0xff;
+        return 3;
+    }
+
+    p[0] = (type == FLB_PACK_JSON_OBJECT) ? 0xdf : 0xdd;
+    p[1] = (entries >> 24) & 0xff;
+    p[2] = (entries >> 16) & 0xff;
+    p[3] = (entries >> 8) & 0xff;
+    p[4] = entries & 0xff;
+    return 5;
+}
+
+/* Replace the reserved headers with the final ones, shrinking the buffer */
+static void json_scan_compact(struct json_scan *s)
+{
+    int i;
+    size_t n;
+    size_t r;
+    size_t w;
+    char *data;
+    struct json_scan_container *c;
+
+    if (s->containers_count == 0) {
+        return;
+    }
+
+    data = s->sbuf.data;
+    r = s->containers[0].offset;
+    w = r;
+
+    for (i = 0; i < s->containers_count; i++) {
+        c = &s->containers[i];
+
+        n = c->offset - r;
+        if (n > 0 && w != r) {
+            memmove(data + w, data + r, n);
+        }
+        w += n;
+        w += json_scan_header(data + w, c->type, c->entries);
+        r = c->offset + JSON_SCAN_HEADER_SIZE;
+    }
+
+    n = s->sbuf.size - r;
+    if (n > 0) {
+        memmove(data + w, data + r, n);
+    }
+    s->sbuf.size = w + n;
+}
+
+/*
+ * Pack every JSON root value found in 'js'. If 'multiple' is set and the
+ * last value is incomplete, the complete ones are returned and 'last_byte'
+ * points to the end of the last one, as done by the jsmn based packer.
+ */
+static int pack_json_scan(const char *js, size_t len, int multiple,
+                          char **buffer, size_t *size, int *root_type,
+                          int *records, int *last_byte)
+{
+    int ret = 0;
+    int n_records = 0;
+    int last = 0;
+    int last_containers = 0;
+    size_t last_size = 0;
+    char c;
+    struct json_scan s;
+
+    s.js = js;
+    s.len = len;
+    s.pos = 0;
+    s.buf_data = NULL;
+    s.buf_size = 0;
+    s.containers_count = 0;
+    s.containers_size = 64;
+    s.containers = flb_malloc(sizeof(struct json_scan_container) *
+                              s.containers_size);
+    if (!s.containers) {
+        flb_errno();
+        return -1;
+    }
+
+    msgpack_sbuffer_init(&s.sbuf);
+    msgpack_packer_init(&s.pck, &s.sbuf, msgpack_sbuffer_write);
+
+    while (1) {
+        c = json_scan_skip(&s);
+        if (c == '\0') {
+            break;
+        }
+
+        if (n_records == 0) {
+            if (c == '{') {
+                *root_type = FLB_PACK_JSON_OBJECT;
+            }
+            else if (c == '[') {
+                *root_type = FLB_PACK_JSON_ARRAY;
+            }
+            else if (c == '"') {
+                *root_type = FLB_PACK_JSON_STRING;
+            }
+            else {
+                *root_type = FLB_PACK_JSON_PRIMITIVE;
+            }
+        }
+
+        ret = json_scan_record(&s);
+        if (ret != 0) {
+            break;
+        }
+
+        n_records++;
+        last_size = s.sbuf.size;
+        last_containers = s.containers_count;
+
+        /* jsmn reports the end of a root string before its closing quote */
+        last = s.pos;
+        if (c == '"') {
+            last--;
+        }
+    }
+
+    /* drop an incomplete trailing value */
+    if (ret == FLB_ERR_JSON_PART && multiple == FLB_TRUE && n_records > 0) {
+        s.sbuf.size = last_size;
+        s.containers_count = last_containers;
+        ret = 0;
+    }
+
+    if (ret == 0 && n_records == 0) {
+        ret = FLB_ERR_JSON_INVAL;
+    }
+
+    if (ret != 0) {
+        msgpack_sbuffer_destroy(&s.sbuf);
+    }
+    else {
+        json_scan_compact(&s);
+        *buffer = s.sbuf.data;
+        *size = s.sbuf.size;
+        *records = n_records;
+        *last_byte = last;
+    }
+
+    flb_free(s.containers);
+    flb_free(s.buf_data);
+
+    return ret;
+}
+#endif
+
 /*
  * It parse a JSON string and convert it to MessagePack format, this packer is
  * useful when a complete JSON message exists, otherwise it will fail until
@@ -249,6 +802,21 @@ static int pack_json_to_msgpack(const char *js, size_t len, char **buffer,
     char *buf = NULL;
     struct flb_pack_state state;
 
+#ifdef FLB_HAVE_SIMD
+    if (json_backend == FLB_PACK_JSON_BACKEND_SCAN) {
+        ret = pack_json_scan(js, len, FLB_FALSE, buffer, size, root_type,
+                             records, &last);
+        if (ret != 0) {
+            return -1;
+        }
+
+        if (consumed != NULL) {
+            *consumed = last;
+        }
+        return 0;
+    }
+#endif
+
     ret = flb_pack_state_init(&state);
     if (ret != 0) {
         return -1;
@@ -367,6 +935,26 @@ int flb_pack_json_state(const char *js, size_t len,
     int records;
     char *buf;
     jsmntok_t *t;
+#ifdef FLB_HAVE_SIMD
+    int root_type;
+    size_t out_size;
+
+    if (json_backend == FLB_PACK_JSON_BACKEND_SCAN) {
+        state->multiple = FLB_TRUE;
+        ret = pack_json_scan(js, len, state->multiple, buffer, &out_size,
+                             &root_type, &records, &last);
+        if (ret != 0) {
+            if (ret == FLB_ERR_JSON_INVAL) {
+                state->last_byte = 0;
+            }
+            return ret;
+        }
+
+        *size = out_size;
+        state->last_byte = last;
+        return 0;
+    }
+#endif
 
     ret = flb_json_tokenise(js, len, state);
     state->multiple = FLB_TRUE;
@@ -536,29 +1124,165 @@ void flb_pack_print_metrics(const char *data, size_t bytes)
     cmt_encode_text_destroy(text);
 }
 
-static inline int try_to_write(char *buf, int *off, size_t left,
-                               const char *str, size_t str_len)
+/*
+ * msgpack to JSON serializer. The output is appended to a flb_sds buffer,
+ * every token reserves its worst case size once and then it's written with
+ * plain stores: strings are escaped by flb_utils_write_str_raw(), integers
+ * use a two digits lookup table and floating point values get their
+ * shortest round-trip representation from flb_dtoa().
+ */
+
+/* Room for any number written by json_write_*() */
+#define JSON_NUMBER_MAX    FLB_DTOA_BUFFER_SIZE
+
+static const char json_digits_lut[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char json_hex[] = "0123456789abcdef";
+
+/* Make room for 'size' bytes, returns the write position */
+static inline char *json_reserve(flb_sds_t *buf, size_t size)
 {
-    if (str_len <= 0){
-        str_len = strlen(str);
-    }
-    if (left <= *off+str_len) {
-        return FLB_FALSE;
+    size_t alloc;
+    flb_sds_t tmp;
+
+    if (flb_sds_avail(*buf) < size) {
+        alloc = flb_sds_alloc(*buf);
+        if (alloc < size) {
+            alloc = size;
+        }
+
+        tmp = flb_sds_increase(*buf, alloc);
+        if (!tmp) {
+            return NULL;
+        }
+        *buf = tmp;
     }
-    memcpy(buf+*off, str, str_len);
-    *off += str_len;
-    return FLB_TRUE;
+
+    return *buf + flb_sds_len(*buf);
 }
 
+static inline void json_commit(flb_sds_t buf, char *end)
+{
+    flb_sds_len_set(buf, end - buf);
+}
 
-/*
- * Check if a key exists in the map using the 'offset' as an index to define
- * which element needs to start looking from
- */
-static inline int key_exists_in_map(msgpack_object key, msgpack_object map, int offset)
+static inline int json_write_char(flb_sds_t *buf, char c)
 {
-    int i;
-    msgpack_object p;
+    char *p;
+
+    p = json_reserve(buf, 1);
+    if (!p) {
+        return -1;
+    }
+    *p++ = c;
+    json_commit(*buf, p);
+
+    return 0;
+}
+
+static inline char *json_write_u64(char *p, uint64_t v)
+{
+    int len;
+    int idx;
+    char tmp[20];
+    char *t = tmp + sizeof(tmp);
+
+    while (v >= 100) {
+        idx = (v % 100) * 2;
+        v /= 100;
+        *--t = json_digits_lut[idx + 1];
+        *--t = json_digits_lut[idx];
+    }
+
+    if (v >= 10) {
+        *--t = json_digits_lut[v * 2 + 1];
+        *--t = json_digits_lut[v * 2];
+    }
+    else {
+        *--t = '0' + v;
+    }
+
+    len = (tmp + sizeof(tmp)) - t;
+    memcpy(p, t, len);
+
+    return p + len;
+}
+
+static inline char *json_write_i64(char *p, int64_t v)
+{
+    if (v < 0) {
+        *p++ = '-';
+        return json_write_u64(p, (uint64_t) -(v + 1) + 1);
+    }
+
+    return json_write_u64(p, v);
+}
+
+/*
+ * Integral values keep the '%.1f' layout (e.g: 10.0), non finite ones are
+ * left to printf(3), everything else uses the shortest representation.
+ */
+static inline char *json_write_double(char *p, double d)
+{
+    if (d == (double)(long long int) d) {
+        /* exact integers, no rounding involved */
+        if (fabs(d) < 9007199254740992.0) {
+            if (signbit(d)) {
+                *p++ = '-';
+            }
+            p = json_write_u64(p, (uint64_t) fabs(d));
+            *p++ = '.';
+            *p++ = '0';
+            return p;
+        }
+        return p + snprintf(p, JSON_NUMBER_MAX, "%.1f", d);
+    }
+    else if (convert_nan_to_null && isnan(d)) {
+        memcpy(p, "null", 4);
+        return p + 4;
+    }
+    else if (!isfinite(d)) {
+        return p + snprintf(p, JSON_NUMBER_MAX, "%.16g", d);
+    }
+
+    return p + flb_dtoa(d, p);
+}
+
+static inline int json_write_str(flb_sds_t *buf, const char *str, size_t len)
+{
+    char *p;
+
+    p = json_reserve(buf, FLB_UTILS_WRITE_STR_MAX(len) + 2);
+    if (!p) {
+        return -1;
+    }
+
+    *p++ = '"';
+    p += flb_utils_write_str_raw(p, str, len);
+    *p++ = '"';
+    json_commit(*buf, p);
+
+    return 0;
+}
+
+/*
+ * Check if a key exists in the map using the 'offset' as an index to define
+ * which element needs to start looking from
+ */
+static inline int key_exists_in_map(msgpack_object key, msgpack_object map, int offset)
+{
+    int i;
+    msgpack_object p;
 
     if (key.type != MSGPACK_OBJECT_STR) {
         return FLB_FALSE;
@@ -582,166 +1306,169 @@ static inline int key_exists_in_map(msgpack_object key, msgpack_object map, int
     return FLB_FALSE;
 }
 
-static int msgpack2json(char *buf, int *off, size_t left,
-                        const msgpack_object *o)
+static int msgpack2json(flb_sds_t *buf, const msgpack_object *o);
+
+/*
+ * Write the entries of the map 'o', 'packed' is the number of entries
+ * already written in the same JSON object. When a key is repeated only
+ * its last value is written.
+ */
+static int msgpack2json_kvs(flb_sds_t *buf, const msgpack_object *o, int packed)
+{
+    int i;
+    msgpack_object_kv *kv;
+
+    for (i = 0; i < o->via.map.size; i++) {
+        kv = &o->via.map.ptr[i];
+        if (key_exists_in_map(kv->key, *o, i + 1) == FLB_TRUE) {
+            continue;
+        }
+
+        if (packed > 0 && json_write_char(buf, ',') == -1) {
+            return -1;
+        }
+
+        if (msgpack2json(buf, &kv->key) == -1 ||
+            json_write_char(buf, ':') == -1 ||
+            msgpack2json(buf, &kv->val) == -1) {
+            return -1;
+        }
+        packed++;
+    }
+
+    return 0;
+}
+
+static int msgpack2json(flb_sds_t *buf, const msgpack_object *o)
 {
     int i;
-    int dup;
-    int ret = FLB_FALSE;
-    int loop;
-    int packed;
+    int c;
+    char *p;
 
     switch(o->type) {
     case MSGPACK_OBJECT_NIL:
-        ret = try_to_write(buf, off, left, "null", 4);
+        p = json_reserve(buf, 4);
+        if (!p) {
+            return -1;
+        }
+        memcpy(p, "null", 4);
+        json_commit(*buf, p + 4);
         break;
 
     case MSGPACK_OBJECT_BOOLEAN:
-        ret = try_to_write(buf, off, left,
-                           (o->via.boolean ? "true":"false"),0);
-
+        p = json_reserve(buf, 5);
+        if (!p) {
+            return -1;
+        }
+        if (o->via.boolean) {
+            memcpy(p, "true", 4);
+            p += 4;
+        }
+        else {
+            memcpy(p, "false", 5);
+            p += 5;
+        }
+        json_commit(*buf, p);
         break;
 
     case MSGPACK_OBJECT_POSITIVE_INTEGER:
-        {
-            char temp[32] = {0};
-            i = snprintf(temp, sizeof(temp)-1, "%"PRIu64, o->via.u64);
-            ret = try_to_write(buf, off, left, temp, i);
+        p = json_reserve(buf, JSON_NUMBER_MAX);
+        if (!p) {
+            return -1;
         }
+        json_commit(*buf, json_write_u64(p, o->via.u64));
         break;
 
     case MSGPACK_OBJECT_NEGATIVE_INTEGER:
-        {
-            char temp[32] = {0};
-            i = snprintf(temp, sizeof(temp)-1, "%"PRId64, o->via.i64);
-            ret = try_to_write(buf, off, left, temp, i);
+        p = json_reserve(buf, JSON_NUMBER_MAX);
+        if (!p) {
+            return -1;
         }
+        json_commit(*buf, json_write_i64(p, o->via.i64));
         break;
+
     case MSGPACK_OBJECT_FLOAT32:
     case MSGPACK_OBJECT_FLOAT64:
-        {
-            char temp[512] = {0};
-            if (o->via.f64 == (double)(long long int)o->via.f64) {
-                i = snprintf(temp, sizeof(temp)-1, "%.1f", o->via.f64);
-            }
-            else if (convert_nan_to_null && isnan(o->via.f64) ) {
-                i = snprintf(temp, sizeof(temp)-1, "null");
-            }
-            else {
-                i = snprintf(temp, sizeof(temp)-1, "%.16g", o->via.f64);
-            }
-            ret = try_to_write(buf, off, left, temp, i);
+        p = json_reserve(buf, JSON_NUMBER_MAX);
+        if (!p) {
+            return -1;
         }
+        json_commit(*buf, json_write_double(p, o->via.f64));
         break;
 
     case MSGPACK_OBJECT_STR:
-        if (try_to_write(buf, off, left, "\"", 1) &&
-            (o->via.str.size > 0 ?
-             try_to_write_str(buf, off, left, o->via.str.ptr, o->via.str.size)
-             : 1/* nothing to do */) &&
-            try_to_write(buf, off, left, "\"", 1)) {
-            ret = FLB_TRUE;
-        }
-        break;
+        return json_write_str(buf, o->via.str.ptr, o->via.str.size);
 
     case MSGPACK_OBJECT_BIN:
-        if (try_to_write(buf, off, left, "\"", 1) &&
-            (o->via.bin.size > 0 ?
-             try_to_write_str(buf, off, left, o->via.bin.ptr, o->via.bin.size)
-              : 1 /* nothing to do */) &&
-            try_to_write(buf, off, left, "\"", 1)) {
-            ret = FLB_TRUE;
-        }
-        break;
+        return json_write_str(buf, o->via.bin.ptr, o->via.bin.size);
 
     case MSGPACK_OBJECT_EXT:
-        if (!try_to_write(buf, off, left, "\"", 1)) {
-            goto msg2json_end;
-        }
-        /* ext body. fortmat is similar to printf(1) */
-        {
-            char temp[32] = {0};
-            int  len;
-            loop = o->via.ext.size;
-            for(i=0; i<loop; i++) {
-                len = snprintf(temp, sizeof(temp)-1, "\\x%02x", (char)o->via.ext.ptr[i]);
-                if (!try_to_write(buf, off, left, temp, len)) {
-                    goto msg2json_end;
-                }
-            }
+        /*
+         * ext body, format is similar to printf(1): every byte is written
+         * as \x%02x of its (char) value, so negative ones get 8 digits.
+         */
+        p = json_reserve(buf, o->via.ext.size * 10 + 2);
+        if (!p) {
+            return -1;
         }
-        if (!try_to_write(buf, off, left, "\"", 1)) {
-            goto msg2json_end;
+        *p++ = '"';
+        for (i = 0; i < o->via.ext.size; i++) {
+            c = (char) o->via.ext.ptr[i];
+            *p++ = '\\';
+            *p++ = 'x';
+            if (c < 0) {
+                memcpy(p, "ffffff", 6);
+                p += 6;
+            }
+            *p++ = json_hex[(c >> 4) & 0x0f];
+            *p++ = json_hex[c & 0x0f];
         }
-        ret = FLB_TRUE;
+        *p++ = '"';
+        json_commit(*buf, p);
         break;
 
     case MSGPACK_OBJECT_ARRAY:
-        loop = o->via.array.size;
-
-        if (!try_to_write(buf, off, left, "[", 1)) {
-            goto msg2json_end;
+        if (json_write_char(buf, '[') == -1) {
+            return -1;
         }
-        if (loop != 0) {
-            msgpack_object* p = o->via.array.ptr;
-            if (!msgpack2json(buf, off, left, p)) {
-                goto msg2json_end;
+        for (i = 0; i < o->via.array.size; i++) {
+            if (i > 0 && json_write_char(buf, ',') == -1) {
+                return -1;
             }
-            for (i=1; i<loop; i++) {
-                if (!try_to_write(buf, off, left, ",", 1) ||
-                    !msgpack2json(buf, off, left, p+i)) {
-                    goto msg2json_end;
-                }
+            if (msgpack2json(buf, &o->via.array.ptr[i]) == -1) {
+                return -1;
             }
         }
-
-        ret = try_to_write(buf, off, left, "]", 1);
-        break;
+        return json_write_char(buf, ']');
 
     case MSGPACK_OBJECT_MAP:
-        loop = o->via.map.size;
-        if (!try_to_write(buf, off, left, "{", 1)) {
-            goto msg2json_end;
-        }
-        if (loop != 0) {
-            msgpack_object k;
-            msgpack_object_kv *p = o->via.map.ptr;
-
-            packed = 0;
-            dup = FLB_FALSE;
-
-            k = o->via.map.ptr[0].key;
-            for (i = 0; i < loop; i++) {
-                k = o->via.map.ptr[i].key;
-                dup = key_exists_in_map(k, *o, i + 1);
-                if (dup == FLB_TRUE) {
-                    continue;
-                }
-
-                if (packed > 0) {
-                    if (!try_to_write(buf, off, left, ",", 1)) {
-                        goto msg2json_end;
-                    }
-                }
-
-                if (
-                    !msgpack2json(buf, off, left, &(p+i)->key) ||
-                    !try_to_write(buf, off, left, ":", 1)  ||
-                    !msgpack2json(buf, off, left, &(p+i)->val) ) {
-                    goto msg2json_end;
-                }
-                packed++;
-            }
+        if (json_write_char(buf, '{') == -1 ||
+            msgpack2json_kvs(buf, o, 0) == -1) {
+            return -1;
         }
-
-        ret = try_to_write(buf, off, left, "}", 1);
-        break;
+        return json_write_char(buf, '}');
 
     default:
         flb_warn("[%s] unknown msgpack type %i", __FUNCTION__, o->type);
+        return -1;
     }
 
- msg2json_end:
+    return 0;
+}
+
+/*
+ * Append the JSON representation of 'obj' to the 'buf' sds buffer, it's
+ * reallocated as needed. Returns 0 on success or -1 on error.
+ */
+int flb_msgpack_to_json_sds(flb_sds_t *buf, const msgpack_object *obj)
+{
+    int ret;
+
+    ret = msgpack2json(buf, obj);
+
+    /* keep the buffer NULL terminated, the header excludes that byte */
+    (*buf)[flb_sds_len(*buf)] = '\0';
+
     return ret;
 }
 
@@ -757,16 +1484,34 @@ static int msgpack2json(char *buf, int *off, size_t left,
 int flb_msgpack_to_json(char *json_str, size_t json_size,
                         const msgpack_object *obj)
 {
-    int ret = -1;
-    int off = 0;
+    int ret;
+    size_t len;
+    flb_sds_t out_buf;
 
     if (json_str == NULL || obj == NULL) {
         return -1;
     }
 
-    ret = msgpack2json(json_str, &off, json_size - 1, obj);
-    json_str[off] = '\0';
-    return ret ? off: ret;
+    out_buf = flb_sds_create_size(json_size);
+    if (!out_buf) {
+        flb_errno();
+        return -1;
+    }
+
+    ret = flb_msgpack_to_json_sds(&out_buf, obj);
+    len = flb_sds_len(out_buf);
+
+    /* not enough space */
+    if (ret == -1 || len >= json_size) {
+        json_str[0] = '\0';
+        flb_sds_destroy(out_buf);
+        return 0;
+    }
+
+    memcpy(json_str, out_buf, len + 1);
+    flb_sds_destroy(out_buf);
+
+    return len;
 }
 
 flb_sds_t flb_msgpack_raw_to_json_sds(const void *in_buf, size_t in_size)
@@ -774,58 +1519,33 @@ flb_sds_t flb_msgpack_raw_to_json_sds(const void *in_buf, size_t in_size)
     int ret;
     size_t off = 0;
     size_t out_size;
-    size_t realloc_size;
-
     msgpack_unpacked result;
-    msgpack_object *root;
     flb_sds_t out_buf;
-    flb_sds_t tmp_buf;
 
     /* buffer size strategy */
     out_size = in_size * FLB_MSGPACK_TO_JSON_INIT_BUFFER_SIZE;
-    realloc_size = in_size * FLB_MSGPACK_TO_JSON_REALLOC_BUFFER_SIZE;
-    if (realloc_size < 256) {
-        realloc_size = 256;
-    }
-
-    out_buf = flb_sds_create_size(out_size);
-    if (!out_buf) {
-        flb_errno();
-        return NULL;
-    }
 
     msgpack_unpacked_init(&result);
     ret = msgpack_unpack_next(&result, in_buf, in_size, &off);
     if (ret != MSGPACK_UNPACK_SUCCESS) {
-        flb_sds_destroy(out_buf);
         msgpack_unpacked_destroy(&result);
         return NULL;
     }
 
-    root = &result.data;
-    while (1) {
-        ret = flb_msgpack_to_json(out_buf, out_size, root);
-        if (ret <= 0) {
-            realloc_size *= 2;
-            tmp_buf = flb_sds_increase(out_buf, realloc_size);
-            if (tmp_buf) {
-                out_buf = tmp_buf;
-                out_size = flb_sds_alloc(out_buf);
-            }
-            else {
-                flb_errno();
-                flb_sds_destroy(out_buf);
-                msgpack_unpacked_destroy(&result);
-                return NULL;
-            }
-        }
-        else {
-            break;
-        }
+    out_buf = flb_sds_create_size(out_size);
+    if (!out_buf) {
+        flb_errno();
+        msgpack_unpacked_destroy(&result);
+        return NULL;
     }
 
+    ret = flb_msgpack_to_json_sds(&out_buf, &result.data);
     msgpack_unpacked_destroy(&result);
-    flb_sds_len_set(out_buf, ret);
+
+    if (ret == -1) {
+        flb_sds_destroy(out_buf);
+        return NULL;
+    }
 
     return out_buf;
 }
@@ -878,77 +1598,168 @@ int flb_pack_to_json_date_type(const char *str)
 }
 
 
-static int msgpack_pack_formatted_datetime(flb_sds_t out_buf, char time_formatted[], int max_len,
-                                           msgpack_packer* tmp_pck, struct flb_time* tms,
-                                           const char *date_format,
-                                           const char *time_format)
+/*
+ * The date part of the formatted timestamps (up to the seconds) only
+ * changes once per second, keep the last one around.
+ */
+struct json_date_cache {
+    time_t sec;
+    int len;
+    char buf[40];
+};
+
+static int json_write_formatted_date(flb_sds_t *buf,
+                                     struct json_date_cache *cache,
+                                     struct flb_time *tms,
+                                     const char *date_format, int zulu)
 {
     int len;
-    size_t s;
+    char *p;
+    char *usec;
     struct tm tm;
 
-    gmtime_r(&tms->tm.tv_sec, &tm);
+    if (cache->len == 0 || cache->sec != tms->tm.tv_sec) {
+        if (!gmtime_r(&tms->tm.tv_sec, &tm)) {
+            return -1;
+        }
 
-    s = strftime(time_formatted, max_len,
-                 date_format, &tm);
-    if (!s) {
-        flb_debug("strftime failed in flb_pack_msgpack_to_json_format");
-        return 1;
+        cache->len = strftime(cache->buf, sizeof(cache->buf), date_format, &tm);
+        if (cache->len == 0) {
+            flb_debug("strftime failed in flb_pack_msgpack_to_json_format");
+            return -1;
+        }
+        cache->sec = tms->tm.tv_sec;
     }
 
+    p = json_reserve(buf, cache->len + JSON_NUMBER_MAX + 4);
+    if (!p) {
+        return -1;
+    }
+
+    *p++ = '"';
+    memcpy(p, cache->buf, cache->len);
+    p += cache->len;
+
     /* Format the time, use microsecond precision not nanoseconds */
-    max_len -= s;
-    len = snprintf(&time_formatted[s],
-                    max_len,
-                    time_format,
-                    (uint64_t) tms->tm.tv_nsec / 1000);
-    if (len >= max_len) {
-        flb_debug("snprintf: %d >= %d in flb_pack_msgpack_to_json_format", len, max_len);
-        return 2;
-    }
-    s += len;
-    msgpack_pack_str(tmp_pck, s);
-    msgpack_pack_str_body(tmp_pck, time_formatted, s);
+    *p++ = '.';
+    usec = p;
+    p = json_write_u64(p, (uint64_t) tms->tm.tv_nsec / 1000);
+    len = p - usec;
+    if (len < 6) {
+        memmove(usec + 6 - len, usec, len);
+        memset(usec, '0', 6 - len);
+        p = usec + 6;
+    }
+
+    if (zulu) {
+        *p++ = 'Z';
+    }
+    *p++ = '"';
+    json_commit(*buf, p);
+
     return 0;
 }
 
+static int json_write_date(flb_sds_t *buf, struct json_date_cache *cache,
+                           struct flb_time *tms, int date_format)
+{
+    char *p;
+
+    switch (date_format) {
+    case FLB_PACK_JSON_DATE_DOUBLE:
+        p = json_reserve(buf, JSON_NUMBER_MAX);
+        if (!p) {
+            return -1;
+        }
+        json_commit(*buf, json_write_double(p, flb_time_to_double(tms)));
+        break;
+    case FLB_PACK_JSON_DATE_JAVA_SQL_TIMESTAMP:
+        return json_write_formatted_date(buf, cache, tms,
+                                         FLB_PACK_JSON_DATE_JAVA_SQL_TIMESTAMP_FMT,
+                                         FLB_FALSE);
+    case FLB_PACK_JSON_DATE_ISO8601:
+        return json_write_formatted_date(buf, cache, tms,
+                                         FLB_PACK_JSON_DATE_ISO8601_FMT,
+                                         FLB_TRUE);
+    case FLB_PACK_JSON_DATE_EPOCH:
+        p = json_reserve(buf, JSON_NUMBER_MAX);
+        if (!p) {
+            return -1;
+        }
+        json_commit(*buf,
+                    json_write_u64(p, (long long unsigned)(tms->tm.tv_sec)));
+        break;
+    case FLB_PACK_JSON_DATE_EPOCH_MS:
+        p = json_reserve(buf, JSON_NUMBER_MAX);
+        if (!p) {
+            return -1;
+        }
+        json_commit(*buf, json_write_u64(p, flb_time_to_millisec(tms)));
+        break;
+    }
+
+    return 0;
+}
+
+/*
+ * Write one record as a JSON map. The date key goes first unless the record
+ * has its own key with the same name, which wins like any repeated key.
+ */
+static int json_write_record(flb_sds_t *buf, struct json_date_cache *cache,
+                             struct flb_time *tms, msgpack_object *map,
+                             int date_format, flb_sds_t date_key)
+{
+    int packed = 0;
+    msgpack_object key;
+
+    if (json_write_char(buf, '{') == -1) {
+        return -1;
+    }
+
+    if (date_key != NULL) {
+        key.type = MSGPACK_OBJECT_STR;
+        key.via.str.ptr = date_key;
+        key.via.str.size = flb_sds_len(date_key);
+
+        if (key_exists_in_map(key, *map, 0) == FLB_FALSE) {
+            if (json_write_str(buf, date_key, flb_sds_len(date_key)) == -1 ||
+                json_write_char(buf, ':') == -1 ||
+                json_write_date(buf, cache, tms, date_format) == -1) {
+                return -1;
+            }
+            packed++;
+        }
+    }
+
+    if (msgpack2json_kvs(buf, map, packed) == -1) {
+        return -1;
+    }
+
+    return json_write_char(buf, '}');
+}
+
 flb_sds_t flb_pack_msgpack_to_json_format(const char *data, uint64_t bytes,
                                           int json_format, int date_format,
                                           flb_sds_t date_key)
 {
-    int i;
+    int ret;
     int ok = MSGPACK_UNPACK_SUCCESS;
     int records = 0;
-    int map_size;
     size_t off = 0;
-    char time_formatted[38];
-    flb_sds_t out_tmp;
-    flb_sds_t out_js;
     flb_sds_t out_buf = NULL;
     msgpack_unpacked result;
     msgpack_object root;
     msgpack_object map;
-    msgpack_sbuffer tmp_sbuf;
-    msgpack_packer tmp_pck;
     msgpack_object *obj;
-    msgpack_object *k;
-    msgpack_object *v;
     struct flb_time tms;
+    struct json_date_cache date_cache = {0};
 
-    /* For json lines and streams mode we need a pre-allocated buffer */
-    if (json_format == FLB_PACK_JSON_FORMAT_LINES ||
-        json_format == FLB_PACK_JSON_FORMAT_STREAM) {
-        out_buf = flb_sds_create_size(bytes + bytes / 4);
-        if (!out_buf) {
-            flb_errno();
-            return NULL;
-        }
+    if (json_format != FLB_PACK_JSON_FORMAT_JSON &&
+        json_format != FLB_PACK_JSON_FORMAT_LINES &&
+        json_format != FLB_PACK_JSON_FORMAT_STREAM) {
+        return NULL;
     }
 
-    /* Create temporary msgpack buffer */
-    msgpack_sbuffer_init(&tmp_sbuf);
-    msgpack_packer_init(&tmp_pck, &tmp_sbuf, msgpack_sbuffer_write);
-
     /*
      * If the format is the original msgpack style of one big array,
      * registrate the array, otherwise is not necessary. FYI, original format:
@@ -960,12 +1771,21 @@ flb_sds_t flb_pack_msgpack_to_json_format(const char *data, uint64_t bytes,
      * ]
      */
     if (json_format == FLB_PACK_JSON_FORMAT_JSON) {
-        records = flb_mp_count(data, bytes);
-        if (records <= 0) {
-            msgpack_sbuffer_destroy(&tmp_sbuf);
+        if (flb_mp_count(data, bytes) <= 0) {
             return NULL;
         }
-        msgpack_pack_array(&tmp_pck, records);
+    }
+
+    out_buf = flb_sds_create_size(bytes + bytes / 4);
+    if (!out_buf) {
+        flb_errno();
+        return NULL;
+    }
+
+    if (json_format == FLB_PACK_JSON_FORMAT_JSON &&
+        json_write_char(&out_buf, '[') == -1) {
+        flb_sds_destroy(out_buf);
+        return NULL;
     }
 
     msgpack_unpacked_init(&result);
@@ -987,73 +1807,15 @@ flb_sds_t flb_pack_msgpack_to_json_format(const char *data, uint64_t bytes,
         if (map.type != MSGPACK_OBJECT_MAP) {
             continue;
         }
-        map_size = map.via.map.size;
-
-        if (date_key != NULL) {
-            msgpack_pack_map(&tmp_pck, map_size + 1);
-        }
-        else {
-            msgpack_pack_map(&tmp_pck, map_size);
-        }
-
-        if (date_key != NULL) {
-            /* Append date key */
-            msgpack_pack_str(&tmp_pck, flb_sds_len(date_key));
-            msgpack_pack_str_body(&tmp_pck, date_key, flb_sds_len(date_key));
-
-            /* Append date value */
-            switch (date_format) {
-            case FLB_PACK_JSON_DATE_DOUBLE:
-                msgpack_pack_double(&tmp_pck, flb_time_to_double(&tms));
-                break;
-            case FLB_PACK_JSON_DATE_JAVA_SQL_TIMESTAMP:
-                if (msgpack_pack_formatted_datetime(out_buf, time_formatted, sizeof(time_formatted), &tmp_pck, &tms,
-                                                    FLB_PACK_JSON_DATE_JAVA_SQL_TIMESTAMP_FMT, ".%06" PRIu64)) {
-                    flb_sds_destroy(out_buf);
-                    msgpack_sbuffer_destroy(&tmp_sbuf);
-                    msgpack_unpacked_destroy(&result);
-                    return NULL;
-                }
-                break;
-            case FLB_PACK_JSON_DATE_ISO8601:
-                if (msgpack_pack_formatted_datetime(out_buf, time_formatted, sizeof(time_formatted), &tmp_pck, &tms,
-                                                    FLB_PACK_JSON_DATE_ISO8601_FMT, ".%06" PRIu64 "Z")) {
-                    flb_sds_destroy(out_buf);
-                    msgpack_sbuffer_destroy(&tmp_sbuf);
-                    msgpack_unpacked_destroy(&result);
-                    return NULL;
-                }
-                break;
-            case FLB_PACK_JSON_DATE_EPOCH:
-                msgpack_pack_uint64(&tmp_pck, (long long unsigned)(tms.tm.tv_sec));
-                break;
-            case FLB_PACK_JSON_DATE_EPOCH_MS:
-                msgpack_pack_uint64(&tmp_pck, flb_time_to_millisec(&tms));
-                break;
-            }
-        }
-
-        /* Append remaining keys/values */
-        for (i = 0; i < map_size; i++) {
-            k = &map.via.map.ptr[i].key;
-            v = &map.via.map.ptr[i].val;
-            msgpack_pack_object(&tmp_pck, *k);
-            msgpack_pack_object(&tmp_pck, *v);
-        }
 
         /*
-         * If the format is the original msgpack style, just continue since
-         * we don't care about separator or JSON convertion at this point.
-         */
-        if (json_format == FLB_PACK_JSON_FORMAT_JSON) {
-            continue;
-        }
-
-        /*
-         * Here we handle two types of records concatenation:
+         * Here we handle three types of records concatenation:
          *
-         * FLB_PACK_JSON_FORMAT_LINES: add  breakline (\n) after each record
+         * FLB_PACK_JSON_FORMAT_JSON: records are items of a JSON array
          *
+         *     [{'ts':abc,'k1':1},{'ts':abc,'k1':2},{N}]
+         *
+         * FLB_PACK_JSON_FORMAT_LINES: add  breakline (\n) after each record
          *
          *     {'ts':abc,'k1':1}
          *     {'ts':abc,'k1':2}
@@ -1063,76 +1825,42 @@ flb_sds_t flb_pack_msgpack_to_json_format(const char *data, uint64_t bytes,
          *
          *     {'ts':abc,'k1':1}{'ts':abc,'k1':2}{N}
          */
-        if (json_format == FLB_PACK_JSON_FORMAT_LINES ||
-            json_format == FLB_PACK_JSON_FORMAT_STREAM) {
-
-            /* Encode current record into JSON in a temporary variable */
-            out_js = flb_msgpack_raw_to_json_sds(tmp_sbuf.data, tmp_sbuf.size);
-            if (!out_js) {
-                flb_sds_destroy(out_buf);
-                msgpack_sbuffer_destroy(&tmp_sbuf);
-                msgpack_unpacked_destroy(&result);
-                return NULL;
-            }
-
-            /*
-             * One map record has been converted, now append it to the
-             * outgoing out_buf sds variable.
-             */
-            out_tmp = flb_sds_cat(out_buf, out_js, flb_sds_len(out_js));
-            if (!out_tmp) {
-                flb_sds_destroy(out_js);
-                flb_sds_destroy(out_buf);
-                msgpack_sbuffer_destroy(&tmp_sbuf);
-                msgpack_unpacked_destroy(&result);
-                return NULL;
-            }
+        ret = 0;
+        if (json_format == FLB_PACK_JSON_FORMAT_JSON && records > 0) {
+            ret = json_write_char(&out_buf, ',');
+        }
 
-            /* Release temporary json sds buffer */
-            flb_sds_destroy(out_js);
+        if (ret == 0) {
+            ret = json_write_record(&out_buf, &date_cache, &tms, &map,
+                                    date_format, date_key);
+        }
 
-            /* If a realloc happened, check the returned address */
-            if (out_tmp != out_buf) {
-                out_buf = out_tmp;
-            }
+        if (ret == 0 && json_format == FLB_PACK_JSON_FORMAT_LINES) {
+            ret = json_write_char(&out_buf, '\n');
+        }
 
-            /* Append the breakline only for json lines mode */
-            if (json_format == FLB_PACK_JSON_FORMAT_LINES) {
-                out_tmp = flb_sds_cat(out_buf, "\n", 1);
-                if (!out_tmp) {
-                    flb_sds_destroy(out_buf);
-                    msgpack_sbuffer_destroy(&tmp_sbuf);
-                    msgpack_unpacked_destroy(&result);
-                    return NULL;
-                }
-                if (out_tmp != out_buf) {
-                    out_buf = out_tmp;
-                }
-            }
-            msgpack_sbuffer_clear(&tmp_sbuf);
+        if (ret == -1) {
+            flb_sds_destroy(out_buf);
+            msgpack_unpacked_destroy(&result);
+            return NULL;
         }
+        records++;
     }
 
     /* Release the unpacker */
     msgpack_unpacked_destroy(&result);
 
-    /* Format to JSON */
-    if (json_format == FLB_PACK_JSON_FORMAT_JSON) {
-        out_buf = flb_msgpack_raw_to_json_sds(tmp_sbuf.data, tmp_sbuf.size);
-        msgpack_sbuffer_destroy(&tmp_sbuf);
-
-        if (!out_buf) {
-            return NULL;
-        }
-    }
-    else {
-        msgpack_sbuffer_destroy(&tmp_sbuf);
+    if (records == 0) {
+        flb_sds_destroy(out_buf);
+        return NULL;
     }
 
-    if (out_buf && flb_sds_len(out_buf) == 0) {
+    if (json_format == FLB_PACK_JSON_FORMAT_JSON &&
+        json_write_char(&out_buf, ']') == -1) {
         flb_sds_destroy(out_buf);
         return NULL;
     }
+    out_buf[flb_sds_len(out_buf)] = '\0';
 
     return out_buf;
 }
@@ -1147,8 +1875,9 @@ flb_sds_t flb_pack_msgpack_to_json_format(const char *data, uint64_t bytes,
 char *flb_msgpack_to_json_str(size_t size, const msgpack_object *obj)
 {
     int ret;
-    char *buf = NULL;
-    char *tmp;
+    size_t len;
+    char *buf;
+    flb_sds_t out_buf;
 
     if (obj == NULL) {
         return NULL;
@@ -1158,32 +1887,29 @@ char *flb_msgpack_to_json_str(size_t size, const msgpack_object *obj)
         size = 128;
     }
 
-    buf = flb_malloc(size);
-    if (!buf) {
+    out_buf = flb_sds_create_size(size);
+    if (!out_buf) {
         flb_errno();
         return NULL;
     }
 
-    while (1) {
-        ret = flb_msgpack_to_json(buf, size, obj);
-        if (ret <= 0) {
-            /* buffer is small. retry.*/
-            size *= 2;
-            tmp = flb_realloc(buf, size);
-            if (tmp) {
-                buf = tmp;
-            }
-            else {
-                flb_free(buf);
-                flb_errno();
-                return NULL;
-            }
-        }
-        else {
-            break;
-        }
+    ret = flb_msgpack_to_json_sds(&out_buf, obj);
+    if (ret == -1) {
+        flb_sds_destroy(out_buf);
+        return NULL;
     }
 
+    /* the caller releases the string with flb_free() */
+    len = flb_sds_len(out_buf);
+    buf = flb_malloc(len + 1);
+    if (!buf) {
+        flb_errno();
+        flb_sds_destroy(out_buf);
+        return NULL;
+    }
+    memcpy(buf, out_buf, len + 1);
+    flb_sds_destroy(out_buf);
+
     return buf;
 }
 
@@ -1257,6 +1983,32 @@ int flb_msgpack_expand_map(char *map_data, size_t map_size,
     return 0;
 }
 
+/*
+ * Select the packer used by the flb_pack_json*() functions, the default
+ * one is set at build time (FLB_SIMD). This is meant for tests and
+ * benchmarks, it returns the previous backend or -1 if it's not available.
+ */
+int flb_pack_json_backend_set(int backend)
+{
+    int prev;
+
+    if (backend != FLB_PACK_JSON_BACKEND_JSMN &&
+        backend != FLB_PACK_JSON_BACKEND_SCAN) {
+        return -1;
+    }
+
+#ifndef FLB_HAVE_SIMD
+    if (backend == FLB_PACK_JSON_BACKEND_SCAN) {
+        return -1;
+    }
+#endif
+
+    prev = json_backend;
+    json_backend = backend;
+
+    return prev;
+}
+
 int flb_pack_init(struct flb_config *config)
 {
     int ret;
@@ -28,6 +28,7 @@
 #include <fluent-bit/flb_utils.h>
 #include <fluent-bit/flb_config.h>
 #include <fluent-bit/flb_strptime.h>
+#include <fluent-bit/flb_langinfo.h>
 #include <fluent-bit/flb_env.h>
 #include <fluent-bit/flb_str.h>
 #include <fluent-bit/flb_kv.h>
@@ -41,7 +42,9 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <ctype.h>
 #include <limits.h>
+#include <pthread.h>
 #include <string.h>
 
 static inline uint32_t digits10(uint64_t v) {
@@ -97,6 +100,8 @@ int flb_parser_regex_do(struct flb_parser *parser,
                         void **out_buf, size_t *out_size,
                         struct flb_time *out_time);
 
+int flb_parser_regex_fields_create(struct flb_parser *parser);
+
 int flb_parser_json_do(struct flb_parser *parser,
                        const char *buf, size_t length,
                        void **out_buf, size_t *out_size,
@@ -112,6 +117,14 @@ int flb_parser_logfmt_do(struct flb_parser *parser,
                          void **out_buf, size_t *out_size,
                          struct flb_time *out_time);
 
+/* time_fast flags */
+#define TIME_FAST_FMT     1    /* time_fmt or time_fmt_year */
+#define TIME_FAST_FRAC    2    /* time_frac_secs */
+
+static int time_fast_check(const char *fmt);
+static struct flb_parser_time_cache *time_cache_create();
+static void time_cache_destroy(struct flb_parser_time_cache *cache);
+
 /*
  * This function is used to free all aspects of a parser
  * which is provided by the caller of flb_create_parser.
@@ -140,6 +153,7 @@ static void flb_interim_parser_destroy(struct flb_parser *parser)
     if (parser->time_key) {
         flb_free(parser->time_key);
     }
+    time_cache_destroy(parser->time_cache);
 
     mk_list_del(&parser->_head);
     flb_free(parser);
@@ -313,6 +327,23 @@ struct flb_parser *flb_parser_create(const char *name, const char *format,
             p->time_frac_secs = (tmp + 2);
         }
 
+        /* Built-in decoder and cache of the last timestamp parsed */
+        if (time_fast_check(timeptr)) {
+            p->time_fast |= TIME_FAST_FMT;
+        }
+        if (p->time_frac_secs && time_fast_check(p->time_frac_secs)) {
+            p->time_fast |= TIME_FAST_FRAC;
+        }
+
+        /* '%Z' names depend on the process timezone, don't cache them */
+        if (!strstr(p->time_fmt, "%Z")) {
+            p->time_cache = time_cache_create();
+            if (!p->time_cache) {
+                flb_interim_parser_destroy(p);
+                return NULL;
+            }
+        }
+
         /* 
          * Fall back to the system timezone 
          * if there is no zone parsed from the log.  
@@ -344,6 +375,20 @@ struct flb_parser *flb_parser_create(const char *name, const char *format,
     p->logfmt_no_bare_keys = logfmt_no_bare_keys;
     p->types = types;
     p->types_len = types_len;
+
+    if (p->type == FLB_PARSER_REGEX) {
+        ret = flb_parser_regex_fields_create(p);
+        if (ret == -1) {
+            flb_interim_parser_destroy(p);
+            return NULL;
+        }
+
+        p->native = flb_parser_native_lookup(p);
+        if (p->native) {
+            flb_debug("[parser:%s] using the built-in matcher", name);
+        }
+    }
+
     return p;
 }
 
@@ -354,6 +399,7 @@ void flb_parser_destroy(struct flb_parser *parser)
     if (parser->type == FLB_PARSER_REGEX) {
         flb_regex_destroy(parser->regex);
         flb_free(parser->p_regex);
+        flb_free(parser->fields);
     }
 
     flb_free(parser->name);
@@ -367,6 +413,7 @@ void flb_parser_destroy(struct flb_parser *parser)
     if (parser->time_key) {
         flb_free(parser->time_key);
     }
+    time_cache_destroy(parser->time_cache);
     if (parser->types_len != 0) {
         for (i=0; i<parser->types_len; i++){
             flb_free(parser->types[i].key);
@@ -1081,14 +1128,33 @@ int flb_parser_tzone_offset(const char *str, int len, int *tmdiff)
  */
 static int parse_subseconds(char *str, int len, double *subsec)
 {
+    static const double pow10[] = {
+        1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+    };
     char buf[16];
     char *end;
+    int i;
     int consumed;
     int digits = 9;  /* 1 ns = 000000001 (9 digits) */
+    uint32_t val = 0;
 
     if (len < digits) {
         digits = len;
     }
+
+    /*
+     * Plain digits: both values are exact and the division is correctly
+     * rounded, so it gives the same result as strtod(3). An exponent is
+     * left to it.
+     */
+    for (i = 0; i < digits && str[i] >= '0' && str[i] <= '9'; i++) {
+        val = val * 10 + (str[i] - '0');
+    }
+    if (i > 0 && (i == digits || (str[i] != 'e' && str[i] != 'E'))) {
+        *subsec = val / pow10[i];
+        return i;
+    }
+
     memcpy(buf, "0.", 2);
     memcpy(buf + 2, str, digits);
     buf[digits + 2] = '\0';
@@ -1102,6 +1168,424 @@ static int parse_subseconds(char *str, int len, double *subsec)
     return consumed;
 }
 
+/*
+ * Timestamp cache
+ * ===============
+ * Consecutive records usually carry the same second, the last timestamp
+ * parsed is kept so the next lookup only needs to compare the part of the
+ * string before the subseconds ('key') and the part after them ('suffix').
+ *
+ * The result of flb_strptime() also depends on the fields it does not set,
+ * so the caller 'tm' before parsing is part of the key as well.
+ */
+struct flb_parser_time_cache {
+    pthread_mutex_t lock;
+    int key_len;                /* zero when empty */
+    int suffix_len;
+    char key[64];
+    char suffix[64];
+    struct flb_tm tm_in;
+    struct flb_tm tm;
+};
+
+#define TIME_FIELD_MON    (1 << 0)
+#define TIME_FIELD_MDAY   (1 << 1)
+#define TIME_FIELD_YEAR   (1 << 2)
+
+static const char *time_fast_months[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static const char *time_fast_months_full[] = {
+    "January", "February", "March", "April", "May", "June",
+    "July", "August", "September", "October", "November", "December"
+};
+
+static const int time_fast_mon_days[2][12] = {
+    { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 },
+    { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 }
+};
+
+static int time_fast_leaps(int y)
+{
+    return (y >= 0) ? (y / 4 - y / 100 + y / 400) :
+        -(time_fast_leaps(-(y + 1)) + 1);
+}
+
+/*
+ * Check if a time format only uses the conversions known by the built-in
+ * decoder: %Y %m %d %H %M %S %b %z, literals and white spaces. That covers
+ * ISO8601/RFC3339 ('%Y-%m-%dT%H:%M:%S.%L%z') and the common log format
+ * ('%d/%b/%Y:%H:%M:%S %z').
+ */
+static int time_fast_check(const char *fmt)
+{
+    int i;
+
+    while (*fmt) {
+        if (*fmt != '%') {
+            fmt++;
+            continue;
+        }
+
+        switch (fmt[1]) {
+        case 'b':
+            /* month names come from the locale in flb_strptime() */
+            for (i = 0; i < 12; i++) {
+                if (strcmp(nl_langinfo(ABMON_1 + i), time_fast_months[i]) != 0 ||
+                    strcmp(nl_langinfo(MON_1 + i),
+                           time_fast_months_full[i]) != 0) {
+                    return FLB_FALSE;
+                }
+            }
+            break;
+        case 'Y':
+        case 'm':
+        case 'd':
+        case 'H':
+        case 'M':
+        case 'S':
+        case 'z':
+            break;
+        default:
+            return FLB_FALSE;
+        }
+        fmt += 2;
+    }
+
+    return FLB_TRUE;
+}
+
+/*
+ * Two digits conversion in the [min, max] range. flb_strptime() reads one
+ * or two digits, only the two digits case is handled here and anything
+ * else is left to it.
+ */
+static inline int time_fast_num2(const char **str, int min, int max, int *out)
+{
+    const char *s = *str;
+    int val;
+
+    if (s[0] < '0' || s[0] > '9' || s[1] < '0' || s[1] > '9') {
+        return -1;
+    }
+
+    val = (s[0] - '0') * 10 + (s[1] - '0');
+    if (val < min || val > max) {
+        return -1;
+    }
+
+    *out = val;
+    *str = s + 2;
+    return 0;
+}
+
+/* '%z' as read by flb_strptime(), only 'Z' and numeric offsets */
+static const char *time_fast_zone(const char *s, struct flb_tm *tm)
+{
+    int neg = 0;
+    int offs;
+
+    while (isspace((unsigned char) *s)) {
+        s++;
+    }
+
+    if (*s == 'Z') {
+        tm->tm.tm_isdst = 0;
+        flb_tm_gmtoff(tm) = 0;
+        return s + 1;
+    }
+    else if (*s == '-') {
+        neg = 1;
+    }
+    else if (*s != '+') {
+        return NULL;
+    }
+    s++;
+
+    if (!isdigit((unsigned char) s[0]) || !isdigit((unsigned char) s[1])) {
+        return NULL;
+    }
+    offs = ((s[0] - '0') * 10 + (s[1] - '0')) * 3600;
+    s += 2;
+
+    if (*s == ':') {
+        s++;
+    }
+    if (isdigit((unsigned char) *s)) {
+        offs += (*s++ - '0') * 10 * 60;
+        if (!isdigit((unsigned char) *s)) {
+            return NULL;
+        }
+        offs += (*s++ - '0') * 60;
+    }
+
+    tm->tm.tm_isdst = 0;
+    flb_tm_gmtoff(tm) = neg ? -offs : offs;
+    return s;
+}
+
+/*
+ * Built-in decoder for the formats accepted by time_fast_check(). It fills
+ * the same fields flb_strptime() does, or returns NULL when the input is
+ * not in its canonical form so the caller can fall back to flb_strptime().
+ */
+static const char *time_fast_decode(const char *s, const char *fmt,
+                                    struct flb_tm *tm)
+{
+    int i;
+    int val;
+    int year;
+    int fields = 0;
+    const int *mon_days;
+
+    while (*fmt) {
+        if (isspace((unsigned char) *fmt)) {
+            while (isspace((unsigned char) *s)) {
+                s++;
+            }
+            fmt++;
+            continue;
+        }
+
+        if (*s == '\0') {
+            return NULL;
+        }
+
+        if (*fmt != '%') {
+            if (*s != *fmt) {
+                return NULL;
+            }
+            s++;
+            fmt++;
+            continue;
+        }
+
+        switch (fmt[1]) {
+        case 'Y':
+            for (i = 0, val = 0; i < 4; i++) {
+                if (s[i] < '0' || s[i] > '9') {
+                    return NULL;
+                }
+                val = val * 10 + (s[i] - '0');
+            }
+            s += 4;
+            tm->tm.tm_year = val - 1900;
+            fields |= TIME_FIELD_YEAR;
+            break;
+        case 'm':
+            if (time_fast_num2(&s, 1, 12, &val) == -1) {
+                return NULL;
+            }
+            tm->tm.tm_mon = val - 1;
+            fields |= TIME_FIELD_MON;
+            break;
+        case 'b':
+            for (i = 0; i < 12; i++) {
+                if (strncasecmp(s, time_fast_months[i], 3) == 0) {
+                    break;
+                }
+            }
+            /* a longer name can match a full month name */
+            if (i == 12 || isalpha((unsigned char) s[3])) {
+                return NULL;
+            }
+            s += 3;
+            tm->tm.tm_mon = i;
+            fields |= TIME_FIELD_MON;
+            break;
+        case 'd':
+            if (time_fast_num2(&s, 1, 31, &tm->tm.tm_mday) == -1) {
+                return NULL;
+            }
+            fields |= TIME_FIELD_MDAY;
+            break;
+        case 'H':
+            if (time_fast_num2(&s, 0, 23, &tm->tm.tm_hour) == -1) {
+                return NULL;
+            }
+            break;
+        case 'M':
+            if (time_fast_num2(&s, 0, 59, &tm->tm.tm_min) == -1) {
+                return NULL;
+            }
+            break;
+        case 'S':
+            if (time_fast_num2(&s, 0, 60, &tm->tm.tm_sec) == -1) {
+                return NULL;
+            }
+            break;
+        case 'z':
+            s = time_fast_zone(s, tm);
+            if (!s) {
+                return NULL;
+            }
+            break;
+        default:
+            return NULL;
+        }
+        fmt += 2;
+    }
+
+    /* day of the year and of the week, as computed by flb_strptime() */
+    if (fields == (TIME_FIELD_YEAR | TIME_FIELD_MON | TIME_FIELD_MDAY)) {
+        year = tm->tm.tm_year + 1900;
+        mon_days = time_fast_mon_days[(year % 4 == 0 &&
+                                       (year % 100 != 0 || year % 400 == 0))];
+
+        tm->tm.tm_yday = tm->tm.tm_mday - 1;
+        for (i = 0; i < tm->tm.tm_mon; i++) {
+            tm->tm.tm_yday += mon_days[i];
+        }
+
+        tm->tm.tm_wday = 4 + ((year - 1970) % 7) * (365 % 7) +
+                         time_fast_leaps(year - 1) - time_fast_leaps(1969) +
+                         tm->tm.tm_yday;
+        tm->tm.tm_wday %= 7;
+        if (tm->tm.tm_wday < 0) {
+            tm->tm.tm_wday += 7;
+        }
+    }
+
+    return s;
+}
+
+/* flb_strptime() with the built-in decoder first when the format allows it */
+static char *time_strptime(const char *s, const char *fmt, int fast,
+                           struct flb_tm *tm)
+{
+    const char *p;
+    struct flb_tm out;
+
+    if (fast) {
+        out = *tm;
+        p = time_fast_decode(s, fmt, &out);
+        if (p) {
+            *tm = out;
+            return (char *) p;
+        }
+    }
+
+    return flb_strptime(s, fmt, tm);
+}
+
+static int time_tm_equal(const struct flb_tm *a, const struct flb_tm *b)
+{
+    return a->tm.tm_sec == b->tm.tm_sec &&
+           a->tm.tm_min == b->tm.tm_min &&
+           a->tm.tm_hour == b->tm.tm_hour &&
+           a->tm.tm_mday == b->tm.tm_mday &&
+           a->tm.tm_mon == b->tm.tm_mon &&
+           a->tm.tm_year == b->tm.tm_year &&
+           a->tm.tm_wday == b->tm.tm_wday &&
+           a->tm.tm_yday == b->tm.tm_yday &&
+           a->tm.tm_isdst == b->tm.tm_isdst &&
+           flb_tm_gmtoff(a) == flb_tm_gmtoff(b);
+}
+
+static struct flb_parser_time_cache *time_cache_create()
+{
+    struct flb_parser_time_cache *cache;
+
+    cache = flb_calloc(1, sizeof(struct flb_parser_time_cache));
+    if (!cache) {
+        flb_errno();
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return cache;
+}
+
+static void time_cache_destroy(struct flb_parser_time_cache *cache)
+{
+    if (!cache) {
+        return;
+    }
+    pthread_mutex_destroy(&cache->lock);
+    flb_free(cache);
+}
+
+/*
+ * Lookup the time string in the cache, it's a hit when the key matches and
+ * for subseconds formats, it's followed by digits and the same suffix. The
+ * cache is skipped when another thread holds it.
+ */
+static int time_cache_get(struct flb_parser *parser,
+                          const char *str, int len,
+                          struct flb_tm *tm, double *ns)
+{
+    int ret = -1;
+    int n;
+    const char *p;
+    struct flb_parser_time_cache *cache = parser->time_cache;
+
+    if (pthread_mutex_trylock(&cache->lock) != 0) {
+        return -1;
+    }
+
+    if (cache->key_len == 0 || len < cache->key_len ||
+        memcmp(str, cache->key, cache->key_len) != 0 ||
+        !time_tm_equal(tm, &cache->tm_in)) {
+        goto out;
+    }
+
+    if (!parser->time_frac_secs) {
+        if (len == cache->key_len) {
+            *tm = cache->tm;
+            ret = 0;
+        }
+        goto out;
+    }
+
+    p = str + cache->key_len;
+    if (!isdigit((unsigned char) *p)) {
+        goto out;
+    }
+
+    n = parse_subseconds((char *) p, len - cache->key_len, ns);
+    if (n < 0) {
+        *ns = 0;
+        goto out;
+    }
+    p += n;
+
+    if (str + len - p != cache->suffix_len ||
+        memcmp(p, cache->suffix, cache->suffix_len) != 0) {
+        *ns = 0;
+        goto out;
+    }
+
+    *tm = cache->tm;
+    ret = 0;
+
+out:
+    pthread_mutex_unlock(&cache->lock);
+    return ret;
+}
+
+static void time_cache_set(struct flb_parser *parser,
+                           const char *key, int key_len,
+                           const char *suffix, int suffix_len,
+                           struct flb_tm *tm_in, struct flb_tm *tm)
+{
+    struct flb_parser_time_cache *cache = parser->time_cache;
+
+    if (pthread_mutex_trylock(&cache->lock) != 0) {
+        return;
+    }
+
+    memcpy(cache->key, key, key_len);
+    memcpy(cache->suffix, suffix, suffix_len);
+    cache->key_len = key_len;
+    cache->suffix_len = suffix_len;
+    cache->tm_in = *tm_in;
+    cache->tm = *tm;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
 int flb_parser_time_lookup(const char *time_str, size_t tsize,
                            time_t now,
                            struct flb_parser *parser,
@@ -1111,10 +1595,13 @@ int flb_parser_time_lookup(const char *time_str, size_t tsize,
     time_t time_now;
     char *p = NULL;
     char *fmt;
+    char *key_end;
+    char *suffix;
     int time_len = tsize;
     const char *time_ptr = time_str;
     char tmp[64];
     struct tm tmy;
+    struct flb_tm tm_in;
 
     *ns = 0;
 
@@ -1164,7 +1651,7 @@ int flb_parser_time_lookup(const char *time_str, size_t tsize,
 
         time_ptr = tmp;
         time_len = strlen(tmp);
-        p = flb_strptime(time_ptr, parser->time_fmt_year, tm);
+        fmt = parser->time_fmt_year;
     }
     else {
         /*
@@ -1179,10 +1666,17 @@ int flb_parser_time_lookup(const char *time_str, size_t tsize,
         tmp[time_len] = '\0';
         time_ptr = tmp;
         time_len = strlen(tmp);
+        fmt = parser->time_fmt;
+    }
 
-        p = flb_strptime(time_ptr, parser->time_fmt, tm);
+    if (parser->time_cache) {
+        if (time_cache_get(parser, time_ptr, time_len, tm, ns) == 0) {
+            goto time_offset;
+        }
+        tm_in = *tm;
     }
 
+    p = time_strptime(time_ptr, fmt, parser->time_fast & TIME_FAST_FMT, tm);
     if (p == NULL) {
         if (parser->time_strict) {
             flb_error("[parser] cannot parse '%.*s'", (int)tsize, time_str);
@@ -1191,6 +1685,7 @@ int flb_parser_time_lookup(const char *time_str, size_t tsize,
         flb_debug("[parser] non-exact match '%.*s'", (int)tsize, time_str);
         return 0;
     }
+    key_end = p;
 
     if (parser->time_frac_secs) {
         ret = parse_subseconds(p, time_len - (p - time_ptr), ns);
@@ -1203,9 +1698,11 @@ int flb_parser_time_lookup(const char *time_str, size_t tsize,
             return 0;
         }
         p += ret;
+        suffix = p;
 
         /* Parse the remaining part after %L */
-        p = flb_strptime(p, parser->time_frac_secs, tm);
+        p = time_strptime(p, parser->time_frac_secs,
+                          parser->time_fast & TIME_FAST_FRAC, tm);
         if (p == NULL) {
             if (parser->time_strict) {
                 flb_error("[parser] cannot parse '%.*s' after %%L", (int)tsize, time_str);
@@ -1214,8 +1711,20 @@ int flb_parser_time_lookup(const char *time_str, size_t tsize,
             flb_debug("[parser] non-exact match after %%L '%.*s'", (int)tsize, time_str);
             return 0;
         }
+
+        /* the subseconds must start with a digit to be matched later */
+        if (parser->time_cache && isdigit((unsigned char) *key_end)) {
+            time_cache_set(parser, time_ptr, key_end - time_ptr,
+                           suffix, time_len - (suffix - time_ptr),
+                           &tm_in, tm);
+        }
+    }
+    else if (parser->time_cache) {
+        time_cache_set(parser, time_ptr, time_len, time_ptr + time_len, 0,
+                       &tm_in, tm);
     }
 
+time_offset:
     if (parser->time_with_tz == FLB_FALSE) {
         flb_tm_gmtoff(tm) = parser->time_offset;
     }
@@ -1223,6 +1732,28 @@ int flb_parser_time_lookup(const char *time_str, size_t tsize,
     return 0;
 }
 
+/*
+ * Numbers are converted from a NULL terminated copy of the value, short
+ * values use the caller buffer instead of a heap copy.
+ */
+static char *typecast_str(const char *val, int val_len, char *buf, size_t size)
+{
+    if (val_len >= size) {
+        return flb_strndup(val, val_len);
+    }
+
+    memcpy(buf, val, val_len);
+    buf[val_len] = '\0';
+    return buf;
+}
+
+static void typecast_str_release(char *str, char *buf)
+{
+    if (str != buf) {
+        flb_free(str);
+    }
+}
+
 int flb_parser_typecast(const char *key, int key_len,
                         const char *val, int val_len,
                         msgpack_packer *pck,
@@ -1232,6 +1763,7 @@ int flb_parser_typecast(const char *key, int key_len,
     int i;
     int error = FLB_FALSE;
     char *tmp_str;
+    char tmp[64];
     int casted = FLB_FALSE;
 
     for(i=0; i<types_len; i++){
@@ -1252,18 +1784,18 @@ int flb_parser_typecast(const char *key, int key_len,
                     /* msgpack char is not null terminated.
                        So make a temporary copy.
                      */
-                    tmp_str = flb_strndup(val, val_len);
+                    tmp_str = typecast_str(val, val_len, tmp, sizeof(tmp));
                     lval = atoll(tmp_str);
-                    flb_free(tmp_str);
+                    typecast_str_release(tmp_str, tmp);
                     msgpack_pack_int64(pck, lval);
                 }
                 break;
             case FLB_PARSER_TYPE_HEX:
                 {
                     unsigned long long lval;
-                    tmp_str = flb_strndup(val, val_len);
+                    tmp_str = typecast_str(val, val_len, tmp, sizeof(tmp));
                     lval = strtoull(tmp_str, NULL, 16);
-                    flb_free(tmp_str);
+                    typecast_str_release(tmp_str, tmp);
                     msgpack_pack_uint64(pck, lval);
                 }
                 break;
@@ -1271,9 +1803,9 @@ int flb_parser_typecast(const char *key, int key_len,
             case FLB_PARSER_TYPE_FLOAT:
                 {
                     double dval;
-                    tmp_str = flb_strndup(val, val_len);
+                    tmp_str = typecast_str(val, val_len, tmp, sizeof(tmp));
                     dval = atof(tmp_str);
-                    flb_free(tmp_str);
+                    typecast_str_release(tmp_str, tmp);
                     msgpack_pack_double(pck, dval);
                 }
                 break;
@@ -0,0 +1,870 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_parser.h>
+#include <fluent-bit/flb_regex.h>
+#include <fluent-bit/flb_simd.h>
+
+#include <string.h>
+
+/*
+ * Built-in matchers for the regular expressions shipped in conf/parsers.conf.
+ *
+ * When a regex parser is created with one of the patterns below, records
+ * are tokenized by hand instead of running the regex engine. Each matcher
+ * follows the same backtracking order the engine uses for its pattern, so
+ * the captured groups are the same ones the regex would report.
+ *
+ * The character classes used by these patterns only involve ASCII bytes, so
+ * working on bytes is equivalent to working on characters as long as the
+ * line is valid UTF-8. Lines with invalid UTF-8 or a line break (where '^'
+ * and '$' can match in the middle of the buffer) are left to the engine.
+ */
+
+enum {
+    NATIVE_NONE = 0,
+    NATIVE_APACHE,
+    NATIVE_APACHE2,
+    NATIVE_NGINX,
+    NATIVE_DOCKER_DAEMON,
+    NATIVE_SYSLOG_RFC5424,
+    NATIVE_SYSLOG_RFC3164_LOCAL,
+    NATIVE_SYSLOG_RFC3164,
+    NATIVE_CRI
+};
+
+/* referer and agent group of the access log formats */
+#define TAIL_OPTIONAL      1   /* optional, line must end after it */
+#define TAIL_OPTIONAL_ANY  2   /* optional, agent is '.*' */
+#define TAIL_REQUIRED      3   /* required, anything can follow */
+
+struct native_match {
+    const char *s;
+    size_t n;
+    ptrdiff_t *beg;
+    ptrdiff_t *end;
+};
+
+struct native_pattern {
+    int id;
+    const char *regex;
+    const char *groups[FLB_PARSER_NATIVE_GROUPS];
+};
+
+static struct native_pattern native_patterns[] = {
+    {
+        NATIVE_APACHE,
+        "^(?<host>[^ ]*) [^ ]* (?<user>[^ ]*) \\[(?<time>[^\\]]*)\\] \"(?<method>\\S+)"
+        "(?: +(?<path>[^\\\"]*?)(?: +\\S*)?)?\" (?<code>[^ ]*) (?<size>[^ ]*)"
+        "(?: \"(?<referer>[^\\\"]*)\" \"(?<agent>[^\\\"]*)\")?$",
+        {"host", "user", "time", "method", "path", "code", "size",
+         "referer", "agent"}
+    },
+    {
+        NATIVE_APACHE2,
+        "^(?<host>[^ ]*) [^ ]* (?<user>[^ ]*) \\[(?<time>[^\\]]*)\\] \"(?<method>\\S+)"
+        "(?: +(?<path>[^ ]*) +\\S*)?\" (?<code>[^ ]*) (?<size>[^ ]*)"
+        "(?: \"(?<referer>[^\\\"]*)\" \"(?<agent>.*)\")?$",
+        {"host", "user", "time", "method", "path", "code", "size",
+         "referer", "agent"}
+    },
+    {
+        NATIVE_NGINX,
+        "^(?<remote>[^ ]*) (?<host>[^ ]*) (?<user>[^ ]*) \\[(?<time>[^\\]]*)\\] "
+        "\"(?<method>\\S+)(?: +(?<path>[^\\\"]*?)(?: +\\S*)?)?\" (?<code>[^ ]*) "
+        "(?<size>[^ ]*)(?: \"(?<referer>[^\\\"]*)\" \"(?<agent>[^\\\"]*)\")",
+        {"remote", "host", "user", "time", "method", "path", "code", "size",
+         "referer", "agent"}
+    },
+    {
+        NATIVE_DOCKER_DAEMON,
+        "time=\"(?<time>[^ ]*)\" level=(?<level>[^ ]*) msg=\"(?<msg>[^ ].*)\"",
+        {"time", "level", "msg"}
+    },
+    {
+        NATIVE_SYSLOG_RFC5424,
+        "^\\<(?<pri>[0-9]{1,5})\\>1 (?<time>[^ ]+) (?<host>[^ ]+) (?<ident>[^ ]+) "
+        "(?<pid>[-0-9]+) (?<msgid>[^ ]+) (?<extradata>(\\[(.*?)\\]|-)) (?<message>.+)$",
+        {"pri", "time", "host", "ident", "pid", "msgid", "extradata", "message"}
+    },
+    {
+        NATIVE_SYSLOG_RFC3164_LOCAL,
+        "^\\<(?<pri>[0-9]+)\\>(?<time>[^ ]* {1,2}[^ ]* [^ ]*) "
+        "(?<ident>[a-zA-Z0-9_\\/\\.\\-]*)(?:\\[(?<pid>[0-9]+)\\])?(?:[^\\:]*\\:)? "
+        "*(?<message>.*)$",
+        {"pri", "time", "ident", "pid", "message"}
+    },
+    {
+        NATIVE_SYSLOG_RFC3164,
+        "/^\\<(?<pri>[0-9]+)\\>(?<time>[^ ]* {1,2}[^ ]* [^ ]*) (?<host>[^ ]*) "
+        "(?<ident>[a-zA-Z0-9_\\/\\.\\-]*)(?:\\[(?<pid>[0-9]+)\\])?(?:[^\\:]*\\:)? "
+        "*(?<message>.*)$/",
+        {"pri", "time", "host", "ident", "pid", "message"}
+    },
+    {
+        NATIVE_CRI,
+        "^(?<time>[^ ]+) (?<stream>stdout|stderr) (?<logtag>[^ ]*) (?<message>.*)$",
+        {"time", "stream", "logtag", "message"}
+    },
+    { NATIVE_NONE, NULL, {NULL} }
+};
+
+/* Regex '\s' with the ASCII range option used by the Ruby syntax */
+static inline int is_space(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline int is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/* [a-zA-Z0-9_\/\.\-] */
+static inline int is_ident(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c) ||
+           c == '_' || c == '/' || c == '.' || c == '-';
+}
+
+/* Position of the first 'c' from 'i', or 'n' */
+static inline size_t span_until(const char *s, size_t n, size_t i, char c)
+{
+    const char *p;
+
+    if (i >= n) {
+        return n;
+    }
+
+    p = memchr(s + i, c, n - i);
+    if (!p) {
+        return n;
+    }
+    return p - s;
+}
+
+/* Position after the run of 'c' starting at 'i' */
+static inline size_t span_char(const char *s, size_t n, size_t i, char c)
+{
+    while (i < n && s[i] == c) {
+        i++;
+    }
+    return i;
+}
+
+static inline size_t span_non_space(const char *s, size_t n, size_t i)
+{
+    while (i < n && !is_space(s[i])) {
+        i++;
+    }
+    return i;
+}
+
+static inline size_t span_digits(const char *s, size_t n, size_t i)
+{
+    while (i < n && is_digit(s[i])) {
+        i++;
+    }
+    return i;
+}
+
+static inline void capture(struct native_match *m, int group,
+                           size_t beg, size_t end)
+{
+    m->beg[group] = beg;
+    m->end[group] = end;
+}
+
+static inline void capture_unset(struct native_match *m, int group)
+{
+    m->beg[group] = -1;
+    m->end[group] = -1;
+}
+
+/* Lines the matchers can handle: valid UTF-8 without line breaks */
+static int line_check(const char *s, size_t n)
+{
+    size_t i = 0;
+    int len;
+    unsigned char c;
+#ifndef FLB_SIMD_NONE
+    flb_vector8 v;
+    flb_vector8 nl = flb_vector8_broadcast('\n');
+
+    for (; i + FLB_VECTOR8_SIZE <= n; i += FLB_VECTOR8_SIZE) {
+        v = flb_vector8_load(s + i);
+        if (flb_vector8_mask(flb_vector8_or(v, flb_vector8_eq(v, nl)))) {
+            break;
+        }
+    }
+#endif
+
+    while (i < n) {
+        c = s[i];
+        if (c < 0x80) {
+            if (c == '\n') {
+                return -1;
+            }
+            i++;
+            continue;
+        }
+
+        if (c >= 0xc2 && c <= 0xdf) {
+            len = 2;
+        }
+        else if (c >= 0xe0 && c <= 0xef) {
+            len = 3;
+        }
+        else if (c >= 0xf0 && c <= 0xf4) {
+            len = 4;
+        }
+        else {
+            return -1;
+        }
+
+        if (i + len > n) {
+            return -1;
+        }
+        for (i++, len--; len > 0; i++, len--) {
+            if (((unsigned char) s[i] & 0xc0) != 0x80) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Access log tail starting at 'x', 'g' is the index of the code group:
+ *
+ *   " (?<code>[^ ]*) (?<size>[^ ]*)(?: "(?<referer>[^"]*)" "(?<agent>...)")
+ *
+ * Every sub expression can only stop at one place, so there is nothing to
+ * backtrack into.
+ */
+static int tail_match(struct native_match *m, size_t x, int g, int mode)
+{
+    int present = FLB_FALSE;
+    size_t code_end;
+    size_t size;
+    size_t size_end;
+    size_t referer;
+    size_t referer_end = 0;
+    size_t agent = 0;
+    size_t agent_end = 0;
+    const char *s = m->s;
+    size_t n = m->n;
+
+    if (x + 1 >= n || s[x] != '"' || s[x + 1] != ' ') {
+        return -1;
+    }
+
+    code_end = span_until(s, n, x + 2, ' ');
+    if (code_end >= n) {
+        return -1;
+    }
+
+    size = code_end + 1;
+    size_end = span_until(s, n, size, ' ');
+
+    if (size_end + 1 < n && s[size_end + 1] == '"') {
+        referer = size_end + 2;
+        referer_end = span_until(s, n, referer, '"');
+
+        if (referer_end + 2 < n &&
+            s[referer_end + 1] == ' ' && s[referer_end + 2] == '"') {
+            agent = referer_end + 3;
+
+            if (mode == TAIL_OPTIONAL_ANY) {
+                if (n > agent && s[n - 1] == '"') {
+                    agent_end = n - 1;
+                    present = FLB_TRUE;
+                }
+            }
+            else {
+                agent_end = span_until(s, n, agent, '"');
+                if (agent_end < n &&
+                    (mode == TAIL_REQUIRED || agent_end + 1 == n)) {
+                    present = FLB_TRUE;
+                }
+            }
+        }
+    }
+
+    if (present) {
+        capture(m, g + 2, size_end + 2, referer_end);
+        capture(m, g + 3, agent, agent_end);
+    }
+    else if (mode == TAIL_REQUIRED || size_end != n) {
+        return -1;
+    }
+    else {
+        capture_unset(m, g + 2);
+        capture_unset(m, g + 3);
+    }
+
+    capture(m, g, x + 2, code_end);
+    capture(m, g + 1, size, size_end);
+
+    return 0;
+}
+
+/*
+ * Request line of apache and nginx, 'g' is the index of the method group:
+ *
+ *   "(?<method>\S+)(?: +(?<path>[^"]*?)(?: +\S*)?)?" + tail
+ */
+static int request_lazy_match(struct native_match *m, size_t b, int g, int mode)
+{
+    size_t e;
+    size_t p;
+    size_t pe;
+    size_t q;
+    size_t r;
+    size_t method_end;
+    size_t spaces_end;
+    size_t inner_end;
+    size_t token_end;
+    const char *s = m->s;
+    size_t n = m->n;
+
+    method_end = span_non_space(s, n, b);
+
+    for (e = method_end; e > b; e--) {
+        spaces_end = span_char(s, n, e, ' ');
+
+        for (p = spaces_end; p > e; p--) {
+            /* the path grows one character at a time */
+            for (pe = p; ; pe++) {
+                inner_end = span_char(s, n, pe, ' ');
+                for (q = inner_end; q > pe; q--) {
+                    token_end = span_non_space(s, n, q);
+                    for (r = token_end + 1; r > q; r--) {
+                        if (tail_match(m, r - 1, g + 2, mode) == 0) {
+                            capture(m, g, b, e);
+                            capture(m, g + 1, p, pe);
+                            return 0;
+                        }
+                    }
+                }
+
+                if (tail_match(m, pe, g + 2, mode) == 0) {
+                    capture(m, g, b, e);
+                    capture(m, g + 1, p, pe);
+                    return 0;
+                }
+
+                if (pe >= n || s[pe] == '"') {
+                    break;
+                }
+            }
+        }
+
+        if (tail_match(m, e, g + 2, mode) == 0) {
+            capture(m, g, b, e);
+            capture_unset(m, g + 1);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Request line of apache2:
+ *
+ *   "(?<method>\S+)(?: +(?<path>[^ ]*) +\S*)?" + tail
+ */
+static int request_token_match(struct native_match *m, size_t b, int g, int mode)
+{
+    size_t e;
+    size_t p;
+    size_t pe;
+    size_t q;
+    size_t r;
+    size_t method_end;
+    size_t spaces_end;
+    size_t path_end;
+    size_t inner_end;
+    size_t token_end;
+    const char *s = m->s;
+    size_t n = m->n;
+
+    method_end = span_non_space(s, n, b);
+
+    for (e = method_end; e > b; e--) {
+        spaces_end = span_char(s, n, e, ' ');
+
+        for (p = spaces_end; p > e; p--) {
+            path_end = span_until(s, n, p, ' ');
+
+            for (pe = path_end + 1; pe > p; pe--) {
+                inner_end = span_char(s, n, pe - 1, ' ');
+                for (q = inner_end; q > pe - 1; q--) {
+                    token_end = span_non_space(s, n, q);
+                    for (r = token_end + 1; r > q; r--) {
+                        if (tail_match(m, r - 1, g + 2, mode) == 0) {
+                            capture(m, g, b, e);
+                            capture(m, g + 1, p, pe - 1);
+                            return 0;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (tail_match(m, e, g + 2, mode) == 0) {
+            capture(m, g, b, e);
+            capture_unset(m, g + 1);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Leading space separated fields and the bracketed time of the access logs,
+ * returns the position after '"' or -1:
+ *
+ *   ^(?<a>[^ ]*) (?<b>[^ ]*) (?<c>[^ ]*) \[(?<time>[^\]]*)\] "
+ *
+ * Groups set to -1 in 'groups' are matched but not captured.
+ */
+static ssize_t access_head_match(struct native_match *m, int *groups)
+{
+    int i;
+    size_t p = 0;
+    size_t e;
+    const char *s = m->s;
+    size_t n = m->n;
+
+    for (i = 0; i < 3; i++) {
+        e = span_until(s, n, p, ' ');
+        if (e >= n) {
+            return -1;
+        }
+        if (groups[i] > 0) {
+            capture(m, groups[i], p, e);
+        }
+        p = e + 1;
+    }
+
+    if (p >= n || s[p] != '[') {
+        return -1;
+    }
+
+    e = span_until(s, n, p + 1, ']');
+    if (e + 2 >= n || s[e + 1] != ' ' || s[e + 2] != '"') {
+        return -1;
+    }
+    capture(m, groups[3], p + 1, e);
+
+    return e + 3;
+}
+
+static int apache_match(struct native_match *m, int id)
+{
+    ssize_t p;
+    int groups[] = {1, -1, 2, 3};
+
+    p = access_head_match(m, groups);
+    if (p == -1) {
+        return -1;
+    }
+
+    if (id == NATIVE_APACHE2) {
+        return request_token_match(m, p, 4, TAIL_OPTIONAL_ANY);
+    }
+    return request_lazy_match(m, p, 4, TAIL_OPTIONAL);
+}
+
+static int nginx_match(struct native_match *m)
+{
+    ssize_t p;
+    int groups[] = {1, 2, 3, 4};
+
+    p = access_head_match(m, groups);
+    if (p == -1) {
+        return -1;
+    }
+
+    return request_lazy_match(m, p, 5, TAIL_REQUIRED);
+}
+
+/*
+ * time="(?<time>[^ ]*)" level=(?<level>[^ ]*) msg="(?<msg>[^ ].*)"
+ *
+ * The pattern is not anchored, every occurrence of 'time="' is tried from
+ * the left.
+ */
+static int docker_daemon_match(struct native_match *m)
+{
+    size_t i = 0;
+    size_t t;
+    size_t r;
+    size_t l;
+    size_t le;
+    size_t msg;
+    size_t q;
+    const char *s = m->s;
+    size_t n = m->n;
+
+    while (n >= 6 && i <= n - 6) {
+        i = span_until(s, n - 5, i, 't');
+        if (i > n - 6) {
+            break;
+        }
+        if (memcmp(s + i, "time=\"", 6) != 0) {
+            i++;
+            continue;
+        }
+
+        /* the time value must end with the quote right before the space */
+        t = i + 6;
+        r = span_until(s, n, t, ' ');
+        if (r > t && n - r >= 7 && s[r - 1] == '"' &&
+            memcmp(s + r, " level=", 7) == 0) {
+
+            l = r + 7;
+            le = span_until(s, n, l, ' ');
+            if (n - le >= 6 && memcmp(s + le, " msg=\"", 6) == 0) {
+                msg = le + 6;
+
+                /* msg runs up to the last quote */
+                if (msg < n && s[msg] != ' ') {
+                    for (q = n - 1; q > msg; q--) {
+                        if (s[q] == '"') {
+                            capture(m, 1, t, r - 1);
+                            capture(m, 2, l, le);
+                            capture(m, 3, msg, q);
+                            return 0;
+                        }
+                    }
+                }
+            }
+        }
+        i++;
+    }
+
+    return -1;
+}
+
+/* '[^ ]+ ' fields, returns the position after the space or -1 */
+static ssize_t field_match(struct native_match *m, size_t p, int group)
+{
+    size_t e;
+
+    e = span_until(m->s, m->n, p, ' ');
+    if (e == p || e >= m->n) {
+        return -1;
+    }
+    capture(m, group, p, e);
+
+    return e + 1;
+}
+
+static int syslog_rfc5424_match(struct native_match *m)
+{
+    int i;
+    ssize_t p;
+    size_t e;
+    size_t c;
+    const char *s = m->s;
+    size_t n = m->n;
+
+    /* ^\<(?<pri>[0-9]{1,5})\>1 */
+    if (n < 1 || s[0] != '<') {
+        return -1;
+    }
+    e = span_digits(s, n, 1);
+    if (e == 1 || e - 1 > 5 || e + 2 >= n ||
+        s[e] != '>' || s[e + 1] != '1' || s[e + 2] != ' ') {
+        return -1;
+    }
+    capture(m, 1, 1, e);
+    p = e + 3;
+
+    /* time, host and ident */
+    for (i = 2; i <= 4; i++) {
+        p = field_match(m, p, i);
+        if (p == -1) {
+            return -1;
+        }
+    }
+
+    /* (?<pid>[-0-9]+) */
+    e = p;
+    while (e < n && (is_digit(s[e]) || s[e] == '-')) {
+        e++;
+    }
+    if (e == p || e >= n || s[e] != ' ') {
+        return -1;
+    }
+    capture(m, 5, p, e);
+
+    p = field_match(m, e + 1, 6);
+    if (p == -1) {
+        return -1;
+    }
+
+    /* (?<extradata>(\[(.*?)\]|-)) (?<message>.+)$ */
+    if (p < n && s[p] == '[') {
+        for (c = p + 1; ; c++) {
+            c = span_until(s, n, c, ']');
+            if (c + 2 >= n) {
+                return -1;
+            }
+            if (s[c + 1] == ' ') {
+                break;
+            }
+        }
+        capture(m, 7, p, c + 1);
+        capture(m, 8, c + 2, n);
+        return 0;
+    }
+    else if (p < n && s[p] == '-') {
+        if (p + 2 >= n || s[p + 1] != ' ') {
+            return -1;
+        }
+        capture(m, 7, p, p + 1);
+        capture(m, 8, p + 2, n);
+        return 0;
+    }
+
+    return -1;
+}
+
+/*
+ * ^\<(?<pri>[0-9]+)\>(?<time>[^ ]* {1,2}[^ ]* [^ ]*) (?<host>[^ ]*)
+ *  (?<ident>[a-zA-Z0-9_\/\.\-]*)(?:\[(?<pid>[0-9]+)\])?(?:[^\:]*\:)? *
+ * (?<message>.*)$
+ *
+ * The host field is only part of the non local variant.
+ */
+static int syslog_rfc3164_match(struct native_match *m, int with_host)
+{
+    int g;
+    int sp;
+    size_t a;
+    size_t b;
+    size_t d;
+    size_t e;
+    size_t x;
+    size_t spaces;
+    const char *s = m->s;
+    size_t n = m->n;
+
+    if (n < 1 || s[0] != '<') {
+        return -1;
+    }
+    e = span_digits(s, n, 1);
+    if (e == 1 || e >= n || s[e] != '>') {
+        return -1;
+    }
+    capture(m, 1, 1, e);
+
+    /* time: the one or two spaces are the only choice to backtrack into */
+    a = span_until(s, n, e + 1, ' ');
+    spaces = span_char(s, n, a, ' ') - a;
+    if (spaces == 0) {
+        return -1;
+    }
+
+    for (sp = (spaces >= 2) ? 2 : 1; sp >= 1; sp--) {
+        b = span_until(s, n, a + sp, ' ');
+        if (b >= n) {
+            continue;
+        }
+        d = span_until(s, n, b + 1, ' ');
+        if (d >= n) {
+            continue;
+        }
+
+        x = d + 1;
+        g = 3;
+        if (with_host) {
+            b = span_until(s, n, x, ' ');
+            if (b >= n) {
+                continue;
+            }
+            capture(m, g++, x, b);
+            x = b + 1;
+        }
+        capture(m, 2, e + 1, d);
+
+        /* from here on the first choice of every element matches */
+        b = x;
+        while (b < n && is_ident(s[b])) {
+            b++;
+        }
+        capture(m, g++, x, b);
+
+        capture_unset(m, g);
+        if (b < n && s[b] == '[') {
+            d = span_digits(s, n, b + 1);
+            if (d > b + 1 && d < n && s[d] == ']') {
+                capture(m, g, b + 1, d);
+                b = d + 1;
+            }
+        }
+        g++;
+
+        d = span_until(s, n, b, ':');
+        if (d < n) {
+            b = d + 1;
+        }
+        b = span_char(s, n, b, ' ');
+        capture(m, g, b, n);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+/* ^(?<time>[^ ]+) (?<stream>stdout|stderr) (?<logtag>[^ ]*) (?<message>.*)$ */
+static int cri_match(struct native_match *m)
+{
+    ssize_t p;
+    size_t e;
+    const char *s = m->s;
+    size_t n = m->n;
+
+    p = field_match(m, 0, 1);
+    if (p == -1 || n - p < 7 ||
+        (memcmp(s + p, "stdout ", 7) != 0 && memcmp(s + p, "stderr ", 7) != 0)) {
+        return -1;
+    }
+    capture(m, 2, p, p + 6);
+
+    p += 7;
+    e = span_until(s, n, p, ' ');
+    if (e >= n) {
+        return -1;
+    }
+    capture(m, 3, p, e);
+    capture(m, 4, e + 1, n);
+
+    return 0;
+}
+
+/*
+ * Return the built-in matcher for the parser regex, or zero. The groups
+ * numbers of the compiled regex must be the ones the matcher fills.
+ */
+int flb_parser_native_lookup(struct flb_parser *parser)
+{
+    int i;
+    int g;
+    int num;
+    struct native_pattern *np;
+    struct flb_regex *regex = parser->regex;
+
+    if (!parser->p_regex || !regex) {
+        return NATIVE_NONE;
+    }
+
+    for (np = native_patterns; np->id != NATIVE_NONE; np++) {
+        if (strcmp(parser->p_regex, np->regex) == 0) {
+            break;
+        }
+    }
+    if (np->id == NATIVE_NONE) {
+        return NATIVE_NONE;
+    }
+
+    for (num = 0; num < FLB_PARSER_NATIVE_GROUPS && np->groups[num]; num++);
+    if (num != regex->groups_len) {
+        return NATIVE_NONE;
+    }
+
+    for (i = 0; i < regex->groups_len; i++) {
+        g = regex->groups[i].num;
+        if (g < 1 || g > num || strcmp(regex->groups[i].name, np->groups[g - 1]) != 0) {
+            return NATIVE_NONE;
+        }
+    }
+
+    return np->id;
+}
+
+/*
+ * Match a line with a built-in matcher. The capture offsets are stored by
+ * group number in 'beg' and 'end' (-1 when the group did not participate).
+ * Returns the number of groups, -1 if the line does not match or
+ * FLB_PARSER_NATIVE_FALLBACK if the regex engine must be used instead.
+ */
+int flb_parser_native_do(int id, const char *buf, size_t length,
+                         ptrdiff_t *beg, ptrdiff_t *end)
+{
+    int ret;
+    int groups;
+    struct native_match m;
+
+    if (line_check(buf, length) != 0) {
+        return FLB_PARSER_NATIVE_FALLBACK;
+    }
+
+    m.s = buf;
+    m.n = length;
+    m.beg = beg;
+    m.end = end;
+
+    switch (id) {
+    case NATIVE_APACHE:
+    case NATIVE_APACHE2:
+        groups = 9;
+        ret = apache_match(&m, id);
+        break;
+    case NATIVE_NGINX:
+        groups = 10;
+        ret = nginx_match(&m);
+        break;
+    case NATIVE_DOCKER_DAEMON:
+        groups = 3;
+        ret = docker_daemon_match(&m);
+        break;
+    case NATIVE_SYSLOG_RFC5424:
+        groups = 8;
+        ret = syslog_rfc5424_match(&m);
+        break;
+    case NATIVE_SYSLOG_RFC3164_LOCAL:
+        groups = 5;
+        ret = syslog_rfc3164_match(&m, FLB_FALSE);
+        break;
+    case NATIVE_SYSLOG_RFC3164:
+        groups = 6;
+        ret = syslog_rfc3164_match(&m, FLB_TRUE);
+        break;
+    case NATIVE_CRI:
+        groups = 4;
+        ret = cri_match(&m);
+        break;
+    default:
+        return FLB_PARSER_NATIVE_FALLBACK;
+    }
+
+    if (ret == -1) {
+        return -1;
+    }
+    return groups;
+}
@@ -25,6 +25,7 @@
 #include <fluent-bit/flb_parser_decoder.h>
 #include <fluent-bit/flb_regex.h>
 #include <fluent-bit/flb_str.h>
+#include <fluent-bit/flb_mem.h>
 
 #include <msgpack.h>
 
@@ -41,97 +42,177 @@ struct regex_cb_ctx {
     msgpack_packer *pck;
 };
 
-static void cb_results(const char *name, const char *value,
+static void cb_results(int index, const char *value,
                        size_t vlen, void *data)
 {
-    int len;
     int ret;
     double frac = 0;
-    char *time_key;
     char tmp[255];
     struct regex_cb_ctx *pcb = data;
     struct flb_parser *parser = pcb->parser;
+    struct flb_regex_group *group = &parser->regex->groups[index];
+    struct flb_parser_field *field = &parser->fields[index];
     struct flb_tm tm = {0};
-    (void) data;
 
     if (vlen == 0 && parser->skip_empty) {
         pcb->num_skipped++;
         return;
     }
 
-    len = strlen(name);
-
     /* Check if there is a time lookup field */
-    if (parser->time_fmt) {
-        if (parser->time_key) {
-            time_key = parser->time_key;
-        }
-        else {
-            time_key = "time";
-        }
-
-        if (strcmp(name, time_key) == 0) {
-            /* Lookup time */
-            ret = flb_parser_time_lookup(value, vlen,
-                                         pcb->time_now, parser, &tm, &frac);
-            if (ret == -1) {
-                if (vlen > sizeof(tmp) - 1) {
-                    vlen = sizeof(tmp) - 1;
-                }
-                memcpy(tmp, value, vlen);
-                tmp[vlen] = '\0';
-                flb_warn("[parser:%s] invalid time format %s for '%s'",
-                         parser->name, parser->time_fmt_full, tmp);
-                pcb->num_skipped++;
-                return;
+    if (field->time_key) {
+        /* Lookup time */
+        ret = flb_parser_time_lookup(value, vlen,
+                                     pcb->time_now, parser, &tm, &frac);
+        if (ret == -1) {
+            if (vlen > sizeof(tmp) - 1) {
+                vlen = sizeof(tmp) - 1;
             }
+            memcpy(tmp, value, vlen);
+            tmp[vlen] = '\0';
+            flb_warn("[parser:%s] invalid time format %s for '%s'",
+                     parser->name, parser->time_fmt_full, tmp);
+            pcb->num_skipped++;
+            return;
+        }
 
-            pcb->time_frac = frac;
-            pcb->time_lookup = flb_parser_tm2time(&tm, parser->time_system_timezone);
+        pcb->time_frac = frac;
+        pcb->time_lookup = flb_parser_tm2time(&tm, parser->time_system_timezone);
 
-            if (parser->time_keep == FLB_FALSE) {
-                pcb->num_skipped++;
-                return;
-            }
+        if (parser->time_keep == FLB_FALSE) {
+            pcb->num_skipped++;
+            return;
         }
     }
 
-    if (parser->types_len != 0) {
-        flb_parser_typecast(name, len,
+    if (field->type) {
+        flb_parser_typecast(group->name, group->name_len,
                             value, vlen,
                             pcb->pck,
-                            parser->types,
-                            parser->types_len);
+                            field->type, 1);
     }
     else {
-        msgpack_pack_str(pcb->pck, len);
-        msgpack_pack_str_body(pcb->pck, name, len);
+        msgpack_pack_str(pcb->pck, group->name_len);
+        msgpack_pack_str_body(pcb->pck, group->name, group->name_len);
         msgpack_pack_str(pcb->pck, vlen);
         msgpack_pack_str_body(pcb->pck, value, vlen);
     }
 }
 
+/* Same as flb_regex_parse_groups() for the offsets of a built-in matcher */
+static int native_parse(struct flb_parser *parser, const char *buf,
+                        ptrdiff_t *beg, ptrdiff_t *end,
+                        struct regex_cb_ctx *pcb)
+{
+    int i;
+    int gn;
+    int last_pos = -1;
+    struct flb_regex *regex = parser->regex;
+
+    for (i = 0; i < regex->groups_len; i++) {
+        gn = regex->groups[i].num;
+
+        cb_results(i, buf + beg[gn], end[gn] - beg[gn], pcb);
+
+        if (end[gn] >= 0) {
+            last_pos = end[gn];
+        }
+    }
+
+    return last_pos;
+}
+
+/*
+ * Resolve the time key and the type casting rule of every regex group once,
+ * so matching a record does not compare each group name again.
+ */
+int flb_parser_regex_fields_create(struct flb_parser *parser)
+{
+    int i;
+    int j;
+    char *time_key;
+    struct flb_regex *regex = parser->regex;
+    struct flb_regex_group *group;
+    struct flb_parser_field *field;
+
+    if (regex->groups_len == 0) {
+        return 0;
+    }
+
+    parser->fields = flb_calloc(regex->groups_len,
+                                sizeof(struct flb_parser_field));
+    if (!parser->fields) {
+        flb_errno();
+        return -1;
+    }
+
+    if (parser->time_key) {
+        time_key = parser->time_key;
+    }
+    else {
+        time_key = "time";
+    }
+
+    for (i = 0; i < regex->groups_len; i++) {
+        group = &regex->groups[i];
+        field = &parser->fields[i];
+
+        if (parser->time_fmt && strcmp(group->name, time_key) == 0) {
+            field->time_key = FLB_TRUE;
+        }
+
+        for (j = 0; j < parser->types_len; j++) {
+            if (parser->types[j].key != NULL &&
+                parser->types[j].key_len == group->name_len &&
+                strncmp(parser->types[j].key, group->name,
+                        group->name_len) == 0) {
+                field->type = &parser->types[j];
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
 int flb_parser_regex_do(struct flb_parser *parser,
                         const char *buf, size_t length,
                         void **out_buf, size_t *out_size,
                         struct flb_time *out_time)
 {
     int ret;
+    int native;
     int arr_size;
     int last_byte;
     ssize_t n;
     size_t dec_out_size;
     char *dec_out_buf;
     char *tmp;
+    ptrdiff_t beg[FLB_PARSER_NATIVE_GROUPS + 1];
+    ptrdiff_t end[FLB_PARSER_NATIVE_GROUPS + 1];
     struct flb_regex_search result;
     struct regex_cb_ctx pcb;
     struct flb_time *t;
     msgpack_sbuffer tmp_sbuf;
     msgpack_packer tmp_pck;
 
-    n = flb_regex_do(parser->regex, buf, length, &result);
-    if (n <= 0) {
-        return -1;
+    n = FLB_PARSER_NATIVE_FALLBACK;
+    if (parser->native) {
+        n = flb_parser_native_do(parser->native, buf, length, beg, end);
+        if (n == -1) {
+            return -1;
+        }
+    }
+
+    if (n == FLB_PARSER_NATIVE_FALLBACK) {
+        n = flb_regex_do(parser->regex, buf, length, &result);
+        if (n <= 0) {
+            return -1;
+        }
+        native = FLB_FALSE;
+    }
+    else {
+        native = FLB_TRUE;
     }
 
     /* Prepare new outgoing buffer */
@@ -151,7 +232,13 @@ int flb_parser_regex_do(struct flb_parser *parser,
     pcb.time_now = 0;
 
     /* Iterate results and compose new buffer */
-    last_byte = flb_regex_parse(parser->regex, &result, cb_results, &pcb);
+    if (native) {
+        last_byte = native_parse(parser, buf, beg, end, &pcb);
+    }
+    else {
+        last_byte = flb_regex_parse_groups(parser->regex, &result,
+                                           cb_results, &pcb);
+    }
     if (last_byte == -1) {
         msgpack_sbuffer_destroy(&tmp_sbuf);
         return -1;
@@ -417,6 +417,15 @@ int flb_processor_is_active(struct flb_processor *proc)
 
 #include <fluent-bit/flb_pack.h>
 
+/* Close the arena scope opened for a chunk context */
+static void processor_arena_release(struct flb_arena **arena)
+{
+    if (*arena) {
+        flb_arena_scope_end(*arena);
+        *arena = NULL;
+    }
+}
+
 /*
  * This function will run all the processor units for the given tag and data, note
  * that depending of the 'type', 'data' can reference a msgpack for logs, a CMetrics
@@ -442,6 +451,7 @@ int flb_processor_run(struct flb_processor *proc,
     struct flb_filter_instance *f_ins;
     struct flb_processor_instance *p_ins;
     struct flb_mp_chunk_cobj *chunk_cobj = NULL;
+    struct flb_arena *arena = NULL;
 
     if (type == FLB_PROCESSOR_LOGS) {
         list = &proc->logs;
@@ -551,9 +561,21 @@ int flb_processor_run(struct flb_processor *proc,
                     if (!chunk_cobj) {
                         flb_log_event_decoder_reset(p_ins->log_decoder, cur_buf, cur_size);
 
+                        /*
+                         * records are allocated from the thread arena, they are
+                         * released at once when the context is destroyed.
+                         */
+                        arena = flb_arena_thread_get();
+                        if (arena) {
+                            flb_arena_scope_begin(arena);
+                        }
+
                         /* create the context */
-                        chunk_cobj = flb_mp_chunk_cobj_create(p_ins->log_encoder, p_ins->log_decoder);
+                        chunk_cobj = flb_mp_chunk_cobj_create_with_arena(p_ins->log_encoder,
+                                                                         p_ins->log_decoder,
+                                                                         arena);
                         if (chunk_cobj == NULL) {
+                            processor_arena_release(&arena);
                             flb_log_event_decoder_reset(p_ins->log_decoder, NULL, 0);
                             if (cur_buf != data) {
                                 flb_free(cur_buf);
@@ -594,6 +616,7 @@ int flb_processor_run(struct flb_processor *proc,
                         if (cfl_list_size(&chunk_cobj->records) == 0) {
                             flb_log_event_encoder_reset(p_ins->log_encoder);
                             flb_mp_chunk_cobj_destroy(chunk_cobj);
+                            processor_arena_release(&arena);
 
                             *out_buf = NULL;
                             *out_size = 0;
@@ -607,6 +630,8 @@ int flb_processor_run(struct flb_processor *proc,
                         /* encode chunk_cobj as msgpack */
                         ret = flb_mp_chunk_cobj_encode(chunk_cobj, (char **) &tmp_buf, &tmp_size);
                         if (ret != 0) {
+                            flb_mp_chunk_cobj_destroy(chunk_cobj);
+                            processor_arena_release(&arena);
                             flb_log_event_decoder_reset(p_ins->log_decoder, NULL, 0);
 
                             if (cur_buf != data) {
@@ -632,6 +657,7 @@ int flb_processor_run(struct flb_processor *proc,
                         flb_log_event_encoder_claim_internal_buffer_ownership(p_ins->log_encoder);
                         flb_mp_chunk_cobj_destroy(chunk_cobj);
                         chunk_cobj = NULL;
+                        processor_arena_release(&arena);
                     }
                 }
             }
@@ -23,6 +23,7 @@
 #include <fluent-bit/flb_mem.h>
 #include <fluent-bit/flb_regex.h>
 #include <fluent-bit/flb_ra_key.h>
+#include <fluent-bit/flb_simd.h>
 #include <fluent-bit/record_accessor/flb_ra_parser.h>
 #include <msgpack.h>
 #include <limits.h>
@@ -81,22 +82,25 @@ static int ra_key_val_id(flb_sds_t ckey, msgpack_object map)
 {
     int i;
     int map_size;
-    msgpack_object key;
+    size_t len;
+    msgpack_object *key;
 
     if (map.type != MSGPACK_OBJECT_MAP) {
         return -1;
     }
 
+    len = flb_sds_len(ckey);
     map_size = map.via.map.size;
     for (i = map_size - 1; i >= 0; i--) {
-        key = map.via.map.ptr[i].key;
+        key = &map.via.map.ptr[i].key;
 
-        if (key.type != MSGPACK_OBJECT_STR) {
+        if (key->type != MSGPACK_OBJECT_STR) {
             continue;
         }
 
         /* Compare by length and by key name */
-        if (flb_sds_cmp(ckey, key.via.str.ptr, key.via.str.size) != 0) {
+        if (key->via.str.size != len ||
+            strncmp(ckey, key->via.str.ptr, len) != 0) {
             continue;
         }
 
@@ -259,25 +263,15 @@ struct flb_ra_value *flb_ra_key_to_value(flb_sds_t ckey,
     return result;
 }
 
-int flb_ra_key_value_get(flb_sds_t ckey, msgpack_object map,
-                         struct mk_list *subkeys,
-                         msgpack_object **start_key,
-                         msgpack_object **out_key, msgpack_object **out_val)
+/* Resolve the sub-keys of the map entry 'i', see flb_ra_key_value_get() */
+static int ra_key_value_at(msgpack_object map, int i, struct mk_list *subkeys,
+                           msgpack_object **out_key, msgpack_object **out_val)
 {
-    int i;
     int ret;
     msgpack_object val;
     msgpack_object *o_key;
     msgpack_object *o_val;
 
-    /* Get the key position in the map */
-    i = ra_key_val_id(ckey, map);
-    if (i == -1) {
-        return -1;
-    }
-
-    /* Reference entries */
-    *start_key = &map.via.map.ptr[i].key;
     val = map.via.map.ptr[i].val;
 
     if ((val.type == MSGPACK_OBJECT_MAP || val.type == MSGPACK_OBJECT_ARRAY)
@@ -298,6 +292,128 @@ int flb_ra_key_value_get(flb_sds_t ckey, msgpack_object map,
     return -1;
 }
 
+int flb_ra_key_value_get(flb_sds_t ckey, msgpack_object map,
+                         struct mk_list *subkeys,
+                         msgpack_object **start_key,
+                         msgpack_object **out_key, msgpack_object **out_val)
+{
+    int i;
+
+    /* Get the key position in the map */
+    i = ra_key_val_id(ckey, map);
+    if (i == -1) {
+        return -1;
+    }
+
+    /* Reference entries */
+    *start_key = &map.via.map.ptr[i].key;
+
+    return ra_key_value_at(map, i, subkeys, out_key, out_val);
+}
+
+void flb_ra_key_set_init(struct flb_ra_key_set *set)
+{
+    memset(set, 0, sizeof(struct flb_ra_key_set));
+}
+
+/*
+ * Add a key to the set, it's indexed by the length of its name. Returns its
+ * position in the set or -1 if the set is full.
+ */
+int flb_ra_key_set_add(struct flb_ra_key_set *set, struct flb_ra_key *key)
+{
+    int id;
+    size_t len;
+
+    if (set->count >= FLB_RA_KEY_SET_MAX) {
+        return -1;
+    }
+
+    id = set->count++;
+    set->keys[id] = key;
+
+    len = flb_sds_len(key->name);
+    if (len < FLB_RA_KEY_SET_LENS) {
+        set->lens[len] |= (uint32_t) 1 << id;
+    }
+    else {
+        set->lens_long |= (uint32_t) 1 << id;
+    }
+
+    return id;
+}
+
+/*
+ * Resolve every key of the set with a single walk of the map. The map is
+ * walked from the end like ra_key_val_id() does, so the last entry wins for
+ * duplicated keys, and every entry only compares the keys with the same
+ * name length. 'out' has one entry per key and unresolved keys are set to
+ * NULL. Returns the number of keys resolved.
+ */
+int flb_ra_key_set_get(struct flb_ra_key_set *set, msgpack_object map,
+                       struct flb_ra_kv *out)
+{
+    int i;
+    int id;
+    int found = 0;
+    uint32_t len;
+    uint32_t mask;
+    uint32_t pending;
+    msgpack_object *key;
+    struct flb_ra_kv *kv;
+
+    memset(out, 0, sizeof(struct flb_ra_kv) * set->count);
+
+    if (map.type != MSGPACK_OBJECT_MAP || set->count == 0) {
+        return 0;
+    }
+
+    if (set->count == FLB_RA_KEY_SET_MAX) {
+        pending = UINT32_MAX;
+    }
+    else {
+        pending = ((uint32_t) 1 << set->count) - 1;
+    }
+
+    for (i = map.via.map.size - 1; i >= 0 && pending; i--) {
+        key = &map.via.map.ptr[i].key;
+        if (key->type != MSGPACK_OBJECT_STR) {
+            continue;
+        }
+
+        len = key->via.str.size;
+        if (len < FLB_RA_KEY_SET_LENS) {
+            mask = set->lens[len] & pending;
+        }
+        else {
+            mask = set->lens_long & pending;
+        }
+
+        while (mask) {
+            id = flb_simd_ctz(mask);
+            mask &= mask - 1;
+
+            if (flb_sds_cmp(set->keys[id]->name, key->via.str.ptr, len) != 0) {
+                continue;
+            }
+            pending &= ~((uint32_t) 1 << id);
+
+            kv = &out[id];
+            if (ra_key_value_at(map, i, set->keys[id]->subkeys,
+                                &kv->key, &kv->val) == 0) {
+                kv->start_key = key;
+                found++;
+            }
+            else {
+                kv->key = NULL;
+                kv->val = NULL;
+            }
+        }
+    }
+
+    return found;
+}
+
 int flb_ra_key_strcmp(flb_sds_t ckey, msgpack_object map,
                       struct mk_list *subkeys, char *str, int len)
 {
@@ -772,6 +772,25 @@ int flb_ra_get_kv_pair(struct flb_record_accessor *ra, msgpack_object map,
                                 start_key, out_key, out_val);
 }
 
+/*
+ * Register the key of the 'record accessor' in the set, so it's resolved
+ * together with the other keys of the set by flb_ra_key_set_get(). Returns
+ * the slot of the key in the set or -1 if the pattern has no key or the set
+ * is full.
+ */
+int flb_ra_key_set_add_ra(struct flb_ra_key_set *set,
+                          struct flb_record_accessor *ra)
+{
+    struct flb_ra_parser *rp;
+
+    rp = get_ra_parser(ra);
+    if (rp == NULL) {
+        return -1;
+    }
+
+    return flb_ra_key_set_add(set, rp->key);
+}
+
 struct flb_ra_value *flb_ra_get_value_object(struct flb_record_accessor *ra,
                                              msgpack_object map)
 {
@@ -21,42 +21,322 @@
 #include <fluent-bit/flb_regex.h>
 #include <fluent-bit/flb_log.h>
 #include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_str.h>
+#include <fluent-bit/flb_simd.h>
 
+#include <ctype.h>
 #include <string.h>
 #include <onigmo.h>
 
+/* Literals shorter than this are not worth a prefilter pass */
+#define REGEX_LITERAL_MIN 2
+
 static int
-cb_onig_named(const UChar *name, const UChar *name_end,
+cb_onig_count(const UChar *name, const UChar *name_end,
               int ngroup_num, int *group_nums,
               regex_t *reg, void *data)
 {
-    int i;
-    int gn;
-    struct flb_regex_search *s;
-    OnigRegion *region;
+    int *count = data;
 
-    s = (struct flb_regex_search *) data;
-    region = s->region;
+    *count += ngroup_num;
+    return 0;
+}
+
+static int
+cb_onig_groups(const UChar *name, const UChar *name_end,
+               int ngroup_num, int *group_nums,
+               regex_t *reg, void *data)
+{
+    int i;
+    struct flb_regex *r = data;
+    struct flb_regex_group *group;
 
     for (i = 0; i < ngroup_num; i++) {
-        gn = group_nums[i];
-        onig_name_to_backref_number(reg, name, name_end, region);
-
-        if (s->cb_match) {
-            s->cb_match((const char *)name,
-                        s->str + region->beg[gn],
-                        region->end[gn] - region->beg[gn],
-                        s->data);
+        group = &r->groups[r->groups_len];
+        group->name_len = name_end - name;
+        group->name = flb_strndup((const char *) name, group->name_len);
+        if (!group->name) {
+            return -1;
         }
+        group->num = group_nums[i];
+        r->groups_len++;
+    }
 
-        if (region->end[gn] >= 0) {
-            s->last_pos = region->end[gn];
+    return 0;
+}
+
+/* Cache the named groups so every match doesn't walk the engine name table */
+static int regex_groups_create(struct flb_regex *r)
+{
+    int ret;
+    int count = 0;
+
+    onig_foreach_name(r->regex, cb_onig_count, &count);
+    if (count == 0) {
+        return 0;
+    }
+
+    r->groups = flb_calloc(count, sizeof(struct flb_regex_group));
+    if (!r->groups) {
+        flb_errno();
+        return -1;
+    }
+
+    ret = onig_foreach_name(r->regex, cb_onig_groups, r);
+    if (ret != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Drop the last character of a literal run, it was made optional */
+static int literal_run_pop(char *run, int len)
+{
+    while (len > 0 && (run[len - 1] & 0xc0) == 0x80) {
+        len--;
+    }
+    if (len > 0) {
+        len--;
+    }
+    return len;
+}
+
+/* Skip a bracket expression, 'p' points to the opening '[' */
+static const char *literal_skip_class(const char *p, const char *end)
+{
+    int nest = 1;
+
+    p++;
+    if (p < end && *p == '^') {
+        p++;
+    }
+
+    /* a ']' right after the opening bracket is a member */
+    if (p < end && *p == ']') {
+        p++;
+    }
+
+    while (p < end && nest > 0) {
+        if (*p == '\\') {
+            p++;
         }
+        else if (*p == '[') {
+            nest++;
+        }
+        else if (*p == ']') {
+            nest--;
+        }
+        p++;
     }
 
+    return p;
+}
+
+/*
+ * Find the longest run of plain characters that any match has to contain.
+ * Only the top level of the pattern is considered: group contents, classes,
+ * escapes other than punctuation and characters made optional by a
+ * quantifier end the current run. Any top level alternation, inline option
+ * or a construct that is not understood disables the prefilter.
+ */
+static int regex_literal_create(struct flb_regex *r,
+                                const char *start, const char *end,
+                                OnigOptionType option)
+{
+    int depth = 0;
+    int run_len = 0;
+    int best_len = 0;
+    int exact = FLB_TRUE;
+    char *run;
+    char *best;
+    const char *p;
+
+    if (option & (ONIG_OPTION_IGNORECASE | ONIG_OPTION_EXTEND)) {
+        return 0;
+    }
+
+    run = flb_malloc((end - start) * 2 + 2);
+    if (!run) {
+        flb_errno();
+        return -1;
+    }
+    best = run + (end - start) + 1;
+
+#define RUN_END()                                       \
+    do {                                                \
+        if (run_len > best_len) {                       \
+            memcpy(best, run, run_len);                 \
+            best_len = run_len;                         \
+        }                                               \
+        run_len = 0;                                    \
+    } while (0)
+
+    p = start;
+    while (p < end) {
+        if (depth > 0) {
+            if (*p == '\\') {
+                p += 2;
+                continue;
+            }
+            else if (*p == '[') {
+                p = literal_skip_class(p, end);
+                continue;
+            }
+            else if (*p == '(') {
+                /* comments may hold unbalanced parentheses */
+                if (p + 2 < end && p[1] == '?' && p[2] == '#') {
+                    goto disable;
+                }
+                depth++;
+            }
+            else if (*p == ')') {
+                depth--;
+            }
+            p++;
+            continue;
+        }
+
+        switch (*p) {
+        case '\\':
+            if (p + 1 >= end) {
+                goto disable;
+            }
+            if (isalnum((unsigned char) p[1])) {
+                /* single character escapes only, others take arguments */
+                if (!strchr("dDwWsShHbBAzZGntrfvaeRX", p[1])) {
+                    goto disable;
+                }
+                RUN_END();
+                exact = FLB_FALSE;
+                p += 2;
+                continue;
+            }
+            run[run_len++] = p[1];
+            p += 2;
+            continue;
+        case '(':
+            if (p + 2 < end && p[1] == '?' && strchr("imx-#", p[2])) {
+                goto disable;
+            }
+            RUN_END();
+            exact = FLB_FALSE;
+            depth++;
+            break;
+        case ')':
+        case '|':
+            goto disable;
+        case '[':
+            RUN_END();
+            exact = FLB_FALSE;
+            p = literal_skip_class(p, end);
+            continue;
+        case '.':
+        case '^':
+        case '$':
+            RUN_END();
+            exact = FLB_FALSE;
+            break;
+        case '?':
+        case '*':
+        case '+':
+            run_len = literal_run_pop(run, run_len);
+            RUN_END();
+            exact = FLB_FALSE;
+            break;
+        case '{':
+            run_len = literal_run_pop(run, run_len);
+            RUN_END();
+            exact = FLB_FALSE;
+            p++;
+            while (p < end && (isdigit((unsigned char) *p) || *p == ',')) {
+                p++;
+            }
+            if (p >= end || *p != '}') {
+                goto disable;
+            }
+            break;
+        default:
+            run[run_len++] = *p;
+        }
+        p++;
+    }
+    RUN_END();
+
+#undef RUN_END
+
+    if (best_len < REGEX_LITERAL_MIN) {
+        flb_free(run);
+        return 0;
+    }
+
+    r->literal = flb_malloc(best_len);
+    if (!r->literal) {
+        flb_errno();
+        flb_free(run);
+        return -1;
+    }
+    memcpy(r->literal, best, best_len);
+    r->literal_len = best_len;
+    r->literal_exact = exact;
+
+    flb_free(run);
+    return 0;
+
+disable:
+    flb_free(run);
     return 0;
 }
 
+/* Lookup 'needle' in 'str' comparing its first and last bytes per vector */
+static int regex_literal_find(const char *str, size_t slen,
+                              const char *needle, size_t nlen)
+{
+    size_t i = 0;
+    const char *p;
+#ifndef FLB_SIMD_NONE
+    uint32_t mask;
+    flb_vector8 first;
+    flb_vector8 last;
+#endif
+
+    if (nlen > slen) {
+        return FLB_FALSE;
+    }
+
+#ifndef FLB_SIMD_NONE
+    first = flb_vector8_broadcast(needle[0]);
+    last = flb_vector8_broadcast(needle[nlen - 1]);
+
+    for (; i + nlen - 1 + FLB_VECTOR8_SIZE <= slen; i += FLB_VECTOR8_SIZE) {
+        mask = flb_vector8_mask(flb_vector8_eq(flb_vector8_load(str + i),
+                                               first)) &
+               flb_vector8_mask(flb_vector8_eq(flb_vector8_load(str + i + nlen - 1),
+                                               last));
+        while (mask) {
+            if (memcmp(str + i + flb_simd_ctz(mask) + 1,
+                       needle + 1, nlen - 2) == 0) {
+                return FLB_TRUE;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    while (i + nlen <= slen) {
+        p = memchr(str + i, needle[0], slen - i - nlen + 1);
+        if (!p) {
+            return FLB_FALSE;
+        }
+        if (memcmp(p + 1, needle + 1, nlen - 1) == 0) {
+            return FLB_TRUE;
+        }
+        i = (p - str) + 1;
+    }
+
+    return FLB_FALSE;
+}
+
 static OnigOptionType check_option(const char *start, const char *end, char **new_end)
 {
     char *chr = NULL;
@@ -107,7 +387,7 @@ static OnigOptionType check_option(const char *start, const char *end, char **ne
     return option;
 }
 
-static int str_to_regex(const char *pattern, OnigRegex *reg)
+static int str_to_regex(const char *pattern, struct flb_regex *r)
 {
     int ret;
     size_t len;
@@ -134,7 +414,7 @@ static int str_to_regex(const char *pattern, OnigRegex *reg)
         end = new_end;
     }
 
-    ret = onig_new(reg,
+    ret = onig_new((OnigRegex *) &r->regex,
                    (const unsigned char *)start, (const unsigned char *)end,
                    option,
                    ONIG_ENCODING_UTF8, ONIG_SYNTAX_RUBY, &einfo);
@@ -142,7 +422,8 @@ static int str_to_regex(const char *pattern, OnigRegex *reg)
     if (ret != ONIG_NORMAL) {
         return -1;
     }
-    return 0;
+
+    return regex_literal_create(r, start, end, option);
 }
 
 /* Initialize backend library */
@@ -157,19 +438,28 @@ struct flb_regex *flb_regex_create(const char *pattern)
     struct flb_regex *r;
 
     /* Create context */
-    r = flb_malloc(sizeof(struct flb_regex));
+    r = flb_calloc(1, sizeof(struct flb_regex));
     if (!r) {
         flb_errno();
         return NULL;
     }
 
     /* Compile pattern */
-    ret = str_to_regex(pattern, (OnigRegex*)&r->regex);
+    ret = str_to_regex(pattern, r);
     if (ret == -1) {
+        if (r->regex) {
+            onig_free(r->regex);
+        }
         flb_free(r);
         return NULL;
     }
 
+    ret = regex_groups_create(r);
+    if (ret == -1) {
+        flb_regex_destroy(r);
+        return NULL;
+    }
+
     return r;
 }
 
@@ -182,6 +472,12 @@ ssize_t flb_regex_do(struct flb_regex *r, const char *str, size_t slen,
     const char *range;
     OnigRegion *region;
 
+    if (r->literal &&
+        !regex_literal_find(str, slen, r->literal, r->literal_len)) {
+        result->region = NULL;
+        return -1;
+    }
+
     region = onig_region_new();
     if (!region) {
         flb_errno();
@@ -268,6 +564,11 @@ int flb_regex_match(struct flb_regex *r, unsigned char *str, size_t slen)
     unsigned char *end;
     unsigned char *range;
 
+    if (r->literal &&
+        !regex_literal_find((char *) str, slen, r->literal, r->literal_len)) {
+        return 0;
+    }
+
     /* Search scope */
     start = (unsigned char *) str;
     end   = start + slen;
@@ -291,23 +592,81 @@ int flb_regex_parse(struct flb_regex *r, struct flb_regex_search *result,
                                       void *),                  /* caller data */
                     void *data)
 {
-    int ret;
+    int i;
+    int gn;
+    OnigRegion *region;
+    struct flb_regex_group *group;
 
     result->data = data;
     result->cb_match = cb_match;
     result->last_pos = -1;
 
-    ret = onig_foreach_name(r->regex, cb_onig_named, result);
-    onig_region_free(result->region, 1);
+    region = result->region;
+    for (i = 0; i < r->groups_len; i++) {
+        group = &r->groups[i];
+        gn = group->num;
 
-    if (ret == 0) {
-        return result->last_pos;
+        if (cb_match) {
+            cb_match(group->name,
+                     result->str + region->beg[gn],
+                     region->end[gn] - region->beg[gn],
+                     data);
+        }
+
+        if (region->end[gn] >= 0) {
+            result->last_pos = region->end[gn];
+        }
+    }
+    onig_region_free(region, 1);
+
+    return result->last_pos;
+}
+
+/*
+ * Same as flb_regex_parse() but the callback receives the index of the
+ * group in r->groups, so callers can keep their own per group lookups.
+ */
+int flb_regex_parse_groups(struct flb_regex *r, struct flb_regex_search *result,
+                           void (*cb_group) (int,                   /* group index */
+                                             const char *, size_t,  /* value */
+                                             void *),               /* caller data */
+                           void *data)
+{
+    int i;
+    int gn;
+    OnigRegion *region;
+
+    result->data = data;
+    result->cb_match = NULL;
+    result->last_pos = -1;
+
+    region = result->region;
+    for (i = 0; i < r->groups_len; i++) {
+        gn = r->groups[i].num;
+
+        cb_group(i,
+                 result->str + region->beg[gn],
+                 region->end[gn] - region->beg[gn],
+                 data);
+
+        if (region->end[gn] >= 0) {
+            result->last_pos = region->end[gn];
+        }
     }
-    return -1;
+    onig_region_free(region, 1);
+
+    return result->last_pos;
 }
 
 int flb_regex_destroy(struct flb_regex *r)
 {
+    int i;
+
+    for (i = 0; i < r->groups_len; i++) {
+        flb_free(r->groups[i].name);
+    }
+    flb_free(r->groups);
+    flb_free(r->literal);
     onig_free(r->regex);
     flb_free(r);
     return 0;
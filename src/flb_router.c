@@ -24,8 +24,11 @@
 #include <fluent-bit/flb_input.h>
 #include <fluent-bit/flb_input_chunk.h>
 #include <fluent-bit/flb_output.h>
+#include <fluent-bit/flb_filter.h>
 #include <fluent-bit/flb_config.h>
 #include <fluent-bit/flb_router.h>
+#include <fluent-bit/flb_routes_mask.h>
+#include <fluent-bit/flb_hash_table.h>
 
 #ifdef FLB_HAVE_REGEX
 #include <onigmo.h>
@@ -124,6 +127,388 @@ int flb_router_match(const char *tag, int tag_len, const char *match,
     return ret;
 }
 
+/*
+ * Pre-process a match pattern: most of the rules used in real configurations
+ * are a plain tag, a prefix ('kube.*'), a suffix ('*.log') or a catch-all,
+ * those are resolved with a single comparison. Anything else falls back to
+ * the generic wildcard matcher.
+ */
+void flb_router_rule_compile(struct flb_router_rule *rule,
+                             const char *match, void *match_regex)
+{
+    int len;
+    int stars = 0;
+    int lead = 0;
+    int trail = 0;
+    const char *p;
+
+    memset(rule, 0, sizeof(struct flb_router_rule));
+    rule->match = match;
+    rule->match_regex = match_regex;
+
+    if (!match) {
+        rule->type = FLB_ROUTER_RULE_NONE;
+        return;
+    }
+
+    len = strlen(match);
+    for (p = match; *p; p++) {
+        if (*p == '*') {
+            stars++;
+        }
+    }
+
+    /* count leading and trailing wildcards */
+    while (lead < len && match[lead] == '*') {
+        lead++;
+    }
+    while (trail < len - lead && match[len - trail - 1] == '*') {
+        trail++;
+    }
+
+    if (stars == 0) {
+        rule->type = FLB_ROUTER_RULE_EXACT;
+        rule->literal = match;
+        rule->literal_len = len;
+    }
+    else if (lead == len) {
+        rule->type = FLB_ROUTER_RULE_ALL;
+    }
+    else if (lead == 0 && trail == stars) {
+        rule->type = FLB_ROUTER_RULE_PREFIX;
+        rule->literal = match;
+        rule->literal_len = len - trail;
+    }
+    else if (trail == 0 && lead == stars) {
+        rule->type = FLB_ROUTER_RULE_SUFFIX;
+        rule->literal = match + lead;
+        rule->literal_len = len - lead;
+    }
+    else {
+        rule->type = FLB_ROUTER_RULE_WILDCARD;
+    }
+}
+
+/*
+ * Check if a compiled rule matches the given tag. As in flb_router_match(), a
+ * rule matches if its regex (if any) or its wildcard pattern matches.
+ */
+int flb_router_rule_match(struct flb_router_rule *rule,
+                          const char *tag, int tag_len)
+{
+    int ret;
+    flb_sds_t t;
+#ifdef FLB_HAVE_REGEX
+    struct flb_regex *regex;
+
+    if (rule->match_regex) {
+        regex = rule->match_regex;
+        ret = onig_match(regex->regex,
+                         (const unsigned char *) tag,
+                         (const unsigned char *) tag + tag_len,
+                         (const unsigned char *) tag, 0,
+                         ONIG_OPTION_NONE);
+        if (ret > 0) {
+            return FLB_TRUE;
+        }
+    }
+#endif
+
+    switch (rule->type) {
+    case FLB_ROUTER_RULE_ALL:
+        return FLB_TRUE;
+    case FLB_ROUTER_RULE_EXACT:
+        if (tag_len == rule->literal_len &&
+            memcmp(tag, rule->literal, tag_len) == 0) {
+            return FLB_TRUE;
+        }
+        return FLB_FALSE;
+    case FLB_ROUTER_RULE_PREFIX:
+        if (tag_len >= rule->literal_len &&
+            memcmp(tag, rule->literal, rule->literal_len) == 0) {
+            return FLB_TRUE;
+        }
+        return FLB_FALSE;
+    case FLB_ROUTER_RULE_SUFFIX:
+        if (tag_len >= rule->literal_len &&
+            memcmp(tag + (tag_len - rule->literal_len),
+                   rule->literal, rule->literal_len) == 0) {
+            return FLB_TRUE;
+        }
+        return FLB_FALSE;
+    case FLB_ROUTER_RULE_WILDCARD:
+        /* the generic matcher needs a NULL terminated tag */
+        t = flb_sds_create_len(tag, tag_len);
+        if (!t) {
+            return FLB_FALSE;
+        }
+        ret = router_match(t, tag_len, rule->match, NULL);
+        flb_sds_destroy(t);
+        return ret;
+    }
+
+    return FLB_FALSE;
+}
+
+static void route_destroy(struct flb_router_route *route)
+{
+    if (route->tag) {
+        flb_sds_destroy(route->tag);
+    }
+    if (route->filters) {
+        flb_free(route->filters);
+    }
+    flb_routes_mask_destroy(route->routes_mask);
+    flb_free(route);
+}
+
+/* Resolve the full route (filters + outputs) for a tag */
+static struct flb_router_route *route_create(struct flb_router_table *table,
+                                             const char *tag, int tag_len)
+{
+    int i;
+    struct flb_router_route *route;
+
+    route = flb_calloc(1, sizeof(struct flb_router_route));
+    if (!route) {
+        flb_errno();
+        return NULL;
+    }
+
+    route->tag = flb_sds_create_len(tag, tag_len);
+    if (!route->tag) {
+        flb_free(route);
+        return NULL;
+    }
+
+    route->routes_mask = flb_routes_mask_create(table->config);
+    if (!route->routes_mask) {
+        route_destroy(route);
+        return NULL;
+    }
+
+    if (table->filters_size > 0) {
+        route->filters = flb_malloc(sizeof(struct flb_filter_instance *) *
+                                    table->filters_size);
+        if (!route->filters) {
+            flb_errno();
+            route_destroy(route);
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < table->filters_size; i++) {
+        if (flb_router_rule_match(&table->filter_rules[i], tag, tag_len)) {
+            route->filters[route->filters_size++] = table->filters[i];
+        }
+    }
+
+    for (i = 0; i < table->outputs_size; i++) {
+        if (flb_router_rule_match(&table->output_rules[i], tag, tag_len)) {
+            flb_routes_mask_set_bit(route->routes_mask, table->outputs[i]->id,
+                                    table->config);
+            route->has_routes = FLB_TRUE;
+        }
+    }
+
+    return route;
+}
+
+/* Remove the oldest cached route that is not in use */
+static void route_evict(struct flb_router_table *table)
+{
+    struct mk_list *head;
+    struct flb_router_route *route;
+
+    mk_list_foreach(head, &table->routes) {
+        route = mk_list_entry(head, struct flb_router_route, _head);
+        if (route->users > 0) {
+            continue;
+        }
+
+        flb_hash_table_del_ptr(table->routes_ht,
+                               route->tag, flb_sds_len(route->tag), route);
+        mk_list_del(&route->_head);
+        table->routes_count--;
+        route_destroy(route);
+        return;
+    }
+}
+
+/*
+ * Lookup the route for a tag, on a miss the route is resolved against the
+ * compiled rules and cached. The caller must release the reference with
+ * flb_router_route_put().
+ */
+struct flb_router_route *flb_router_route_get(struct flb_router_table *table,
+                                              const char *tag, int tag_len)
+{
+    int ret;
+    struct flb_router_route *route;
+
+    route = flb_hash_table_get_ptr(table->routes_ht, tag, tag_len);
+    if (route) {
+        table->hits++;
+        route->users++;
+        return route;
+    }
+
+    table->misses++;
+    route = route_create(table, tag, tag_len);
+    if (!route) {
+        return NULL;
+    }
+    route->users = 1;
+
+    if (table->routes_count >= table->routes_max) {
+        route_evict(table);
+    }
+
+    /* if every cached route is in use, the new one is not cached */
+    if (table->routes_count < table->routes_max) {
+        ret = flb_hash_table_add(table->routes_ht, tag, tag_len, route, 0);
+        if (ret >= 0) {
+            route->cached = FLB_TRUE;
+            mk_list_add(&route->_head, &table->routes);
+            table->routes_count++;
+        }
+    }
+
+    return route;
+}
+
+void flb_router_route_put(struct flb_router_table *table,
+                          struct flb_router_route *route)
+{
+    (void) table;
+
+    route->users--;
+    if (route->users <= 0 && route->cached == FLB_FALSE) {
+        route_destroy(route);
+    }
+}
+
+/*
+ * Compile the Match and Match_Regex rules of all filters and outputs. The
+ * table must be re-created if the pipeline changes (e.g: hot reload creates a
+ * new configuration context).
+ */
+struct flb_router_table *flb_router_table_create(struct flb_config *config,
+                                                 int routes_max)
+{
+    int i;
+    int size;
+    struct mk_list *head;
+    struct flb_filter_instance *f_ins;
+    struct flb_output_instance *o_ins;
+    struct flb_router_table *table;
+
+    table = flb_calloc(1, sizeof(struct flb_router_table));
+    if (!table) {
+        flb_errno();
+        return NULL;
+    }
+    mk_list_init(&table->routes);
+    table->config = config;
+    table->routes_max = routes_max;
+
+    size = routes_max / 4;
+    if (size <= 0) {
+        size = 1;
+    }
+    table->routes_ht = flb_hash_table_create(FLB_HASH_TABLE_EVICT_NONE, size, 0);
+    if (!table->routes_ht) {
+        flb_router_table_destroy(table);
+        return NULL;
+    }
+
+    /* filters */
+    size = mk_list_size(&config->filters);
+    if (size > 0) {
+        table->filters = flb_calloc(size, sizeof(struct flb_filter_instance *));
+        table->filter_rules = flb_calloc(size, sizeof(struct flb_router_rule));
+        if (!table->filters || !table->filter_rules) {
+            flb_errno();
+            flb_router_table_destroy(table);
+            return NULL;
+        }
+    }
+
+    i = 0;
+    mk_list_foreach(head, &config->filters) {
+        f_ins = mk_list_entry(head, struct flb_filter_instance, _head);
+        table->filters[i] = f_ins;
+        flb_router_rule_compile(&table->filter_rules[i], f_ins->match,
+#ifdef FLB_HAVE_REGEX
+                                f_ins->match_regex
+#else
+                                NULL
+#endif
+                                );
+        i++;
+    }
+    table->filters_size = i;
+
+    /* outputs */
+    size = mk_list_size(&config->outputs);
+    if (size > 0) {
+        table->outputs = flb_calloc(size, sizeof(struct flb_output_instance *));
+        table->output_rules = flb_calloc(size, sizeof(struct flb_router_rule));
+        if (!table->outputs || !table->output_rules) {
+            flb_errno();
+            flb_router_table_destroy(table);
+            return NULL;
+        }
+    }
+
+    i = 0;
+    mk_list_foreach(head, &config->outputs) {
+        o_ins = mk_list_entry(head, struct flb_output_instance, _head);
+        table->outputs[i] = o_ins;
+        flb_router_rule_compile(&table->output_rules[i], o_ins->match,
+#ifdef FLB_HAVE_REGEX
+                                o_ins->match_regex
+#else
+                                NULL
+#endif
+                                );
+        i++;
+    }
+    table->outputs_size = i;
+
+    return table;
+}
+
+void flb_router_table_destroy(struct flb_router_table *table)
+{
+    struct mk_list *tmp;
+    struct mk_list *head;
+    struct flb_router_route *route;
+
+    mk_list_foreach_safe(head, tmp, &table->routes) {
+        route = mk_list_entry(head, struct flb_router_route, _head);
+        mk_list_del(&route->_head);
+        route_destroy(route);
+    }
+
+    if (table->routes_ht) {
+        flb_hash_table_destroy(table->routes_ht);
+    }
+    if (table->filters) {
+        flb_free(table->filters);
+    }
+    if (table->filter_rules) {
+        flb_free(table->filter_rules);
+    }
+    if (table->outputs) {
+        flb_free(table->outputs);
+    }
+    if (table->output_rules) {
+        flb_free(table->output_rules);
+    }
+    flb_free(table);
+}
+
 /* Associate and input and output instances due to a previous match */
 int flb_router_connect(struct flb_input_instance *in,
                        struct flb_output_instance *out)
@@ -191,7 +576,7 @@ int flb_router_io_set(struct flb_config *config)
             o_ins->match = flb_sds_create_len("*", 1);
         }
         flb_router_connect(i_ins, o_ins);
-        return 0;
+        goto compile;
     }
 
     /* N:M case, iterate all input instances */
@@ -238,6 +623,21 @@ int flb_router_io_set(struct flb_config *config)
         }
     }
 
+compile:
+    /* Compile the rules used to route chunks at runtime */
+    if (config->router_table) {
+        flb_router_table_destroy(config->router_table);
+    }
+    config->router_table = flb_router_table_create(config,
+                                                   FLB_ROUTER_CACHE_SIZE);
+    if (!config->router_table) {
+        flb_error("[router] could not create routing table");
+        return -1;
+    }
+    flb_debug("[router] routing table compiled: %i filter rules, "
+              "%i output rules", config->router_table->filters_size,
+              config->router_table->outputs_size);
+
     return 0;
 }
 
@@ -250,6 +650,11 @@ void flb_router_exit(struct flb_config *config)
     struct flb_input_instance *in;
     struct flb_router_path *r;
 
+    if (config->router_table) {
+        flb_router_table_destroy(config->router_table);
+        config->router_table = NULL;
+    }
+
     /* Iterate input plugins */
     mk_list_foreach_safe(head, tmp, &config->inputs) {
         in = mk_list_entry(head, struct flb_input_instance, _head);
@@ -18,17 +18,78 @@
  */
 
 #include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
 #include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_config.h>
 #include <fluent-bit/flb_input.h>
 #include <fluent-bit/flb_router.h>
 #include <fluent-bit/flb_routes_mask.h>
 
 
+/*
+ * Calculate the number of elements of the routes mask required to represent
+ * the given number of output plugins. It must be invoked before any routes
+ * mask is created for the configuration context.
+ */
+int flb_routes_mask_set_size(struct flb_config *config, size_t outputs)
+{
+    size_t size;
+
+    size = (outputs + FLB_ROUTES_MASK_ELEMENT_BITS - 1) /
+           FLB_ROUTES_MASK_ELEMENT_BITS;
+    if (size < FLB_ROUTES_MASK_DEFAULT_ELEMENTS) {
+        size = FLB_ROUTES_MASK_DEFAULT_ELEMENTS;
+    }
+
+    config->route_mask_size = size;
+    return 0;
+}
+
+/* Number of elements of the routes mask */
+size_t flb_routes_mask_get_size(struct flb_config *config)
+{
+    if (config->route_mask_size == 0) {
+        return FLB_ROUTES_MASK_DEFAULT_ELEMENTS;
+    }
+
+    return config->route_mask_size;
+}
+
+/* Create an empty routes mask */
+flb_route_mask_element *flb_routes_mask_create(struct flb_config *config)
+{
+    flb_route_mask_element *routes_mask;
+
+    routes_mask = flb_calloc(flb_routes_mask_get_size(config),
+                             sizeof(flb_route_mask_element));
+    if (!routes_mask) {
+        flb_errno();
+        return NULL;
+    }
+
+    return routes_mask;
+}
+
+void flb_routes_mask_destroy(flb_route_mask_element *routes_mask)
+{
+    if (routes_mask) {
+        flb_free(routes_mask);
+    }
+}
+
+void flb_routes_mask_copy(flb_route_mask_element *dst,
+                          flb_route_mask_element *src,
+                          struct flb_config *config)
+{
+    memcpy(dst, src,
+           sizeof(flb_route_mask_element) * flb_routes_mask_get_size(config));
+}
+
 /*
  * Set the routes_mask for input chunk with a router_match on tag, return a
  * non-zero value if any routes matched
  */
-int flb_routes_mask_set_by_tag(uint64_t *routes_mask,
+int flb_routes_mask_set_by_tag(flb_route_mask_element *routes_mask,
                                const char *tag,
                                int tag_len,
                                struct flb_input_instance *in)
@@ -36,12 +97,26 @@ int flb_routes_mask_set_by_tag(uint64_t *routes_mask,
     int has_routes = 0;
     struct mk_list *o_head;
     struct flb_output_instance *o_ins;
+    struct flb_router_route *route;
+
     if (!in) {
         return 0;
     }
 
+    /* Use the compiled routing table if available */
+    if (in->config->router_table) {
+        route = flb_router_route_get(in->config->router_table, tag, tag_len);
+        if (route) {
+            flb_routes_mask_copy(routes_mask, route->routes_mask, in->config);
+            has_routes = route->has_routes;
+            flb_router_route_put(in->config->router_table, route);
+            return has_routes;
+        }
+    }
+
     /* Clear the bit field */
-    memset(routes_mask, 0, sizeof(uint64_t) * FLB_ROUTES_MASK_ELEMENTS);
+    memset(routes_mask, 0,
+           sizeof(flb_route_mask_element) * flb_routes_mask_get_size(in->config));
 
     /* Find all matching routes for the given tag */
     mk_list_foreach(o_head, &in->config->outputs) {
@@ -55,7 +130,7 @@ int flb_routes_mask_set_by_tag(uint64_t *routes_mask,
                              , NULL
 #endif
                              )) {
-            flb_routes_mask_set_bit(routes_mask, o_ins->id);
+            flb_routes_mask_set_bit(routes_mask, o_ins->id, in->config);
             has_routes = 1;
         }
     }
@@ -70,12 +145,14 @@ int flb_routes_mask_set_by_tag(uint64_t *routes_mask,
  * 4th bit in the 2nd value of the bitfield array.
  *
  */
-void flb_routes_mask_set_bit(uint64_t *routes_mask, int value)
+void flb_routes_mask_set_bit(flb_route_mask_element *routes_mask, int value,
+                             struct flb_config *config)
 {
     int index;
-    uint64_t bit;
+    flb_route_mask_element bit;
 
-    if (value < 0 || value > FLB_ROUTES_MASK_MAX_VALUE) {
+    if (value < 0 ||
+        value >= flb_routes_mask_get_size(config) * FLB_ROUTES_MASK_ELEMENT_BITS) {
         flb_warn("[routes_mask] Can't set bit (%d) past limits of bitfield",
                  value);
         return;
@@ -93,12 +170,14 @@ void flb_routes_mask_set_bit(uint64_t *routes_mask, int value)
  * 4th bit in the 2nd value of the bitfield array.
  *
  */
-void flb_routes_mask_clear_bit(uint64_t *routes_mask, int value)
+void flb_routes_mask_clear_bit(flb_route_mask_element *routes_mask, int value,
+                               struct flb_config *config)
 {
     int index;
-    uint64_t bit;
+    flb_route_mask_element bit;
 
-    if (value < 0 || value > FLB_ROUTES_MASK_MAX_VALUE) {
+    if (value < 0 ||
+        value >= flb_routes_mask_get_size(config) * FLB_ROUTES_MASK_ELEMENT_BITS) {
         flb_warn("[routes_mask] Can't set bit (%d) past limits of bitfield",
                  value);
         return;
@@ -117,12 +196,14 @@ void flb_routes_mask_clear_bit(uint64_t *routes_mask, int value)
  * if the 4th bit in the 2nd value of the bitfield array is set.
  *
  */
-int flb_routes_mask_get_bit(uint64_t *routes_mask, int value)
+int flb_routes_mask_get_bit(flb_route_mask_element *routes_mask, int value,
+                            struct flb_config *config)
 {
     int index;
-    uint64_t bit;
+    flb_route_mask_element bit;
 
-    if (value < 0 || value > FLB_ROUTES_MASK_MAX_VALUE) {
+    if (value < 0 ||
+        value >= flb_routes_mask_get_size(config) * FLB_ROUTES_MASK_ELEMENT_BITS) {
         flb_warn("[routes_mask] Can't get bit (%d) past limits of bitfield",
                  value);
         return 0;
@@ -133,11 +214,21 @@ int flb_routes_mask_get_bit(uint64_t *routes_mask, int value)
     return (routes_mask[index] & bit) != 0ULL;
 }
 
-int flb_routes_mask_is_empty(uint64_t *routes_mask)
+/*
+ * Checks if no bit is set. The elements are OR'ed together without early
+ * exit so the compiler can vectorize the loop.
+ */
+int flb_routes_mask_is_empty(flb_route_mask_element *routes_mask,
+                             struct flb_config *config)
 {
-    uint64_t empty[FLB_ROUTES_MASK_ELEMENTS];
+    size_t i;
+    size_t size;
+    flb_route_mask_element acc = 0;
+
+    size = flb_routes_mask_get_size(config);
+    for (i = 0; i < size; i++) {
+        acc |= routes_mask[i];
+    }
 
-    /* Clear the tmp bitfield */
-    memset(empty, 0, sizeof(empty));
-    return memcmp(routes_mask, empty, sizeof(empty)) == 0;
+    return acc == 0;
 }
@@ -26,10 +26,17 @@
 #include <fluent-bit/flb_engine.h>
 #include <fluent-bit/flb_engine_dispatch.h>
 #include <fluent-bit/flb_random.h>
+#include <fluent-bit/flb_timer_wheel.h>
+#include <cfl/cfl_time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
 FLB_TLS_DEFINE(struct flb_sched, flb_sched_ctx);
 
 void flb_sched_ctx_init()
@@ -77,6 +84,23 @@ static inline int consume_byte(flb_pipefd_t fd)
     return 0;
 }
 
+/*
+ * Depending on the backend that provides the timer, most of the time except
+ * on event loops based on 'kqueue', we need to read the notification byte, which
+ * usually comes from a file descriptor registered through the backend based on
+ * epoll(), select() or poll().
+ *
+ * If we are NOT using kequeue, just read(2) the byte.
+ */
+static inline int timer_consume_byte(int fd)
+{
+#ifndef FLB_EVENT_LOOP_KQUEUE
+    return consume_byte(fd);
+#endif
+
+    return 0;
+}
+
 /*
  * Generate an uniform random value between min and max. Original version
  * taken from internet and modified to use /dev/urandom to set a seed on
@@ -109,123 +133,244 @@ static int random_uniform(int min, int max)
 }
 
 
+/* Convert milliseconds to timer wheel ticks, rounding up */
+static inline uint64_t ms_to_ticks(uint64_t ms)
+{
+    return (ms + FLB_SCHED_WHEEL_TICK - 1) / FLB_SCHED_WHEEL_TICK;
+}
+
 /*
- * Schedule a request that will be processed within the next
- * FLB_SCHED_REQUEST_FRAME seconds.
+ * Timer file descriptors: on Linux a timerfd is created once per timer and
+ * re-armed in place with timerfd_settime(2). Monkey only provides periodic
+ * timeouts, other systems create a new one every time the timer is armed.
  */
-static int schedule_request_now(int seconds,
-                                struct flb_sched_timer *timer,
-                                struct flb_sched_request *request,
-                                struct flb_config *config)
+static int sched_timeout_set(struct flb_sched *sched,
+                             struct flb_sched_timer *timer,
+                             uint64_t ns, int periodic,
+                             int type, int priority)
 {
-    flb_pipefd_t fd;
+    int fd;
     struct mk_event *event;
-    struct flb_sched *sched = config->sched;
+#ifdef __linux__
+    int ret;
+    struct itimerspec its;
+#endif
+
+    /* a zero timeout disarms the timer */
+    if (ns == 0) {
+        ns = 1;
+    }
 
-    /* Initialize event */
     event = &timer->event;
-    event->mask   = MK_EVENT_EMPTY;
-    event->status = MK_EVENT_NONE;
 
-    /* Create a timeout into the main event loop */
-    fd = mk_event_timeout_create(config->evl, seconds, 0, event);
-    event->priority = FLB_ENGINE_PRIORITY_CB_SCHED;
+#ifdef __linux__
+    if (timer->timer_fd == -1) {
+        fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (fd == -1) {
+            flb_errno();
+            return -1;
+        }
+
+        MK_EVENT_ZERO(event);
+        ret = mk_event_add(sched->evl, fd, type, MK_EVENT_READ, event);
+        if (ret == -1) {
+            close(fd);
+            return -1;
+        }
+        event->priority = priority;
+        timer->timer_fd = fd;
+    }
+
+    its.it_value.tv_sec = ns / 1000000000;
+    its.it_value.tv_nsec = ns % 1000000000;
+    if (periodic == FLB_TRUE) {
+        its.it_interval = its.it_value;
+    }
+    else {
+        its.it_interval.tv_sec = 0;
+        its.it_interval.tv_nsec = 0;
+    }
+
+    if (timerfd_settime(timer->timer_fd, 0, &its, NULL) == -1) {
+        flb_errno();
+        return -1;
+    }
+#else
+    (void) periodic;
+
+    if (timer->timer_fd != -1) {
+        mk_event_timeout_destroy(sched->evl, event);
+        timer->timer_fd = -1;
+    }
+
+    MK_EVENT_ZERO(event);
+    fd = mk_event_timeout_create(sched->evl,
+                                 ns / 1000000000, ns % 1000000000,
+                                 event);
     if (fd == -1) {
         return -1;
     }
-    request->fd = fd;
-    timer->timer_fd = fd;
+    event->priority = priority;
 
     /*
      * Note: mk_event_timeout_create() sets a type = MK_EVENT_NOTIFICATION by
      * default, we need to overwrite this value so we can do a clean check
      * into the Engine when the event is triggered.
      */
-    event->type = FLB_ENGINE_EV_SCHED;
-    mk_list_add(&request->_head, &sched->requests);
+    event->type = type;
+    timer->timer_fd = fd;
+#endif
 
     return 0;
 }
 
-/*
- * Enqueue a request that will wait until it expected timeout reach the
- * FLB_SCHED_REQUEST_FRAME interval.
- */
-static int schedule_request_wait(struct flb_sched_request *request,
-                                 struct flb_config *config)
+/* Stop a timer, on Linux its file descriptor is kept to be armed again */
+static void sched_timeout_stop(struct flb_sched *sched,
+                               struct flb_sched_timer *timer)
 {
-    struct flb_sched *sched = config->sched;
+#ifdef __linux__
+    struct itimerspec its;
 
-    mk_list_add(&request->_head, &sched->requests_wait);
-    return 0;
+    if (timer->timer_fd != -1) {
+        memset(&its, 0, sizeof(its));
+        timerfd_settime(timer->timer_fd, 0, &its, NULL);
+    }
+#else
+    if (timer->timer_fd != -1) {
+        mk_event_timeout_destroy(sched->evl, &timer->event);
+        timer->timer_fd = -1;
+    }
+#endif
+}
+
+/* Stop a timer and release its file descriptor */
+static void sched_timeout_destroy(struct flb_sched *sched,
+                                  struct flb_sched_timer *timer)
+{
+#ifdef __linux__
+    if (timer->timer_fd != -1) {
+        mk_event_del(sched->evl, &timer->event);
+        close(timer->timer_fd);
+        timer->timer_fd = -1;
+    }
+#else
+    sched_timeout_stop(sched, timer);
+#endif
 }
 
 /*
- * Iterate requests_wait list looking for candidates to be promoted
- * to the 'requests' list.
+ * Read the expirations of a timer. On Linux re-arming a timer resets the
+ * count, so it can be empty once its event is handled.
  */
-static int schedule_request_promote(struct flb_sched *sched)
+static void sched_timeout_consume(struct flb_sched_timer *timer)
+{
+#ifdef __linux__
+    uint64_t val;
+
+    if (read(timer->timer_fd, &val, sizeof(val)) == -1 && errno != EAGAIN) {
+        flb_errno();
+    }
+#else
+    timer_consume_byte(timer->timer_fd);
+#endif
+}
+
+/* Stop the frame timer, the wheel is not advanced until it's armed again */
+static void sched_frame_disarm(struct flb_sched *sched)
+{
+    if (sched->frame == NULL || sched->frame_armed == FLB_FALSE) {
+        return;
+    }
+
+    sched_timeout_stop(sched, sched->frame);
+    sched->frame_fd = sched->frame->timer_fd;
+    sched->frame_armed = FLB_FALSE;
+}
+
+/* Arm the frame timer to fire once, when the wheel must be advanced next */
+static void sched_frame_update(struct flb_sched *sched)
 {
     int ret;
-    int next;
-    int passed;
-    time_t now;
-    struct mk_list *tmp;
-    struct mk_list *head;
-    struct mk_list failed_requests;
-    struct flb_sched_request *request;
+    uint64_t now;
+    uint64_t due;
+    uint64_t tick;
+    uint64_t delay;
+    struct flb_sched_timer *frame;
 
-    now = time(NULL);
-    mk_list_init(&failed_requests);
+    frame = sched->frame;
+    if (frame == NULL || sched->frame_hold == FLB_TRUE) {
+        return;
+    }
 
-    mk_list_foreach_safe(head, tmp, &sched->requests_wait) {
-        request = mk_list_entry(head, struct flb_sched_request, _head);
+    ret = flb_timer_wheel_next(&sched->wheel, &tick);
+    if (ret == -1) {
+        /* nothing armed, don't wake up the event loop */
+        sched_frame_disarm(sched);
+        return;
+    }
 
-        /* First check how many seconds have passed since the request creation */
-        passed = (now - request->created);
-        ret = 0;
-
-        /* If we passed the original time, schedule now for the next second */
-        if (passed > request->timeout) {
-            mk_list_del(&request->_head);
-            ret = schedule_request_now(1, request->timer, request, sched->config);
-            if (ret != 0) {
-                mk_list_add(&request->_head, &failed_requests);
-            }
-        }
-        else if (passed + FLB_SCHED_REQUEST_FRAME >= request->timeout) {
-            /* Check if we should schedule within this frame */
-            mk_list_del(&request->_head);
-            next = labs(passed - request->timeout);
-            ret = schedule_request_now(next, request->timer, request, sched->config);
-            if (ret != 0) {
-                mk_list_add(&request->_head, &failed_requests);
-            }
-        }
-        else {
-            continue;
-        }
+    if (sched->frame_armed == FLB_TRUE && tick == sched->frame_tick) {
+        return;
+    }
 
-        /*
-         * If the 'request' could not be scheduled, this could only happen due to memory
-         * exhaustion or running out of file descriptors. There is no much we can do
-         * at this time.
-         */
-        if (ret == -1) {
-            flb_error("[sched] a 'retry request' could not be scheduled. the "
-                      "system might be running out of memory or file "
-                      "descriptors. The scheduler will do a retry later.");
-        }
+    /* time left until the tick is due */
+    now = cfl_time_now();
+    due = sched->wheel_base + (tick * FLB_SCHED_WHEEL_TICK * 1000000ULL);
+    delay = due > now ? due - now : 0;
+
+    ret = sched_timeout_set(sched, frame, delay, FLB_FALSE,
+                            FLB_ENGINE_EV_SCHED_FRAME,
+                            FLB_ENGINE_PRIORITY_CB_SCHED);
+    sched->frame_fd = frame->timer_fd;
+    if (ret == -1) {
+        flb_error("[sched] could not arm the timer wheel");
+        sched->frame_armed = FLB_FALSE;
+        return;
     }
 
-    /* For each failed request, re-add them to the wait list */
-    mk_list_foreach_safe(head, tmp, &failed_requests) {
-        request = mk_list_entry(head, struct flb_sched_request, _head);
-        mk_list_del(&request->_head);
-        mk_list_add(&request->_head, &sched->requests_wait);
+    sched->frame_armed = FLB_TRUE;
+    sched->frame_tick = tick;
+}
+
+/*
+ * Arm a timer into the wheel and update the frame timer if needed. The wheel
+ * is only advanced when the frame timer fires, so its position can be behind
+ * the clock: the timeout is counted from the current time instead, and from
+ * the next tick when the current one already started so it never fires early.
+ */
+static void sched_timer_arm(struct flb_sched *sched,
+                            struct flb_sched_timer *timer, uint64_t ticks)
+{
+    uint64_t now;
+    uint64_t tick;
+    uint64_t tick_ns;
+
+    tick_ns = (uint64_t) FLB_SCHED_WHEEL_TICK * 1000000;
+
+    now = cfl_time_now();
+    if (now > sched->wheel_base) {
+        tick = (now - sched->wheel_base) / tick_ns;
+        if (tick > sched->wheel.current) {
+            ticks += tick - sched->wheel.current;
+        }
+        if (tick >= sched->wheel.current &&
+            (now - sched->wheel_base) % tick_ns != 0) {
+            ticks++;
+        }
     }
 
-    return 0;
+    flb_timer_wheel_add(&sched->wheel, &timer->wheel_entry, ticks);
+    sched_frame_update(sched);
+}
+
+/* Arm a request so it's dispatched once the given seconds have passed */
+static void schedule_request_now(int seconds,
+                                 struct flb_sched_timer *timer,
+                                 struct flb_sched_request *request,
+                                 struct flb_sched *sched)
+{
+    sched_timer_arm(sched, timer, ms_to_ticks((uint64_t) seconds * 1000));
+    mk_list_add(&request->_head, &sched->requests);
 }
 
 static double ipow(double base, int exp)
@@ -265,7 +410,6 @@ static int backoff_full_jitter(int base, int cap, int n)
 /* Schedule the 'retry' for a thread buffer flush */
 int flb_sched_request_create(struct flb_config *config, void *data, int tries)
 {
-    int ret;
     int seconds;
     struct flb_sched_timer *timer;
     struct flb_sched_request *request;
@@ -280,6 +424,7 @@ int flb_sched_request_create(struct flb_config *config, void *data, int tries)
     request = flb_malloc(sizeof(struct flb_sched_request));
     if (!request) {
         flb_errno();
+        flb_sched_timer_destroy(timer);
         return -1;
     }
 
@@ -298,27 +443,12 @@ int flb_sched_request_create(struct flb_config *config, void *data, int tries)
     seconds += 1;
 
     /* Populare request */
-    request->fd      = -1;
     request->created = time(NULL);
     request->timeout = seconds;
     request->data    = data;
     request->timer   = timer;
 
-    /* Request to be placed into the sched_requests_wait list */
-    if (seconds > FLB_SCHED_REQUEST_FRAME) {
-        schedule_request_wait(request, config);
-    }
-    else {
-        ret = schedule_request_now(seconds, timer, request, config);
-        if (ret == -1) {
-            flb_error("[sched]  'retry request' could not be created. the "
-                      "system might be running out of memory or file "
-                      "descriptors.");
-            flb_sched_timer_destroy(timer);
-            flb_free(request);
-            return -1;
-        }
-    }
+    schedule_request_now(seconds, timer, request, config->sched);
 
     return seconds;
 }
@@ -365,60 +495,23 @@ int flb_sched_request_invalidate(struct flb_config *config, void *data)
         }
     }
 
-    /*
-     *  Clean up retry tasks that are scheduled more than 60s.
-     *  Task might be destroyed when there are still retry
-     *  scheduled but no thread is running for the task.
-     *
-     *  We need to drop buffered chunks when the filesystem buffer
-     *  limit is reached. We need to make sure that all requests
-     *  should be destroyed to avoid invoke an invlidated request.
-     */
-    mk_list_foreach_safe(head, tmp, &sched->requests_wait) {
-        request = mk_list_entry(head, struct flb_sched_request, _head);
-        if (request->data == data) {
-            flb_sched_request_destroy(request);
-            return 0;
-        }
-    }
-
     return -1;
 }
 
-/*
- * Depending on the backend that provides the timer, most of the time except
- * on event loops based on 'kqueue', we need to read the notification byte, which
- * usually comes from a file descriptor registered through the backend based on
- * epoll(), select() or poll().
- *
- * If we are NOT using kequeue, just read(2) the byte.
- */
-static inline int timer_consume_byte(int fd)
-{
-#ifndef FLB_EVENT_LOOP_KQUEUE
-    return consume_byte(fd);
-#endif
-
-    return 0;
-}
-
-/* Handle a timeout event set by a previous flb_sched_request_create(...) */
-int flb_sched_event_handler(struct flb_config *config, struct mk_event *event)
+/* Run the action of a timer that expired in the timer wheel */
+static void sched_timer_expired(struct flb_sched *sched,
+                                struct flb_sched_timer *timer)
 {
     int ret;
-    struct flb_sched *sched;
-    struct flb_sched_timer *timer;
+    int seconds;
+    struct flb_config *config;
     struct flb_sched_request *req;
 
-    timer = (struct flb_sched_timer *) event;
-    if (timer->active == FLB_FALSE) {
-        return 0;
-    }
+    config = sched->config;
 
     if (timer->type == FLB_SCHED_TIMER_REQUEST) {
         /* Map request struct */
         req = timer->data;
-        consume_byte(req->fd);
 
         /* Dispatch 'retry' */
         ret = flb_engine_dispatch_retry(req->data, config);
@@ -427,20 +520,119 @@ int flb_sched_event_handler(struct flb_config *config, struct mk_event *event)
         if (ret == 0) {
             flb_sched_request_destroy(req);
         }
+        else {
+            /* the retry could not be dispatched, try again later */
+            seconds = req->timeout > 0 ? req->timeout : 1;
+            sched_timer_arm(sched, timer, ms_to_ticks((uint64_t) seconds * 1000));
+        }
+    }
+    else if (timer->type == FLB_SCHED_TIMER_CB_ONESHOT) {
+        flb_sched_timer_cb_disable(timer);
+        timer->cb(config, timer->data);
+        flb_sched_timer_cb_destroy(timer);
     }
-    else if (timer->type == FLB_SCHED_TIMER_FRAME) {
+    else if (timer->type == FLB_SCHED_TIMER_CB_PERM) {
+        /* re-arm first, the callback might disable the timer */
+        sched_timer_arm(sched, timer, ms_to_ticks(timer->ms));
+        timer->cb(config, timer->data);
+    }
+}
+
+/*
+ * Advance the timer wheel up to the current time and run every timer that
+ * expired in the meantime.
+ */
+static void sched_wheel_tick(struct flb_sched *sched)
+{
+    uint64_t now;
+    uint64_t due;
+    uint64_t tick;
+    uint64_t tick_ns;
+    struct mk_list expired;
+    struct flb_sched_timer *timer;
+    struct flb_timer_wheel_entry *entry;
+
+    tick_ns = (uint64_t) FLB_SCHED_WHEEL_TICK * 1000000;
+    now = cfl_time_now();
+
+    /*
+     * The clock went backwards or jumped too far ahead: rebase the wheel
+     * time so the pending timers keep their relative distance.
+     */
+    if (now < sched->wheel_base ||
+        (now - sched->wheel_base) / tick_ns + 1 < sched->wheel.current ||
+        (now - sched->wheel_base) / tick_ns >
+        sched->wheel.current + FLB_TIMER_WHEEL_MAX_TICKS) {
+        sched->wheel_base = now - (sched->wheel.current * tick_ns);
+    }
+
+    /* every tick event moves the wheel at least one position */
+    tick = (now - sched->wheel_base) / tick_ns;
+    if (tick < sched->wheel.current) {
+        tick = sched->wheel.current;
+    }
+
+    due = sched->wheel_base + (tick * tick_ns);
+    sched->tick_lag = now > due ? now - due : 0;
+
+    mk_list_init(&expired);
+    flb_timer_wheel_expire(&sched->wheel, tick, &expired);
+
+    /*
+     * Entries are taken one by one: a callback can disable any other timer
+     * that is still waiting in the expired list.
+     */
+    while (mk_list_is_empty(&expired) != 0) {
+        entry = mk_list_entry_first(&expired, struct flb_timer_wheel_entry,
+                                    _head);
+        mk_list_del(&entry->_head);
+
+        timer = container_of(entry, struct flb_sched_timer, wheel_entry);
+        if (timer->active == FLB_FALSE) {
+            continue;
+        }
+
+        sched_timer_expired(sched, timer);
+    }
+}
+
+/*
+ * Handle the frame timer, triggered when the next wheel expiration is due,
+ * and the callback timers kept off the wheel.
+ */
+int flb_sched_event_handler(struct flb_config *config, struct mk_event *event)
+{
+    struct flb_sched *sched;
+    struct flb_sched_timer *timer;
+
+    timer = (struct flb_sched_timer *) event;
+    if (timer->active == FLB_FALSE) {
+        return 0;
+    }
+
+    if (timer->type == FLB_SCHED_TIMER_FRAME) {
         sched = timer->data;
-        timer_consume_byte(sched->frame_fd);
-        schedule_request_promote(sched);
+        sched_timeout_consume(timer);
+
+        /*
+         * Expired timers are re-armed or disabled while the wheel advances,
+         * the frame timer is updated once when all of them ran.
+         */
+        sched_frame_disarm(sched);
+        sched->frame_hold = FLB_TRUE;
+        sched_wheel_tick(sched);
+        sched->frame_hold = FLB_FALSE;
+        sched_frame_update(sched);
     }
     else if (timer->type == FLB_SCHED_TIMER_CB_ONESHOT) {
-        timer_consume_byte(timer->timer_fd);
+        /* callback timer with its own file descriptor */
+        sched_timeout_consume(timer);
         flb_sched_timer_cb_disable(timer);
         timer->cb(config, timer->data);
         flb_sched_timer_cb_destroy(timer);
     }
     else if (timer->type == FLB_SCHED_TIMER_CB_PERM) {
-        timer_consume_byte(timer->timer_fd);
+        sched_timeout_consume(timer);
         timer->cb(config, timer->data);
     }
 
@@ -453,15 +645,16 @@ int flb_sched_event_handler(struct flb_config *config, struct mk_event *event)
  * for re-tries.
  *
  * use-case: invoke function A() after M milliseconds.
+ *
+ * Timers are armed into the wheel when the interval is a multiple of
+ * FLB_SCHED_WHEEL_TICK. Shorter or finer ones, like the DNS lookup
+ * timeouts, would be rounded by the wheel: they get their own timer.
  */
 int flb_sched_timer_cb_create(struct flb_sched *sched, int type, int ms,
                               void (*cb)(struct flb_config *, void *),
                               void *data, struct flb_sched_timer **out_timer)
 {
-    int fd;
-    time_t sec;
-    long nsec;
-    struct mk_event *event;
+    int ret;
     struct flb_sched_timer *timer;
 
     if (type != FLB_SCHED_TIMER_CB_ONESHOT && type != FLB_SCHED_TIMER_CB_PERM) {
@@ -477,32 +670,23 @@ int flb_sched_timer_cb_create(struct flb_sched *sched, int type, int ms,
     timer->type = type;
     timer->data = data;
     timer->cb   = cb;
+    timer->ms   = ms;
 
-    /* Initialize event */
-    event = &timer->event;
-    event->mask   = MK_EVENT_EMPTY;
-    event->status = MK_EVENT_NONE;
-
-    /* Convert from milliseconds to seconds and nanoseconds */
-    sec = (ms / 1000);
-    nsec = ((ms % 1000) * 1000000);
-
-    /* Create the frame timer */
-    fd = mk_event_timeout_create(sched->evl, sec, nsec, event);
-    event->priority = FLB_ENGINE_PRIORITY_CB_TIMER;
-    if (fd == -1) {
-        flb_error("[sched] cannot do timeout_create()");
-        flb_sched_timer_destroy(timer);
-        return -1;
+    if (ms >= FLB_SCHED_WHEEL_TICK && ms % FLB_SCHED_WHEEL_TICK == 0) {
+        sched_timer_arm(sched, timer, ms_to_ticks(ms));
+    }
+    else {
+        ret = sched_timeout_set(sched, timer,
+                                (uint64_t) (ms > 0 ? ms : 1) * 1000000,
+                                type == FLB_SCHED_TIMER_CB_PERM,
+                                FLB_ENGINE_EV_SCHED,
+                                FLB_ENGINE_PRIORITY_CB_TIMER);
+        if (ret == -1) {
+            flb_error("[sched] cannot do timeout_create()");
+            flb_sched_timer_destroy(timer);
+            return -1;
+        }
     }
-
-    /*
-     * Note: mk_event_timeout_create() sets a type = MK_EVENT_NOTIFICATION by
-     * default, we need to overwrite this value so we can do a clean check
-     * into the Engine when the event is triggered.
-     */
-    event->type = FLB_ENGINE_EV_SCHED;
-    timer->timer_fd = fd;
 
     if (out_timer != NULL) {
         *out_timer = timer;
@@ -514,10 +698,26 @@ int flb_sched_timer_cb_create(struct flb_sched *sched, int type, int ms,
 /* Disable notifications, used before to destroy the context */
 int flb_sched_timer_cb_disable(struct flb_sched_timer *timer)
 {
+    int armed;
+    struct flb_sched *sched;
+
+    sched = timer->sched;
+
+    if (timer == sched->frame) {
+        sched_frame_disarm(sched);
+        return 0;
+    }
+
+    /* callback timer kept off the wheel */
     if (timer->timer_fd != -1) {
-        mk_event_timeout_destroy(timer->sched->evl, &timer->event);
+        sched_timeout_destroy(sched, timer);
+        return 0;
+    }
 
-        timer->timer_fd = -1;
+    armed = timer->wheel_entry.armed;
+    flb_timer_wheel_del(&sched->wheel, &timer->wheel_entry);
+    if (armed == FLB_TRUE) {
+        sched_frame_update(sched);
     }
 
     return 0;
@@ -534,8 +734,6 @@ int flb_sched_timer_cb_destroy(struct flb_sched_timer *timer)
 struct flb_sched *flb_sched_create(struct flb_config *config,
                                    struct mk_event_loop *evl)
 {
-    flb_pipefd_t fd;
-    struct mk_event *event;
     struct flb_sched *sched;
     struct flb_sched_timer *timer;
 
@@ -550,11 +748,18 @@ struct flb_sched *flb_sched_create(struct flb_config *config,
 
     /* Initialize lists */
     mk_list_init(&sched->requests);
-    mk_list_init(&sched->requests_wait);
     mk_list_init(&sched->timers);
     mk_list_init(&sched->timers_drop);
 
-    /* Create the frame timer who enqueue 'requests' for future time */
+    /* Initialize the timer wheel */
+    flb_timer_wheel_init(&sched->wheel);
+    sched->wheel_base = cfl_time_now();
+    sched->tick_lag = 0;
+
+    /*
+     * Create the frame timer who advances the timer wheel, it's only armed
+     * while there are timers in the wheel.
+     */
     timer = flb_sched_timer_create(sched);
     if (!timer) {
         flb_free(sched);
@@ -564,28 +769,11 @@ struct flb_sched *flb_sched_create(struct flb_config *config,
     timer->type = FLB_SCHED_TIMER_FRAME;
     timer->data = sched;
 
-    /* Initialize event */
-    event = &timer->event;
-    event->mask   = MK_EVENT_EMPTY;
-    event->status = MK_EVENT_NONE;
-
-    /* Create the frame timer */
-    fd = mk_event_timeout_create(evl, FLB_SCHED_REQUEST_FRAME, 0,
-                                 event);
-    event->priority = FLB_ENGINE_PRIORITY_CB_SCHED;
-    if (fd == -1) {
-        flb_sched_timer_destroy(timer);
-        flb_free(sched);
-        return NULL;
-    }
-    sched->frame_fd = fd;
-
-    /*
-     * Note: mk_event_timeout_create() sets a type = MK_EVENT_NOTIFICATION by
-     * default, we need to overwrite this value so we can do a clean check
-     * into the Engine when the event is triggered.
-     */
-    event->type = FLB_ENGINE_EV_SCHED_FRAME;
+    sched->frame = timer;
+    sched->frame_fd = -1;
+    sched->frame_tick = 0;
+    sched->frame_hold = FLB_FALSE;
+    sched->frame_armed = FLB_FALSE;
 
     return sched;
 }
@@ -603,14 +791,16 @@ int flb_sched_destroy(struct flb_sched *sched)
         return 0;
     }
 
-    mk_list_foreach_safe(head, tmp, &sched->requests) {
-        request = mk_list_entry(head, struct flb_sched_request, _head);
-        flb_sched_request_destroy(request);
-        c++; /* evil counter */
-    }
+    /* stop the frame timer first, nothing is re-armed from here */
+    timer = sched->frame;
+    sched_frame_disarm(sched);
+    sched_timeout_destroy(sched, timer);
+    sched->frame = NULL;
+    sched->frame_fd = -1;
+    flb_sched_timer_destroy(timer);
+    c++;
 
-    /* Delete requests on wait list */
-    mk_list_foreach_safe(head, tmp, &sched->requests_wait) {
+    mk_list_foreach_safe(head, tmp, &sched->requests) {
         request = mk_list_entry(head, struct flb_sched_request, _head);
         flb_sched_request_destroy(request);
         c++; /* evil counter */
@@ -619,7 +809,6 @@ int flb_sched_destroy(struct flb_sched *sched)
     /* Delete timers */
     mk_list_foreach_safe(head, tmp, &sched->timers) {
         timer = mk_list_entry(head, struct flb_sched_timer, _head);
-        mk_event_timeout_destroy(sched->evl, &timer->event);
         flb_sched_timer_destroy(timer);
         c++;
     }
@@ -647,6 +836,7 @@ struct flb_sched_timer *flb_sched_timer_create(struct flb_sched *sched)
         return NULL;
     }
     MK_EVENT_ZERO(&timer->event);
+    flb_timer_wheel_entry_init(&timer->wheel_entry);
 
     timer->timer_fd = -1;
     timer->config = sched->config;
@@ -701,7 +891,6 @@ int flb_sched_timer_cleanup(struct flb_sched *sched)
 int flb_sched_retry_now(struct flb_config *config,
                         struct flb_task_retry *retry)
 {
-    int ret;
     struct flb_sched_timer *timer;
     struct flb_sched_request *request;
 
@@ -725,20 +914,25 @@ int flb_sched_retry_now(struct flb_config *config,
     timer->event.mask = MK_EVENT_EMPTY;
 
     /* Populate request */
-    request->fd      = -1;
     request->created = time(NULL);
     request->timeout = 0;
     request->data    = retry;
     request->timer   = timer;
 
-    ret = schedule_request_now(0 /* seconds */, timer, request, config);
-    if (ret == -1) {
-        flb_error("[sched] 'retry-now request' could not be created. the "
-                  "system might be running out of memory or file "
-                  "descirptors.");
-        flb_sched_timer_destroy(timer);
-        flb_free(request);
-        return -1;
-    }
+    /* dispatched on the next wheel tick */
+    schedule_request_now(0 /* seconds */, timer, request, config->sched);
+
     return 0;
 }
+
+/* Number of timers currently armed in the timer wheel */
+size_t flb_sched_timers_armed(struct flb_sched *sched)
+{
+    return flb_timer_wheel_armed(&sched->wheel);
+}
+
+/* Delay between the last wheel tick due time and its processing (ns) */
+uint64_t flb_sched_tick_lag(struct flb_sched *sched)
+{
+    return sched->tick_lag;
+}
@@ -402,9 +402,7 @@ struct flb_task *flb_task_create(uint64_t ref_id,
     task->ic     = ic;
     mk_list_add(&task->_head, &i_ins->tasks);
 
-#ifdef FLB_HAVE_METRICS
     task->records = ((struct flb_input_chunk *) ic)->total_records;
-#endif
 
     /* Direct connects betweek input <> outputs (API based) */
     if (mk_list_size(&i_ins->routes_direct) > 0) {
@@ -437,7 +435,8 @@ struct flb_task *flb_task_create(uint64_t ref_id,
             continue;
         }
 
-        if (flb_routes_mask_get_bit(task_ic->routes_mask, o_ins->id) != 0) {
+        if (flb_routes_mask_get_bit(task_ic->routes_mask, o_ins->id,
+                                    config) != 0) {
             route = flb_calloc(1, sizeof(struct flb_task_route));
             if (!route) {
                 flb_errno();
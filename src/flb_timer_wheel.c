@@ -0,0 +1,218 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_timer_wheel.h>
+
+/* Slot index of 'tick' on the given level */
+#define WHEEL_INDEX(tick, level) \
+    (((tick) >> ((level) * FLB_TIMER_WHEEL_SLOT_BITS)) & FLB_TIMER_WHEEL_SLOT_MASK)
+
+void flb_timer_wheel_init(struct flb_timer_wheel *wheel)
+{
+    int level;
+    int slot;
+
+    wheel->current = 0;
+    wheel->armed = 0;
+
+    for (level = 0; level < FLB_TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < FLB_TIMER_WHEEL_SLOTS; slot++) {
+            mk_list_init(&wheel->slots[level][slot]);
+        }
+    }
+}
+
+void flb_timer_wheel_entry_init(struct flb_timer_wheel_entry *entry)
+{
+    entry->armed = FLB_FALSE;
+    entry->expires = 0;
+    mk_list_entry_init(&entry->_head);
+}
+
+/* Link the entry into the slot that matches its distance to 'current' */
+static void wheel_place(struct flb_timer_wheel *wheel,
+                        struct flb_timer_wheel_entry *entry)
+{
+    int level;
+    uint64_t delta;
+
+    delta = entry->expires - wheel->current;
+
+    for (level = 0; level < FLB_TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < (1ULL << ((level + 1) * FLB_TIMER_WHEEL_SLOT_BITS))) {
+            break;
+        }
+    }
+
+    mk_list_add(&entry->_head,
+                &wheel->slots[level][WHEEL_INDEX(entry->expires, level)]);
+}
+
+void flb_timer_wheel_add(struct flb_timer_wheel *wheel,
+                         struct flb_timer_wheel_entry *entry, uint64_t ticks)
+{
+    if (entry->armed == FLB_TRUE) {
+        flb_timer_wheel_del(wheel, entry);
+    }
+
+    if (ticks > FLB_TIMER_WHEEL_MAX_TICKS) {
+        ticks = FLB_TIMER_WHEEL_MAX_TICKS;
+    }
+
+    entry->expires = wheel->current + ticks;
+    entry->armed = FLB_TRUE;
+    wheel_place(wheel, entry);
+    wheel->armed++;
+}
+
+/*
+ * Disarm the entry. It's also unlinked if it was already expired but is
+ * still waiting in the caller 'expired' list.
+ */
+void flb_timer_wheel_del(struct flb_timer_wheel *wheel,
+                         struct flb_timer_wheel_entry *entry)
+{
+    if (mk_list_is_set(&entry->_head) == 0) {
+        mk_list_del(&entry->_head);
+    }
+
+    if (entry->armed == FLB_TRUE) {
+        entry->armed = FLB_FALSE;
+        wheel->armed--;
+    }
+}
+
+/* Move the entries of an upper level slot down to their new position */
+static int wheel_cascade(struct flb_timer_wheel *wheel, int level, int index)
+{
+    struct mk_list *tmp;
+    struct mk_list *head;
+    struct mk_list *slot;
+    struct flb_timer_wheel_entry *entry;
+
+    slot = &wheel->slots[level][index];
+    mk_list_foreach_safe(head, tmp, slot) {
+        entry = mk_list_entry(head, struct flb_timer_wheel_entry, _head);
+        mk_list_del(&entry->_head);
+        wheel_place(wheel, entry);
+    }
+
+    return index;
+}
+
+/*
+ * Get the next tick the wheel must be advanced to. It's exact for entries in
+ * level 0; entries in upper levels report the tick where their slot is
+ * cascaded, which is never later than their expiration. Returns -1 if no
+ * entry is armed.
+ */
+int flb_timer_wheel_next(struct flb_timer_wheel *wheel, uint64_t *tick)
+{
+    int i;
+    int level;
+    int shift;
+    int found = FLB_FALSE;
+    uint64_t t;
+    uint64_t base;
+
+    if (wheel->armed == 0) {
+        return -1;
+    }
+
+    /* level 0: the first used slot starting at the current tick */
+    for (i = 0; i < FLB_TIMER_WHEEL_SLOTS; i++) {
+        t = wheel->current + i;
+        if (mk_list_is_empty(&wheel->slots[0][WHEEL_INDEX(t, 0)]) != 0) {
+            *tick = t;
+            found = FLB_TRUE;
+            break;
+        }
+    }
+
+    /* upper levels: the first boundary that cascades a used slot */
+    for (level = 1; level < FLB_TIMER_WHEEL_LEVELS; level++) {
+        shift = level * FLB_TIMER_WHEEL_SLOT_BITS;
+        base = (wheel->current + (1ULL << shift) - 1) >> shift;
+
+        for (i = 0; i < FLB_TIMER_WHEEL_SLOTS; i++) {
+            t = (base + i) << shift;
+            if (found == FLB_TRUE && t >= *tick) {
+                break;
+            }
+
+            if (mk_list_is_empty(&wheel->slots[level][WHEEL_INDEX(t, level)]) != 0) {
+                *tick = t;
+                found = FLB_TRUE;
+                break;
+            }
+        }
+    }
+
+    return found == FLB_TRUE ? 0 : -1;
+}
+
+/*
+ * Advance the wheel processing every tick up to (and including) 'tick'.
+ * Expired entries are disarmed and moved into the 'expired' list, the
+ * caller owns them from that point. Returns the number of expired entries.
+ */
+int flb_timer_wheel_expire(struct flb_timer_wheel *wheel, uint64_t tick,
+                           struct mk_list *expired)
+{
+    int c = 0;
+    int level;
+    int index;
+    struct mk_list *tmp;
+    struct mk_list *head;
+    struct flb_timer_wheel_entry *entry;
+
+    while (wheel->current <= tick) {
+        /* nothing armed, jump straight to the target */
+        if (wheel->armed == 0) {
+            wheel->current = tick + 1;
+            break;
+        }
+
+        index = WHEEL_INDEX(wheel->current, 0);
+
+        /* level 0 wrapped around, pull down the next batch from upper levels */
+        if (index == 0) {
+            for (level = 1; level < FLB_TIMER_WHEEL_LEVELS; level++) {
+                if (wheel_cascade(wheel, level,
+                                  WHEEL_INDEX(wheel->current, level)) != 0) {
+                    break;
+                }
+            }
+        }
+
+        mk_list_foreach_safe(head, tmp, &wheel->slots[0][index]) {
+            entry = mk_list_entry(head, struct flb_timer_wheel_entry, _head);
+            mk_list_del(&entry->_head);
+            entry->armed = FLB_FALSE;
+            wheel->armed--;
+            mk_list_add(&entry->_head, expired);
+            c++;
+        }
+
+        wheel->current++;
+    }
+
+    return c;
+}
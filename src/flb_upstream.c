@@ -25,6 +25,8 @@
 #include <fluent-bit/flb_str.h>
 #include <fluent-bit/flb_upstream.h>
 #include <fluent-bit/flb_io.h>
+#include <fluent-bit/flb_coro.h>
+#include <fluent-bit/flb_http_client_http2.h>
 #include <fluent-bit/tls/flb_tls.h>
 #include <fluent-bit/flb_utils.h>
 #include <fluent-bit/flb_engine.h>
@@ -104,12 +106,35 @@ struct flb_config_map upstream_net[] = {
      "before it is retried."
     },
 
+    {
+     FLB_CONFIG_MAP_INT, "net.keepalive_min_idle", "0",
+     0, FLB_TRUE, offsetof(struct flb_net_setup, keepalive_min_idle),
+     "Set the minimum number of idle keepalive connections kept open per "
+     "worker thread, they are established in background so a burst of "
+     "flushes does not have to wait for new connections."
+    },
+
     {
      FLB_CONFIG_MAP_INT, "net.max_worker_connections", "0",
      0, FLB_TRUE, offsetof(struct flb_net_setup, max_worker_connections),
      "Set the maximum number of active TCP connections that can be used per worker thread."
     },
 
+    {
+     FLB_CONFIG_MAP_BOOL, "net.http2", "false",
+     0, FLB_TRUE, offsetof(struct flb_net_setup, http2),
+     "Send HTTP requests over HTTP/2: TLS connections negotiate it through ALPN "
+     "and fallback to HTTP/1.1, plain connections use HTTP/2 with prior "
+     "knowledge. Concurrent requests share the same connection."
+    },
+
+    {
+     FLB_CONFIG_MAP_INT, "net.http2.max_concurrent_streams", "100",
+     0, FLB_TRUE, offsetof(struct flb_net_setup, http2_max_streams),
+     "Set the maximum number of concurrent requests sent over one HTTP/2 "
+     "connection, the limit announced by the server is honored too."
+    },
+
     /* EOF */
     {0}
 };
@@ -129,6 +154,9 @@ static void flb_upstream_increment_total_connections_count(
 static void flb_upstream_decrement_total_connections_count(
                 struct flb_upstream *stream);
 
+static void flb_upstream_observe_wait_time(struct flb_upstream *stream,
+                                           uint64_t ts_start);
+
 /* Enable thread-safe mode for upstream connection */
 void flb_upstream_thread_safe(struct flb_upstream *u)
 {
@@ -189,6 +217,50 @@ void flb_upstream_queue_init(struct flb_upstream_queue *uq)
     mk_list_init(&uq->av_queue);
     mk_list_init(&uq->busy_queue);
     mk_list_init(&uq->destroy_queue);
+    uq->prewarm = NULL;
+}
+
+/*
+ * The queues of the output workers are only used by their own thread, the
+ * stream mutex is only needed for the queue owned by the upstream.
+ */
+static inline void queue_lock(struct flb_upstream *u,
+                              struct flb_upstream_queue *uq)
+{
+    if (uq == &u->queue) {
+        flb_stream_acquire_lock(&u->base, FLB_TRUE);
+    }
+}
+
+static inline void queue_unlock(struct flb_upstream *u,
+                                struct flb_upstream_queue *uq)
+{
+    if (uq == &u->queue) {
+        flb_stream_release_lock(&u->base);
+    }
+}
+
+/* Background connections of a queue, see 'net.keepalive_min_idle' */
+struct flb_upstream_prewarm {
+    int count;                      /* connections left to establish */
+    int done;                       /* the coroutine has finished    */
+    struct flb_upstream *u;
+    struct flb_coro *coro;
+};
+
+static void prewarm_destroy(struct flb_upstream_queue *uq)
+{
+    struct flb_upstream_prewarm *prewarm = uq->prewarm;
+
+    if (!prewarm) {
+        return;
+    }
+
+    if (prewarm->coro) {
+        flb_coro_destroy(prewarm->coro);
+    }
+    flb_free(prewarm);
+    uq->prewarm = NULL;
 }
 
 struct flb_upstream_queue *flb_upstream_queue_get(struct flb_upstream *u)
@@ -518,12 +590,16 @@ static int prepare_destroy_conn(struct flb_connection *u_conn)
 static inline int prepare_destroy_conn_safe(struct flb_connection *u_conn)
 {
     int ret;
+    struct flb_upstream *u = u_conn->upstream;
+    struct flb_upstream_queue *uq;
+
+    uq = flb_upstream_queue_get(u);
 
-    flb_stream_acquire_lock(u_conn->stream, FLB_TRUE);
+    queue_lock(u, uq);
 
     ret = prepare_destroy_conn(u_conn);
 
-    flb_stream_release_lock(u_conn->stream);
+    queue_unlock(u, uq);
 
     return ret;
 }
@@ -537,6 +613,10 @@ static int destroy_conn(struct flb_connection *u_conn)
 
     mk_list_del(&u_conn->_head);
 
+    if (u_conn->http2_session != NULL) {
+        flb_http2_client_session_destroy(u_conn->http2_session);
+    }
+
     flb_connection_destroy(u_conn);
 
     return 0;
@@ -569,15 +649,16 @@ static struct flb_connection *create_conn(struct flb_upstream *u)
         flb_upstream_conn_recycle(conn, FLB_FALSE);
     }
 
-    flb_stream_acquire_lock(&u->base, FLB_TRUE);
+    uq = flb_upstream_queue_get(u);
+
+    queue_lock(u, uq);
 
     /* Link new connection to the busy queue */
-    uq = flb_upstream_queue_get(u);
     mk_list_add(&conn->_head, &uq->busy_queue);
 
     flb_upstream_increment_total_connections_count(u);
 
-    flb_stream_release_lock(&u->base);
+    queue_unlock(u, uq);
 
     flb_connection_reset_connection_timeout(conn);
 
@@ -597,6 +678,20 @@ static struct flb_connection *create_conn(struct flb_upstream *u)
 
     flb_connection_unset_connection_timeout(conn);
 
+    /* HTTP/2 session, TLS connections might have fallen back to HTTP/1.1 */
+    if (u->base.net.http2 == FLB_TRUE) {
+        ret = flb_http2_client_session_create(conn);
+        if (ret == -1) {
+            flb_error("[upstream] connection #%i to %s:%i: cannot create "
+                      "HTTP/2 session", conn->fd, u->tcp_host, u->tcp_port);
+
+            prepare_destroy_conn_safe(conn);
+            conn->busy_flag = FLB_FALSE;
+
+            return NULL;
+        }
+    }
+
     if (flb_stream_is_keepalive(&u->base)) {
         flb_debug("[upstream] KA connection #%i to %s:%i is connected",
                   conn->fd, u->tcp_host, u->tcp_port);
@@ -635,11 +730,17 @@ int flb_upstream_destroy(struct flb_upstream *u)
         destroy_conn(u_conn);
     }
 
+    prewarm_destroy(uq);
+
     flb_free(u->tcp_host);
     flb_free(u->proxied_host);
     flb_free(u->proxy_username);
     flb_free(u->proxy_password);
-    mk_list_del(&u->base._head);
+
+    /* thread safe upstreams are not linked unless their owner did it */
+    if (mk_list_entry_orphan(&u->base._head) == 0) {
+        mk_list_del(&u->base._head);
+    }
     flb_free(u);
 
     return 0;
@@ -655,9 +756,70 @@ int flb_upstream_conn_recycle(struct flb_connection *conn, int val)
     return -1;
 }
 
-struct flb_connection *flb_upstream_conn_get(struct flb_upstream *u)
+/* Look for a busy HTTP/2 connection that can take one more stream */
+static struct flb_connection *http2_conn_get(struct flb_upstream *u,
+                                             struct flb_upstream_queue *uq)
+{
+    struct mk_list *head;
+    struct flb_connection *conn = NULL;
+    struct flb_connection *entry;
+
+    queue_lock(u, uq);
+
+    mk_list_foreach(head, &uq->busy_queue) {
+        entry = mk_list_entry(head, struct flb_connection, _head);
+
+        if (entry->http2_session != NULL &&
+            entry->net_error == -1 &&
+            flb_http2_client_session_available(entry->http2_session)) {
+            conn = entry;
+            conn->http2_session->users++;
+            break;
+        }
+    }
+
+    queue_unlock(u, uq);
+
+    if (conn != NULL) {
+        flb_debug("[upstream] HTTP/2 connection #%i to %s:%i has been "
+                  "assigned (%i concurrent users)",
+                  conn->fd, u->tcp_host, u->tcp_port,
+                  conn->http2_session->users);
+    }
+
+    return conn;
+}
+
+/*
+ * Check an idle keepalive connection: a connection closed by the remote end
+ * reads as end of file. Pending data is left in place, TLS records like the
+ * session tickets might arrive while the connection is idle.
+ */
+static int conn_is_alive(struct flb_connection *conn)
 {
     int err;
+#ifdef MSG_DONTWAIT
+    char c;
+    ssize_t ret;
+#endif
+
+    err = flb_socket_error(conn->fd);
+    if (!FLB_EINPROGRESS(err) && err != 0) {
+        return FLB_FALSE;
+    }
+
+#ifdef MSG_DONTWAIT
+    ret = recv(conn->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (ret == 0 || (ret == -1 && !FLB_WOULDBLOCK())) {
+        return FLB_FALSE;
+    }
+#endif
+
+    return FLB_TRUE;
+}
+
+static struct flb_connection *upstream_conn_get(struct flb_upstream *u)
+{
     int total_connections = 0;
     struct mk_list *tmp;
     struct mk_list *head;
@@ -666,6 +828,18 @@ struct flb_connection *flb_upstream_conn_get(struct flb_upstream *u)
 
     uq = flb_upstream_queue_get(u);
 
+    /*
+     * HTTP/2 connections multiplex the requests: while a busy connection of
+     * this worker has room for more concurrent streams, it's shared with
+     * the new caller.
+     */
+    if (u->base.net.http2 == FLB_TRUE) {
+        conn = http2_conn_get(u, uq);
+        if (conn != NULL) {
+            return conn;
+        }
+    }
+
     flb_trace("[upstream] get new connection for %s:%i, net setup:\n"
               "net.connect_timeout        = %i seconds\n"
               "net.source_address         = %s\n"
@@ -704,9 +878,9 @@ struct flb_connection *flb_upstream_conn_get(struct flb_upstream *u)
          */
 
         /* Count the number of relevant connections */
-        flb_stream_acquire_lock(&u->base, FLB_TRUE);
+        queue_lock(u, uq);
         total_connections = mk_list_size(&uq->busy_queue);
-        flb_stream_release_lock(&u->base);
+        queue_unlock(u, uq);
 
         if (total_connections >= u->base.net.max_worker_connections) {
             flb_debug("[upstream] max worker connections=%i reached to: %s:%i, cannot connect",
@@ -726,17 +900,15 @@ struct flb_connection *flb_upstream_conn_get(struct flb_upstream *u)
         mk_list_foreach_safe(head, tmp, &uq->av_queue) {
             conn = mk_list_entry(head, struct flb_connection, _head);
 
-            flb_stream_acquire_lock(&u->base, FLB_TRUE);
+            queue_lock(u, uq);
 
             /* This connection works, let's move it to the busy queue */
             mk_list_del(&conn->_head);
             mk_list_add(&conn->_head, &uq->busy_queue);
 
-            flb_stream_release_lock(&u->base);
+            queue_unlock(u, uq);
 
-            err = flb_socket_error(conn->fd);
-
-            if (!FLB_EINPROGRESS(err) && err != 0) {
+            if (!conn_is_alive(conn)) {
                 flb_debug("[upstream] KA connection #%i is in a failed state "
                           "to: %s:%i, cleaning up",
                           conn->fd, u->tcp_host, u->tcp_port);
@@ -777,6 +949,25 @@ struct flb_connection *flb_upstream_conn_get(struct flb_upstream *u)
     if (conn != NULL) {
         flb_connection_reset_io_timeout(conn);
         flb_upstream_increment_busy_connections_count(u);
+
+        if (conn->http2_session != NULL) {
+            conn->http2_session->users = 1;
+        }
+    }
+
+    return conn;
+}
+
+struct flb_connection *flb_upstream_conn_get(struct flb_upstream *u)
+{
+    uint64_t ts;
+    struct flb_connection *conn;
+
+    ts = cfl_time_now();
+
+    conn = upstream_conn_get(u);
+    if (conn != NULL) {
+        flb_upstream_observe_wait_time(u, ts);
     }
 
     return conn;
@@ -804,6 +995,16 @@ int flb_upstream_conn_release(struct flb_connection *conn)
     struct flb_upstream *u = conn->upstream;
     struct flb_upstream_queue *uq;
 
+    /* Shared HTTP/2 connection: it's released by its last user */
+    if (conn->http2_session != NULL && conn->http2_session->users > 1) {
+        conn->http2_session->users--;
+        return 0;
+    }
+
+    if (conn->http2_session != NULL) {
+        conn->http2_session->users = 0;
+    }
+
     flb_upstream_decrement_busy_connections_count(u);
 
     uq = flb_upstream_queue_get(u);
@@ -817,12 +1018,12 @@ int flb_upstream_conn_release(struct flb_connection *conn)
          * This connection is still useful, move it to the 'available' queue and
          * initialize variables.
          */
-        flb_stream_acquire_lock(&u->base, FLB_TRUE);
+        queue_lock(u, uq);
 
         mk_list_del(&conn->_head);
         mk_list_add(&conn->_head, &uq->av_queue);
 
-        flb_stream_release_lock(&u->base);
+        queue_unlock(u, uq);
 
         conn->ts_available = time(NULL);
 
@@ -870,6 +1071,115 @@ int flb_upstream_conn_release(struct flb_connection *conn)
     return prepare_destroy_conn_safe(conn);
 }
 
+/* Establish connections and make them available, it runs in a coroutine */
+static void cb_upstream_prewarm()
+{
+    struct flb_coro *coro = flb_coro_get();
+    struct flb_upstream_prewarm *prewarm = coro->data;
+    struct flb_upstream *u = prewarm->u;
+    struct flb_connection *conn;
+
+    while (prewarm->count > 0 && !flb_upstream_is_shutting_down(u)) {
+        conn = create_conn(u);
+        if (!conn) {
+            break;
+        }
+        prewarm->count--;
+
+        flb_debug("[upstream] connection #%i to %s:%i has been pre-warmed",
+                  conn->fd, u->tcp_host, u->tcp_port);
+
+        /* the next user will resume its own coroutine */
+        conn->coroutine = NULL;
+
+        flb_upstream_increment_busy_connections_count(u);
+        flb_upstream_conn_release(conn);
+    }
+
+    prewarm->done = FLB_TRUE;
+    flb_coro_yield(coro, FLB_TRUE);
+}
+
+/*
+ * Keep at least 'net.keepalive_min_idle' connections in the available queue,
+ * the missing ones are established by a coroutine so the event loop is not
+ * blocked. Only one coroutine runs per queue.
+ */
+static void upstream_prewarm(struct flb_upstream *u,
+                             struct flb_upstream_queue *uq)
+{
+    int count;
+    int busy;
+    size_t stack_size;
+    struct flb_coro *coro;
+    struct flb_coro *current;
+    struct flb_upstream_prewarm *prewarm;
+
+    if (uq->prewarm != NULL) {
+        if (!uq->prewarm->done) {
+            return;
+        }
+        prewarm_destroy(uq);
+    }
+
+    if (!u->base.net.keepalive || u->base.net.keepalive_min_idle <= 0 ||
+        !flb_stream_is_keepalive(&u->base) || !flb_upstream_is_async(u) ||
+        flb_upstream_is_shutting_down(u) ||
+        flb_engine_evl_get() == NULL) {
+        return;
+    }
+
+    queue_lock(u, uq);
+    count = u->base.net.keepalive_min_idle - mk_list_size(&uq->av_queue);
+    busy = mk_list_size(&uq->busy_queue);
+    queue_unlock(u, uq);
+
+    if (u->base.net.max_worker_connections > 0 &&
+        busy + count > u->base.net.max_worker_connections) {
+        count = u->base.net.max_worker_connections - busy;
+    }
+
+    if (count <= 0) {
+        return;
+    }
+
+    prewarm = flb_calloc(1, sizeof(struct flb_upstream_prewarm));
+    if (!prewarm) {
+        flb_errno();
+        return;
+    }
+    prewarm->u = u;
+    prewarm->count = count;
+
+    coro = flb_coro_create(prewarm);
+    if (!coro) {
+        flb_free(prewarm);
+        return;
+    }
+    prewarm->coro = coro;
+
+    coro->caller = co_active();
+    coro->callee = co_create(u->base.config->coro_stack_size,
+                             cb_upstream_prewarm, &stack_size);
+    if (coro->callee == NULL) {
+        flb_coro_destroy(coro);
+        flb_free(prewarm);
+        return;
+    }
+
+#ifdef FLB_HAVE_VALGRIND
+    coro->valgrind_stack_id = \
+        VALGRIND_STACK_REGISTER(coro->callee, ((char *) coro->callee) + stack_size);
+#endif
+
+    uq->prewarm = prewarm;
+
+    /* runs until the first connection is in progress */
+    current = flb_coro_get();
+    flb_coro_resume(coro);
+    flb_coro_set(current);
+}
+
 int flb_upstream_conn_timeouts(struct mk_list *list)
 {
     time_t now;
@@ -890,7 +1200,7 @@ int flb_upstream_conn_timeouts(struct mk_list *list)
         u = mk_list_entry(head, struct flb_upstream, base._head);
         uq = flb_upstream_queue_get(u);
 
-        flb_stream_acquire_lock(&u->base, FLB_TRUE);
+        queue_lock(u, uq);
 
         /* Iterate every busy connection */
         mk_list_foreach_safe(u_head, tmp, &uq->busy_queue) {
@@ -986,11 +1296,22 @@ int flb_upstream_conn_timeouts(struct mk_list *list)
             }
         }
 
-        /* Check every available Keepalive connection */
+        /*
+         * Check every available Keepalive connection, the oldest ones come
+         * first. The idle timeout does not apply to the last connections
+         * required by 'net.keepalive_min_idle'.
+         */
         mk_list_foreach_safe(u_head, tmp, &uq->av_queue) {
             u_conn = mk_list_entry(u_head, struct flb_connection, _head);
 
-            if ((now - u_conn->ts_available) >= u->base.net.keepalive_idle_timeout) {
+            if (!conn_is_alive(u_conn)) {
+                flb_debug("[upstream] drop keepalive connection #%i to %s:%i "
+                          "(closed while idle)",
+                          u_conn->fd, u->tcp_host, u->tcp_port);
+                prepare_destroy_conn(u_conn);
+            }
+            else if ((now - u_conn->ts_available) >= u->base.net.keepalive_idle_timeout &&
+                     mk_list_size(&uq->av_queue) > u->base.net.keepalive_min_idle) {
                 prepare_destroy_conn(u_conn);
                 flb_debug("[upstream] drop keepalive connection #%i to %s:%i "
                           "(keepalive idle timeout)",
@@ -998,7 +1319,9 @@ int flb_upstream_conn_timeouts(struct mk_list *list)
             }
         }
 
-        flb_stream_release_lock(&u->base);
+        queue_unlock(u, uq);
+
+        upstream_prewarm(u, uq);
     }
 
     return 0;
@@ -1013,7 +1336,7 @@ int flb_upstream_conn_pending_destroy(struct flb_upstream *u)
 
     uq = flb_upstream_queue_get(u);
 
-    flb_stream_acquire_lock(&u->base, FLB_TRUE);
+    queue_lock(u, uq);
 
     /* Real destroy of connections context */
     mk_list_foreach_safe(head, tmp, &uq->destroy_queue) {
@@ -1022,7 +1345,7 @@ int flb_upstream_conn_pending_destroy(struct flb_upstream *u)
         destroy_conn(u_conn);
     }
 
-    flb_stream_release_lock(&u->base);
+    queue_unlock(u, uq);
 
     return 0;
 }
@@ -1212,3 +1535,48 @@ static void flb_upstream_decrement_busy_connections_count(
         }
     }
 }
+
+void flb_upstream_set_wait_time_label(
+        struct flb_upstream *stream,
+        const char *label_value)
+{
+    stream->cmt_wait_time_label = label_value;
+}
+
+void flb_upstream_set_wait_time_histogram(
+        struct flb_upstream *stream,
+        struct cmt_histogram *histogram_instance)
+{
+    stream->cmt_wait_time = histogram_instance;
+}
+
+/* Time spent by a caller to get a connection, it includes new connections */
+static void flb_upstream_observe_wait_time(struct flb_upstream *stream,
+                                           uint64_t ts_start)
+{
+    uint64_t now;
+
+    if (stream->parent_upstream != NULL) {
+        stream = (struct flb_upstream *) stream->parent_upstream;
+    }
+
+    if (stream->cmt_wait_time == NULL) {
+        return;
+    }
+
+    now = cfl_time_now();
+
+    if (stream->cmt_wait_time_label != NULL) {
+        cmt_histogram_observe(stream->cmt_wait_time, now,
+                              (double) (now - ts_start) / 1000000000.0,
+                              1,
+                              (char *[]) {
+                                  (char *) stream->cmt_wait_time_label
+                              });
+    }
+    else {
+        cmt_histogram_observe(stream->cmt_wait_time, now,
+                              (double) (now - ts_start) / 1000000000.0,
+                              0, NULL);
+    }
+}
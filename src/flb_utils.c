@@ -35,6 +35,7 @@
 #include <fluent-bit/flb_output.h>
 #include <fluent-bit/flb_utils.h>
 #include <fluent-bit/flb_utf8.h>
+#include <fluent-bit/flb_simd.h>
 
 #ifdef FLB_HAVE_AWS_ERROR_REPORTER
 #include <fluent-bit/aws/flb_aws_error_reporter.h>
@@ -752,19 +753,23 @@ static inline void encoded_to_buf(char *out, const char *in, int len)
     }
 }
 
+#define UTILS_UTF8_TRUNCATED  -1
+#define UTILS_UTF8_NO_SPACE   -2
+
 /*
- * Write string pointed by 'str' to the destination buffer 'buf'. It's make sure
- * to escape sepecial characters and convert utf-8 byte characters to string
- * representation.
+ * Write the non-ASCII character found at str[*i], 'c' is the value read by
+ * the caller. On return *i points to the last consumed byte. Returns the
+ * number of bytes written, UTILS_UTF8_TRUNCATED if the UTF-8 sequence is
+ * truncated (the remaining bytes are skipped) or UTILS_UTF8_NO_SPACE when
+ * 'available' is not enough.
  */
-int flb_utils_write_str(char *buf, int *off, size_t size,
-                        const char *str, size_t str_len)
+static int utils_write_utf8(char *buf, uint32_t c,
+                            const char *str, size_t str_len, int *idx,
+                            size_t available)
 {
     int i;
     int b;
     int ret;
-    int written = 0;
-    int required;
     int len;
     int hex_bytes;
     int is_valid;
@@ -773,10 +778,167 @@ int flb_utils_write_str(char *buf, int *off, size_t size,
     uint32_t codepoint;
     uint32_t state = 0;
     char tmp[16];
+    char *p = buf;
+    uint8_t *s;
+
+    i = *idx;
+
+    if (c >= 0x80 && c <= 0xFFFF) {
+        hex_bytes = flb_utf8_len(str + i);
+        if (available < 6) {
+            return UTILS_UTF8_NO_SPACE;
+        }
+
+        if (i + hex_bytes > str_len) {
+            return UTILS_UTF8_TRUNCATED;
+        }
+
+        state = FLB_UTF8_ACCEPT;
+        codepoint = 0;
+
+        for (b = 0; b < hex_bytes; b++) {
+            s = (unsigned char *) str + i + b;
+            ret = flb_utf8_decode(&state, &codepoint, *s);
+            if (ret == 0) {
+                break;
+            }
+        }
+
+        if (state != FLB_UTF8_ACCEPT) {
+            /* Invalid UTF-8 hex, just skip utf-8 bytes */
+            flb_warn("[pack] invalid UTF-8 bytes found, skipping bytes");
+        }
+        else {
+            len = snprintf(tmp, sizeof(tmp) - 1, "\\u%.4x", codepoint);
+            if (available < len) {
+                return UTILS_UTF8_NO_SPACE;
+            }
+            encoded_to_buf(p, tmp, len);
+            p += len;
+        }
+        i += (hex_bytes - 1);
+    }
+    else {
+        utf_sequence_length = flb_utf8_len(str + i);
+
+        if (i + utf_sequence_length > str_len) {
+            return UTILS_UTF8_TRUNCATED;
+        }
+
+        is_valid = FLB_TRUE;
+        for (utf_sequence_number = 0; utf_sequence_number < utf_sequence_length;
+            utf_sequence_number++) {
+            /* Leading characters must start with bits 11 */
+            if (utf_sequence_number == 0 && ((str[i] & 0xC0) != 0xC0)) {
+                /* Invalid unicode character. replace */
+                flb_debug("[pack] unexpected UTF-8 leading byte, "
+                         "substituting character with replacement character");
+                tmp[utf_sequence_number] = str[i];
+                ++i; /* Consume invalid leading byte */
+                utf_sequence_length = utf_sequence_number + 1;
+                is_valid = FLB_FALSE;
+                break;
+            }
+            /* Trailing characters must start with bits 10 */
+            else if (utf_sequence_number > 0 && ((str[i] & 0xC0) != 0x80)) {
+                /* Invalid unicode character. replace */
+                flb_debug("[pack] unexpected UTF-8 continuation byte, "
+                         "substituting character with replacement character");
+                /* This byte, i, is the start of the next unicode character */
+                utf_sequence_length = utf_sequence_number;
+                is_valid = FLB_FALSE;
+                break;
+            }
+
+            tmp[utf_sequence_number] = str[i];
+            ++i;
+        }
+        --i;
+
+        if (is_valid) {
+            if (available < utf_sequence_length) {
+                return UTILS_UTF8_NO_SPACE;
+            }
+
+            encoded_to_buf(p, tmp, utf_sequence_length);
+            p += utf_sequence_length;
+        }
+        else {
+            if (available < utf_sequence_length * 3) {
+                return UTILS_UTF8_NO_SPACE;
+            }
+
+            /*
+             * Utf-8 sequence is invalid. Map fragments to private use area
+             * codepoints in range:
+             * 0x<FLB_UTILS_FRAGMENT_PRIVATE_BLOCK_DESCRIPTOR>00 to
+             * 0x<FLB_UTILS_FRAGMENT_PRIVATE_BLOCK_DESCRIPTOR>FF
+             */
+            for (b = 0; b < utf_sequence_length; ++b) {
+                /*
+                 * Utf-8 private block invalid hex mapping. Format unicode charpoint
+                 * in the following format:
+                 *
+                 *      +--------+--------+--------+
+                 *      |1110PPPP|10PPPPHH|10HHHHHH|
+                 *      +--------+--------+--------+
+                 *
+                 * Where:
+                 *   P is FLB_UTILS_FRAGMENT_PRIVATE_BLOCK_DESCRIPTOR bits (1 byte)
+                 *   H is Utf-8 fragment hex bits (1 byte)
+                 *   1 is bit 1
+                 *   0 is bit 0
+                 */
+
+                /* unicode codepoint start */
+                *p = 0xE0;
+
+                /* print unicode private block header first 4 bits */
+                *p |= FLB_UTILS_FRAGMENT_PRIVATE_BLOCK_DESCRIPTOR >> 4;
+                ++p;
+
+                /* unicode codepoint middle */
+                *p = 0x80;
+
+                /* print end of unicode private block header last 4 bits */
+                *p |= ((FLB_UTILS_FRAGMENT_PRIVATE_BLOCK_DESCRIPTOR << 2) & 0x3f);
+
+                /* print hex fragment first 2 bits */
+                *p |= (tmp[b] >> 6) & 0x03;
+                ++p;
+
+                /* unicode codepoint middle */
+                *p = 0x80;
+
+                /* print hex fragment last 6 bits */
+                *p |= tmp[b] & 0x3f;
+                ++p;
+            }
+        }
+    }
+
+    *idx = i;
+
+    return p - buf;
+}
+
+/*
+ * Write string pointed by 'str' to the destination buffer 'buf'. It's make sure
+ * to escape sepecial characters and convert utf-8 byte characters to string
+ * representation.
+ */
+int flb_utils_write_str(char *buf, int *off, size_t size,
+                        const char *str, size_t str_len)
+{
+    int i;
+    int ret;
+    int written = 0;
+    int required;
+    int len;
+    char tmp[16];
     size_t available;
     uint32_t c;
     char *p;
-    uint8_t *s;
 
     available = (size - *off);
     required = str_len;
@@ -830,148 +992,159 @@ int flb_utils_write_str(char *buf, int *off, size_t size,
             encoded_to_buf(p, tmp, len);
             p += len;
         }
-        else if (c >= 0x80 && c <= 0xFFFF) {
-            hex_bytes = flb_utf8_len(str + i);
-            if (available - written < 6) {
-                return FLB_FALSE;
-            }
-
-            if (i + hex_bytes > str_len) {
+        else if (c >= 0x80) {
+            ret = utils_write_utf8(p, c, str, str_len, &i, available - written);
+            if (ret == UTILS_UTF8_TRUNCATED) {
                 break; /* skip truncated UTF-8 */
             }
+            else if (ret == UTILS_UTF8_NO_SPACE) {
+                return FLB_FALSE;
+            }
+            p += ret;
+        }
+        else {
+            *p++ = c;
+        }
+        written = (p - (buf + *off));
+    }
 
-            state = FLB_UTF8_ACCEPT;
-            codepoint = 0;
+    *off += written;
 
-            for (b = 0; b < hex_bytes; b++) {
-                s = (unsigned char *) str + i + b;
-                ret = flb_utf8_decode(&state, &codepoint, *s);
-                if (ret == 0) {
-                    break;
-                }
-            }
+    return FLB_TRUE;
+}
 
-            if (state != FLB_UTF8_ACCEPT) {
-                /* Invalid UTF-8 hex, just skip utf-8 bytes */
-                flb_warn("[pack] invalid UTF-8 bytes found, skipping bytes");
-            }
-            else {
-                len = snprintf(tmp, sizeof(tmp) - 1, "\\u%.4x", codepoint);
-                if ((available - written) < len) {
-                    return FLB_FALSE;
-                }
-                encoded_to_buf(p, tmp, len);
-                p += len;
-            }
-            i += (hex_bytes - 1);
+/*
+ * Escape table used by flb_utils_write_str_raw(): zero for the bytes that
+ * are copied as they are, the character of the short escape sequence ('n'
+ * for '\n'), 'u' for the ones written as \u00XX and 0x80 for the bytes
+ * that start a non-ASCII character.
+ */
+#define ESC_UTF8   0x80
+
+static const unsigned char json_escape_table[256] = {
+    /* 0x00 */ 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    /* 0x08 */ 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    /* 0x10 */ 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    /* 0x18 */ 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    /* 0x20 */ 0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0x30 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0x40 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0x50 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+    /* 0x60 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0x70 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 'u',
+    /* 0x80 */
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8,
+    ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8, ESC_UTF8
+};
+
+/* Length of the run of bytes at the start of 'str' that need no escaping */
+static inline size_t utils_safe_run(const char *str, size_t len)
+{
+    size_t i = 0;
+#ifndef FLB_SIMD_NONE
+    uint32_t mask;
+    flb_vector8 v;
+    flb_vector8 space = flb_vector8_broadcast(0x20);
+    flb_vector8 quote = flb_vector8_broadcast('"');
+    flb_vector8 bslash = flb_vector8_broadcast('\\');
+    flb_vector8 del = flb_vector8_broadcast(0x7f);
+
+    /*
+     * Bytes are compared as signed: anything lower than 0x20 is either a
+     * control character or the start of a non-ASCII character.
+     */
+    while (i + FLB_VECTOR8_SIZE <= len) {
+        v = flb_vector8_load(str + i);
+        mask = flb_vector8_mask(flb_vector8_or(
+                   flb_vector8_or(flb_vector8_gt(space, v),
+                                  flb_vector8_eq(v, quote)),
+                   flb_vector8_or(flb_vector8_eq(v, bslash),
+                                  flb_vector8_eq(v, del))));
+        if (mask != 0) {
+            return i + flb_simd_ctz(mask);
         }
-        else if (c > 0xFFFF) {
-            utf_sequence_length = flb_utf8_len(str + i);
+        i += FLB_VECTOR8_SIZE;
+    }
+#endif
 
-            if (i + utf_sequence_length > str_len) {
-                break; /* skip truncated UTF-8 */
-            }
+    while (i < len && json_escape_table[(unsigned char) str[i]] == 0) {
+        i++;
+    }
 
-            is_valid = FLB_TRUE;
-            for (utf_sequence_number = 0; utf_sequence_number < utf_sequence_length;
-                utf_sequence_number++) {
-                /* Leading characters must start with bits 11 */
-                if (utf_sequence_number == 0 && ((str[i] & 0xC0) != 0xC0)) {
-                    /* Invalid unicode character. replace */
-                    flb_debug("[pack] unexpected UTF-8 leading byte, "
-                             "substituting character with replacement character");
-                    tmp[utf_sequence_number] = str[i];
-                    ++i; /* Consume invalid leading byte */
-                    utf_sequence_length = utf_sequence_number + 1;
-                    is_valid = FLB_FALSE;
-                    break;
-                }
-                /* Trailing characters must start with bits 10 */
-                else if (utf_sequence_number > 0 && ((str[i] & 0xC0) != 0x80)) {
-                    /* Invalid unicode character. replace */
-                    flb_debug("[pack] unexpected UTF-8 continuation byte, "
-                             "substituting character with replacement character");
-                    /* This byte, i, is the start of the next unicode character */
-                    utf_sequence_length = utf_sequence_number;
-                    is_valid = FLB_FALSE;
-                    break;
-                }
+    return i;
+}
 
-                tmp[utf_sequence_number] = str[i];
-                ++i;
+/*
+ * Same output than flb_utils_write_str() for callers that already reserved
+ * FLB_UTILS_WRITE_STR_MAX(str_len) bytes in 'buf': there are no bounds
+ * checks, runs of safe bytes are copied at once and the escape sequences
+ * come from a lookup table. Returns the number of bytes written.
+ */
+size_t flb_utils_write_str_raw(char *buf, const char *str, size_t str_len)
+{
+    int i;
+    int ret;
+    size_t run;
+    size_t pos = 0;
+    unsigned char c;
+    unsigned char esc;
+    char *p = buf;
+    static const char hex[] = "0123456789abcdef";
+
+    while (pos < str_len) {
+        run = utils_safe_run(str + pos, str_len - pos);
+        if (run > 0) {
+            memcpy(p, str + pos, run);
+            p += run;
+            pos += run;
+            if (pos == str_len) {
+                break;
             }
-            --i;
-
-            if (is_valid) {
-                if (available - written < utf_sequence_length) {
-                    return FLB_FALSE;
-                }
+        }
 
-                encoded_to_buf(p, tmp, utf_sequence_length);
-                p += utf_sequence_length;
-            }
-            else {
-                if (available - written < utf_sequence_length * 3) {
-                    return FLB_FALSE;
-                }
+        c = (unsigned char) str[pos];
+        esc = json_escape_table[c];
 
-                /*
-                 * Utf-8 sequence is invalid. Map fragments to private use area
-                 * codepoints in range:
-                 * 0x<FLB_UTILS_FRAGMENT_PRIVATE_BLOCK_DESCRIPTOR>00 to
-                 * 0x<FLB_UTILS_FRAGMENT_PRIVATE_BLOCK_DESCRIPTOR>FF
-                 */
-                for (b = 0; b < utf_sequence_length; ++b) {
-                    /*
-                     * Utf-8 private block invalid hex mapping. Format unicode charpoint
-                     * in the following format:
-                     *
-                     *      +--------+--------+--------+
-                     *      |1110PPPP|10PPPPHH|10HHHHHH|
-                     *      +--------+--------+--------+
-                     *
-                     * Where:
-                     *   P is FLB_UTILS_FRAGMENT_PRIVATE_BLOCK_DESCRIPTOR bits (1 byte)
-                     *   H is Utf-8 fragment hex bits (1 byte)
-                     *   1 is bit 1
-                     *   0 is bit 0
-                     */
-
-                    /* unicode codepoint start */
-                    *p = 0xE0;
-
-                    /* print unicode private block header first 4 bits */
-                    *p |= FLB_UTILS_FRAGMENT_PRIVATE_BLOCK_DESCRIPTOR >> 4;
-                    ++p;
-
-                    /* unicode codepoint middle */
-                    *p = 0x80;
-
-                    /* print end of unicode private block header last 4 bits */
-                    *p |= ((FLB_UTILS_FRAGMENT_PRIVATE_BLOCK_DESCRIPTOR << 2) & 0x3f);
-
-                    /* print hex fragment first 2 bits */
-                    *p |= (tmp[b] >> 6) & 0x03;
-                    ++p;
-
-                    /* unicode codepoint middle */
-                    *p = 0x80;
-
-                    /* print hex fragment last 6 bits */
-                    *p |= tmp[b] & 0x3f;
-                    ++p;
-                }
+        if (esc == ESC_UTF8) {
+            i = pos;
+            ret = utils_write_utf8(p, (uint32_t) str[pos], str, str_len, &i,
+                                   (size_t) -1);
+            if (ret == UTILS_UTF8_TRUNCATED) {
+                break; /* skip truncated UTF-8 */
             }
+            p += ret;
+            pos = i;
+        }
+        else if (esc == 'u') {
+            *p++ = '\\';
+            *p++ = 'u';
+            *p++ = '0';
+            *p++ = '0';
+            *p++ = hex[c >> 4];
+            *p++ = hex[c & 0x0f];
         }
         else {
-            *p++ = c;
+            *p++ = '\\';
+            *p++ = esc;
         }
-        written = (p - (buf + *off));
+        pos++;
     }
 
-    *off += written;
-
-    return FLB_TRUE;
+    return p - buf;
 }
 
 
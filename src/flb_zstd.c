@@ -0,0 +1,258 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*  Fluent Bit
+ *  ==========
+ *  Copyright (C) 2015-2024 The Fluent Bit Authors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_zstd.h>
+#include <fluent-bit/flb_compression.h>
+
+#include <stdint.h>
+#include <zstd.h>
+
+struct flb_zstd_decompression_context {
+    ZSTD_DCtx *dctx;
+};
+
+int flb_zstd_compress(void *in_data, size_t in_len,
+                      void **out_data, size_t *out_len)
+{
+    size_t ret;
+    size_t out_size;
+    void *buf;
+
+    out_size = ZSTD_compressBound(in_len);
+
+    buf = flb_malloc(out_size);
+    if (!buf) {
+        flb_errno();
+        return -1;
+    }
+
+    ret = ZSTD_compress(buf, out_size, in_data, in_len,
+                        FLB_ZSTD_DEFAULT_LEVEL);
+    if (ZSTD_isError(ret)) {
+        flb_error("[zstd] compression failed: %s", ZSTD_getErrorName(ret));
+        flb_free(buf);
+        return -1;
+    }
+
+    *out_data = buf;
+    *out_len = ret;
+
+    return 0;
+}
+
+int flb_zstd_uncompress(void *in_data, size_t in_len,
+                        void **out_data, size_t *out_len,
+                        size_t max_size)
+{
+    size_t ret;
+    size_t out_size;
+    size_t out_limit;
+    char *buf;
+    char *tmp;
+    ZSTD_DCtx *dctx;
+    ZSTD_inBuffer input;
+    ZSTD_outBuffer output;
+
+    dctx = ZSTD_createDCtx();
+    if (!dctx) {
+        flb_error("[zstd] could not create decompression context");
+        return -1;
+    }
+
+    /*
+     * The buffer may grow up to one byte over the limit, filling that byte
+     * means the data does not fit.
+     */
+    out_limit = SIZE_MAX - 1;
+    if (max_size > 0) {
+        out_limit = max_size + 1;
+    }
+
+    /* content size is optional in the frame header, start with a guess */
+    out_size = (in_len * 4) + ZSTD_DStreamOutSize();
+    if (out_size > out_limit) {
+        out_size = out_limit;
+    }
+
+    buf = flb_malloc(out_size + 1);
+    if (!buf) {
+        flb_errno();
+        ZSTD_freeDCtx(dctx);
+        return -1;
+    }
+
+    input.src = in_data;
+    input.size = in_len;
+    input.pos = 0;
+
+    output.dst = buf;
+    output.size = out_size;
+    output.pos = 0;
+
+    /* keep going while there is input or zstd may still hold output */
+    ret = 0;
+    while (input.pos < input.size || output.pos == output.size) {
+        if (output.pos == output.size) {
+            if (out_size == out_limit) {
+                flb_error("[zstd] maximum decompression size is %zu bytes",
+                          max_size);
+                goto error;
+            }
+
+            out_size = (out_size > out_limit / 2) ? out_limit : out_size * 2;
+
+            tmp = flb_realloc(buf, out_size + 1);
+            if (!tmp) {
+                flb_errno();
+                goto error;
+            }
+            buf = tmp;
+
+            output.dst = buf;
+            output.size = out_size;
+        }
+
+        ret = ZSTD_decompressStream(dctx, &output, &input);
+        if (ZSTD_isError(ret)) {
+            flb_error("[zstd] decompression failed: %s",
+                      ZSTD_getErrorName(ret));
+            goto error;
+        }
+    }
+
+    /* a non zero hint means the last frame is incomplete */
+    if (ret != 0) {
+        flb_error("[zstd] truncated frame");
+        goto error;
+    }
+
+    ZSTD_freeDCtx(dctx);
+
+    buf[output.pos] = '\0';
+
+    *out_data = buf;
+    *out_len = output.pos;
+
+    return 0;
+
+error:
+    ZSTD_freeDCtx(dctx);
+    flb_free(buf);
+
+    return -1;
+}
+
+int flb_zstd_decompressor_dispatch(struct flb_decompression_context *context,
+                                   void *output_buffer,
+                                   size_t *output_length)
+{
+    size_t ret;
+    ZSTD_inBuffer input;
+    ZSTD_outBuffer output;
+    struct flb_zstd_decompression_context *inner_context;
+
+    output.dst = output_buffer;
+    output.size = *output_length;
+    output.pos = 0;
+
+    *output_length = 0;
+
+    if (context == NULL ||
+        context->inner_context == NULL) {
+        return FLB_DECOMPRESSOR_FAILURE;
+    }
+
+    inner_context = context->inner_context;
+
+    input.src = context->read_buffer;
+    input.size = context->input_buffer_length;
+    input.pos = 0;
+
+    /* runs at least once so data buffered by zstd is flushed */
+    do {
+        ret = ZSTD_decompressStream(inner_context->dctx, &output, &input);
+        if (ZSTD_isError(ret)) {
+            flb_error("[zstd] decompression failed: %s",
+                      ZSTD_getErrorName(ret));
+
+            context->state = FLB_DECOMPRESSOR_STATE_FAILED;
+
+            return FLB_DECOMPRESSOR_FAILURE;
+        }
+    } while (input.pos < input.size && output.pos < output.size);
+
+    context->input_buffer_length -= input.pos;
+
+    if (context->input_buffer_length > 0) {
+        context->read_buffer = &context->read_buffer[input.pos];
+    }
+    else {
+        context->read_buffer = context->input_buffer;
+    }
+
+    /* zstd keeps track of the frame boundaries by itself */
+    if (ret == 0) {
+        context->state = FLB_DECOMPRESSOR_STATE_EXPECTING_HEADER;
+    }
+    else {
+        context->state = FLB_DECOMPRESSOR_STATE_EXPECTING_BODY;
+    }
+
+    *output_length = output.pos;
+
+    return FLB_DECOMPRESSOR_SUCCESS;
+}
+
+void *flb_zstd_decompression_context_create()
+{
+    struct flb_zstd_decompression_context *context;
+
+    context = flb_calloc(1, sizeof(struct flb_zstd_decompression_context));
+    if (context == NULL) {
+        flb_errno();
+        return NULL;
+    }
+
+    context->dctx = ZSTD_createDCtx();
+    if (context->dctx == NULL) {
+        flb_error("[zstd] could not create decompression context");
+        flb_free(context);
+        return NULL;
+    }
+
+    return (void *) context;
+}
+
+void flb_zstd_decompression_context_destroy(void *context)
+{
+    struct flb_zstd_decompression_context *inner_context;
+
+    if (context != NULL) {
+        inner_context = context;
+
+        if (inner_context->dctx != NULL) {
+            ZSTD_freeDCtx(inner_context->dctx);
+        }
+
+        flb_free(inner_context);
+    }
+}
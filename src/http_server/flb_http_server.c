@@ -23,6 +23,11 @@
 
 #include <fluent-bit/flb_snappy.h>
 #include <fluent-bit/flb_gzip.h>
+#include <fluent-bit/flb_lz4.h>
+#ifdef FLB_HAVE_ZSTD
+#include <fluent-bit/flb_zstd.h>
+#endif
+#include <fluent-bit/flb_compression.h>
 
 static \
 int uncompress_zlib(char **output_buffer,
@@ -36,6 +41,12 @@ int uncompress_zstd(char **output_buffer,
                     char *input_buffer,
                     size_t input_size);
 
+static \
+int uncompress_lz4(char **output_buffer,
+                   size_t *output_size,
+                   char *input_buffer,
+                   size_t input_size);
+
 static \
 int uncompress_deflate(char **output_buffer,
                        size_t *output_size,
@@ -229,6 +240,12 @@ static int flb_http_server_inflate_request_body(
                                     request->body,
                                     cfl_sds_len(request->body));
     }
+    else if (strncasecmp(content_encoding_header_value, "lz4", 3) == 0) {
+        result = uncompress_lz4(&output_buffer,
+                                    &output_size,
+                                    request->body,
+                                    cfl_sds_len(request->body));
+    }
     else if (strncasecmp(content_encoding_header_value, "snappy", 6) == 0) {
         result = uncompress_snappy(&output_buffer,
                                     &output_size,
@@ -242,6 +259,11 @@ static int flb_http_server_inflate_request_body(
                                     cfl_sds_len(request->body));
     }
 
+    /* corrupted or oversized payload */
+    if (result == -1) {
+        return -1;
+    }
+
     if (result == 1) {
         inflated_body = cfl_sds_create_len(output_buffer, output_size);
 
@@ -772,7 +794,50 @@ int uncompress_zstd(char **output_buffer,
                     char *input_buffer,
                     size_t input_size)
 {
-    return 0;
+#ifdef FLB_HAVE_ZSTD
+    int ret;
+
+    ret = flb_zstd_uncompress(input_buffer,
+                              input_size,
+                              (void *) output_buffer,
+                              output_size,
+                              FLB_DECOMPRESSION_MAX_SIZE);
+
+    if (ret == -1) {
+        flb_error("[http_server] zstd decompression failed");
+
+        return -1;
+    }
+
+    return 1;
+#else
+    flb_error("[http_server] zstd decompression is not supported");
+
+    return -1;
+#endif
+}
+
+static \
+int uncompress_lz4(char **output_buffer,
+                   size_t *output_size,
+                   char *input_buffer,
+                   size_t input_size)
+{
+    int ret;
+
+    ret = flb_lz4_uncompress(input_buffer,
+                             input_size,
+                             (void *) output_buffer,
+                             output_size,
+                             FLB_DECOMPRESSION_MAX_SIZE);
+
+    if (ret == -1) {
+        flb_error("[http_server] lz4 decompression failed");
+
+        return -1;
+    }
+
+    return 1;
 }
 
 static \
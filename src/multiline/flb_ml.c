@@ -163,15 +163,54 @@ static void cb_ml_flush_timer(struct flb_config *ctx, void *data)
     flb_ml_flush_pending(ml, now, FLB_TRUE);
 }
 
-int flb_ml_register_context(struct flb_ml_stream_group *group,
+/*
+ * Store the first line record of a multiline message. Only the first map
+ * registered until the next flush is used. The map is packed as is, but
+ * the location of the 'key_content' value is recorded so the flush only has
+ * to replace that range with the concatenated content, without unpacking
+ * the record again.
+ */
+int flb_ml_register_context(struct flb_ml_stream *mst,
+                            struct flb_ml_stream_group *group,
                             struct flb_time *tm, msgpack_object *map)
 {
+    int i;
+    int len = 0;
+    flb_sds_t key_content;
+    msgpack_object *k;
+
     if (tm) {
         flb_time_copy(&group->mp_time, tm);
     }
 
-    if (map) {
-        msgpack_pack_object(&group->mp_pck, *map);
+    if (!map || map->type != MSGPACK_OBJECT_MAP || group->mp_sbuf.size > 0) {
+        return 0;
+    }
+
+    group->mp_content_off = 0;
+    group->mp_content_end = 0;
+
+    key_content = mst->parser->key_content;
+    if (key_content) {
+        len = flb_sds_len(key_content);
+    }
+
+    msgpack_pack_map(&group->mp_pck, map->via.map.size);
+    for (i = 0; i < map->via.map.size; i++) {
+        k = &map->via.map.ptr[i].key;
+        msgpack_pack_object(&group->mp_pck, *k);
+
+        if (group->mp_content_end == 0 && key_content &&
+            k->type == MSGPACK_OBJECT_STR &&
+            k->via.str.size == len &&
+            strncmp(k->via.str.ptr, key_content, len) == 0) {
+            group->mp_content_off = group->mp_sbuf.size;
+            msgpack_pack_object(&group->mp_pck, map->via.map.ptr[i].val);
+            group->mp_content_end = group->mp_sbuf.size;
+        }
+        else {
+            msgpack_pack_object(&group->mp_pck, map->via.map.ptr[i].val);
+        }
     }
 
     return 0;
@@ -279,7 +318,7 @@ static int package_content(struct flb_ml_stream *mst,
             }
 
             if (stream_group->mp_sbuf.size == 0) {
-                flb_ml_register_context(stream_group, tm, full_map);
+                flb_ml_register_context(mst, stream_group, tm, full_map);
             }
 
             /* Prepare concatenation */
@@ -313,7 +352,7 @@ static int package_content(struct flb_ml_stream *mst,
         }
 
         if (stream_group->mp_sbuf.size == 0) {
-            flb_ml_register_context(stream_group, tm, full_map);
+            flb_ml_register_context(mst, stream_group, tm, full_map);
         }
 
         /* Prepare concatenation */
@@ -1353,22 +1392,99 @@ int flb_ml_flush_metadata_buffer(struct flb_ml_stream *mst,
     return ret;
 }
 
+/*
+ * Compose the record body straight into the log event encoder: the first line
+ * record with the 'key_content' value replaced by the multiline content, or a
+ * single key map with the content if there is no first line record.
+ */
+static int flush_stream_group_body(struct flb_ml_parser_ins *parser_i,
+                                   struct flb_ml_stream_group *group,
+                                   struct flb_log_event_encoder *encoder)
+{
+    int ret;
+    size_t len;
+    char *key;
+    size_t key_len;
+
+    ret = flb_log_event_encoder_dynamic_field_reset(&encoder->body);
+
+    if (group->mp_sbuf.size > 0 && group->mp_content_end == 0) {
+        /* no 'key_content' in the first line record, keep it as is */
+        if (ret == FLB_EVENT_ENCODER_SUCCESS) {
+            ret = flb_log_event_encoder_append_body_raw_msgpack(
+                    encoder,
+                    group->mp_sbuf.data,
+                    group->mp_sbuf.size);
+        }
+    }
+    else if (group->mp_sbuf.size > 0) {
+        /* keys and values before and after the replaced value */
+        if (ret == FLB_EVENT_ENCODER_SUCCESS) {
+            ret = flb_log_event_encoder_append_body_raw_msgpack(
+                    encoder,
+                    group->mp_sbuf.data,
+                    group->mp_content_off);
+        }
+
+        if (ret == FLB_EVENT_ENCODER_SUCCESS) {
+            ret = flb_log_event_encoder_append_body_string(
+                    encoder,
+                    group->buf,
+                    flb_sds_len(group->buf));
+        }
+
+        if (ret == FLB_EVENT_ENCODER_SUCCESS) {
+            len = group->mp_sbuf.size - group->mp_content_end;
+            ret = flb_log_event_encoder_append_body_raw_msgpack(
+                    encoder,
+                    group->mp_sbuf.data + group->mp_content_end,
+                    len);
+        }
+    }
+    else {
+        /* Pack raw content as Fluent Bit record */
+        if (parser_i->key_content) {
+            key = parser_i->key_content;
+            key_len = flb_sds_len(parser_i->key_content);
+        }
+        else {
+            key = "log";
+            key_len = 3;
+        }
+
+        /* map header of one entry */
+        if (ret == FLB_EVENT_ENCODER_SUCCESS) {
+            ret = flb_log_event_encoder_append_body_raw_msgpack(
+                    encoder, "\x81", 1);
+        }
+
+        if (ret == FLB_EVENT_ENCODER_SUCCESS) {
+            ret = flb_log_event_encoder_append_body_string(
+                    encoder, key, key_len);
+        }
+
+        if (ret == FLB_EVENT_ENCODER_SUCCESS) {
+            ret = flb_log_event_encoder_append_body_string(
+                    encoder,
+                    group->buf,
+                    flb_sds_len(group->buf));
+        }
+    }
+
+    if (ret == FLB_EVENT_ENCODER_SUCCESS) {
+        ret = flb_log_event_encoder_dynamic_field_flush(&encoder->body);
+    }
+
+    return ret;
+}
+
 int flb_ml_flush_stream_group(struct flb_ml_parser *ml_parser,
                               struct flb_ml_stream *mst,
                               struct flb_ml_stream_group *group,
                               int forced_flush)
 {
-    int i;
     int ret;
-    int size;
     int len;
-    size_t off = 0;
-    msgpack_object map;
-    msgpack_object k;
-    msgpack_object v;
-    msgpack_sbuffer mp_sbuf;
-    msgpack_packer mp_pck;
-    msgpack_unpacked result;
     struct flb_ml_parser_ins *parser_i = mst->parser;
     struct flb_time *group_time;
     struct flb_time now;
@@ -1376,10 +1492,6 @@ int flb_ml_flush_stream_group(struct flb_ml_parser *ml_parser,
     breakline_prepare(parser_i, group);
     len = flb_sds_len(group->buf);
 
-    /* init msgpack buffer */
-    msgpack_sbuffer_init(&mp_sbuf);
-    msgpack_packer_init(&mp_pck, &mp_sbuf, msgpack_sbuffer_write);
-
     /* if the group don't have a time set, use current time */
     if (flb_time_to_nanosec(&group->mp_time) == 0L) {
         flb_time_get(&now);
@@ -1388,84 +1500,8 @@ int flb_ml_flush_stream_group(struct flb_ml_parser *ml_parser,
         group_time = &group->mp_time;
     }
 
-    /* compose final record if we have a first line context */
-    if (group->mp_sbuf.size > 0) {
-        msgpack_unpacked_init(&result);
-        ret = msgpack_unpack_next(&result,
-                                  group->mp_sbuf.data, group->mp_sbuf.size,
-                                  &off);
-        if (ret != MSGPACK_UNPACK_SUCCESS) {
-            flb_error("[multiline] could not unpack first line state buffer");
-            msgpack_unpacked_destroy(&result);
-            group->mp_sbuf.size = 0;
-            return -1;
-        }
-        map = result.data;
-
-        if (map.type != MSGPACK_OBJECT_MAP) {
-            flb_error("[multiline] expected MAP type in first line state buffer");
-            msgpack_unpacked_destroy(&result);
-            group->mp_sbuf.size = 0;
-            return -1;
-        }
-
-        /* Take the first line keys and repack */
-        len = flb_sds_len(parser_i->key_content);
-        size = map.via.map.size;
-        msgpack_pack_map(&mp_pck, size);
-
-        for (i = 0; i < size; i++) {
-            k = map.via.map.ptr[i].key;
-            v = map.via.map.ptr[i].val;
-
-            /*
-             * Check if the current key is the key that will contain the
-             * concatenated multiline buffer
-             */
-            if (k.type == MSGPACK_OBJECT_STR &&
-                parser_i->key_content &&
-                k.via.str.size == len &&
-                strncmp(k.via.str.ptr, parser_i->key_content, len) == 0) {
-
-                /* key */
-                msgpack_pack_object(&mp_pck, k);
-
-                /* value */
-                len = flb_sds_len(group->buf);
-                msgpack_pack_str(&mp_pck, len);
-                msgpack_pack_str_body(&mp_pck, group->buf, len);
-            }
-            else {
-                /* key / val */
-                msgpack_pack_object(&mp_pck, k);
-                msgpack_pack_object(&mp_pck, v);
-            }
-        }
-        msgpack_unpacked_destroy(&result);
-        group->mp_sbuf.size = 0;
-    }
-    else if (len > 0) {
-        /* Pack raw content as Fluent Bit record */
-        msgpack_pack_map(&mp_pck, 1);
-
-        /* key */
-        if (parser_i->key_content) {
-            len = flb_sds_len(parser_i->key_content);
-            msgpack_pack_str(&mp_pck, len);
-            msgpack_pack_str_body(&mp_pck, parser_i->key_content, len);
-        }
-        else {
-            msgpack_pack_str(&mp_pck, 3);
-            msgpack_pack_str_body(&mp_pck, "log", 3);
-        }
-
-        /* val */
-        len = flb_sds_len(group->buf);
-        msgpack_pack_str(&mp_pck, len);
-        msgpack_pack_str_body(&mp_pck, group->buf, len);
-    }
-
-    if (mp_sbuf.size > 0) {
+    /* compose the final record if we have a first line context or content */
+    if (group->mp_sbuf.size > 0 || len > 0) {
         /*
          * a 'forced_flush' means to alert the caller that the data 'must be flushed to it destination'. This flag is
          * only enabled when the flush process has been triggered by the multiline timer, e.g:
@@ -1494,10 +1530,8 @@ int flb_ml_flush_stream_group(struct flb_ml_parser *ml_parser,
         }
 
         if (ret == FLB_EVENT_ENCODER_SUCCESS) {
-            ret = flb_log_event_encoder_set_body_from_raw_msgpack(
-                    &mst->ml->log_event_encoder,
-                    mp_sbuf.data,
-                    mp_sbuf.size);
+            ret = flush_stream_group_body(parser_i, group,
+                                          &mst->ml->log_event_encoder);
         }
 
         if (ret == FLB_EVENT_ENCODER_SUCCESS) {
@@ -1505,6 +1539,8 @@ int flb_ml_flush_stream_group(struct flb_ml_parser *ml_parser,
                     &mst->ml->log_event_encoder);
         }
 
+        group->mp_sbuf.size = 0;
+
         if (ret != FLB_EVENT_ENCODER_SUCCESS) {
             flb_error("[multiline] error packing event");
 
@@ -1529,7 +1565,6 @@ int flb_ml_flush_stream_group(struct flb_ml_parser *ml_parser,
         }
     }
 
-    msgpack_sbuffer_destroy(&mp_sbuf);
     flb_sds_len_set(group->buf, 0);
 
     /* Update last flush time */
@@ -136,6 +136,10 @@ void flb_ml_rule_destroy(struct flb_ml_rule *rule)
         flb_free(st);
     }
 
+    if (rule->next_rules) {
+        flb_free(rule->next_rules);
+    }
+
     if (rule->regex_end) {
         flb_regex_destroy(rule->regex_end);
     }
@@ -154,6 +158,11 @@ void flb_ml_rule_destroy_all(struct flb_ml_parser *ml_parser)
         rule = mk_list_entry(head, struct flb_ml_rule, _head);
         flb_ml_rule_destroy(rule);
     }
+    if (ml_parser->start_rules) {
+        flb_free(ml_parser->start_rules);
+        ml_parser->start_rules = NULL;
+    }
+    ml_parser->start_rules_count = 0;
 }
 
 static inline int to_states_exists(struct flb_ml_parser *ml_parser,
@@ -245,9 +254,6 @@ static int try_flushing_buffer(struct flb_ml_parser *ml_parser,
                                struct flb_ml_stream *mst,
                                struct flb_ml_stream_group *group)
 {
-    int next_start = FLB_FALSE;
-    struct mk_list *head;
-    struct to_state *st;
     struct flb_ml_rule *rule;
 
     rule = group->rule_to_state;
@@ -260,17 +266,83 @@ static int try_flushing_buffer(struct flb_ml_parser *ml_parser,
     }
 
     /* Check if any 'to_state_map' referenced rules is a possible start */
+    if (rule->next_start && flb_sds_len(group->buf) > 0) {
+        flb_ml_flush_stream_group(ml_parser, mst, group, FLB_FALSE);
+        group->first_line = FLB_TRUE;
+    }
+
+    return 0;
+}
+
+/*
+ * Turn the 'to_state_map' list of a rule into an array of the rules that can
+ * continue it, so processing a line does not walk the list nor skip the start
+ * states every time.
+ */
+static int set_next_rules(struct flb_ml_rule *rule)
+{
+    int size;
+    struct mk_list *head;
+    struct to_state *st;
+
+    if (rule->next_rules) {
+        flb_free(rule->next_rules);
+        rule->next_rules = NULL;
+    }
+    rule->next_rules_count = 0;
+    rule->next_start = FLB_FALSE;
+
+    size = mk_list_size(&rule->to_state_map);
+    if (size == 0) {
+        return 0;
+    }
+
+    rule->next_rules = flb_malloc(sizeof(struct flb_ml_rule *) * size);
+    if (!rule->next_rules) {
+        flb_errno();
+        return -1;
+    }
+
     mk_list_foreach(head, &rule->to_state_map) {
         st = mk_list_entry(head, struct to_state, _head);
         if (st->rule->start_state) {
-            next_start = FLB_TRUE;
-            break;
+            rule->next_start = FLB_TRUE;
+            continue;
         }
+        rule->next_rules[rule->next_rules_count++] = st->rule;
     }
 
-    if (next_start && flb_sds_len(group->buf) > 0) {
-        flb_ml_flush_stream_group(ml_parser, mst, group, FLB_FALSE);
-        group->first_line = FLB_TRUE;
+    return 0;
+}
+
+static int set_start_rules(struct flb_ml_parser *ml_parser)
+{
+    int size;
+    struct mk_list *head;
+    struct flb_ml_rule *rule;
+
+    if (ml_parser->start_rules) {
+        flb_free(ml_parser->start_rules);
+        ml_parser->start_rules = NULL;
+    }
+    ml_parser->start_rules_count = 0;
+
+    size = mk_list_size(&ml_parser->regex_rules);
+    if (size == 0) {
+        return 0;
+    }
+
+    ml_parser->start_rules = flb_malloc(sizeof(struct flb_ml_rule *) * size);
+    if (!ml_parser->start_rules) {
+        flb_errno();
+        return -1;
+    }
+
+    mk_list_foreach(head, &ml_parser->regex_rules) {
+        rule = mk_list_entry(head, struct flb_ml_rule, _head);
+        if (rule->start_state) {
+            ml_parser->start_rules[ml_parser->start_rules_count++] = rule;
+        }
     }
 
     return 0;
@@ -293,29 +365,28 @@ int flb_ml_rule_init(struct flb_ml_parser *ml_parser)
         if (ret == -1) {
             return -1;
         }
+
+        ret = set_next_rules(rule);
+        if (ret == -1) {
+            return -1;
+        }
     }
 
-    return 0;
+    return set_start_rules(ml_parser);
 }
 
 /* Search any 'start_state' matching the incoming 'buf_data' */
 static struct flb_ml_rule *try_start_state(struct flb_ml_parser *ml_parser,
                                            char *buf_data, size_t buf_size)
 {
-    int ret = -1;
-    struct mk_list *head;
-    struct flb_ml_rule *rule = NULL;
-
-    mk_list_foreach(head, &ml_parser->regex_rules) {
-        rule = mk_list_entry(head, struct flb_ml_rule, _head);
+    int i;
+    int ret;
+    struct flb_ml_rule *rule;
 
-        /* Is this rule matching a start_state ? */
-        if (!rule->start_state) {
-            rule = NULL;
-            continue;
-        }
+    for (i = 0; i < ml_parser->start_rules_count; i++) {
+        rule = ml_parser->start_rules[i];
 
-        /* Matched a start_state. Check if we have a regex match */
+        /* Check if we have a regex match */
         ret = flb_regex_match(rule->regex, (unsigned char *) buf_data, buf_size);
         if (ret) {
             return rule;
@@ -333,12 +404,12 @@ int flb_ml_rule_process(struct flb_ml_parser *ml_parser,
                         msgpack_object *val_content,
                         msgpack_object *val_pattern)
 {
+    int i;
     int ret;
     int len;
     char *buf_data = NULL;
     size_t buf_size = 0;
-    struct mk_list *head;
-    struct to_state *st = NULL;
+    struct flb_ml_rule *next;
     struct flb_ml_rule *rule = NULL;
     struct flb_ml_rule *tmp_rule = NULL;
 
@@ -357,16 +428,11 @@ int flb_ml_rule_process(struct flb_ml_parser *ml_parser,
 
         /* Lookup all possible next rules by state reference */
         rule = NULL;
-        mk_list_foreach(head, &tmp_rule->to_state_map) {
-            st = mk_list_entry(head, struct to_state, _head);
-
-            /* skip start states */
-            if (st->rule->start_state) {
-                continue;
-            }
+        for (i = 0; i < tmp_rule->next_rules_count; i++) {
+            next = tmp_rule->next_rules[i];
 
             /* Try regex match */
-            ret = flb_regex_match(st->rule->regex,
+            ret = flb_regex_match(next->regex,
                                   (unsigned char *) buf_data, buf_size);
             if (ret) {
                 /* Regex matched */
@@ -381,10 +447,9 @@ int flb_ml_rule_process(struct flb_ml_parser *ml_parser,
                 else {
                     flb_sds_cat_safe(&group->buf, buf_data, buf_size);
                 }
-                rule = st->rule;
+                rule = next;
                 break;
             }
-            rule = NULL;
         }
 
     }
@@ -405,7 +470,7 @@ int flb_ml_rule_process(struct flb_ml_parser *ml_parser,
             flb_sds_cat_safe(&group->buf, buf_data, buf_size);
 
             /* Copy full map content in stream buffer */
-            flb_ml_register_context(group, tm, full_map);
+            flb_ml_register_context(mst, group, tm, full_map);
 
             return 0;
         }
@@ -546,6 +546,14 @@ int flb_tls_session_create(struct flb_tls *tls,
     session->tls = tls;
     session->connection = connection;
 
+    /* Upstreams with 'net.http2' enabled offer h2 and fallback to HTTP/1.1 */
+    if (session->ptr != NULL &&
+        connection->type == FLB_UPSTREAM_CONNECTION &&
+        connection->net->http2 == FLB_TRUE &&
+        tls->api->session_alpn_set != NULL) {
+        tls->api->session_alpn_set(session->ptr, "h2,http/1.1");
+    }
+
     result = 0;
 
     event_restore_needed = FLB_FALSE;
@@ -672,6 +680,20 @@ cleanup:
     return result;
 }
 
+/*
+ * Copy the protocol negotiated through ALPN into 'buf', returns its length
+ * or zero if there was no negotiation.
+ */
+int flb_tls_session_get_alpn(struct flb_tls_session *session,
+                             char *buf, size_t size)
+{
+    if (session->ptr == NULL || session->tls->api->session_alpn_get == NULL) {
+        return 0;
+    }
+
+    return session->tls->api->session_alpn_get(session->ptr, buf, size);
+}
+
 int flb_tls_session_destroy(struct flb_tls_session *session)
 {
     int ret;
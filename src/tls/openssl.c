@@ -19,6 +19,7 @@
 
 #include <fluent-bit/flb_info.h>
 #include <fluent-bit/flb_compat.h>
+#include <fluent-bit/flb_str.h>
 #include <fluent-bit/tls/flb_tls.h>
 #include <fluent-bit/tls/flb_tls_info.h>
 
@@ -40,6 +41,15 @@
  */
 #define OPENSSL_1_1_0 0x010100000L
 
+/* Number of server names a client context keeps a session for */
+#define TLS_RESUME_CACHE_SIZE 32
+
+/* Client session that can be resumed on a new connection to the server */
+struct tls_resume_entry {
+    char *server_name;
+    SSL_SESSION *session;
+};
+
 /* OpenSSL library context */
 struct tls_context {
     int debug_level;
@@ -47,6 +57,10 @@ struct tls_context {
     int mode;
     char *alpn;
     pthread_mutex_t mutex;
+
+    /* client mode: session resumption cache, protected by 'mutex' */
+    int resume_next;
+    struct tls_resume_entry resume_cache[TLS_RESUME_CACHE_SIZE];
 };
 
 struct tls_session {
@@ -123,11 +137,83 @@ static void tls_info_callback(const SSL *s, int where, int ret)
     }
 }
 
+static struct tls_resume_entry *tls_resume_entry_get(struct tls_context *ctx,
+                                                     const char *server_name)
+{
+    int i;
+    struct tls_resume_entry *entry;
+
+    for (i = 0; i < TLS_RESUME_CACHE_SIZE; i++) {
+        entry = &ctx->resume_cache[i];
+        if (entry->server_name != NULL &&
+            strcmp(entry->server_name, server_name) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void tls_resume_entry_clear(struct tls_resume_entry *entry)
+{
+    if (entry->session != NULL) {
+        SSL_SESSION_free(entry->session);
+        entry->session = NULL;
+    }
+    if (entry->server_name != NULL) {
+        flb_free(entry->server_name);
+        entry->server_name = NULL;
+    }
+}
+
+/*
+ * A new client session was established (or a TLS 1.3 ticket was received),
+ * keep it so the next connection to the same server can resume it. The
+ * callback runs inside the handshake or a read, the context mutex is held.
+ */
+static int tls_context_session_new_callback(SSL *ssl, SSL_SESSION *session)
+{
+    const char *server_name;
+    struct tls_context *ctx;
+    struct tls_resume_entry *entry;
+
+    ctx = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    server_name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    if (ctx == NULL || server_name == NULL) {
+        return 0;
+    }
+
+    entry = tls_resume_entry_get(ctx, server_name);
+    if (entry != NULL) {
+        SSL_SESSION_free(entry->session);
+        entry->session = session;
+        return 1;
+    }
+
+    /* replace the oldest entry */
+    entry = &ctx->resume_cache[ctx->resume_next];
+    ctx->resume_next = (ctx->resume_next + 1) % TLS_RESUME_CACHE_SIZE;
+    tls_resume_entry_clear(entry);
+
+    entry->server_name = flb_strdup(server_name);
+    if (entry->server_name == NULL) {
+        return 0;
+    }
+    entry->session = session;
+
+    /* the reference of the session is owned by the cache */
+    return 1;
+}
+
 static void tls_context_destroy(void *ctx_backend)
 {
+    int i;
     struct tls_context *ctx = ctx_backend;
 
     pthread_mutex_lock(&ctx->mutex);
+    for (i = 0; i < TLS_RESUME_CACHE_SIZE; i++) {
+        tls_resume_entry_clear(&ctx->resume_cache[i]);
+    }
     SSL_CTX_free(ctx->ctx);
     if (ctx->alpn != NULL) {
         flb_free(ctx->alpn);
@@ -137,70 +223,83 @@ static void tls_context_destroy(void *ctx_backend)
     flb_free(ctx);
 }
 
-int tls_context_alpn_set(void *ctx_backend, const char *alpn)
+/*
+ * Convert a comma separated list of protocols to the ALPN wire format, the
+ * first byte of the returned buffer holds the length of the list.
+ */
+static char *tls_alpn_wire_format(const char *alpn)
 {
-    size_t              wire_format_alpn_index;
-    char               *alpn_token_context;
-    char               *alpn_working_copy;
-    char               *wire_format_alpn;
-    char               *alpn_token;
-    int                 result;
-    struct tls_context *ctx;
+    size_t  wire_format_alpn_index;
+    char   *alpn_token_context;
+    char   *alpn_working_copy;
+    char   *wire_format_alpn;
+    char   *alpn_token;
 
-    ctx = (struct tls_context *) ctx_backend;
+    wire_format_alpn = flb_calloc(strlen(alpn),
+                                  sizeof(char) + 1);
 
-    result = 0;
+    if (wire_format_alpn == NULL) {
+        return NULL;
+    }
 
-    if (alpn != NULL) {
-        wire_format_alpn = flb_calloc(strlen(alpn),
-                                      sizeof(char) + 1);
+    alpn_working_copy = strdup(alpn);
 
-        if (wire_format_alpn == NULL) {
-            return -1;
-        }
+    if (alpn_working_copy == NULL) {
+        flb_free(wire_format_alpn);
 
-        alpn_working_copy = strdup(alpn);
+        return NULL;
+    }
 
-        if (alpn_working_copy == NULL) {
-            flb_free(wire_format_alpn);
+    wire_format_alpn_index = 1;
+    alpn_token_context = NULL;
 
-            return -1;
-        }
+    alpn_token = strtok_r(alpn_working_copy,
+                          ",",
+                          &alpn_token_context);
 
-        wire_format_alpn_index = 1;
-        alpn_token_context = NULL;
+    while (alpn_token != NULL) {
+        wire_format_alpn[wire_format_alpn_index] = \
+            (char) strlen(alpn_token);
 
-        alpn_token = strtok_r(alpn_working_copy,
+        strcpy(&wire_format_alpn[wire_format_alpn_index + 1],
+               alpn_token);
+
+        wire_format_alpn_index += strlen(alpn_token) + 1;
+
+        alpn_token = strtok_r(NULL,
                               ",",
                               &alpn_token_context);
+    }
 
-        while (alpn_token != NULL) {
-            wire_format_alpn[wire_format_alpn_index] = \
-                (char) strlen(alpn_token);
+    free(alpn_working_copy);
 
-            strcpy(&wire_format_alpn[wire_format_alpn_index + 1],
-                   alpn_token);
+    if (wire_format_alpn_index == 1) {
+        flb_free(wire_format_alpn);
 
-            wire_format_alpn_index += strlen(alpn_token) + 1;
+        return NULL;
+    }
 
-            alpn_token = strtok_r(NULL,
-                                  ",",
-                                  &alpn_token_context);
-        }
+    wire_format_alpn[0] = (char) wire_format_alpn_index - 1;
 
-        if (wire_format_alpn_index > 1) {
-            wire_format_alpn[0] = (char) wire_format_alpn_index - 1;
-            ctx->alpn = wire_format_alpn;
-        }
+    return wire_format_alpn;
+}
 
-        free(alpn_working_copy);
-    }
+int tls_context_alpn_set(void *ctx_backend, const char *alpn)
+{
+    char               *wire_format_alpn;
+    struct tls_context *ctx;
+
+    ctx = (struct tls_context *) ctx_backend;
 
-    if (result != 0) {
-        result = -1;
+    if (alpn != NULL) {
+        wire_format_alpn = tls_alpn_wire_format(alpn);
+
+        if (wire_format_alpn != NULL) {
+            ctx->alpn = wire_format_alpn;
+        }
     }
 
-    return result;
+    return 0;
 }
 
 static int tls_context_server_alpn_select_callback(SSL *ssl,
@@ -373,6 +472,14 @@ static void *tls_context_create(int verify,
                                    tls_context_server_alpn_select_callback,
                                    ctx);
     }
+    else {
+        /* keep the client sessions to resume them on new connections */
+        SSL_CTX_set_app_data(ssl_ctx, ctx);
+        SSL_CTX_set_session_cache_mode(ssl_ctx,
+                                       SSL_SESS_CACHE_CLIENT |
+                                       SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ssl_ctx, tls_context_session_new_callback);
+    }
 
     /* Verify peer: by default OpenSSL always verify peer */
     if (verify == FLB_FALSE) {
@@ -514,6 +621,51 @@ static int tls_session_destroy(void *session)
     return 0;
 }
 
+/* Set the protocols offered by a client session, it overrides the context */
+static int tls_session_alpn_set(void *ptr_session, const char *alpn)
+{
+    int                 ret;
+    char               *wire_format_alpn;
+    struct tls_session *session = ptr_session;
+
+    wire_format_alpn = tls_alpn_wire_format(alpn);
+
+    if (wire_format_alpn == NULL) {
+        return -1;
+    }
+
+    ret = SSL_set_alpn_protos(session->ssl,
+                              (const unsigned char *) &wire_format_alpn[1],
+                              (unsigned int) (unsigned char) wire_format_alpn[0]);
+    flb_free(wire_format_alpn);
+
+    /* unlike most of the API, SSL_set_alpn_protos() returns 0 on success */
+    if (ret != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Get the protocol selected through ALPN, returns its length */
+static int tls_session_alpn_get(void *ptr_session, char *buf, size_t size)
+{
+    unsigned int          len;
+    const unsigned char  *data;
+    struct tls_session   *session = ptr_session;
+
+    SSL_get0_alpn_selected(session->ssl, &data, &len);
+
+    if (data == NULL || len == 0 || len >= size) {
+        return 0;
+    }
+
+    memcpy(buf, data, len);
+    buf[len] = '\0';
+
+    return len;
+}
+
 static int tls_net_read(struct flb_tls_session *session,
                         void *buf, size_t len)
 {
@@ -682,8 +834,10 @@ static int tls_net_handshake(struct flb_tls *tls,
     int ret = 0;
     long ssl_code = 0;
     char err_buf[256];
+    const char *server_name = NULL;
     struct tls_session *session = ptr_session;
     struct tls_context *ctx;
+    struct tls_resume_entry *entry;
 
     ctx = session->parent;
     pthread_mutex_lock(&ctx->mutex);
@@ -702,10 +856,22 @@ static int tls_net_handshake(struct flb_tls *tls,
         }
 
         if (vhost != NULL) {
-            SSL_set_tlsext_host_name(session->ssl, vhost);
+            server_name = vhost;
         }
         else if (tls->vhost) {
-            SSL_set_tlsext_host_name(session->ssl, tls->vhost);
+            server_name = tls->vhost;
+        }
+
+        if (server_name != NULL) {
+            SSL_set_tlsext_host_name(session->ssl, server_name);
+
+            /* resume the last session established with the server */
+            if (tls->mode == FLB_TLS_CLIENT_MODE) {
+                entry = tls_resume_entry_get(ctx, server_name);
+                if (entry != NULL && entry->session != NULL) {
+                    SSL_set_session(session->ssl, entry->session);
+                }
+            }
         }
     }
 
@@ -777,6 +943,10 @@ static int tls_net_handshake(struct flb_tls *tls,
 
     session->continuation_flag = FLB_FALSE;
 
+    if (SSL_session_reused(session->ssl)) {
+        flb_trace("[tls] session resumed");
+    }
+
     pthread_mutex_unlock(&ctx->mutex);
     flb_trace("[tls] connection and handshake OK");
     return 0;
@@ -790,6 +960,8 @@ static struct flb_tls_backend tls_openssl = {
     .context_alpn_set     = tls_context_alpn_set,
     .session_create       = tls_session_create,
     .session_destroy      = tls_session_destroy,
+    .session_alpn_set     = tls_session_alpn_set,
+    .session_alpn_get     = tls_session_alpn_get,
     .net_read             = tls_net_read,
     .net_write            = tls_net_write,
     .net_handshake        = tls_net_handshake,
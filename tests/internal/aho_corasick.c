@@ -0,0 +1,175 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_aho_corasick.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "flb_tests_internal.h"
+
+static int contains(const char *buf, size_t len, const char *str, size_t slen)
+{
+    size_t i;
+
+    for (i = 0; i + slen <= len; i++) {
+        if (memcmp(buf + i, str, slen) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void test_basic()
+{
+    int ret;
+    int he;
+    int she;
+    int his;
+    int hers;
+    int dup;
+    char found[8];
+    char *buf = "ushers";
+    struct flb_aho_corasick *ac;
+
+    ac = flb_aho_corasick_create();
+    TEST_CHECK(ac != NULL);
+    if (!ac) {
+        exit(EXIT_FAILURE);
+    }
+
+    he = flb_aho_corasick_add(ac, "he", 2);
+    she = flb_aho_corasick_add(ac, "she", 3);
+    his = flb_aho_corasick_add(ac, "his", 3);
+    hers = flb_aho_corasick_add(ac, "hers", 4);
+    dup = flb_aho_corasick_add(ac, "she", 3);
+    TEST_CHECK(he == 0 && she == 1 && his == 2 && hers == 3 && dup == 4);
+
+    /* empty patterns are rejected */
+    TEST_CHECK(flb_aho_corasick_add(ac, "", 0) == -1);
+
+    ret = flb_aho_corasick_build(ac);
+    TEST_CHECK(ret == 0);
+
+    /* no more patterns once it's built */
+    TEST_CHECK(flb_aho_corasick_add(ac, "us", 2) == -1);
+
+    memset(found, 0, sizeof(found));
+    ret = flb_aho_corasick_search(ac, buf, strlen(buf), found);
+    TEST_CHECK(ret == 4);
+    TEST_CHECK(found[he] && found[she] && !found[his] && found[hers] &&
+               found[dup]);
+
+    /* entries already set are not counted again */
+    ret = flb_aho_corasick_search(ac, "this", 4, found);
+    TEST_CHECK(ret == 1);
+    TEST_CHECK(found[his]);
+
+    memset(found, 0, sizeof(found));
+    ret = flb_aho_corasick_search(ac, "", 0, found);
+    TEST_CHECK(ret == 0);
+
+    flb_aho_corasick_destroy(ac);
+}
+
+static void test_binary()
+{
+    int a;
+    int b;
+    int ret;
+    char found[2];
+    struct flb_aho_corasick *ac;
+
+    ac = flb_aho_corasick_create();
+    TEST_CHECK(ac != NULL);
+    if (!ac) {
+        exit(EXIT_FAILURE);
+    }
+
+    a = flb_aho_corasick_add(ac, "\0\xff", 2);
+    b = flb_aho_corasick_add(ac, "\xff\xfe", 2);
+    ret = flb_aho_corasick_build(ac);
+    TEST_CHECK(ret == 0);
+
+    memset(found, 0, sizeof(found));
+    ret = flb_aho_corasick_search(ac, "x\0\xff", 3, found);
+    TEST_CHECK(ret == 1 && found[a] && !found[b]);
+
+    memset(found, 0, sizeof(found));
+    ret = flb_aho_corasick_search(ac, "\xff\xff\xfe", 3, found);
+    TEST_CHECK(ret == 1 && !found[a] && found[b]);
+
+    flb_aho_corasick_destroy(ac);
+}
+
+/* Compare every search with a naive lookup of each pattern */
+static void test_random()
+{
+    int i;
+    int j;
+    int n;
+    int ret;
+    int round;
+    int patterns;
+    int expected;
+    size_t len;
+    size_t plen[32];
+    char pattern[32][8];
+    char found[32];
+    char buf[512];
+    struct flb_aho_corasick *ac;
+
+    srand(1);
+
+    for (round = 0; round < 500; round++) {
+        ac = flb_aho_corasick_create();
+        TEST_CHECK(ac != NULL);
+        if (!ac) {
+            exit(EXIT_FAILURE);
+        }
+
+        /* small alphabet so patterns overlap and share suffixes */
+        patterns = 1 + rand() % 32;
+        for (i = 0; i < patterns; i++) {
+            plen[i] = 1 + rand() % 6;
+            for (j = 0; j < plen[i]; j++) {
+                pattern[i][j] = 'a' + rand() % 4;
+            }
+            ret = flb_aho_corasick_add(ac, pattern[i], plen[i]);
+            TEST_CHECK(ret == i);
+        }
+        ret = flb_aho_corasick_build(ac);
+        TEST_CHECK(ret == 0);
+
+        for (n = 0; n < 10; n++) {
+            len = rand() % sizeof(buf);
+            for (i = 0; i < len; i++) {
+                buf[i] = 'a' + rand() % 5;
+            }
+
+            memset(found, 0, sizeof(found));
+            ret = flb_aho_corasick_search(ac, buf, len, found);
+
+            expected = 0;
+            for (i = 0; i < patterns; i++) {
+                j = contains(buf, len, pattern[i], plen[i]);
+                expected += j;
+                if (!TEST_CHECK(found[i] == j)) {
+                    TEST_MSG("round %d pattern %.*s expected %d",
+                             round, (int) plen[i], pattern[i], j);
+                }
+            }
+            TEST_CHECK(ret == expected);
+        }
+
+        flb_aho_corasick_destroy(ac);
+    }
+}
+
+TEST_LIST = {
+    { "basic",  test_basic},
+    { "binary", test_binary},
+    { "random", test_random},
+    { 0 }
+};
@@ -0,0 +1,210 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_arena.h>
+#include <fluent-bit/flb_mp_chunk.h>
+#include <fluent-bit/flb_log_event_encoder.h>
+#include <fluent-bit/flb_log_event_decoder.h>
+
+#include <string.h>
+
+#include "flb_tests_internal.h"
+
+static void test_alloc()
+{
+    int i;
+    char *a;
+    char *b;
+    char *big;
+    struct flb_arena *arena;
+
+    arena = flb_arena_create(1024);
+    TEST_CHECK(arena != NULL);
+    if (!arena) {
+        exit(EXIT_FAILURE);
+    }
+
+    a = flb_arena_alloc(arena, 3);
+    b = flb_arena_alloc(arena, 5);
+    TEST_CHECK(a != NULL && b != NULL);
+
+    /* allocations are aligned and don't overlap */
+    TEST_CHECK(((uintptr_t) a % FLB_ARENA_ALIGN) == 0);
+    TEST_CHECK(((uintptr_t) b % FLB_ARENA_ALIGN) == 0);
+    TEST_CHECK(b >= a + 3);
+    TEST_CHECK(arena->used == 2 * FLB_ARENA_ALIGN);
+
+    /* bigger than a block */
+    big = flb_arena_calloc(arena, 4096);
+    TEST_CHECK(big != NULL);
+    for (i = 0; i < 4096; i++) {
+        if (big[i] != 0) {
+            break;
+        }
+    }
+    TEST_CHECK(i == 4096);
+    TEST_CHECK(arena->block->next != NULL);
+
+    /* a reset leaves a single block that fits the previous usage */
+    flb_arena_reset(arena);
+    TEST_CHECK(arena->used == 0);
+    TEST_CHECK(arena->block != NULL && arena->block->next == NULL);
+    TEST_CHECK(arena->block->size >= 4096 + 2 * FLB_ARENA_ALIGN);
+    TEST_CHECK(arena->high_water == 4096 + 2 * FLB_ARENA_ALIGN);
+
+    /* the same usage fits in the block kept */
+    a = flb_arena_alloc(arena, 4096);
+    b = flb_arena_alloc(arena, 16);
+    TEST_CHECK(a != NULL && b != NULL);
+    TEST_CHECK(arena->block->next == NULL);
+
+    flb_arena_destroy(arena);
+}
+
+static void test_scope()
+{
+    struct flb_arena *arena;
+
+    arena = flb_arena_create(0);
+    TEST_CHECK(arena != NULL);
+    if (!arena) {
+        exit(EXIT_FAILURE);
+    }
+    TEST_CHECK(arena->block_size == FLB_ARENA_BLOCK_SIZE);
+
+    flb_arena_scope_begin(arena);
+    flb_arena_alloc(arena, 100);
+
+    /* nested scope, closing it keeps the memory */
+    flb_arena_scope_begin(arena);
+    flb_arena_alloc(arena, 100);
+    flb_arena_scope_end(arena);
+    TEST_CHECK(arena->used > 0);
+
+    /* outer scope releases everything */
+    flb_arena_scope_end(arena);
+    TEST_CHECK(arena->scopes == 0);
+    TEST_CHECK(arena->used == 0);
+
+    /* unbalanced end is ignored */
+    flb_arena_scope_end(arena);
+    TEST_CHECK(arena->scopes == 0);
+
+    flb_arena_destroy(arena);
+}
+
+static void test_thread()
+{
+    struct flb_arena *arena;
+
+    flb_arena_init();
+
+    arena = flb_arena_thread_get();
+    TEST_CHECK(arena != NULL);
+    TEST_CHECK(flb_arena_thread_get() == arena);
+
+    flb_arena_alloc(arena, 64);
+    TEST_CHECK(flb_arena_high_water() >= 64);
+    TEST_CHECK(flb_arena_reserved() >= FLB_ARENA_BLOCK_SIZE);
+
+    flb_arena_thread_destroy();
+}
+
+static void test_chunk_records()
+{
+    int i;
+    int ret;
+    int count;
+    char *out_buf;
+    size_t out_size;
+    struct flb_arena *arena;
+    struct flb_mp_chunk_record *record;
+    struct flb_mp_chunk_record *heap_record;
+    struct flb_mp_chunk_cobj *chunk_cobj;
+    struct flb_log_event_encoder *encoder;
+    struct flb_log_event_decoder *decoder;
+    struct flb_log_event_encoder *input;
+
+    input = flb_log_event_encoder_create(FLB_LOG_EVENT_FORMAT_DEFAULT);
+    TEST_CHECK(input != NULL);
+    if (!input) {
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < 10; i++) {
+        flb_log_event_encoder_begin_record(input);
+        flb_log_event_encoder_set_current_timestamp(input);
+        flb_log_event_encoder_append_body_values(input,
+            FLB_LOG_EVENT_CSTRING_VALUE("key"),
+            FLB_LOG_EVENT_INT64_VALUE(i));
+        ret = flb_log_event_encoder_commit_record(input);
+        TEST_CHECK(ret == FLB_EVENT_ENCODER_SUCCESS);
+    }
+
+    encoder = flb_log_event_encoder_create(FLB_LOG_EVENT_FORMAT_DEFAULT);
+    decoder = flb_log_event_decoder_create(input->output_buffer,
+                                           input->output_length);
+    TEST_CHECK(encoder != NULL && decoder != NULL);
+    if (!encoder || !decoder) {
+        exit(EXIT_FAILURE);
+    }
+
+    arena = flb_arena_create(0);
+    TEST_CHECK(arena != NULL);
+    if (!arena) {
+        exit(EXIT_FAILURE);
+    }
+    flb_arena_scope_begin(arena);
+
+    chunk_cobj = flb_mp_chunk_cobj_create_with_arena(encoder, decoder, arena);
+    TEST_CHECK(chunk_cobj != NULL);
+    if (!chunk_cobj) {
+        exit(EXIT_FAILURE);
+    }
+
+    count = 0;
+    while (flb_mp_chunk_cobj_record_next(chunk_cobj, &record) ==
+           FLB_MP_CHUNK_RECORD_OK) {
+        TEST_CHECK(record->arena == arena);
+        count++;
+    }
+    TEST_CHECK(count == 10);
+    TEST_CHECK(arena->used >= 10 * sizeof(struct flb_mp_chunk_record));
+
+    /* records created without a chunk live in the heap, even on the list */
+    heap_record = flb_mp_chunk_record_create(NULL);
+    TEST_CHECK(heap_record != NULL && heap_record->arena == NULL);
+    if (!heap_record) {
+        exit(EXIT_FAILURE);
+    }
+    flb_time_get(&heap_record->event.timestamp);
+    cfl_list_add(&heap_record->_head, &chunk_cobj->records);
+
+    /* remove the first record */
+    record = cfl_list_entry_first(&chunk_cobj->records,
+                                  struct flb_mp_chunk_record, _head);
+    flb_mp_chunk_cobj_record_destroy(chunk_cobj, record);
+    TEST_CHECK(cfl_list_size(&chunk_cobj->records) == 10);
+
+    ret = flb_mp_chunk_cobj_encode(chunk_cobj, &out_buf, &out_size);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(out_size > 0);
+
+    flb_mp_chunk_cobj_destroy(chunk_cobj);
+    flb_arena_scope_end(arena);
+    TEST_CHECK(arena->used == 0);
+
+    flb_arena_destroy(arena);
+    flb_log_event_decoder_destroy(decoder);
+    flb_log_event_encoder_destroy(encoder);
+    flb_log_event_encoder_destroy(input);
+}
+
+TEST_LIST = {
+    { "alloc",         test_alloc},
+    { "scope",         test_scope},
+    { "thread",        test_thread},
+    { "chunk_records", test_chunk_records},
+    { 0 }
+};
@@ -0,0 +1,511 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_sds.h>
+#include <fluent-bit/flb_gzip.h>
+#include <fluent-bit/flb_lz4.h>
+#include <fluent-bit/flb_compression.h>
+#ifdef FLB_HAVE_ZSTD
+#include <fluent-bit/flb_zstd.h>
+#endif
+#include <cfl/cfl.h>
+
+#include "flb_tests_internal.h"
+
+/* Sample data */
+static char *morpheus = "This is your last chance. After this, there is no "
+    "turning back. You take the blue pill - the story ends, you wake up in "
+    "your bed and believe whatever you want to believe. You take the red pill,"
+    "you stay in Wonderland and I show you how deep the rabbit-hole goes.";
+
+/*
+ * 'morpheus' x 3 compressed with the lz4 command line tool using block
+ * checksums, content size and content checksum:
+ *
+ *   lz4 -c -BD -BX --content-size
+ */
+static unsigned char morpheus_lz4_cli[] = {
+  0x04, 0x22, 0x4d, 0x18, 0x7c, 0x40, 0x0f, 0x03, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0xce, 0xf1, 0x00, 0x00, 0x00, 0xf0, 0x1c, 0x54, 0x68, 0x69,
+  0x73, 0x20, 0x69, 0x73, 0x20, 0x79, 0x6f, 0x75, 0x72, 0x20, 0x6c, 0x61,
+  0x73, 0x74, 0x20, 0x63, 0x68, 0x61, 0x6e, 0x63, 0x65, 0x2e, 0x20, 0x41,
+  0x66, 0x74, 0x65, 0x72, 0x20, 0x74, 0x68, 0x69, 0x73, 0x2c, 0x20, 0x74,
+  0x68, 0x65, 0x72, 0x65, 0x27, 0x00, 0xf0, 0x0a, 0x6e, 0x6f, 0x20, 0x74,
+  0x75, 0x72, 0x6e, 0x69, 0x6e, 0x67, 0x20, 0x62, 0x61, 0x63, 0x6b, 0x2e,
+  0x20, 0x59, 0x6f, 0x75, 0x20, 0x74, 0x61, 0x6b, 0x65, 0x23, 0x00, 0xc1,
+  0x20, 0x62, 0x6c, 0x75, 0x65, 0x20, 0x70, 0x69, 0x6c, 0x6c, 0x20, 0x2d,
+  0x10, 0x00, 0xb0, 0x73, 0x74, 0x6f, 0x72, 0x79, 0x20, 0x65, 0x6e, 0x64,
+  0x73, 0x2c, 0x61, 0x00, 0x20, 0x20, 0x77, 0x29, 0x00, 0x50, 0x75, 0x70,
+  0x20, 0x69, 0x6e, 0x0f, 0x00, 0xf0, 0x0b, 0x72, 0x20, 0x62, 0x65, 0x64,
+  0x20, 0x61, 0x6e, 0x64, 0x20, 0x62, 0x65, 0x6c, 0x69, 0x65, 0x76, 0x65,
+  0x20, 0x77, 0x68, 0x61, 0x74, 0x65, 0x76, 0x65, 0x72, 0x1e, 0x00, 0x84,
+  0x20, 0x77, 0x61, 0x6e, 0x74, 0x20, 0x74, 0x6f, 0x1d, 0x00, 0x0b, 0x6b,
+  0x00, 0x31, 0x72, 0x65, 0x64, 0x6a, 0x00, 0x90, 0x2c, 0x79, 0x6f, 0x75,
+  0x20, 0x73, 0x74, 0x61, 0x79, 0x55, 0x00, 0x70, 0x57, 0x6f, 0x6e, 0x64,
+  0x65, 0x72, 0x6c, 0x53, 0x00, 0x00, 0x04, 0x00, 0x61, 0x49, 0x20, 0x73,
+  0x68, 0x6f, 0x77, 0x4d, 0x00, 0x00, 0x08, 0x00, 0x41, 0x64, 0x65, 0x65,
+  0x70, 0x97, 0x00, 0xff, 0x02, 0x72, 0x61, 0x62, 0x62, 0x69, 0x74, 0x2d,
+  0x68, 0x6f, 0x6c, 0x65, 0x20, 0x67, 0x6f, 0x65, 0x73, 0x2e, 0x05, 0x01,
+  0xff, 0xf3, 0x50, 0x67, 0x6f, 0x65, 0x73, 0x2e, 0x1d, 0x22, 0x9b, 0x78,
+  0x00, 0x00, 0x00, 0x00, 0xca, 0x3b, 0xc2, 0x12
+};
+
+/* Build a log corpus mixing the usual formats: apache, JSON and syslog */
+static flb_sds_t log_corpus_create(size_t size)
+{
+    int i = 0;
+    uint32_t seed = 0x2545F491;
+    flb_sds_t corpus;
+    flb_sds_t tmp;
+    static const char *methods[] = {"GET", "POST", "PUT", "DELETE"};
+    static const char *paths[] = {
+        "/api/v1/users", "/api/v1/orders", "/static/app.js",
+        "/healthz", "/api/v2/search?q=fluent"
+    };
+    static const char *levels[] = {"info", "warn", "error", "debug"};
+
+    corpus = flb_sds_create_size(size + 512);
+    if (!corpus) {
+        return NULL;
+    }
+
+    while (flb_sds_len(corpus) < size) {
+        seed = seed * 1103515245 + 12345;
+
+        if (i % 3 == 0) {
+            tmp = flb_sds_printf(&corpus,
+                                 "192.168.%u.%u - - [16/Oct/2026:10:%02u:%02u +0000] "
+                                 "\"%s %s HTTP/1.1\" %u %u \"-\" "
+                                 "\"Mozilla/5.0 (X11; Linux x86_64)\"\n",
+                                 (seed >> 8) & 0xff, (seed >> 16) & 0xff,
+                                 (seed >> 4) % 60, (seed >> 10) % 60,
+                                 methods[(seed >> 3) % 4], paths[(seed >> 5) % 5],
+                                 (seed % 7 == 0) ? 500 : 200, (seed >> 12) % 65536);
+        }
+        else if (i % 3 == 1) {
+            tmp = flb_sds_printf(&corpus,
+                                 "{\"time\":\"2026-10-16T10:%02u:%02u.%03uZ\","
+                                 "\"level\":\"%s\",\"service\":\"checkout\","
+                                 "\"trace_id\":\"%08x%08x\",\"latency_ms\":%u,"
+                                 "\"msg\":\"request processed\"}\n",
+                                 (seed >> 4) % 60, (seed >> 10) % 60, seed % 1000,
+                                 levels[(seed >> 7) % 4], seed, seed ^ 0x5bd1e995,
+                                 (seed >> 16) % 2000);
+        }
+        else {
+            tmp = flb_sds_printf(&corpus,
+                                 "Oct 16 10:%02u:%02u node-%u kernel: [%u.%06u] "
+                                 "eth0: link up, 1000Mbps, full-duplex\n",
+                                 (seed >> 4) % 60, (seed >> 10) % 60,
+                                 (seed >> 20) % 16, (seed >> 8) % 100000,
+                                 seed % 1000000);
+        }
+
+        if (!tmp) {
+            flb_sds_destroy(corpus);
+            return NULL;
+        }
+        i++;
+    }
+
+    return corpus;
+}
+
+static void check_round_trip(int algorithm, char *data, size_t size)
+{
+    int ret;
+    void *compressed;
+    size_t compressed_size;
+    void *uncompressed;
+    size_t uncompressed_size;
+
+    ret = flb_compress(algorithm, data, size, &compressed, &compressed_size);
+    TEST_CHECK(ret == 0);
+    if (ret != 0) {
+        return;
+    }
+
+    ret = flb_uncompress(algorithm, compressed, compressed_size,
+                         &uncompressed, &uncompressed_size, 0);
+    TEST_CHECK(ret == 0);
+    if (ret == 0) {
+        TEST_CHECK(uncompressed_size == size);
+        TEST_CHECK(uncompressed_size == size &&
+                   memcmp(uncompressed, data, size) == 0);
+        TEST_MSG("algorithm=%s size=%zu",
+                 flb_compression_get_algorithm_name(algorithm), size);
+        flb_free(uncompressed);
+    }
+
+    flb_free(compressed);
+}
+
+/* Feed the compressed data in small pieces through a decompression context */
+static void check_streaming(int algorithm, char *data, size_t size,
+                            size_t input_step, size_t output_step)
+{
+    int ret;
+    char *output;
+    size_t offset;
+    size_t length;
+    size_t output_length;
+    size_t produced;
+    void *compressed;
+    size_t compressed_size;
+    struct flb_decompression_context *context;
+
+    ret = flb_compress(algorithm, data, size, &compressed, &compressed_size);
+    TEST_CHECK(ret == 0);
+    if (ret != 0) {
+        return;
+    }
+
+    context = flb_decompression_context_create(algorithm, 0);
+    TEST_CHECK(context != NULL);
+    if (!context) {
+        flb_free(compressed);
+        return;
+    }
+
+    output = flb_malloc(size + output_step);
+    TEST_CHECK(output != NULL);
+
+    offset = 0;
+    produced = 0;
+    while (1) {
+        length = compressed_size - offset;
+        if (length > input_step) {
+            length = input_step;
+        }
+
+        memcpy(flb_decompression_context_get_append_buffer(context),
+               (char *) compressed + offset, length);
+        context->input_buffer_length += length;
+        offset += length;
+
+        output_length = output_step;
+        ret = flb_decompress(context, &output[produced], &output_length);
+        TEST_CHECK(ret == FLB_DECOMPRESSOR_SUCCESS);
+        if (ret != FLB_DECOMPRESSOR_SUCCESS) {
+            break;
+        }
+        produced += output_length;
+
+        if (produced > size) {
+            break;
+        }
+
+        /* all the input has been delivered, stop once nothing comes out */
+        if (offset == compressed_size && output_length == 0) {
+            break;
+        }
+    }
+
+    TEST_CHECK(produced == size);
+    TEST_CHECK(produced == size && memcmp(output, data, size) == 0);
+    TEST_MSG("algorithm=%s size=%zu produced=%zu",
+             flb_compression_get_algorithm_name(algorithm), size, produced);
+
+    flb_free(output);
+    flb_free(compressed);
+    flb_decompression_context_destroy(context);
+}
+
+static void test_lz4_compress()
+{
+    int i;
+    size_t sizes[] = {0, 1, 12, 13, 64, 255, 4096, 65535, 65536, 65537,
+                      300 * 1024};
+    char *random_data;
+    flb_sds_t corpus;
+
+    check_round_trip(FLB_COMPRESSION_ALGORITHM_LZ4, morpheus, strlen(morpheus));
+
+    corpus = log_corpus_create(300 * 1024);
+    TEST_CHECK(corpus != NULL);
+
+    random_data = flb_malloc(300 * 1024);
+    TEST_CHECK(random_data != NULL);
+    for (i = 0; i < 300 * 1024; i++) {
+        random_data[i] = (char) (rand() & 0xff);
+    }
+
+    for (i = 0; i < sizeof(sizes) / sizeof(size_t); i++) {
+        check_round_trip(FLB_COMPRESSION_ALGORITHM_LZ4, corpus, sizes[i]);
+        check_round_trip(FLB_COMPRESSION_ALGORITHM_LZ4, random_data, sizes[i]);
+    }
+
+    flb_free(random_data);
+    flb_sds_destroy(corpus);
+}
+
+static void test_lz4_interop()
+{
+    int ret;
+    void *out;
+    size_t out_size;
+    flb_sds_t expected;
+
+    expected = flb_sds_create(morpheus);
+    flb_sds_cat_safe(&expected, morpheus, strlen(morpheus));
+    flb_sds_cat_safe(&expected, morpheus, strlen(morpheus));
+
+    ret = flb_lz4_uncompress(morpheus_lz4_cli, sizeof(morpheus_lz4_cli),
+                             &out, &out_size, 0);
+    TEST_CHECK(ret == 0);
+    if (ret == 0) {
+        TEST_CHECK(out_size == flb_sds_len(expected));
+        TEST_CHECK(memcmp(out, expected, flb_sds_len(expected)) == 0);
+        flb_free(out);
+    }
+
+    flb_sds_destroy(expected);
+}
+
+static void test_lz4_corrupted()
+{
+    int ret;
+    void *out;
+    size_t out_size;
+    unsigned char frame[sizeof(morpheus_lz4_cli)];
+
+    /* damaged block: caught by the block checksum */
+    memcpy(frame, morpheus_lz4_cli, sizeof(frame));
+    frame[40] ^= 0x01;
+    ret = flb_lz4_uncompress(frame, sizeof(frame), &out, &out_size, 0);
+    TEST_CHECK(ret == -1);
+
+    /* damaged frame descriptor */
+    memcpy(frame, morpheus_lz4_cli, sizeof(frame));
+    frame[5] ^= 0x10;
+    ret = flb_lz4_uncompress(frame, sizeof(frame), &out, &out_size, 0);
+    TEST_CHECK(ret == -1);
+
+    /* truncated frame */
+    ret = flb_lz4_uncompress(morpheus_lz4_cli, sizeof(morpheus_lz4_cli) - 6,
+                             &out, &out_size, 0);
+    TEST_CHECK(ret == -1);
+
+    /* not a frame */
+    ret = flb_lz4_uncompress(morpheus, strlen(morpheus), &out, &out_size, 0);
+    TEST_CHECK(ret == -1);
+}
+
+static void test_lz4_streaming()
+{
+    flb_sds_t corpus;
+
+    corpus = log_corpus_create(512 * 1024);
+    TEST_CHECK(corpus != NULL);
+
+    check_streaming(FLB_COMPRESSION_ALGORITHM_LZ4, corpus, flb_sds_len(corpus),
+                    1000, 4096);
+    check_streaming(FLB_COMPRESSION_ALGORITHM_LZ4, corpus, flb_sds_len(corpus),
+                    128 * 1024, 256 * 1024);
+    check_streaming(FLB_COMPRESSION_ALGORITHM_LZ4, corpus, flb_sds_len(corpus),
+                    1, 100 * 1024);
+
+    flb_sds_destroy(corpus);
+}
+
+#ifdef FLB_HAVE_ZSTD
+static void test_zstd_compress()
+{
+    flb_sds_t corpus;
+
+    check_round_trip(FLB_COMPRESSION_ALGORITHM_ZSTD, morpheus, strlen(morpheus));
+
+    corpus = log_corpus_create(300 * 1024);
+    TEST_CHECK(corpus != NULL);
+
+    check_round_trip(FLB_COMPRESSION_ALGORITHM_ZSTD, corpus, 0);
+    check_round_trip(FLB_COMPRESSION_ALGORITHM_ZSTD, corpus, flb_sds_len(corpus));
+
+    flb_sds_destroy(corpus);
+}
+
+static void test_zstd_streaming()
+{
+    flb_sds_t corpus;
+
+    corpus = log_corpus_create(512 * 1024);
+    TEST_CHECK(corpus != NULL);
+
+    check_streaming(FLB_COMPRESSION_ALGORITHM_ZSTD, corpus, flb_sds_len(corpus),
+                    1000, 4096);
+    check_streaming(FLB_COMPRESSION_ALGORITHM_ZSTD, corpus, flb_sds_len(corpus),
+                    128 * 1024, 256 * 1024);
+
+    flb_sds_destroy(corpus);
+}
+#endif
+
+/* A small payload that expands a lot must not go over the size limit */
+static void test_max_size()
+{
+    int i;
+    int ret;
+    int algorithms[] = {FLB_COMPRESSION_ALGORITHM_GZIP,
+                        FLB_COMPRESSION_ALGORITHM_ZSTD,
+                        FLB_COMPRESSION_ALGORITHM_LZ4};
+    char *data;
+    size_t size = 4 * 1024 * 1024;
+    void *compressed;
+    size_t compressed_size;
+    void *uncompressed;
+    size_t uncompressed_size;
+
+    data = flb_calloc(1, size);
+    TEST_CHECK(data != NULL);
+    if (!data) {
+        return;
+    }
+
+    for (i = 0; i < sizeof(algorithms) / sizeof(int); i++) {
+        if (flb_compression_is_supported(algorithms[i]) == FLB_FALSE) {
+            continue;
+        }
+
+        ret = flb_compress(algorithms[i], data, size,
+                           &compressed, &compressed_size);
+        TEST_CHECK(ret == 0);
+        if (ret != 0) {
+            continue;
+        }
+        TEST_CHECK(compressed_size < size / 100);
+
+        /* exactly at the limit */
+        ret = flb_uncompress(algorithms[i], compressed, compressed_size,
+                             &uncompressed, &uncompressed_size, size);
+        TEST_CHECK(ret == 0);
+        TEST_MSG("algorithm=%s",
+                 flb_compression_get_algorithm_name(algorithms[i]));
+        if (ret == 0) {
+            TEST_CHECK(uncompressed_size == size);
+            flb_free(uncompressed);
+        }
+
+        /* one byte over the limit */
+        ret = flb_uncompress(algorithms[i], compressed, compressed_size,
+                             &uncompressed, &uncompressed_size, size - 1);
+        TEST_CHECK(ret == -1);
+        TEST_MSG("algorithm=%s",
+                 flb_compression_get_algorithm_name(algorithms[i]));
+
+        /* far over the limit */
+        ret = flb_uncompress(algorithms[i], compressed, compressed_size,
+                             &uncompressed, &uncompressed_size, 4096);
+        TEST_CHECK(ret == -1);
+
+        flb_free(compressed);
+    }
+
+    flb_free(data);
+}
+
+static void test_algorithm_names()
+{
+    TEST_CHECK(flb_compression_get_algorithm_by_name("gzip", 4) ==
+               FLB_COMPRESSION_ALGORITHM_GZIP);
+    TEST_CHECK(flb_compression_get_algorithm_by_name("ZSTD", 4) ==
+               FLB_COMPRESSION_ALGORITHM_ZSTD);
+    TEST_CHECK(flb_compression_get_algorithm_by_name("lz4", 3) ==
+               FLB_COMPRESSION_ALGORITHM_LZ4);
+    TEST_CHECK(flb_compression_get_algorithm_by_name("br", 2) == -1);
+    TEST_CHECK(flb_compression_is_supported(FLB_COMPRESSION_ALGORITHM_LZ4) ==
+               FLB_TRUE);
+}
+
+/*
+ * Set FLB_COMPRESSION_BENCH to a number of rounds to report the ratio and
+ * throughput of each codec over the same log corpus.
+ */
+static void test_bench()
+{
+    int i;
+    int r;
+    int ret;
+    int rounds;
+    char *env;
+    int algorithms[] = {FLB_COMPRESSION_ALGORITHM_GZIP,
+                        FLB_COMPRESSION_ALGORITHM_ZSTD,
+                        FLB_COMPRESSION_ALGORITHM_LZ4};
+    void *compressed;
+    size_t compressed_size;
+    void *uncompressed;
+    size_t uncompressed_size;
+    uint64_t ts_start;
+    uint64_t ts_compress;
+    uint64_t ts_uncompress;
+    flb_sds_t corpus;
+
+    env = getenv("FLB_COMPRESSION_BENCH");
+    if (!env || (rounds = atoi(env)) <= 0) {
+        return;
+    }
+
+    corpus = log_corpus_create(4 * 1024 * 1024);
+    TEST_CHECK(corpus != NULL);
+
+    printf("\n");
+    for (i = 0; i < sizeof(algorithms) / sizeof(int); i++) {
+        if (flb_compression_is_supported(algorithms[i]) == FLB_FALSE) {
+            continue;
+        }
+
+        ts_compress = 0;
+        ts_uncompress = 0;
+        compressed_size = 0;
+
+        for (r = 0; r < rounds; r++) {
+            ts_start = cfl_time_now();
+            ret = flb_compress(algorithms[i], corpus, flb_sds_len(corpus),
+                               &compressed, &compressed_size);
+            ts_compress += cfl_time_now() - ts_start;
+            TEST_CHECK(ret == 0);
+            if (ret != 0) {
+                break;
+            }
+
+            ts_start = cfl_time_now();
+            ret = flb_uncompress(algorithms[i], compressed, compressed_size,
+                                 &uncompressed, &uncompressed_size, 0);
+            ts_uncompress += cfl_time_now() - ts_start;
+            TEST_CHECK(ret == 0);
+            if (ret == 0) {
+                TEST_CHECK(uncompressed_size == flb_sds_len(corpus));
+                flb_free(uncompressed);
+            }
+            flb_free(compressed);
+        }
+
+        printf("[compression] %-4s ratio=%.2f compress=%.1f MB/s "
+               "uncompress=%.1f MB/s\n",
+               flb_compression_get_algorithm_name(algorithms[i]),
+               (double) flb_sds_len(corpus) / compressed_size,
+               ((double) flb_sds_len(corpus) * rounds / (1024 * 1024)) /
+               ((double) ts_compress / 1e9),
+               ((double) flb_sds_len(corpus) * rounds / (1024 * 1024)) /
+               ((double) ts_uncompress / 1e9));
+    }
+
+    flb_sds_destroy(corpus);
+}
+
+TEST_LIST = {
+    {"lz4_compress", test_lz4_compress},
+    {"lz4_interop", test_lz4_interop},
+    {"lz4_corrupted", test_lz4_corrupted},
+    {"lz4_streaming", test_lz4_streaming},
+#ifdef FLB_HAVE_ZSTD
+    {"zstd_compress", test_zstd_compress},
+    {"zstd_streaming", test_zstd_streaming},
+#endif
+    {"max_size", test_max_size},
+    {"algorithm_names", test_algorithm_names},
+
+    /* Benchmark, only runs when FLB_COMPRESSION_BENCH is set */
+    {"bench", test_bench},
+    { 0 }
+};
@@ -0,0 +1,647 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_log.h>
+#include <fluent-bit/flb_config.h>
+#include <fluent-bit/flb_filter.h>
+#include <fluent-bit/flb_filter_worker.h>
+#include <fluent-bit/flb_input_chunk.h>
+#include <fluent-bit/flb_mp.h>
+#include <fluent-bit/flb_time.h>
+#include <msgpack.h>
+
+#include "flb_tests_internal.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define APACHE_10K    FLB_TESTS_DATA_PATH "/data/mp/apache_10k.mp"
+
+static pthread_t main_thread;
+static int calls_in_workers;
+static int bad_worker_ids;
+static int test_workers_count;
+static int drop_all;
+static const char *records_base;
+static size_t records_size;
+
+/*
+ * Test filter: depending on the size of every record it's dropped, kept or
+ * duplicated, so the output does not depend on how the records are split.
+ */
+static int cb_test_filter(const void *data, size_t bytes,
+                          const char *tag, int tag_len,
+                          void **out_buf, size_t *out_bytes,
+                          struct flb_filter_instance *f_ins,
+                          struct flb_input_instance *i_ins,
+                          void *context,
+                          struct flb_config *config)
+{
+    size_t off = 0;
+    size_t prev = 0;
+    size_t len;
+    msgpack_sbuffer sbuf;
+    msgpack_unpacked result;
+
+    if (!pthread_equal(pthread_self(), main_thread)) {
+        __sync_fetch_and_add(&calls_in_workers, 1);
+        if (flb_filter_worker_id() < 1 ||
+            flb_filter_worker_id() > test_workers_count) {
+            __sync_fetch_and_add(&bad_worker_ids, 1);
+        }
+    }
+    else if (flb_filter_worker_id() != 0) {
+        __sync_fetch_and_add(&bad_worker_ids, 1);
+    }
+
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_unpacked_init(&result);
+    while (msgpack_unpack_next(&result, data, bytes, &off) ==
+           MSGPACK_UNPACK_SUCCESS) {
+        len = off - prev;
+        if (len % 3 != 0) {
+            msgpack_sbuffer_write(&sbuf, (char *) data + prev, len);
+        }
+        if (len % 5 == 0) {
+            msgpack_sbuffer_write(&sbuf, (char *) data + prev, len);
+        }
+        prev = off;
+    }
+    msgpack_unpacked_destroy(&result);
+
+    *out_buf = sbuf.data;
+    *out_bytes = sbuf.size;
+
+    return FLB_FILTER_MODIFIED;
+}
+
+static struct flb_filter_plugin test_threadsafe_plugin = {
+    .name         = "test_threadsafe",
+    .description  = "test filter",
+    .cb_filter    = cb_test_filter,
+    .flags        = FLB_FILTER_THREADSAFE
+};
+
+static struct flb_filter_plugin test_serial_plugin = {
+    .name         = "test_serial",
+    .description  = "test filter",
+    .cb_filter    = cb_test_filter,
+    .flags        = 0
+};
+
+/*
+ * Copy the records as they are. The slices of the start of the buffer take
+ * longer, so the workers complete them in the reverse order.
+ */
+static int cb_slow_filter(const void *data, size_t bytes,
+                          const char *tag, int tag_len,
+                          void **out_buf, size_t *out_bytes,
+                          struct flb_filter_instance *f_ins,
+                          struct flb_input_instance *i_ins,
+                          void *context,
+                          struct flb_config *config)
+{
+    size_t pos;
+    char *buf;
+
+    pos = ((const char *) data - records_base) * 10 / records_size;
+    flb_time_msleep(10 * (10 - pos));
+
+    buf = flb_malloc(bytes);
+    if (!buf) {
+        return FLB_FILTER_NOTOUCH;
+    }
+    memcpy(buf, data, bytes);
+
+    *out_buf = buf;
+    *out_bytes = bytes;
+
+    return FLB_FILTER_MODIFIED;
+}
+
+/* Drop the records of the slices that run in a worker */
+static int cb_drop_filter(const void *data, size_t bytes,
+                          const char *tag, int tag_len,
+                          void **out_buf, size_t *out_bytes,
+                          struct flb_filter_instance *f_ins,
+                          struct flb_input_instance *i_ins,
+                          void *context,
+                          struct flb_config *config)
+{
+    if (pthread_equal(pthread_self(), main_thread) && !drop_all) {
+        return FLB_FILTER_NOTOUCH;
+    }
+
+    *out_buf = NULL;
+    *out_bytes = 0;
+
+    return FLB_FILTER_MODIFIED;
+}
+
+static struct flb_filter_plugin test_slow_plugin = {
+    .name         = "test_slow",
+    .description  = "test filter",
+    .cb_filter    = cb_slow_filter,
+    .flags        = FLB_FILTER_THREADSAFE
+};
+
+static struct flb_filter_plugin test_drop_plugin = {
+    .name         = "test_drop",
+    .description  = "test filter",
+    .cb_filter    = cb_drop_filter,
+    .flags        = FLB_FILTER_THREADSAFE
+};
+
+/* Job of the pool tests */
+struct test_job {
+    struct flb_filter_job job;
+    int id;
+};
+
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct flb_filter_pool *jobs_pool;
+static int jobs_done;
+static int jobs_order[64];
+static int jobs_max_queued;
+static int jobs_done_before_first;
+
+static void cb_test_job(struct flb_filter_job *job)
+{
+    struct test_job *t = (struct test_job *) job;
+
+    pthread_mutex_lock(&jobs_pool->mutex);
+    if (jobs_pool->queue_count > jobs_max_queued) {
+        jobs_max_queued = jobs_pool->queue_count;
+    }
+    pthread_mutex_unlock(&jobs_pool->mutex);
+
+    pthread_mutex_lock(&jobs_mutex);
+    if (t->id == 0) {
+        jobs_done_before_first = jobs_done;
+    }
+    pthread_mutex_unlock(&jobs_mutex);
+
+    flb_time_msleep(5);
+
+    pthread_mutex_lock(&jobs_mutex);
+    jobs_order[jobs_done++] = t->id;
+    pthread_mutex_unlock(&jobs_mutex);
+}
+
+static struct flb_config *config_create(int workers, const char *plugin)
+{
+    struct flb_config *config;
+    struct flb_filter_instance *ins;
+
+    config = flb_config_init();
+    if (!config) {
+        return NULL;
+    }
+    flb_log_create(config, FLB_LOG_STDERR, FLB_LOG_INFO, NULL);
+
+    mk_list_add(&test_threadsafe_plugin._head, &config->filter_plugins);
+    mk_list_add(&test_serial_plugin._head, &config->filter_plugins);
+    mk_list_add(&test_slow_plugin._head, &config->filter_plugins);
+    mk_list_add(&test_drop_plugin._head, &config->filter_plugins);
+
+    config->filter_workers = workers;
+    test_workers_count = workers;
+
+    ins = flb_filter_new(config, plugin, NULL);
+    TEST_CHECK(ins != NULL);
+    flb_filter_set_property(ins, "match", "*");
+
+    TEST_CHECK(flb_filter_init_all(config) == 0);
+    return config;
+}
+
+static void config_destroy(struct flb_config *config)
+{
+    flb_filter_exit(config);
+
+    /* the test plugins are static, do not let the config release them */
+    mk_list_del(&test_threadsafe_plugin._head);
+    mk_list_del(&test_serial_plugin._head);
+    mk_list_del(&test_slow_plugin._head);
+    mk_list_del(&test_drop_plugin._head);
+    flb_config_exit(config);
+}
+
+static void run_filters(struct flb_config *config,
+                        char *data, size_t size, int records,
+                        void **out_buf, size_t *out_size, int *out_records)
+{
+    struct flb_input_chunk ic = {0};
+
+    ic.added_records = records;
+    ic.total_records = records + 10;
+
+    flb_filter_do(&ic, data, size, out_buf, out_size, "test", 4, config);
+    *out_records = ic.total_records - 10;
+}
+
+static char *load_records(size_t *size, int *records)
+{
+    char *data;
+    struct stat st;
+
+    if (stat(APACHE_10K, &st) == -1) {
+        return NULL;
+    }
+    data = mk_file_to_buffer(APACHE_10K);
+    *size = st.st_size;
+    *records = flb_mp_count(data, *size);
+
+    return data;
+}
+
+void test_split()
+{
+    int i;
+    int records;
+    size_t size;
+    size_t offsets[5];
+    char *data;
+
+    data = load_records(&size, &records);
+    TEST_CHECK(data != NULL);
+    if (!data) {
+        return;
+    }
+
+    TEST_CHECK(flb_mp_split(data, size, records, 4, offsets) == 0);
+    TEST_CHECK(offsets[0] == 0 && offsets[4] == size);
+    for (i = 0; i < 4; i++) {
+        TEST_CHECK(offsets[i] < offsets[i + 1]);
+        TEST_CHECK(flb_mp_count(data + offsets[i],
+                                offsets[i + 1] - offsets[i]) == records / 4);
+    }
+
+    /* more parts than records */
+    TEST_CHECK(flb_mp_split(data, size, 3, 4, offsets) == -1);
+
+    /* truncated buffer */
+    TEST_CHECK(flb_mp_split(data, 10, records, 4, offsets) == -1);
+
+    flb_free(data);
+}
+
+void test_workers()
+{
+    int ret;
+    double wait;
+    int records;
+    int serial_records;
+    int worker_records;
+    size_t size;
+    size_t serial_size;
+    size_t worker_size;
+    char *data;
+    void *serial_buf;
+    void *worker_buf;
+    struct flb_config *config;
+    struct flb_filter_instance *ins;
+
+    data = load_records(&size, &records);
+    TEST_CHECK(data != NULL);
+    if (!data) {
+        return;
+    }
+    main_thread = pthread_self();
+
+    /* reference output, filters in the caller thread */
+    config = config_create(0, "test_threadsafe");
+    TEST_CHECK(config->filter_pool == NULL);
+    calls_in_workers = 0;
+    run_filters(config, data, size, records,
+                &serial_buf, &serial_size, &serial_records);
+    TEST_CHECK(calls_in_workers == 0);
+    config_destroy(config);
+
+    /* the same records split across the filter workers */
+    config = config_create(3, "test_threadsafe");
+    TEST_CHECK(config->filter_pool != NULL);
+    calls_in_workers = 0;
+    bad_worker_ids = 0;
+    TEST_CHECK(flb_filter_worker_slots(config) == 4);
+    run_filters(config, data, size, records,
+                &worker_buf, &worker_size, &worker_records);
+    TEST_CHECK(calls_in_workers > 0);
+    TEST_CHECK(bad_worker_ids == 0);
+
+    /* the queue wait is reported per filter instance */
+    ins = mk_list_entry_first(&config->filters, struct flb_filter_instance,
+                              _head);
+    TEST_CHECK(ins->cmt_queue_wait != NULL);
+    if (ins->cmt_queue_wait) {
+        ret = cmt_counter_get_val(ins->cmt_queue_wait, 1,
+                                  (char *[]) {(char *) flb_filter_name(ins)},
+                                  &wait);
+        TEST_CHECK(ret == 0);
+        TEST_CHECK(wait > 0);
+    }
+    config_destroy(config);
+
+    TEST_CHECK(serial_records != records);
+    TEST_CHECK(worker_records == serial_records);
+    TEST_MSG("records: serial=%i workers=%i", serial_records, worker_records);
+    TEST_CHECK(worker_size == serial_size);
+    if (worker_size == serial_size) {
+        ret = memcmp(worker_buf, serial_buf, serial_size);
+        TEST_CHECK(ret == 0);
+    }
+    TEST_CHECK(flb_mp_count(worker_buf, worker_size) == worker_records);
+
+    flb_free(serial_buf);
+    flb_free(worker_buf);
+    flb_free(data);
+}
+
+void test_workers_not_threadsafe()
+{
+    int records;
+    int out_records;
+    size_t size;
+    size_t out_size;
+    char *data;
+    void *out_buf;
+    struct flb_config *config;
+
+    data = load_records(&size, &records);
+    TEST_CHECK(data != NULL);
+    if (!data) {
+        return;
+    }
+    main_thread = pthread_self();
+
+    /* a filter that is not thread safe always runs in the caller thread */
+    config = config_create(3, "test_serial");
+    TEST_CHECK(config->filter_pool != NULL);
+    calls_in_workers = 0;
+    run_filters(config, data, size, records,
+                &out_buf, &out_size, &out_records);
+    TEST_CHECK(calls_in_workers == 0);
+    TEST_CHECK(flb_mp_count(out_buf, out_size) == out_records);
+    config_destroy(config);
+
+    flb_free(out_buf);
+    flb_free(data);
+}
+
+void test_split_remainder()
+{
+    int i;
+    size_t offsets[4];
+    msgpack_sbuffer sbuf;
+    msgpack_packer pck;
+
+    msgpack_sbuffer_init(&sbuf);
+    msgpack_packer_init(&pck, &sbuf, msgpack_sbuffer_write);
+    for (i = 0; i < 10; i++) {
+        msgpack_pack_int(&pck, i * 1000);
+    }
+
+    /* the last slice gets the remaining records */
+    TEST_CHECK(flb_mp_split(sbuf.data, sbuf.size, 10, 3, offsets) == 0);
+    TEST_CHECK(flb_mp_count(sbuf.data + offsets[0], offsets[1] - offsets[0]) == 3);
+    TEST_CHECK(flb_mp_count(sbuf.data + offsets[1], offsets[2] - offsets[1]) == 3);
+    TEST_CHECK(flb_mp_count(sbuf.data + offsets[2], offsets[3] - offsets[2]) == 4);
+    TEST_CHECK(offsets[3] == sbuf.size);
+
+    /* a single slice is the whole buffer */
+    TEST_CHECK(flb_mp_split(sbuf.data, sbuf.size, 10, 1, offsets) == 0);
+    TEST_CHECK(offsets[0] == 0 && offsets[1] == sbuf.size);
+
+    TEST_CHECK(flb_mp_split(sbuf.data, sbuf.size, 10, 0, offsets) == -1);
+
+    msgpack_sbuffer_destroy(&sbuf);
+}
+
+void test_workers_order()
+{
+    int records;
+    int out_records;
+    size_t size;
+    size_t out_size;
+    char *data;
+    void *out_buf;
+    struct flb_config *config;
+
+    data = load_records(&size, &records);
+    TEST_CHECK(data != NULL);
+    if (!data) {
+        return;
+    }
+    main_thread = pthread_self();
+    records_base = data;
+    records_size = size;
+
+    /* the slices complete out of order, they are joined in order */
+    config = config_create(3, "test_slow");
+    run_filters(config, data, size, records,
+                &out_buf, &out_size, &out_records);
+    config_destroy(config);
+
+    TEST_CHECK(out_records == records);
+    TEST_CHECK(out_size == size);
+    if (out_size == size) {
+        TEST_CHECK(memcmp(out_buf, data, size) == 0);
+    }
+
+    flb_free(out_buf);
+    flb_free(data);
+}
+
+void test_workers_dropped()
+{
+    int count;
+    int records;
+    int out_records;
+    size_t size;
+    size_t out_size;
+    size_t offsets[5];
+    char *data;
+    void *out_buf;
+    struct flb_config *config;
+
+    data = load_records(&size, &records);
+    TEST_CHECK(data != NULL);
+    if (!data) {
+        return;
+    }
+    main_thread = pthread_self();
+
+    /* the slices built by filter_do_workers() */
+    count = records / FLB_FILTER_WORKER_SLICE_MIN;
+    if (count > 4) {
+        count = 4;
+    }
+    TEST_CHECK(flb_mp_split(data, size, records, count, offsets) == 0);
+
+    /*
+     * The slice of the caller thread is not modified and the ones of the
+     * workers are dropped: only the first slice is left.
+     */
+    drop_all = FLB_FALSE;
+    config = config_create(3, "test_drop");
+    run_filters(config, data, size, records,
+                &out_buf, &out_size, &out_records);
+    config_destroy(config);
+
+    TEST_CHECK(out_records == records / count);
+    TEST_CHECK(out_size == offsets[1]);
+    if (out_size == offsets[1]) {
+        TEST_CHECK(memcmp(out_buf, data, out_size) == 0);
+    }
+    flb_free(out_buf);
+
+    /* every slice dropped */
+    drop_all = FLB_TRUE;
+    config = config_create(3, "test_drop");
+    run_filters(config, data, size, records,
+                &out_buf, &out_size, &out_records);
+    config_destroy(config);
+
+    TEST_CHECK(out_records == 0);
+    TEST_CHECK(out_size == 0);
+    flb_free(out_buf);
+
+    drop_all = FLB_FALSE;
+    flb_free(data);
+}
+
+static void pool_jobs_init(struct test_job *jobs, struct flb_filter_job **list,
+                           int count)
+{
+    int i;
+
+    jobs_done = 0;
+    jobs_max_queued = 0;
+    jobs_done_before_first = -1;
+
+    for (i = 0; i < count; i++) {
+        jobs[i].job.cb = cb_test_job;
+        jobs[i].id = i;
+        list[i] = &jobs[i].job;
+    }
+}
+
+void test_pool_backpressure()
+{
+    int i;
+    uint64_t wait;
+    int count;
+    struct test_job jobs[16];
+    struct flb_filter_job *list[16];
+    struct flb_config *config;
+    struct flb_filter_pool *pool;
+
+    config = flb_config_init();
+    TEST_CHECK(config != NULL);
+    flb_log_create(config, FLB_LOG_STDERR, FLB_LOG_INFO, NULL);
+    config->filter_workers = 1;
+    TEST_CHECK(flb_filter_pool_create(config) == 0);
+    pool = config->filter_pool;
+    jobs_pool = pool;
+
+    /* three times the queue size, the caller must wait for room */
+    count = 1 + (pool->queue_size * 3);
+    TEST_CHECK(count <= 16);
+    pool_jobs_init(jobs, list, count);
+
+    flb_filter_pool_run(pool, list, count);
+
+    /* every job is done once the batch returns */
+    TEST_CHECK(jobs_done == count);
+    TEST_CHECK(jobs_max_queued <= pool->queue_size);
+
+    /*
+     * The caller job only runs once everything else was queued: at most a
+     * full queue and the job of the worker are left.
+     */
+    TEST_CHECK_(jobs_done_before_first >= count - 2 - pool->queue_size,
+                "%i jobs done before the caller one", jobs_done_before_first);
+
+    /* a single worker takes the jobs in the queue order */
+    for (i = 0; i < count - 1; i++) {
+        if (jobs_order[i] == 0) {
+            continue;
+        }
+        if (i > 0 && jobs_order[i - 1] != 0) {
+            TEST_CHECK(jobs_order[i] == jobs_order[i - 1] + 1);
+        }
+    }
+
+    /* the queued jobs had to wait for the worker, the caller one did not */
+    wait = 0;
+    for (i = 1; i < count; i++) {
+        wait += jobs[i].job.wait;
+    }
+    TEST_CHECK(wait > 0);
+    TEST_CHECK(jobs[0].job.wait == 0);
+
+    flb_filter_pool_destroy(config);
+    TEST_CHECK(config->filter_pool == NULL);
+    flb_config_exit(config);
+}
+
+static void *pool_run_thread(void *data)
+{
+    struct flb_filter_job **list = data;
+
+    flb_filter_pool_run(jobs_pool, list, 1 + (jobs_pool->queue_size * 3));
+    return NULL;
+}
+
+void test_pool_destroy_queued()
+{
+    int count;
+    int callers;
+    pthread_t tid;
+    struct test_job jobs[16];
+    struct flb_filter_job *list[16];
+    struct flb_config *config;
+    struct flb_filter_pool *pool;
+
+    config = flb_config_init();
+    TEST_CHECK(config != NULL);
+    flb_log_create(config, FLB_LOG_STDERR, FLB_LOG_INFO, NULL);
+    config->filter_workers = 1;
+    TEST_CHECK(flb_filter_pool_create(config) == 0);
+    pool = config->filter_pool;
+    jobs_pool = pool;
+
+    count = 1 + (pool->queue_size * 3);
+    pool_jobs_init(jobs, list, count);
+
+    TEST_CHECK(pthread_create(&tid, NULL, pool_run_thread, list) == 0);
+
+    /* wait for the batch to be queued */
+    do {
+        flb_time_msleep(1);
+        pthread_mutex_lock(&pool->mutex);
+        callers = pool->callers;
+        pthread_mutex_unlock(&pool->mutex);
+    } while (callers == 0);
+
+    /* the pool is only released once the whole batch is done */
+    flb_filter_pool_destroy(config);
+    TEST_CHECK(config->filter_pool == NULL);
+    TEST_CHECK(jobs_done == count);
+
+    pthread_join(tid, NULL);
+    flb_config_exit(config);
+}
+
+TEST_LIST = {
+    {"split"                  , test_split},
+    {"workers"                , test_workers},
+    {"workers_not_threadsafe" , test_workers_not_threadsafe},
+    {"split_remainder"        , test_split_remainder},
+    {"workers_order"          , test_workers_order},
+    {"workers_dropped"        , test_workers_dropped},
+    {"pool_backpressure"      , test_pool_backpressure},
+    {"pool_destroy_queued"    , test_pool_destroy_queued},
+    { 0 }
+};
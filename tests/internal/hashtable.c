@@ -2,8 +2,13 @@
 
 #include <fluent-bit/flb_info.h>
 #include <fluent-bit/flb_macros.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_str.h>
+#include <fluent-bit/flb_time.h>
 #include <fluent-bit/flb_hash_table.h>
 
+#include <unistd.h>
+
 #include "flb_tests_internal.h"
 
 struct map {
@@ -399,6 +404,462 @@ void test_hash_exists()
     flb_hash_table_destroy(ht);
 }
 
+void test_open_single()
+{
+    int ret;
+    const char *out_buf;
+    size_t out_size;
+    struct flb_hash_table *ht;
+
+    ht  = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_NONE, 0, -1);
+    TEST_CHECK(ht == NULL);
+
+    ht = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_NONE, 1, -1);
+    TEST_CHECK(ht != NULL);
+
+    ret = ht_add(ht, "key", "value");
+    TEST_CHECK(ret != -1);
+
+    ret = flb_hash_table_get(ht, "key", 3, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret >= 0);
+    TEST_CHECK(out_size == 5);
+
+    ret = flb_hash_table_get(ht, "NOT", 3, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret == -1);
+
+    /* prefix of an existing key */
+    ret = flb_hash_table_get(ht, "ke", 2, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret == -1);
+
+    flb_hash_table_destroy(ht);
+}
+
+/* the table starts with a few slots and must grow */
+void test_open_grow()
+{
+    int i;
+    int ret;
+    int total;
+    char *out_buf;
+    size_t out_size;
+    struct map *m;
+    struct flb_hash_table *ht;
+
+    ht = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_NONE, 8, -1);
+    TEST_CHECK(ht != NULL);
+
+    total = sizeof(entries) / sizeof(struct map);
+    for (i = 0; i < total; i++) {
+        m = &entries[i];
+        ht_add(ht, m->key, m->val);
+    }
+
+    /* 3 overrides */
+    TEST_CHECK(ht->total_count == total - 3);
+    TEST_CHECK(ht->capacity >= total - 3);
+
+    for (i = 0; i < total; i++) {
+        m = &entries[i];
+        ret = flb_hash_table_get(ht, m->key, strlen(m->key),
+                                 (void *) &out_buf, &out_size);
+        TEST_CHECK(ret >= 0);
+
+        /* overridden keys */
+        if (i >= 67 && i <= 69) {
+            continue;
+        }
+        TEST_CHECK(strcmp(out_buf, m->val) == 0);
+    }
+
+    flb_hash_table_destroy(ht);
+}
+
+void test_open_long_keys()
+{
+    int i;
+    int ret;
+    char key[128];
+    char *out_buf;
+    size_t out_size;
+    struct flb_hash_table *ht;
+
+    ht = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_NONE, 16, 0);
+    TEST_CHECK(ht != NULL);
+
+    /* keys around the inline limit */
+    for (i = 1; i < sizeof(key); i++) {
+        memset(key, 'a' + (i % 26), i);
+        key[i] = '\0';
+        ret = flb_hash_table_add(ht, key, i, key, i);
+        TEST_CHECK(ret >= 0);
+    }
+
+    for (i = 1; i < sizeof(key); i++) {
+        memset(key, 'a' + (i % 26), i);
+        key[i] = '\0';
+        ret = flb_hash_table_get(ht, key, i, (void *) &out_buf, &out_size);
+        TEST_CHECK(ret >= 0);
+        TEST_CHECK(out_size == i && strcmp(out_buf, key) == 0);
+
+        ret = flb_hash_table_get_by_id(ht, ret, key,
+                                       (const char **) &out_buf, &out_size);
+        TEST_CHECK(ret == 0);
+        TEST_CHECK(out_size == i && strcmp(out_buf, key) == 0);
+    }
+
+    for (i = 1; i < sizeof(key); i += 2) {
+        memset(key, 'a' + (i % 26), i);
+        key[i] = '\0';
+        ret = flb_hash_table_del(ht, key);
+        TEST_CHECK(ret == 0);
+    }
+    TEST_CHECK(ht->total_count == (sizeof(key) - 1) / 2);
+
+    flb_hash_table_destroy(ht);
+}
+
+void test_open_delete_all()
+{
+    int i;
+    int ret;
+    int total;
+    int not_found = 0;
+    struct map *m;
+    struct flb_hash_table *ht;
+
+    ht = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_NONE, 8, -1);
+    TEST_CHECK(ht != NULL);
+
+    total = sizeof(entries) / sizeof(struct map);
+
+    /* fill and empty the table a few times so deleted slots are reused */
+    for (ret = 0; ret < 4; ret++) {
+        for (i = 0; i < total; i++) {
+            m = &entries[i];
+            ht_add(ht, m->key, m->val);
+        }
+
+        for (i = total - 1; i >= 0; i--) {
+            m = &entries[i];
+            if (flb_hash_table_del(ht, m->key) == -1) {
+                not_found++;
+            }
+        }
+        TEST_CHECK(ht->total_count == 0);
+    }
+
+    TEST_CHECK(not_found == 3 * 4);
+    TEST_CHECK(ht->oldest == -1 && ht->newest == -1);
+    flb_hash_table_destroy(ht);
+}
+
+void test_open_eviction()
+{
+    int ret;
+    const char *out_buf;
+    size_t out_size;
+    struct flb_hash_table *ht;
+
+    /* random */
+    ht = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_RANDOM, 8, 1);
+    TEST_CHECK(ht != NULL);
+
+    ht_add(ht, "key1", "value1");
+    ht_add(ht, "key2", "value2");
+
+    ret = flb_hash_table_get(ht, "key1", 4, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret == -1);
+    ret = flb_hash_table_get(ht, "key2", 4, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret >= 0);
+    flb_hash_table_destroy(ht);
+
+    /* less used */
+    ht = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_LESS_USED, 8, 2);
+    TEST_CHECK(ht != NULL);
+
+    ht_add(ht, "key1", "value1");
+    ht_add(ht, "key2", "value2");
+    flb_hash_table_get(ht, "key2", 4, (void *) &out_buf, &out_size);
+    ht_add(ht, "key3", "value3");
+
+    ret = flb_hash_table_get(ht, "key1", 4, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret == -1);
+    ret = flb_hash_table_get(ht, "key2", 4, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret >= 0);
+    ret = flb_hash_table_get(ht, "key3", 4, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret >= 0);
+    flb_hash_table_destroy(ht);
+
+    /* older */
+    ht = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_OLDER, 8, 2);
+    TEST_CHECK(ht != NULL);
+
+    ht_add(ht, "key2", "value2");
+    ht_add(ht, "key1", "value1");
+    flb_hash_table_get(ht, "key2", 4, (void *) &out_buf, &out_size);
+    ht_add(ht, "key3", "value3");
+
+    ret = flb_hash_table_get(ht, "key2", 4, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret == -1);
+    ret = flb_hash_table_get(ht, "key1", 4, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret >= 0);
+    ret = flb_hash_table_get(ht, "key3", 4, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret >= 0);
+    TEST_CHECK(ht->total_count == 2);
+    flb_hash_table_destroy(ht);
+}
+
+void test_open_ttl()
+{
+    int ret;
+    const char *out_buf;
+    size_t out_size;
+    struct flb_hash_table *ht;
+
+    ht = flb_hash_table_create_open_with_ttl(1, FLB_HASH_TABLE_EVICT_OLDER, 8, 8);
+    TEST_CHECK(ht != NULL);
+
+    ht_add(ht, "key1", "value1");
+    sleep(2);
+
+    ret = flb_hash_table_get(ht, "key1", 4, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret == -1);
+    TEST_CHECK(ht->total_count == 0);
+
+    flb_hash_table_destroy(ht);
+}
+
+void test_open_pointer()
+{
+    int i;
+    int ret;
+    int len;
+    const char *out_buf;
+    size_t out_size;
+    uint64_t hash;
+    struct map *m;
+    struct flb_hash_table *ht;
+
+    char *val1 = "val1";
+    char *val2 = "val2";
+
+    ht = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_NONE, 512, 0);
+    TEST_CHECK(ht != NULL);
+
+    ret = flb_hash_table_add(ht, "key1", 4, (void *) val1, 0);
+    TEST_CHECK(ret >= 0);
+
+    ret = flb_hash_table_add(ht, "key2", 4, (void *) val2, 0);
+    TEST_CHECK(ret >= 0);
+
+    ret = flb_hash_table_get(ht, "key2", 4, (void *) &out_buf, &out_size);
+    TEST_CHECK(ret >= 0);
+    TEST_CHECK((void *) out_buf == (void *) val2);
+
+    out_buf = flb_hash_table_get_ptr(ht, "key2", 4);
+    TEST_CHECK((void *) out_buf == (void *) val2);
+
+    ret = flb_hash_table_del_ptr(ht, "key2", 4, (void *) val1);
+    TEST_CHECK(ret == -1);
+
+    ret = flb_hash_table_del_ptr(ht, "key2", 4, (void *) out_buf);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(ht->total_count == 1);
+
+    /* lookups by hash */
+    for (i = 0; i < sizeof(entries) / sizeof(struct map); i++) {
+        m = &entries[i];
+        ht_add(ht, m->key, m->val);
+
+        len = strlen(m->key);
+        hash = cfl_hash_64bits(m->key, len);
+        TEST_CHECK(flb_hash_table_exists(ht, hash) == FLB_TRUE);
+    }
+
+    for (i = 0; i < sizeof(entries) / sizeof(struct map); i++) {
+        m = &entries[i];
+        len = strlen(m->key);
+        hash = cfl_hash_64bits(m->key, len);
+
+        flb_hash_table_del(ht, m->key);
+        TEST_CHECK(flb_hash_table_exists(ht, hash) == FLB_FALSE);
+    }
+
+    flb_hash_table_destroy(ht);
+}
+
+/* random operations, the open table must match the chained one */
+void test_open_consistency()
+{
+    int i;
+    int op;
+    int len;
+    int ret_a;
+    int ret_b;
+    int errors = 0;
+    char key[32];
+    char *buf_a;
+    char *buf_b;
+    size_t size_a;
+    size_t size_b;
+    struct flb_hash_table *chained;
+    struct flb_hash_table *open;
+
+    chained = flb_hash_table_create(FLB_HASH_TABLE_EVICT_NONE, 64, 0);
+    open = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_NONE, 8, 0);
+    TEST_CHECK(chained != NULL && open != NULL);
+
+    srand(1234);
+    for (i = 0; i < 100000; i++) {
+        op = rand() % 3;
+        len = snprintf(key, sizeof(key) - 1, "key_%i", rand() % 2000);
+
+        if (op == 0) {
+            ret_a = flb_hash_table_add(chained, key, len, key, len);
+            ret_b = flb_hash_table_add(open, key, len, key, len);
+            if ((ret_a >= 0) != (ret_b >= 0)) {
+                errors++;
+            }
+        }
+        else if (op == 1) {
+            ret_a = flb_hash_table_get(chained, key, len, (void *) &buf_a, &size_a);
+            ret_b = flb_hash_table_get(open, key, len, (void *) &buf_b, &size_b);
+            if ((ret_a >= 0) != (ret_b >= 0) ||
+                (ret_a >= 0 && strcmp(buf_a, buf_b) != 0)) {
+                errors++;
+            }
+        }
+        else {
+            ret_a = flb_hash_table_del(chained, key);
+            ret_b = flb_hash_table_del(open, key);
+            if (ret_a != ret_b) {
+                errors++;
+            }
+        }
+    }
+
+    TEST_CHECK(errors == 0);
+    TEST_CHECK(chained->total_count == open->total_count);
+
+    flb_hash_table_destroy(chained);
+    flb_hash_table_destroy(open);
+}
+
+static double bench_elapsed(struct flb_time *start)
+{
+    struct flb_time end;
+    struct flb_time diff;
+
+    flb_time_get(&end);
+    flb_time_diff(&end, start, &diff);
+
+    return flb_time_to_double(&diff);
+}
+
+static void bench_table(int type, int entries_count, char **keys, int *keys_len)
+{
+    int i;
+    int k;
+    double t_insert;
+    double t_lookup;
+    double t_evict;
+    void *out_buf;
+    size_t out_size;
+    struct flb_time start;
+    struct flb_hash_table *ht;
+
+    /* a table with one bucket per entry, as the callers use it */
+    if (type == FLB_HASH_TABLE_OPEN) {
+        ht = flb_hash_table_create_open(FLB_HASH_TABLE_EVICT_OLDER,
+                                        entries_count, entries_count);
+    }
+    else {
+        ht = flb_hash_table_create(FLB_HASH_TABLE_EVICT_OLDER,
+                                   entries_count, entries_count);
+    }
+    TEST_CHECK(ht != NULL);
+    if (!ht) {
+        return;
+    }
+
+    flb_time_get(&start);
+    for (i = 0; i < entries_count; i++) {
+        flb_hash_table_add(ht, keys[i], keys_len[i], keys[i], 0);
+    }
+    t_insert = bench_elapsed(&start);
+
+    flb_time_get(&start);
+    for (i = 0; i < entries_count; i++) {
+        k = ((uint64_t) i * 7919) % entries_count;
+        flb_hash_table_get(ht, keys[k], keys_len[k], &out_buf, &out_size);
+    }
+    t_lookup = bench_elapsed(&start);
+
+    /* the table is full, every new key evicts the older one */
+    flb_time_get(&start);
+    for (i = 0; i < entries_count; i++) {
+        flb_hash_table_add(ht, keys[entries_count + i],
+                           keys_len[entries_count + i], keys[i], 0);
+    }
+    t_evict = bench_elapsed(&start);
+
+    TEST_CHECK(ht->total_count == entries_count);
+
+    printf("  %-8s entries=%-8i insert=%7.2f lookup=%7.2f evict=%7.2f Mops/s\n",
+           type == FLB_HASH_TABLE_OPEN ? "open" : "chained",
+           entries_count,
+           entries_count / t_insert / 1e6,
+           entries_count / t_lookup / 1e6,
+           entries_count / t_evict / 1e6);
+
+    flb_hash_table_destroy(ht);
+}
+
+/*
+ * Throughput of both layouts. Only the smallest size runs by default, set
+ * FLB_HASH_TABLE_BENCH=1 to run it with up to 1M entries.
+ */
+void test_benchmark()
+{
+    int i;
+    int max;
+    int sizes[] = {10000, 100000, 1000000};
+    int *keys_len;
+    char **keys;
+    char tmp[64];
+
+    max = 1;
+    if (getenv("FLB_HASH_TABLE_BENCH")) {
+        max = sizeof(sizes) / sizeof(int);
+    }
+
+    /* unique keys for the inserts and the evictions */
+    keys = flb_malloc(sizeof(char *) * sizes[max - 1] * 2);
+    keys_len = flb_malloc(sizeof(int) * sizes[max - 1] * 2);
+    TEST_CHECK(keys != NULL && keys_len != NULL);
+    if (!keys || !keys_len) {
+        return;
+    }
+
+    for (i = 0; i < sizes[max - 1] * 2; i++) {
+        keys_len[i] = snprintf(tmp, sizeof(tmp),
+                               "default.app-%i.container_%08x", i, i * 2654435761u);
+        keys[i] = flb_strndup(tmp, keys_len[i]);
+    }
+
+    printf("\n");
+    for (i = 0; i < max; i++) {
+        bench_table(FLB_HASH_TABLE_CHAINED, sizes[i], keys, keys_len);
+        bench_table(FLB_HASH_TABLE_OPEN, sizes[i], keys, keys_len);
+    }
+
+    for (i = 0; i < sizes[max - 1] * 2; i++) {
+        flb_free(keys[i]);
+    }
+    flb_free(keys);
+    flb_free(keys_len);
+}
+
 TEST_LIST = {
     { "zero_size", test_create_zero },
     { "single",    test_single },
@@ -411,5 +872,14 @@ TEST_LIST = {
     { "older_eviction", test_older_eviction },
     { "pointer", test_pointer },
     { "hash_exists", test_hash_exists},
+    { "open_single", test_open_single },
+    { "open_grow", test_open_grow },
+    { "open_long_keys", test_open_long_keys },
+    { "open_delete_all", test_open_delete_all },
+    { "open_eviction", test_open_eviction },
+    { "open_ttl", test_open_ttl },
+    { "open_pointer", test_open_pointer },
+    { "open_consistency", test_open_consistency },
+    { "benchmark", test_benchmark },
     { 0 }
 };
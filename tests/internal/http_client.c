@@ -5,9 +5,23 @@
 #include <fluent-bit/flb_error.h>
 #include <fluent-bit/flb_socket.h>
 #include <fluent-bit/flb_http_client.h>
+#include <fluent-bit/flb_http_client_http2.h>
+#include <fluent-bit/flb_upstream.h>
+#include <fluent-bit/flb_connection.h>
+#include <fluent-bit/flb_network.h>
+#include <fluent-bit/flb_coro.h>
+#include <fluent-bit/flb_event_loop.h>
+#include <fluent-bit/flb_engine_macros.h>
+#include <fluent-bit/flb_lib.h>
+
+#include <nghttp2/nghttp2.h>
+#include <pthread.h>
 
 #include "flb_tests_internal.h"
 
+#define H2_TEST_STREAMS     4
+#define H2_TEST_BODY_SIZE   (100 * 1024)
+
 struct test_ctx {
     struct flb_upstream   *u;
     struct flb_connection *u_conn;
@@ -466,6 +480,414 @@ void test_http_add_proxy_auth_header()
     test_ctx_destroy(ctx);
 }
 
+/* HTTP/2 test server: answers the requests once all of them arrived */
+struct h2_test_stream {
+    int32_t id;
+    size_t bytes;
+    char path[64];
+    char response[128];
+    size_t response_len;
+    size_t response_offset;
+};
+
+struct h2_test_server {
+    int fd;
+    int count;
+    int completed;
+    nghttp2_session *session;
+    struct h2_test_stream streams[H2_TEST_STREAMS];
+};
+
+struct h2_test_request {
+    int ret;
+    int done;
+    int status;
+    char uri[32];
+    char payload[128];
+    char *body;
+    struct flb_coro *coro;
+    struct flb_connection *conn;
+};
+
+static struct h2_test_stream *h2_test_stream_get(struct h2_test_server *server,
+                                                 int32_t id)
+{
+    int i;
+
+    for (i = 0; i < server->count; i++) {
+        if (server->streams[i].id == id) {
+            return &server->streams[i];
+        }
+    }
+    return NULL;
+}
+
+static ssize_t h2_server_send(nghttp2_session *session, const uint8_t *data,
+                              size_t length, int flags, void *user_data)
+{
+    ssize_t ret;
+    struct h2_test_server *server = user_data;
+
+    ret = send(server->fd, data, length, 0);
+    if (ret <= 0) {
+        return NGHTTP2_ERR_CALLBACK_FAILURE;
+    }
+    return ret;
+}
+
+static int h2_server_begin_headers(nghttp2_session *session,
+                                   const nghttp2_frame *frame,
+                                   void *user_data)
+{
+    struct h2_test_server *server = user_data;
+
+    if (frame->hd.type == NGHTTP2_HEADERS &&
+        server->count < H2_TEST_STREAMS) {
+        server->streams[server->count++].id = frame->hd.stream_id;
+    }
+    return 0;
+}
+
+static int h2_server_header(nghttp2_session *session,
+                            const nghttp2_frame *frame,
+                            const uint8_t *name, size_t namelen,
+                            const uint8_t *value, size_t valuelen,
+                            uint8_t flags, void *user_data)
+{
+    struct h2_test_stream *stream;
+
+    stream = h2_test_stream_get(user_data, frame->hd.stream_id);
+    if (stream && namelen == 5 && memcmp(name, ":path", 5) == 0 &&
+        valuelen < sizeof(stream->path)) {
+        memcpy(stream->path, value, valuelen);
+        stream->path[valuelen] = '\0';
+    }
+    return 0;
+}
+
+static int h2_server_data(nghttp2_session *session, uint8_t flags,
+                          int32_t stream_id, const uint8_t *data,
+                          size_t len, void *user_data)
+{
+    struct h2_test_stream *stream;
+
+    stream = h2_test_stream_get(user_data, stream_id);
+    if (stream) {
+        stream->bytes += len;
+    }
+    return 0;
+}
+
+static ssize_t h2_server_body_read(nghttp2_session *session, int32_t stream_id,
+                                   uint8_t *buf, size_t length,
+                                   uint32_t *data_flags,
+                                   nghttp2_data_source *source,
+                                   void *user_data)
+{
+    size_t len;
+    struct h2_test_stream *stream = source->ptr;
+
+    len = stream->response_len - stream->response_offset;
+    if (len > length) {
+        len = length;
+    }
+    memcpy(buf, stream->response + stream->response_offset, len);
+    stream->response_offset += len;
+
+    if (stream->response_offset == stream->response_len) {
+        *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    return len;
+}
+
+static int h2_server_frame_recv(nghttp2_session *session,
+                                const nghttp2_frame *frame, void *user_data)
+{
+    int i;
+    int len;
+    char response[128];
+    nghttp2_nv nv;
+    nghttp2_data_provider provider;
+    struct h2_test_stream *stream;
+    struct h2_test_server *server = user_data;
+
+    if ((frame->hd.type != NGHTTP2_HEADERS &&
+         frame->hd.type != NGHTTP2_DATA) ||
+        (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) == 0) {
+        return 0;
+    }
+
+    server->completed++;
+    if (server->completed < H2_TEST_STREAMS) {
+        return 0;
+    }
+
+    /* every request is in flight at the same time over the connection */
+    nv.name = (uint8_t *) ":status";
+    nv.namelen = 7;
+    nv.value = (uint8_t *) "200";
+    nv.valuelen = 3;
+    nv.flags = NGHTTP2_NV_FLAG_NONE;
+
+    for (i = 0; i < server->count; i++) {
+        stream = &server->streams[i];
+
+        /* format in a separate buffer, path and response share the stream */
+        len = snprintf(response, sizeof(response),
+                       "%s:%zu", stream->path, stream->bytes);
+        if (len < 0) {
+            len = 0;
+        }
+        else if (len >= sizeof(response)) {
+            len = sizeof(response) - 1;
+        }
+        memcpy(stream->response, response, len);
+        stream->response_len = len;
+
+        provider.source.ptr = stream;
+        provider.read_callback = h2_server_body_read;
+        nghttp2_submit_response(session, stream->id, &nv, 1, &provider);
+    }
+    return 0;
+}
+
+static void *h2_server_worker(void *data)
+{
+    ssize_t bytes;
+    uint8_t buf[16384];
+    nghttp2_session_callbacks *callbacks;
+    struct h2_test_server *server = data;
+
+    nghttp2_session_callbacks_new(&callbacks);
+    nghttp2_session_callbacks_set_send_callback(callbacks, h2_server_send);
+    nghttp2_session_callbacks_set_on_begin_headers_callback(
+                                        callbacks, h2_server_begin_headers);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks,
+                                                     h2_server_header);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks,
+                                                              h2_server_data);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks,
+                                                         h2_server_frame_recv);
+    nghttp2_session_server_new(&server->session, callbacks, server);
+    nghttp2_session_callbacks_del(callbacks);
+
+    nghttp2_submit_settings(server->session, NGHTTP2_FLAG_NONE, NULL, 0);
+
+    while (nghttp2_session_send(server->session) == 0) {
+        bytes = recv(server->fd, buf, sizeof(buf), 0);
+        if (bytes <= 0) {
+            break;
+        }
+        if (nghttp2_session_mem_recv(server->session, buf, bytes) < 0) {
+            break;
+        }
+    }
+
+    nghttp2_session_del(server->session);
+    return NULL;
+}
+
+static void h2_request_entry()
+{
+    size_t b_sent;
+    struct flb_coro *coro = flb_coro_get();
+    struct h2_test_request *req = coro->data;
+    struct flb_http_client *c;
+
+    c = flb_http_client(req->conn, FLB_HTTP_POST, req->uri,
+                        req->body, H2_TEST_BODY_SIZE,
+                        "127.0.0.1", 80, NULL, 0);
+    if (c) {
+        req->ret = flb_http_do(c, &b_sent);
+        req->status = c->resp.status;
+        if (req->ret == 0 && c->resp.payload_size < sizeof(req->payload)) {
+            memcpy(req->payload, c->resp.payload, c->resp.payload_size);
+        }
+        flb_http_client_destroy(c);
+    }
+    req->done = FLB_TRUE;
+
+    flb_coro_yield(coro, FLB_TRUE);
+}
+
+static int h2_requests_done(struct h2_test_request *reqs)
+{
+    int i;
+
+    for (i = 0; i < H2_TEST_STREAMS; i++) {
+        if (!reqs[i].done) {
+            return FLB_FALSE;
+        }
+    }
+    return FLB_TRUE;
+}
+
+void test_http2_upstream_share()
+{
+    int ret;
+    int port;
+    flb_sockfd_t fd;
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    struct flb_config *config;
+    struct flb_upstream *u;
+    struct flb_connection *conn[3];
+
+    flb_init_env();
+
+    config = flb_config_init();
+    TEST_CHECK(config != NULL);
+
+    fd = flb_net_server("0", "127.0.0.1", FLB_FALSE);
+    TEST_CHECK(fd != -1);
+    ret = getsockname(fd, (struct sockaddr *) &addr, &len);
+    TEST_CHECK(ret == 0);
+    port = ntohs(addr.sin_port);
+
+    u = flb_upstream_create(config, "127.0.0.1", port, FLB_IO_TCP, NULL);
+    TEST_CHECK(u != NULL);
+    flb_stream_disable_async_mode(&u->base);
+    u->base.net.keepalive = FLB_FALSE;
+    u->base.net.http2 = FLB_TRUE;
+    u->base.net.http2_max_streams = 2;
+
+    /* prior knowledge: the connection is shared up to the streams limit */
+    conn[0] = flb_upstream_conn_get(u);
+    conn[1] = flb_upstream_conn_get(u);
+    conn[2] = flb_upstream_conn_get(u);
+    if (TEST_CHECK(conn[0] != NULL && conn[1] != NULL && conn[2] != NULL)) {
+        TEST_CHECK(conn[0]->http2_session != NULL);
+        TEST_CHECK(conn[0] == conn[1]);
+        TEST_CHECK(conn[0]->http2_session->users == 2);
+        TEST_CHECK(conn[2] != conn[0]);
+
+        flb_upstream_conn_release(conn[2]);
+        flb_upstream_conn_release(conn[1]);
+        TEST_CHECK(conn[0]->http2_session->users == 1);
+        flb_upstream_conn_release(conn[0]);
+    }
+
+    flb_upstream_destroy(u);
+    flb_socket_close(fd);
+    flb_config_exit(config);
+}
+
+void test_http2_multiplex()
+{
+    int i;
+    int ret;
+    int sv[2];
+    size_t size;
+    time_t deadline;
+    pthread_t tid;
+    char *body;
+    struct mk_event *event;
+    struct mk_event_loop *evl;
+    struct flb_bucket_queue *bktq;
+    struct flb_config *config;
+    struct flb_upstream *u;
+    struct flb_connection *conn;
+    struct flb_connection *ev_conn;
+    struct h2_test_server server = {0};
+    struct h2_test_request reqs[H2_TEST_STREAMS] = {0};
+    char expected[128];
+
+    flb_init_env();
+
+    config = flb_config_init();
+    TEST_CHECK(config != NULL);
+
+    evl = mk_event_loop_create(256);
+    TEST_CHECK(evl != NULL);
+    bktq = flb_bucket_queue_create(FLB_ENGINE_PRIORITY_COUNT);
+    TEST_CHECK(bktq != NULL);
+
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    TEST_CHECK(ret == 0);
+    flb_net_socket_nonblocking(sv[0]);
+
+    u = flb_upstream_create(config, "127.0.0.1", 80, FLB_IO_TCP, NULL);
+    TEST_CHECK(u != NULL);
+    u->base.net.http2 = FLB_TRUE;
+
+    conn = flb_connection_create(sv[0], FLB_UPSTREAM_CONNECTION, u, evl, NULL);
+    TEST_CHECK(conn != NULL);
+    ret = flb_http2_client_session_create(conn);
+    TEST_CHECK(ret == 0 && conn->http2_session != NULL);
+
+    server.fd = sv[1];
+    ret = pthread_create(&tid, NULL, h2_server_worker, &server);
+    TEST_CHECK(ret == 0);
+
+    /* request bodies larger than the initial flow control windows */
+    body = flb_malloc(H2_TEST_BODY_SIZE);
+    TEST_CHECK(body != NULL);
+    memset(body, 'x', H2_TEST_BODY_SIZE);
+
+    for (i = 0; i < H2_TEST_STREAMS; i++) {
+        reqs[i].conn = conn;
+        reqs[i].body = body;
+        snprintf(reqs[i].uri, sizeof(reqs[i].uri), "/req/%i", i);
+
+        reqs[i].coro = flb_coro_create(&reqs[i]);
+        TEST_CHECK(reqs[i].coro != NULL);
+        reqs[i].coro->caller = co_active();
+        reqs[i].coro->callee = co_create(config->coro_stack_size,
+                                         h2_request_entry, &size);
+        flb_coro_resume(reqs[i].coro);
+    }
+
+    deadline = time(NULL) + 10;
+    while (!h2_requests_done(reqs) && time(NULL) < deadline) {
+        mk_event_wait_2(evl, 1000);
+        flb_event_priority_live_foreach(event, bktq, evl,
+                                        FLB_ENGINE_LOOP_MAX_ITER) {
+            if (event->type == FLB_ENGINE_EV_CUSTOM) {
+                event->handler(event);
+            }
+            else if (event->type == FLB_ENGINE_EV_THREAD) {
+                ev_conn = (struct flb_connection *) event;
+                if (ev_conn->coroutine) {
+                    flb_coro_resume(ev_conn->coroutine);
+                }
+            }
+        }
+    }
+
+    if (!h2_requests_done(reqs)) {
+        /* wake up the waiters with a connection error */
+        shutdown(sv[0], SHUT_RDWR);
+    }
+    TEST_CHECK(h2_requests_done(reqs));
+
+    for (i = 0; i < H2_TEST_STREAMS; i++) {
+        snprintf(expected, sizeof(expected), "/req/%i:%i",
+                 i, H2_TEST_BODY_SIZE);
+        TEST_CHECK(reqs[i].ret == 0);
+        TEST_CHECK(reqs[i].status == 200);
+        TEST_CHECK(strcmp(reqs[i].payload, expected) == 0);
+        TEST_MSG("payload: got=%s expected=%s", reqs[i].payload, expected);
+    }
+
+    if (MK_EVENT_IS_REGISTERED((&conn->event))) {
+        mk_event_del(evl, &conn->event);
+    }
+    flb_http2_client_session_destroy(conn->http2_session);
+    flb_socket_close(sv[0]);
+    pthread_join(tid, NULL);
+    flb_socket_close(sv[1]);
+
+    for (i = 0; i < H2_TEST_STREAMS; i++) {
+        flb_coro_destroy(reqs[i].coro);
+    }
+    flb_free(body);
+    flb_connection_destroy(conn);
+    flb_upstream_destroy(u);
+    flb_bucket_queue_destroy(bktq);
+    mk_event_loop_destroy(evl);
+    flb_config_exit(config);
+}
+
 TEST_LIST = {
     { "http_buffer_increase"  , test_http_buffer_increase},
     { "add_get_header"        , test_http_add_get_header},
@@ -474,5 +896,7 @@ TEST_LIST = {
     { "encoding_gzip"         , test_http_encoding_gzip},
     { "add_basic_auth_header" , test_http_add_basic_auth_header},
     { "add_proxy_auth_header" , test_http_add_proxy_auth_header},
+    { "http2_upstream_share"  , test_http2_upstream_share},
+    { "http2_multiplex"       , test_http2_multiplex},
     { 0 }
 };
@@ -511,7 +511,13 @@ void flb_test_input_chunk_fs_chunks_size_real()
  */
 void flb_test_input_chunk_correct_total_records(void)
 {
+    int ret;
     int records;
+    int meta_len;
+    char *meta_buf;
+    size_t stats_records;
+    uint64_t first_ts;
+    uint64_t last_ts;
     struct flb_input_instance *i_ins;
     struct flb_output_instance *o_ins;
     struct mk_list *tmp;
@@ -570,6 +576,114 @@ void flb_test_input_chunk_correct_total_records(void)
     mk_list_foreach_safe(head, tmp, &i_ins->chunks) {
         ic = mk_list_entry(head, struct flb_input_chunk, _head);
         TEST_CHECK_(ic->total_records > 0, "found input chunk with 0 total records");
+
+        /* the stats block is opt-in, default chunks keep the legacy header */
+        ret = cio_meta_read(ic->chunk, &meta_buf, &meta_len);
+        TEST_CHECK(ret == 0 && meta_len > 3 && meta_buf[3] == 0);
+        TEST_CHECK(flb_input_chunk_get_stats(ic, &stats_records,
+                                             &first_ts, &last_ts) == -1);
+    }
+
+    /* FORCE clean up test tasks*/
+    mk_list_foreach_safe(head, tmp, &i_ins->tasks) {
+        task = mk_list_entry(head, struct flb_task, _head);
+        flb_info("[task] cleanup test task");
+        flb_task_destroy(task, FLB_TRUE);
+    }
+
+    /* clean up test chunks */
+    mk_list_foreach_safe(head, tmp, &i_ins->chunks) {
+        ic = mk_list_entry(head, struct flb_input_chunk, _head);
+        flb_input_chunk_destroy(ic, FLB_TRUE);
+    }
+
+    cio_destroy(cio);
+    flb_router_exit(cfg);
+    flb_input_exit_all(cfg);
+    flb_output_exit(cfg);
+    flb_config_exit(cfg);
+}
+
+
+/* The record count and append times are persisted in the chunk metadata */
+void flb_test_input_chunk_meta_stats(void)
+{
+    int ret;
+    int records;
+    int tag_len;
+    size_t stats_records;
+    uint64_t first_ts;
+    uint64_t last_ts;
+    const char *tag_buf;
+    struct flb_input_instance *i_ins;
+    struct flb_output_instance *o_ins;
+    struct mk_list *tmp;
+    struct mk_list *head;
+    struct flb_input_chunk *ic;
+    struct flb_task *task;
+    struct flb_config *cfg;
+    struct cio_ctx *cio;
+    msgpack_sbuffer mp_sbuf;
+    char buf[4096];
+    struct mk_event_loop *evl;
+    struct cio_options opts = {0};
+
+    flb_init_env();
+    cfg = flb_config_init();
+    evl = mk_event_loop_create(256);
+
+    TEST_CHECK(evl != NULL);
+    cfg->evl = evl;
+    cfg->storage_meta_stats = FLB_TRUE;
+
+    flb_log_create(cfg, FLB_LOG_STDERR, FLB_LOG_DEBUG, NULL);
+
+    i_ins = flb_input_new(cfg, "dummy", NULL, FLB_TRUE);
+    i_ins->storage_type = CIO_STORE_FS;
+
+    cio_options_init(&opts);
+
+    opts.root_path = "/tmp/input-chunk-meta-stats";
+    opts.log_cb = log_cb;
+    opts.log_level = CIO_LOG_DEBUG;
+    opts.flags = CIO_OPEN;
+
+    cio = cio_create(&opts);
+    flb_storage_input_create(cio, i_ins);
+    flb_input_init_all(cfg);
+
+    o_ins = flb_output_new(cfg, "http", NULL, FLB_TRUE);
+    // not the right way to do this
+    o_ins->id = 1;
+    TEST_CHECK_(o_ins != NULL, "unable to instance output");
+    flb_output_set_property(o_ins, "match", "*");
+
+    TEST_CHECK_((flb_router_io_set(cfg) != -1), "unable to router");
+
+    /* append twice to the same chunk */
+    memset((void *)buf, 0x41, sizeof(buf));
+    msgpack_sbuffer_init(&mp_sbuf);
+    gen_buf(&mp_sbuf, buf, sizeof(buf));
+
+    records = flb_mp_count(buf, sizeof(buf));
+    flb_input_chunk_append_raw(i_ins, FLB_INPUT_LOGS, records, "dummy", 5, (void *)buf, sizeof(buf));
+    flb_input_chunk_append_raw(i_ins, FLB_INPUT_LOGS, records, "dummy", 5, (void *)buf, sizeof(buf));
+    msgpack_sbuffer_destroy(&mp_sbuf);
+
+    mk_list_foreach_safe(head, tmp, &i_ins->chunks) {
+        ic = mk_list_entry(head, struct flb_input_chunk, _head);
+
+        ret = flb_input_chunk_get_stats(ic, &stats_records, &first_ts, &last_ts);
+        TEST_CHECK_(ret == 0, "chunk metadata has no stats block");
+        TEST_CHECK(stats_records == ic->total_records);
+        TEST_CHECK(first_ts > 0 && first_ts <= last_ts);
+        TEST_CHECK(first_ts == ic->first_append_ts);
+        TEST_CHECK(last_ts == ic->last_append_ts);
+
+        /* the tag must skip the stats block */
+        ret = flb_input_chunk_get_tag(ic, &tag_buf, &tag_len);
+        TEST_CHECK(ret == 0);
+        TEST_CHECK(tag_len == 5 && strncmp(tag_buf, "dummy", 5) == 0);
     }
 
     /* FORCE clean up test tasks*/
@@ -600,5 +714,6 @@ TEST_LIST = {
     {"input_chunk_dropping_chunks",    flb_test_input_chunk_dropping_chunks},
     {"input_chunk_fs_chunk_size_real", flb_test_input_chunk_fs_chunks_size_real},
     {"input_chunk_correct_total_records", flb_test_input_chunk_correct_total_records},
+    {"input_chunk_meta_stats",         flb_test_input_chunk_meta_stats},
     {NULL, NULL}
 };
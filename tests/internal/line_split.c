@@ -0,0 +1,123 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_line_split.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "flb_tests_internal.h"
+
+/* Compare the splitter output with a byte by byte lookup */
+static int check_buffer(const char *buf, size_t len, char sep_a, char sep_b)
+{
+    size_t i;
+    const char *p;
+    struct flb_line_split ls;
+
+    flb_line_split_init(&ls, buf, len, sep_a, sep_b);
+
+    for (i = 0; i < len; i++) {
+        if (buf[i] != sep_a && buf[i] != sep_b) {
+            continue;
+        }
+
+        p = flb_line_split_next(&ls);
+        if (p != buf + i) {
+            TEST_MSG("len=%zu expected separator at %zu, got %td",
+                     len, i, p ? p - buf : -1);
+            return -1;
+        }
+    }
+
+    if (flb_line_split_next(&ls) != NULL) {
+        TEST_MSG("len=%zu unexpected separator", len);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void test_lines()
+{
+    const char *p;
+    const char *buf = "first line\nsecond\n\nlast without break";
+    struct flb_line_split ls;
+
+    flb_line_split_init(&ls, buf, strlen(buf), '\n', '\n');
+
+    p = flb_line_split_next(&ls);
+    TEST_CHECK(p == buf + 10);
+    p = flb_line_split_next(&ls);
+    TEST_CHECK(p == buf + 17);
+    p = flb_line_split_next(&ls);
+    TEST_CHECK(p == buf + 18);
+    TEST_CHECK(flb_line_split_next(&ls) == NULL);
+    TEST_CHECK(flb_line_split_next(&ls) == NULL);
+
+    /* empty buffer */
+    flb_line_split_init(&ls, buf, 0, '\n', '\n');
+    TEST_CHECK(flb_line_split_next(&ls) == NULL);
+}
+
+static void test_two_separators()
+{
+    char buf[] = "a\nbb\0ccc\n\0d";
+    size_t len = sizeof(buf) - 1;
+
+    TEST_CHECK(check_buffer(buf, len, '\n', '\0') == 0);
+}
+
+static void test_random()
+{
+    int i;
+    int round;
+    size_t len;
+    char *buf;
+
+    buf = flb_malloc(4096);
+    TEST_CHECK(buf != NULL);
+    if (!buf) {
+        exit(EXIT_FAILURE);
+    }
+
+    srand(1);
+
+    /* every length around the vector sizes and past a full batch */
+    for (round = 0; round < 200; round++) {
+        len = rand() % 4096;
+        for (i = 0; i < len; i++) {
+            switch (rand() % 8) {
+            case 0:
+                buf[i] = '\n';
+                break;
+            case 1:
+                buf[i] = '\0';
+                break;
+            default:
+                buf[i] = 'a' + (rand() % 26);
+            }
+        }
+
+        if (!TEST_CHECK(check_buffer(buf, len, '\n', '\n') == 0)) {
+            break;
+        }
+        if (!TEST_CHECK(check_buffer(buf, len, '\n', '\0') == 0)) {
+            break;
+        }
+    }
+
+    /* only separators, several batches */
+    memset(buf, '\n', 1000);
+    TEST_CHECK(check_buffer(buf, 1000, '\n', '\n') == 0);
+
+    flb_free(buf);
+}
+
+TEST_LIST = {
+    { "lines",          test_lines},
+    { "two_separators", test_two_separators},
+    { "random",         test_random},
+    { 0 }
+};
@@ -0,0 +1,233 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_engine.h>
+#include <fluent-bit/flb_mpsc_queue.h>
+#include <fluent-bit/flb_event_loop.h>
+
+#include <pthread.h>
+
+#include "flb_tests_internal.h"
+
+#define PRODUCERS      4
+#define PRODUCER_ITEMS 20000
+
+struct producer {
+    int id;
+    struct flb_mpsc_queue *queue;
+    uintptr_t values[PRODUCER_ITEMS];
+};
+
+static void test_basic()
+{
+    int i;
+    int ret;
+    int values[8];
+    int *value;
+    struct flb_mpsc_queue *queue;
+
+    /* the size is rounded up to a power of two */
+    queue = flb_mpsc_queue_create(7);
+    TEST_CHECK(queue != NULL);
+    if (!queue) {
+        exit(EXIT_FAILURE);
+    }
+    TEST_CHECK(queue->size == 8);
+
+    TEST_CHECK(flb_mpsc_queue_pop(queue) == NULL);
+    TEST_CHECK(flb_mpsc_queue_depth(queue) == 0);
+
+    for (i = 0; i < 8; i++) {
+        values[i] = i;
+        ret = flb_mpsc_queue_push(queue, &values[i]);
+        TEST_CHECK(ret == 0);
+    }
+    TEST_CHECK(flb_mpsc_queue_depth(queue) == 8);
+
+    /* the queue is full */
+    ret = flb_mpsc_queue_push(queue, &values[0]);
+    TEST_CHECK(ret == -1);
+
+    /* release one slot, it can be used again */
+    value = flb_mpsc_queue_pop(queue);
+    TEST_CHECK(value == &values[0]);
+
+    ret = flb_mpsc_queue_push(queue, &values[0]);
+    TEST_CHECK(ret == 0);
+
+    /* entries are consumed in order */
+    for (i = 1; i < 8; i++) {
+        value = flb_mpsc_queue_pop(queue);
+        TEST_CHECK(value != NULL && *value == i);
+    }
+    value = flb_mpsc_queue_pop(queue);
+    TEST_CHECK(value == &values[0]);
+
+    TEST_CHECK(flb_mpsc_queue_pop(queue) == NULL);
+    TEST_CHECK(flb_mpsc_queue_depth(queue) == 0);
+
+    flb_mpsc_queue_destroy(queue);
+}
+
+static void test_signal()
+{
+    int i;
+    int ret;
+    int n_events;
+    int values[4];
+    struct mk_event_loop *evl;
+    struct flb_mpsc_queue *queue;
+
+#ifdef _WIN32
+    WSADATA wsa_data;
+    WSAStartup(0x0201, &wsa_data);
+#endif
+
+    evl = mk_event_loop_create(8);
+    TEST_CHECK(evl != NULL);
+    if (!evl) {
+        exit(EXIT_FAILURE);
+    }
+
+    queue = flb_mpsc_queue_create(16);
+    TEST_CHECK(queue != NULL);
+    if (!queue) {
+        exit(EXIT_FAILURE);
+    }
+
+    ret = flb_mpsc_queue_add_event_loop(queue, evl, FLB_ENGINE_EV_THREAD_INPUT);
+    TEST_CHECK(ret == 0);
+    if (ret) {
+        exit(EXIT_FAILURE);
+    }
+
+    n_events = mk_event_wait_2(evl, 0);
+    TEST_CHECK(n_events == 0);
+
+    /* many entries, a single pending wakeup */
+    for (i = 0; i < 4; i++) {
+        ret = flb_mpsc_queue_push(queue, &values[i]);
+        TEST_CHECK(ret == 0);
+        flb_mpsc_queue_signal(queue);
+    }
+    TEST_CHECK(queue->signal_pending == 1);
+
+    n_events = mk_event_wait_2(evl, 0);
+    TEST_CHECK(n_events == 1);
+
+    flb_mpsc_queue_signal_drain(queue);
+    TEST_CHECK(queue->signal_pending == 0);
+
+    for (i = 0; i < 4; i++) {
+        TEST_CHECK(flb_mpsc_queue_pop(queue) == &values[i]);
+    }
+
+    /* the wakeup was consumed */
+    n_events = mk_event_wait_2(evl, 0);
+    TEST_CHECK(n_events == 0);
+
+    /* a new entry raises a new wakeup */
+    ret = flb_mpsc_queue_push(queue, &values[0]);
+    TEST_CHECK(ret == 0);
+    flb_mpsc_queue_signal(queue);
+
+    n_events = mk_event_wait_2(evl, 0);
+    TEST_CHECK(n_events == 1);
+
+    flb_mpsc_queue_destroy(queue);
+    mk_event_loop_destroy(evl);
+}
+
+static void *producer_worker(void *data)
+{
+    int i;
+    struct producer *p = data;
+
+    for (i = 0; i < PRODUCER_ITEMS; i++) {
+        while (flb_mpsc_queue_push(p->queue, &p->values[i]) != 0) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void test_producers()
+{
+    int i;
+    int ret;
+    int id;
+    int total = 0;
+    int ordered = FLB_TRUE;
+    uintptr_t *value;
+    uintptr_t next[PRODUCERS];
+    pthread_t threads[PRODUCERS];
+    struct producer *producers;
+    struct flb_mpsc_queue *queue;
+
+    /* smaller than the number of entries so producers have to wait */
+    queue = flb_mpsc_queue_create(1024);
+    TEST_CHECK(queue != NULL);
+    if (!queue) {
+        exit(EXIT_FAILURE);
+    }
+
+    producers = flb_calloc(PRODUCERS, sizeof(struct producer));
+    TEST_CHECK(producers != NULL);
+    if (!producers) {
+        exit(EXIT_FAILURE);
+    }
+
+    for (id = 0; id < PRODUCERS; id++) {
+        producers[id].id = id;
+        producers[id].queue = queue;
+        for (i = 0; i < PRODUCER_ITEMS; i++) {
+            producers[id].values[i] = ((uintptr_t) id << 24) | i;
+        }
+        next[id] = 0;
+    }
+
+    for (id = 0; id < PRODUCERS; id++) {
+        ret = pthread_create(&threads[id], NULL, producer_worker, &producers[id]);
+        TEST_CHECK(ret == 0);
+    }
+
+    /* every producer entries must come out in the order they were pushed */
+    while (total < PRODUCERS * PRODUCER_ITEMS) {
+        value = flb_mpsc_queue_pop(queue);
+        if (!value) {
+            sched_yield();
+            continue;
+        }
+
+        id = *value >> 24;
+        if (id >= PRODUCERS || (*value & 0xffffff) != next[id]) {
+            ordered = FLB_FALSE;
+        }
+        else {
+            next[id]++;
+        }
+        total++;
+    }
+
+    for (id = 0; id < PRODUCERS; id++) {
+        pthread_join(threads[id], NULL);
+    }
+
+    TEST_CHECK(ordered == FLB_TRUE);
+    for (id = 0; id < PRODUCERS; id++) {
+        TEST_CHECK(next[id] == PRODUCER_ITEMS);
+    }
+    TEST_CHECK(flb_mpsc_queue_pop(queue) == NULL);
+
+    flb_free(producers);
+    flb_mpsc_queue_destroy(queue);
+}
+
+TEST_LIST = {
+    { "basic",     test_basic},
+    { "signal",    test_signal},
+    { "producers", test_producers},
+    { 0 }
+};
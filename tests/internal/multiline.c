@@ -1457,6 +1457,144 @@ static void test_issue_5504()
 #endif
 }
 
+static int flush_callback_count(struct flb_ml_parser *parser,
+                                struct flb_ml_stream *mst,
+                                void *data, char *buf_data, size_t buf_size)
+{
+    size_t *bytes = data;
+
+    *bytes += buf_size;
+    return 0;
+}
+
+/* Feed the input records of a parser test 'iterations' times */
+static void bench_parser(struct flb_config *config, char *name,
+                         struct record_check *in, int in_len,
+                         int text, int iterations)
+{
+    int i;
+    int n;
+    int len;
+    int ret;
+    int lines = 0;
+    size_t bytes = 0;
+    size_t in_bytes = 0;
+    size_t off;
+    uint64_t stream_id;
+    double elapsed;
+    struct flb_ml *ml;
+    struct flb_ml_parser_ins *mlp_i;
+    struct flb_time tm;
+    struct flb_time start_time;
+    struct flb_time end_time;
+    struct flb_time diff_time;
+    msgpack_sbuffer mp_sbuf;
+    msgpack_packer mp_pck;
+    msgpack_unpacked result;
+    msgpack_object *maps;
+
+    ml = flb_ml_create(config, name);
+    TEST_CHECK(ml != NULL);
+    mlp_i = flb_ml_parser_instance_create(ml, name);
+    TEST_CHECK(mlp_i != NULL);
+    if (!ml || !mlp_i) {
+        exit(EXIT_FAILURE);
+    }
+    flb_ml_parser_instance_set(mlp_i, "key_content", "log");
+
+    ret = flb_ml_stream_create(ml, name, -1, flush_callback_count,
+                               (void *) &bytes, &stream_id);
+    TEST_CHECK(ret == 0);
+
+    /* the objects are packed once, out of the measured loop */
+    msgpack_sbuffer_init(&mp_sbuf);
+    msgpack_packer_init(&mp_pck, &mp_sbuf, msgpack_sbuffer_write);
+    for (i = 0; i < in_len; i++) {
+        len = strlen(in[i].buf);
+        in_bytes += len;
+        msgpack_pack_map(&mp_pck, 1);
+        msgpack_pack_str(&mp_pck, 3);
+        msgpack_pack_str_body(&mp_pck, "log", 3);
+        msgpack_pack_str(&mp_pck, len);
+        msgpack_pack_str_body(&mp_pck, in[i].buf, len);
+    }
+
+    maps = flb_calloc(in_len, sizeof(msgpack_object));
+    TEST_CHECK(maps != NULL);
+    if (!maps) {
+        exit(EXIT_FAILURE);
+    }
+    off = 0;
+    msgpack_unpacked_init(&result);
+    for (i = 0; i < in_len; i++) {
+        msgpack_unpack_next(&result, mp_sbuf.data, mp_sbuf.size, &off);
+        maps[i] = result.data;
+    }
+
+    flb_time_get(&tm);
+    flb_time_get(&start_time);
+    for (n = 0; n < iterations; n++) {
+        for (i = 0; i < in_len; i++) {
+            if (text) {
+                flb_ml_append_text(ml, stream_id, &tm,
+                                   in[i].buf, strlen(in[i].buf));
+            }
+            else {
+                flb_ml_append_object(ml, stream_id, &tm, NULL, &maps[i]);
+            }
+            lines++;
+        }
+    }
+    flb_ml_flush_pending_now(ml);
+    flb_time_get(&end_time);
+    flb_time_diff(&end_time, &start_time, &diff_time);
+    elapsed = flb_time_to_double(&diff_time);
+
+    printf("\n%-8s %.0f lines/s, %.1f MB/s in, %zu bytes out",
+           name, lines / elapsed,
+           (in_bytes * iterations) / elapsed / 1000000, bytes);
+
+    msgpack_unpacked_destroy(&result);
+    msgpack_sbuffer_destroy(&mp_sbuf);
+    flb_free(maps);
+    flb_ml_destroy(ml);
+}
+
+/*
+ * Set FLB_ML_BENCH to a number of iterations to report the throughput of
+ * the built-in parsers over their test inputs.
+ */
+static void test_bench()
+{
+    int iterations;
+    char *env;
+    struct flb_config *config;
+
+    env = getenv("FLB_ML_BENCH");
+    if (!env || (iterations = atoi(env)) <= 0) {
+        return;
+    }
+
+    config = flb_config_init();
+    TEST_CHECK(config != NULL);
+    if (!config) {
+        exit(EXIT_FAILURE);
+    }
+
+#define BENCH(name, in, text) \
+    bench_parser(config, name, in, sizeof(in) / sizeof(in[0]), text, iterations)
+
+    BENCH("docker", docker_input, FLB_TRUE);
+    BENCH("cri", cri_input, FLB_TRUE);
+    BENCH("java", java_input, FLB_FALSE);
+    BENCH("python", python_input, FLB_FALSE);
+    BENCH("go", go_input, FLB_FALSE);
+
+#undef BENCH
+
+    flb_config_exit(config);
+}
+
 TEST_LIST = {
     /* Normal features tests */
     { "parser_docker",  test_parser_docker},
@@ -1474,5 +1612,8 @@ TEST_LIST = {
     { "issue_4034"    , test_issue_4034},
     { "issue_4949"    , test_issue_4949},
     { "issue_5504"    , test_issue_5504},
+
+    /* Benchmark, only runs when FLB_ML_BENCH is set */
+    { "bench"         , test_bench},
     { 0 }
 };
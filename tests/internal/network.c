@@ -7,8 +7,21 @@
 #include <fluent-bit/flb_network.h>
 #include <fluent-bit/flb_socket.h>
 #include <fluent-bit/flb_time.h>
+#include <fluent-bit/flb_lib.h>
+#include <fluent-bit/flb_io.h>
+#include <fluent-bit/flb_stream.h>
+#include <fluent-bit/flb_connection.h>
+#include <fluent-bit/flb_upstream.h>
+#include <fluent-bit/flb_engine.h>
+#include <fluent-bit/flb_engine_macros.h>
+#include <fluent-bit/flb_event_loop.h>
+#include <fluent-bit/flb_coro.h>
+#include <fluent-bit/flb_net_dns_cache.h>
+
+#include <ares.h>
 
 #include <time.h>
+#include <pthread.h>
 #include "flb_tests_internal.h"
 
 #define TEST_HOSTv4           "127.0.0.1"
@@ -157,8 +170,564 @@ void test_ipv6_client_server()
     test_client_server(FLB_TRUE);
 }
 
+#ifndef FLB_SYSTEM_WINDOWS
+
+/* Reader side of a socket pair, drains it while the test writes */
+struct test_reader {
+    flb_sockfd_t fd;
+    char *buf;
+    size_t size;
+    size_t len;
+};
+
+static void *test_reader_run(void *data)
+{
+    ssize_t bytes;
+    char tmp[65536];
+    struct test_reader *r = data;
+
+    while (1) {
+        bytes = read(r->fd, tmp, sizeof(tmp));
+        if (bytes <= 0) {
+            break;
+        }
+        if (r->buf && r->len + bytes <= r->size) {
+            memcpy(r->buf + r->len, tmp, bytes);
+        }
+        r->len += bytes;
+    }
+
+    return NULL;
+}
+
+/* Build a vector of buffers of several sizes, some of them empty */
+static struct iovec *test_iov_create(int count, char **out_buf, size_t *out_len)
+{
+    int i;
+    size_t len = 0;
+    char *buf;
+    struct iovec *iov;
+
+    iov = flb_calloc(count, sizeof(struct iovec));
+    buf = flb_malloc(count * 4096);
+    if (!iov || !buf) {
+        flb_free(iov);
+        flb_free(buf);
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++) {
+        iov[i].iov_base = buf + len;
+        iov[i].iov_len = (i % 7 == 0) ? 0 : (i * 131) % 4096;
+        memset(iov[i].iov_base, 'a' + (i % 26), iov[i].iov_len);
+        len += iov[i].iov_len;
+    }
+
+    *out_buf = buf;
+    *out_len = len;
+
+    return iov;
+}
+
+void test_fd_writev()
+{
+    int ret;
+    int fds[2];
+    char *buf;
+    size_t len;
+    size_t sent = 0;
+    pthread_t tid;
+    struct iovec *iov;
+    struct test_reader reader = {0};
+
+    /* more buffers than a single writev(2) call takes */
+    iov = test_iov_create(FLB_IO_IOV_MAX * 3 + 5, &buf, &len);
+    TEST_CHECK(iov != NULL);
+    if (!iov) {
+        return;
+    }
+
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    TEST_CHECK(ret == 0);
+
+    reader.fd = fds[1];
+    reader.size = len;
+    reader.buf = flb_malloc(len);
+    pthread_create(&tid, NULL, test_reader_run, &reader);
+
+    ret = flb_io_fd_writev(fds[0], iov, FLB_IO_IOV_MAX * 3 + 5, &sent);
+    TEST_CHECK(ret == len);
+    TEST_CHECK(sent == len);
+
+    flb_socket_close(fds[0]);
+    pthread_join(tid, NULL);
+    flb_socket_close(fds[1]);
+
+    /* the buffers were laid out contiguously */
+    TEST_CHECK(reader.len == len);
+    TEST_CHECK(memcmp(reader.buf, buf, len) == 0);
+
+    flb_free(reader.buf);
+    flb_free(buf);
+    flb_free(iov);
+}
+
+void test_net_writev()
+{
+    int ret;
+    int fds[2];
+    char *buf;
+    size_t len;
+    size_t sent = 0;
+    pthread_t tid;
+    struct iovec *iov;
+    struct flb_stream stream = {0};
+    struct flb_net_setup net = {0};
+    struct flb_connection conn = {0};
+    struct test_reader reader = {0};
+
+    flb_init_env();
+
+    iov = test_iov_create(20, &buf, &len);
+    TEST_CHECK(iov != NULL);
+    if (!iov) {
+        return;
+    }
+
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    TEST_CHECK(ret == 0);
+
+    /* a synchronous upstream connection */
+    stream.flags = FLB_IO_TCP;
+    conn.stream = &stream;
+    conn.net = &net;
+    conn.type = FLB_UPSTREAM_CONNECTION;
+    conn.fd = fds[0];
+
+    reader.fd = fds[1];
+    reader.size = len;
+    reader.buf = flb_malloc(len);
+    pthread_create(&tid, NULL, test_reader_run, &reader);
+
+    ret = flb_io_net_writev(&conn, iov, 20, &sent);
+    TEST_CHECK(ret == len);
+    TEST_CHECK(sent == len);
+
+    /* nothing to write */
+    ret = flb_io_net_writev(&conn, iov, 1, &sent);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(sent == 0);
+
+    flb_socket_close(fds[0]);
+    pthread_join(tid, NULL);
+    flb_socket_close(fds[1]);
+
+    TEST_CHECK(reader.len == len);
+    TEST_CHECK(memcmp(reader.buf, buf, len) == 0);
+
+    flb_free(reader.buf);
+    flb_free(buf);
+    flb_free(iov);
+}
+
+/* Number of write system calls done by the process, -1 if unknown */
+static long test_write_syscalls()
+{
+    long n = -1;
+    char line[128];
+    FILE *f;
+
+    f = fopen("/proc/self/io", "r");
+    if (!f) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "syscw:", 6) == 0) {
+            n = atol(line + 6);
+            break;
+        }
+    }
+    fclose(f);
+
+    return n;
+}
+
+/*
+ * Set FLB_IO_BENCH to a number of flushes to compare the ways of sending an
+ * HTTP like request (headers and body): one write per buffer, concatenating
+ * them first or a single writev(2).
+ */
+void test_bench_writev()
+{
+    int n;
+    int mode;
+    int fds[2];
+    int flushes;
+    long syscalls;
+    char *env;
+    char *tmp;
+    char header[512];
+    char *body;
+    size_t sent;
+    size_t copied;
+    size_t body_len = 65536;
+    double elapsed;
+    pthread_t tid;
+    struct iovec iov[2];
+    struct flb_time start_time;
+    struct flb_time end_time;
+    struct flb_time diff_time;
+    struct test_reader reader = {0};
+    const char *names[] = {"write x2", "concat", "writev"};
+
+    env = getenv("FLB_IO_BENCH");
+    if (!env || (flushes = atoi(env)) <= 0) {
+        return;
+    }
+
+    memset(header, 'h', sizeof(header));
+    body = flb_malloc(body_len);
+    tmp = flb_malloc(sizeof(header) + body_len);
+    TEST_CHECK(body != NULL && tmp != NULL);
+    if (!body || !tmp) {
+        exit(EXIT_FAILURE);
+    }
+    memset(body, 'b', body_len);
+
+    for (mode = 0; mode < 3; mode++) {
+        TEST_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        reader.fd = fds[1];
+        reader.len = 0;
+        pthread_create(&tid, NULL, test_reader_run, &reader);
+
+        copied = 0;
+        syscalls = test_write_syscalls();
+        flb_time_get(&start_time);
+        for (n = 0; n < flushes; n++) {
+            if (mode == 0) {
+                flb_io_fd_write(fds[0], header, sizeof(header), &sent);
+                flb_io_fd_write(fds[0], body, body_len, &sent);
+            }
+            else if (mode == 1) {
+                memcpy(tmp, header, sizeof(header));
+                memcpy(tmp + sizeof(header), body, body_len);
+                copied += sizeof(header) + body_len;
+                flb_io_fd_write(fds[0], tmp, sizeof(header) + body_len, &sent);
+            }
+            else {
+                iov[0].iov_base = header;
+                iov[0].iov_len = sizeof(header);
+                iov[1].iov_base = body;
+                iov[1].iov_len = body_len;
+                flb_io_fd_writev(fds[0], iov, 2, &sent);
+            }
+        }
+        flb_time_get(&end_time);
+        if (syscalls != -1) {
+            syscalls = test_write_syscalls() - syscalls;
+        }
+
+        flb_socket_close(fds[0]);
+        pthread_join(tid, NULL);
+        flb_socket_close(fds[1]);
+        TEST_CHECK(reader.len == (sizeof(header) + body_len) * flushes);
+
+        flb_time_diff(&end_time, &start_time, &diff_time);
+        elapsed = flb_time_to_double(&diff_time);
+
+        printf("\n%-8s %.0f flushes/s, %.2f syscalls/flush, "
+               "%zu bytes copied/flush",
+               names[mode], flushes / elapsed,
+               syscalls == -1 ? -1.0 : (double) syscalls / flushes,
+               copied / flushes);
+    }
+
+    flb_free(body);
+    flb_free(tmp);
+}
+
+#endif
+
+/* Process the connection events like the engine does */
+static void test_upstream_loop(struct mk_event_loop *evl,
+                               struct flb_bucket_queue *bktq)
+{
+    struct mk_event *event;
+    struct flb_connection *conn;
+
+    mk_event_wait_2(evl, 100);
+    flb_event_priority_live_foreach(event, bktq, evl,
+                                    FLB_ENGINE_LOOP_MAX_ITER) {
+        if (event->type == FLB_ENGINE_EV_CUSTOM) {
+            event->handler(event);
+        }
+        else if (event->type == FLB_ENGINE_EV_THREAD) {
+            conn = (struct flb_connection *) event;
+            if (conn->coroutine) {
+                flb_coro_resume(conn->coroutine);
+            }
+        }
+    }
+}
+
+void test_upstream_prewarm()
+{
+    int i;
+    int ret;
+    int port;
+    time_t deadline;
+    flb_sockfd_t fd;
+    flb_sockfd_t remote;
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    struct mk_event_loop *evl;
+    struct flb_bucket_queue *bktq;
+    struct flb_config *config;
+    struct flb_upstream *u;
+    struct flb_connection *conn;
+
+    flb_init_env();
+
+    config = flb_config_init();
+    TEST_CHECK(config != NULL);
+
+    evl = mk_event_loop_create(256);
+    TEST_CHECK(evl != NULL);
+    bktq = flb_bucket_queue_create(FLB_ENGINE_PRIORITY_COUNT);
+    TEST_CHECK(bktq != NULL);
+    flb_engine_evl_set(evl);
+
+    fd = flb_net_server("0", TEST_HOSTv4, FLB_FALSE);
+    TEST_CHECK(fd != -1);
+    ret = getsockname(fd, (struct sockaddr *) &addr, &len);
+    TEST_CHECK(ret == 0);
+    port = ntohs(addr.sin_port);
+
+    u = flb_upstream_create(config, TEST_HOSTv4, port,
+                            FLB_IO_TCP | FLB_IO_TCP_KA, NULL);
+    TEST_CHECK(u != NULL);
+    u->base.net.dns_resolver = "LEGACY";
+    u->base.net.keepalive_min_idle = 2;
+
+    /* the connections are established in background */
+    deadline = time(NULL) + 5;
+    while (mk_list_size(&u->queue.av_queue) < 2 && time(NULL) < deadline) {
+        flb_upstream_conn_timeouts(&config->upstreams);
+        test_upstream_loop(evl, bktq);
+    }
+    TEST_CHECK(mk_list_size(&u->queue.av_queue) == 2);
+    TEST_CHECK(mk_list_size(&u->queue.busy_queue) == 0);
+
+    /* a caller gets a connection right away */
+    conn = flb_upstream_conn_get(u);
+    TEST_CHECK(conn != NULL);
+    TEST_CHECK(mk_list_size(&u->queue.av_queue) == 1);
+    flb_upstream_conn_release(conn);
+    TEST_CHECK(mk_list_size(&u->queue.av_queue) == 2);
+
+    /* connections closed by the server are dropped by the health check */
+    u->base.net.keepalive_min_idle = 0;
+    for (i = 0; i < 2; i++) {
+        remote = accept(fd, NULL, NULL);
+        TEST_CHECK(remote != -1);
+        flb_socket_close(remote);
+    }
+    flb_upstream_conn_timeouts(&config->upstreams);
+    TEST_CHECK(mk_list_size(&u->queue.av_queue) == 0);
+    TEST_CHECK(mk_list_size(&u->queue.destroy_queue) == 2);
+
+    flb_upstream_conn_pending_destroy(u);
+    flb_upstream_destroy(u);
+    flb_socket_close(fd);
+
+    flb_engine_evl_set(NULL);
+    flb_bucket_queue_destroy(bktq);
+    mk_event_loop_destroy(evl);
+    flb_config_exit(config);
+}
+
+static struct addrinfo *dns_records(int count)
+{
+    int i;
+    struct addrinfo *head = NULL;
+    struct addrinfo *node;
+    struct sockaddr_in *addr;
+
+    for (i = count - 1; i >= 0; i--) {
+        node = flb_calloc(1, sizeof(struct addrinfo));
+        addr = flb_calloc(1, sizeof(struct sockaddr_in));
+        addr->sin_family = AF_INET;
+        addr->sin_addr.s_addr = htonl(0x0a000001 + i);
+
+        node->ai_family = AF_INET;
+        node->ai_socktype = SOCK_STREAM;
+        node->ai_addrlen = sizeof(struct sockaddr_in);
+        node->ai_addr = (struct sockaddr *) addr;
+        node->ai_next = head;
+        head = node;
+    }
+
+    return head;
+}
+
+static void dns_records_free(struct addrinfo *list)
+{
+    struct addrinfo *next;
+
+    while (list) {
+        next = list->ai_next;
+        flb_free(list->ai_addr);
+        flb_free(list);
+        list = next;
+    }
+}
+
+/* last byte of the address of the first record */
+static int dns_first(struct addrinfo *list)
+{
+    return ntohl(((struct sockaddr_in *) list->ai_addr)->sin_addr.s_addr) & 0xff;
+}
+
+static void dns_expire(struct flb_net_dns_cache *cache)
+{
+    struct mk_list *head;
+    struct flb_net_dns_cache_entry *entry;
+
+    mk_list_foreach(head, &cache->entries) {
+        entry = mk_list_entry(head, struct flb_net_dns_cache_entry, _head);
+        entry->expires = time(NULL) - 1;
+    }
+}
+
+void test_dns_cache()
+{
+    int i;
+    int ret;
+    int status;
+    struct addrinfo *rp;
+    struct addrinfo *res;
+    struct addrinfo *records;
+    struct flb_net_dns_cache *cache;
+
+    cache = flb_net_dns_cache_create(60, 5, 30);
+    TEST_CHECK(cache != NULL);
+
+    res = NULL;
+    ret = flb_net_dns_cache_lookup(cache, "example.com", "443", &res, &status);
+    TEST_CHECK(ret == FLB_NET_DNS_CACHE_MISS);
+
+    /* every hit starts with the next record */
+    records = dns_records(3);
+    flb_net_dns_cache_store(cache, "example.com", "443", ARES_SUCCESS,
+                            records, 3600);
+    dns_records_free(records);
+
+    for (i = 0; i < 4; i++) {
+        res = NULL;
+        ret = flb_net_dns_cache_lookup(cache, "example.com", "443",
+                                       &res, &status);
+        TEST_CHECK(ret == FLB_NET_DNS_CACHE_HIT);
+        TEST_CHECK(res != NULL);
+        if (!res) {
+            continue;
+        }
+        TEST_CHECK(dns_first(res) == 1 + (i % 3));
+
+        ret = 0;
+        for (rp = res; rp != NULL; rp = rp->ai_next) {
+            ret++;
+        }
+        TEST_CHECK(ret == 3);
+        dns_records_free(res);
+    }
+
+    /* the port is part of the key */
+    ret = flb_net_dns_cache_lookup(cache, "example.com", "80", &res, &status);
+    TEST_CHECK(ret == FLB_NET_DNS_CACHE_MISS);
+
+    /* the ttl is capped by max_ttl */
+    TEST_CHECK(mk_list_entry_first(&cache->entries,
+                                   struct flb_net_dns_cache_entry,
+                                   _head)->expires <= time(NULL) + 60);
+
+    /* expired: the first caller refreshes, the others get the old records */
+    dns_expire(cache);
+    ret = flb_net_dns_cache_lookup(cache, "example.com", "443", &res, &status);
+    TEST_CHECK(ret == FLB_NET_DNS_CACHE_MISS);
+    res = NULL;
+    ret = flb_net_dns_cache_lookup(cache, "example.com", "443", &res, &status);
+    TEST_CHECK(ret == FLB_NET_DNS_CACHE_STALE);
+    TEST_CHECK(res != NULL);
+    dns_records_free(res);
+
+    /* the refresh failed, the old records are still usable */
+    res = NULL;
+    ret = flb_net_dns_cache_fallback(cache, "example.com", "443", &res);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(res != NULL);
+    dns_records_free(res);
+
+    /* a new answer replaces the entry */
+    records = dns_records(1);
+    flb_net_dns_cache_store(cache, "example.com", "443", ARES_SUCCESS,
+                            records, 10);
+    dns_records_free(records);
+    res = NULL;
+    ret = flb_net_dns_cache_lookup(cache, "example.com", "443", &res, &status);
+    TEST_CHECK(ret == FLB_NET_DNS_CACHE_HIT);
+    TEST_CHECK(res != NULL && res->ai_next == NULL);
+    dns_records_free(res);
+
+    /* a zero ttl answer is not cached */
+    records = dns_records(1);
+    flb_net_dns_cache_store(cache, "example.com", "443", ARES_SUCCESS,
+                            records, 0);
+    dns_records_free(records);
+    ret = flb_net_dns_cache_lookup(cache, "example.com", "443", &res, &status);
+    TEST_CHECK(ret == FLB_NET_DNS_CACHE_MISS);
+    TEST_CHECK(cache->entry_count == 0);
+
+    /* negative answers, other errors are not cached */
+    flb_net_dns_cache_store(cache, "missing.example.com", "443",
+                            ARES_ENOTFOUND, NULL, 0);
+    status = 0;
+    ret = flb_net_dns_cache_lookup(cache, "missing.example.com", "443",
+                                   &res, &status);
+    TEST_CHECK(ret == FLB_NET_DNS_CACHE_NEGATIVE);
+    TEST_CHECK(status == ARES_ENOTFOUND);
+
+    flb_net_dns_cache_store(cache, "down.example.com", "443",
+                            ARES_ETIMEOUT, NULL, 0);
+    ret = flb_net_dns_cache_lookup(cache, "down.example.com", "443",
+                                   &res, &status);
+    TEST_CHECK(ret == FLB_NET_DNS_CACHE_MISS);
+
+    TEST_CHECK(cache->hits == 5);
+    TEST_CHECK(cache->stale_hits == 2);
+    TEST_CHECK(cache->negative_hits == 1);
+    TEST_CHECK(cache->misses == 5);
+
+    flb_net_dns_cache_observe(cache, 2000000);
+    flb_net_dns_cache_observe(cache, 2000000000);
+    TEST_CHECK(cache->latency_count == 2);
+    TEST_CHECK(cache->latency_buckets[0] == 0);
+    TEST_CHECK(cache->latency_buckets[1] == 1);
+    TEST_CHECK(cache->latency_buckets[FLB_NET_DNS_CACHE_LATENCY_BUCKETS] == 2);
+
+    flb_net_dns_cache_destroy(cache);
+}
+
 TEST_LIST = {
     { "ipv4_client_server", test_ipv4_client_server},
     { "ipv6_client_server", test_ipv6_client_server},
+    { "upstream_prewarm"  , test_upstream_prewarm},
+    { "dns_cache"         , test_dns_cache},
+#ifndef FLB_SYSTEM_WINDOWS
+    { "fd_writev"         , test_fd_writev},
+    { "net_writev"        , test_net_writev},
+
+    /* Benchmark, only runs when FLB_IO_BENCH is set */
+    { "bench_writev"      , test_bench_writev},
+#endif
     { 0 }
 };
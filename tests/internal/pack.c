@@ -682,6 +682,45 @@ void test_json_pack_nan()
     flb_pack_init(&config);
 }
 
+void test_json_pack_double()
+{
+    int i;
+    int ret;
+    char json_str[64];
+    msgpack_object obj;
+    struct {
+        double val;
+        char *json;
+    } cases[] = {
+        {10.0,                  "10.0"},
+        {-0.0,                  "-0.0"},
+        {-123456789.0,          "-123456789.0"},
+        {1e17,                  "100000000000000000.0"},
+        {0.1,                   "0.1"},
+        {0.1 + 0.2,             "0.30000000000000004"},
+        {641.781,               "641.781"},
+        {-2.5e-7,               "-2.5e-07"},
+        {0.000123,              "0.000123"},
+        {5e-324,                "5e-324"},
+        {1.7976931348623157e308, "1.7976931348623157e+308"},
+    };
+
+    obj.type = MSGPACK_OBJECT_FLOAT64;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        obj.via.f64 = cases[i].val;
+
+        ret = flb_msgpack_to_json(json_str, sizeof(json_str), &obj);
+        TEST_CHECK(ret == strlen(cases[i].json));
+        if (!TEST_CHECK(strcmp(json_str, cases[i].json) == 0)) {
+            TEST_MSG("expected %s, got %s", cases[i].json, json_str);
+        }
+
+        /* shortest representation still reads back the same value */
+        TEST_CHECK(strtod(json_str, NULL) == cases[i].val);
+    }
+}
+
 static int check_msgpack_val(msgpack_object obj, int expected_type, char *expected_val)
 {
     int len;
@@ -837,6 +876,146 @@ const char input_msgpack[] = {0x92,/* array 2 */
                             0x81, 0xa2, 0x61, 0x61, 0xa2, 0x62, 0x62 /* {"aa":"bb"} */
 };
 
+#ifdef FLB_HAVE_SIMD
+/* Pack 'json' with the given backend */
+static int pack_json_backend(int backend, char *json, size_t len,
+                             char **out_buf, size_t *out_size,
+                             int *root_type, int *records, size_t *consumed)
+{
+    int ret;
+    int prev;
+
+    prev = flb_pack_json_backend_set(backend);
+    ret = flb_pack_json_recs(json, len, out_buf, out_size, root_type,
+                             records, consumed);
+    flb_pack_json_backend_set(prev);
+
+    return ret;
+}
+
+/* The single pass packer must produce the same output than jsmn */
+void test_json_pack_backends()
+{
+    int i;
+    int n;
+    int ret_a;
+    int ret_b;
+    int type_a;
+    int type_b;
+    int recs_a;
+    int recs_b;
+    char *json;
+    char *big;
+    char *buf_a;
+    char *buf_b;
+    size_t len;
+    size_t size_a;
+    size_t size_b;
+    size_t consumed_a;
+    size_t consumed_b;
+    struct flb_pack_state state;
+    char *samples[] = {
+        "{\"key\": \"value\", \"int\": 123, \"neg\": -5, \"float\": 1.5}",
+        "{\"nested\": {\"a\": [1, 2, {\"b\": null}], \"c\": {}}, \"d\": []}",
+        "{\"esc\": \"a\\\"b\\\\c\\nd\\u00e9\\u2603\", \"t\": true, \"f\": false}",
+        "[\"one\", \"two\", 3, 4.25e-2, 1e5]",
+        "{\"a\": 1}\n{\"b\": 2}\n{\"c\": 3}\n",
+        "{\"a\": 1},{\"b\": [1,2,]} ",
+        "\"root string\"",
+        "123 ",
+        "{\"long\": \"0123456789012345678901234567890123456789\"}",
+        "{\"a\": 1",
+        "{\"a\" 1}",
+        "{\"a\": 1]",
+        "{1: 2}",
+        "{\"a\": x}",
+        "{\"a\":1 \"b\":2}",
+        "{\"a\": [1] \"b\": 2}",
+        "[1 2]",
+        "[\"a\" {}]",
+        "{\"a\":1,,\"b\":2}",
+        "",
+        "   ",
+        NULL
+    };
+
+    for (i = 0; samples[i] != NULL; i++) {
+        json = samples[i];
+        len = strlen(json);
+
+        buf_a = NULL;
+        buf_b = NULL;
+        ret_a = pack_json_backend(FLB_PACK_JSON_BACKEND_JSMN, json, len,
+                                  &buf_a, &size_a, &type_a, &recs_a,
+                                  &consumed_a);
+        ret_b = pack_json_backend(FLB_PACK_JSON_BACKEND_SCAN, json, len,
+                                  &buf_b, &size_b, &type_b, &recs_b,
+                                  &consumed_b);
+
+        /* jsmn accepts some broken input, the scanner only has to be stricter */
+        if (ret_a != 0 || ret_b != 0) {
+            TEST_CHECK(ret_b != 0);
+            TEST_MSG("sample %i: jsmn=%i scan=%i", i, ret_a, ret_b);
+            if (ret_a == 0) {
+                flb_free(buf_a);
+            }
+            continue;
+        }
+
+        TEST_CHECK(type_a == type_b);
+        TEST_CHECK(recs_a == recs_b);
+        TEST_CHECK(consumed_a == consumed_b);
+        TEST_MSG("sample %i: consumed jsmn=%zu scan=%zu", i,
+                 consumed_a, consumed_b);
+        TEST_CHECK(size_a == size_b && memcmp(buf_a, buf_b, size_a) == 0);
+        TEST_MSG("sample %i: msgpack output differs", i);
+
+        flb_free(buf_a);
+        flb_free(buf_b);
+    }
+
+    /*
+     * A missing comma between two members is an error, not a new key. The
+     * streaming packer must not wait for more data either.
+     */
+    json = "{\"a\":1 \"b\":2}";
+    flb_pack_state_init(&state);
+    n = flb_pack_json_backend_set(FLB_PACK_JSON_BACKEND_SCAN);
+    ret_b = flb_pack_json_state(json, strlen(json), &buf_b, &i, &state);
+    flb_pack_json_backend_set(n);
+    TEST_CHECK(ret_b == FLB_ERR_JSON_INVAL);
+    if (ret_b == 0) {
+        flb_free(buf_b);
+    }
+    flb_pack_state_reset(&state);
+
+    /* containers bigger than fixmap/fixarray and 16 bits headers */
+    n = 70000;
+    big = flb_malloc(n * 2 + 64);
+    TEST_CHECK(big != NULL);
+    len = 0;
+    len += sprintf(big, "{\"items\": [");
+    for (i = 0; i < n; i++) {
+        big[len++] = (i % 10) + '0';
+        big[len++] = ',';
+    }
+    len--;
+    len += sprintf(big + len, "]}");
+
+    ret_a = pack_json_backend(FLB_PACK_JSON_BACKEND_JSMN, big, len,
+                              &buf_a, &size_a, &type_a, &recs_a, &consumed_a);
+    ret_b = pack_json_backend(FLB_PACK_JSON_BACKEND_SCAN, big, len,
+                              &buf_b, &size_b, &type_b, &recs_b, &consumed_b);
+    TEST_CHECK(ret_a == 0 && ret_b == 0);
+    if (ret_a == 0 && ret_b == 0) {
+        TEST_CHECK(size_a == size_b && memcmp(buf_a, buf_b, size_a) == 0);
+        flb_free(buf_a);
+        flb_free(buf_b);
+    }
+    flb_free(big);
+}
+#endif
+
 void test_json_date(char* expect, int date_format)
 {
     flb_sds_t json_key;
@@ -902,6 +1081,10 @@ TEST_LIST = {
     { "json_pack_bug1278"  , test_json_pack_bug1278},
     { "json_pack_nan"      , test_json_pack_nan},
     { "json_pack_bug5336"  , test_json_pack_bug5336},
+    { "json_pack_double"   , test_json_pack_double},
+#ifdef FLB_HAVE_SIMD
+    { "json_pack_backends" , test_json_pack_backends},
+#endif
     { "json_date_iso8601" , test_json_date_iso8601},
     { "json_date_double" , test_json_date_double},
     { "json_date_java_sql" , test_json_date_java_sql},
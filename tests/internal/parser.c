@@ -8,6 +8,7 @@
 #include <fluent-bit/flb_sds.h>
 
 #include <time.h>
+#include <stdlib.h>
 #include <string.h>
 #include "flb_tests_internal.h"
 
@@ -518,11 +519,347 @@ void test_mysql_unquoted()
 }
 
 
+/*
+ * Time lookups with the built-in decoder and the cache must be the same
+ * as flb_strptime() ones. Samples are parsed as they are and with random
+ * edits, each one twice so the second lookup comes from the cache.
+ */
+static int time_lookup_ref(struct flb_parser *p, const char *str, size_t len,
+                           time_t now, struct flb_tm *tm, double *ns)
+{
+    int ret;
+    int time_fast;
+    struct flb_parser_time_cache *time_cache;
+
+    time_fast = p->time_fast;
+    time_cache = p->time_cache;
+    p->time_fast = 0;
+    p->time_cache = NULL;
+
+    ret = flb_parser_time_lookup(str, len, now, p, tm, ns);
+
+    p->time_fast = time_fast;
+    p->time_cache = time_cache;
+
+    return ret;
+}
+
+static int time_lookup_compare(struct flb_parser *p, const char *str,
+                               size_t len, time_t now)
+{
+    int ret;
+    int ret_ref;
+    double ns;
+    double ns_ref;
+    struct flb_tm tm = {0};
+    struct flb_tm tm_ref = {0};
+
+    ret = flb_parser_time_lookup(str, len, now, p, &tm, &ns);
+    ret_ref = time_lookup_ref(p, str, len, now, &tm_ref, &ns_ref);
+
+    if (ret != ret_ref || ns != ns_ref ||
+        tm.tm.tm_sec != tm_ref.tm.tm_sec ||
+        tm.tm.tm_min != tm_ref.tm.tm_min ||
+        tm.tm.tm_hour != tm_ref.tm.tm_hour ||
+        tm.tm.tm_mday != tm_ref.tm.tm_mday ||
+        tm.tm.tm_mon != tm_ref.tm.tm_mon ||
+        tm.tm.tm_year != tm_ref.tm.tm_year ||
+        tm.tm.tm_wday != tm_ref.tm.tm_wday ||
+        tm.tm.tm_yday != tm_ref.tm.tm_yday ||
+        tm.tm.tm_isdst != tm_ref.tm.tm_isdst ||
+        flb_tm_gmtoff(&tm) != flb_tm_gmtoff(&tm_ref)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static struct flb_parser *time_parser_create(char *name, char *time_fmt,
+                                             struct flb_config *config)
+{
+    struct flb_parser *p;
+
+    p = flb_parser_create(name, "json", NULL, FLB_TRUE, time_fmt, "time",
+                          NULL, FLB_FALSE, FLB_FALSE, FLB_FALSE, FLB_FALSE,
+                          NULL, 0, NULL, config);
+    TEST_CHECK(p != NULL);
+    if (!p) {
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+void test_time_lookup_fast()
+{
+    int i;
+    int ret;
+    int j;
+    int k;
+    int n;
+    int len;
+    int failed = 0;
+    char name[16];
+    char buf[64];
+    time_t now = 1500322623;
+    struct flb_parser *p;
+    struct flb_config *config;
+    const char *alphabet = "0123456789012345:-+ ./,TZ\tJulunAaxy";
+    char *formats[] = {
+        "%Y-%m-%dT%H:%M:%S.%L%z",
+        "%Y-%m-%dT%H:%M:%S.%LZ",
+        "%Y-%m-%dT%H:%M:%S%z",
+        "%Y-%m-%dT%H:%M:%S",
+        "%Y-%m-%d %H:%M:%S.%L",
+        "%Y-%m-%d %H:%M:%S,%L",
+        "%d/%b/%Y:%H:%M:%S %z",
+        "%b %d %H:%M:%S",
+        "%b %d %H:%M:%S.%L %z",
+        "%m/%d/%Y %H:%M:%S:%L %z",
+        "%a %b %d %H:%M:%S.%L %Y",
+    };
+    char *samples[] = {
+        "2017-07-17T20:17:03.123456Z",
+        "2017-07-17T20:17:03.1+02:00",
+        "2017-07-17T20:17:03-0600",
+        "2016-02-29T23:59:60.999999999+0000",
+        "2000-12-31 00:00:00.5",
+        "1999-01-01 12:00:00,25",
+        "17/Jul/2017:20:17:03 +0530",
+        "01/Dec/2024:00:00:00 -1200",
+        "29/feb/2016:23:59:59 +00:00",
+        "Jul 17 20:17:03",
+        "May 01 20:17:03.1234 -0600",
+        "07/17/2017 22:17:03:1 +02:00",
+        "Mon Jul 17 20:17:03.1234 2017",
+    };
+
+    config = flb_config_init();
+    TEST_CHECK(config != NULL);
+    if (!config) {
+        exit(EXIT_FAILURE);
+    }
+
+    /* the formats mostly used by the bundled parsers take the fast path */
+    p = time_parser_create("fast_iso", "%Y-%m-%dT%H:%M:%S.%L%z", config);
+    TEST_CHECK(p->time_fast != 0 && p->time_cache != NULL);
+    p = time_parser_create("fast_clf", "%d/%b/%Y:%H:%M:%S %z", config);
+    TEST_CHECK(p->time_fast != 0 && p->time_cache != NULL);
+    p = time_parser_create("slow_tz", "%Y-%m-%d %H:%M:%S %Z", config);
+    TEST_CHECK(p->time_fast == 0 && p->time_cache == NULL);
+
+    srand(1);
+
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        snprintf(name, sizeof(name), "time_%i", i);
+        p = time_parser_create(name, formats[i], config);
+
+        for (j = 0; j < sizeof(samples) / sizeof(samples[0]) && !failed; j++) {
+            for (k = 0; k < 2000; k++) {
+                len = strlen(samples[j]);
+                memcpy(buf, samples[j], len);
+
+                /* the first rounds use the sample as it is */
+                for (n = k < 2 ? 0 : 1 + rand() % 2; n > 0; n--) {
+                    switch (rand() % 3) {
+                    case 0:
+                        buf[rand() % len] = alphabet[rand() % strlen(alphabet)];
+                        break;
+                    case 1:
+                        len = rand() % len + 1;
+                        break;
+                    default:
+                        /* change the subseconds only */
+                        if (buf[len - 1] >= '0' && buf[len - 1] <= '9') {
+                            buf[len - 1] = '0' + rand() % 10;
+                        }
+                    }
+                }
+
+                ret = time_lookup_compare(p, buf, len, now);
+                if (ret == 0) {
+                    ret = time_lookup_compare(p, buf, len, now);
+                }
+                if (!TEST_CHECK(ret == 0)) {
+                    TEST_MSG("format '%s' time '%.*s' differs",
+                             formats[i], len, buf);
+                    failed = FLB_TRUE;
+                    break;
+                }
+            }
+        }
+    }
+
+    flb_parser_exit(config);
+    flb_config_exit(config);
+}
+
+void test_time_lookup_cache()
+{
+    int ret;
+    double ns;
+    time_t epoch;
+    struct flb_tm tm;
+    struct flb_parser *p;
+    struct flb_config *config;
+
+    config = flb_config_init();
+    TEST_CHECK(config != NULL);
+    if (!config) {
+        exit(EXIT_FAILURE);
+    }
+
+    p = time_parser_create("iso", "%Y-%m-%dT%H:%M:%S.%L%z", config);
+
+    /* same second, the subseconds come from the string */
+    memset(&tm, 0, sizeof(tm));
+    ret = flb_parser_time_lookup("2017-07-18T01:47:03.25+05:30", 28, 0,
+                                 p, &tm, &ns);
+    TEST_CHECK(ret == 0 && ns == 0.25);
+    TEST_CHECK(flb_parser_tm2time(&tm, FLB_FALSE) == 1500322623);
+    TEST_CHECK(p->time_cache != NULL);
+
+    memset(&tm, 0, sizeof(tm));
+    ret = flb_parser_time_lookup("2017-07-18T01:47:03.5+05:30", 27, 0,
+                                 p, &tm, &ns);
+    TEST_CHECK(ret == 0 && ns == 0.5);
+    TEST_CHECK(flb_parser_tm2time(&tm, FLB_FALSE) == 1500322623);
+
+    /* a different offset after the subseconds is not a hit */
+    memset(&tm, 0, sizeof(tm));
+    ret = flb_parser_time_lookup("2017-07-18T01:47:03.5+00:00", 27, 0,
+                                 p, &tm, &ns);
+    TEST_CHECK(ret == 0 && ns == 0.5);
+    TEST_CHECK(flb_parser_tm2time(&tm, FLB_FALSE) == 1500322623 + 19800);
+
+    /* the fixed offset is applied after the cache */
+    p = time_parser_create("no_tz", "%Y-%m-%d %H:%M:%S", config);
+
+    memset(&tm, 0, sizeof(tm));
+    ret = flb_parser_time_lookup("2017-07-17 22:17:03", 19, 0, p, &tm, &ns);
+    TEST_CHECK(ret == 0);
+    epoch = flb_parser_tm2time(&tm, FLB_FALSE);
+    TEST_CHECK(epoch == 1500322623 + 7200);
+
+    p->time_offset = 7200;
+    memset(&tm, 0, sizeof(tm));
+    ret = flb_parser_time_lookup("2017-07-17 22:17:03", 19, 0, p, &tm, &ns);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(flb_parser_tm2time(&tm, FLB_FALSE) == 1500322623);
+
+    flb_parser_exit(config);
+    flb_config_exit(config);
+}
+
+#define TIME_BENCH_LINES 1000
+
+/*
+ * Set FLB_PARSER_BENCH to a number of iterations to report the time lookup
+ * throughput with flb_strptime(), the built-in decoder and the cache. Every
+ * 100 lookups share the same second.
+ */
+void test_time_lookup_bench()
+{
+    int i;
+    int n;
+    int len;
+    int mode;
+    int iterations;
+    int time_fast;
+    char *env;
+    char *str;
+    char (*lines)[64];
+    double ns;
+    double elapsed;
+    time_t t;
+    time_t now = 1500322623;
+    struct tm tm_gm;
+    struct flb_tm tm;
+    struct flb_time start_time;
+    struct flb_time end_time;
+    struct flb_time diff_time;
+    struct flb_parser *p;
+    struct flb_parser_time_cache *time_cache;
+    struct flb_config *config;
+    char *formats[] = {
+        "%Y-%m-%dT%H:%M:%S.%L%z",
+        "%d/%b/%Y:%H:%M:%S %z",
+        "%b %d %H:%M:%S",
+    };
+    char *modes[] = {"strptime", "fast", "cached"};
+
+    env = getenv("FLB_PARSER_BENCH");
+    if (!env || (iterations = atoi(env)) <= 0) {
+        return;
+    }
+
+    config = flb_config_init();
+    lines = flb_malloc(TIME_BENCH_LINES * sizeof(*lines));
+    TEST_CHECK(config != NULL && lines != NULL);
+    if (!config || !lines) {
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        p = time_parser_create(formats[i], formats[i], config);
+
+        for (n = 0; n < TIME_BENCH_LINES; n++) {
+            t = now + n / 100;
+            gmtime_r(&t, &tm_gm);
+            if (i == 0) {
+                len = strftime(lines[n], sizeof(lines[n]),
+                               "%Y-%m-%dT%H:%M:%S", &tm_gm);
+                snprintf(lines[n] + len, sizeof(lines[n]) - len,
+                         ".%06iZ", n * 997 % 1000000);
+            }
+            else if (i == 1) {
+                strftime(lines[n], sizeof(lines[n]),
+                         "%d/%b/%Y:%H:%M:%S +0200", &tm_gm);
+            }
+            else {
+                strftime(lines[n], sizeof(lines[n]), "%b %d %H:%M:%S", &tm_gm);
+            }
+        }
+
+        time_fast = p->time_fast;
+        time_cache = p->time_cache;
+
+        for (mode = 0; mode < 3; mode++) {
+            p->time_fast = mode > 0 ? time_fast : 0;
+            p->time_cache = mode > 1 ? time_cache : NULL;
+
+            flb_time_get(&start_time);
+            for (n = 0; n < iterations; n++) {
+                str = lines[n % TIME_BENCH_LINES];
+                memset(&tm, 0, sizeof(tm));
+                flb_parser_time_lookup(str, strlen(str), now, p, &tm, &ns);
+                flb_parser_tm2time(&tm, FLB_FALSE);
+            }
+            flb_time_get(&end_time);
+            flb_time_diff(&end_time, &start_time, &diff_time);
+            elapsed = flb_time_to_double(&diff_time);
+
+            printf("\n%-24s %-8s %.0f lookups/s", formats[i], modes[mode],
+                   iterations / elapsed);
+        }
+
+        p->time_fast = time_fast;
+        p->time_cache = time_cache;
+    }
+
+    flb_free(lines);
+    flb_parser_exit(config);
+    flb_config_exit(config);
+}
+
 TEST_LIST = {
     { "tzone_offset", test_parser_tzone_offset},
     { "time_lookup", test_parser_time_lookup},
     { "json_time_lookup", test_json_parser_time_lookup},
     { "regex_time_lookup", test_regex_parser_time_lookup},
     { "mysql_unquoted" , test_mysql_unquoted },
+    { "time_lookup_fast", test_time_lookup_fast },
+    { "time_lookup_cache", test_time_lookup_cache },
+    { "time_lookup_bench", test_time_lookup_bench },
     { 0 }
 };
@@ -480,6 +480,397 @@ void test_decode_field_json()
     flb_config_exit(config);
 }
 
+void test_literal_prefilter()
+{
+    int i;
+    struct flb_regex *regex;
+    struct {
+        char *pattern;
+        char *literal;
+    } cases[] = {
+        /* longest top level run, escapes resolved */
+        {"^(?<host>[^ ]*) [^ ]* \\[(?<time>[^\\]]*)\\] \"(?<method>\\S+)", "] \""},
+        {"(?<a>\\w+)-(?<b>\\w+)\\.log$", ".log"},
+        /* an optional character is not required */
+        {"abc?d", "ab"},
+        {"xab{2,3}c", "xa"},
+        {"x(?<a>foo)?bar+", "ba"},
+        /* a leading ']' is part of the class */
+        {"[]abc]def", "def"},
+        /* disabled */
+        {"foo|bar", NULL},
+        {"/foobar/i", NULL},
+        {"(?i)foobar", NULL},
+        {"(?<a>x)\\k<a>foobar", NULL},
+        {"\\x41foo", NULL},
+        {"(?# ( )foobar", NULL},
+        {"a{foobar", NULL},
+        /* too short to be useful */
+        {"^(?<a>[^ ]+) (?<b>.*)$", NULL},
+    };
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        regex = flb_regex_create(cases[i].pattern);
+        if (!TEST_CHECK(regex != NULL)) {
+            TEST_MSG("pattern %s", cases[i].pattern);
+            continue;
+        }
+
+        if (cases[i].literal == NULL) {
+            TEST_CHECK(regex->literal == NULL);
+        }
+        else if (TEST_CHECK(regex->literal != NULL)) {
+            TEST_CHECK(regex->literal_len == strlen(cases[i].literal) &&
+                       memcmp(regex->literal, cases[i].literal,
+                              regex->literal_len) == 0);
+        }
+        TEST_MSG("pattern %s literal '%.*s'", cases[i].pattern,
+                 regex->literal_len, regex->literal);
+
+        flb_regex_destroy(regex);
+    }
+
+    /* the prefilter only rejects lines the engine would reject */
+    regex = flb_regex_create("(?<a>\\d+) ms, id=(?<b>\\w+)");
+    TEST_CHECK(regex != NULL && regex->literal_len == 8);
+    TEST_CHECK(flb_regex_match(regex, (unsigned char *) "took 10 ms, id=x", 16) == 1);
+    TEST_CHECK(flb_regex_match(regex, (unsigned char *) "took 10 ms id=x", 15) == 0);
+    TEST_CHECK(flb_regex_match(regex, (unsigned char *)
+                               "a long line, longer than a vector 10 ms, id=end", 47) == 1);
+    TEST_CHECK(flb_regex_match(regex, (unsigned char *)
+                               "a long line, longer than a vector 10 ms, id", 43) == 0);
+    flb_regex_destroy(regex);
+
+    /* patterns made of the literal only */
+    regex = flb_regex_create("kube-probe\\/1\\.2");
+    TEST_CHECK(regex != NULL && regex->literal_exact == FLB_TRUE);
+    TEST_CHECK(regex->literal_len == 14);
+    flb_regex_destroy(regex);
+
+    regex = flb_regex_create("/healthcheck/m");
+    TEST_CHECK(regex != NULL && regex->literal_exact == FLB_TRUE);
+    flb_regex_destroy(regex);
+
+    regex = flb_regex_create("^healthcheck");
+    TEST_CHECK(regex != NULL && regex->literal_exact == FLB_FALSE);
+    flb_regex_destroy(regex);
+
+    regex = flb_regex_create("health\\scheck");
+    TEST_CHECK(regex != NULL && regex->literal_exact == FLB_FALSE);
+    flb_regex_destroy(regex);
+}
+
+/*
+ * Samples for the bundled parsers. Each one is parsed with and without the
+ * literal prefilter and both outputs must be the same. Set FLB_PARSER_BENCH
+ * to a number of iterations to also report the parsing throughput.
+ */
+#define PARSERS_CONF FLB_TESTS_DATA_PATH "/../../conf/parsers.conf"
+
+void test_parsers_conf()
+{
+    int i;
+    int n;
+    int ret;
+    int ret_ref;
+    int native;
+    int iterations = 0;
+    char *env;
+    char *literal;
+    void *out_buf;
+    void *ref_buf;
+    size_t out_size;
+    size_t ref_size;
+    double elapsed;
+    struct flb_time out_time;
+    struct flb_time start_time;
+    struct flb_time end_time;
+    struct flb_time diff_time;
+    struct flb_parser *parser;
+    struct flb_config *config;
+    struct {
+        char *name;
+        char *line;
+    } samples[] = {
+        {"apache",
+         "192.168.2.20 - - [29/Jul/2015:10:27:10 -0300] \"GET /cgi-bin/try/ HTTP/1.0\" 200 3395"},
+        {"apache2",
+         "192.168.2.20 - - [29/Jul/2015:10:27:10 -0300] \"GET /index.html HTTP/1.1\" 200 3395 \"-\" \"Mozilla/5.0\""},
+        {"apache_error",
+         "[Wed Oct 11 14:32:52 2000] [error] [client 127.0.0.1] client denied by server configuration"},
+        {"nginx",
+         "172.17.0.1 - - [29/Jul/2015:10:27:10 -0300] \"GET / HTTP/1.1\" 200 612 \"-\" \"curl/7.64.0\""},
+        {"docker-daemon",
+         "time=\"2019-01-01T00:00:00.000000000Z\" level=info msg=\"loading plugin\""},
+        {"syslog-rfc5424",
+         "<165>1 2003-10-11T22:14:15.003Z mymachine.example.com evntslog - ID47 - An application event"},
+        {"syslog-rfc3164",
+         "<34>Oct 11 22:14:15 mymachine su: 'su root' failed for lonvick on /dev/pts/8"},
+        {"cri",
+         "2019-01-01T00:00:00.000000000Z stdout F a message from the container"},
+        {"kube-custom",
+         "var.log.containers.app-5d7f8_default_app-"
+         "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef.log"},
+        /* lines the parsers must reject */
+        {"apache", "not an access log line"},
+        {"nginx", "172.17.0.1 - - 29/Jul/2015:10:27:10 -0300 GET / HTTP/1.1 200 612"},
+        {"kube-custom", "var_containers_app_default_app-0123.txt"},
+    };
+
+    env = getenv("FLB_PARSER_BENCH");
+    if (env) {
+        iterations = atoi(env);
+    }
+
+    config = flb_config_init();
+    if (!TEST_CHECK(config != NULL)) {
+        exit(EXIT_FAILURE);
+    }
+
+    ret = flb_parser_conf_file(PARSERS_CONF, config);
+    if (!TEST_CHECK(ret == 0)) {
+        flb_config_exit(config);
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        parser = flb_parser_get(samples[i].name, config);
+        if (!TEST_CHECK(parser != NULL)) {
+            TEST_MSG("parser %s not found", samples[i].name);
+            continue;
+        }
+
+        out_buf = NULL;
+        ret = flb_parser_do(parser, samples[i].line, strlen(samples[i].line),
+                            &out_buf, &out_size, &out_time);
+        /* the first samples match, the last ones don't */
+        TEST_CHECK((i < 9 && ret != -1) || (i >= 9 && ret == -1));
+        TEST_MSG("parser %s ret=%i", samples[i].name, ret);
+
+        /* same result without the prefilter */
+        literal = parser->regex->literal;
+        parser->regex->literal = NULL;
+
+        ref_buf = NULL;
+        ret_ref = flb_parser_do(parser, samples[i].line, strlen(samples[i].line),
+                                &ref_buf, &ref_size, &out_time);
+        parser->regex->literal = literal;
+
+        TEST_CHECK(ret == ret_ref);
+        if (ret != -1 && ret_ref != -1) {
+            TEST_CHECK(out_size == ref_size &&
+                       memcmp(out_buf, ref_buf, out_size) == 0);
+            TEST_MSG("parser %s output differs", samples[i].name);
+        }
+        flb_free(out_buf);
+        flb_free(ref_buf);
+
+        if (iterations <= 0) {
+            continue;
+        }
+
+        /* regex engine first, then the built-in matcher if any */
+        native = parser->native;
+        parser->native = 0;
+        do {
+            flb_time_get(&start_time);
+            for (n = 0; n < iterations; n++) {
+                out_buf = NULL;
+                ret = flb_parser_do(parser, samples[i].line, strlen(samples[i].line),
+                                    &out_buf, &out_size, &out_time);
+                flb_free(out_buf);
+            }
+            flb_time_get(&end_time);
+            flb_time_diff(&end_time, &start_time, &diff_time);
+            elapsed = flb_time_to_double(&diff_time);
+
+            printf("\n%-16s %-8s %-6s %.0f lines/s", samples[i].name,
+                   ret == -1 ? "reject" : "match",
+                   parser->native ? "native" : "regex", iterations / elapsed);
+
+            if (parser->native || !native) {
+                break;
+            }
+            parser->native = native;
+        } while (1);
+    }
+
+    flb_config_exit(config);
+}
+
+/*
+ * The built-in matchers must produce the same records as the regex engine.
+ * Lines are derived from a sample of every format with random edits and
+ * parsed by both.
+ */
+static int native_compare(struct flb_parser *parser, char *line, size_t len)
+{
+    int ret;
+    int ret_ref;
+    int native;
+    void *out_buf = NULL;
+    void *ref_buf = NULL;
+    size_t out_size = 0;
+    size_t ref_size = 0;
+    struct flb_time out_time;
+
+    ret = flb_parser_do(parser, line, len, &out_buf, &out_size, &out_time);
+
+    native = parser->native;
+    parser->native = 0;
+    ret_ref = flb_parser_do(parser, line, len, &ref_buf, &ref_size, &out_time);
+    parser->native = native;
+
+    if (ret != ret_ref ||
+        (ret != -1 && (out_size != ref_size ||
+                       memcmp(out_buf, ref_buf, out_size) != 0))) {
+        TEST_MSG("parser %s ret=%i expected=%i line '%.*s'",
+                 parser->name, ret, ret_ref, (int) len, line);
+        ret = -1;
+    }
+    else {
+        ret = 0;
+    }
+
+    flb_free(out_buf);
+    flb_free(ref_buf);
+
+    return ret;
+}
+
+void test_native()
+{
+    int i;
+    int j;
+    int k;
+    int ret;
+    int round;
+    int matched;
+    size_t len;
+    size_t pos;
+    char line[512];
+    char name[64];
+    ptrdiff_t beg[FLB_PARSER_NATIVE_GROUPS + 1];
+    ptrdiff_t end[FLB_PARSER_NATIVE_GROUPS + 1];
+    const char *charset = " \"[]-:<>1a\t/.=_";
+    struct flb_parser *conf_parser;
+    struct flb_parser *parser;
+    struct flb_config *config;
+    struct {
+        char *name;
+        char *line;
+    } samples[] = {
+        {"apache",
+         "192.168.2.20 - - [29/Jul/2015:10:27:10 -0300] \"GET /cgi-bin/try/ HTTP/1.0\" 200 3395"},
+        {"apache",
+         "10.0.0.1 - frank [10/Oct/2000:13:55:36 -0700] \"-\" 400 0 \"-\" \"-\""},
+        {"apache2",
+         "192.168.2.20 - - [29/Jul/2015:10:27:10 -0300] \"GET /a HTTP/1.1\" 200 3395 \"-\" \"Mozilla/5.0 \"x\"\""},
+        {"nginx",
+         "172.17.0.1 - - [29/Jul/2015:10:27:10 -0300] \"GET / HTTP/1.1\" 200 612 \"-\" \"curl/7.64.0\" extra"},
+        {"docker-daemon",
+         "time=\"2019-01-01T00:00:00Z\" level=info msg=\"loading \"plugin\"\" x"},
+        {"syslog-rfc5424",
+         "<165>1 2003-10-11T22:14:15.003Z host app 1234 ID47 [a=\"1\"] [b] message]"},
+        {"syslog-rfc3164",
+         "<34>Oct  1 22:14:15 mymachine su[123]: 'su root' failed: for lonvick"},
+        {"syslog-rfc3164-local",
+         "<34>Oct 11 22:14:15 su: 'su root' failed for lonvick on /dev/pts/8"},
+        {"cri",
+         "2019-01-01T00:00:00.000000000Z stderr P a message from the container"},
+    };
+
+    config = flb_config_init();
+    if (!TEST_CHECK(config != NULL)) {
+        exit(EXIT_FAILURE);
+    }
+
+    ret = flb_parser_conf_file(PARSERS_CONF, config);
+    if (!TEST_CHECK(ret == 0)) {
+        flb_config_exit(config);
+        exit(EXIT_FAILURE);
+    }
+
+    srand(1);
+
+    for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        conf_parser = flb_parser_get(samples[i].name, config);
+        if (!TEST_CHECK(conf_parser != NULL && conf_parser->native != 0)) {
+            TEST_MSG("parser %s", samples[i].name);
+            continue;
+        }
+
+        /* same pattern without time handling to keep the output quiet */
+        snprintf(name, sizeof(name) - 1, "native-%i", i);
+        parser = flb_parser_create(name, "regex", conf_parser->p_regex,
+                                   FLB_FALSE, NULL, NULL, NULL,
+                                   FLB_FALSE, FLB_FALSE, FLB_FALSE, FLB_FALSE,
+                                   NULL, 0, NULL, config);
+        if (!TEST_CHECK(parser != NULL && parser->native != 0)) {
+            continue;
+        }
+
+        /* the sample itself must match */
+        len = strlen(samples[i].line);
+        ret = flb_parser_native_do(parser->native, samples[i].line, len,
+                                   beg, end);
+        TEST_CHECK(ret > 0);
+        TEST_MSG("parser %s does not match its sample", samples[i].name);
+        if (!TEST_CHECK(native_compare(parser, samples[i].line, len) == 0)) {
+            continue;
+        }
+
+        matched = 0;
+        for (round = 0; round < 5000; round++) {
+            len = strlen(samples[i].line);
+            memcpy(line, samples[i].line, len);
+
+            for (j = rand() % 4; j >= 0; j--) {
+                pos = rand() % (len + 1);
+                k = rand() % 3;
+                if (k == 0 && pos < len) {
+                    line[pos] = charset[rand() % strlen(charset)];
+                }
+                else if (k == 1 && len < sizeof(line) - 1) {
+                    memmove(line + pos + 1, line + pos, len - pos);
+                    line[pos] = charset[rand() % strlen(charset)];
+                    len++;
+                }
+                else if (pos < len) {
+                    memmove(line + pos, line + pos + 1, len - pos - 1);
+                    len--;
+                }
+            }
+
+            ret = native_compare(parser, line, len);
+            if (!TEST_CHECK(ret == 0)) {
+                break;
+            }
+            if (flb_parser_native_do(parser->native, line, len, beg, end) > 0) {
+                matched++;
+            }
+        }
+        TEST_CHECK(matched > 0);
+        TEST_MSG("parser %s matched %i", samples[i].name, matched);
+    }
+
+    /* multibyte text is matched, invalid UTF-8 and line breaks fall back */
+    parser = flb_parser_get("native-8", config);
+    if (TEST_CHECK(parser != NULL)) {
+        TEST_CHECK(native_compare(parser, "2019 stdout F caf\xc3\xa9", 19) == 0);
+        TEST_CHECK(native_compare(parser, "2019 stdout F caf\xc3", 18) == 0);
+        TEST_CHECK(native_compare(parser, "2019 stdout F a\nb", 17) == 0);
+        ret = flb_parser_native_do(parser->native, "2019 stdout F a\nb", 17,
+                                   beg, end);
+        TEST_CHECK(ret == FLB_PARSER_NATIVE_FALLBACK);
+    }
+
+    /* other patterns use the regex engine */
+    parser = flb_parser_get("apache_error", config);
+    TEST_CHECK(parser != NULL && parser->native == 0);
+
+    flb_config_exit(config);
+}
 
 TEST_LIST = {
     { "basic", test_basic},
@@ -487,5 +878,8 @@ TEST_LIST = {
     { "time_keep", test_time_keep},
     { "types", test_types},
     { "decode_field_json", test_decode_field_json},
+    { "literal_prefilter", test_literal_prefilter},
+    { "parsers_conf", test_parsers_conf},
+    { "native", test_native},
     { 0 }
 };
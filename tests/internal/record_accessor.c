@@ -26,6 +26,7 @@
 #include <fluent-bit/flb_sds.h>
 #include <fluent-bit/flb_sds_list.h>
 #include <fluent-bit/flb_record_accessor.h>
+#include <fluent-bit/flb_time.h>
 #include <fluent-bit/record_accessor/flb_ra_parser.h>
 #include <msgpack.h>
 
@@ -1702,6 +1703,200 @@ void cb_issue_7330_single_char()
     }
 }
 
+/* Resolve several keys with a single walk, compare with flb_ra_get_kv_pair() */
+static void cb_key_set()
+{
+    int i;
+    int j;
+    int ret;
+    int id;
+    int found;
+    int expected;
+    char *out_buf = NULL;
+    char *json;
+    msgpack_object map;
+    msgpack_unpacked result;
+    msgpack_object *start_key;
+    msgpack_object *out_key;
+    msgpack_object *out_val;
+    struct flb_ra_kv kv[FLB_RA_KEY_SET_MAX];
+    struct flb_ra_key_set set;
+    struct flb_record_accessor *ra[16];
+    char *patterns[] = {
+        "$a", "$b", "$dup", "$c['d']", "$c['missing']", "$k[2]['x']",
+        "$k[9]", "$a['not_a_map']", "$missing", "$dup",
+        "$a_very_long_key_name_used_to_check_keys_past_the_length_index_x",
+        "$a_very_long_key_name_used_to_check_keys_past_the_length_index_y",
+        "$", "$e", NULL
+    };
+
+    json =
+        "{\"a\": 1, \"b\": \"x\", \"dup\": 1, \"c\": {\"d\": [1, 2]},"
+        " \"k\": [0, 1, {\"x\": \"y\"}], \"dup\": 2, \"e\": null,"
+        " \"a_very_long_key_name_used_to_check_keys_past_the_length_index_y\": 3,"
+        " \"b\": \"last\"}";
+
+    ret = create_map(json, &map, &out_buf, &result);
+    if (!TEST_CHECK(ret == 0)) {
+        exit(EXIT_FAILURE);
+    }
+
+    flb_ra_key_set_init(&set);
+
+    for (i = 0; patterns[i] != NULL; i++) {
+        ra[i] = flb_ra_create(patterns[i], FLB_FALSE);
+        if (!TEST_CHECK(ra[i] != NULL)) {
+            TEST_MSG("cannot create record accessor %s", patterns[i]);
+            exit(EXIT_FAILURE);
+        }
+
+        id = flb_ra_key_set_add_ra(&set, ra[i]);
+        if (strcmp(patterns[i], "$") == 0) {
+            /* no key to resolve */
+            TEST_CHECK(id == -1);
+            continue;
+        }
+        TEST_CHECK(id == set.count - 1);
+    }
+
+    found = flb_ra_key_set_get(&set, map, kv);
+
+    expected = 0;
+    for (i = 0, id = 0; patterns[i] != NULL; i++) {
+        if (strcmp(patterns[i], "$") == 0) {
+            continue;
+        }
+
+        start_key = NULL;
+        out_key = NULL;
+        out_val = NULL;
+        ret = flb_ra_get_kv_pair(ra[i], map, &start_key, &out_key, &out_val);
+        if (ret == 0) {
+            expected++;
+            if (!TEST_CHECK(kv[id].start_key == start_key &&
+                            kv[id].key == out_key &&
+                            kv[id].val == out_val)) {
+                TEST_MSG("pattern %s resolved differently", patterns[i]);
+            }
+        }
+        else if (!TEST_CHECK(kv[id].key == NULL && kv[id].val == NULL)) {
+            TEST_MSG("pattern %s must not be resolved", patterns[i]);
+        }
+        id++;
+    }
+    TEST_CHECK(found == expected);
+    TEST_CHECK(found == 9);
+
+    /* the last entry wins for duplicated keys */
+    TEST_CHECK(kv[1].val->type == MSGPACK_OBJECT_STR &&
+               kv[1].val->via.str.size == 4);
+    TEST_CHECK(kv[2].val->via.u64 == 2 && kv[9].val->via.u64 == 2);
+
+    /* not a map */
+    found = flb_ra_key_set_get(&set, map.via.map.ptr[0].val, kv);
+    TEST_CHECK(found == 0);
+    for (j = 0; j < set.count; j++) {
+        TEST_CHECK(kv[j].key == NULL && kv[j].val == NULL);
+    }
+
+    /* the set is full */
+    for (j = set.count; j < FLB_RA_KEY_SET_MAX; j++) {
+        TEST_CHECK(flb_ra_key_set_add_ra(&set, ra[0]) == j);
+    }
+    TEST_CHECK(flb_ra_key_set_add_ra(&set, ra[0]) == -1);
+    found = flb_ra_key_set_get(&set, map, kv);
+    TEST_CHECK(found == 9 + FLB_RA_KEY_SET_MAX - 13);
+    TEST_CHECK(kv[FLB_RA_KEY_SET_MAX - 1].val == kv[0].val);
+
+    for (i = 0; patterns[i] != NULL; i++) {
+        flb_ra_destroy(ra[i]);
+    }
+    msgpack_unpacked_destroy(&result);
+    flb_free(out_buf);
+}
+
+/*
+ * Resolve 8 keys of a 32 entries map, one accessor at the time and with a
+ * key set, set FLB_RA_BENCH to the number of iterations to run it.
+ */
+static void cb_key_set_bench()
+{
+    int i;
+    int n;
+    int ret;
+    int iterations;
+    char *env;
+    char *out_buf = NULL;
+    double t_single;
+    double t_set;
+    flb_sds_t json;
+    msgpack_object map;
+    msgpack_unpacked result;
+    msgpack_object *start_key;
+    msgpack_object *out_key;
+    msgpack_object *out_val;
+    struct flb_time t0;
+    struct flb_time t1;
+    struct flb_time diff;
+    struct flb_ra_kv kv[FLB_RA_KEY_SET_MAX];
+    struct flb_ra_key_set set;
+    struct flb_record_accessor *ra[8];
+    char pattern[32];
+
+    env = getenv("FLB_RA_BENCH");
+    if (!env) {
+        return;
+    }
+    iterations = atoi(env);
+
+    json = flb_sds_create("{");
+    for (i = 0; i < 32; i++) {
+        flb_sds_printf(&json, "%s\"field_%02d\": %d", i ? ", " : "", i, i);
+    }
+    flb_sds_cat_safe(&json, "}", 1);
+
+    ret = create_map(json, &map, &out_buf, &result);
+    if (!TEST_CHECK(ret == 0)) {
+        exit(EXIT_FAILURE);
+    }
+
+    flb_ra_key_set_init(&set);
+    for (i = 0; i < 8; i++) {
+        snprintf(pattern, sizeof(pattern) - 1, "$field_%02d", i * 4);
+        ra[i] = flb_ra_create(pattern, FLB_FALSE);
+        TEST_CHECK(ra[i] != NULL);
+        flb_ra_key_set_add_ra(&set, ra[i]);
+    }
+
+    flb_time_get(&t0);
+    for (n = 0; n < iterations; n++) {
+        for (i = 0; i < 8; i++) {
+            flb_ra_get_kv_pair(ra[i], map, &start_key, &out_key, &out_val);
+        }
+    }
+    flb_time_get(&t1);
+    flb_time_diff(&t1, &t0, &diff);
+    t_single = flb_time_to_double(&diff);
+
+    flb_time_get(&t0);
+    for (n = 0; n < iterations; n++) {
+        flb_ra_key_set_get(&set, map, kv);
+    }
+    flb_time_get(&t1);
+    flb_time_diff(&t1, &t0, &diff);
+    t_set = flb_time_to_double(&diff);
+
+    printf("\n%-16s %.3fs\n%-16s %.3fs\n",
+           "kv_pair", t_single, "key_set", t_set);
+
+    for (i = 0; i < 8; i++) {
+        flb_ra_destroy(ra[i]);
+    }
+    msgpack_unpacked_destroy(&result);
+    flb_free(out_buf);
+    flb_sds_destroy(json);
+}
+
 TEST_LIST = {
     { "keys"            , cb_keys},
     { "dash_key"        , cb_dash_key},
@@ -1727,5 +1922,7 @@ TEST_LIST = {
     { "issue_5936_last_array"      , cb_issue_5936_last_array},
     { "ra_create_str_from_list", cb_ra_create_str_from_list},
     { "issue_7330_single_character"  , cb_issue_7330_single_char},
+    { "key_set"         , cb_key_set},
+    { "key_set_bench"   , cb_key_set_bench},
     { NULL }
 };
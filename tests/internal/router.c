@@ -1,7 +1,13 @@
 /* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
 
 #include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_config.h>
+#include <fluent-bit/flb_filter.h>
+#include <fluent-bit/flb_output.h>
 #include <fluent-bit/flb_router.h>
+#include <fluent-bit/flb_routes_mask.h>
+#include <cfl/cfl.h>
 
 #include "flb_tests_internal.h"
 
@@ -49,7 +55,465 @@ void test_router_wildcard()
     TEST_CHECK(ret == FLB_TRUE);
 }
 
+void test_router_compiled_rules()
+{
+    int i;
+    int ret;
+    int len;
+    int checks = 0;
+    struct check *c;
+    struct flb_router_rule rule;
+
+    checks = sizeof(route_checks) / sizeof(struct check);
+    for (i = 0; i < checks; i++) {
+        c = &route_checks[i];
+        len = strlen(c->tag);
+        flb_router_rule_compile(&rule, c->match, NULL);
+        ret = flb_router_rule_match(&rule, c->tag, len);
+        TEST_CHECK(ret == c->matched);
+        if (ret != c->matched) {
+            fprintf(stderr, "test %i failed: tag=%s match=%s expected_to_match=%s\n",
+                    i, c->tag, c->match, c->matched ? "YES": "NO");
+        }
+    }
+
+    /* rule types */
+    flb_router_rule_compile(&rule, "**", NULL);
+    TEST_CHECK(rule.type == FLB_ROUTER_RULE_ALL);
+
+    flb_router_rule_compile(&rule, "kube.**", NULL);
+    TEST_CHECK(rule.type == FLB_ROUTER_RULE_PREFIX);
+    TEST_CHECK(rule.literal_len == 5);
+    TEST_CHECK(flb_router_rule_match(&rule, "kube.", 5) == FLB_TRUE);
+    TEST_CHECK(flb_router_rule_match(&rule, "kub", 3) == FLB_FALSE);
+
+    flb_router_rule_compile(&rule, "*.log", NULL);
+    TEST_CHECK(rule.type == FLB_ROUTER_RULE_SUFFIX);
+    TEST_CHECK(flb_router_rule_match(&rule, ".log", 4) == FLB_TRUE);
+    TEST_CHECK(flb_router_rule_match(&rule, "app.log.1", 9) == FLB_FALSE);
+
+    flb_router_rule_compile(&rule, "a*b*c", NULL);
+    TEST_CHECK(rule.type == FLB_ROUTER_RULE_WILDCARD);
+    TEST_CHECK(flb_router_rule_match(&rule, "axxbyyc", 7) == FLB_TRUE);
+    TEST_CHECK(flb_router_rule_match(&rule, "axxbyyd", 7) == FLB_FALSE);
+
+    flb_router_rule_compile(&rule, NULL, NULL);
+    TEST_CHECK(rule.type == FLB_ROUTER_RULE_NONE);
+    TEST_CHECK(flb_router_rule_match(&rule, "test", 4) == FLB_FALSE);
+
+    /* the tag length is honored, not the NULL byte */
+    flb_router_rule_compile(&rule, "aaa", NULL);
+    TEST_CHECK(flb_router_rule_match(&rule, "aaaX", 3) == FLB_TRUE);
+}
+
+/*
+ * Set, check and clear every route of a mask sized for the given number of
+ * outputs.
+ */
+static void routes_mask_check(int outputs)
+{
+    int i;
+    struct flb_config *config;
+    flb_route_mask_element *mask;
+
+    config = flb_calloc(1, sizeof(struct flb_config));
+    TEST_CHECK(config != NULL);
+    if (!config) {
+        return;
+    }
+
+    flb_routes_mask_set_size(config, outputs);
+    TEST_CHECK(flb_routes_mask_get_size(config) * FLB_ROUTES_MASK_ELEMENT_BITS >=
+               outputs);
+
+    mask = flb_routes_mask_create(config);
+    TEST_CHECK(mask != NULL);
+    if (!mask) {
+        flb_free(config);
+        return;
+    }
+    TEST_CHECK(flb_routes_mask_is_empty(mask, config) == FLB_TRUE);
+
+    /* the last route is the one more likely to be out of bounds */
+    flb_routes_mask_set_bit(mask, outputs - 1, config);
+    TEST_CHECK(flb_routes_mask_get_bit(mask, outputs - 1, config) != 0);
+    TEST_CHECK(flb_routes_mask_is_empty(mask, config) == FLB_FALSE);
+    flb_routes_mask_clear_bit(mask, outputs - 1, config);
+    TEST_CHECK(flb_routes_mask_is_empty(mask, config) == FLB_TRUE);
+
+    for (i = 0; i < outputs; i++) {
+        flb_routes_mask_set_bit(mask, i, config);
+        if (!TEST_CHECK(flb_routes_mask_get_bit(mask, i, config) != 0)) {
+            TEST_MSG("route %i of %i is not set", i, outputs);
+        }
+    }
+    TEST_CHECK(flb_routes_mask_is_empty(mask, config) == FLB_FALSE);
+
+    for (i = 0; i < outputs; i++) {
+        flb_routes_mask_clear_bit(mask, i, config);
+        if (!TEST_CHECK(flb_routes_mask_get_bit(mask, i, config) == 0)) {
+            TEST_MSG("route %i of %i is not cleared", i, outputs);
+        }
+    }
+    TEST_CHECK(flb_routes_mask_is_empty(mask, config) == FLB_TRUE);
+
+    flb_routes_mask_destroy(mask);
+    flb_free(config);
+}
+
+void test_routes_mask()
+{
+    routes_mask_check(10);
+    routes_mask_check(256);
+    routes_mask_check(4096);
+}
+
+/* Report the cost of setting and clearing every route of a mask */
+static void routes_mask_bench(int outputs, int loops)
+{
+    int i;
+    int ret = FLB_TRUE;
+    int loop;
+    uint64_t ts_start;
+    uint64_t ts_end;
+    struct flb_config *config;
+    flb_route_mask_element *mask;
+
+    config = flb_calloc(1, sizeof(struct flb_config));
+    TEST_CHECK(config != NULL);
+    if (!config) {
+        return;
+    }
+    flb_routes_mask_set_size(config, outputs);
+
+    mask = flb_routes_mask_create(config);
+    TEST_CHECK(mask != NULL);
+    if (!mask) {
+        flb_free(config);
+        return;
+    }
+
+    ts_start = cfl_time_now();
+    for (loop = 0; loop < loops; loop++) {
+        for (i = 0; i < outputs; i++) {
+            flb_routes_mask_set_bit(mask, i, config);
+        }
+        ret = flb_routes_mask_is_empty(mask, config);
+        for (i = 0; i < outputs; i++) {
+            flb_routes_mask_clear_bit(mask, i, config);
+        }
+    }
+    ts_end = cfl_time_now();
+
+    TEST_CHECK(ret == FLB_FALSE);
+
+    printf("\n[routes_mask] outputs=%i elements=%zu: %.2f ns per route set/clear",
+           outputs, flb_routes_mask_get_size(config),
+           (double) (ts_end - ts_start) / ((double) loops * outputs));
+
+    flb_routes_mask_destroy(mask);
+    flb_free(config);
+}
+
+/*
+ * Set FLB_ROUTER_BENCH to a number of loops to report the cost of the routes
+ * mask operations with 10, 256 and 4096 outputs.
+ */
+void test_routes_mask_bench()
+{
+    int loops;
+    char *env;
+
+    env = getenv("FLB_ROUTER_BENCH");
+    if (!env || (loops = atoi(env)) <= 0) {
+        return;
+    }
+
+    routes_mask_bench(10, loops);
+    routes_mask_bench(256, loops);
+    routes_mask_bench(4096, loops);
+    printf("\n");
+}
+
+/*
+ * Minimal pipeline for the routing table tests: only the fields read by
+ * flb_router_table_create() are set on the instances.
+ */
+struct router_test {
+    struct flb_config *config;
+    struct flb_filter_instance filters[2];
+    struct flb_output_instance outputs[2];
+};
+
+static int router_test_init(struct router_test *ctx)
+{
+    int i;
+
+    memset(ctx, 0, sizeof(struct router_test));
+    ctx->config = flb_calloc(1, sizeof(struct flb_config));
+    if (!TEST_CHECK(ctx->config != NULL)) {
+        return -1;
+    }
+    mk_list_init(&ctx->config->filters);
+    mk_list_init(&ctx->config->outputs);
+    flb_routes_mask_set_size(ctx->config, 2);
+
+    ctx->filters[0].match = "app.*";
+    ctx->filters[1].match = "*.log";
+    for (i = 0; i < 2; i++) {
+        mk_list_add(&ctx->filters[i]._head, &ctx->config->filters);
+    }
+
+    ctx->outputs[0].id = 0;
+    ctx->outputs[0].match = "app.*";
+    ctx->outputs[1].id = 1;
+    ctx->outputs[1].match = "sys.*";
+    for (i = 0; i < 2; i++) {
+        mk_list_add(&ctx->outputs[i]._head, &ctx->config->outputs);
+    }
+
+    return 0;
+}
+
+static void router_test_exit(struct router_test *ctx)
+{
+    flb_free(ctx->config);
+}
+
+void test_router_cache_hit_miss()
+{
+    struct router_test ctx;
+    struct flb_router_table *table;
+    struct flb_router_route *route;
+    struct flb_router_route *again;
+
+    if (router_test_init(&ctx) != 0) {
+        return;
+    }
+
+    table = flb_router_table_create(ctx.config, 4);
+    TEST_CHECK(table != NULL);
+    if (!table) {
+        router_test_exit(&ctx);
+        return;
+    }
+    TEST_CHECK(table->filters_size == 2);
+    TEST_CHECK(table->outputs_size == 2);
+
+    /* first lookup resolves the route against the rules */
+    route = flb_router_route_get(table, "app.log", 7);
+    TEST_CHECK(route != NULL);
+    TEST_CHECK(table->misses == 1 && table->hits == 0);
+    TEST_CHECK(route->cached == FLB_TRUE);
+    TEST_CHECK(route->users == 1);
+    TEST_CHECK(route->filters_size == 2);
+    TEST_CHECK(route->has_routes == FLB_TRUE);
+    TEST_CHECK(flb_routes_mask_get_bit(route->routes_mask, 0, ctx.config) != 0);
+    TEST_CHECK(flb_routes_mask_get_bit(route->routes_mask, 1, ctx.config) == 0);
+    flb_router_route_put(table, route);
+    TEST_CHECK(route->users == 0);
+
+    /* the same tag is served from the cache */
+    again = flb_router_route_get(table, "app.log", 7);
+    TEST_CHECK(again == route);
+    TEST_CHECK(table->misses == 1 && table->hits == 1);
+    TEST_CHECK(again->users == 1);
+    flb_router_route_put(table, again);
+
+    /* only the tag length is used for the lookup */
+    route = flb_router_route_get(table, "app.logX", 7);
+    TEST_CHECK(route == again);
+    TEST_CHECK(table->hits == 2);
+    flb_router_route_put(table, route);
+
+    /* a tag without outputs is cached as well */
+    route = flb_router_route_get(table, "other", 5);
+    TEST_CHECK(route != NULL);
+    TEST_CHECK(table->misses == 2);
+    TEST_CHECK(route->cached == FLB_TRUE);
+    TEST_CHECK(route->has_routes == FLB_FALSE);
+    TEST_CHECK(route->filters_size == 0);
+    flb_router_route_put(table, route);
+    TEST_CHECK(table->routes_count == 2);
+
+    flb_router_table_destroy(table);
+    router_test_exit(&ctx);
+}
+
+void test_router_cache_evict()
+{
+    struct router_test ctx;
+    struct flb_router_table *table;
+    struct flb_router_route *held;
+    struct flb_router_route *route;
+    struct flb_router_route *second;
+
+    if (router_test_init(&ctx) != 0) {
+        return;
+    }
+
+    table = flb_router_table_create(ctx.config, 2);
+    TEST_CHECK(table != NULL);
+    if (!table) {
+        router_test_exit(&ctx);
+        return;
+    }
+
+    /* the oldest route is kept in use */
+    held = flb_router_route_get(table, "app.a", 5);
+    second = flb_router_route_get(table, "app.b", 5);
+    TEST_CHECK(held != NULL && second != NULL);
+    flb_router_route_put(table, second);
+    TEST_CHECK(table->routes_count == 2);
+
+    /* the cache is full: the unused route is evicted, not the held one */
+    route = flb_router_route_get(table, "app.c", 5);
+    TEST_CHECK(route != NULL);
+    TEST_CHECK(route->cached == FLB_TRUE);
+    TEST_CHECK(table->routes_count == 2);
+    flb_router_route_put(table, route);
+
+    TEST_CHECK(held->users == 1);
+    TEST_CHECK(flb_router_route_get(table, "app.a", 5) == held);
+    TEST_CHECK(held->users == 2);
+    flb_router_route_put(table, held);
+    TEST_CHECK(table->hits == 1);
+
+    /* the evicted tag is resolved again */
+    route = flb_router_route_get(table, "app.b", 5);
+    TEST_CHECK(route != NULL);
+    TEST_CHECK(table->misses == 4);
+    TEST_CHECK(route->cached == FLB_TRUE);
+    flb_router_route_put(table, route);
+
+    flb_router_route_put(table, held);
+    TEST_CHECK(held->users == 0);
+    TEST_CHECK(table->routes_count == 2);
+
+    flb_router_table_destroy(table);
+    router_test_exit(&ctx);
+}
+
+void test_router_cache_uncached()
+{
+    int users;
+    struct router_test ctx;
+    struct flb_router_table *table;
+    struct flb_router_route *a;
+    struct flb_router_route *b;
+    struct flb_router_route *route;
+
+    if (router_test_init(&ctx) != 0) {
+        return;
+    }
+
+    table = flb_router_table_create(ctx.config, 2);
+    TEST_CHECK(table != NULL);
+    if (!table) {
+        router_test_exit(&ctx);
+        return;
+    }
+
+    /* every cached route is in use */
+    a = flb_router_route_get(table, "app.a", 5);
+    b = flb_router_route_get(table, "sys.b", 5);
+    TEST_CHECK(a != NULL && b != NULL);
+
+    /* the new route is resolved but not cached */
+    route = flb_router_route_get(table, "sys.c", 5);
+    TEST_CHECK(route != NULL);
+    TEST_CHECK(route->cached == FLB_FALSE);
+    TEST_CHECK(route->users == 1);
+    TEST_CHECK(route->has_routes == FLB_TRUE);
+    TEST_CHECK(flb_routes_mask_get_bit(route->routes_mask, 1, ctx.config) != 0);
+    TEST_CHECK(table->routes_count == 2);
+
+    /* the cached routes are untouched */
+    users = a->users + b->users;
+    TEST_CHECK(users == 2);
+
+    /* releasing the last reference frees it (checked by the leak detector) */
+    flb_router_route_put(table, route);
+
+    /* a second lookup of the same tag is a miss again */
+    route = flb_router_route_get(table, "sys.c", 5);
+    TEST_CHECK(route != NULL);
+    TEST_CHECK(route->cached == FLB_FALSE);
+    TEST_CHECK(table->misses == 4);
+    TEST_CHECK(table->hits == 0);
+    flb_router_route_put(table, route);
+
+    /* cached routes are not freed when they become unused */
+    flb_router_route_put(table, a);
+    flb_router_route_put(table, b);
+    TEST_CHECK(table->routes_count == 2);
+    TEST_CHECK(flb_router_route_get(table, "app.a", 5) == a);
+    flb_router_route_put(table, a);
+
+    flb_router_table_destroy(table);
+    router_test_exit(&ctx);
+}
+
+void test_router_cache_rebuild()
+{
+    struct router_test ctx;
+    struct flb_router_table *table;
+    struct flb_router_route *route;
+
+    if (router_test_init(&ctx) != 0) {
+        return;
+    }
+
+    table = flb_router_table_create(ctx.config, 4);
+    TEST_CHECK(table != NULL);
+    if (!table) {
+        router_test_exit(&ctx);
+        return;
+    }
+
+    route = flb_router_route_get(table, "sys.log", 7);
+    TEST_CHECK(route != NULL);
+    TEST_CHECK(flb_routes_mask_get_bit(route->routes_mask, 0, ctx.config) == 0);
+    TEST_CHECK(flb_routes_mask_get_bit(route->routes_mask, 1, ctx.config) != 0);
+    TEST_CHECK(route->filters_size == 1);
+    flb_router_route_put(table, route);
+
+    /* the pipeline changes, the table is re-created as flb_router_io_set() does */
+    flb_router_table_destroy(table);
+    ctx.outputs[0].match = "*";
+    mk_list_del(&ctx.filters[1]._head);
+
+    table = flb_router_table_create(ctx.config, 4);
+    TEST_CHECK(table != NULL);
+    if (!table) {
+        router_test_exit(&ctx);
+        return;
+    }
+    TEST_CHECK(table->filters_size == 1);
+    TEST_CHECK(table->routes_count == 0);
+    TEST_CHECK(table->hits == 0 && table->misses == 0);
+
+    /* nothing is carried over from the previous table */
+    route = flb_router_route_get(table, "sys.log", 7);
+    TEST_CHECK(route != NULL);
+    TEST_CHECK(table->misses == 1 && table->hits == 0);
+    TEST_CHECK(flb_routes_mask_get_bit(route->routes_mask, 0, ctx.config) != 0);
+    TEST_CHECK(flb_routes_mask_get_bit(route->routes_mask, 1, ctx.config) != 0);
+    TEST_CHECK(route->filters_size == 0);
+    flb_router_route_put(table, route);
+
+    flb_router_table_destroy(table);
+    router_test_exit(&ctx);
+}
+
 TEST_LIST = {
     { "wildcard", test_router_wildcard},
+    { "compiled_rules", test_router_compiled_rules},
+    { "routes_mask", test_routes_mask},
+    { "routes_mask_bench", test_routes_mask_bench},
+    { "cache_hit_miss", test_router_cache_hit_miss},
+    { "cache_evict", test_router_cache_evict},
+    { "cache_uncached", test_router_cache_uncached},
+    { "cache_rebuild", test_router_cache_rebuild},
     { 0 }
 };
@@ -0,0 +1,260 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_config.h>
+#include <fluent-bit/flb_engine_macros.h>
+#include <fluent-bit/flb_scheduler.h>
+#include <fluent-bit/flb_time.h>
+#include <cfl/cfl_time.h>
+
+#include "flb_tests_internal.h"
+
+struct sched_test {
+    struct flb_config *config;
+    struct mk_event_loop *evl;
+    struct flb_sched *sched;
+};
+
+static int fired_count;
+
+static void cb_count(struct flb_config *config, void *data)
+{
+    fired_count++;
+}
+
+static int sched_test_init(struct sched_test *ctx)
+{
+    ctx->config = flb_config_init();
+    if (!TEST_CHECK(ctx->config != NULL)) {
+        return -1;
+    }
+
+    ctx->evl = mk_event_loop_create(32);
+    if (!TEST_CHECK(ctx->evl != NULL)) {
+        flb_config_exit(ctx->config);
+        return -1;
+    }
+
+    ctx->sched = flb_sched_create(ctx->config, ctx->evl);
+    if (!TEST_CHECK(ctx->sched != NULL)) {
+        mk_event_loop_destroy(ctx->evl);
+        flb_config_exit(ctx->config);
+        return -1;
+    }
+
+    fired_count = 0;
+    return 0;
+}
+
+static void sched_test_exit(struct sched_test *ctx)
+{
+    flb_sched_destroy(ctx->sched);
+    mk_event_loop_destroy(ctx->evl);
+    flb_config_exit(ctx->config);
+}
+
+/* Run the event loop for 'ms' milliseconds or until 'count' timers fired */
+static void sched_test_run(struct sched_test *ctx, int ms, int count)
+{
+    uint64_t end;
+    struct mk_event *event;
+
+    end = cfl_time_now() + ((uint64_t) ms * 1000000);
+
+    while (cfl_time_now() < end && fired_count < count) {
+        mk_event_wait_2(ctx->evl, 50);
+        mk_event_foreach(event, ctx->evl) {
+            if (event->type & FLB_ENGINE_EV_SCHED) {
+                flb_sched_event_handler(ctx->config, event);
+            }
+        }
+        flb_sched_timer_cleanup(ctx->sched);
+    }
+}
+
+void test_frame_idle()
+{
+    struct sched_test ctx;
+
+    if (sched_test_init(&ctx) != 0) {
+        return;
+    }
+
+    /* without armed timers the event loop is never woken up */
+    TEST_CHECK(ctx.sched->frame_armed == FLB_FALSE);
+    sched_test_run(&ctx, 300, 1);
+    TEST_CHECK(ctx.sched->frame_armed == FLB_FALSE);
+
+    sched_test_exit(&ctx);
+}
+
+void test_frame_oneshot()
+{
+    int ret;
+    uint64_t start;
+    uint64_t elapsed;
+    struct sched_test ctx;
+
+    if (sched_test_init(&ctx) != 0) {
+        return;
+    }
+
+    start = cfl_time_now();
+    ret = flb_sched_timer_cb_create(ctx.sched, FLB_SCHED_TIMER_CB_ONESHOT, 300,
+                                    cb_count, NULL, NULL);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(ctx.sched->frame_armed == FLB_TRUE);
+
+    sched_test_run(&ctx, 2000, 1);
+    elapsed = (cfl_time_now() - start) / 1000000;
+
+    TEST_CHECK(fired_count == 1);
+    TEST_CHECK_(elapsed >= 300 && elapsed < 1000,
+                "timer fired after %lu ms", (unsigned long) elapsed);
+
+    /* the wheel is empty again, so is the frame timer */
+    TEST_CHECK(flb_sched_timers_armed(ctx.sched) == 0);
+    TEST_CHECK(ctx.sched->frame_armed == FLB_FALSE);
+
+    sched_test_exit(&ctx);
+}
+
+void test_frame_rearm()
+{
+    int ret;
+    uint64_t far_tick;
+    struct sched_test ctx;
+    struct flb_sched_timer *far;
+    struct flb_sched_timer *near;
+
+    if (sched_test_init(&ctx) != 0) {
+        return;
+    }
+
+    ret = flb_sched_timer_cb_create(ctx.sched, FLB_SCHED_TIMER_CB_ONESHOT, 60000,
+                                    cb_count, NULL, &far);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(ctx.sched->frame_armed == FLB_TRUE);
+    far_tick = ctx.sched->frame_tick;
+
+    /* a closer timer moves the frame timer earlier */
+    ret = flb_sched_timer_cb_create(ctx.sched, FLB_SCHED_TIMER_CB_ONESHOT, 200,
+                                    cb_count, NULL, &near);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(ctx.sched->frame_tick < far_tick);
+
+    /* and back once it's removed */
+    flb_sched_timer_cb_disable(near);
+    flb_sched_timer_cb_destroy(near);
+    TEST_CHECK(ctx.sched->frame_tick <= far_tick);
+    TEST_CHECK(ctx.sched->frame_tick > ctx.sched->wheel.current + 2);
+
+    /* nothing fires in the meantime */
+    sched_test_run(&ctx, 400, 1);
+    TEST_CHECK(fired_count == 0);
+
+    flb_sched_timer_cb_disable(far);
+    TEST_CHECK(ctx.sched->frame_armed == FLB_FALSE);
+    flb_sched_timer_cb_destroy(far);
+
+    sched_test_exit(&ctx);
+}
+
+void test_frame_perm()
+{
+    int ret;
+    struct sched_test ctx;
+    struct flb_sched_timer *timer;
+
+    if (sched_test_init(&ctx) != 0) {
+        return;
+    }
+
+    ret = flb_sched_timer_cb_create(ctx.sched, FLB_SCHED_TIMER_CB_PERM, 100,
+                                    cb_count, NULL, &timer);
+    TEST_CHECK(ret == 0);
+
+    sched_test_run(&ctx, 2000, 3);
+    TEST_CHECK(fired_count == 3);
+
+    /* a permanent timer keeps the frame timer armed */
+    TEST_CHECK(ctx.sched->frame_armed == FLB_TRUE);
+
+    flb_sched_timer_cb_disable(timer);
+    TEST_CHECK(ctx.sched->frame_armed == FLB_FALSE);
+    flb_sched_timer_cb_destroy(timer);
+
+    sched_test_exit(&ctx);
+}
+
+void test_frame_fd_reuse()
+{
+    int ret;
+    int fd;
+    struct sched_test ctx;
+    struct flb_sched_timer *timer;
+
+    if (sched_test_init(&ctx) != 0) {
+        return;
+    }
+
+    ret = flb_sched_timer_cb_create(ctx.sched, FLB_SCHED_TIMER_CB_ONESHOT, 200,
+                                    cb_count, NULL, NULL);
+    TEST_CHECK(ret == 0);
+    fd = ctx.sched->frame_fd;
+
+    /* re-arming or firing the frame timer keeps the same descriptor */
+    ret = flb_sched_timer_cb_create(ctx.sched, FLB_SCHED_TIMER_CB_ONESHOT, 100,
+                                    cb_count, NULL, &timer);
+    TEST_CHECK(ret == 0);
+    flb_sched_timer_cb_disable(timer);
+    flb_sched_timer_cb_destroy(timer);
+
+    sched_test_run(&ctx, 2000, 1);
+    TEST_CHECK(fired_count == 1);
+#ifdef __linux__
+    TEST_CHECK(fd != -1 && ctx.sched->frame_fd == fd);
+#endif
+
+    sched_test_exit(&ctx);
+}
+
+void test_precise_timer()
+{
+    int ret;
+    uint64_t start;
+    uint64_t elapsed;
+    struct sched_test ctx;
+
+    if (sched_test_init(&ctx) != 0) {
+        return;
+    }
+
+    /* not a multiple of the wheel tick, it's kept off the wheel */
+    start = cfl_time_now();
+    ret = flb_sched_timer_cb_create(ctx.sched, FLB_SCHED_TIMER_CB_ONESHOT, 150,
+                                    cb_count, NULL, NULL);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(flb_sched_timers_armed(ctx.sched) == 0);
+    TEST_CHECK(ctx.sched->frame_armed == FLB_FALSE);
+
+    sched_test_run(&ctx, 2000, 1);
+    elapsed = (cfl_time_now() - start) / 1000000;
+
+    TEST_CHECK(fired_count == 1);
+    TEST_CHECK_(elapsed >= 150 && elapsed < 250,
+                "timer fired after %lu ms", (unsigned long) elapsed);
+
+    sched_test_exit(&ctx);
+}
+
+TEST_LIST = {
+    {"frame_idle"   , test_frame_idle},
+    {"frame_oneshot", test_frame_oneshot},
+    {"frame_rearm"  , test_frame_rearm},
+    {"frame_perm"   , test_frame_perm},
+    {"frame_fd_reuse", test_frame_fd_reuse},
+    {"precise_timer", test_precise_timer},
+    { 0 }
+};
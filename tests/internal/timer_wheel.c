@@ -0,0 +1,217 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+#include <fluent-bit/flb_info.h>
+#include <fluent-bit/flb_mem.h>
+#include <fluent-bit/flb_timer_wheel.h>
+#include <monkey/mk_core/mk_list.h>
+
+#include "flb_tests_internal.h"
+
+struct wheel_test_entry {
+    int id;
+    struct flb_timer_wheel_entry entry;
+};
+
+/* Advance the wheel up to 'tick' and return the number of expired entries */
+static int wheel_run(struct flb_timer_wheel *wheel, uint64_t tick,
+                     int *fired, int fired_size)
+{
+    int c = 0;
+    struct mk_list *tmp;
+    struct mk_list *head;
+    struct mk_list expired;
+    struct wheel_test_entry *t;
+
+    mk_list_init(&expired);
+    flb_timer_wheel_expire(wheel, tick, &expired);
+
+    mk_list_foreach_safe(head, tmp, &expired) {
+        t = mk_list_entry(head, struct wheel_test_entry, entry._head);
+        mk_list_del(&t->entry._head);
+        if (c < fired_size) {
+            fired[c] = t->id;
+        }
+        c++;
+    }
+
+    return c;
+}
+
+void test_expire_order()
+{
+    int i;
+    int ret;
+    int fired[4];
+    uint64_t tick;
+    struct flb_timer_wheel wheel;
+    struct wheel_test_entry entries[4];
+    uint64_t delays[] = {0, 63, 64, 5000};
+
+    flb_timer_wheel_init(&wheel);
+
+    for (i = 0; i < 4; i++) {
+        entries[i].id = i;
+        flb_timer_wheel_entry_init(&entries[i].entry);
+        flb_timer_wheel_add(&wheel, &entries[i].entry, delays[i]);
+    }
+    TEST_CHECK(flb_timer_wheel_armed(&wheel) == 4);
+
+    /* every entry must fire exactly on its tick */
+    for (tick = 0; tick <= 5000; tick++) {
+        ret = wheel_run(&wheel, tick, fired, 4);
+        for (i = 0; i < 4; i++) {
+            if (delays[i] == tick) {
+                TEST_CHECK(ret == 1);
+                TEST_MSG("tick %lu expired %i entries", (unsigned long) tick, ret);
+                TEST_CHECK(fired[0] == i);
+                break;
+            }
+        }
+        if (i == 4) {
+            TEST_CHECK(ret == 0);
+            TEST_MSG("tick %lu expired %i entries", (unsigned long) tick, ret);
+        }
+    }
+
+    TEST_CHECK(flb_timer_wheel_armed(&wheel) == 0);
+}
+
+void test_cancel()
+{
+    int ret;
+    int fired[2];
+    struct flb_timer_wheel wheel;
+    struct wheel_test_entry a;
+    struct wheel_test_entry b;
+
+    flb_timer_wheel_init(&wheel);
+
+    a.id = 1;
+    b.id = 2;
+    flb_timer_wheel_entry_init(&a.entry);
+    flb_timer_wheel_entry_init(&b.entry);
+
+    flb_timer_wheel_add(&wheel, &a.entry, 10);
+    flb_timer_wheel_add(&wheel, &b.entry, 100000);
+    TEST_CHECK(flb_timer_wheel_armed(&wheel) == 2);
+
+    flb_timer_wheel_del(&wheel, &b.entry);
+    TEST_CHECK(flb_timer_wheel_armed(&wheel) == 1);
+
+    /* deleting twice is harmless */
+    flb_timer_wheel_del(&wheel, &b.entry);
+    TEST_CHECK(flb_timer_wheel_armed(&wheel) == 1);
+
+    /* re-arming moves the entry */
+    flb_timer_wheel_add(&wheel, &a.entry, 20);
+    TEST_CHECK(flb_timer_wheel_armed(&wheel) == 1);
+
+    ret = wheel_run(&wheel, 10, fired, 2);
+    TEST_CHECK(ret == 0);
+
+    ret = wheel_run(&wheel, 200000, fired, 2);
+    TEST_CHECK(ret == 1);
+    TEST_CHECK(fired[0] == 1);
+    TEST_CHECK(flb_timer_wheel_armed(&wheel) == 0);
+}
+
+void test_jump()
+{
+    int ret;
+    int fired[2];
+    struct flb_timer_wheel wheel;
+    struct wheel_test_entry a;
+    struct wheel_test_entry b;
+
+    flb_timer_wheel_init(&wheel);
+
+    a.id = 1;
+    b.id = 2;
+    flb_timer_wheel_entry_init(&a.entry);
+    flb_timer_wheel_entry_init(&b.entry);
+
+    /* idle wheel jumps straight to the target tick */
+    ret = wheel_run(&wheel, 1000000, fired, 2);
+    TEST_CHECK(ret == 0);
+    TEST_CHECK(wheel.current == 1000001);
+
+    flb_timer_wheel_add(&wheel, &a.entry, 300000);
+    flb_timer_wheel_add(&wheel, &b.entry, FLB_TIMER_WHEEL_MAX_TICKS + 100);
+
+    /* an advance of several ticks at once expires everything due */
+    ret = wheel_run(&wheel, wheel.current + 299999, fired, 2);
+    TEST_CHECK(ret == 0);
+    ret = wheel_run(&wheel, wheel.current, fired, 2);
+    TEST_CHECK(ret == 1);
+    TEST_CHECK(fired[0] == 1);
+
+    /* longer timeouts are truncated to the wheel range */
+    TEST_CHECK(b.entry.expires == 1000001 + FLB_TIMER_WHEEL_MAX_TICKS);
+    ret = wheel_run(&wheel, b.entry.expires, fired, 2);
+    TEST_CHECK(ret == 1);
+    TEST_CHECK(fired[0] == 2);
+}
+
+void test_next()
+{
+    int i;
+    int ret;
+    int fired[3];
+    uint64_t tick;
+    struct flb_timer_wheel wheel;
+    struct wheel_test_entry entries[3];
+    uint64_t delays[] = {5, 70, 5000};
+
+    /*
+     * For every step: the tick reported by flb_timer_wheel_next() and the
+     * number of entries that expire when the wheel is advanced to it. Upper
+     * level entries report the tick where their slot is cascaded.
+     */
+    uint64_t steps[][2] = {
+        {5, 1}, {64, 0}, {70, 1}, {4096, 0}, {4992, 0}, {5000, 1}
+    };
+
+    flb_timer_wheel_init(&wheel);
+
+    ret = flb_timer_wheel_next(&wheel, &tick);
+    TEST_CHECK(ret == -1);
+
+    for (i = 0; i < 3; i++) {
+        entries[i].id = i;
+        flb_timer_wheel_entry_init(&entries[i].entry);
+        flb_timer_wheel_add(&wheel, &entries[i].entry, delays[i]);
+    }
+
+    for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        ret = flb_timer_wheel_next(&wheel, &tick);
+        TEST_CHECK(ret == 0);
+        TEST_CHECK_(tick == steps[i][0], "step %i: expected tick %lu, got %lu",
+                    i, (unsigned long) steps[i][0], (unsigned long) tick);
+
+        ret = wheel_run(&wheel, tick, fired, 3);
+        TEST_CHECK(ret == steps[i][1]);
+    }
+
+    ret = flb_timer_wheel_next(&wheel, &tick);
+    TEST_CHECK(ret == -1);
+
+    /* a closer entry armed later takes over */
+    flb_timer_wheel_add(&wheel, &entries[0].entry, 300);
+    flb_timer_wheel_add(&wheel, &entries[1].entry, 2);
+    ret = flb_timer_wheel_next(&wheel, &tick);
+    TEST_CHECK(ret == 0 && tick == wheel.current + 2);
+
+    /* and the next one is reported once it's cancelled */
+    flb_timer_wheel_del(&wheel, &entries[1].entry);
+    ret = flb_timer_wheel_next(&wheel, &tick);
+    TEST_CHECK(ret == 0 && tick <= entries[0].entry.expires);
+    TEST_CHECK(tick > wheel.current + 2);
+}
+
+TEST_LIST = {
+    {"expire_order", test_expire_order},
+    {"cancel"      , test_cancel},
+    {"jump"        , test_jump},
+    {"next"        , test_next},
+    { 0 }
+};
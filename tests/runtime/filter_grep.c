@@ -820,6 +820,98 @@ void flb_test_OR_exclude(void)
     flb_destroy(ctx);
 }
 
+/*
+ * Many rules on the same key: their literals are looked up with a single
+ * pass, the regex is only run for the rules that are not a plain literal.
+ */
+void flb_test_filter_grep_many_exclude(void)
+{
+    int i;
+    int j;
+    int ret;
+    int bytes;
+    char p[512];
+    flb_ctx_t *ctx;
+    int in_ffd;
+    int out_ffd;
+    int filter_ffd;
+    int got;
+    int n_loop = 64;
+    int not_used = 0;
+    struct flb_lib_out_cb cb_data;
+    char *records[] = {
+        /* excluded */
+        "{\"log\": \"Using deprecated option\", \"level\": \"info\"}",
+        "{\"log\": \"GET /healthz 200\", \"level\": \"info\"}",
+        "{\"log\": \"kube-probe/1.2 check\", \"level\": \"info\"}",
+        "{\"log\": \"timeout after 30s\", \"level\": \"info\"}",
+        "{\"log\": \"connection refused\", \"level\": \"info\"}",
+        "{\"log\": \"Using option\", \"level\": \"trace\"}",
+        /* included, the literal is there but the regex doesn't match */
+        "{\"log\": \"timeout after many seconds\", \"level\": \"info\"}",
+        "{\"log\": \"not a debug: line\", \"level\": \"info\"}",
+        "{\"log\": \"Using option\", \"level\": \"info\"}",
+        NULL
+    };
+
+    /* Prepare output callback with expected result */
+    cb_data.cb = cb_count_msgpack;
+    cb_data.data = &not_used;
+
+    ctx = flb_create();
+
+    in_ffd = flb_input(ctx, (char *) "lib", NULL);
+    TEST_CHECK(in_ffd >= 0);
+    flb_input_set(ctx, in_ffd, "tag", "test", NULL);
+
+    out_ffd = flb_output(ctx, (char *) "lib", &cb_data);
+    TEST_CHECK(out_ffd >= 0);
+    flb_output_set(ctx, out_ffd, "match", "test", NULL);
+
+    filter_ffd = flb_filter(ctx, (char *) "grep", NULL);
+    TEST_CHECK(filter_ffd >= 0);
+    ret = flb_filter_set(ctx, filter_ffd, "match", "*", NULL);
+    TEST_CHECK(ret == 0);
+    ret = flb_filter_set(ctx, filter_ffd,
+                         "Exclude", "log deprecated",
+                         "Exclude", "log healthz",
+                         "Exclude", "log kube-probe\\/1\\.2",
+                         "Exclude", "log ^debug:",
+                         "Exclude", "log timeout after \\d+s",
+                         "Exclude", "log connection (reset|refused)",
+                         "Exclude", "log warning",
+                         "Exclude", "level trace",
+                         NULL);
+    TEST_CHECK(ret == 0);
+
+    clear_output_num();
+
+    ret = flb_start(ctx);
+    if(!TEST_CHECK(ret == 0)) {
+        TEST_MSG("flb_start failed");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < n_loop; i++) {
+        for (j = 0; records[j] != NULL; j++) {
+            memset(p, '\0', sizeof(p));
+            snprintf(p, sizeof(p), "[%d, %s]", i, records[j]);
+            bytes = flb_lib_push(ctx, in_ffd, p, strlen(p));
+            TEST_CHECK(bytes == strlen(p));
+        }
+    }
+
+    flb_time_msleep(1500); /* waiting flush */
+
+    got = get_output_num();
+    if (!TEST_CHECK(got == 3 * n_loop)) {
+        TEST_MSG("expect: %d got: %d", 3 * n_loop, got);
+    }
+
+    flb_stop(ctx);
+    flb_destroy(ctx);
+}
+
 /* Test list */
 TEST_LIST = {
     {"regex",   flb_test_filter_grep_regex   },
@@ -827,6 +919,7 @@ TEST_LIST = {
     {"invalid", flb_test_filter_grep_invalid },
     {"multi_regex", flb_test_filter_grep_multi_regex },
     {"multi_exclude", flb_test_filter_grep_multi_exclude },
+    {"many_exclude", flb_test_filter_grep_many_exclude },
     {"unknown_property", flb_test_filter_grep_unknown_property },
     {"AND_regex", flb_test_AND_regex},
     {"OR_regex", flb_test_OR_regex},
@@ -1213,6 +1213,194 @@ void flb_test_skip_empty_lines_crlf()
     test_tail_ctx_destroy(ctx);
 }
 
+/* Write 'lines' records to 'fd', the last one without a new line if 'partial' */
+static int write_lines(int fd, int lines, int partial)
+{
+    int i;
+    int len;
+    ssize_t w_byte;
+    char buf[256];
+
+    for (i = 0; i < lines; i++) {
+        len = snprintf(buf, sizeof(buf),
+                       "line %08d lorem ipsum dolor sit amet consectetur%s",
+                       i, (partial && i == lines - 1) ? "" : NEW_LINE);
+        w_byte = write(fd, buf, len);
+        if (w_byte != len) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#ifdef __linux__
+void flb_test_read_mode_mmap()
+{
+    struct flb_lib_out_cb cb_data;
+    struct test_tail_ctx *ctx;
+    char *file[] = {"read_mode_mmap.log"};
+    int lines = 50000;
+    int ret;
+    int num;
+    int unused;
+
+    clear_output_num();
+
+    cb_data.cb = cb_count_msgpack;
+    cb_data.data = &unused;
+
+    ctx = test_tail_ctx_create(&cb_data, &file[0], sizeof(file)/sizeof(char *), FLB_TRUE);
+    if (!TEST_CHECK(ctx != NULL)) {
+        TEST_MSG("test_ctx_create failed");
+        exit(EXIT_FAILURE);
+    }
+
+    ret = flb_input_set(ctx->flb, ctx->o_ffd,
+                        "path", file[0],
+                        "read_from_head", "true",
+                        "read_mode", "mmap",
+                        NULL);
+    TEST_CHECK(ret == 0);
+
+    ret = flb_output_set(ctx->flb, ctx->o_ffd,
+                         NULL);
+    TEST_CHECK(ret == 0);
+
+    /* more than one mapping window, the last line is not complete */
+    ret = write_lines(ctx->fds[0], lines, FLB_TRUE);
+    if (!TEST_CHECK(ret == 0)) {
+        test_tail_ctx_destroy(ctx);
+        exit(EXIT_FAILURE);
+    }
+
+    /* a file open for writing cannot be leased, hence not mapped */
+    close(ctx->fds[0]);
+
+    /* Start the engine */
+    ret = flb_start(ctx->flb);
+    TEST_CHECK(ret == 0);
+
+    /* waiting to flush */
+    flb_time_msleep(1500);
+
+    num = get_output_num();
+    if (!TEST_CHECK(num == lines - 1))  {
+        TEST_MSG("output error: expect=%d got=%d", lines - 1, num);
+    }
+
+    /* complete the last line */
+    ctx->fds[0] = open(ctx->filepaths[0], O_WRONLY | O_APPEND);
+    TEST_CHECK(ctx->fds[0] != -1);
+    ret = write(ctx->fds[0], NEW_LINE, strlen(NEW_LINE));
+    TEST_CHECK(ret == strlen(NEW_LINE));
+
+    flb_time_msleep(1500);
+
+    num = get_output_num();
+    if (!TEST_CHECK(num == lines))  {
+        TEST_MSG("output error: expect=%d got=%d", lines, num);
+    }
+
+    test_tail_ctx_destroy(ctx);
+}
+#endif
+
+/*
+ * Static files throughput for every read mode. It's skipped unless the
+ * FLB_IN_TAIL_BENCH environment variable is set to the number of lines to
+ * write, e.g: FLB_IN_TAIL_BENCH=5000000.
+ */
+static void read_mode_benchmark(char *read_mode, int lines)
+{
+    struct flb_lib_out_cb cb_data;
+    struct test_tail_ctx *ctx;
+    struct flb_time start_time;
+    struct flb_time end_time;
+    struct flb_time diff_time;
+    char *file[] = {"read_mode_bench.log"};
+    double elapsed;
+    int ret;
+    int num;
+    int unused;
+
+    clear_output_num();
+
+    cb_data.cb = cb_count_msgpack;
+    cb_data.data = &unused;
+
+    ctx = test_tail_ctx_create(&cb_data, &file[0], sizeof(file)/sizeof(char *), FLB_TRUE);
+    if (!TEST_CHECK(ctx != NULL)) {
+        TEST_MSG("test_ctx_create failed");
+        exit(EXIT_FAILURE);
+    }
+
+    flb_service_set(ctx->flb, "Log_Level", "error", NULL);
+
+    ret = flb_input_set(ctx->flb, ctx->o_ffd,
+                        "path", file[0],
+                        "read_from_head", "true",
+                        "read_mode", read_mode,
+                        "mem_buf_limit", "512M",
+                        NULL);
+    TEST_CHECK(ret == 0);
+
+    ret = flb_output_set(ctx->flb, ctx->o_ffd,
+                         NULL);
+    TEST_CHECK(ret == 0);
+
+    ret = write_lines(ctx->fds[0], lines, FLB_FALSE);
+    if (!TEST_CHECK(ret == 0)) {
+        test_tail_ctx_destroy(ctx);
+        exit(EXIT_FAILURE);
+    }
+
+    /* let read_mode 'mmap' lease the file */
+    close(ctx->fds[0]);
+    ctx->fds[0] = -1;
+
+    flb_time_get(&start_time);
+
+    ret = flb_start(ctx->flb);
+    TEST_CHECK(ret == 0);
+
+    num = 0;
+    while (num < lines) {
+        flb_time_msleep(10);
+        num = get_output_num();
+    }
+
+    flb_time_get(&end_time);
+    flb_time_diff(&end_time, &start_time, &diff_time);
+    elapsed = flb_time_to_double(&diff_time);
+
+    printf("\nread_mode=%-4s lines=%d elapsed=%.3fs rate=%.0f lines/s",
+           read_mode, lines, elapsed, lines / elapsed);
+
+    test_tail_ctx_destroy(ctx);
+}
+
+void flb_test_read_mode_benchmark()
+{
+    int lines;
+    char *env;
+
+    env = getenv("FLB_IN_TAIL_BENCH");
+    if (env == NULL) {
+        return;
+    }
+
+    lines = atoi(env);
+    if (lines <= 0) {
+        lines = 1000000;
+    }
+
+    read_mode_benchmark("read", lines);
+#ifdef __linux__
+    read_mode_benchmark("mmap", lines);
+#endif
+}
+
 static int ignore_older(int expected, char *ignore_older)
 {
     struct flb_lib_out_cb cb_data;
@@ -1615,6 +1803,127 @@ void flb_test_db()
     unlink(db);
 }
 
+void flb_test_db_checkpoint()
+{
+    struct flb_lib_out_cb cb_data;
+    struct test_tail_ctx *ctx;
+    char *file[] = {"test_db_checkpoint.log"};
+    char *db = "test_db_checkpoint.db";
+    char *msg_init = "hello world";
+    char *msg = "hello checkpoint";
+    char *msg_end = "hello checkpoint end";
+    int i;
+    int ret;
+    int num;
+    int unused;
+
+    unlink(db);
+
+    clear_output_num();
+
+    cb_data.cb = cb_count_msgpack;
+    cb_data.data = &unused;
+
+    ctx = test_tail_ctx_create(&cb_data, &file[0], sizeof(file)/sizeof(char *), FLB_FALSE);
+    if (!TEST_CHECK(ctx != NULL)) {
+        TEST_MSG("test_ctx_create failed");
+        exit(EXIT_FAILURE);
+    }
+
+    ret = flb_input_set(ctx->flb, ctx->o_ffd,
+                        "path", file[0],
+                        "db", db,
+                        "db.checkpoint_interval", "1",
+                        NULL);
+    TEST_CHECK(ret == 0);
+
+    ret = flb_output_set(ctx->flb, ctx->o_ffd,
+                         NULL);
+    TEST_CHECK(ret == 0);
+
+    /* Start the engine */
+    ret = flb_start(ctx->flb);
+    TEST_CHECK(ret == 0);
+
+    ret = write_msg(ctx, msg_init, strlen(msg_init));
+    if (!TEST_CHECK(ret > 0)) {
+        test_tail_ctx_destroy(ctx);
+        unlink(db);
+        exit(EXIT_FAILURE);
+    }
+
+    /* waiting to flush */
+    flb_time_msleep(500);
+
+    num = get_output_num();
+    if (!TEST_CHECK(num > 0))  {
+        TEST_MSG("no output");
+    }
+
+    if (ctx->fds != NULL) {
+        for (i=0; i<ctx->fd_num; i++) {
+            close(ctx->fds[i]);
+        }
+        flb_free(ctx->fds);
+    }
+    flb_stop(ctx->flb);
+    flb_destroy(ctx->flb);
+    flb_free(ctx);
+
+    /* re-init, the offsets were stored on exit: 'hello world' is not read again */
+    clear_output_num();
+
+    cb_data.cb = cb_count_msgpack;
+    cb_data.data = &unused;
+
+    ctx = test_tail_ctx_create(&cb_data, &file[0], sizeof(file)/sizeof(char *), FLB_FALSE);
+    if (!TEST_CHECK(ctx != NULL)) {
+        TEST_MSG("test_ctx_create failed");
+        unlink(db);
+        exit(EXIT_FAILURE);
+    }
+
+    ret = flb_input_set(ctx->flb, ctx->o_ffd,
+                        "path", file[0],
+                        "db", db,
+                        "db.checkpoint_interval", "1",
+                        NULL);
+    TEST_CHECK(ret == 0);
+
+    ret = write_msg(ctx, msg, strlen(msg));
+    if (!TEST_CHECK(ret > 0)) {
+        test_tail_ctx_destroy(ctx);
+        unlink(db);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Start the engine */
+    ret = flb_start(ctx->flb);
+    TEST_CHECK(ret == 0);
+
+    /* waiting to flush */
+    flb_time_msleep(500);
+
+    ret = write_msg(ctx, msg_end, strlen(msg_end));
+    if (!TEST_CHECK(ret > 0)) {
+        test_tail_ctx_destroy(ctx);
+        unlink(db);
+        exit(EXIT_FAILURE);
+    }
+
+    /* waiting to flush */
+    flb_time_msleep(500);
+
+    num = get_output_num();
+    if (!TEST_CHECK(num == 2))  {
+        /* 2 = msg + msg_end */
+        TEST_MSG("num error. expect=2 got=%d", num);
+    }
+
+    test_tail_ctx_destroy(ctx);
+    unlink(db);
+}
+
 void flb_test_db_delete_stale_file()
 {
     struct flb_lib_out_cb cb_data;
@@ -1963,6 +2272,10 @@ TEST_LIST = {
     {"skip_empty_lines", flb_test_skip_empty_lines},
     {"skip_empty_lines_crlf", flb_test_skip_empty_lines_crlf},
     {"ignore_older", flb_test_ignore_older},
+#ifdef __linux__
+    {"read_mode_mmap", flb_test_read_mode_mmap},
+#endif
+    {"read_mode_benchmark", flb_test_read_mode_benchmark},
 #ifdef FLB_HAVE_INOTIFY
     {"inotify_watcher_false", flb_test_inotify_watcher_false},
 #endif /* FLB_HAVE_INOTIFY */
@@ -1974,6 +2287,7 @@ TEST_LIST = {
 
 #ifdef FLB_HAVE_SQLDB
     {"db", flb_test_db},
+    {"db_checkpoint", flb_test_db_checkpoint},
     {"db_delete_stale_file", flb_test_db_delete_stale_file},
     {"db_compare_filename", flb_test_db_compare_filename},
 #endif
@@ -20,6 +20,7 @@
 #include <fluent-bit.h>
 #include <fluent-bit/flb_pack.h>
 #include <fluent-bit/flb_record_accessor.h>
+#include <fluent-bit/flb_time.h>
 
 #include "flb_tests_runtime.h"
 
@@ -352,6 +353,200 @@ void flb_test_forward_compat_mode()
     flb_destroy(ctx);
 }
 
+/*
+ * Forward to forward: records go through out_forward to an in_forward
+ * listener of the same service, which prefixes their tag with 'received.'.
+ */
+#define FORWARD_PORT    "24299"
+#define FORWARD_RECORDS 3000
+
+/* records per push, every write to the lib pipe must be atomic */
+#define FORWARD_BATCH   64
+
+static int received_records;
+static int received_checked;
+static pthread_mutex_t received_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int cb_count_received(void *record, size_t size, void *data)
+{
+    char *expected = data;
+
+    pthread_mutex_lock(&received_mutex);
+    received_records++;
+    if (expected && strstr(record, expected) != NULL) {
+        received_checked++;
+    }
+    pthread_mutex_unlock(&received_mutex);
+
+    flb_free(record);
+    return 0;
+}
+
+static int get_received()
+{
+    int ret;
+
+    pthread_mutex_lock(&received_mutex);
+    ret = received_records;
+    pthread_mutex_unlock(&received_mutex);
+
+    return ret;
+}
+
+static flb_ctx_t *forward_pair_create(char *passthrough, char *format,
+                                      char *expected, int *in_ffd)
+{
+    int ret;
+    int ffd;
+    flb_ctx_t *ctx;
+    struct flb_lib_out_cb cb;
+
+    received_records = 0;
+    received_checked = 0;
+
+    ctx = flb_create();
+    flb_service_set(ctx,
+                    "flush", "0.2",
+                    "grace", "1",
+                    "log_level", "error",
+                    NULL);
+
+    *in_ffd = flb_input(ctx, (char *) "lib", NULL);
+    flb_input_set(ctx, *in_ffd, "tag", "test", NULL);
+
+    ffd = flb_input(ctx, (char *) "forward", NULL);
+    flb_input_set(ctx, ffd,
+                  "listen", "127.0.0.1",
+                  "port", FORWARD_PORT,
+                  "tag_prefix", "received.",
+                  NULL);
+
+    ffd = flb_output(ctx, (char *) "forward", NULL);
+    flb_output_set(ctx, ffd,
+                   "match", "test",
+                   "host", "127.0.0.1",
+                   "port", FORWARD_PORT,
+                   "require_ack_response", "true",
+                   "passthrough", passthrough,
+                   NULL);
+
+    cb.cb = cb_count_received;
+    cb.data = expected;
+    ffd = flb_output(ctx, (char *) "lib", &cb);
+    flb_output_set(ctx, ffd,
+                   "match", "received.*",
+                   "format", format,
+                   NULL);
+
+    ret = flb_start(ctx);
+    TEST_CHECK(ret == 0);
+
+    return ctx;
+}
+
+/* push 'count' records in batches */
+static void forward_pair_push(flb_ctx_t *ctx, int in_ffd, int count)
+{
+    int i;
+    int n;
+    size_t len;
+    char *buf;
+    char record[] = "[1700000000.5, {\"key1\": \"value\", \"key2\": 12345}]";
+
+    buf = flb_malloc(sizeof(record) * FORWARD_BATCH);
+    TEST_CHECK(buf != NULL);
+    if (!buf) {
+        return;
+    }
+
+    while (count > 0) {
+        n = count < FORWARD_BATCH ? count : FORWARD_BATCH;
+        len = 0;
+        for (i = 0; i < n; i++) {
+            memcpy(buf + len, record, sizeof(record) - 1);
+            len += sizeof(record) - 1;
+        }
+        flb_lib_push(ctx, in_ffd, buf, len);
+        count -= n;
+    }
+
+    flb_free(buf);
+}
+
+static int forward_pair_wait(int count, int seconds)
+{
+    int i;
+
+    for (i = 0; i < seconds * 100 && get_received() < count; i++) {
+        flb_time_msleep(10);
+    }
+
+    return get_received();
+}
+
+void flb_test_forward_passthrough()
+{
+    int in_ffd;
+    int received;
+    flb_ctx_t *ctx;
+
+    ctx = forward_pair_create("true", "json",
+                              "{\"key1\":\"value\",\"key2\":12345}", &in_ffd);
+
+    forward_pair_push(ctx, in_ffd, FORWARD_RECORDS);
+    received = forward_pair_wait(FORWARD_RECORDS, 10);
+
+    TEST_CHECK(received == FORWARD_RECORDS);
+    TEST_MSG("received=%i", received);
+    TEST_CHECK(received_checked == received);
+
+    flb_stop(ctx);
+    flb_destroy(ctx);
+}
+
+/*
+ * Benchmark: set FLB_FORWARD_BENCH to a number of records to compare the
+ * throughput of the forward mode with and without passthrough.
+ */
+void flb_test_bench_passthrough()
+{
+    int i;
+    int count;
+    int in_ffd;
+    int received;
+    char *env;
+    char *modes[] = {"false", "true"};
+    uint64_t start;
+    double elapsed;
+    flb_ctx_t *ctx;
+
+    env = getenv("FLB_FORWARD_BENCH");
+    if (!env) {
+        return;
+    }
+    count = atoi(env);
+    if (count <= 0) {
+        return;
+    }
+
+    for (i = 0; i < 2; i++) {
+        ctx = forward_pair_create(modes[i], "msgpack", NULL, &in_ffd);
+
+        start = cfl_time_now();
+        forward_pair_push(ctx, in_ffd, count);
+        received = forward_pair_wait(count, 120);
+        elapsed = (cfl_time_now() - start) / 1000000000.0;
+
+        TEST_CHECK(received == count);
+        printf("\npassthrough=%-5s records=%i time=%.3fs records/s=%.0f",
+               modes[i], received, elapsed, received / elapsed);
+
+        flb_stop(ctx);
+        flb_destroy(ctx);
+    }
+    printf("\n");
+}
+
 /* Test list */
 TEST_LIST = {
 #ifdef FLB_HAVE_RECORD_ACCESSOR
@@ -360,5 +555,9 @@ TEST_LIST = {
 #endif
     {"forward_mode"       , flb_test_forward_mode },
     {"forward_compat_mode", flb_test_forward_compat_mode },
+    {"forward_passthrough", flb_test_forward_passthrough },
+
+    /* Benchmark, only runs when FLB_FORWARD_BENCH is set */
+    {"bench_passthrough"  , flb_test_bench_passthrough },
     {NULL, NULL}
 };